@@ -0,0 +1,129 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+
+#include "action_map.h"
+
+ActionMap::ActionMap()
+{
+    clear();
+}
+
+ActionMap::~ActionMap()
+{
+}
+
+bool ActionMap::bind(int action, int trigger, int modifier1, int modifier2, int modifier3)
+{
+    if (m_bindingCount == MAX_BINDINGS)
+        return false;
+
+    if (action < 0 || action >= MAX_ACTIONS)
+        return false;
+
+    if (trigger < 0 || trigger >= InputBits::INPUT_COUNT)
+        return false;
+
+    Binding &binding = m_bindings[m_bindingCount++];
+
+    binding.action = action;
+    binding.trigger = trigger;
+    binding.modifiers[0] = modifier1;
+    binding.modifiers[1] = modifier2;
+    binding.modifiers[2] = modifier3;
+
+    return true;
+}
+
+void ActionMap::clear()
+{
+    m_bindingCount = 0;
+    m_compiledCount = 0;
+    m_actionsDown = 0;
+    m_prevActionsDown = 0;
+    m_actionsTriggered = 0;
+}
+
+void ActionMap::compile()
+{
+    for (int i = 0; i < m_bindingCount; ++i)
+    {
+        const Binding &binding = m_bindings[i];
+        CompiledBinding &compiled = m_compiled[i];
+
+        compiled.actionBit = 1ULL << binding.action;
+        compiled.triggerWord = binding.trigger >> 5;
+        compiled.triggerBit = 1U << (binding.trigger & 31);
+        compiled.hasModifiers = false;
+
+        for (int j = 0; j < InputBits::WORD_COUNT; ++j)
+            compiled.modifierMask[j] = 0;
+
+        for (int j = 0; j < MAX_MODIFIERS; ++j)
+        {
+            int modifier = binding.modifiers[j];
+
+            if (modifier >= 0 && modifier < InputBits::INPUT_COUNT)
+            {
+                compiled.modifierMask[modifier >> 5] |= 1U << (modifier & 31);
+                compiled.hasModifiers = true;
+            }
+        }
+    }
+
+    m_compiledCount = m_bindingCount;
+}
+
+void ActionMap::evaluate(const InputBits &down, const InputBits &pressed)
+{
+    // Evaluates every compiled binding against the current input state. The
+    // results for all actions are accumulated into 64-bit masks. A binding
+    // contributes its action bit only if none of its modifier bits are
+    // missing from the 'down' set.
+
+    unsigned long long actionsDown = 0;
+    unsigned long long actionsTriggered = 0;
+
+    for (int i = 0; i < m_compiledCount; ++i)
+    {
+        const CompiledBinding &binding = m_compiled[i];
+        unsigned int missingModifiers = 0;
+
+        if (binding.hasModifiers)
+        {
+            for (int j = 0; j < InputBits::WORD_COUNT; ++j)
+                missingModifiers |= binding.modifierMask[j] & ~down.words[j];
+        }
+
+        unsigned long long actionBit = missingModifiers ? 0 : binding.actionBit;
+
+        if (down.words[binding.triggerWord] & binding.triggerBit)
+            actionsDown |= actionBit;
+
+        if (pressed.words[binding.triggerWord] & binding.triggerBit)
+            actionsTriggered |= actionBit;
+    }
+
+    m_prevActionsDown = m_actionsDown;
+    m_actionsDown = actionsDown;
+    m_actionsTriggered = actionsTriggered;
+}
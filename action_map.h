@@ -0,0 +1,141 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+
+#if !defined(ACTION_MAP_H)
+#define ACTION_MAP_H
+
+//-----------------------------------------------------------------------------
+// A packed set of digital inputs. Bits 0-255 hold the keyboard keys (indexed
+// by their DirectInput scan codes, i.e., the Keyboard::Key values). The bits
+// following the keys hold the mouse buttons and the mouse wheel directions.
+//-----------------------------------------------------------------------------
+
+struct InputBits
+{
+    enum
+    {
+        INPUT_MOUSE_BUTTON_LEFT = 256,
+        INPUT_MOUSE_BUTTON_RIGHT,
+        INPUT_MOUSE_BUTTON_MIDDLE,
+        INPUT_MOUSE_BUTTON_4,
+        INPUT_MOUSE_WHEEL_UP,
+        INPUT_MOUSE_WHEEL_DOWN,
+        INPUT_COUNT
+    };
+
+    enum { WORD_COUNT = (INPUT_COUNT + 31) / 32 };
+
+    void clear()
+    {
+        for (int i = 0; i < WORD_COUNT; ++i)
+            words[i] = 0;
+    }
+
+    void set(int input)
+    { words[input >> 5] |= 1U << (input & 31); }
+
+    bool test(int input) const
+    { return (words[input >> 5] & (1U << (input & 31))) != 0; }
+
+    unsigned int words[WORD_COUNT];
+};
+
+//-----------------------------------------------------------------------------
+// The ActionMap class maps digital inputs to application defined actions.
+// Actions are identified by integers in the range [0, MAX_ACTIONS).
+//
+// Each binding consists of a trigger input and up to MAX_MODIFIERS modifier
+// inputs that must be held down at the same time (e.g., ALT + ENTER). An
+// action can have any number of bindings. The action is down if any of its
+// bindings is down, and it's triggered if the trigger input of any of its
+// bindings was pressed while that binding's modifiers were held down.
+//
+// Once all of the bindings have been added call compile(). This flattens the
+// bindings into a table of bit masks that evaluate() walks in a single pass.
+//-----------------------------------------------------------------------------
+
+class ActionMap
+{
+public:
+    enum { MAX_ACTIONS = 64 };
+    enum { MAX_BINDINGS = 1024 };
+    enum { MAX_MODIFIERS = 3 };
+    enum { INPUT_NONE = -1 };
+
+    ActionMap();
+    ~ActionMap();
+
+    bool bind(int action, int trigger, int modifier1 = INPUT_NONE,
+              int modifier2 = INPUT_NONE, int modifier3 = INPUT_NONE);
+    void clear();
+    void compile();
+    void evaluate(const InputBits &down, const InputBits &pressed);
+
+    // Returns +1, -1, or 0 depending on which of the two actions are down.
+    float axis(int positiveAction, int negativeAction) const
+    { return (isDown(positiveAction) ? 1.0f : 0.0f) - (isDown(negativeAction) ? 1.0f : 0.0f); }
+
+    int bindingCount() const
+    { return m_bindingCount; }
+
+    bool isDown(int action) const
+    { return (m_actionsDown & (1ULL << action)) != 0; }
+
+    // True if the action is down now but wasn't down the last time
+    // evaluate() was called.
+    bool started(int action) const
+    { return (m_actionsDown & ~m_prevActionsDown & (1ULL << action)) != 0; }
+
+    bool triggered(int action) const
+    { return (m_actionsTriggered & (1ULL << action)) != 0; }
+
+private:
+    struct Binding
+    {
+        int action;
+        int trigger;
+        int modifiers[MAX_MODIFIERS];
+    };
+
+    // The compiled form of a binding. The modifier inputs are folded into a
+    // full width bit mask so that testing them is a handful of AND and
+    // compare operations regardless of how many modifiers there are.
+    struct CompiledBinding
+    {
+        unsigned int modifierMask[InputBits::WORD_COUNT];
+        unsigned long long actionBit;
+        int triggerWord;
+        unsigned int triggerBit;
+        bool hasModifiers;
+    };
+
+    Binding m_bindings[MAX_BINDINGS];
+    CompiledBinding m_compiled[MAX_BINDINGS];
+    int m_bindingCount;
+    int m_compiledCount;
+    unsigned long long m_actionsDown;
+    unsigned long long m_prevActionsDown;
+    unsigned long long m_actionsTriggered;
+};
+
+#endif
@@ -0,0 +1,68 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(APP_CAMERA_H)
+#define APP_CAMERA_H
+
+#include <cmath>
+#include <d3dx9.h>
+
+//-----------------------------------------------------------------------------
+// How the interactive application sets up its camera. The headless camera
+// server and the tests and benchmarks use the same settings so that they
+// measure the camera the way the application uses it.
+//-----------------------------------------------------------------------------
+
+const D3DXVECTOR3 CAMERA_ACCELERATION(8.0f, 8.0f, 8.0f);
+const float       CAMERA_FOVX = 90.0f;
+const D3DXVECTOR3 CAMERA_POS(0.0f, 1.0f, 0.0f);
+const float       CAMERA_SPEED_ROTATION = 0.2f;
+const float       CAMERA_SPEED_FLIGHT_YAW = 100.0f;
+const D3DXVECTOR3 CAMERA_VELOCITY(2.0f, 2.0f, 2.0f);
+const float       CAMERA_ZFAR = 100.0f;
+const float       CAMERA_ZNEAR = 0.1f;
+
+// The camera is kept above the floor, which is centered on the scene's
+// origin.
+const float       FLOOR_WIDTH = 16.0f;
+const float       FLOOR_HEIGHT = 16.0f;
+
+// In follow mode the camera follows a subject walking in a circle around the
+// floor's center.
+const float       FOLLOW_SUBJECT_RADIUS = 5.0f;
+const float       FOLLOW_SUBJECT_SPEED = 1.5f;
+
+//-----------------------------------------------------------------------------
+
+// Returns where the follow mode's subject is after walking for timeSec
+// seconds, relative to the scene's origin, and the heading it's walking in
+// (in the same sense as Camera::rotate()).
+inline void GetFollowSubject(float timeSec, D3DXVECTOR3 &position, float &headingDegrees)
+{
+    float angle = FOLLOW_SUBJECT_SPEED / FOLLOW_SUBJECT_RADIUS * timeSec;
+
+    position = D3DXVECTOR3(FOLLOW_SUBJECT_RADIUS * sinf(angle), 0.0f,
+        FOLLOW_SUBJECT_RADIUS * cosf(angle));
+    headingDegrees = D3DXToDegree(angle) + 90.0f;
+}
+
+#endif
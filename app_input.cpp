@@ -0,0 +1,95 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <cstring>
+#include "app_input.h"
+#include "input.h"
+
+void InitActionMap(ActionMap &actionMap)
+{
+    actionMap.clear();
+
+    // Camera movement.
+
+    BindCameraActions(actionMap);
+
+    // Application controls.
+
+    actionMap.bind(ACTION_EXIT, Keyboard::KEY_ESCAPE);
+    actionMap.bind(ACTION_TOGGLE_HELP, Keyboard::KEY_H);
+    actionMap.bind(ACTION_TOGGLE_COLOR_MAP, Keyboard::KEY_T);
+    actionMap.bind(ACTION_INCREASE_ROTATION_SPEED, Keyboard::KEY_ADD);
+    actionMap.bind(ACTION_INCREASE_ROTATION_SPEED, Keyboard::KEY_NUMPAD_ADD);
+    actionMap.bind(ACTION_DECREASE_ROTATION_SPEED, Keyboard::KEY_MINUS);
+    actionMap.bind(ACTION_DECREASE_ROTATION_SPEED, Keyboard::KEY_NUMPAD_MINUS);
+    actionMap.bind(ACTION_INCREASE_MOUSE_WEIGHT, Keyboard::KEY_PERIOD);
+    actionMap.bind(ACTION_DECREASE_MOUSE_WEIGHT, Keyboard::KEY_COMMA);
+    actionMap.bind(ACTION_TOGGLE_MOUSE_SMOOTHING, Keyboard::KEY_M);
+    actionMap.bind(ACTION_TOGGLE_FULL_SCREEN, Keyboard::KEY_ENTER, Keyboard::KEY_LALT);
+    actionMap.bind(ACTION_TOGGLE_FULL_SCREEN, Keyboard::KEY_ENTER, Keyboard::KEY_RALT);
+    actionMap.bind(ACTION_TOGGLE_FLIGHT_MODE, Keyboard::KEY_SPACE);
+    actionMap.bind(ACTION_CYCLE_VIEW_LAYOUT, Keyboard::KEY_V);
+    actionMap.bind(ACTION_TOGGLE_PREDICTION, Keyboard::KEY_P);
+    actionMap.bind(ACTION_CYCLE_CAMERA_MODE, Keyboard::KEY_C);
+
+    actionMap.compile();
+}
+
+void UpdateActionMap(ActionMap &actionMap)
+{
+    const Keyboard &keyboard = Keyboard::instance();
+    const Mouse &mouse = Mouse::instance();
+    InputBits down;
+    InputBits pressed;
+
+    down.clear();
+    pressed.clear();
+
+    // The keyboard already keeps its state as 256-bit sets laid out the same
+    // way as the first 8 words of InputBits.
+    memcpy(down.words, keyboard.getKeyDownBits(), 8 * sizeof(unsigned int));
+    memcpy(pressed.words, keyboard.getKeyPressedBits(), 8 * sizeof(unsigned int));
+
+    for (int i = 0; i < 4; ++i)
+    {
+        Mouse::MouseButton button = static_cast<Mouse::MouseButton>(i);
+
+        if (mouse.buttonDown(button))
+            down.set(InputBits::INPUT_MOUSE_BUTTON_LEFT + i);
+
+        if (mouse.buttonPressed(button))
+            pressed.set(InputBits::INPUT_MOUSE_BUTTON_LEFT + i);
+    }
+
+    if (mouse.wheelPos() > 0.0f)
+    {
+        down.set(InputBits::INPUT_MOUSE_WHEEL_UP);
+        pressed.set(InputBits::INPUT_MOUSE_WHEEL_UP);
+    }
+    else if (mouse.wheelPos() < 0.0f)
+    {
+        down.set(InputBits::INPUT_MOUSE_WHEEL_DOWN);
+        pressed.set(InputBits::INPUT_MOUSE_WHEEL_DOWN);
+    }
+
+    actionMap.evaluate(down, pressed);
+}
@@ -0,0 +1,62 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(APP_INPUT_H)
+#define APP_INPUT_H
+
+#include "action_map.h"
+#include "camera_input.h"
+
+//-----------------------------------------------------------------------------
+// The interactive application's actions and their key bindings. The headless
+// tests replay input through the same bindings so that they trigger the
+// actions the way the application does.
+//-----------------------------------------------------------------------------
+
+// The camera movement actions come first. See camera_input.h.
+enum Action
+{
+    ACTION_EXIT = CAMERA_ACTION_COUNT,
+    ACTION_TOGGLE_HELP,
+    ACTION_TOGGLE_COLOR_MAP,
+    ACTION_INCREASE_ROTATION_SPEED,
+    ACTION_DECREASE_ROTATION_SPEED,
+    ACTION_INCREASE_MOUSE_WEIGHT,
+    ACTION_DECREASE_MOUSE_WEIGHT,
+    ACTION_TOGGLE_MOUSE_SMOOTHING,
+    ACTION_TOGGLE_FULL_SCREEN,
+    ACTION_TOGGLE_FLIGHT_MODE,
+    ACTION_CYCLE_VIEW_LAYOUT,
+    ACTION_TOGGLE_PREDICTION,
+    ACTION_CYCLE_CAMERA_MODE,
+    ACTION_COUNT
+};
+
+// Binds the camera movement keys and the application's keys, and compiles
+// the map.
+void InitActionMap(ActionMap &actionMap);
+
+// Packs the Keyboard and Mouse classes' current state into bit sets and
+// evaluates all of the map's bindings against them in one go.
+void UpdateActionMap(ActionMap &actionMap);
+
+#endif
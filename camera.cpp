@@ -20,21 +20,55 @@
 // IN THE SOFTWARE.
 //-----------------------------------------------------------------------------
 
+#include <cfloat>
 #include <cmath>
+#include <xmmintrin.h>
 #include "camera.h"
 
-const float Camera::DEFAULT_ROTATION_SPEED = 0.3f;
-const float Camera::DEFAULT_FOVX = 90.0f;
-const float Camera::DEFAULT_ZNEAR = 0.1f;
-const float Camera::DEFAULT_ZFAR = 1000.0f;
+namespace
+{
+    float Halton(int index, int base)
+    {
+        // Returns the index'th element of the Halton sequence for the given
+        // prime base. The elements are well spread out in [0,1) for any
+        // number of consecutive indices, so any number of jitter samples
+        // covers the pixel evenly.
 
-const D3DXVECTOR3 Camera::WORLD_XAXIS(1.0f, 0.0f, 0.0f);
-const D3DXVECTOR3 Camera::WORLD_YAXIS(0.0f, 1.0f, 0.0f);
-const D3DXVECTOR3 Camera::WORLD_ZAXIS(0.0f, 0.0f, 1.0f);
+        float result = 0.0f;
+        float fraction = 1.0f / base;
 
-Camera::Camera()
+        while (index > 0)
+        {
+            result += fraction * (index % base);
+            index /= base;
+            fraction /= base;
+        }
+
+        return result;
+    }
+}
+
+const float CameraBase::DEFAULT_ORBIT_DISTANCE = 5.0f;
+const float CameraBase::DEFAULT_ROTATION_SPEED = 0.3f;
+const float CameraBase::DEFAULT_FOVX = 90.0f;
+const float CameraBase::DEFAULT_ZNEAR = 0.1f;
+const float CameraBase::DEFAULT_ZFAR = 1000.0f;
+
+// Keeps vertices at infinity just inside the far plane of the standard
+// infinite projection despite round off in the vertex transform.
+const float CameraBase::INFINITE_FAR_EPSILON = 2.4e-7f;
+
+// Zooming an orbit camera all the way in would leave it without a view
+// direction.
+const float CameraBase::MIN_ORBIT_DISTANCE = 0.01f;
+
+const D3DXVECTOR3 CameraBase::WORLD_XAXIS(1.0f, 0.0f, 0.0f);
+const D3DXVECTOR3 CameraBase::WORLD_YAXIS(0.0f, 1.0f, 0.0f);
+const D3DXVECTOR3 CameraBase::WORLD_ZAXIS(0.0f, 0.0f, 1.0f);
+
+CameraBase::CameraBase()
 {
-    m_behavior = CAMERA_BEHAVIOR_FLIGHT;
+    m_depthMode = DEPTH_MODE_STANDARD;
     
     m_accumPitchDegrees = 0.0f;
     m_rotationSpeed = DEFAULT_ROTATION_SPEED;
@@ -42,7 +76,16 @@ Camera::Camera()
     m_aspectRatio = 0.0f;
     m_znear = DEFAULT_ZNEAR;
     m_zfar = DEFAULT_ZFAR;
+    m_orbitDistance = DEFAULT_ORBIT_DISTANCE;
+    m_jitterSampleCount = 0;
+    m_jitterIndex = 0;
+    m_viewportWidth = 0;
+    m_viewportHeight = 0;
+    m_hasPreviousFrame = false;
+    m_jitter = D3DXVECTOR2(0.0f, 0.0f);
     
+    m_orbitTarget = D3DXVECTOR3(0.0f, 0.0f, DEFAULT_ORBIT_DISTANCE);
+    m_origin = WorldPosition(0.0, 0.0, 0.0);
     m_eye = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
     m_xAxis = D3DXVECTOR3(1.0f, 0.0f, 0.0f);
     m_yAxis = D3DXVECTOR3(0.0f, 1.0f, 0.0f);
@@ -55,22 +98,88 @@ Camera::Camera()
     
     D3DXMatrixIdentity(&m_viewMatrix);
     D3DXMatrixIdentity(&m_projMatrix);
+    D3DXMatrixIdentity(&m_prevViewProjMatrix);
+
+    m_prevOrigin = WorldPosition(0.0, 0.0, 0.0);
 }
 
-Camera::~Camera()
+CameraBase::~CameraBase()
+{
+}
+
+void CameraBase::advanceFrame()
+{
+    advanceFrame(*this);
+}
+
+void CameraBase::advanceFrame(const CameraBase &renderedCamera)
+{
+    // Remembers the view-projection matrix the frame was rendered with for
+    // the next frame and moves on to the next jitter sample. The rendered
+    // camera is usually this camera, but it can be a copy of it that was
+    // changed just for rendering (e.g., moved to a predicted pose).
+
+    m_prevViewProjMatrix = renderedCamera.getUnjitteredViewProjectionMatrix();
+    m_prevOrigin = renderedCamera.m_origin;
+    m_hasPreviousFrame = true;
+
+    ++m_jitterIndex;
+    updateJitter();
+}
+
+void CameraBase::depthProjection(DepthMode mode, float znear, float zfar,
+                                 float &zScale, float &zOffset)
+{
+    // Returns the two projection matrix entries that map view space z to
+    // depth: depth = zScale + zOffset / z. These are the (2,2) and (3,2)
+    // entries of a row vector D3D projection matrix whose (2,3) entry is 1.
+
+    switch (mode)
+    {
+    default:
+    case DEPTH_MODE_STANDARD:
+        zScale = zfar / (zfar - znear);
+        zOffset = -znear * zScale;
+        break;
+
+    case DEPTH_MODE_REVERSE_Z:
+        zScale = znear / (znear - zfar);
+        zOffset = -zfar * zScale;
+        break;
+
+    case DEPTH_MODE_INFINITE_FAR:
+        zScale = 1.0f - INFINITE_FAR_EPSILON;
+        zOffset = -znear * zScale;
+        break;
+
+    case DEPTH_MODE_REVERSE_Z_INFINITE_FAR:
+        zScale = 0.0f;
+        zOffset = znear;
+        break;
+    }
+}
+
+float CameraBase::linearizeDepth(float depth) const
 {
+    // Converts a depth buffer value back into a view space distance along the
+    // view direction. Works for all of the depth modes. Returns infinity for
+    // the far plane of the infinite far plane modes.
+
+    return m_projMatrix(3,2) / (depth - m_projMatrix(2,2));
 }
 
-void Camera::lookAt(const D3DXVECTOR3 &target)
+void CameraBase::lookAt(const D3DXVECTOR3 &target)
 {
     lookAt(m_eye, target, m_yAxis);
 }
 
-void Camera::lookAt(const D3DXVECTOR3 &eye, const D3DXVECTOR3 &target, const D3DXVECTOR3 &up)
+void CameraBase::lookAt(const D3DXVECTOR3 &eye, const D3DXVECTOR3 &target, const D3DXVECTOR3 &up)
 {
     m_eye = eye;
+    m_orbitTarget = target;
 
     m_zAxis = target - eye;
+    m_orbitDistance = D3DXVec3Length(&m_zAxis);
     D3DXVec3Normalize(&m_zAxis, &m_zAxis);
 
     m_viewDir = m_zAxis;
@@ -103,37 +212,30 @@ void Camera::lookAt(const D3DXVECTOR3 &eye, const D3DXVECTOR3 &target, const D3D
     m_accumPitchDegrees = D3DXToDegree(-asinf(m_viewMatrix(1,2)));
 }
 
-void Camera::move(float dx, float dy, float dz)
+D3DXVECTOR2 CameraBase::motionVector(const D3DXVECTOR3 &position,
+                                     const D3DXVECTOR3 &previousPosition) const
 {
-    // Moves the camera by dx world units to the left or right; dy
-    // world units upwards or downwards; and dz world units forwards
-    // or backwards.
-
-    D3DXVECTOR3 eye = m_eye;
-    D3DXVECTOR3 forwards;
-
-    if (m_behavior == CAMERA_BEHAVIOR_FIRST_PERSON)
-    {
-        // Calculate the forwards direction. Can't just use the camera's local
-        // z axis as doing so will cause the camera to move more slowly as the
-        // camera's view approaches 90 degrees straight up and down.
-
-        D3DXVec3Cross(&forwards, &m_xAxis, &WORLD_YAXIS);
-        D3DXVec3Normalize(&forwards, &forwards);
-    }
-    else
-    {
-        forwards = m_viewDir;
-    }
-
-    eye += m_xAxis * dx;
-    eye += WORLD_YAXIS * dy;
-    eye += forwards * dz;
-
-    setPosition(eye);
+    // Returns how far a point moved in normalized device coordinates since
+    // the previous frame: where 'position' is now minus where
+    // 'previousPosition' was in the previous frame. Both are relative to the
+    // camera's current origin. Pass the same position twice for a static
+    // object. Multiply by half the viewport's size for pixels, remembering
+    // that y points up in normalized device coordinates. The jitter is left
+    // out so that a static scene seen by a static camera doesn't move.
+
+    D3DXMATRIX viewProj = getUnjitteredViewProjectionMatrix();
+    D3DXMATRIX prevViewProj = getPreviousViewProjectionMatrix();
+    D3DXVECTOR4 current;
+    D3DXVECTOR4 previous;
+
+    D3DXVec3Transform(&current, &position, &viewProj);
+    D3DXVec3Transform(&previous, &previousPosition, &prevViewProj);
+
+    return D3DXVECTOR2(current.x / current.w - previous.x / previous.w,
+        current.y / current.w - previous.y / previous.w);
 }
 
-void Camera::move(const D3DXVECTOR3 &direction, const D3DXVECTOR3 &amount)
+void CameraBase::move(const D3DXVECTOR3 &direction, const D3DXVECTOR3 &amount)
 {
     // Moves the camera by the specified amount of world units in the specified
     // direction in world space.
@@ -145,7 +247,20 @@ void Camera::move(const D3DXVECTOR3 &direction, const D3DXVECTOR3 &amount)
     updateViewMatrix(false);
 }
 
-void Camera::perspective(float fovx, float aspect, float znear, float zfar)
+void CameraBase::orbit(const D3DXVECTOR3 &target, float distance)
+{
+    // Places the camera 'distance' world units from 'target' along its current
+    // view direction without changing its orientation. Unlike lookAt() this
+    // doesn't need to rebuild the camera's axes, and it leaves the orbit
+    // target and distance alone. CameraRig uses it to show the smoothed orbit
+    // while the orbit target and distance hold where the camera is heading.
+
+    m_eye = target - m_zAxis * distance;
+
+    updateViewMatrix(false);
+}
+
+void CameraBase::perspective(float fovx, float aspect, float znear, float zfar)
 {
     // Construct a projection matrix based on the horizontal field of view
     // 'fovx' rather than the more traditional vertical field of view 'fovy'.
@@ -168,8 +283,7 @@ void Camera::perspective(float fovx, float aspect, float znear, float zfar)
 
     m_projMatrix(0,2) = 0.0f;
     m_projMatrix(1,2) = 0.0f;
-    m_projMatrix(2,2) = zfar / (zfar - znear);
-    m_projMatrix(3,2) = -znear * zfar / (zfar - znear);
+    depthProjection(m_depthMode, znear, zfar, m_projMatrix(2,2), m_projMatrix(3,2));
 
     m_projMatrix(0,3) = 0.0f;
     m_projMatrix(1,3) = 0.0f;
@@ -180,351 +294,300 @@ void Camera::perspective(float fovx, float aspect, float znear, float zfar)
     m_aspectRatio = aspect;
     m_znear = znear;
     m_zfar = zfar;
+
+    updateJitter();
 }
 
-void Camera::rotate(float headingDegrees, float pitchDegrees, float rollDegrees)
+D3DXQUATERNION CameraBase::getOrientation() const
 {
-    // Rotates the camera based on its current behavior.
-    // Note that not all behaviors support rolling.
-    //
-    // This Camera class follows the left-hand rotation rule.
-    // Angles are measured clockwise when looking along the rotation
-    // axis toward the origin. Since the Z axis is pointing into the
-    // screen we need to negate rolls.
+    // The camera's local axes form the rows of its world space rotation
+    // matrix. This is the inverse of the rotation in the view matrix.
 
-    rollDegrees = -rollDegrees;
-
-    switch (m_behavior)
-    {
-    default:
-        break;
-
-    case CAMERA_BEHAVIOR_FIRST_PERSON:
-        rotateFirstPerson(headingDegrees, pitchDegrees);
-        break;
+    D3DXMATRIX rotMtx;
+    D3DXQUATERNION orientation;
 
-    case CAMERA_BEHAVIOR_FLIGHT:
-        rotateFlight(headingDegrees, pitchDegrees, rollDegrees);
-        break;
-    }
+    D3DXMatrixIdentity(&rotMtx);
 
-    updateViewMatrix(true);
-}
+    rotMtx(0,0) = m_xAxis.x;
+    rotMtx(0,1) = m_xAxis.y;
+    rotMtx(0,2) = m_xAxis.z;
 
-void Camera::rotateSmoothly(float headingDegrees, float pitchDegrees, float rollDegrees)
-{
-    // This method applies a scaling factor to the rotation angles prior to
-    // using these rotation angles to rotate the camera. This method is usually
-    // called when the camera is being rotated using an input device (such as a
-    // mouse or a joystick). 
+    rotMtx(1,0) = m_yAxis.x;
+    rotMtx(1,1) = m_yAxis.y;
+    rotMtx(1,2) = m_yAxis.z;
 
-    headingDegrees *= m_rotationSpeed;
-    pitchDegrees *= m_rotationSpeed;
-    rollDegrees *= m_rotationSpeed;
+    rotMtx(2,0) = m_zAxis.x;
+    rotMtx(2,1) = m_zAxis.y;
+    rotMtx(2,2) = m_zAxis.z;
 
-    rotate(headingDegrees, pitchDegrees, rollDegrees);
+    D3DXQuaternionRotationMatrix(&orientation, &rotMtx);
+    D3DXQuaternionNormalize(&orientation, &orientation);
+    return orientation;
 }
 
-void Camera::updatePosition(const D3DXVECTOR3 &direction, float elapsedTimeSec)
+D3DXMATRIX CameraBase::getPreviousViewProjectionMatrix() const
 {
-    // Moves the camera using Newton's second law of motion. Unit mass is
-    // assumed here to somewhat simplify the calculations. The direction vector
-    // is in the range [-1,1].
-
-    if (D3DXVec3LengthSq(&m_currentVelocity) != 0.0f)
-    {
-        // Only move the camera if the velocity vector is not of zero length.
-        // Doing this guards against the camera slowly creeping around due to
-        // floating point rounding errors.
-
-        D3DXVECTOR3 displacement = (m_currentVelocity * elapsedTimeSec) +
-            (0.5f * m_acceleration * elapsedTimeSec * elapsedTimeSec);
-
-        // Floating point rounding errors will slowly accumulate and cause the
-        // camera to move along each axis. To prevent any unintended movement
-        // the displacement vector is clamped to zero for each direction that
-        // the camera isn't moving in. Note that the updateVelocity() method
-        // will slowly decelerate the camera's velocity back to a stationary
-        // state when the camera is no longer moving along that direction. To
-        // account for this the camera's current velocity is also checked.
+    // The previous frame's view-projection matrix, relative to the current
+    // origin. Before the first call to advanceFrame() there is no previous
+    // frame and the current matrix is returned instead.
 
-        if (direction.x == 0.0f && fabsf(m_currentVelocity.x) < 1e-6f)
-            displacement.x = 0.0f;
+    if (!m_hasPreviousFrame)
+        return getUnjitteredViewProjectionMatrix();
 
-        if (direction.y == 0.0f && fabsf(m_currentVelocity.y) < 1e-6f)
-            displacement.y = 0.0f;
+    D3DXVECTOR3 originOffset = WorldOffset(m_origin, m_prevOrigin);
+    D3DXMATRIX translation;
 
-        if (direction.z == 0.0f && fabsf(m_currentVelocity.z) < 1e-6f)
-            displacement.z = 0.0f;
+    D3DXMatrixTranslation(&translation, originOffset.x, originOffset.y, originOffset.z);
+    return translation * m_prevViewProjMatrix;
+}
 
-        move(displacement.x, displacement.y, displacement.z);
-    }
+D3DXMATRIX CameraBase::getUnjitteredViewProjectionMatrix() const
+{
+    D3DXMATRIX proj = m_projMatrix;
 
-    // Continuously update the camera's velocity vector even if the camera
-    // hasn't moved during this call. When the camera is no longer being moved
-    // the camera is decelerating back to its stationary state.
+    proj(2,0) = 0.0f;
+    proj(2,1) = 0.0f;
 
-    updateVelocity(direction, elapsedTimeSec);
+    return m_viewMatrix * proj;
 }
 
-void Camera::setAcceleration(const D3DXVECTOR3 &acceleration)
+void CameraBase::setAcceleration(const D3DXVECTOR3 &acceleration)
 {
     m_acceleration = acceleration;
 }
 
-void Camera::setAcceleration(float x, float y, float z)
+void CameraBase::setAcceleration(float x, float y, float z)
 {
     m_acceleration.x = x;
     m_acceleration.y = y;
     m_acceleration.z = z;
 }
 
-void Camera::setBehavior(CameraBehavior behavior)
-{
-    if (m_behavior == CAMERA_BEHAVIOR_FLIGHT && behavior == CAMERA_BEHAVIOR_FIRST_PERSON)
-    {
-        // Moving from flight behavior to first person behavior.
-        // Need to ignore camera roll, but retain existing pitch and heading.
-
-        lookAt(m_eye, m_eye + m_zAxis, WORLD_YAXIS);
-    }
-
-    m_behavior = behavior;
-}
-
-void Camera::setCurrentVelocity(const D3DXVECTOR3 &currentVelocity)
+void CameraBase::setCurrentVelocity(const D3DXVECTOR3 &currentVelocity)
 {
     m_currentVelocity = currentVelocity;
 }
 
-void Camera::setCurrentVelocity(float x, float y, float z)
+void CameraBase::setCurrentVelocity(float x, float y, float z)
 {
     m_currentVelocity.x = x;
     m_currentVelocity.y = y;
     m_currentVelocity.z = z;
 }
 
-void Camera::setPosition(const D3DXVECTOR3 &eye)
+void CameraBase::setDepthMode(DepthMode mode)
 {
-    m_eye = eye;
+    m_depthMode = mode;
 
-    updateViewMatrix(false);
+    // Rebuild the projection matrix if perspective() has already been called.
+    if (m_aspectRatio > 0.0f)
+        perspective(m_fovx, m_aspectRatio, m_znear, m_zfar);
 }
 
-void Camera::setPosition(float x, float y, float z)
+void CameraBase::setJitter(int sampleCount, int viewportWidth, int viewportHeight)
 {
-    m_eye.x = x;
-    m_eye.y = y;
-    m_eye.z = z;
+    // Jitters the projection by up to half a pixel in each direction,
+    // cycling through 'sampleCount' points. A sample count of 0 turns
+    // jittering off.
 
-    updateViewMatrix(false);
-}
+    m_jitterSampleCount = (sampleCount > 0) ? sampleCount : 0;
+    m_viewportWidth = viewportWidth;
+    m_viewportHeight = viewportHeight;
 
-void Camera::setRotationSpeed(float rotationSpeed)
-{
-    m_rotationSpeed = rotationSpeed;
+    updateJitter();
 }
 
-void Camera::setVelocity(const D3DXVECTOR3 &velocity)
+void CameraBase::setOrbitDistance(float distance)
 {
-    m_velocity = velocity;
+    // Like setOrbitTarget() this only takes effect the next time an orbit
+    // camera is moved or rotated.
+
+    m_orbitDistance = (distance < MIN_ORBIT_DISTANCE) ? MIN_ORBIT_DISTANCE : distance;
 }
 
-void Camera::setVelocity(float x, float y, float z)
+void CameraBase::setOrbitTarget(const D3DXVECTOR3 &target)
 {
-    m_velocity.x = x;
-    m_velocity.y = y;
-    m_velocity.z = z;
+    m_orbitTarget = target;
 }
 
-void Camera::rotateFirstPerson(float headingDegrees, float pitchDegrees)
+void CameraBase::setOrientation(const D3DXQUATERNION &orientation)
 {
-    m_accumPitchDegrees += pitchDegrees;
+    // The inverse of getOrientation(). The pitch angle is extracted from the
+    // new view direction so that first person mode continues to clamp the
+    // pitch correctly.
 
-    if (m_accumPitchDegrees > 90.0f)
-    {
-        pitchDegrees = 90.0f - (m_accumPitchDegrees - pitchDegrees);
-        m_accumPitchDegrees = 90.0f;
-    }
+    D3DXQUATERNION q;
+    D3DXMATRIX rotMtx;
 
-    if (m_accumPitchDegrees < -90.0f)
-    {
-        pitchDegrees = -90.0f - (m_accumPitchDegrees - pitchDegrees);
-        m_accumPitchDegrees = -90.0f;
-    }
+    D3DXQuaternionNormalize(&q, &orientation);
+    D3DXMatrixRotationQuaternion(&rotMtx, &q);
 
-    float heading = D3DXToRadian(headingDegrees);
-    float pitch = D3DXToRadian(pitchDegrees);
-    
-    D3DXMATRIX rotMtx;
-    D3DXVECTOR4 result;
+    m_xAxis = D3DXVECTOR3(rotMtx(0,0), rotMtx(0,1), rotMtx(0,2));
+    m_yAxis = D3DXVECTOR3(rotMtx(1,0), rotMtx(1,1), rotMtx(1,2));
+    m_zAxis = D3DXVECTOR3(rotMtx(2,0), rotMtx(2,1), rotMtx(2,2));
+    m_viewDir = m_zAxis;
 
-    // Rotate camera's existing x and z axes about the world y axis.
-    if (heading != 0.0f)
-    {
-        D3DXMatrixRotationY(&rotMtx, heading);
-        
-        D3DXVec3Transform(&result, &m_xAxis, &rotMtx);
-        m_xAxis = D3DXVECTOR3(result.x, result.y, result.z);
+    float sinPitch = m_zAxis.y;
 
-        D3DXVec3Transform(&result, &m_zAxis, &rotMtx);
-        m_zAxis = D3DXVECTOR3(result.x, result.y, result.z);
-    }
+    if (sinPitch > 1.0f)
+        sinPitch = 1.0f;
+    else if (sinPitch < -1.0f)
+        sinPitch = -1.0f;
 
-    // Rotate camera's existing y and z axes about its existing x axis.
-    if (pitch != 0.0f)
-    {
-        D3DXMatrixRotationAxis(&rotMtx, &m_xAxis, pitch);
-        
-        D3DXVec3Transform(&result, &m_yAxis, &rotMtx);
-        m_yAxis = D3DXVECTOR3(result.x, result.y, result.z);
-        
-        D3DXVec3Transform(&result, &m_zAxis, &rotMtx);
-        m_zAxis = D3DXVECTOR3(result.x, result.y, result.z);
-    }
+    m_accumPitchDegrees = D3DXToDegree(-asinf(sinPitch));
+
+    updateViewMatrix(false);
 }
 
-void Camera::rotateFlight(float headingDegrees, float pitchDegrees, float rollDegrees)
+void CameraBase::setOrigin(const WorldPosition &origin)
 {
-    float heading = D3DXToRadian(headingDegrees);
-    float pitch = D3DXToRadian(pitchDegrees);
-    float roll = D3DXToRadian(rollDegrees);
+    // Re-expresses the camera's position and orbit target relative to the
+    // new origin. Both are converted in double precision so that the camera
+    // stays exactly where it is.
 
-    D3DXMATRIX rotMtx;
-    D3DXVECTOR4 result;
+    m_eye = WorldOffset(m_origin + m_eye, origin);
+    m_orbitTarget = WorldOffset(m_origin + m_orbitTarget, origin);
+    m_origin = origin;
 
-    // Rotate camera's existing x and z axes about its existing y axis.
-    if (heading != 0.0f)
-    {
-        D3DXMatrixRotationAxis(&rotMtx, &m_yAxis, heading);
-        
-        D3DXVec3Transform(&result, &m_xAxis, &rotMtx);
-        m_xAxis = D3DXVECTOR3(result.x, result.y, result.z);
-        
-        D3DXVec3Transform(&result, &m_zAxis, &rotMtx);
-        m_zAxis = D3DXVECTOR3(result.x, result.y, result.z);
-    }
-
-    // Rotate camera's existing y and z axes about its existing x axis.
-    if (pitch != 0.0f)
-    {
-        D3DXMatrixRotationAxis(&rotMtx, &m_xAxis, pitch);
+    updateViewMatrix(false);
+}
 
-        D3DXVec3Transform(&result, &m_yAxis, &rotMtx);
-        m_yAxis = D3DXVECTOR3(result.x, result.y, result.z);
-        
-        D3DXVec3Transform(&result, &m_zAxis, &rotMtx);
-        m_zAxis = D3DXVECTOR3(result.x, result.y, result.z);
-    }
+void CameraBase::setPosition(const D3DXVECTOR3 &eye)
+{
+    m_eye = eye;
 
-    // Rotate camera's existing x and y axes about its existing z axis.
-    if (roll != 0.0f)
-    {
-        D3DXMatrixRotationAxis(&rotMtx, &m_zAxis, roll);
-        
-        D3DXVec3Transform(&result, &m_xAxis, &rotMtx);
-        m_xAxis = D3DXVECTOR3(result.x, result.y, result.z);
-        
-        D3DXVec3Transform(&result, &m_yAxis, &rotMtx);
-        m_yAxis = D3DXVECTOR3(result.x, result.y, result.z);
-    }
+    updateViewMatrix(false);
 }
 
-void Camera::updateVelocity(const D3DXVECTOR3 &direction, float elapsedTimeSec)
+void CameraBase::setPosition(float x, float y, float z)
 {
-    // Updates the camera's velocity based on the supplied movement direction
-    // and the elapsed time (since this method was last called). The movement
-    // direction is the in the range [-1,1].
-
-    if (direction.x != 0.0f)
-    {
-        // Camera is moving along the x axis.
-        // Linearly accelerate up to the camera's max speed.
+    m_eye.x = x;
+    m_eye.y = y;
+    m_eye.z = z;
 
-        m_currentVelocity.x += direction.x * m_acceleration.x * elapsedTimeSec;
+    updateViewMatrix(false);
+}
 
-        if (m_currentVelocity.x > m_velocity.x)
-            m_currentVelocity.x = m_velocity.x;
-        else if (m_currentVelocity.x < -m_velocity.x)
-            m_currentVelocity.x = -m_velocity.x;
-    }
-    else
-    {
-        // Camera is no longer moving along the x axis.
-        // Linearly decelerate back to stationary state.
+void CameraBase::setRotationSpeed(float rotationSpeed)
+{
+    m_rotationSpeed = rotationSpeed;
+}
 
-        if (m_currentVelocity.x > 0.0f)
-        {
-            if ((m_currentVelocity.x -= m_acceleration.x * elapsedTimeSec) < 0.0f)
-                m_currentVelocity.x = 0.0f;
-        }
-        else
-        {
-            if ((m_currentVelocity.x += m_acceleration.x * elapsedTimeSec) > 0.0f)
-                m_currentVelocity.x = 0.0f;
-        }
-    }
+void CameraBase::setVelocity(const D3DXVECTOR3 &velocity)
+{
+    m_velocity = velocity;
+}
 
-    if (direction.y != 0.0f)
-    {
-        // Camera is moving along the y axis.
-        // Linearly accelerate up to the camera's max speed.
+void CameraBase::setVelocity(float x, float y, float z)
+{
+    m_velocity.x = x;
+    m_velocity.y = y;
+    m_velocity.z = z;
+}
 
-        m_currentVelocity.y += direction.y * m_acceleration.y * elapsedTimeSec;
+void CameraBase::setWorldPosition(const WorldPosition &eye)
+{
+    m_eye = WorldOffset(eye, m_origin);
 
-        if (m_currentVelocity.y > m_velocity.y)
-            m_currentVelocity.y = m_velocity.y;
-        else if (m_currentVelocity.y < -m_velocity.y)
-            m_currentVelocity.y = -m_velocity.y;
-    }
-    else
-    {
-        // Camera is no longer moving along the y axis.
-        // Linearly decelerate back to stationary state.
+    updateViewMatrix(false);
+}
 
-        if (m_currentVelocity.y > 0.0f)
-        {
-            if ((m_currentVelocity.y -= m_acceleration.y * elapsedTimeSec) < 0.0f)
-                m_currentVelocity.y = 0.0f;
-        }
-        else
-        {
-            if ((m_currentVelocity.y += m_acceleration.y * elapsedTimeSec) > 0.0f)
-                m_currentVelocity.y = 0.0f;
-        }
-    }
+void CameraBase::updateJitter()
+{
+    // The jitter is in pixels. It goes into the projection matrix's (2,0)
+    // and (2,1) entries, which shift the image by a constant amount in
+    // normalized device coordinates after the divide by w. y is flipped as
+    // pixel rows go down the screen. The Halton sequence starts at 1 as its
+    // first element is 0.
 
-    if (direction.z != 0.0f)
+    if (m_jitterSampleCount > 0 && m_viewportWidth > 0 && m_viewportHeight > 0)
     {
-        // Camera is moving along the z axis.
-        // Linearly accelerate up to the camera's max speed.
+        int index = m_jitterIndex % m_jitterSampleCount + 1;
 
-        m_currentVelocity.z += direction.z * m_acceleration.z * elapsedTimeSec;
+        m_jitter.x = Halton(index, 2) - 0.5f;
+        m_jitter.y = Halton(index, 3) - 0.5f;
 
-        if (m_currentVelocity.z > m_velocity.z)
-            m_currentVelocity.z = m_velocity.z;
-        else if (m_currentVelocity.z < -m_velocity.z)
-            m_currentVelocity.z = -m_velocity.z;
+        m_projMatrix(2,0) = 2.0f * m_jitter.x / m_viewportWidth;
+        m_projMatrix(2,1) = -2.0f * m_jitter.y / m_viewportHeight;
     }
     else
     {
-        // Camera is no longer moving along the z axis.
-        // Linearly decelerate back to stationary state.
-
-        if (m_currentVelocity.z > 0.0f)
-        {
-            if ((m_currentVelocity.z -= m_acceleration.z * elapsedTimeSec) < 0.0f)
-                m_currentVelocity.z = 0.0f;
-        }
-        else
-        {
-            if ((m_currentVelocity.z += m_acceleration.z * elapsedTimeSec) > 0.0f)
-                m_currentVelocity.z = 0.0f;
-        }
+        m_jitter = D3DXVECTOR2(0.0f, 0.0f);
+        m_projMatrix(2,0) = 0.0f;
+        m_projMatrix(2,1) = 0.0f;
     }
 }
 
-void Camera::updateViewMatrix(bool orthogonalizeAxes)
+void CameraBase::updateVelocity(const D3DXVECTOR3 &direction, float elapsedTimeSec,
+                                D3DXVECTOR3 &displacement)
+{
+    // Updates the camera's velocity based on the supplied movement direction
+    // and the elapsed time (since this method was last called), and returns
+    // how far the camera moved in that time. The movement direction is in the
+    // range [-1,1].
+    //
+    // Along each axis the velocity heads linearly towards a target velocity
+    // and then stays there. When the camera is moving along an axis the target
+    // is the camera's max speed in that direction and the rate is the
+    // camera's acceleration scaled by the direction. When it isn't the target
+    // is 0 and the camera decelerates back to its stationary state at the
+    // full acceleration. With t' = min(t, time to reach the target) the exact
+    // solution is:
+    //
+    //  v(t) = v0 + rate * t'
+    //  x(t) = v0 * t' + rate * t'^2 / 2 + target * (t - t')
+    //
+    // All 3 axes are evaluated at once using SSE without any branches.
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+
+    __m128 dir = _mm_setr_ps(direction.x, direction.y, direction.z, 0.0f);
+    __m128 v0 = _mm_setr_ps(m_currentVelocity.x, m_currentVelocity.y, m_currentVelocity.z, 0.0f);
+    __m128 accel = _mm_setr_ps(m_acceleration.x, m_acceleration.y, m_acceleration.z, 0.0f);
+    __m128 maxSpeed = _mm_setr_ps(m_velocity.x, m_velocity.y, m_velocity.z, 0.0f);
+    __m128 t = _mm_set1_ps(elapsedTimeSec);
+
+    // Start off within the speed limit. It may have been lowered since the
+    // last call.
+    v0 = _mm_min_ps(_mm_max_ps(v0, _mm_sub_ps(zero, maxSpeed)), maxSpeed);
+
+    // target = moving ? sign(direction) * max speed : 0
+    // rate magnitude = moving ? |direction| * acceleration : acceleration
+    __m128 moving = _mm_cmpneq_ps(dir, zero);
+    __m128 target = _mm_and_ps(moving, _mm_or_ps(_mm_and_ps(dir, signMask), maxSpeed));
+    __m128 absDir = _mm_andnot_ps(signMask, dir);
+    __m128 rateMagnitude = _mm_mul_ps(accel, _mm_add_ps(absDir, _mm_andnot_ps(moving, one)));
+
+    // The rate points from the current velocity towards the target. The time
+    // to reach the target is huge rather than infinite for a zero rate.
+    __m128 deltaV = _mm_sub_ps(target, v0);
+    __m128 rate = _mm_or_ps(_mm_and_ps(deltaV, signMask), rateMagnitude);
+    __m128 timeToTarget = _mm_div_ps(_mm_andnot_ps(signMask, deltaV),
+        _mm_max_ps(rateMagnitude, _mm_set1_ps(FLT_MIN)));
+    __m128 reached = _mm_cmpge_ps(t, timeToTarget);
+    __m128 tc = _mm_min_ps(t, timeToTarget);
+
+    // Snap to the target once it's reached so that the camera comes to rest
+    // exactly rather than creeping around due to rounding errors.
+    __m128 v = _mm_add_ps(v0, _mm_mul_ps(rate, tc));
+    v = _mm_or_ps(_mm_and_ps(reached, target), _mm_andnot_ps(reached, v));
+
+    __m128 x = _mm_mul_ps(tc, _mm_add_ps(v0, _mm_mul_ps(_mm_mul_ps(half, rate), tc)));
+    x = _mm_add_ps(x, _mm_mul_ps(target, _mm_sub_ps(t, tc)));
+
+    float result[4];
+
+    _mm_storeu_ps(result, v);
+    m_currentVelocity = D3DXVECTOR3(result[0], result[1], result[2]);
+
+    _mm_storeu_ps(result, x);
+    displacement = D3DXVECTOR3(result[0], result[1], result[2]);
+}
+
+void CameraBase::updateViewMatrix(bool orthogonalizeAxes)
 {
     if (orthogonalizeAxes)
     {
@@ -562,4 +625,129 @@ void Camera::updateViewMatrix(bool orthogonalizeAxes)
     m_viewMatrix(1,3) = 0.0f;
     m_viewMatrix(2,3) = 0.0f;
     m_viewMatrix(3,3) = 1.0f;
+}
+
+//-----------------------------------------------------------------------------
+
+Camera::Camera()
+{
+    m_behavior = CAMERA_BEHAVIOR_FLIGHT;
+}
+
+Camera::~Camera()
+{
+}
+
+void Camera::move(float dx, float dy, float dz)
+{
+    // Moves the camera by dx world units to the left or right; dy
+    // world units upwards or downwards; and dz world units forwards
+    // or backwards.
+
+    switch (m_behavior)
+    {
+    default:
+        break;
+
+    case CAMERA_BEHAVIOR_FIRST_PERSON:
+        FirstPersonBehavior::move(*this, dx, dy, dz);
+        break;
+
+    case CAMERA_BEHAVIOR_FLIGHT:
+        FlightBehavior::move(*this, dx, dy, dz);
+        break;
+
+    case CAMERA_BEHAVIOR_ORBIT:
+        OrbitBehavior::move(*this, dx, dy, dz);
+        break;
+
+    case CAMERA_BEHAVIOR_FOLLOW:
+        FollowBehavior::move(*this, dx, dy, dz);
+        break;
+    }
+}
+
+void Camera::rotate(float headingDegrees, float pitchDegrees, float rollDegrees)
+{
+    // Rotates the camera based on its current behavior.
+    // Note that not all behaviors support rolling.
+
+    switch (m_behavior)
+    {
+    default:
+        break;
+
+    case CAMERA_BEHAVIOR_FIRST_PERSON:
+        FirstPersonBehavior::rotate(*this, headingDegrees, pitchDegrees, rollDegrees);
+        break;
+
+    case CAMERA_BEHAVIOR_FLIGHT:
+        FlightBehavior::rotate(*this, headingDegrees, pitchDegrees, rollDegrees);
+        break;
+
+    case CAMERA_BEHAVIOR_ORBIT:
+        OrbitBehavior::rotate(*this, headingDegrees, pitchDegrees, rollDegrees);
+        break;
+
+    case CAMERA_BEHAVIOR_FOLLOW:
+        FollowBehavior::rotate(*this, headingDegrees, pitchDegrees, rollDegrees);
+        break;
+    }
+}
+
+void Camera::rotateSmoothly(float headingDegrees, float pitchDegrees, float rollDegrees)
+{
+    // This method applies a scaling factor to the rotation angles prior to
+    // using these rotation angles to rotate the camera. This method is usually
+    // called when the camera is being rotated using an input device (such as a
+    // mouse or a joystick). 
+
+    headingDegrees *= m_rotationSpeed;
+    pitchDegrees *= m_rotationSpeed;
+    rollDegrees *= m_rotationSpeed;
+
+    rotate(headingDegrees, pitchDegrees, rollDegrees);
+}
+
+void Camera::updatePosition(const D3DXVECTOR3 &direction, float elapsedTimeSec)
+{
+    // Moves the camera using Newton's second law of motion. Unit mass is
+    // assumed here to somewhat simplify the calculations. The direction vector
+    // is in the range [-1,1].
+    //
+    // The motion is integrated exactly, so one call with a large elapsed time
+    // (e.g., after a stall) moves the camera just as far as many calls with
+    // small elapsed times would.
+
+    D3DXVECTOR3 displacement;
+
+    updateVelocity(direction, elapsedTimeSec, displacement);
+
+    // Only move the camera if it actually moved. Doing this guards against
+    // needlessly rebuilding the view matrix while the camera is at rest.
+
+    if (displacement.x != 0.0f || displacement.y != 0.0f || displacement.z != 0.0f)
+        move(displacement.x, displacement.y, displacement.z);
+}
+
+void Camera::setBehavior(CameraBehavior behavior)
+{
+    bool orbiting = m_behavior == CAMERA_BEHAVIOR_ORBIT || m_behavior == CAMERA_BEHAVIOR_FOLLOW;
+
+    if ((behavior == CAMERA_BEHAVIOR_ORBIT || behavior == CAMERA_BEHAVIOR_FOLLOW) && !orbiting)
+    {
+        // Moving to orbit or follow behavior. Orbit around the point the
+        // camera is looking at. Like first person behavior these have no roll.
+
+        lookAt(m_eye, m_eye + m_zAxis * m_orbitDistance, WORLD_YAXIS);
+    }
+    else if (m_behavior == CAMERA_BEHAVIOR_FLIGHT && behavior == CAMERA_BEHAVIOR_FIRST_PERSON)
+    {
+        // Moving from flight behavior to first person behavior.
+        // Need to ignore camera roll, but retain existing pitch and heading.
+
+        lookAt(m_eye, m_eye + m_zAxis * m_orbitDistance, WORLD_YAXIS);
+    }
+
+    m_behavior = behavior;
 }
\ No newline at end of file
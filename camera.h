@@ -24,98 +24,190 @@
 #define CAMERA_H
 
 #include     <d3dx9.h>
+#include     "world_position.h"
 
 //-----------------------------------------------------------------------------
 // A general purpose 6DoF (six degrees of freedom) vector based camera.
 //
-// This camera class supports 2 different behaviors:
-// first person mode and flight mode.
+// This camera supports 4 different behaviors:
+// first person mode, flight mode, orbit mode, and follow mode.
 //
 // First person mode only allows 5DOF (x axis movement, y axis movement, z axis
 // movement, yaw, and pitch) and movement is always parallel to the world x-z
 // (ground) plane.
 //
-// Flight mode supports 6DoF. This is the camera class' default behavior.
+// Flight mode supports 6DoF. This is the Camera class' default behavior.
 //
-// This camera class allows the camera to be moved in 2 ways: using fixed
-// step world units, and using a supplied velocity and acceleration. The former
-// simply moves the camera by the specified amount. To move the camera in this
-// way call one of the move() methods. The other way to move the camera
-// calculates the camera's displacement based on the supplied velocity,
-// acceleration, and elapsed time. To move the camera in this way call the
-// updatePosition() method.
+// Orbit mode keeps the camera at a fixed distance from a target point and
+// always looking at it. Heading and pitch swing the camera around the target
+// like first person mode does (there is no roll). Moving along the camera's x
+// and the world y axes pans the target, and moving along the camera's z axis
+// zooms in and out. lookAt() sets the orbit target and distance.
+//
+// Follow mode is orbit mode for a third person view of a moving subject. The
+// orbit target is the subject, so moving only zooms. The subject is usually
+// tracked with a CameraRig, which also turns the camera to stay behind it.
+//
+// The camera can be moved in 2 ways: using fixed step world units, and using
+// a supplied velocity and acceleration. The former simply moves the camera by
+// the specified amount. To move the camera in this way call one of the move()
+// methods. The other way to move the camera calculates the camera's
+// displacement based on the supplied velocity, acceleration, and elapsed time.
+// To move the camera in this way call the updatePosition() method.
+//
+// The projection matrix can map depth in one of four ways. The standard mode
+// maps the near plane to 0 and the far plane to 1. Reverse-Z swaps this
+// around so that the far plane maps to 0. Combined with a floating point
+// depth buffer the exponent of the float then cancels out the 1/z
+// distribution of the depth values, giving a nearly uniform relative
+// precision over the whole depth range. The infinite far plane modes push
+// the far plane out to infinity so that nothing is ever clipped by it.
+// Reverse-Z modes must clear depth to 0 and use a greater-equal depth test.
+//
+// For large worlds the camera's position is split into a double precision
+// origin and a float position relative to that origin. All of the camera's
+// float vectors and its view matrix are relative to the origin, so they keep
+// their precision as long as the origin is kept near the camera. By default
+// the origin is the world origin. For camera relative rendering set the
+// origin to the camera's own world position: the view matrix then contains
+// no translation at all, and objects are positioned with WorldOffset() from
+// getOrigin().
+//
+// For temporal techniques such as temporal anti-aliasing and motion blur the
+// camera keeps the previous frame's view-projection matrix. advanceFrame()
+// is called once per frame after the frame has been set up for rendering.
+// It saves the frame's view-projection matrix, which getPrevious...()
+// then returns during the next frame, and moves the projection's sub-pixel
+// jitter on to the next point of a Halton(2,3) sequence. Jittering is off
+// until setJitter() is called. motionVector() gives the screen space motion
+// of a point between the previous frame and the current one.
+//
+// The camera comes in two flavors. BasicCamera<Behavior> has its behavior
+// fixed at compile time: the behavior specific rotation and movement math is
+// inlined and no behavior is ever switched on. Use it when the behavior is
+// known in advance, such as in batched simulations. Camera selects one of the
+// same behavior policies at run time and can switch between them. Both share
+// everything that doesn't depend on the behavior through CameraBase.
 //-----------------------------------------------------------------------------
 
-class Camera
+class CameraBase
 {
 public:
     enum CameraBehavior
     {
         CAMERA_BEHAVIOR_FIRST_PERSON,
-        CAMERA_BEHAVIOR_FLIGHT
+        CAMERA_BEHAVIOR_FLIGHT,
+        CAMERA_BEHAVIOR_ORBIT,
+        CAMERA_BEHAVIOR_FOLLOW
     };
 
-    Camera();
-    ~Camera();
+    enum DepthMode
+    {
+        DEPTH_MODE_STANDARD = 0,
+        DEPTH_MODE_REVERSE_Z = 1,
+        DEPTH_MODE_INFINITE_FAR = 2,
+        DEPTH_MODE_REVERSE_Z_INFINITE_FAR = DEPTH_MODE_REVERSE_Z | DEPTH_MODE_INFINITE_FAR
+    };
+
+    static void depthProjection(DepthMode mode, float znear, float zfar,
+                                float &zScale, float &zOffset);
 
+    void advanceFrame();
+    void advanceFrame(const CameraBase &renderedCamera);
+    float linearizeDepth(float depth) const;
     void lookAt(const D3DXVECTOR3 &target);
     void lookAt(const D3DXVECTOR3 &eye, const D3DXVECTOR3 &target, const D3DXVECTOR3 &up);
-    void move(float dx, float dy, float dz);
+    D3DXVECTOR2 motionVector(const D3DXVECTOR3 &position, const D3DXVECTOR3 &previousPosition) const;
     void move(const D3DXVECTOR3 &direction, const D3DXVECTOR3 &amount);
+    void orbit(const D3DXVECTOR3 &target, float distance);
     void perspective(float fovx, float aspect, float znear, float zfar);
-    void rotate(float headingDegrees, float pitchDegrees, float rollDegrees);
-    void rotateSmoothly(float headingDegrees, float pitchDegrees, float rollDegrees);
-    void updatePosition(const D3DXVECTOR3 &direction, float elapsedTimeSec);
 
     // Getter methods.
 
     const D3DXVECTOR3 &getAcceleration() const;
-    CameraBehavior getBehavior() const;
     const D3DXVECTOR3 &getCurrentVelocity() const;
+    DepthMode getDepthMode() const;
+    const D3DXVECTOR2 &getJitter() const;
+    int getJitterSampleCount() const;
+    float getOrbitDistance() const;
+    const D3DXVECTOR3 &getOrbitTarget() const;
+    D3DXQUATERNION getOrientation() const;
+    const WorldPosition &getOrigin() const;
     const D3DXVECTOR3 &getPosition() const;
+    D3DXMATRIX getPreviousViewProjectionMatrix() const;
     float getRotationSpeed() const;
     const D3DXMATRIX &getProjectionMatrix() const;
+    D3DXMATRIX getUnjitteredViewProjectionMatrix() const;
     const D3DXVECTOR3 &getVelocity() const;
     const D3DXVECTOR3 &getViewDirection() const;
     const D3DXMATRIX &getViewMatrix() const;
+    WorldPosition getWorldPosition() const;
     const D3DXVECTOR3 &getXAxis() const;
     const D3DXVECTOR3 &getYAxis() const;
     const D3DXVECTOR3 &getZAxis() const;
+    float getZFar() const;
+    float getZNear() const;
     
     // Setter methods.
 
     void setAcceleration(const D3DXVECTOR3 &acceleration);
     void setAcceleration(float x, float y, float z);
-    void setBehavior(CameraBehavior behavior);
     void setCurrentVelocity(const D3DXVECTOR3 &currentVelocity);
     void setCurrentVelocity(float x, float y, float z);
+    void setDepthMode(DepthMode mode);
+    void setJitter(int sampleCount, int viewportWidth, int viewportHeight);
+    void setOrbitDistance(float distance);
+    void setOrbitTarget(const D3DXVECTOR3 &target);
+    void setOrientation(const D3DXQUATERNION &orientation);
+    void setOrigin(const WorldPosition &origin);
     void setPosition(const D3DXVECTOR3 &eye);
     void setPosition(float x, float y, float z);
     void setRotationSpeed(float rotationSpeed);
     void setVelocity(const D3DXVECTOR3 &velocity);
     void setVelocity(float x, float y, float z);
-        
-private:
-    void rotateFirstPerson(float headingDegrees, float pitchDegrees);
-    void rotateFlight(float headingDegrees, float pitchDegrees, float rollDegrees);
-    void updateVelocity(const D3DXVECTOR3 &direction, float elapsedTimeSec);
+    void setWorldPosition(const WorldPosition &eye);
+
+protected:
+    friend struct FirstPersonBehavior;
+    friend struct FlightBehavior;
+    friend struct FollowBehavior;
+    friend struct OrbitBehavior;
+
+    CameraBase();
+    ~CameraBase();
+
+    void updateVelocity(const D3DXVECTOR3 &direction, float elapsedTimeSec,
+                        D3DXVECTOR3 &displacement);
+    void updateJitter();
     void updateViewMatrix(bool orthogonalizeAxes);
     
+    static const float DEFAULT_ORBIT_DISTANCE;
     static const float DEFAULT_ROTATION_SPEED;
     static const float DEFAULT_FOVX;   
     static const float DEFAULT_ZFAR;
     static const float DEFAULT_ZNEAR;
+    static const float INFINITE_FAR_EPSILON;
+    static const float MIN_ORBIT_DISTANCE;
     static const D3DXVECTOR3 WORLD_XAXIS;
     static const D3DXVECTOR3 WORLD_YAXIS;
     static const D3DXVECTOR3 WORLD_ZAXIS;
 
-    CameraBehavior m_behavior;
+    DepthMode m_depthMode;
     float m_accumPitchDegrees;
     float m_rotationSpeed;
     float m_fovx;
     float m_aspectRatio;
     float m_znear;
     float m_zfar;
+    float m_orbitDistance;
+    int m_jitterSampleCount;
+    int m_jitterIndex;
+    int m_viewportWidth;
+    int m_viewportHeight;
+    bool m_hasPreviousFrame;
+    D3DXVECTOR2 m_jitter;
+    D3DXVECTOR3 m_orbitTarget;
+    WorldPosition m_origin;
     D3DXVECTOR3 m_eye;
     D3DXVECTOR3 m_xAxis;
     D3DXVECTOR3 m_yAxis;
@@ -126,44 +218,416 @@ private:
     D3DXVECTOR3 m_velocity;
     D3DXMATRIX m_viewMatrix;
     D3DXMATRIX m_projMatrix;
+    D3DXMATRIX m_prevViewProjMatrix;
+    WorldPosition m_prevOrigin;
 };
 
+//-----------------------------------------------------------------------------
+// Behavior policies. Each policy implements the behavior specific parts of
+// the camera as static functions operating on a CameraBase:
+//
+//  move(camera, dx, dy, dz)
+//      Moves the camera by dx world units to the left or right; dy world units
+//      upwards or downwards; and dz world units forwards or backwards.
+//
+//  rotate(camera, headingDegrees, pitchDegrees, rollDegrees)
+//      Rotates the camera. Not all behaviors support rolling.
+//
+// The camera follows the left-hand rotation rule. Angles are measured
+// clockwise when looking along the rotation axis toward the origin. Since the
+// z axis is pointing into the screen rolls are negated.
 //-----------------------------------------------------------------------------
 
-inline const D3DXVECTOR3 &Camera::getAcceleration() const
-{ return m_acceleration; }
+struct FirstPersonBehavior
+{
+    static const CameraBase::CameraBehavior BEHAVIOR = CameraBase::CAMERA_BEHAVIOR_FIRST_PERSON;
 
-inline Camera::CameraBehavior Camera::getBehavior() const
-{ return m_behavior; }
+    static void move(CameraBase &camera, float dx, float dy, float dz);
+    static void rotate(CameraBase &camera, float headingDegrees, float pitchDegrees, float rollDegrees);
+    static void rotateAxes(CameraBase &camera, float headingDegrees, float pitchDegrees);
+};
+
+struct FlightBehavior
+{
+    static const CameraBase::CameraBehavior BEHAVIOR = CameraBase::CAMERA_BEHAVIOR_FLIGHT;
+
+    static void move(CameraBase &camera, float dx, float dy, float dz);
+    static void rotate(CameraBase &camera, float headingDegrees, float pitchDegrees, float rollDegrees);
+};
+
+struct FollowBehavior
+{
+    static const CameraBase::CameraBehavior BEHAVIOR = CameraBase::CAMERA_BEHAVIOR_FOLLOW;
+
+    static void move(CameraBase &camera, float dx, float dy, float dz);
+    static void rotate(CameraBase &camera, float headingDegrees, float pitchDegrees, float rollDegrees);
+};
+
+struct OrbitBehavior
+{
+    static const CameraBase::CameraBehavior BEHAVIOR = CameraBase::CAMERA_BEHAVIOR_ORBIT;
+
+    static void move(CameraBase &camera, float dx, float dy, float dz);
+    static void rotate(CameraBase &camera, float headingDegrees, float pitchDegrees, float rollDegrees);
+    static void updateEye(CameraBase &camera);
+    static void zoom(CameraBase &camera, float dz);
+};
+
+//-----------------------------------------------------------------------------
+// A camera whose behavior is fixed at compile time by the Behavior policy.
+//-----------------------------------------------------------------------------
+
+template <typename Behavior>
+class BasicCamera : public CameraBase
+{
+public:
+    typedef Behavior BehaviorPolicy;
+
+    using CameraBase::move;
+
+    BasicCamera() {}
+    ~BasicCamera() {}
+
+    void move(float dx, float dy, float dz);
+    void rotate(float headingDegrees, float pitchDegrees, float rollDegrees);
+    void rotateSmoothly(float headingDegrees, float pitchDegrees, float rollDegrees);
+    void updatePosition(const D3DXVECTOR3 &direction, float elapsedTimeSec);
+
+    // Getter methods.
+
+    CameraBehavior getBehavior() const;
+};
+
+typedef BasicCamera<FirstPersonBehavior> FirstPersonCamera;
+typedef BasicCamera<FlightBehavior> FlightCamera;
+typedef BasicCamera<FollowBehavior> FollowCamera;
+typedef BasicCamera<OrbitBehavior> OrbitCamera;
+
+//-----------------------------------------------------------------------------
+// A camera whose behavior can be changed at run time. It dispatches to the
+// same behavior policies as BasicCamera.
+//-----------------------------------------------------------------------------
+
+class Camera : public CameraBase
+{
+public:
+    using CameraBase::move;
+
+    Camera();
+    ~Camera();
+
+    void move(float dx, float dy, float dz);
+    void rotate(float headingDegrees, float pitchDegrees, float rollDegrees);
+    void rotateSmoothly(float headingDegrees, float pitchDegrees, float rollDegrees);
+    void updatePosition(const D3DXVECTOR3 &direction, float elapsedTimeSec);
+
+    // Getter methods.
+
+    CameraBehavior getBehavior() const;
+
+    // Setter methods.
+
+    void setBehavior(CameraBehavior behavior);
+
+private:
+    CameraBehavior m_behavior;
+};
+
+//-----------------------------------------------------------------------------
+
+inline const D3DXVECTOR3 &CameraBase::getAcceleration() const
+{ return m_acceleration; }
 
-inline const D3DXVECTOR3 &Camera::getCurrentVelocity() const
+inline const D3DXVECTOR3 &CameraBase::getCurrentVelocity() const
 { return m_currentVelocity; }
 
-inline const D3DXVECTOR3 &Camera::getPosition() const
+inline CameraBase::DepthMode CameraBase::getDepthMode() const
+{ return m_depthMode; }
+
+inline const D3DXVECTOR2 &CameraBase::getJitter() const
+{ return m_jitter; }
+
+inline int CameraBase::getJitterSampleCount() const
+{ return m_jitterSampleCount; }
+
+inline float CameraBase::getOrbitDistance() const
+{ return m_orbitDistance; }
+
+inline const D3DXVECTOR3 &CameraBase::getOrbitTarget() const
+{ return m_orbitTarget; }
+
+inline const WorldPosition &CameraBase::getOrigin() const
+{ return m_origin; }
+
+inline const D3DXVECTOR3 &CameraBase::getPosition() const
 { return m_eye; }
 
-inline float Camera::getRotationSpeed() const
+inline float CameraBase::getRotationSpeed() const
 { return m_rotationSpeed; }
 
-inline const D3DXMATRIX &Camera::getProjectionMatrix() const
+inline const D3DXMATRIX &CameraBase::getProjectionMatrix() const
 { return m_projMatrix; }
 
-inline const D3DXVECTOR3 &Camera::getVelocity() const
+inline const D3DXVECTOR3 &CameraBase::getVelocity() const
 { return m_velocity; }
 
-inline const D3DXVECTOR3 &Camera::getViewDirection() const
+inline const D3DXVECTOR3 &CameraBase::getViewDirection() const
 { return m_viewDir; }
 
-inline const D3DXMATRIX &Camera::getViewMatrix() const
+inline const D3DXMATRIX &CameraBase::getViewMatrix() const
 { return m_viewMatrix; }
 
-inline const D3DXVECTOR3 &Camera::getXAxis() const
+inline WorldPosition CameraBase::getWorldPosition() const
+{ return m_origin + m_eye; }
+
+inline const D3DXVECTOR3 &CameraBase::getXAxis() const
 { return m_xAxis; }
 
-inline const D3DXVECTOR3 &Camera::getYAxis() const
+inline const D3DXVECTOR3 &CameraBase::getYAxis() const
 { return m_yAxis; }
 
-inline const D3DXVECTOR3 &Camera::getZAxis() const
+inline const D3DXVECTOR3 &CameraBase::getZAxis() const
 { return m_zAxis; }
 
+inline float CameraBase::getZFar() const
+{ return m_zfar; }
+
+inline float CameraBase::getZNear() const
+{ return m_znear; }
+
+//-----------------------------------------------------------------------------
+
+inline void FirstPersonBehavior::move(CameraBase &camera, float dx, float dy, float dz)
+{
+    // Calculate the forwards direction. Can't just use the camera's local z
+    // axis as doing so will cause the camera to move more slowly as the
+    // camera's view approaches 90 degrees straight up and down.
+
+    D3DXVECTOR3 forwards;
+
+    D3DXVec3Cross(&forwards, &camera.m_xAxis, &CameraBase::WORLD_YAXIS);
+    D3DXVec3Normalize(&forwards, &forwards);
+
+    camera.m_eye += camera.m_xAxis * dx;
+    camera.m_eye += CameraBase::WORLD_YAXIS * dy;
+    camera.m_eye += forwards * dz;
+
+    camera.updateViewMatrix(false);
+}
+
+inline void FirstPersonBehavior::rotate(CameraBase &camera, float headingDegrees,
+                                        float pitchDegrees, float)
+{
+    rotateAxes(camera, headingDegrees, pitchDegrees);
+    camera.updateViewMatrix(true);
+}
+
+inline void FirstPersonBehavior::rotateAxes(CameraBase &camera, float headingDegrees,
+                                            float pitchDegrees)
+{
+    camera.m_accumPitchDegrees += pitchDegrees;
+
+    if (camera.m_accumPitchDegrees > 90.0f)
+    {
+        pitchDegrees = 90.0f - (camera.m_accumPitchDegrees - pitchDegrees);
+        camera.m_accumPitchDegrees = 90.0f;
+    }
+
+    if (camera.m_accumPitchDegrees < -90.0f)
+    {
+        pitchDegrees = -90.0f - (camera.m_accumPitchDegrees - pitchDegrees);
+        camera.m_accumPitchDegrees = -90.0f;
+    }
+
+    float heading = D3DXToRadian(headingDegrees);
+    float pitch = D3DXToRadian(pitchDegrees);
+    
+    D3DXMATRIX rotMtx;
+    D3DXVECTOR4 result;
+
+    // Rotate camera's existing x and z axes about the world y axis.
+    if (heading != 0.0f)
+    {
+        D3DXMatrixRotationY(&rotMtx, heading);
+        
+        D3DXVec3Transform(&result, &camera.m_xAxis, &rotMtx);
+        camera.m_xAxis = D3DXVECTOR3(result.x, result.y, result.z);
+
+        D3DXVec3Transform(&result, &camera.m_zAxis, &rotMtx);
+        camera.m_zAxis = D3DXVECTOR3(result.x, result.y, result.z);
+    }
+
+    // Rotate camera's existing y and z axes about its existing x axis.
+    if (pitch != 0.0f)
+    {
+        D3DXMatrixRotationAxis(&rotMtx, &camera.m_xAxis, pitch);
+        
+        D3DXVec3Transform(&result, &camera.m_yAxis, &rotMtx);
+        camera.m_yAxis = D3DXVECTOR3(result.x, result.y, result.z);
+        
+        D3DXVec3Transform(&result, &camera.m_zAxis, &rotMtx);
+        camera.m_zAxis = D3DXVECTOR3(result.x, result.y, result.z);
+    }
+}
+
+inline void FlightBehavior::move(CameraBase &camera, float dx, float dy, float dz)
+{
+    camera.m_eye += camera.m_xAxis * dx;
+    camera.m_eye += CameraBase::WORLD_YAXIS * dy;
+    camera.m_eye += camera.m_viewDir * dz;
+
+    camera.updateViewMatrix(false);
+}
+
+inline void FlightBehavior::rotate(CameraBase &camera, float headingDegrees,
+                                   float pitchDegrees, float rollDegrees)
+{
+    float heading = D3DXToRadian(headingDegrees);
+    float pitch = D3DXToRadian(pitchDegrees);
+    float roll = D3DXToRadian(-rollDegrees);
+
+    D3DXMATRIX rotMtx;
+    D3DXVECTOR4 result;
+
+    // Rotate camera's existing x and z axes about its existing y axis.
+    if (heading != 0.0f)
+    {
+        D3DXMatrixRotationAxis(&rotMtx, &camera.m_yAxis, heading);
+        
+        D3DXVec3Transform(&result, &camera.m_xAxis, &rotMtx);
+        camera.m_xAxis = D3DXVECTOR3(result.x, result.y, result.z);
+        
+        D3DXVec3Transform(&result, &camera.m_zAxis, &rotMtx);
+        camera.m_zAxis = D3DXVECTOR3(result.x, result.y, result.z);
+    }
+
+    // Rotate camera's existing y and z axes about its existing x axis.
+    if (pitch != 0.0f)
+    {
+        D3DXMatrixRotationAxis(&rotMtx, &camera.m_xAxis, pitch);
+
+        D3DXVec3Transform(&result, &camera.m_yAxis, &rotMtx);
+        camera.m_yAxis = D3DXVECTOR3(result.x, result.y, result.z);
+        
+        D3DXVec3Transform(&result, &camera.m_zAxis, &rotMtx);
+        camera.m_zAxis = D3DXVECTOR3(result.x, result.y, result.z);
+    }
+
+    // Rotate camera's existing x and y axes about its existing z axis.
+    if (roll != 0.0f)
+    {
+        D3DXMatrixRotationAxis(&rotMtx, &camera.m_zAxis, roll);
+        
+        D3DXVec3Transform(&result, &camera.m_xAxis, &rotMtx);
+        camera.m_xAxis = D3DXVECTOR3(result.x, result.y, result.z);
+        
+        D3DXVec3Transform(&result, &camera.m_yAxis, &rotMtx);
+        camera.m_yAxis = D3DXVECTOR3(result.x, result.y, result.z);
+    }
+
+    camera.updateViewMatrix(true);
+}
+
+inline void FollowBehavior::move(CameraBase &camera, float, float, float dz)
+{
+    // The subject decides where the target is. Only zooming is left.
+
+    OrbitBehavior::zoom(camera, dz);
+    OrbitBehavior::updateEye(camera);
+    camera.updateViewMatrix(false);
+}
+
+inline void FollowBehavior::rotate(CameraBase &camera, float headingDegrees,
+                                   float pitchDegrees, float rollDegrees)
+{
+    OrbitBehavior::rotate(camera, headingDegrees, pitchDegrees, rollDegrees);
+}
+
+inline void OrbitBehavior::move(CameraBase &camera, float dx, float dy, float dz)
+{
+    // Panning moves the target along with the camera.
+
+    camera.m_orbitTarget += camera.m_xAxis * dx;
+    camera.m_orbitTarget += CameraBase::WORLD_YAXIS * dy;
+
+    zoom(camera, dz);
+    updateEye(camera);
+    camera.updateViewMatrix(false);
+}
+
+inline void OrbitBehavior::rotate(CameraBase &camera, float headingDegrees,
+                                  float pitchDegrees, float)
+{
+    // Turn exactly like first person mode and then place the camera behind
+    // the target along the new view direction.
+
+    FirstPersonBehavior::rotateAxes(camera, headingDegrees, pitchDegrees);
+    D3DXVec3Normalize(&camera.m_zAxis, &camera.m_zAxis);
+    updateEye(camera);
+    camera.updateViewMatrix(true);
+}
+
+inline void OrbitBehavior::updateEye(CameraBase &camera)
+{
+    camera.m_eye = camera.m_orbitTarget - camera.m_zAxis * camera.m_orbitDistance;
+}
+
+inline void OrbitBehavior::zoom(CameraBase &camera, float dz)
+{
+    // Zooming never moves the camera onto or past the target.
+
+    camera.m_orbitDistance -= dz;
+
+    if (camera.m_orbitDistance < CameraBase::MIN_ORBIT_DISTANCE)
+        camera.m_orbitDistance = CameraBase::MIN_ORBIT_DISTANCE;
+}
+
+//-----------------------------------------------------------------------------
+
+template <typename Behavior>
+inline void BasicCamera<Behavior>::move(float dx, float dy, float dz)
+{
+    Behavior::move(*this, dx, dy, dz);
+}
+
+template <typename Behavior>
+inline void BasicCamera<Behavior>::rotate(float headingDegrees, float pitchDegrees, float rollDegrees)
+{
+    Behavior::rotate(*this, headingDegrees, pitchDegrees, rollDegrees);
+}
+
+template <typename Behavior>
+inline void BasicCamera<Behavior>::rotateSmoothly(float headingDegrees, float pitchDegrees, float rollDegrees)
+{
+    // This method applies a scaling factor to the rotation angles prior to
+    // using these rotation angles to rotate the camera. This method is usually
+    // called when the camera is being rotated using an input device (such as a
+    // mouse or a joystick). 
+
+    Behavior::rotate(*this, headingDegrees * m_rotationSpeed,
+        pitchDegrees * m_rotationSpeed, rollDegrees * m_rotationSpeed);
+}
+
+template <typename Behavior>
+inline void BasicCamera<Behavior>::updatePosition(const D3DXVECTOR3 &direction, float elapsedTimeSec)
+{
+    // See Camera::updatePosition().
+
+    D3DXVECTOR3 displacement;
+
+    updateVelocity(direction, elapsedTimeSec, displacement);
+
+    if (displacement.x != 0.0f || displacement.y != 0.0f || displacement.z != 0.0f)
+        Behavior::move(*this, displacement.x, displacement.y, displacement.z);
+}
+
+template <typename Behavior>
+inline CameraBase::CameraBehavior BasicCamera<Behavior>::getBehavior() const
+{ return Behavior::BEHAVIOR; }
+
+//-----------------------------------------------------------------------------
+
+inline Camera::CameraBehavior Camera::getBehavior() const
+{ return m_behavior; }
+
 #endif
\ No newline at end of file
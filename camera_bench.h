@@ -0,0 +1,70 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(CAMERA_BENCH_H)
+#define CAMERA_BENCH_H
+
+#include "camera.h"
+
+//-----------------------------------------------------------------------------
+// The headless tests and benchmarks run by the camera_bench console program
+// (see camera_bench_main.cpp). None of them needs a window or a device. Each
+// one writes a report to the standard output and returns the program's exit
+// code: 0 if the run passed (benchmarks always pass unless they fail to set
+// up), 1 otherwise.
+//-----------------------------------------------------------------------------
+
+// Cameras (camera_bench_camera.cpp).
+
+int RunCameraPolicyBenchmark(int updateCount);
+int RunCameraRigTest(int updateCount);
+int RunCameraSetBenchmark(int sphereCount, Camera::DepthMode depthMode);
+int RunCameraTrackBenchmark(int seconds);
+int RunDepthPrecisionTest(int zfar);
+int RunIntegratorTest(int testCaseCount);
+int RunWorldPrecisionTest(int poseCount);
+
+// Input (camera_bench_input.cpp).
+
+int RunActionMapTest(int frameCount);
+int RunInputEventTest(int seconds);
+int RunKeyboardBenchmark(int frameCount);
+int RunMouseFilterBenchmark(int seconds);
+int RunPredictionTest(const char *pszFilename);
+int RunRawMouseBenchmark(int seconds);
+int RunSyntheticInputRecorder(const char *pszFilename);
+
+// Rendering and the job system (camera_bench_render.cpp). A job thread count
+// of -1 uses one thread per processor.
+
+int RunDeferredBenchmark(int lightCount, int jobThreadCount, bool pinJobThreads);
+int RunHudBenchmark(int frameCount);
+int RunJobBenchmark(int jobCount, int jobThreadCount, bool pinJobThreads);
+int RunMaterialBenchmark(int materialCount);
+int RunNormalMapBaker(int size, int jobThreadCount, bool pinJobThreads);
+int RunOcclusionBenchmark(int citySize, int jobThreadCount, bool pinJobThreads);
+int RunPipelineBenchmark(int frameCount, int jobThreadCount, bool pinJobThreads);
+int RunShaderStartupBenchmark(int runCount);
+int RunShadowBenchmark(int lightCount, int jobThreadCount, bool pinJobThreads);
+int RunTemporalResolveTest(int frameCount);
+
+#endif
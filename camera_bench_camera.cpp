@@ -0,0 +1,1489 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <d3dx9.h>
+
+#include "app_camera.h"
+#include "camera.h"
+#include "camera_bench.h"
+#include "camera_controller.h"
+#include "camera_rig.h"
+#include "camera_set.h"
+#include "camera_track.h"
+#include "text_buffer.h"
+#include "timer.h"
+
+namespace
+{
+    // The same tolerances the application compresses recorded tracks with.
+    const float       CAMERA_TRACK_ANGLE_TOLERANCE = 0.25f;
+    const float       CAMERA_TRACK_POSITION_TOLERANCE = 0.01f;
+    const float       CAMERA_TRACK_BENCHMARK_SPEED = 20.0f;
+    const float       CAMERA_TRACK_BENCHMARK_SAMPLE_RATE = 60.0f;
+    const int         CAMERA_TRACK_BENCHMARK_EVALUATIONS = 1000000;
+    const char        CAMERA_TRACK_BENCHMARK_FILENAME[] = "camera_track_benchmark.ctk";
+
+    const int         CAMERA_SET_BENCHMARK_CAMERAS = 16;
+    const int         CAMERA_SET_BENCHMARK_UPDATES = 100000;
+    const float       CAMERA_SET_BENCHMARK_RANGE = 100.0f;
+    const float       CAMERA_SET_BENCHMARK_CULL_MARGIN = 1e-3f;
+    const float       CAMERA_SET_BENCHMARK_MAX_MATRIX_ERROR = 1e-5f;
+
+    const float       CAMERA_POLICY_BENCHMARK_FRAME_TIME = 1.0f / 60.0f;
+    const int         CAMERA_POLICY_BENCHMARK_RUNS = 3;
+
+    const int         DEPTH_PRECISION_SAMPLES_PER_DECADE = 1000;
+    const float       DEPTH_PRECISION_MAX_REVERSE_Z_ERROR = 1e-5f;
+
+    const float       INTEGRATOR_TEST_MAX_STEP = 2.0f;
+    const double      INTEGRATOR_TEST_REFERENCE_STEP = 1e-5;
+    const float       INTEGRATOR_TEST_SUBSTEP = 0.001f;
+    const float       INTEGRATOR_TEST_MAX_ERROR = 1e-4f;
+
+    const double      WORLD_PRECISION_MIN_OFFSET = 1e3;
+    const int         WORLD_PRECISION_DECADES = 5;
+    const int         WORLD_PRECISION_POINTS = 16;
+    const float       WORLD_PRECISION_MAX_ERROR = 1e-3f;
+    const float       WORLD_PRECISION_SCREEN_WIDTH = 1280.0f;
+    const float       WORLD_PRECISION_SCREEN_HEIGHT = 720.0f;
+    const float       WORLD_PRECISION_MAX_DEPTH = 90.0f;
+    const float       WORLD_PRECISION_BOUNDS_SIZE = 20.0f;
+    const float       WORLD_PRECISION_BOUNDS_HEIGHT = 10.0f;
+
+    const float       CAMERA_RIG_TEST_FRAME_TIMES[] = {0.001f, 0.016f, 1.0f};
+    const int         CAMERA_RIG_TEST_FRAME_TIME_COUNT = 3;
+    const float       CAMERA_RIG_TEST_SECONDS = 5.0f;
+    const float       CAMERA_RIG_TEST_TURN = 170.0f;
+    const float       CAMERA_RIG_TEST_MAX_OVERSHOOT = 1e-4f;
+    const float       CAMERA_RIG_TEST_MAX_ERROR = 1e-3f;
+    const float       CAMERA_RIG_TEST_MAX_HEADING_ERROR = 0.01f;
+    const float       CAMERA_RIG_BENCHMARK_FRAME_TIME = 1.0f / 60.0f;
+    const int         CAMERA_RIG_BENCHMARK_OBSTACLES = 64;
+
+    struct CameraRigTestResult
+    {
+        D3DXVECTOR3 eye;
+        float maxOvershoot;
+        float targetError;
+        float distanceError;
+        float headingError;
+    };
+
+    struct IntegratorTestCase
+    {
+        D3DXVECTOR3 acceleration;
+        D3DXVECTOR3 direction;
+        D3DXVECTOR3 maxSpeed;
+        D3DXVECTOR3 velocity;
+        float time;
+    };
+
+    float CameraHeading(const CameraBase &camera)
+    {
+        // The camera's heading the way CameraRig measures it.
+
+        const D3DXVECTOR3 &xAxis = camera.getXAxis();
+        return D3DXToDegree(atan2f(-xAxis.z, xAxis.x));
+    }
+
+    void CullSpheresPerView(const CameraSet &cameraSet, const D3DXVECTOR3 *pCenters,
+                            const float *pRadii, int count, unsigned int *pViewMasks,
+                            float margin, unsigned int *pAmbiguousMasks)
+    {
+        // Reference for CameraSet::cull() used by RunCameraSetBenchmark(). Tests
+        // every sphere against every plane of every view one at a time, without
+        // the combined bounds. The planes are extracted from each view's view-
+        // projection matrix every call. Spheres within margin of touching one
+        // of a view's planes are also flagged in pAmbiguousMasks since rounding
+        // can go either way for them.
+
+        for (int i = 0; i < count; ++i)
+        {
+            pViewMasks[i] = 0;
+            pAmbiguousMasks[i] = 0;
+        }
+
+        for (int v = 0; v < cameraSet.getViewCount(); ++v)
+        {
+            const D3DXMATRIX &m = cameraSet.getView(v).viewProjectionMatrix;
+            D3DXPLANE planes[6];
+
+            for (int j = 0; j < 6; ++j)
+            {
+                int column = (j < 4) ? j / 2 : 2;
+                float sign = (j % 2 == 0) ? 1.0f : -1.0f;
+                float w = (j == 4) ? 0.0f : 1.0f;
+                D3DXPLANE &plane = planes[j];
+
+                plane.a = w * m(0,3) + sign * m(0,column);
+                plane.b = w * m(1,3) + sign * m(1,column);
+                plane.c = w * m(2,3) + sign * m(2,column);
+                plane.d = w * m(3,3) + sign * m(3,column);
+
+                float length = sqrtf(plane.a * plane.a + plane.b * plane.b + plane.c * plane.c);
+
+                // An infinite far plane has no normal. Everything is inside it.
+                if (length > 1e-6f * fabsf(plane.d))
+                    plane /= length;
+                else
+                    plane = D3DXPLANE(0.0f, 0.0f, 0.0f, 1.0f);
+            }
+
+            for (int i = 0; i < count; ++i)
+            {
+                bool inside = true;
+                bool nearPlane = false;
+
+                for (int j = 0; j < 6; ++j)
+                {
+                    float distance = D3DXPlaneDotCoord(&planes[j], &pCenters[i]) + pRadii[i];
+
+                    if (fabsf(distance) <= margin)
+                        nearPlane = true;
+
+                    if (distance < 0.0f)
+                        inside = false;
+                }
+
+                if (inside)
+                    pViewMasks[i] |= 1U << v;
+
+                if (nearPlane)
+                    pAmbiguousMasks[i] |= 1U << v;
+            }
+        }
+    }
+
+    void IntegrateCameraMotion(const IntegratorTestCase &testCase, double step,
+                               D3DXVECTOR3 &displacement, D3DXVECTOR3 &velocity)
+    {
+        // Reference for the camera's closed form integrator. Steps each axis's
+        // velocity towards its target in double precision, step seconds at a
+        // time, and sums the distance covered with the trapezoidal rule. Only
+        // the step in which the velocity reaches its target isn't exact.
+
+        int stepCount = static_cast<int>(ceil(testCase.time / step));
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            double direction = testCase.direction[axis];
+            double maxSpeed = testCase.maxSpeed[axis];
+            double acceleration = testCase.acceleration[axis];
+            double v = (std::min)((std::max)(static_cast<double>(testCase.velocity[axis]), -maxSpeed), maxSpeed);
+            double x = 0.0;
+            double target = 0.0;
+            double rate = acceleration;
+
+            if (direction != 0.0)
+            {
+                target = (direction > 0.0) ? maxSpeed : -maxSpeed;
+                rate = fabs(direction) * acceleration;
+            }
+
+            for (int i = 0; i < stepCount; ++i)
+            {
+                double dt = (i < stepCount - 1) ? step : testCase.time - step * i;
+                double vNext = (v < target) ? (std::min)(v + rate * dt, target) : (std::max)(v - rate * dt, target);
+
+                x += 0.5 * (v + vNext) * dt;
+                v = vNext;
+            }
+
+            displacement[axis] = static_cast<float>(x);
+            velocity[axis] = static_cast<float>(v);
+        }
+    }
+
+    float WrapDegrees(float degrees)
+    {
+        // Wraps an angle into the range [-180,180).
+
+        return degrees - 360.0f * floorf((degrees + 180.0f) / 360.0f);
+    }
+
+    void StepCameraRig(bool follow, float frameTime, CameraRigTestResult &result)
+    {
+        // Used by RunCameraRigTest(). Starts an orbit or follow camera at
+        // rest, jumps its goal to a new target and distance (and turns the
+        // subject around in follow mode), and steps the rig frameTime seconds
+        // at a time for CAMERA_RIG_TEST_SECONDS. The progress along each jump
+        // runs from 0 to 1. Going past 1 or backwards is an overshoot.
+
+        const D3DXVECTOR3 startTarget(0.0f, 1.0f, 0.0f);
+        const D3DXVECTOR3 endTarget(10.0f, 1.0f, -4.0f);
+        const float startDistance = 5.0f;
+        const float endDistance = 12.0f;
+
+        Camera camera;
+        CameraRig rig;
+
+        camera.setBehavior(follow ? Camera::CAMERA_BEHAVIOR_FOLLOW : Camera::CAMERA_BEHAVIOR_ORBIT);
+        camera.lookAt(D3DXVECTOR3(0.0f, 4.0f, -4.0f), startTarget, D3DXVECTOR3(0.0f, 1.0f, 0.0f));
+        rig.reset(camera);
+
+        float startHeading = CameraHeading(camera);
+        float endHeading = startHeading + CAMERA_RIG_TEST_TURN;
+
+        if (follow)
+            rig.setSubject(endTarget - D3DXVECTOR3(0.0f, rig.getFollowHeight(), 0.0f), endHeading);
+        else
+            camera.setOrbitTarget(endTarget);
+
+        camera.setOrbitDistance(endDistance);
+
+        D3DXVECTOR3 jump = endTarget - startTarget;
+        float jumpLengthSq = D3DXVec3LengthSq(&jump);
+        float lastProgress[3] = {0.0f, 0.0f, 0.0f};
+        int stepCount = static_cast<int>(CAMERA_RIG_TEST_SECONDS / frameTime + 0.5f);
+
+        result.maxOvershoot = 0.0f;
+
+        for (int i = 0; i < stepCount; ++i)
+        {
+            rig.update(frameTime, camera);
+
+            D3DXVECTOR3 moved = rig.getTarget() - startTarget;
+            float progress[3];
+
+            progress[0] = D3DXVec3Dot(&moved, &jump) / jumpLengthSq;
+            progress[1] = (rig.getDistance() - startDistance) / (endDistance - startDistance);
+            progress[2] = follow ? WrapDegrees(CameraHeading(camera) - startHeading) / CAMERA_RIG_TEST_TURN : 1.0f;
+
+            for (int j = 0; j < 3; ++j)
+            {
+                result.maxOvershoot = (std::max)(result.maxOvershoot, progress[j] - 1.0f);
+                result.maxOvershoot = (std::max)(result.maxOvershoot, lastProgress[j] - progress[j]);
+                lastProgress[j] = progress[j];
+            }
+        }
+
+        D3DXVECTOR3 targetError = rig.getTarget() - endTarget;
+
+        result.eye = camera.getPosition();
+        result.targetError = D3DXVec3Length(&targetError);
+        result.distanceError = fabsf(rig.getDistance() - endDistance);
+        result.headingError = follow ? fabsf(WrapDegrees(CameraHeading(camera) - endHeading)) : 0.0f;
+    }
+
+    void MeasureWorldPrecision(const Camera &camera, const WorldPosition &sceneOrigin,
+                               const WorldPosition &eye, const D3DXVECTOR3 *pPoints, int count,
+                               float &maxPositionError, float &maxPixelError)
+    {
+        // Used by RunWorldPrecisionTest(). Transforms points given relative
+        // to the scene's origin the way the application draws the floor: a
+        // world matrix moves the scene to the camera's origin, followed by
+        // the camera's view and projection matrices, all in float. Compares
+        // the view space positions and the pixels they land on with the
+        // same transforms done in double precision from the exact eye.
+
+        const D3DXMATRIX &projection = camera.getProjectionMatrix();
+        const D3DXVECTOR3 *pAxes[3] = {&camera.getXAxis(), &camera.getYAxis(), &camera.getZAxis()};
+        D3DXVECTOR3 sceneOffset = WorldOffset(sceneOrigin, camera.getOrigin());
+        D3DXMATRIX world;
+        D3DXMATRIX worldView;
+        D3DXMATRIX worldViewProjection;
+
+        D3DXMatrixTranslation(&world, sceneOffset.x, sceneOffset.y, sceneOffset.z);
+        D3DXMatrixMultiply(&worldView, &world, &camera.getViewMatrix());
+        D3DXMatrixMultiply(&worldViewProjection, &worldView, &projection);
+
+        for (int i = 0; i < count; ++i)
+        {
+            D3DXVECTOR4 view;
+            D3DXVECTOR4 clip;
+            double offset[3];
+            double reference[4];
+            double referenceClip[4];
+
+            D3DXVec3Transform(&view, &pPoints[i], &worldView);
+            D3DXVec3Transform(&clip, &pPoints[i], &worldViewProjection);
+
+            offset[0] = sceneOrigin.x + pPoints[i].x - eye.x;
+            offset[1] = sceneOrigin.y + pPoints[i].y - eye.y;
+            offset[2] = sceneOrigin.z + pPoints[i].z - eye.z;
+
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                const D3DXVECTOR3 &a = *pAxes[axis];
+                reference[axis] = offset[0] * a.x + offset[1] * a.y + offset[2] * a.z;
+            }
+
+            reference[3] = 1.0;
+
+            for (int column = 0; column < 4; ++column)
+            {
+                referenceClip[column] = 0.0;
+
+                for (int row = 0; row < 4; ++row)
+                    referenceClip[column] += reference[row] * projection(row, column);
+            }
+
+            double dx = view.x - reference[0];
+            double dy = view.y - reference[1];
+            double dz = view.z - reference[2];
+            double px = (clip.x / clip.w - referenceClip[0] / referenceClip[3]) * 0.5 * WORLD_PRECISION_SCREEN_WIDTH;
+            double py = (clip.y / clip.w - referenceClip[1] / referenceClip[3]) * 0.5 * WORLD_PRECISION_SCREEN_HEIGHT;
+
+            maxPositionError = (std::max)(maxPositionError, static_cast<float>(sqrt(dx * dx + dy * dy + dz * dz)));
+            maxPixelError = (std::max)(maxPixelError, static_cast<float>(sqrt(px * px + py * py)));
+        }
+    }
+
+    template <typename CameraType>
+    double TimeCameraUpdates(const CameraController &controller,
+                             const std::vector<CameraInput> &inputs, CameraType &camera)
+    {
+        // Used by RunCameraPolicyBenchmark(). Returns the time in seconds it
+        // takes to feed the inputs to the camera.
+
+        double startTime = GetTimeInSeconds();
+
+        for (size_t i = 0; i < inputs.size(); ++i)
+            controller.update(inputs[i], CAMERA_POLICY_BENCHMARK_FRAME_TIME, camera);
+
+        return GetTimeInSeconds() - startTime;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Tests and benchmarks.
+//-----------------------------------------------------------------------------
+
+int RunCameraPolicyBenchmark(int updateCount)
+{
+    // For each behavior policy feeds the same updateCount random camera
+    // inputs through the camera controller to a BasicCamera with that policy
+    // and to a Camera switched to the same behavior, and reports the cost
+    // per update of each. Both start from the same state, and since Camera
+    // dispatches to the same policies they must end up with exactly the same
+    // view matrix. Each camera is timed CAMERA_POLICY_BENCHMARK_RUNS times
+    // and the best run is kept.
+
+    std::vector<CameraInput> inputs(updateCount);
+    float direction[3] = {0.0f, 0.0f, 0.0f};
+    unsigned int random = 24680;
+
+    for (int i = 0; i < updateCount; ++i)
+    {
+        CameraInput &input = inputs[i];
+        float r[4];
+
+        for (int j = 0; j < 4; ++j)
+        {
+            random = random * 1664525 + 1013904223;
+            r[j] = (random >> 8) / 16777216.0f;
+        }
+
+        // Change one movement axis every 30 updates or so. Starting to move
+        // along an axis resets the velocity along it.
+
+        input.started = 0;
+
+        if (r[0] < 1.0f / 30.0f)
+        {
+            int axis = static_cast<int>(r[1] * 3.0f) % 3;
+            float value = floorf(r[2] * 3.0f) - 1.0f;
+
+            if (direction[axis] == 0.0f && value != 0.0f)
+                input.started = CameraInput::STARTED_X << axis;
+
+            direction[axis] = value;
+        }
+
+        input.direction = D3DXVECTOR3(direction[0], direction[1], direction[2]);
+        input.mouseX = 10.0f * r[3] - 5.0f;
+        input.mouseY = 5.0f * r[1] - 2.5f;
+    }
+
+    static const Camera::CameraBehavior behaviors[] =
+    {
+        Camera::CAMERA_BEHAVIOR_FIRST_PERSON,
+        Camera::CAMERA_BEHAVIOR_FLIGHT,
+        Camera::CAMERA_BEHAVIOR_ORBIT,
+        Camera::CAMERA_BEHAVIOR_FOLLOW
+    };
+
+    static const char *behaviorNames[] =
+    {
+        "First person", "Flight", "Orbit", "Follow"
+    };
+
+    CameraController controller;
+    TextBuffer text;
+    bool passed = true;
+
+    controller.setFlightYawSpeed(CAMERA_SPEED_FLIGHT_YAW);
+
+    text.append("Updates: ").append(updateCount).newline();
+
+    for (int b = 0; b < 4; ++b)
+    {
+        Camera start;
+
+        start.setPosition(CAMERA_POS);
+        start.setAcceleration(CAMERA_ACCELERATION);
+        start.setVelocity(CAMERA_VELOCITY);
+        start.setRotationSpeed(CAMERA_SPEED_ROTATION);
+        start.setBehavior(behaviors[b]);
+
+        Camera camera;
+        FirstPersonCamera firstPersonCamera;
+        FlightCamera flightCamera;
+        OrbitCamera orbitCamera;
+        FollowCamera followCamera;
+        CameraBase *pPolicyCamera = 0;
+        double policySec = DBL_MAX;
+        double switchSec = DBL_MAX;
+
+        for (int run = 0; run < CAMERA_POLICY_BENCHMARK_RUNS; ++run)
+        {
+            // Start both cameras from the same state. Assigning the base
+            // copies everything but the behavior.
+
+            double sec = 0.0;
+
+            switch (behaviors[b])
+            {
+            case Camera::CAMERA_BEHAVIOR_FIRST_PERSON:
+                static_cast<CameraBase &>(firstPersonCamera) = start;
+                sec = TimeCameraUpdates(controller, inputs, firstPersonCamera);
+                pPolicyCamera = &firstPersonCamera;
+                break;
+
+            case Camera::CAMERA_BEHAVIOR_FLIGHT:
+                static_cast<CameraBase &>(flightCamera) = start;
+                sec = TimeCameraUpdates(controller, inputs, flightCamera);
+                pPolicyCamera = &flightCamera;
+                break;
+
+            case Camera::CAMERA_BEHAVIOR_ORBIT:
+                static_cast<CameraBase &>(orbitCamera) = start;
+                sec = TimeCameraUpdates(controller, inputs, orbitCamera);
+                pPolicyCamera = &orbitCamera;
+                break;
+
+            case Camera::CAMERA_BEHAVIOR_FOLLOW:
+                static_cast<CameraBase &>(followCamera) = start;
+                sec = TimeCameraUpdates(controller, inputs, followCamera);
+                pPolicyCamera = &followCamera;
+                break;
+            }
+
+            policySec = (std::min)(policySec, sec);
+
+            camera = start;
+            switchSec = (std::min)(switchSec, TimeCameraUpdates(controller, inputs, camera));
+        }
+
+        const D3DXMATRIX &policyView = pPolicyCamera->getViewMatrix();
+        const D3DXMATRIX &switchView = camera.getViewMatrix();
+        bool matched = true;
+
+        for (int j = 0; j < 16; ++j)
+        {
+            if (policyView(j / 4, j % 4) != switchView(j / 4, j % 4))
+                matched = false;
+        }
+
+        float policyNs = static_cast<float>(policySec * 1e9 / (std::max)(updateCount, 1));
+        float switchNs = static_cast<float>(switchSec * 1e9 / (std::max)(updateCount, 1));
+
+        text.newline();
+        text.append(behaviorNames[b]).newline();
+        text.append("  BasicCamera: ").append(policyNs, 1).append(" ns/update").newline();
+        text.append("  Camera: ").append(switchNs, 1).append(" ns/update").newline();
+        text.append("  Speedup: ").append(switchNs / (std::max)(policyNs, 0.001f), 2).append("x").newline();
+        text.append("  View matrices: ").append(matched ? "match" : "DIFFER").newline();
+
+        passed = passed && matched;
+    }
+
+    text.newline();
+    text.append(passed ? "PASSED" : "FAILED").newline();
+
+    fputs(text.c_str(), stdout);
+    fflush(stdout);
+    return passed ? 0 : 1;
+}
+
+int RunCameraRigTest(int updateCount)
+{
+    // Steps orbit and follow cameras' rigs through a sudden jump of the
+    // target and distance (and a turn of the follow subject) with 1, 16 and
+    // 1000 ms frames, see StepCameraRig(). The rigs must never overshoot,
+    // must settle within CAMERA_RIG_TEST_MAX_ERROR units and
+    // CAMERA_RIG_TEST_MAX_HEADING_ERROR degrees of the goal, and must end up
+    // in the same place whatever the frame time. Then times updateCount
+    // rig updates of a follow camera chasing the application's follow
+    // subject without obstacles and with CAMERA_RIG_BENCHMARK_OBSTACLES
+    // random boxes around its path, and checks that the camera never ends
+    // up inside one.
+
+    TextBuffer text;
+    bool passed = true;
+
+    for (int mode = 0; mode < 2; ++mode)
+    {
+        CameraRigTestResult results[CAMERA_RIG_TEST_FRAME_TIME_COUNT];
+
+        for (int i = 0; i < CAMERA_RIG_TEST_FRAME_TIME_COUNT; ++i)
+        {
+            CameraRigTestResult &result = results[i];
+            D3DXVECTOR3 drift;
+
+            StepCameraRig(mode == 1, CAMERA_RIG_TEST_FRAME_TIMES[i], result);
+            drift = result.eye - results[0].eye;
+
+            passed = passed && result.maxOvershoot <= CAMERA_RIG_TEST_MAX_OVERSHOOT
+                && result.targetError <= CAMERA_RIG_TEST_MAX_ERROR
+                && result.distanceError <= CAMERA_RIG_TEST_MAX_ERROR
+                && result.headingError <= CAMERA_RIG_TEST_MAX_HEADING_ERROR
+                && D3DXVec3Length(&drift) <= CAMERA_RIG_TEST_MAX_ERROR;
+
+            text.append((mode == 0) ? "Orbit, " : "Follow, ");
+            text.append(CAMERA_RIG_TEST_FRAME_TIMES[i] * 1000.0f, 0).append(" ms frames").newline();
+            text.append("Overshoot: ").append(result.maxOvershoot * 100.0f, 4).append("%").newline();
+            text.append("Target error: ").append(result.targetError * 1000.0f, 3).append(" mm").newline();
+            text.append("Distance error: ").append(result.distanceError * 1000.0f, 3).append(" mm").newline();
+
+            if (mode == 1)
+                text.append("Heading error: ").append(result.headingError, 4).append(" degrees").newline();
+
+            text.append("Eye drift from 1 ms frames: ").append(D3DXVec3Length(&drift) * 1000.0f, 3).append(" mm").newline();
+            text.newline();
+        }
+    }
+
+    std::vector<D3DXVECTOR3> boxMins(CAMERA_RIG_BENCHMARK_OBSTACLES);
+    std::vector<D3DXVECTOR3> boxMaxs(CAMERA_RIG_BENCHMARK_OBSTACLES);
+    unsigned int random = 24680;
+
+    for (int i = 0; i < CAMERA_RIG_BENCHMARK_OBSTACLES; ++i)
+    {
+        // Boxes inside the subject's circle and in the ring outside it that
+        // the camera trails through, clear of the subject's path.
+
+        float r[4];
+
+        for (int j = 0; j < 4; ++j)
+        {
+            random = random * 1664525 + 1013904223;
+            r[j] = (random >> 8) / 16777216.0f;
+        }
+
+        float angle = 2.0f * D3DX_PI * r[0];
+        float radius = (r[1] < 0.5f) ? FOLLOW_SUBJECT_RADIUS * r[1] : FOLLOW_SUBJECT_RADIUS * (0.95f + 0.5f * r[1]);
+        float halfSize = 0.25f + 0.5f * r[2];
+        D3DXVECTOR3 center(radius * sinf(angle), 0.0f, radius * cosf(angle));
+        D3DXVECTOR3 halfExtent(halfSize, 1.0f + 4.0f * r[3], halfSize);
+
+        boxMins[i] = center - halfExtent;
+        boxMaxs[i] = center + halfExtent;
+    }
+
+    // Start the camera behind the subject, since obstacles around the
+    // target are ignored.
+
+    D3DXVECTOR3 startEye;
+    D3DXVECTOR3 startTarget;
+    D3DXVECTOR3 subjectPosition;
+    float subjectHeading;
+    double runSec[2] = {0.0, 0.0};
+    int blockedCount = 0;
+    int insideCount = 0;
+
+    GetFollowSubject(0.0f, subjectPosition, subjectHeading);
+    startTarget = subjectPosition + D3DXVECTOR3(0.0f, CameraRig().getFollowHeight(), 0.0f);
+    startEye = startTarget + D3DXVECTOR3(4.0f, 3.0f, 0.0f);
+
+    for (int run = 0; run < 2; ++run)
+    {
+        Camera camera;
+        CameraRig rig;
+
+        camera.setBehavior(Camera::CAMERA_BEHAVIOR_FOLLOW);
+        camera.lookAt(startEye, startTarget, D3DXVECTOR3(0.0f, 1.0f, 0.0f));
+        rig.reset(camera);
+
+        if (run == 1)
+            rig.setObstacles(&boxMins[0], &boxMaxs[0], CAMERA_RIG_BENCHMARK_OBSTACLES);
+
+        double startTime = GetTimeInSeconds();
+
+        for (int i = 0; i < updateCount; ++i)
+        {
+            GetFollowSubject(i * CAMERA_RIG_BENCHMARK_FRAME_TIME, subjectPosition, subjectHeading);
+            rig.setSubject(subjectPosition, subjectHeading);
+            rig.update(CAMERA_RIG_BENCHMARK_FRAME_TIME, camera);
+        }
+
+        runSec[run] = GetTimeInSeconds() - startTime;
+
+        if (run == 1)
+        {
+            // Check the run again, this time outside the timed loop.
+
+            camera.lookAt(startEye, startTarget, D3DXVECTOR3(0.0f, 1.0f, 0.0f));
+            rig.reset(camera);
+
+            for (int i = 0; i < updateCount; ++i)
+            {
+                GetFollowSubject(i * CAMERA_RIG_BENCHMARK_FRAME_TIME, subjectPosition, subjectHeading);
+                rig.setSubject(subjectPosition, subjectHeading);
+                rig.update(CAMERA_RIG_BENCHMARK_FRAME_TIME, camera);
+
+                const D3DXVECTOR3 &eye = camera.getPosition();
+
+                if (rig.getDistance() < camera.getOrbitDistance() - CAMERA_RIG_TEST_MAX_ERROR)
+                    ++blockedCount;
+
+                for (int j = 0; j < CAMERA_RIG_BENCHMARK_OBSTACLES; ++j)
+                {
+                    if (eye.x > boxMins[j].x && eye.x < boxMaxs[j].x
+                        && eye.y > boxMins[j].y && eye.y < boxMaxs[j].y
+                        && eye.z > boxMins[j].z && eye.z < boxMaxs[j].z)
+                    {
+                        ++insideCount;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    passed = passed && insideCount == 0;
+
+    text.append("Follow updates: ").append(updateCount).newline();
+    text.append("Time per update: ").append(static_cast<float>(runSec[0] * 1e9 / updateCount), 1).append(" ns").newline();
+    text.append("Time per update with ").append(CAMERA_RIG_BENCHMARK_OBSTACLES).append(" obstacles: ");
+    text.append(static_cast<float>(runSec[1] * 1e9 / updateCount), 1).append(" ns").newline();
+    text.append("Updates pulled in by an obstacle: ").append(blockedCount).newline();
+    text.append("Updates inside an obstacle: ").append(insideCount).newline();
+    text.newline();
+    text.append(passed ? "PASSED" : "FAILED").newline();
+
+    fputs(text.c_str(), stdout);
+    fflush(stdout);
+    return passed ? 0 : 1;
+}
+
+int RunCameraSetBenchmark(int sphereCount, Camera::DepthMode depthMode)
+{
+    // For each camera set layout times updating the views' matrices
+    // CAMERA_SET_BENCHMARK_UPDATES times, and culling sphereCount random
+    // spheres around the camera against all of the views with
+    // CameraSet::cull() and with CullSpheresPerView(). The view-projection
+    // matrices must match D3DXMatrixMultiply() and the culling results must
+    // match the reference for every sphere that isn't touching a frustum
+    // plane, apart from spheres the combined bounds reject.
+
+    Camera cameras[CAMERA_SET_BENCHMARK_CAMERAS];
+    std::vector<D3DXVECTOR3> centers(sphereCount);
+    std::vector<float> radii(sphereCount);
+    std::vector<unsigned int> masks(sphereCount);
+    std::vector<unsigned int> referenceMasks(sphereCount);
+    std::vector<unsigned int> ambiguousMasks(sphereCount);
+    unsigned int random = 13579;
+
+    for (int i = 0; i < CAMERA_SET_BENCHMARK_CAMERAS; ++i)
+    {
+        float heading = 360.0f * i / CAMERA_SET_BENCHMARK_CAMERAS;
+        float pitch = 30.0f * sinf(static_cast<float>(i));
+
+        cameras[i].setDepthMode(depthMode);
+        cameras[i].perspective(CAMERA_FOVX, 16.0f / 9.0f, CAMERA_ZNEAR, CAMERA_ZFAR);
+        cameras[i].setPosition(CAMERA_POS);
+        cameras[i].rotate(heading, pitch, 0.0f);
+    }
+
+    for (int i = 0; i < sphereCount; ++i)
+    {
+        float r[4];
+
+        for (int j = 0; j < 4; ++j)
+        {
+            random = random * 1664525 + 1013904223;
+            r[j] = (random >> 8) / 16777216.0f;
+        }
+
+        centers[i] = CAMERA_POS + CAMERA_SET_BENCHMARK_RANGE * D3DXVECTOR3(2.0f * r[0] - 1.0f,
+            2.0f * r[1] - 1.0f, 2.0f * r[2] - 1.0f);
+        radii[i] = 0.5f + 4.5f * r[3];
+    }
+
+    TextBuffer text;
+    bool passed = true;
+
+    text.append("Spheres: ").append(sphereCount).newline();
+    text.append("Updates: ").append(CAMERA_SET_BENCHMARK_UPDATES).newline();
+
+    for (int layout = 0; layout < CameraSet::LAYOUT_COUNT; ++layout)
+    {
+        static const char *layoutNames[CameraSet::LAYOUT_COUNT] =
+        {
+            "Single", "Stereo", "Split screen", "Cube map"
+        };
+
+        CameraSet cameraSet;
+
+        cameraSet.setLayout(static_cast<CameraSet::Layout>(layout));
+
+        double startTime = GetTimeInSeconds();
+
+        for (int i = 0; i < CAMERA_SET_BENCHMARK_UPDATES; ++i)
+            cameraSet.update(cameras[i % CAMERA_SET_BENCHMARK_CAMERAS]);
+
+        double updateSec = GetTimeInSeconds() - startTime;
+        int viewCount = cameraSet.getViewCount();
+
+        // Check the matrices and cull with every camera.
+
+        float maxMatrixError = 0.0f;
+        double cullSec = 0.0;
+        double referenceSec = 0.0;
+        int mismatches = 0;
+        int ambiguous = 0;
+        int boundsRejected = 0;
+        int visible = 0;
+
+        for (int c = 0; c < CAMERA_SET_BENCHMARK_CAMERAS; ++c)
+        {
+            cameraSet.update(cameras[c]);
+
+            for (int v = 0; v < viewCount; ++v)
+            {
+                const CameraView &view = cameraSet.getView(v);
+                D3DXMATRIX viewProj;
+
+                D3DXMatrixMultiply(&viewProj, &view.viewMatrix, &view.projectionMatrix);
+
+                for (int j = 0; j < 16; ++j)
+                {
+                    float expected = viewProj(j / 4, j % 4);
+                    float error = fabsf(view.viewProjectionMatrix(j / 4, j % 4) - expected) / (std::max)(fabsf(expected), 1.0f);
+
+                    maxMatrixError = (std::max)(maxMatrixError, error);
+                }
+            }
+
+            int count = sphereCount;
+
+            startTime = GetTimeInSeconds();
+            cameraSet.cull(&centers[0], &radii[0], count, &masks[0]);
+            cullSec += GetTimeInSeconds() - startTime;
+
+            startTime = GetTimeInSeconds();
+            CullSpheresPerView(cameraSet, &centers[0], &radii[0], count, &referenceMasks[0],
+                CAMERA_SET_BENCHMARK_CULL_MARGIN, &ambiguousMasks[0]);
+            referenceSec += GetTimeInSeconds() - startTime;
+
+            // Spheres touching a plane are allowed to differ. The plane
+            // tests let through spheres that are outside of a frustum near
+            // its corners. The combined bounds reject some of these, and
+            // those spheres may only be culled when they are outside of the
+            // bounds.
+
+            const D3DXVECTOR3 &boundsMin = cameraSet.getBoundsMin();
+            const D3DXVECTOR3 &boundsMax = cameraSet.getBoundsMax();
+
+            for (int i = 0; i < count; ++i)
+            {
+                const D3DXVECTOR3 &center = centers[i];
+                unsigned int differences = (masks[i] ^ referenceMasks[i]) & ~ambiguousMasks[i];
+                bool outsideBounds = center.x + radii[i] < boundsMin.x || center.x - radii[i] > boundsMax.x
+                    || center.y + radii[i] < boundsMin.y || center.y - radii[i] > boundsMax.y
+                    || center.z + radii[i] < boundsMin.z || center.z - radii[i] > boundsMax.z;
+
+                for (int v = 0; v < viewCount; ++v)
+                    visible += (masks[i] >> v) & 1;
+
+                if (outsideBounds)
+                    ++boundsRejected;
+
+                if (ambiguousMasks[i] != 0)
+                    ++ambiguous;
+
+                if ((differences & masks[i]) || (differences && !outsideBounds))
+                    ++mismatches;
+            }
+        }
+
+        if (maxMatrixError > CAMERA_SET_BENCHMARK_MAX_MATRIX_ERROR || mismatches > 0)
+            passed = false;
+
+        double tests = static_cast<double>(sphereCount) * CAMERA_SET_BENCHMARK_CAMERAS;
+        double nsPerUpdate = updateSec * 1e9 / CAMERA_SET_BENCHMARK_UPDATES;
+
+        text.newline();
+        text.append(layoutNames[layout]).append(" (").append(viewCount).append(viewCount == 1 ? " view)" : " views)").newline();
+        text.append("  Update: ").append(static_cast<float>(nsPerUpdate), 1).append(" ns, ")
+            .append(static_cast<float>(nsPerUpdate / viewCount), 1).append(" ns/view").newline();
+        text.append("  Max matrix error: ").append(maxMatrixError * 1e6f, 3).append(" ppm").newline();
+        text.append("  Cull: ").append(static_cast<float>(cullSec * 1e9 / (std::max)(tests, 1.0)), 2).append(" ns/sphere").newline();
+        text.append("  Cull per view and plane: ").append(static_cast<float>(referenceSec * 1e9 / (std::max)(tests, 1.0)), 2).append(" ns/sphere").newline();
+        text.append("  Rejected by the combined bounds: ")
+            .append(static_cast<float>(100.0 * boundsRejected / (std::max)(tests, 1.0)), 1).append("%").newline();
+        text.append("  Visible per view: ")
+            .append(static_cast<float>(100.0 * visible / (std::max)(tests * viewCount, 1.0)), 1).append("%").newline();
+        text.append("  Mismatches: ").append(mismatches).append(" (").append(ambiguous).append(" spheres touching a plane)").newline();
+    }
+
+    text.newline();
+    text.append(passed ? "PASSED" : "FAILED").newline();
+
+    fputs(text.c_str(), stdout);
+    fflush(stdout);
+    return passed ? 0 : 1;
+}
+
+int RunCameraTrackBenchmark(int seconds)
+{
+    // Records a flight of the given number of seconds along a long winding
+    // path at CAMERA_TRACK_BENCHMARK_SPEED units/sec and compresses it twice:
+    // once with the positions quantized per block and once relative to the
+    // bounding box of the whole track, which is how tracks used to be
+    // compressed. The longer the track the coarser the whole track
+    // quantization gets.
+
+    Camera camera;
+    CameraTrack track;
+    TextBuffer text;
+    float duration = static_cast<float>(seconds);
+    int sampleCount = static_cast<int>(duration * CAMERA_TRACK_BENCHMARK_SAMPLE_RATE) + 1;
+    const D3DXVECTOR3 up(0.0f, 1.0f, 0.0f);
+
+    for (int i = 0; i < sampleCount; ++i)
+    {
+        // The camera looks half a second ahead along the path.
+
+        float time = i / CAMERA_TRACK_BENCHMARK_SAMPLE_RATE;
+        D3DXVECTOR3 eye;
+        D3DXVECTOR3 target;
+
+        for (int j = 0; j < 2; ++j)
+        {
+            float t = time + j * 0.5f;
+            D3DXVECTOR3 &position = (j == 0) ? eye : target;
+
+            position.x = CAMERA_TRACK_BENCHMARK_SPEED * t;
+            position.y = 5.0f + 2.0f * sinf(0.5f * t);
+            position.z = 40.0f * sinf(0.2f * t) + 300.0f * sinf(0.01f * t);
+        }
+
+        camera.lookAt(eye, target, up);
+        track.record(time, camera);
+    }
+
+    text.append("Seconds: ").append(seconds).newline();
+    text.append("Samples: ").append(track.sampleCount()).newline();
+
+    bool passed = true;
+
+    for (int run = 0; run < 2; ++run)
+    {
+        float blockDuration = (run == 0) ? CameraTrack::BLOCK_DURATION : 0.0f;
+        double startTime = GetTimeInSeconds();
+
+        track.compress(CAMERA_TRACK_POSITION_TOLERANCE, CAMERA_TRACK_ANGLE_TOLERANCE, blockDuration);
+
+        double compressSec = GetTimeInSeconds() - startTime;
+        float positionError = 0.0f;
+        float angleError = 0.0f;
+
+        track.measureError(positionError, angleError);
+
+        // Playback in order, as when flying the track, and at random times.
+
+        float endTime = track.endTime();
+        float checksum = 0.0f;
+        D3DXVECTOR3 position;
+        D3DXQUATERNION orientation;
+        unsigned int random = 8642;
+
+        startTime = GetTimeInSeconds();
+
+        for (int i = 0; i < CAMERA_TRACK_BENCHMARK_EVALUATIONS; ++i)
+        {
+            track.evaluate(endTime * i / CAMERA_TRACK_BENCHMARK_EVALUATIONS, position, orientation);
+            checksum += position.x;
+        }
+
+        double sequentialSec = GetTimeInSeconds() - startTime;
+
+        startTime = GetTimeInSeconds();
+
+        for (int i = 0; i < CAMERA_TRACK_BENCHMARK_EVALUATIONS; ++i)
+        {
+            random = random * 1664525 + 1013904223;
+            track.evaluate(endTime * (random >> 8) / 16777216.0f, position, orientation);
+            checksum += position.x;
+        }
+
+        double randomSec = GetTimeInSeconds() - startTime;
+
+        // Loading includes decoding the keyframes and setting up the
+        // interpolation. The file stays in the file system cache.
+
+        CameraTrack loaded;
+        double loadSec = 0.0;
+        bool loadedOk = track.save(CAMERA_TRACK_BENCHMARK_FILENAME);
+
+        if (loadedOk)
+        {
+            startTime = GetTimeInSeconds();
+            loadedOk = loaded.load(CAMERA_TRACK_BENCHMARK_FILENAME);
+            loadSec = GetTimeInSeconds() - startTime;
+            remove(CAMERA_TRACK_BENCHMARK_FILENAME);
+        }
+
+        loadedOk = loadedOk && loaded.keyCount() == track.keyCount()
+            && loaded.blockCount() == track.blockCount();
+
+        // The per block errors must stay close to the tolerances. The
+        // reduction keeps the path within them of the quantized samples,
+        // which are within half a quantization step of the recording.
+
+        if (!loadedOk || (run == 0 && (positionError > 2.0f * CAMERA_TRACK_POSITION_TOLERANCE
+                                       || angleError > 2.0f * CAMERA_TRACK_ANGLE_TOLERANCE)))
+        {
+            passed = false;
+        }
+
+        double nsPerEvaluation = 1e9 / CAMERA_TRACK_BENCHMARK_EVALUATIONS;
+
+        text.newline();
+        text.append(run == 0 ? "Per block quantization (" : "Whole track quantization (");
+        text.append(track.blockCount()).append(track.blockCount() == 1 ? " block)" : " blocks)").newline();
+        text.append("Keyframes: ").append(track.keyCount()).newline();
+        text.append("Size: ").append(track.compressedSize()).append(" bytes, ")
+            .append(static_cast<float>(track.compressedSize() / (std::max)(duration, 1.0f)), 1).append(" bytes/sec").newline();
+        text.append("Max position error: ").append(positionError, 4).newline();
+        text.append("Max angle error: ").append(angleError, 3).append(" degrees").newline();
+        text.append("Compress: ").append(static_cast<float>(compressSec * 1000.0), 1).append(" ms").newline();
+        text.append("Load: ").append(static_cast<float>(loadSec * 1000.0), 3).append(" ms").append(loadedOk ? "" : " (failed)").newline();
+        text.append("Evaluate in order: ").append(static_cast<float>(sequentialSec * nsPerEvaluation), 1).append(" ns").newline();
+        text.append("Evaluate at random: ").append(static_cast<float>(randomSec * nsPerEvaluation), 1).append(" ns").newline();
+
+        if (checksum == 0.0f)
+            text.append("Checksum: 0").newline();
+    }
+
+    text.newline();
+    text.append(passed ? "PASSED" : "FAILED").newline();
+
+    fputs(text.c_str(), stdout);
+    fflush(stdout);
+    return passed ? 0 : 1;
+}
+
+int RunDepthPrecisionTest(int zfar)
+{
+    // Projects distances spaced evenly on a log scale from CAMERA_ZNEAR out
+    // to zfar with each depth mode the way the GPU does (in single precision,
+    // the far plane of the finite modes at zfar) and stores them in a D24 and
+    // in a D32F depth buffer. For each stored depth the distance to the next
+    // representable depth further away is the smallest change in distance
+    // the depth buffer can resolve there.
+    //
+    // With a float depth buffer the reverse-Z modes must keep every
+    // distance apart and in order, and must resolve, and linearizeDepth()
+    // must recover, every distance to within DEPTH_PRECISION_MAX_REVERSE_Z_ERROR
+    // of the distance. The other modes are only reported.
+
+    static const char *modeNames[4] =
+    {
+        "Standard", "Reverse-Z", "Infinite far plane", "Reverse-Z, infinite far plane"
+    };
+
+    static const double D24_MAX = 16777215.0;
+
+    float farPlane = static_cast<float>(zfar);
+    int decades = static_cast<int>(ceil(log10(farPlane / CAMERA_ZNEAR) - 0.001));
+    TextBuffer text;
+    bool passed = true;
+
+    text.append("Near plane: ").append(CAMERA_ZNEAR, 2).newline();
+    text.append("Far plane: ").append(zfar).newline();
+    text.append("Samples per decade: ").append(DEPTH_PRECISION_SAMPLES_PER_DECADE).newline();
+    text.append("Resolution in parts per million of the distance").newline();
+
+    for (int mode = 0; mode < 4; ++mode)
+    {
+        Camera::DepthMode depthMode = static_cast<Camera::DepthMode>(mode);
+        bool reverseZ = (depthMode & Camera::DEPTH_MODE_REVERSE_Z) != 0;
+        float zScale = 0.0f;
+        float zOffset = 0.0f;
+        Camera camera;
+
+        Camera::depthProjection(depthMode, CAMERA_ZNEAR, farPlane, zScale, zOffset);
+        camera.setDepthMode(depthMode);
+        camera.perspective(CAMERA_FOVX, 1.0f, CAMERA_ZNEAR, farPlane);
+
+        int previousD24 = reverseZ ? INT_MAX : -1;
+        float previousD32 = reverseZ ? FLT_MAX : -FLT_MAX;
+        int equalD24 = 0;
+        int equalD32 = 0;
+        int orderErrors = 0;
+        double maxLinearizeError = 0.0;
+
+        text.newline().append(modeNames[mode]).newline();
+
+        for (int decade = 0; decade < decades; ++decade)
+        {
+            double maxErrorD24 = 0.0;
+            double maxErrorD32 = 0.0;
+
+            for (int i = 0; i < DEPTH_PRECISION_SAMPLES_PER_DECADE; ++i)
+            {
+                double exponent = decade + static_cast<double>(i) / DEPTH_PRECISION_SAMPLES_PER_DECADE;
+                float z = static_cast<float>(CAMERA_ZNEAR * pow(10.0, exponent));
+
+                if (z > farPlane)
+                    break;
+
+                float depth = (std::min)((std::max)((z * zScale + zOffset) / z, 0.0f), 1.0f);
+
+                // The neighboring depth further away, or nearer at the end
+                // of the depth range. Depths decrease with distance in the
+                // reverse-Z modes. A neighbor that maps to an infinite
+                // distance resolves nothing: the error is the distance.
+
+                int d24 = static_cast<int>(depth * D24_MAX + 0.5);
+                int stepD24 = reverseZ ? -1 : 1;
+                int stepD32 = stepD24;
+                unsigned int bits = 0;
+                float nextD32 = 0.0f;
+
+                if (d24 + stepD24 < 0 || d24 + stepD24 > 0xffffff)
+                    stepD24 = -stepD24;
+
+                if (depth == (reverseZ ? 0.0f : 1.0f))
+                    stepD32 = -stepD32;
+
+                memcpy(&bits, &depth, sizeof(bits));
+                bits += stepD32;
+                memcpy(&nextD32, &bits, sizeof(nextD32));
+
+                for (int format = 0; format < 2; ++format)
+                {
+                    double stored = (format == 0) ? d24 / D24_MAX : depth;
+                    double next = (format == 0) ? (d24 + stepD24) / D24_MAX : nextD32;
+                    double storedZ = zOffset / (stored - zScale);
+                    double nextZ = zOffset / (next - zScale);
+                    double error = fabs(nextZ - storedZ) / z;
+
+                    if (!(error < 1.0))
+                        error = 1.0;
+
+                    double &maxError = (format == 0) ? maxErrorD24 : maxErrorD32;
+                    maxError = (std::max)(maxError, error);
+                }
+
+                if (d24 == previousD24)
+                    ++equalD24;
+                else if (reverseZ ? (d24 > previousD24) : (d24 < previousD24))
+                    ++orderErrors;
+
+                if (depth == previousD32)
+                    ++equalD32;
+                else if (reverseZ ? (depth > previousD32) : (depth < previousD32))
+                    ++orderErrors;
+
+                previousD24 = d24;
+                previousD32 = depth;
+
+                double linearizeError = fabs(camera.linearizeDepth(depth) - z) / z;
+                maxLinearizeError = (std::max)(maxLinearizeError, linearizeError);
+
+                if (reverseZ && maxErrorD32 > DEPTH_PRECISION_MAX_REVERSE_Z_ERROR)
+                    passed = false;
+            }
+
+            float rangeStart = static_cast<float>(CAMERA_ZNEAR * pow(10.0, decade));
+            float rangeEnd = (std::min)(rangeStart * 10.0f, farPlane);
+
+            text.append("  ").append(rangeStart, 1).append(" to ").append(rangeEnd, 1).append(": D24 ")
+                .append(static_cast<float>(maxErrorD24 * 1e6), 2).append(", D32F ")
+                .append(static_cast<float>(maxErrorD32 * 1e6), 2).newline();
+        }
+
+        text.append("  Equal depths: D24 ").append(equalD24).append(", D32F ").append(equalD32).newline();
+        text.append("  Order errors: ").append(orderErrors).newline();
+        text.append("  linearizeDepth() error: ").append(static_cast<float>(maxLinearizeError * 1e6), 2).newline();
+
+        if (reverseZ && (orderErrors > 0 || equalD32 > 0
+                         || maxLinearizeError > DEPTH_PRECISION_MAX_REVERSE_Z_ERROR))
+        {
+            passed = false;
+        }
+    }
+
+    text.newline();
+    text.append(passed ? "PASSED" : "FAILED").newline();
+
+    fputs(text.c_str(), stdout);
+    fflush(stdout);
+    return passed ? 0 : 1;
+}
+
+int RunIntegratorTest(int testCaseCount)
+{
+    // Moves a camera through testCaseCount random time steps of up to
+    // INTEGRATOR_TEST_MAX_STEP seconds each, starting from random velocities
+    // (some above the speed limit) with random movement directions,
+    // accelerations and speed limits. Each step is taken with a single
+    // Camera::updatePosition() call and is compared against
+    // IntegrateCameraMotion() stepping INTEGRATOR_TEST_REFERENCE_STEP seconds
+    // at a time. Then times both the single call and catching up
+    // with INTEGRATOR_TEST_SUBSTEP second updatePosition() calls, the way a
+    // stepwise integrator has to.
+
+    std::vector<IntegratorTestCase> testCases(testCaseCount);
+    unsigned int random = 97531;
+    float totalTime = 0.0f;
+
+    for (int i = 0; i < testCaseCount; ++i)
+    {
+        IntegratorTestCase &testCase = testCases[i];
+        float r[13];
+
+        for (int j = 0; j < 13; ++j)
+        {
+            random = random * 1664525 + 1013904223;
+            r[j] = (random >> 8) / 16777216.0f;
+        }
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            float choice = r[axis * 4];
+
+            testCase.acceleration[axis] = 1.0f + 19.0f * r[axis * 4 + 1];
+            testCase.maxSpeed[axis] = 1.0f + 19.0f * r[axis * 4 + 2];
+            testCase.velocity[axis] = (2.0f * r[axis * 4 + 3] - 1.0f) * 1.5f * testCase.maxSpeed[axis];
+
+            if (choice < 0.3f)
+                testCase.direction[axis] = 0.0f;
+            else if (choice < 0.6f)
+                testCase.direction[axis] = (choice < 0.45f) ? -1.0f : 1.0f;
+            else
+                testCase.direction[axis] = 5.0f * choice - 4.0f;
+        }
+
+        testCase.time = INTEGRATOR_TEST_MAX_STEP * r[12] * r[12];
+        totalTime += testCase.time;
+    }
+
+    Camera camera;
+    TextBuffer text;
+    D3DXVECTOR3 referenceDisplacement;
+    D3DXVECTOR3 referenceVelocity;
+    float maxPositionError[2] = {0.0f, 0.0f};
+    float maxVelocityError[2] = {0.0f, 0.0f};
+    double runSec[2] = {0.0, 0.0};
+    int stepCount[2] = {0, 0};
+
+    for (int i = 0; i < testCaseCount; ++i)
+    {
+        const IntegratorTestCase &testCase = testCases[i];
+
+        IntegrateCameraMotion(testCase, INTEGRATOR_TEST_REFERENCE_STEP,
+            referenceDisplacement, referenceVelocity);
+
+        for (int run = 0; run < 2; ++run)
+        {
+            // Errors are relative to the distance covered once it's over a
+            // unit, and to the speed limit.
+
+            camera.setPosition(0.0f, 0.0f, 0.0f);
+            camera.setAcceleration(testCase.acceleration);
+            camera.setVelocity(testCase.maxSpeed);
+            camera.setCurrentVelocity(testCase.velocity);
+
+            double startTime = GetTimeInSeconds();
+
+            if (run == 0)
+            {
+                camera.updatePosition(testCase.direction, testCase.time);
+                ++stepCount[run];
+            }
+            else
+            {
+                int substepCount = static_cast<int>(ceilf(testCase.time / INTEGRATOR_TEST_SUBSTEP));
+
+                for (int j = 0; j < substepCount; ++j)
+                {
+                    float step = (j < substepCount - 1) ? INTEGRATOR_TEST_SUBSTEP
+                        : testCase.time - INTEGRATOR_TEST_SUBSTEP * j;
+
+                    camera.updatePosition(testCase.direction, step);
+                }
+
+                stepCount[run] += substepCount;
+            }
+
+            runSec[run] += GetTimeInSeconds() - startTime;
+
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                float distance = (std::max)(fabsf(referenceDisplacement[axis]), 1.0f);
+                float positionError = fabsf(camera.getPosition()[axis] - referenceDisplacement[axis]) / distance;
+                float velocityError = fabsf(camera.getCurrentVelocity()[axis] - referenceVelocity[axis])
+                    / testCase.maxSpeed[axis];
+
+                maxPositionError[run] = (std::max)(maxPositionError[run], positionError);
+                maxVelocityError[run] = (std::max)(maxVelocityError[run], velocityError);
+            }
+        }
+    }
+
+    bool passed = maxPositionError[0] <= INTEGRATOR_TEST_MAX_ERROR
+        && maxVelocityError[0] <= INTEGRATOR_TEST_MAX_ERROR;
+
+    text.append("Steps: ").append(testCaseCount).newline();
+    text.append("Mean step: ").append(totalTime * 1000.0f / (std::max)(testCaseCount, 1), 1).append(" ms").newline();
+
+    for (int run = 0; run < 2; ++run)
+    {
+        text.newline();
+
+        if (run == 0)
+            text.append("Closed form, one call per step").newline();
+        else
+            text.append("Sub-stepped, ").append(INTEGRATOR_TEST_SUBSTEP * 1000.0f, 1).append(" ms per call").newline();
+
+        text.append("Calls: ").append(stepCount[run]).newline();
+        text.append("Time per step: ").append(static_cast<float>(runSec[run] * 1e9 / (std::max)(testCaseCount, 1)), 1).append(" ns").newline();
+        text.append("Max position error: ").append(maxPositionError[run] * 1e6f, 2).append(" ppm").newline();
+        text.append("Max velocity error: ").append(maxVelocityError[run] * 1e6f, 2).append(" ppm").newline();
+    }
+
+    text.newline();
+    text.append("Speedup: ").append(static_cast<float>(runSec[1] / (std::max)(runSec[0], 1e-9)), 1).append("x").newline();
+    text.append(passed ? "PASSED" : "FAILED").newline();
+
+    fputs(text.c_str(), stdout);
+    fflush(stdout);
+    return passed ? 0 : 1;
+}
+
+int RunWorldPrecisionTest(int poseCount)
+{
+    // Places the scene 1e3 to 1e7 world units from the world origin along
+    // the x and z axes, the way the application's -worldoffset option does,
+    // and looks at WORLD_PRECISION_POINTS random points in front of each of
+    // poseCount random camera poses in the scene. Each pose is drawn the
+    // plain float way, with the camera's origin at the world origin, and the
+    // way -largeworld draws it, with the camera's origin at the scene's
+    // sector and rebased to the eye each frame. See MeasureWorldPrecision().
+    // The camera relative errors must stay under WORLD_PRECISION_MAX_ERROR
+    // (a millimetre) at every offset. Also times building a frame's matrices
+    // both ways, and checks that clamping orbit cameras with random targets
+    // to bounds around the scene leaves their target and eye inside.
+
+    std::vector<Camera> floatCameras(poseCount);
+    std::vector<Camera> sectorCameras(poseCount);
+    std::vector<D3DXMATRIX> matrices(poseCount);
+    std::vector<D3DXVECTOR3> points(WORLD_PRECISION_POINTS);
+    D3DXVECTOR3 boundsMin(-WORLD_PRECISION_BOUNDS_SIZE, CAMERA_POS.y, -WORLD_PRECISION_BOUNDS_SIZE);
+    D3DXVECTOR3 boundsMax(WORLD_PRECISION_BOUNDS_SIZE, WORLD_PRECISION_BOUNDS_HEIGHT, WORLD_PRECISION_BOUNDS_SIZE);
+    float aspect = WORLD_PRECISION_SCREEN_WIDTH / WORLD_PRECISION_SCREEN_HEIGHT;
+    float tanHalfFovX = tanf(D3DXToRadian(CAMERA_FOVX) * 0.5f);
+    float tanHalfFovY = tanHalfFovX / aspect;
+    unsigned int random = 86420;
+    double offset = WORLD_PRECISION_MIN_OFFSET;
+    double runSec[2] = {0.0, 0.0};
+    bool passed = true;
+    Camera camera;
+    CameraController controller;
+    TextBuffer text;
+
+    camera.perspective(CAMERA_FOVX, aspect, CAMERA_ZNEAR, CAMERA_ZFAR);
+    controller.setBounds(boundsMin, boundsMax);
+
+    text.append("Poses: ").append(poseCount).newline();
+    text.append("Points per pose: ").append(WORLD_PRECISION_POINTS).newline();
+
+    for (int decade = 0; decade < WORLD_PRECISION_DECADES; ++decade, offset *= 10.0)
+    {
+        WorldPosition sceneOrigin(offset, 0.0, offset);
+        float maxPositionError[2] = {0.0f, 0.0f};
+        float maxPixelError[2] = {0.0f, 0.0f};
+        int boundsViolations = 0;
+
+        controller.setBoundsOrigin(sceneOrigin);
+
+        for (int i = 0; i < poseCount; ++i)
+        {
+            float r[8];
+
+            for (int j = 0; j < 8; ++j)
+            {
+                random = random * 1664525 + 1013904223;
+                r[j] = (random >> 8) / 16777216.0f;
+            }
+
+            // The eye is somewhere above the floor, looking anywhere but
+            // straight up or down.
+
+            WorldPosition eye(sceneOrigin.x + WORLD_PRECISION_BOUNDS_SIZE * (2.0 * r[0] - 1.0),
+                CAMERA_POS.y + (WORLD_PRECISION_BOUNDS_HEIGHT - CAMERA_POS.y) * r[1],
+                sceneOrigin.z + WORLD_PRECISION_BOUNDS_SIZE * (2.0 * r[2] - 1.0));
+            Camera &floatCamera = floatCameras[i];
+            Camera &sectorCamera = sectorCameras[i];
+
+            floatCamera = camera;
+            floatCamera.rotate(360.0f * r[3], 160.0f * r[4] - 80.0f, 0.0f);
+            floatCamera.setWorldPosition(eye);
+
+            sectorCamera = floatCamera;
+            sectorCamera.setOrigin(SectorOrigin(ToSectorPosition(sceneOrigin)));
+            sectorCamera.setWorldPosition(eye);
+
+            Camera rebasedCamera(sectorCamera);
+            rebasedCamera.setOrigin(rebasedCamera.getWorldPosition());
+
+            // The points are somewhere in the view frustum, and are stored
+            // relative to the scene's origin like the floor's vertices.
+
+            for (int j = 0; j < WORLD_PRECISION_POINTS; ++j)
+            {
+                float s[3];
+
+                for (int k = 0; k < 3; ++k)
+                {
+                    random = random * 1664525 + 1013904223;
+                    s[k] = (random >> 8) / 16777216.0f;
+                }
+
+                float depth = 1.0f + (WORLD_PRECISION_MAX_DEPTH - 1.0f) * s[0];
+                D3DXVECTOR3 view = floatCamera.getZAxis() * depth
+                    + floatCamera.getXAxis() * ((2.0f * s[1] - 1.0f) * tanHalfFovX * depth)
+                    + floatCamera.getYAxis() * ((2.0f * s[2] - 1.0f) * tanHalfFovY * depth);
+
+                points[j] = WorldOffset(eye + view, sceneOrigin);
+            }
+
+            MeasureWorldPrecision(floatCamera, sceneOrigin, eye, &points[0],
+                WORLD_PRECISION_POINTS, maxPositionError[0], maxPixelError[0]);
+            MeasureWorldPrecision(rebasedCamera, sceneOrigin, eye, &points[0],
+                WORLD_PRECISION_POINTS, maxPositionError[1], maxPixelError[1]);
+
+            // An orbit camera whose target may have left the bounds.
+
+            Camera orbitCamera(sectorCamera);
+            D3DXVECTOR3 target(2.0f * WORLD_PRECISION_BOUNDS_SIZE * (2.0f * r[5] - 1.0f),
+                WORLD_PRECISION_BOUNDS_HEIGHT * (3.0f * r[6] - 1.0f),
+                2.0f * WORLD_PRECISION_BOUNDS_SIZE * (2.0f * r[7] - 1.0f));
+
+            orbitCamera.setBehavior(Camera::CAMERA_BEHAVIOR_ORBIT);
+            orbitCamera.setOrbitTarget(WorldOffset(sceneOrigin + target, orbitCamera.getOrigin()));
+            orbitCamera.setOrbitDistance(1.0f + 2.0f * WORLD_PRECISION_BOUNDS_SIZE * r[0]);
+            controller.clampToBounds(orbitCamera);
+
+            D3DXVECTOR3 clampedTarget = WorldOffset(orbitCamera.getOrigin() + orbitCamera.getOrbitTarget(), sceneOrigin);
+            D3DXVECTOR3 clampedEye = WorldOffset(orbitCamera.getWorldPosition(), sceneOrigin);
+            D3DXVECTOR3 behind = orbitCamera.getOrbitTarget() - orbitCamera.getPosition();
+            bool inside = true;
+
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                inside = inside
+                    && clampedTarget[axis] >= boundsMin[axis] - WORLD_PRECISION_MAX_ERROR
+                    && clampedTarget[axis] <= boundsMax[axis] + WORLD_PRECISION_MAX_ERROR
+                    && clampedEye[axis] >= boundsMin[axis] - WORLD_PRECISION_MAX_ERROR
+                    && clampedEye[axis] <= boundsMax[axis] + WORLD_PRECISION_MAX_ERROR;
+            }
+
+            // The eye must still be behind the target along the view direction.
+
+            if (!inside || D3DXVec3Length(&behind) > orbitCamera.getOrbitDistance() + WORLD_PRECISION_MAX_ERROR
+                || D3DXVec3Dot(&behind, &orbitCamera.getZAxis()) < D3DXVec3Length(&behind) - WORLD_PRECISION_MAX_ERROR)
+            {
+                ++boundsViolations;
+            }
+        }
+
+        // Time building each frame's floor world-view-projection matrix.
+
+        for (int run = 0; run < 2; ++run)
+        {
+            double startTime = GetTimeInSeconds();
+
+            for (int i = 0; i < poseCount; ++i)
+            {
+                D3DXMATRIX world;
+                D3DXVECTOR3 sceneOffset;
+
+                if (run == 0)
+                {
+                    const Camera &floatCamera = floatCameras[i];
+
+                    sceneOffset = WorldOffset(sceneOrigin, floatCamera.getOrigin());
+                    D3DXMatrixTranslation(&world, sceneOffset.x, sceneOffset.y, sceneOffset.z);
+                    D3DXMatrixMultiply(&matrices[i], &world, &floatCamera.getViewMatrix());
+                    D3DXMatrixMultiply(&matrices[i], &matrices[i], &floatCamera.getProjectionMatrix());
+                }
+                else
+                {
+                    Camera rebasedCamera(sectorCameras[i]);
+
+                    rebasedCamera.setOrigin(rebasedCamera.getWorldPosition());
+                    sceneOffset = WorldOffset(sceneOrigin, rebasedCamera.getOrigin());
+                    D3DXMatrixTranslation(&world, sceneOffset.x, sceneOffset.y, sceneOffset.z);
+                    D3DXMatrixMultiply(&matrices[i], &world, &rebasedCamera.getViewMatrix());
+                    D3DXMatrixMultiply(&matrices[i], &matrices[i], &rebasedCamera.getProjectionMatrix());
+                }
+            }
+
+            runSec[run] += GetTimeInSeconds() - startTime;
+        }
+
+        passed = passed && maxPositionError[1] <= WORLD_PRECISION_MAX_ERROR && boundsViolations == 0;
+
+        text.newline();
+        text.append("Offset: ").append(static_cast<int>(offset)).newline();
+        text.append("Float error: ").append(maxPositionError[0] * 1000.0f, 3).append(" mm, ");
+        text.append(maxPixelError[0], 3).append(" pixels").newline();
+        text.append("Camera relative error: ").append(maxPositionError[1] * 1000.0f, 3).append(" mm, ");
+        text.append(maxPixelError[1], 3).append(" pixels").newline();
+        text.append("Orbit cameras outside the bounds: ").append(boundsViolations).newline();
+    }
+
+    int frameCount = poseCount * WORLD_PRECISION_DECADES;
+
+    text.newline();
+    text.append("Time per frame, float: ").append(static_cast<float>(runSec[0] * 1e9 / frameCount), 1).append(" ns").newline();
+    text.append("Time per frame, camera relative: ").append(static_cast<float>(runSec[1] * 1e9 / frameCount), 1).append(" ns").newline();
+    text.newline();
+    text.append(passed ? "PASSED" : "FAILED").newline();
+
+    fputs(text.c_str(), stdout);
+    fflush(stdout);
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,1437 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <process.h>
+#include <vector>
+#include <windows.h>
+
+#include "app_camera.h"
+#include "app_input.h"
+#include "camera.h"
+#include "camera_bench.h"
+#include "camera_controller.h"
+#include "camera_predictor.h"
+#include "camera_replay.h"
+#include "camera_rig.h"
+#include "input.h"
+#include "input_events.h"
+#include "input_recorder.h"
+#include "synthetic_input.h"
+#include "text_buffer.h"
+#include "timer.h"
+
+namespace
+{
+    const int         ACTION_MAP_BENCHMARK_BINDINGS = 512;
+    const int         ACTION_MAP_BENCHMARK_STATES = 1024;
+    const int         ACTION_MAP_BENCHMARK_KEYS_DOWN = 8;
+    const float       ACTION_MAP_TEST_FRAME_TIME = 1.0f / 60.0f;
+
+    // The hardcoded key checks only ever knew the actions up to
+    // ACTION_TOGGLE_PREDICTION. Later actions only exist in the action map.
+    const int         ACTION_MAP_TEST_HARDCODED_ACTIONS = ACTION_TOGGLE_PREDICTION + 1;
+
+    const float       INPUT_EVENT_TEST_MOUSE_RATE = 8000.0f;
+    const float       INPUT_EVENT_TEST_KEY_RATE = 8.0f;
+    const unsigned    INPUT_EVENT_TEST_SEED = 24680;
+
+    const int         KEYBOARD_BENCHMARK_STATES = 1024;
+    const int         KEYBOARD_BENCHMARK_KEYS_DOWN = 4;
+
+    const int         MOUSE_FILTER_BENCHMARK_HISTORY_SIZES[3] = {10, 80, 800};
+    const float       MOUSE_FILTER_BENCHMARK_RATE = 8000.0f;
+    const float       MOUSE_FILTER_BENCHMARK_MAX_ERROR = 1e-3f;
+
+    const float       RAW_MOUSE_BENCHMARK_RATE = 8000.0f;
+    const float       RAW_MOUSE_BENCHMARK_FRAME_TIME = 1.0f / 60.0f;
+    const float       RAW_MOUSE_BENCHMARK_MIN_SPEED = 2000.0f;
+
+    const int         PREDICTION_TEST_FRAME_LATENCY = 2;
+
+    const float       SYNTHETIC_LOG_SECONDS = 60.0f;
+    const float       SYNTHETIC_LOG_FRAME_TIME = 1.0f / 60.0f;
+    const float       SYNTHETIC_LOG_MOUSE_RATE = 1000.0f;
+    const float       SYNTHETIC_LOG_KEY_RATE = 4.0f;
+
+    // The synthetic mouse sweeps 4000 counts at up to 12500 counts a second.
+    // At CAMERA_SPEED_ROTATION that would turn the camera at 2500 degrees a
+    // second, so the log records its movement scaled down to a brisk 150
+    // degrees a second.
+    const int         SYNTHETIC_LOG_MOUSE_DIVISOR = 16;
+    const unsigned    SYNTHETIC_LOG_SEED = 13579;
+
+    // Runs a synthetic input source on a thread of its own for
+    // RunInputEventTest().
+    struct InputEventProducer
+    {
+        SyntheticInputSource *pSource;
+        double endTime;
+        volatile LONG finished;
+    };
+
+    void GenerateInputEvents(double startTime, double endTime, double step,
+                             std::vector<InputEvent> &events)
+    {
+        // Runs the synthetic input source that RunInputEventTest() uses up
+        // to endTime, calling update() every step seconds, and collects its
+        // events.
+
+        SyntheticInputSource source;
+        InputEventQueue queue;
+        InputEvent event;
+
+        source.create(startTime, INPUT_EVENT_TEST_MOUSE_RATE, INPUT_EVENT_TEST_KEY_RATE, INPUT_EVENT_TEST_SEED);
+        source.setEventQueue(&queue);
+        events.clear();
+
+        for (double time = startTime; ; time += step)
+        {
+            source.update((std::min)(time, endTime));
+
+            while (queue.pop(event))
+                events.push_back(event);
+
+            if (time >= endTime)
+                break;
+        }
+    }
+
+    unsigned long long GetHardcodedActions(const Keyboard &keyboard)
+    {
+        // The key checks the application's ProcessUserInput() made before the
+        // action map. Used as the reference by RunActionMapTest(). Returns a bit
+        // per Action that the keys triggered.
+
+        unsigned long long actions = 0;
+
+        if (keyboard.keyPressed(Keyboard::KEY_ESCAPE))
+            actions |= 1ULL << ACTION_EXIT;
+
+        if (keyboard.keyPressed(Keyboard::KEY_H))
+            actions |= 1ULL << ACTION_TOGGLE_HELP;
+
+        if (keyboard.keyPressed(Keyboard::KEY_T))
+            actions |= 1ULL << ACTION_TOGGLE_COLOR_MAP;
+
+        if (keyboard.keyPressed(Keyboard::KEY_ADD) || keyboard.keyPressed(Keyboard::KEY_NUMPAD_ADD))
+            actions |= 1ULL << ACTION_INCREASE_ROTATION_SPEED;
+
+        if (keyboard.keyPressed(Keyboard::KEY_MINUS) || keyboard.keyPressed(Keyboard::KEY_NUMPAD_MINUS))
+            actions |= 1ULL << ACTION_DECREASE_ROTATION_SPEED;
+
+        if (keyboard.keyPressed(Keyboard::KEY_PERIOD))
+            actions |= 1ULL << ACTION_INCREASE_MOUSE_WEIGHT;
+
+        if (keyboard.keyPressed(Keyboard::KEY_COMMA))
+            actions |= 1ULL << ACTION_DECREASE_MOUSE_WEIGHT;
+
+        if (keyboard.keyPressed(Keyboard::KEY_M))
+            actions |= 1ULL << ACTION_TOGGLE_MOUSE_SMOOTHING;
+
+        if (keyboard.keyDown(Keyboard::KEY_LALT) || keyboard.keyDown(Keyboard::KEY_RALT))
+        {
+            if (keyboard.keyPressed(Keyboard::KEY_ENTER))
+                actions |= 1ULL << ACTION_TOGGLE_FULL_SCREEN;
+        }
+
+        if (keyboard.keyPressed(Keyboard::KEY_SPACE))
+            actions |= 1ULL << ACTION_TOGGLE_FLIGHT_MODE;
+
+        if (keyboard.keyPressed(Keyboard::KEY_V))
+            actions |= 1ULL << ACTION_CYCLE_VIEW_LAYOUT;
+
+        if (keyboard.keyPressed(Keyboard::KEY_P))
+            actions |= 1ULL << ACTION_TOGGLE_PREDICTION;
+
+        return actions;
+    }
+
+    void GetHardcodedMovement(const Keyboard &keyboard, bool movePressed[6],
+                              Camera &camera, D3DXVECTOR3 &direction)
+    {
+        // The key checks the application's GetMovementDirection() made before
+        // the action map, including its resets of the camera's velocity. Used
+        // as the reference by RunActionMapTest(). movePressed replaces the six
+        // static flags it kept (forwards, backwards, right, left, up, down).
+
+        D3DXVECTOR3 velocity = camera.getCurrentVelocity();
+
+        direction.x = direction.y = direction.z = 0.0f;
+
+        if (keyboard.keyDown(Keyboard::KEY_UP) || keyboard.keyDown(Keyboard::KEY_W))
+        {
+            if (!movePressed[0])
+            {
+                movePressed[0] = true;
+                camera.setCurrentVelocity(velocity.x, velocity.y, 0.0f);
+            }
+
+            direction.z += 1.0f;
+        }
+        else
+        {
+            movePressed[0] = false;
+        }
+
+        if (keyboard.keyDown(Keyboard::KEY_DOWN) || keyboard.keyDown(Keyboard::KEY_S))
+        {
+            if (!movePressed[1])
+            {
+                movePressed[1] = true;
+                camera.setCurrentVelocity(velocity.x, velocity.y, 0.0f);
+            }
+
+            direction.z -= 1.0f;
+        }
+        else
+        {
+            movePressed[1] = false;
+        }
+
+        if (keyboard.keyDown(Keyboard::KEY_RIGHT) || keyboard.keyDown(Keyboard::KEY_D))
+        {
+            if (!movePressed[2])
+            {
+                movePressed[2] = true;
+                camera.setCurrentVelocity(0.0f, velocity.y, velocity.z);
+            }
+
+            direction.x += 1.0f;
+        }
+        else
+        {
+            movePressed[2] = false;
+        }
+
+        if (keyboard.keyDown(Keyboard::KEY_LEFT) || keyboard.keyDown(Keyboard::KEY_A))
+        {
+            if (!movePressed[3])
+            {
+                movePressed[3] = true;
+                camera.setCurrentVelocity(0.0f, velocity.y, velocity.z);
+            }
+
+            direction.x -= 1.0f;
+        }
+        else
+        {
+            movePressed[3] = false;
+        }
+
+        if (keyboard.keyDown(Keyboard::KEY_E) || keyboard.keyDown(Keyboard::KEY_PAGEUP))
+        {
+            if (!movePressed[4])
+            {
+                movePressed[4] = true;
+                camera.setCurrentVelocity(velocity.x, 0.0f, velocity.z);
+            }
+
+            direction.y += 1.0f;
+        }
+        else
+        {
+            movePressed[4] = false;
+        }
+
+        if (keyboard.keyDown(Keyboard::KEY_Q) || keyboard.keyDown(Keyboard::KEY_PAGEDOWN))
+        {
+            if (!movePressed[5])
+            {
+                movePressed[5] = true;
+                camera.setCurrentVelocity(velocity.x, 0.0f, velocity.z);
+            }
+
+            direction.y -= 1.0f;
+        }
+        else
+        {
+            movePressed[5] = false;
+        }
+    }
+
+    unsigned int __stdcall InputEventProducerThreadProc(void *pArg)
+    {
+        // Generates events in real time, the way a device driver would, until
+        // the producer's end time.
+
+        InputEventProducer &producer = *static_cast<InputEventProducer *>(pArg);
+
+        while (GetTimeInSeconds() < producer.endTime)
+        {
+            producer.pSource->update();
+            Sleep(0);
+        }
+
+        producer.pSource->update(producer.endTime);
+        InterlockedExchange(&producer.finished, 1);
+        return 0;
+    }
+
+    void ReadMouseReports(InputEventQueue &queue, std::vector<MouseReport> &reports)
+    {
+        // Empties the queue and groups its mouse movement events back into
+        // the device reports they came from, the same way the Mouse class's
+        // readBufferedData() does it. The reports are appended to 'reports'.
+
+        InputEvent event;
+        unsigned int sequence = 0;
+        bool pending = false;
+
+        while (queue.pop(event))
+        {
+            if (event.type != InputEvent::MOUSE_MOVE_X && event.type != InputEvent::MOUSE_MOVE_Y)
+                continue;
+
+            if (!pending || event.sequence != sequence)
+            {
+                MouseReport report = {0, 0};
+
+                reports.push_back(report);
+                sequence = event.sequence;
+                pending = true;
+            }
+
+            if (event.type == InputEvent::MOUSE_MOVE_X)
+                reports.back().x += event.value;
+            else
+                reports.back().y += event.value;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Tests and benchmarks.
+//-----------------------------------------------------------------------------
+
+int RunActionMapTest(int frameCount)
+{
+    // Replays frameCount frames of synthetic input twice: through the
+    // application's action map, GetCameraInput() and the camera controller,
+    // and through the hardcoded key checks and camera update they replaced. Some keys are tapped (pressed and released between two
+    // frames). Both cameras must end up in exactly the same place and both
+    // paths must trigger the same actions on every frame.
+    //
+    // Then times ActionMap::evaluate() with ACTION_MAP_BENCHMARK_BINDINGS
+    // random bindings, a quarter of them chords, against testing the same
+    // bindings one by one.
+
+    static const int keys[] =
+    {
+        Keyboard::KEY_UP, Keyboard::KEY_W, Keyboard::KEY_DOWN, Keyboard::KEY_S,
+        Keyboard::KEY_RIGHT, Keyboard::KEY_D, Keyboard::KEY_LEFT, Keyboard::KEY_A,
+        Keyboard::KEY_E, Keyboard::KEY_PAGEUP, Keyboard::KEY_Q, Keyboard::KEY_PAGEDOWN,
+        Keyboard::KEY_ESCAPE, Keyboard::KEY_H, Keyboard::KEY_T, Keyboard::KEY_ADD,
+        Keyboard::KEY_NUMPAD_ADD, Keyboard::KEY_MINUS, Keyboard::KEY_NUMPAD_MINUS,
+        Keyboard::KEY_PERIOD, Keyboard::KEY_COMMA, Keyboard::KEY_M, Keyboard::KEY_LALT,
+        Keyboard::KEY_RALT, Keyboard::KEY_ENTER, Keyboard::KEY_SPACE, Keyboard::KEY_V,
+        Keyboard::KEY_P
+    };
+
+    const int keyCount = sizeof(keys) / sizeof(keys[0]);
+    Keyboard &keyboard = Keyboard::instance();
+    ActionMap appActionMap;
+    CameraController controller;
+    Camera mappedCamera;
+    Camera hardcodedCamera;
+    unsigned char keyStates[256] = {0};
+    unsigned char keyTaps[256];
+    bool movePressed[6] = {false, false, false, false, false, false};
+    unsigned int random = 97531;
+    int frames = frameCount;
+    int actionMismatches = 0;
+    int directionMismatches = 0;
+    int cameraMismatches = 0;
+    TextBuffer text;
+
+    InitActionMap(appActionMap);
+    controller.setFlightYawSpeed(CAMERA_SPEED_FLIGHT_YAW);
+
+    Camera *pCameras[2] = {&mappedCamera, &hardcodedCamera};
+
+    for (int i = 0; i < 2; ++i)
+    {
+        pCameras[i]->setBehavior(Camera::CAMERA_BEHAVIOR_FIRST_PERSON);
+        pCameras[i]->setPosition(CAMERA_POS);
+        pCameras[i]->setAcceleration(CAMERA_ACCELERATION);
+        pCameras[i]->setVelocity(CAMERA_VELOCITY);
+        pCameras[i]->setRotationSpeed(CAMERA_SPEED_ROTATION);
+    }
+
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        // Each key changes state every 8 frames on average. Keys that are up
+        // are tapped every 64 frames on average.
+
+        memset(keyTaps, 0, sizeof(keyTaps));
+
+        for (int i = 0; i < keyCount; ++i)
+        {
+            random = random * 1664525 + 1013904223;
+
+            if ((random >> 24) < 32)
+                keyStates[keys[i]] ^= 0x80;
+            else if ((random >> 24) < 36 && !keyStates[keys[i]])
+                keyTaps[keys[i]] = 0x80;
+        }
+
+        random = random * 1664525 + 1013904223;
+
+        float mouseX = static_cast<float>(static_cast<int>(random >> 24) - 128) * 0.1f;
+        float mouseY = static_cast<float>(static_cast<int>((random >> 16) & 0xff) - 128) * 0.1f;
+
+        keyboard.update(keyStates, keyTaps);
+
+        // The action map. The hardcoded checks only ever triggered the
+        // application's actions. The movement actions are compared through
+        // the direction and the cameras instead.
+
+        CameraInput input;
+        unsigned long long mappedActions = 0;
+
+        UpdateActionMap(appActionMap);
+        GetCameraInput(appActionMap, mouseX, mouseY, input);
+        controller.update(input, ACTION_MAP_TEST_FRAME_TIME, mappedCamera);
+
+        for (int action = ACTION_EXIT; action < ACTION_MAP_TEST_HARDCODED_ACTIONS; ++action)
+        {
+            if (appActionMap.triggered(action))
+                mappedActions |= 1ULL << action;
+        }
+
+        // The hardcoded key checks and camera update.
+
+        D3DXVECTOR3 direction;
+        unsigned long long hardcodedActions = GetHardcodedActions(keyboard);
+        float rotationSpeed = hardcodedCamera.getRotationSpeed();
+
+        GetHardcodedMovement(keyboard, movePressed, hardcodedCamera, direction);
+
+        if (direction != input.direction)
+            ++directionMismatches;
+
+        switch (hardcodedCamera.getBehavior())
+        {
+        case Camera::CAMERA_BEHAVIOR_FIRST_PERSON:
+            hardcodedCamera.rotate(mouseX * rotationSpeed, mouseY * rotationSpeed, 0.0f);
+            break;
+
+        case Camera::CAMERA_BEHAVIOR_FLIGHT:
+            hardcodedCamera.rotate(direction.x * CAMERA_SPEED_FLIGHT_YAW * ACTION_MAP_TEST_FRAME_TIME,
+                -mouseY * rotationSpeed, mouseX * rotationSpeed);
+            direction.x = 0.0f;
+            break;
+        }
+
+        hardcodedCamera.updatePosition(direction, ACTION_MAP_TEST_FRAME_TIME);
+
+        if (mappedActions != hardcodedActions)
+            ++actionMismatches;
+
+        // Flight mode is toggled the same way ProcessUserInput() does it, by
+        // each path's own trigger.
+
+        unsigned long long actions[2] = {mappedActions, hardcodedActions};
+
+        for (int i = 0; i < 2; ++i)
+        {
+            if (!(actions[i] & (1ULL << ACTION_TOGGLE_FLIGHT_MODE)))
+                continue;
+
+            if (pCameras[i]->getBehavior() == Camera::CAMERA_BEHAVIOR_FIRST_PERSON)
+            {
+                pCameras[i]->setBehavior(Camera::CAMERA_BEHAVIOR_FLIGHT);
+            }
+            else
+            {
+                const D3DXVECTOR3 &cameraPos = pCameras[i]->getPosition();
+
+                pCameras[i]->setBehavior(Camera::CAMERA_BEHAVIOR_FIRST_PERSON);
+                pCameras[i]->setPosition(cameraPos.x, CAMERA_POS.y, cameraPos.z);
+            }
+        }
+
+        if (mappedCamera.getPosition() != hardcodedCamera.getPosition()
+            || mappedCamera.getCurrentVelocity() != hardcodedCamera.getCurrentVelocity()
+            || mappedCamera.getViewMatrix() != hardcodedCamera.getViewMatrix())
+        {
+            ++cameraMismatches;
+        }
+    }
+
+    bool passed = actionMismatches == 0 && directionMismatches == 0 && cameraMismatches == 0;
+
+    text.append("Frames: ").append(frames).newline();
+    text.append("Action mismatches: ").append(actionMismatches).newline();
+    text.append("Direction mismatches: ").append(directionMismatches).newline();
+    text.append("Camera mismatches: ").append(cameraMismatches).newline();
+
+    // The benchmark. Bindings are stored as an action followed by a trigger
+    // and three modifiers (INPUT_NONE if unused).
+
+    std::vector<int> bindings(ACTION_MAP_BENCHMARK_BINDINGS * 5, ActionMap::INPUT_NONE);
+    std::vector<InputBits> downStates(ACTION_MAP_BENCHMARK_STATES);
+    std::vector<InputBits> pressedStates(ACTION_MAP_BENCHMARK_STATES);
+    ActionMap actionMap;
+
+    for (int i = 0; i < ACTION_MAP_BENCHMARK_BINDINGS; ++i)
+    {
+        int *pBinding = &bindings[i * 5];
+
+        random = random * 1664525 + 1013904223;
+        pBinding[0] = (random >> 8) % ActionMap::MAX_ACTIONS;
+        pBinding[1] = (random >> 16) % InputBits::INPUT_COUNT;
+
+        int modifierCount = ((random >> 4) & 3) == 0 ? 1 + ((random >> 28) & 1) : 0;
+
+        for (int j = 0; j < modifierCount; ++j)
+        {
+            random = random * 1664525 + 1013904223;
+            pBinding[2 + j] = (random >> 16) % InputBits::INPUT_COUNT;
+        }
+
+        actionMap.bind(pBinding[0], pBinding[1], pBinding[2], pBinding[3], pBinding[4]);
+    }
+
+    actionMap.compile();
+
+    for (int i = 0; i < ACTION_MAP_BENCHMARK_STATES; ++i)
+    {
+        const InputBits &prevDown = downStates[(i + ACTION_MAP_BENCHMARK_STATES - 1) % ACTION_MAP_BENCHMARK_STATES];
+
+        downStates[i].clear();
+
+        for (int j = 0; j < ACTION_MAP_BENCHMARK_KEYS_DOWN; ++j)
+        {
+            random = random * 1664525 + 1013904223;
+            downStates[i].set((random >> 16) % InputBits::INPUT_COUNT);
+        }
+
+        // The first state is pressed against an empty previous state.
+
+        for (int j = 0; j < InputBits::WORD_COUNT; ++j)
+            pressedStates[i].words[j] = downStates[i].words[j] & (i > 0 ? ~prevDown.words[j] : ~0U);
+    }
+
+    unsigned long long mappedChecksum = 0;
+    double startTime = GetTimeInSeconds();
+
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        int state = frame % ACTION_MAP_BENCHMARK_STATES;
+
+        actionMap.evaluate(downStates[state], pressedStates[state]);
+
+        for (int action = 0; action < ActionMap::MAX_ACTIONS; ++action)
+        {
+            if (actionMap.isDown(action))
+                mappedChecksum = mappedChecksum * 31 + action;
+
+            if (actionMap.triggered(action))
+                mappedChecksum = mappedChecksum * 37 + action;
+        }
+    }
+
+    double mappedSec = GetTimeInSeconds() - startTime;
+    unsigned long long testedChecksum = 0;
+
+    startTime = GetTimeInSeconds();
+
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        int state = frame % ACTION_MAP_BENCHMARK_STATES;
+        const InputBits &down = downStates[state];
+        const InputBits &pressed = pressedStates[state];
+        unsigned long long actionsDown = 0;
+        unsigned long long actionsTriggered = 0;
+
+        for (int i = 0; i < ACTION_MAP_BENCHMARK_BINDINGS; ++i)
+        {
+            const int *pBinding = &bindings[i * 5];
+            bool modifiersDown = true;
+
+            for (int j = 2; j < 5; ++j)
+            {
+                if (pBinding[j] != ActionMap::INPUT_NONE && !down.test(pBinding[j]))
+                    modifiersDown = false;
+            }
+
+            if (modifiersDown && down.test(pBinding[1]))
+                actionsDown |= 1ULL << pBinding[0];
+
+            if (modifiersDown && pressed.test(pBinding[1]))
+                actionsTriggered |= 1ULL << pBinding[0];
+        }
+
+        for (int action = 0; action < ActionMap::MAX_ACTIONS; ++action)
+        {
+            if (actionsDown & (1ULL << action))
+                testedChecksum = testedChecksum * 31 + action;
+
+            if (actionsTriggered & (1ULL << action))
+                testedChecksum = testedChecksum * 37 + action;
+        }
+    }
+
+    double testedSec = GetTimeInSeconds() - startTime;
+    double nsPerFrame = frames > 0 ? 1e9 / frames : 0.0;
+
+    if (mappedChecksum != testedChecksum)
+        passed = false;
+
+    text.append("Bindings: ").append(actionMap.bindingCount()).newline();
+    text.append("Action map: ").append(static_cast<float>(mappedSec * nsPerFrame), 1).append(" ns/frame").newline();
+    text.append("One by one: ").append(static_cast<float>(testedSec * nsPerFrame), 1).append(" ns/frame").newline();
+    text.append("Speedup: ").append(static_cast<float>(mappedSec > 0.0 ? testedSec / mappedSec : 0.0), 2).append("x").newline();
+    text.append("Results match: ").append(mappedChecksum == testedChecksum ? "yes" : "no").newline();
+    text.append(passed ? "PASSED" : "FAILED").newline();
+
+    fputs(text.c_str(), stdout);
+    fflush(stdout);
+    return passed ? 0 : 1;
+}
+
+int RunInputEventTest(int seconds)
+{
+    // A synthetic 8 kHz mouse and a keyboard generate events on a thread of
+    // their own for the given number of seconds and push them onto an input
+    // event queue, just like the Keyboard and Mouse classes do. The main
+    // thread consumes them and checks that:
+    //
+    //  - the events arrive in time and sequence order,
+    //  - the x and y movement of a mouse report share a sequence number,
+    //  - every key up follows the key down of the same key,
+    //  - the movement adds up to the synthetic mouse's final position,
+    //  - every event was either received or counted as dropped, and
+    //  - the same events are generated however often update() is called.
+    //
+    // The latency between an event happening and it being consumed is
+    // measured along the way.
+
+    SyntheticInputSource source;
+    InputEventQueue queue;
+    InputEventProducer producer;
+    std::vector<InputEvent> received;
+    std::vector<double> latencies;
+    InputEvent event;
+    TextBuffer text;
+    double startTime = GetTimeInSeconds();
+    double endTime = startTime + seconds;
+
+    received.reserve(static_cast<size_t>(seconds * INPUT_EVENT_TEST_MOUSE_RATE * 2.0f));
+    latencies.reserve(received.capacity());
+
+    source.create(startTime, INPUT_EVENT_TEST_MOUSE_RATE, INPUT_EVENT_TEST_KEY_RATE, INPUT_EVENT_TEST_SEED);
+    source.setEventQueue(&queue);
+
+    producer.pSource = &source;
+    producer.endTime = endTime;
+    producer.finished = 0;
+
+    HANDLE hThread = reinterpret_cast<HANDLE>(_beginthreadex(0, 0,
+        InputEventProducerThreadProc, &producer, 0, 0));
+
+    if (!hThread)
+    {
+        fputs("Failed to create the input event thread.\n", stderr);
+        return 1;
+    }
+
+    for (;;)
+    {
+        // Only stop once the queue is empty after the producer has finished,
+        // otherwise the last few events could be missed.
+
+        bool finished = producer.finished != 0;
+
+        if (!queue.pop(event))
+        {
+            if (finished)
+                break;
+
+            YieldProcessor();
+            continue;
+        }
+
+        latencies.push_back(GetTimeInSeconds() - event.time);
+        received.push_back(event);
+    }
+
+    WaitForSingleObject(hThread, INFINITE);
+    CloseHandle(hThread);
+
+    int orderErrors = 0;
+    int pairingErrors = 0;
+    int keyErrors = 0;
+    int mouseX = 0;
+    int mouseY = 0;
+    int keyDown = -1;
+
+    for (size_t i = 0; i < received.size(); ++i)
+    {
+        const InputEvent &curr = received[i];
+
+        if (curr.type == InputEvent::MOUSE_MOVE_X)
+            mouseX += curr.value;
+        else if (curr.type == InputEvent::MOUSE_MOVE_Y)
+            mouseY += curr.value;
+
+        if (curr.type == InputEvent::KEY_DOWN)
+        {
+            if (keyDown != -1)
+                ++keyErrors;
+
+            keyDown = curr.code;
+        }
+        else if (curr.type == InputEvent::KEY_UP)
+        {
+            if (keyDown != curr.code)
+                ++keyErrors;
+
+            keyDown = -1;
+        }
+
+        if (i == 0)
+            continue;
+
+        const InputEvent &prev = received[i - 1];
+
+        if (curr.time < prev.time || curr.sequence < prev.sequence)
+            ++orderErrors;
+
+        // Only the y movement of a report shares the sequence number of the
+        // event before it, which must be the x movement of the same report.
+
+        if (curr.sequence == prev.sequence
+            && (prev.type != InputEvent::MOUSE_MOVE_X || curr.type != InputEvent::MOUSE_MOVE_Y
+                || curr.time != prev.time))
+        {
+            ++pairingErrors;
+        }
+    }
+
+    // Events lost to a full queue break the checks that need the complete
+    // stream. They're reported, but there shouldn't be any.
+
+    int dropped = source.getDroppedEventCount();
+    bool countsMatch = static_cast<int>(received.size()) + dropped == source.getEventCount();
+    bool positionMatches = dropped > 0
+        || (mouseX == source.getMouseX() && mouseY == source.getMouseY());
+
+    // Generate the same events again in fixed steps of 1 and 7 milliseconds.
+
+    std::vector<InputEvent> steps1;
+    std::vector<InputEvent> steps7;
+    bool deterministic = true;
+
+    GenerateInputEvents(startTime, endTime, 0.001, steps1);
+    GenerateInputEvents(startTime, endTime, 0.007, steps7);
+
+    if (steps1.size() != steps7.size() || (dropped == 0 && steps1.size() != received.size()))
+        deterministic = false;
+
+    for (size_t i = 0; deterministic && i < steps1.size(); ++i)
+    {
+        const InputEvent &a = steps1[i];
+        const InputEvent &b = steps7[i];
+
+        if (a.type != b.type || a.code != b.code || a.value != b.value
+            || a.sequence != b.sequence || a.time != b.time)
+        {
+            deterministic = false;
+        }
+
+        if (dropped == 0)
+        {
+            const InputEvent &c = received[i];
+
+            if (a.type != c.type || a.code != c.code || a.value != c.value
+                || a.sequence != c.sequence || a.time != c.time)
+            {
+                deterministic = false;
+            }
+        }
+    }
+
+    bool passed = countsMatch && positionMatches && deterministic
+        && orderErrors == 0 && pairingErrors == 0 && (dropped > 0 || keyErrors == 0);
+
+    std::sort(latencies.begin(), latencies.end());
+
+    double medianMs = 0.0;
+    double p99Ms = 0.0;
+    double maxMs = 0.0;
+
+    if (!latencies.empty())
+    {
+        medianMs = latencies[latencies.size() / 2] * 1000.0;
+        p99Ms = latencies[(latencies.size() - 1) * 99 / 100] * 1000.0;
+        maxMs = latencies.back() * 1000.0;
+    }
+
+    text.append("Seconds: ").append(seconds).newline();
+    text.append("Mouse reports: ").append(source.getMouseReportCount()).newline();
+    text.append("Key presses: ").append(source.getKeyPressCount()).newline();
+    text.append("Events: ").append(source.getEventCount()).newline();
+    text.append("Events dropped: ").append(dropped).newline();
+    text.append("Order errors: ").append(orderErrors).newline();
+    text.append("Report pairing errors: ").append(pairingErrors).newline();
+    text.append("Key pairing errors: ").append(keyErrors).newline();
+    text.append("Mouse position matches: ").append(positionMatches ? "yes" : "no").newline();
+    text.append("Deterministic: ").append(deterministic ? "yes" : "no").newline();
+    text.append("Latency median: ").append(static_cast<float>(medianMs), 3).append(" ms").newline();
+    text.append("Latency 99%: ").append(static_cast<float>(p99Ms), 3).append(" ms").newline();
+    text.append("Latency max: ").append(static_cast<float>(maxMs), 3).append(" ms").newline();
+    text.append(passed ? "PASSED" : "FAILED").newline();
+
+    fputs(text.c_str(), stdout);
+    fflush(stdout);
+    return passed ? 0 : 1;
+}
+
+int RunKeyboardBenchmark(int frameCount)
+{
+    // Feeds frameCount frames of synthetic key states, each with a few keys
+    // going down or up, through the Keyboard class and finds the pressed
+    // and released keys and the key down set that the application's
+    // UpdateActionMap() needs. Then does the same with the per key byte
+    // array comparisons the Keyboard class used before it kept bit sets.
+    // Both results are checked against each other.
+
+    Keyboard &keyboard = Keyboard::instance();
+    std::vector<unsigned char> states(KEYBOARD_BENCHMARK_STATES * 256, 0);
+    unsigned char byteStates[2][256];
+    unsigned int downBits[8];
+    unsigned int pressedBits[8];
+    unsigned int random = 13579;
+    int frames = frameCount;
+    TextBuffer text;
+
+    // Each state releases one of the keys that are down and presses another.
+
+    int keysDown[KEYBOARD_BENCHMARK_KEYS_DOWN] =
+    {
+        Keyboard::KEY_W, Keyboard::KEY_A, Keyboard::KEY_S, Keyboard::KEY_D
+    };
+
+    for (int i = 0; i < KEYBOARD_BENCHMARK_STATES; ++i)
+    {
+        random = random * 1664525 + 1013904223;
+        keysDown[(random >> 8) % KEYBOARD_BENCHMARK_KEYS_DOWN] = 1 + (random >> 16) % 255;
+
+        for (int j = 0; j < KEYBOARD_BENCHMARK_KEYS_DOWN; ++j)
+            states[i * 256 + keysDown[j]] = 0x80;
+    }
+
+    long long bitsetChanges = 0;
+    unsigned int bitsetChecksum = 0;
+    double startTime = GetTimeInSeconds();
+
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        keyboard.update(&states[(frame % KEYBOARD_BENCHMARK_STATES) * 256]);
+
+        for (int key = keyboard.nextPressedKey(-1); key != -1; key = keyboard.nextPressedKey(key))
+            ++bitsetChanges;
+
+        for (int key = keyboard.nextReleasedKey(-1); key != -1; key = keyboard.nextReleasedKey(key))
+            ++bitsetChanges;
+
+        memcpy(downBits, keyboard.getKeyDownBits(), sizeof(downBits));
+        memcpy(pressedBits, keyboard.getKeyPressedBits(), sizeof(pressedBits));
+
+        for (int i = 0; i < 8; ++i)
+            bitsetChecksum = bitsetChecksum * 31 + (downBits[i] ^ pressedBits[i]);
+    }
+
+    double bitsetSec = GetTimeInSeconds() - startTime;
+    unsigned char *pCurr = byteStates[0];
+    unsigned char *pPrev = byteStates[1];
+    long long byteChanges = 0;
+    unsigned int byteChecksum = 0;
+
+    // Both paths start with all of the keys up.
+
+    memset(byteStates, 0, sizeof(byteStates));
+    startTime = GetTimeInSeconds();
+
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        unsigned char *pTemp = pPrev;
+
+        pPrev = pCurr;
+        pCurr = pTemp;
+        memcpy(pCurr, &states[(frame % KEYBOARD_BENCHMARK_STATES) * 256], 256);
+
+        memset(downBits, 0, sizeof(downBits));
+        memset(pressedBits, 0, sizeof(pressedBits));
+
+        for (int key = 0; key < 256; ++key)
+        {
+            bool down = (pCurr[key] & 0x80) != 0;
+            bool wasDown = (pPrev[key] & 0x80) != 0;
+
+            if (down != wasDown)
+                ++byteChanges;
+
+            if (down)
+                downBits[key >> 5] |= 1U << (key & 31);
+
+            if (down && !wasDown)
+                pressedBits[key >> 5] |= 1U << (key & 31);
+        }
+
+        for (int i = 0; i < 8; ++i)
+            byteChecksum = byteChecksum * 31 + (downBits[i] ^ pressedBits[i]);
+    }
+
+    double byteSec = GetTimeInSeconds() - startTime;
+    double nsPerFrame = frames > 0 ? 1e9 / frames : 0.0;
+
+    text.append("Frames: ").append(frames).newline();
+    text.append("Key changes: ").append(static_cast<int>(bitsetChanges)).newline();
+    text.append("Bit sets: ").append(static_cast<float>(bitsetSec * nsPerFrame), 1).append(" ns/frame").newline();
+    text.append("Byte arrays: ").append(static_cast<float>(byteSec * nsPerFrame), 1).append(" ns/frame").newline();
+    text.append("Speedup: ").append(static_cast<float>(bitsetSec > 0.0 ? byteSec / bitsetSec : 0.0), 2).append("x").newline();
+    text.append("Results match: ").append((bitsetChanges == byteChanges && bitsetChecksum == byteChecksum) ? "yes" : "no").newline();
+
+    fputs(text.c_str(), stdout);
+    fflush(stdout);
+    return (bitsetChanges == byteChanges && bitsetChecksum == byteChecksum) ? 0 : 1;
+}
+
+int RunMouseFilterBenchmark(int seconds)
+{
+    // Every report of the given number of seconds of a synthetic 8 kHz
+    // mouse is fed to the Mouse class's filters as if it was a frame of its
+    // own. That's the load the filters are under when they filter every
+    // report of a raw input mouse. The same reports are
+    // then run through the original filter, which shifted the whole history
+    // buffer along and recomputed the weights and the weighted sum on every
+    // update. Both are followed by the same two sample smoothing, and their
+    // results are compared.
+
+    SyntheticInputSource source;
+    InputEventQueue queue;
+    std::vector<MouseReport> reports;
+    std::vector<float> filteredX;
+    std::vector<float> filteredY;
+    TextBuffer text;
+    double endTime = seconds;
+
+    reports.reserve(static_cast<size_t>(endTime * MOUSE_FILTER_BENCHMARK_RATE));
+    source.create(0.0, MOUSE_FILTER_BENCHMARK_RATE, 0.0f, 1);
+    source.setEventQueue(&queue);
+
+    // Stay well clear of the queue's capacity.
+
+    for (double time = 0.01; time < endTime + 0.01; time += 0.01)
+    {
+        source.update((std::min)(time, endTime));
+        ReadMouseReports(queue, reports);
+    }
+
+    int reportCount = static_cast<int>(reports.size());
+    double nsPerReport = reportCount > 0 ? 1e9 / reportCount : 0.0;
+    Mouse &mouse = Mouse::instance();
+    float weight = mouse.weightModifier();
+    bool passed = reportCount > 0;
+
+    filteredX.resize(reportCount);
+    filteredY.resize(reportCount);
+
+    text.append("Seconds: ").append(seconds).newline();
+    text.append("Reports: ").append(reportCount).newline();
+
+    mouse.smoothMouse(true);
+    mouse.setRawInput(false);
+
+    for (int run = 0; run < 3; ++run)
+    {
+        int history = MOUSE_FILTER_BENCHMARK_HISTORY_SIZES[run];
+        DIMOUSESTATE state = {0};
+
+        // The Mouse class's ring buffer with the recursive weighted sum.
+        // Changing the history size starts with clean filters.
+
+        mouse.setHistoryBufferSize(history);
+
+        double startTime = GetTimeInSeconds();
+
+        for (int i = 0; i < reportCount; ++i)
+        {
+            state.lX = reports[i].x;
+            state.lY = reports[i].y;
+
+            mouse.update(state);
+            filteredX[i] = mouse.xPosRelative();
+            filteredY[i] = mouse.yPosRelative();
+        }
+
+        double ringSec = GetTimeInSeconds() - startTime;
+
+        // The original filter.
+
+        std::vector<float> historyX(history, 0.0f);
+        std::vector<float> historyY(history, 0.0f);
+        float prevX = 0.0f;
+        float prevY = 0.0f;
+        float maxError = 0.0f;
+
+        startTime = GetTimeInSeconds();
+
+        for (int i = 0; i < reportCount; ++i)
+        {
+            for (int j = history - 1; j > 0; --j)
+            {
+                historyX[j] = historyX[j - 1];
+                historyY[j] = historyY[j - 1];
+            }
+
+            historyX[0] = static_cast<float>(reports[i].x);
+            historyY[0] = static_cast<float>(reports[i].y);
+
+            float averageX = 0.0f;
+            float averageY = 0.0f;
+            float averageTotal = 0.0f;
+            float currentWeight = 1.0f;
+
+            for (int j = 0; j < history; ++j)
+            {
+                averageX += historyX[j] * currentWeight;
+                averageY += historyY[j] * currentWeight;
+                averageTotal += currentWeight;
+                currentWeight *= weight;
+            }
+
+            averageX /= averageTotal;
+            averageY /= averageTotal;
+
+            float x = (averageX + prevX) * 0.5f;
+            float y = (averageY + prevY) * 0.5f;
+
+            prevX = averageX;
+            prevY = averageY;
+
+            maxError = (std::max)(maxError, (std::max)(fabsf(x - filteredX[i]), fabsf(y - filteredY[i])));
+        }
+
+        double shiftSec = GetTimeInSeconds() - startTime;
+
+        if (maxError > MOUSE_FILTER_BENCHMARK_MAX_ERROR)
+            passed = false;
+
+        text.append("History ").append(history).append(": ring buffer ")
+            .append(static_cast<float>(ringSec * nsPerReport), 1).append(" ns/report, shifting ")
+            .append(static_cast<float>(shiftSec * nsPerReport), 1).append(" ns/report, speedup ")
+            .append(static_cast<float>(ringSec > 0.0 ? shiftSec / ringSec : 0.0), 2).append("x, max error ")
+            .append(maxError, 7).newline();
+    }
+
+    text.append(passed ? "PASSED" : "FAILED").newline();
+
+    fputs(text.c_str(), stdout);
+    fflush(stdout);
+    return passed ? 0 : 1;
+}
+
+int RunPredictionTest(const char *pszFilename)
+{
+    // Replays the input log through the camera the way the application does,
+    // runs the camera predictor the way its SimulateFrame() does, and
+    // predicts each frame's pose PREDICTION_TEST_FRAME_LATENCY frames ahead
+    // the way its UpdateFrameState() does. Each prediction is compared with
+    // the pose the camera actually reaches by then, interpolated between the
+    // frames around it, and so is the unpredicted pose that would be
+    // displayed without prediction. Predictions made across a behavior
+    // change aren't compared, and orbit and follow cameras aren't predicted
+    // since the camera rig moves them. Prediction must not be less accurate
+    // than no prediction on average.
+
+    CameraReplay replay;
+    TextBuffer text;
+
+    if (!replay.open(pszFilename))
+    {
+        text.append("Failed to open the input log ").append(pszFilename).newline();
+        text.append("FAILED").newline();
+        fputs(text.c_str(), stdout);
+        fflush(stdout);
+        return 1;
+    }
+
+    std::vector<double> times;
+    std::vector<D3DXVECTOR3> eyes;
+    std::vector<D3DXQUATERNION> orientations;
+    std::vector<double> predictedTimes;
+    std::vector<D3DXVECTOR3> predictedEyes;
+    std::vector<D3DXQUATERNION> predictedOrientations;
+    std::vector<int> resetFrames;
+    CameraPredictor predictor;
+    double time = 0.0;
+    double predictSec = 0.0;
+    double confidenceSum = 0.0;
+
+    while (replay.update())
+    {
+        const Camera &camera = replay.getCamera();
+
+        if (replay.isBehaviorChanged())
+        {
+            // As in ToggleFlightMode() and CycleCameraMode().
+
+            predictor.reset();
+            resetFrames.push_back(static_cast<int>(times.size()));
+        }
+
+        // As in SimulateFrame() and UpdateFrameState().
+
+        float elapsedTimeSec = replay.getElapsedTimeSec();
+        Camera predicted;
+        double startTime = GetTimeInSeconds();
+
+        predictor.update(elapsedTimeSec, camera);
+        predicted = camera;
+
+        if (!CameraRig::isRigged(camera))
+        {
+            predictor.predict(elapsedTimeSec * PREDICTION_TEST_FRAME_LATENCY, predicted);
+            replay.getController().clampToBounds(predicted);
+        }
+
+        predictSec += GetTimeInSeconds() - startTime;
+        confidenceSum += predictor.getConfidence();
+        time += elapsedTimeSec;
+
+        times.push_back(time);
+        eyes.push_back(camera.getPosition());
+        orientations.push_back(camera.getOrientation());
+        predictedTimes.push_back(time + elapsedTimeSec * PREDICTION_TEST_FRAME_LATENCY);
+        predictedEyes.push_back(predicted.getPosition());
+        predictedOrientations.push_back(predicted.getOrientation());
+    }
+
+    // Compare each frame's predicted and unpredicted poses with the actual
+    // pose at the predicted time.
+
+    int frames = static_cast<int>(times.size());
+    std::vector<float> positionErrors[2];
+    std::vector<float> angleErrors[2];
+    double leadSec = 0.0;
+    int nextReset = 0;
+
+    for (int i = 0; i < frames; ++i)
+    {
+        double targetTime = predictedTimes[i];
+        int next = i;
+
+        while (next < frames && times[next] < targetTime)
+            ++next;
+
+        if (next == frames)
+            break;
+
+        while (nextReset < static_cast<int>(resetFrames.size()) && resetFrames[nextReset] <= i)
+            ++nextReset;
+
+        if (nextReset < static_cast<int>(resetFrames.size()) && resetFrames[nextReset] <= next)
+            continue;
+
+        int previous = (std::max)(next - 1, i);
+        double span = times[next] - times[previous];
+        float t = (span > 0.0) ? static_cast<float>((targetTime - times[previous]) / span) : 1.0f;
+        D3DXVECTOR3 actualEye = eyes[previous] + (eyes[next] - eyes[previous]) * t;
+        D3DXQUATERNION actualOrientation;
+
+        D3DXQuaternionSlerp(&actualOrientation, &orientations[previous], &orientations[next], t);
+        leadSec += targetTime - times[i];
+
+        for (int predicted = 0; predicted < 2; ++predicted)
+        {
+            const D3DXVECTOR3 &eye = predicted ? predictedEyes[i] : eyes[i];
+            const D3DXQUATERNION &orientation = predicted ? predictedOrientations[i] : orientations[i];
+            D3DXVECTOR3 offset = eye - actualEye;
+            float cosHalfAngle = (std::min)(fabsf(D3DXQuaternionDot(&orientation, &actualOrientation)), 1.0f);
+
+            positionErrors[predicted].push_back(D3DXVec3Length(&offset));
+            angleErrors[predicted].push_back(D3DXToDegree(2.0f * acosf(cosHalfAngle)));
+        }
+    }
+
+    int compared = static_cast<int>(positionErrors[0].size());
+    float meanPositionError[2] = {0.0f, 0.0f};
+    float meanAngleError[2] = {0.0f, 0.0f};
+
+    text.append("Input log: ").append(pszFilename).newline();
+    text.append("Frames: ").append(frames).newline();
+    text.append("Seconds: ").append(static_cast<float>(time), 1).newline();
+    text.append("Predictions compared: ").append(compared).newline();
+    text.append("Mean lead time: ").append(static_cast<float>(leadSec * 1000.0 / (std::max)(compared, 1)), 1).append(" ms").newline();
+    text.append("Mean confidence: ").append(static_cast<float>(confidenceSum / (std::max)(frames, 1)), 2).newline();
+    text.append("Prediction cost: ").append(static_cast<float>(predictSec * 1e9 / (std::max)(frames, 1)), 1).append(" ns/frame").newline();
+
+    for (int predicted = 0; predicted < 2; ++predicted)
+    {
+        std::vector<float> &positions = positionErrors[predicted];
+        std::vector<float> &angles = angleErrors[predicted];
+
+        for (int i = 0; i < compared; ++i)
+        {
+            meanPositionError[predicted] += positions[i] / compared;
+            meanAngleError[predicted] += angles[i] / compared;
+        }
+
+        std::sort(positions.begin(), positions.end());
+        std::sort(angles.begin(), angles.end());
+
+        int p95 = (compared - 1) * 95 / 100;
+
+        text.newline();
+        text.append(predicted ? "With prediction" : "Without prediction").newline();
+
+        if (compared == 0)
+            continue;
+
+        text.append("  Position error: mean ").append(meanPositionError[predicted] * 1000.0f, 1)
+            .append(" mm, 95% ").append(positions[p95] * 1000.0f, 1)
+            .append(" mm, max ").append(positions.back() * 1000.0f, 1).append(" mm").newline();
+        text.append("  Angle error: mean ").append(meanAngleError[predicted], 2)
+            .append(" degrees, 95% ").append(angles[p95], 2)
+            .append(" degrees, max ").append(angles.back(), 2).append(" degrees").newline();
+    }
+
+    bool passed = compared > 0 && meanPositionError[1] <= meanPositionError[0] &&
+        meanAngleError[1] <= meanAngleError[0];
+
+    text.newline();
+    text.append(passed ? "PASSED" : "FAILED").newline();
+
+    fputs(text.c_str(), stdout);
+    fflush(stdout);
+    return passed ? 0 : 1;
+}
+
+int RunRawMouseBenchmark(int seconds)
+{
+    // A synthetic 8 kHz mouse is run for the given number of seconds at 60
+    // frames a second. Its events are grouped back into device reports the
+    // same way the Mouse class's readBufferedData() does it, and the reports
+    // are then fed to the Mouse class's filters once per frame (the polled
+    // path) and once per report (the raw input path).
+    //
+    // The lag the filters add is measured while the mouse is moving: it is
+    // how far the filtered mouse position is behind the true position,
+    // divided by the mouse's speed.
+
+    SyntheticInputSource source;
+    InputEventQueue queue;
+    std::vector<MouseReport> reports;
+    std::vector<int> frameFirstReport;
+    std::vector<DIMOUSESTATE> frameStates;
+    std::vector<int> truePositions;
+    TextBuffer text;
+    int frames = static_cast<int>(seconds / RAW_MOUSE_BENCHMARK_FRAME_TIME + 0.5f);
+
+    reports.reserve(static_cast<size_t>(seconds * RAW_MOUSE_BENCHMARK_RATE));
+    source.create(0.0, RAW_MOUSE_BENCHMARK_RATE, 0.0f, 1);
+    source.setEventQueue(&queue);
+
+    double groupingSec = 0.0;
+
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        DIMOUSESTATE state = {0};
+
+        source.update((frame + 1) * static_cast<double>(RAW_MOUSE_BENCHMARK_FRAME_TIME));
+        frameFirstReport.push_back(static_cast<int>(reports.size()));
+
+        double startTime = GetTimeInSeconds();
+
+        ReadMouseReports(queue, reports);
+        groupingSec += GetTimeInSeconds() - startTime;
+
+        for (int i = frameFirstReport.back(); i < static_cast<int>(reports.size()); ++i)
+        {
+            state.lX += reports[i].x;
+            state.lY += reports[i].y;
+        }
+
+        frameStates.push_back(state);
+        truePositions.push_back(source.getMouseX());
+    }
+
+    frameFirstReport.push_back(static_cast<int>(reports.size()));
+
+    int reportCount = static_cast<int>(reports.size());
+    double nsPerReport = reportCount > 0 ? 1e9 / reportCount : 0.0;
+    double nsPerFrame = frames > 0 ? 1e9 / frames : 0.0;
+
+    text.append("Seconds: ").append(seconds).newline();
+    text.append("Frames: ").append(frames).newline();
+    text.append("Reports: ").append(reportCount).newline();
+    text.append("Grouping events into reports: ")
+        .append(static_cast<float>(groupingSec * nsPerReport), 1).append(" ns/report, ")
+        .append(static_cast<float>(groupingSec * nsPerFrame / 1000.0), 2).append(" us/frame, ")
+        .append(static_cast<float>(groupingSec * nsPerFrame / 1e7 / RAW_MOUSE_BENCHMARK_FRAME_TIME), 3)
+        .append("% of a frame").newline();
+
+    // The per report filters are run with the default history and with a
+    // history that covers about as much time as the default per frame one.
+
+    Mouse &mouse = Mouse::instance();
+    int reportsPerFrame = static_cast<int>(RAW_MOUSE_BENCHMARK_RATE * RAW_MOUSE_BENCHMARK_FRAME_TIME + 0.5f);
+    int history = mouse.historyBufferSize();
+    int historySizes[3] = {history, history, history * reportsPerFrame};
+    bool perReport[3] = {false, true, true};
+    std::vector<double> lags;
+
+    lags.reserve(frames);
+    mouse.smoothMouse(true);
+
+    for (int run = 0; run < 3; ++run)
+    {
+        // Changing the mode and the history size starts with clean filters.
+
+        mouse.setRawInput(!perReport[run]);
+        mouse.setRawInput(perReport[run]);
+        mouse.setHistoryBufferSize(historySizes[run]);
+        lags.clear();
+
+        double filteredX = 0.0;
+        double updateSec = 0.0;
+
+        for (int frame = 0; frame < frames; ++frame)
+        {
+            int first = frameFirstReport[frame];
+            int count = frameFirstReport[frame + 1] - first;
+            double startTime = GetTimeInSeconds();
+
+            mouse.update(frameStates[frame], 0, perReport[run], count ? &reports[first] : 0, count);
+            updateSec += GetTimeInSeconds() - startTime;
+            filteredX += mouse.xPosRelative();
+
+            if (frame == 0)
+                continue;
+
+            double speed = (truePositions[frame] - truePositions[frame - 1]) / RAW_MOUSE_BENCHMARK_FRAME_TIME;
+
+            if (fabs(speed) >= RAW_MOUSE_BENCHMARK_MIN_SPEED)
+                lags.push_back((truePositions[frame] - filteredX) / speed);
+        }
+
+        std::sort(lags.begin(), lags.end());
+
+        double lagMs = lags.empty() ? 0.0 : lags[lags.size() / 2] * 1000.0;
+
+        text.append(perReport[run] ? "Per report" : "Per frame").append(", history ")
+            .append(historySizes[run]).append(": ");
+
+        if (perReport[run])
+        {
+            text.append(static_cast<float>(updateSec * nsPerReport), 1).append(" ns/report, ")
+                .append(static_cast<float>(updateSec * nsPerFrame / 1000.0), 2).append(" us/frame, ")
+                .append(static_cast<float>(updateSec > 0.0 ? reportCount / updateSec / 1e6 : 0.0), 1)
+                .append(" million reports/s, ");
+        }
+        else
+        {
+            text.append(static_cast<float>(updateSec * nsPerFrame), 1).append(" ns/frame, ");
+        }
+
+        text.append(static_cast<float>(lagMs), 2).append(" ms lag").newline();
+    }
+
+    fputs(text.c_str(), stdout);
+    fflush(stdout);
+    return 0;
+}
+
+int RunSyntheticInputRecorder(const char *pszFilename)
+{
+    // Records SYNTHETIC_LOG_SECONDS seconds of the synthetic mouse and
+    // keyboard at 60 frames a second to an input log in the format the
+    // application's -record option writes, e.g., for RunPredictionTest().
+    // The mouse's movement is recorded once per frame, as without -rawmouse.
+    // The same log is written every time.
+
+    SyntheticInputSource source;
+    InputEventQueue queue;
+    InputRecorder recorder;
+    InputFrame frame;
+    InputEvent event;
+    TextBuffer text;
+    int frames = static_cast<int>(SYNTHETIC_LOG_SECONDS / SYNTHETIC_LOG_FRAME_TIME + 0.5f);
+    int mouseX = 0;
+    int mouseY = 0;
+    bool passed = recorder.open(pszFilename);
+
+    source.create(0.0, SYNTHETIC_LOG_MOUSE_RATE, SYNTHETIC_LOG_KEY_RATE, SYNTHETIC_LOG_SEED);
+    source.setEventQueue(&queue);
+
+    memset(&frame, 0, sizeof(frame));
+    frame.elapsedTimeSec = SYNTHETIC_LOG_FRAME_TIME;
+
+    for (int i = 0; passed && i < frames; ++i)
+    {
+        source.update((i + 1) * static_cast<double>(SYNTHETIC_LOG_FRAME_TIME));
+
+        memset(frame.keyTaps, 0, sizeof(frame.keyTaps));
+
+        while (queue.pop(event))
+        {
+            if (event.type == InputEvent::KEY_DOWN)
+            {
+                frame.keyStates[event.code] = 0x80;
+                frame.keyTaps[event.code] = 0x80;
+            }
+            else if (event.type == InputEvent::KEY_UP)
+            {
+                frame.keyStates[event.code] = 0;
+            }
+        }
+
+        // Scaling the mouse's position rather than its per frame movement
+        // keeps the rounding errors from adding up.
+
+        frame.mouseX = source.getMouseX() / SYNTHETIC_LOG_MOUSE_DIVISOR - mouseX;
+        frame.mouseY = source.getMouseY() / SYNTHETIC_LOG_MOUSE_DIVISOR - mouseY;
+        mouseX += frame.mouseX;
+        mouseY += frame.mouseY;
+
+        passed = recorder.write(frame);
+    }
+
+    recorder.close();
+
+    text.append("Input log: ").append(pszFilename).newline();
+    text.append("Frames: ").append(passed ? frames : 0).newline();
+    text.append("Key presses: ").append(source.getKeyPressCount()).newline();
+    text.append("Mouse reports: ").append(source.getMouseReportCount()).newline();
+    text.append(passed ? "PASSED" : "FAILED").newline();
+
+    fputs(text.c_str(), stdout);
+    fflush(stdout);
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,441 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+//
+// A console front end for the headless tests and benchmarks (see
+// camera_bench.h). Each run performs a single test or benchmark, selected by
+// its option, and exits with 0 if it passed and 1 if it didn't. Like the
+// camera server it builds with Visual C++ on Windows and with CMake
+// everywhere else, and CMakeLists.txt runs the quick ones as tests.
+//-----------------------------------------------------------------------------
+
+#if defined(_MSC_VER)
+#pragma comment(lib, "d3dx9.lib")
+#pragma comment(lib, "dinput8.lib")
+#pragma comment(lib, "dxguid.lib")
+#endif
+
+#include <cstdio>
+#include <cstring>
+
+#include "camera_bench.h"
+
+//-----------------------------------------------------------------------------
+// Constants.
+//-----------------------------------------------------------------------------
+
+const char USAGE_TEXT[] =
+    "Usage: camera_bench <option> [-jobthreads <n>] [-pinthreads] [-reversez]\n"
+    "                    [-infinitefar]\n"
+    "  -actionmap <n>      Replays n frames of synthetic keyboard and mouse input\n"
+    "                      through the action map and through the hardcoded key\n"
+    "                      checks it replaced, checks that both move the camera\n"
+    "                      the same way and trigger the same actions, and\n"
+    "                      reports the cost of evaluating 512 bindings.\n"
+    "  -bake <size>        Bakes a size x size normal map for the floor from a\n"
+    "                      bumpy high polygon floor, reports the baking rate,\n"
+    "                      and saves it as baked_normal_map.dds.\n"
+    "  -deferredlights <n> Shades a 1280x720 G-buffer lit by n point lights with\n"
+    "                      the CPU reference of the lighting pass, and reports\n"
+    "                      the shading cost per pixel and the lights shaded per\n"
+    "                      pixel.\n"
+    "  -hudbench <n>       Formats n frames of on screen statistics with\n"
+    "                      std::ostringstream, with TextBuffer, and only when\n"
+    "                      they change, checks the texts match, and reports\n"
+    "                      the formatting and GDI layout costs per frame. The\n"
+    "                      GDI layout is only measured on Windows.\n"
+    "  -inputevents <n>    A synthetic 8 kHz mouse and keyboard generate input\n"
+    "                      events on a thread of their own for n seconds. The\n"
+    "                      main thread consumes them and checks their order and\n"
+    "                      contents, and reports the event latency.\n"
+    "  -jobbench <n>       Runs n empty jobs, n jobs doing a fixed amount of\n"
+    "                      work, and a parallel city mesh build with 1, 2, 4,\n"
+    "                      ... threads, and checks the city against a serial\n"
+    "                      build.\n"
+    "  -jobthreads <n>     Number of job system worker threads. Defaults to one\n"
+    "                      per processor, minus one for the main thread.\n"
+    "  -keybench <n>       Finds the pressed and released keys in n frames of\n"
+    "                      synthetic keyboard input using the keyboard's bit\n"
+    "                      sets and using per key byte array comparisons,\n"
+    "                      checks both agree, and reports both costs.\n"
+    "  -materials <n>      Fills a material table with n materials, changes some\n"
+    "                      of them and sorts a scene's draws by material each\n"
+    "                      frame, and reports the bytes uploaded and the\n"
+    "                      material switches.\n"
+    "  -occlusion <n>      Builds a synthetic city of n x n blocks, flies a camera\n"
+    "                      down its streets, and reports the software occlusion\n"
+    "                      culler's rasterization time and cull rate.\n"
+    "  -mousefilter <n>    Filters n seconds of a synthetic 8 kHz mouse's reports\n"
+    "                      with history sizes of 10, 80 and 800 reports, using\n"
+    "                      the mouse's ring buffer and the original shifting\n"
+    "                      history buffer, and reports both costs and how far\n"
+    "                      the results differ.\n"
+    "  -pinthreads         Pins each worker thread to its own processor.\n"
+    "  -pipelinebench <n>  Runs n frames of synthetic simulation and render work\n"
+    "                      through the frame pipeline, inline and pipelined,\n"
+    "                      and reports the throughput and the input to rendered\n"
+    "                      latency.\n"
+    "  -predictiontest <file>\n"
+    "                      Replays an input log recorded with the application's\n"
+    "                      -record option or with -recordsynthetic, predicts\n"
+    "                      the camera pose at display time on every frame, and\n"
+    "                      reports the position and angle errors at display\n"
+    "                      time with and without prediction. Fails if\n"
+    "                      prediction is less accurate on average.\n"
+    "  -rawmousebench <n>  Feeds n seconds of a synthetic 8 kHz mouse to the mouse\n"
+    "                      filters, once filtering the per frame movement and\n"
+    "                      once filtering every device report, and reports the\n"
+    "                      cost and the lag the filters add in both cases.\n"
+    "  -recordsynthetic <file>\n"
+    "                      Records a minute of a synthetic mouse and keyboard\n"
+    "                      to an input log, e.g., for -predictiontest.\n"
+    "  -shaderstartup <n>  Compiles normal_mapping.fx n times with an empty\n"
+    "                      shader cache and n times with a full one, and\n"
+    "                      reports the cold and warm start compile times.\n"
+    "                      Windows only. Run it from the directory with\n"
+    "                      normal_mapping.fx in it.\n"
+    "  -shadowlights <n>   Culls a synthetic city's buildings against n spot\n"
+    "                      lights' shadow frustums, caches their shadow maps\n"
+    "                      in an atlas, and reports the costs, including the\n"
+    "                      CPU reference shadowing.\n"
+    "  -taatest <n>        Ray casts n frames of a moving camera and object with\n"
+    "                      a jittered projection, resolves them with and\n"
+    "                      without the object's motion vectors, and reports\n"
+    "                      the errors against a supersampled reference and the\n"
+    "                      cost. Fails if the resolve doesn't beat no\n"
+    "                      anti-aliasing, or the object's motion vectors don't\n"
+    "                      reduce the error around it.\n"
+    "  -trackbench <n>     Records an n second synthetic flight, compresses it\n"
+    "                      with per block and with whole track position\n"
+    "                      quantization, checks the errors against the recorded\n"
+    "                      path, and reports the sizes and the loading and\n"
+    "                      playback rates.\n"
+    "  -viewsbench <n>     Updates every camera set layout and culls n random\n"
+    "                      spheres against its views, checks the matrices and\n"
+    "                      the culling against unoptimized versions, and\n"
+    "                      reports the matrix and culling costs per view set.\n"
+    "  -depthprecision <n> Projects distances from the near plane out to n units\n"
+    "                      with every depth mode, stores them as 24 bit fixed\n"
+    "                      point and 32 bit float depths, and reports the depth\n"
+    "                      resolution per decade of distance and how well\n"
+    "                      linearizeDepth() recovers the distances. Fails if\n"
+    "                      reverse-Z with a float depth buffer loses precision.\n"
+    "  -integrator <n>     Moves the camera through n random time steps of up\n"
+    "                      to 2 seconds each, checks the closed form integrator\n"
+    "                      against a 10 us step numerical reference, and\n"
+    "                      reports the cost of one call per step against\n"
+    "                      catching up in 1 ms steps.\n"
+    "  -policybench <n>    Feeds n random camera inputs to a BasicCamera of every\n"
+    "                      behavior policy and to a Camera switched to the same\n"
+    "                      behavior, checks they end up with the same view\n"
+    "                      matrix, and reports the cost per update of each.\n"
+    "  -rigtest <n>        Steps orbit and follow camera rigs through a sudden\n"
+    "                      jump with 1, 16 and 1000 ms frames, checks that they\n"
+    "                      settle on the goal without overshooting whatever\n"
+    "                      the frame time, and reports the cost of n follow\n"
+    "                      updates with and without obstacles.\n"
+    "  -worldprecision <n> Views random points from n random camera poses in a\n"
+    "                      scene 1e3 to 1e7 units from the origin, drawn in\n"
+    "                      float and camera relative, and reports the errors\n"
+    "                      and the cost per frame of each. Fails if camera\n"
+    "                      relative errors reach a millimetre, or if orbit\n"
+    "                      cameras leave the bounds around the scene.\n"
+    "  -reversez           Uses reversed depth for the cameras' projections.\n"
+    "  -infinitefar        Moves the cameras' far plane out to infinity.\n";
+
+//-----------------------------------------------------------------------------
+// Functions.
+//-----------------------------------------------------------------------------
+
+bool ParseCount(const char *pszArg, int minValue, int &value)
+{
+    int count = 0;
+    char extra = 0;
+
+    if (!pszArg || sscanf(pszArg, "%d%c", &count, &extra) != 1 || count < minValue)
+        return false;
+
+    value = count;
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    int actionMapTestFrames = 0;
+    int bakeSize = 0;
+    int deferredBenchmarkLights = 0;
+    int hudBenchmarkFrames = 0;
+    int inputEventTestSeconds = 0;
+    int jobBenchmarkCount = 0;
+    int jobThreadCount = -1;
+    bool pinJobThreads = false;
+    int keyboardBenchmarkFrames = 0;
+    int materialBenchmarkCount = 0;
+    int mouseFilterBenchmarkSeconds = 0;
+    int occlusionCitySize = 0;
+    int pipelineBenchmarkFrames = 0;
+    const char *pszPredictionTestFilename = 0;
+    int rawMouseBenchmarkSeconds = 0;
+    const char *pszSyntheticLogFilename = 0;
+    int shaderStartupRuns = 0;
+    int shadowBenchmarkLights = 0;
+    int temporalTestFrames = 0;
+    int cameraTrackBenchmarkSeconds = 0;
+    int cameraSetBenchmarkSpheres = 0;
+    Camera::DepthMode depthMode = Camera::DEPTH_MODE_STANDARD;
+    int depthPrecisionTestFar = 0;
+    int integratorTestCases = 0;
+    int cameraPolicyBenchmarkUpdates = 0;
+    int cameraRigTestUpdates = 0;
+    int worldPrecisionTestPoses = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char *pszOption = argv[i];
+        const char *pszArg = (i + 1 < argc) ? argv[i + 1] : 0;
+        bool valid = true;
+
+        if (strcmp(pszOption, "-actionmap") == 0)
+        {
+            valid = ParseCount(pszArg, 1, actionMapTestFrames);
+            ++i;
+        }
+        else if (strcmp(pszOption, "-bake") == 0)
+        {
+            valid = ParseCount(pszArg, 1, bakeSize);
+            ++i;
+        }
+        else if (strcmp(pszOption, "-deferredlights") == 0)
+        {
+            valid = ParseCount(pszArg, 1, deferredBenchmarkLights);
+            ++i;
+        }
+        else if (strcmp(pszOption, "-hudbench") == 0)
+        {
+            valid = ParseCount(pszArg, 1, hudBenchmarkFrames);
+            ++i;
+        }
+        else if (strcmp(pszOption, "-inputevents") == 0)
+        {
+            valid = ParseCount(pszArg, 1, inputEventTestSeconds);
+            ++i;
+        }
+        else if (strcmp(pszOption, "-jobbench") == 0)
+        {
+            valid = ParseCount(pszArg, 1, jobBenchmarkCount);
+            ++i;
+        }
+        else if (strcmp(pszOption, "-keybench") == 0)
+        {
+            valid = ParseCount(pszArg, 1, keyboardBenchmarkFrames);
+            ++i;
+        }
+        else if (strcmp(pszOption, "-materials") == 0)
+        {
+            valid = ParseCount(pszArg, 1, materialBenchmarkCount);
+            ++i;
+        }
+        else if (strcmp(pszOption, "-mousefilter") == 0)
+        {
+            valid = ParseCount(pszArg, 1, mouseFilterBenchmarkSeconds);
+            ++i;
+        }
+        else if (strcmp(pszOption, "-occlusion") == 0)
+        {
+            valid = ParseCount(pszArg, 1, occlusionCitySize);
+            ++i;
+        }
+        else if (strcmp(pszOption, "-pipelinebench") == 0)
+        {
+            valid = ParseCount(pszArg, 1, pipelineBenchmarkFrames);
+            ++i;
+        }
+        else if (strcmp(pszOption, "-predictiontest") == 0)
+        {
+            pszPredictionTestFilename = pszArg;
+            valid = pszArg != 0;
+            ++i;
+        }
+        else if (strcmp(pszOption, "-rawmousebench") == 0)
+        {
+            valid = ParseCount(pszArg, 1, rawMouseBenchmarkSeconds);
+            ++i;
+        }
+        else if (strcmp(pszOption, "-recordsynthetic") == 0)
+        {
+            pszSyntheticLogFilename = pszArg;
+            valid = pszArg != 0;
+            ++i;
+        }
+        else if (strcmp(pszOption, "-shaderstartup") == 0)
+        {
+            valid = ParseCount(pszArg, 1, shaderStartupRuns);
+            ++i;
+        }
+        else if (strcmp(pszOption, "-shadowlights") == 0)
+        {
+            valid = ParseCount(pszArg, 1, shadowBenchmarkLights);
+            ++i;
+        }
+        else if (strcmp(pszOption, "-taatest") == 0)
+        {
+            valid = ParseCount(pszArg, 1, temporalTestFrames);
+            ++i;
+        }
+        else if (strcmp(pszOption, "-trackbench") == 0)
+        {
+            valid = ParseCount(pszArg, 1, cameraTrackBenchmarkSeconds);
+            ++i;
+        }
+        else if (strcmp(pszOption, "-viewsbench") == 0)
+        {
+            valid = ParseCount(pszArg, 1, cameraSetBenchmarkSpheres);
+            ++i;
+        }
+        else if (strcmp(pszOption, "-depthprecision") == 0)
+        {
+            valid = ParseCount(pszArg, 1, depthPrecisionTestFar);
+            ++i;
+        }
+        else if (strcmp(pszOption, "-integrator") == 0)
+        {
+            valid = ParseCount(pszArg, 1, integratorTestCases);
+            ++i;
+        }
+        else if (strcmp(pszOption, "-policybench") == 0)
+        {
+            valid = ParseCount(pszArg, 1, cameraPolicyBenchmarkUpdates);
+            ++i;
+        }
+        else if (strcmp(pszOption, "-rigtest") == 0)
+        {
+            valid = ParseCount(pszArg, 1, cameraRigTestUpdates);
+            ++i;
+        }
+        else if (strcmp(pszOption, "-worldprecision") == 0)
+        {
+            valid = ParseCount(pszArg, 1, worldPrecisionTestPoses);
+            ++i;
+        }
+        else if (strcmp(pszOption, "-reversez") == 0)
+        {
+            depthMode = static_cast<Camera::DepthMode>(depthMode | Camera::DEPTH_MODE_REVERSE_Z);
+        }
+        else if (strcmp(pszOption, "-infinitefar") == 0)
+        {
+            depthMode = static_cast<Camera::DepthMode>(depthMode | Camera::DEPTH_MODE_INFINITE_FAR);
+        }
+        else if (strcmp(pszOption, "-jobthreads") == 0)
+        {
+            valid = ParseCount(pszArg, 0, jobThreadCount);
+            ++i;
+        }
+        else if (strcmp(pszOption, "-pinthreads") == 0)
+        {
+            pinJobThreads = true;
+        }
+        else
+        {
+            valid = false;
+        }
+
+        if (!valid)
+        {
+            fprintf(stderr, "Invalid option: %s\n\n%s", pszOption, USAGE_TEXT);
+            return 1;
+        }
+    }
+
+    if (actionMapTestFrames > 0)
+        return RunActionMapTest(actionMapTestFrames);
+
+    if (bakeSize > 0)
+        return RunNormalMapBaker(bakeSize, jobThreadCount, pinJobThreads);
+
+    if (deferredBenchmarkLights > 0)
+        return RunDeferredBenchmark(deferredBenchmarkLights, jobThreadCount, pinJobThreads);
+
+    if (hudBenchmarkFrames > 0)
+        return RunHudBenchmark(hudBenchmarkFrames);
+
+    if (inputEventTestSeconds > 0)
+        return RunInputEventTest(inputEventTestSeconds);
+
+    if (jobBenchmarkCount > 0)
+        return RunJobBenchmark(jobBenchmarkCount, jobThreadCount, pinJobThreads);
+
+    if (keyboardBenchmarkFrames > 0)
+        return RunKeyboardBenchmark(keyboardBenchmarkFrames);
+
+    if (materialBenchmarkCount > 0)
+        return RunMaterialBenchmark(materialBenchmarkCount);
+
+    if (mouseFilterBenchmarkSeconds > 0)
+        return RunMouseFilterBenchmark(mouseFilterBenchmarkSeconds);
+
+    if (occlusionCitySize > 0)
+        return RunOcclusionBenchmark(occlusionCitySize, jobThreadCount, pinJobThreads);
+
+    if (pipelineBenchmarkFrames > 0)
+        return RunPipelineBenchmark(pipelineBenchmarkFrames, jobThreadCount, pinJobThreads);
+
+    if (pszPredictionTestFilename)
+        return RunPredictionTest(pszPredictionTestFilename);
+
+    if (rawMouseBenchmarkSeconds > 0)
+        return RunRawMouseBenchmark(rawMouseBenchmarkSeconds);
+
+    if (pszSyntheticLogFilename)
+        return RunSyntheticInputRecorder(pszSyntheticLogFilename);
+
+    if (shaderStartupRuns > 0)
+        return RunShaderStartupBenchmark(shaderStartupRuns);
+
+    if (shadowBenchmarkLights > 0)
+        return RunShadowBenchmark(shadowBenchmarkLights, jobThreadCount, pinJobThreads);
+
+    if (temporalTestFrames > 0)
+        return RunTemporalResolveTest(temporalTestFrames);
+
+    if (cameraSetBenchmarkSpheres > 0)
+        return RunCameraSetBenchmark(cameraSetBenchmarkSpheres, depthMode);
+
+    if (cameraTrackBenchmarkSeconds > 0)
+        return RunCameraTrackBenchmark(cameraTrackBenchmarkSeconds);
+
+    if (depthPrecisionTestFar > 0)
+        return RunDepthPrecisionTest(depthPrecisionTestFar);
+
+    if (integratorTestCases > 0)
+        return RunIntegratorTest(integratorTestCases);
+
+    if (cameraPolicyBenchmarkUpdates > 0)
+        return RunCameraPolicyBenchmark(cameraPolicyBenchmarkUpdates);
+
+    if (cameraRigTestUpdates > 0)
+        return RunCameraRigTest(cameraRigTestUpdates);
+
+    if (worldPrecisionTestPoses > 0)
+        return RunWorldPrecisionTest(worldPrecisionTestPoses);
+
+    fputs(USAGE_TEXT, stderr);
+    return 1;
+}
@@ -0,0 +1,1668 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <windows.h>
+#include <d3dx9.h>
+
+#include "app_camera.h"
+#include "camera.h"
+#include "camera_bench.h"
+#include "camera_set.h"
+#include "deferred_shading.h"
+#if defined(_WIN32)
+#include "effect_compiler.h"
+#endif
+#include "frame_pipeline.h"
+#include "hud_stats.h"
+#include "job_system.h"
+#include "material_table.h"
+#include "normal_map_baker.h"
+#include "normal_mapping_utils.h"
+#include "occlusion_culler.h"
+#if defined(_WIN32)
+#include "shader_cache.h"
+#endif
+#include "shadow_map.h"
+#include "synthetic_city.h"
+#include "temporal_resolve.h"
+#include "text_buffer.h"
+#include "timer.h"
+
+namespace
+{
+    const int         BAKE_HIGH_POLY_GRID_SIZE = 512;
+    const int         BAKE_BUMPS = 8;
+    const float       BAKE_BUMP_HEIGHT = 0.05f;
+    const char        BAKE_FILENAME[] = "baked_normal_map.dds";
+
+    const int         DEFERRED_BENCHMARK_WIDTH = 1280;
+    const int         DEFERRED_BENCHMARK_HEIGHT = 720;
+    const int         DEFERRED_BENCHMARK_FRAMES = 50;
+    const float       DEFERRED_BENCHMARK_FLOOR_SIZE = 100.0f;
+    const float       DEFERRED_BENCHMARK_LIGHT_RADIUS = 3.0f;
+    const D3DXVECTOR3 DEFERRED_BENCHMARK_EYE(0.0f, 10.0f, 0.0f);
+    const D3DXVECTOR3 DEFERRED_BENCHMARK_TARGET(0.0f, 0.0f, 30.0f);
+
+    const float       HUD_BENCHMARK_FRAME_TIME = 1.0f / 60.0f;
+
+    const int         JOB_BENCHMARK_BATCH = 512;
+    const int         JOB_BENCHMARK_WORK = 2000;
+    const int         JOB_BENCHMARK_CITY_SIZE = 128;
+
+    const int         MATERIAL_BENCHMARK_DRAWS = 20000;
+    const int         MATERIAL_BENCHMARK_FRAMES = 300;
+    const int         MATERIAL_BENCHMARK_TEXTURE_SETS = 16;
+    const float       MATERIAL_BENCHMARK_CHANGED = 0.01f;
+
+    // The application's floor material. The random materials start out as
+    // copies of it.
+    const PackedMaterial MATERIAL_BENCHMARK_BASE =
+    {
+        0.2f, 0.2f, 0.2f, 1.0f,                     // ambient
+        0.8f, 0.8f, 0.8f, 1.0f,                     // diffuse
+        0.0f, 0.0f, 0.0f, 1.0f,                     // emissive
+        0.0f, 0.0f, 0.0f, 1.0f,                     // specular
+        0.0f,                                       // shininess
+        0.0f,                                       // textureSet
+        0.0f, 0.0f                                  // reserved
+    };
+
+    const int         OCCLUSION_BUFFER_WIDTH = 320;
+    const int         OCCLUSION_BUFFER_HEIGHT = 192;
+    const int         OCCLUSION_BENCHMARK_FRAMES = 300;
+
+    // The application's effect and where it keeps the compiled one.
+    const char        SHADER_FILENAME[] = "normal_mapping.fx";
+    const char        SHADER_CACHE_DIRECTORY[] = "shader_cache";
+
+    // The application's spot light shadow near plane.
+    const float       SHADOW_ZNEAR = 0.5f;
+    const int         SHADOW_BENCHMARK_CITY_SIZE = 32;
+    const int         SHADOW_BENCHMARK_FRAMES = 300;
+    const int         SHADOW_BENCHMARK_ATLAS_SIZE = 4096;
+    const int         SHADOW_BENCHMARK_MAP_SIZE = 512;
+    const float       SHADOW_BENCHMARK_LIGHT_RADIUS = 80.0f;
+
+    const int         TEMPORAL_TEST_WIDTH = 160;
+    const int         TEMPORAL_TEST_HEIGHT = 90;
+    const int         TEMPORAL_TEST_JITTER_SAMPLES = 8;
+    const int         TEMPORAL_TEST_REFERENCE_GRID = 4;
+    const int         TEMPORAL_TEST_WARMUP_FRAMES = 16;
+    const float       TEMPORAL_TEST_FRAME_TIME = 1.0f / 60.0f;
+    const float       TEMPORAL_TEST_CAMERA_SPEED = 0.5f;
+    const float       TEMPORAL_TEST_SPHERE_SPEED = 2.0f;
+    const float       TEMPORAL_TEST_SPHERE_RADIUS = 1.0f;
+    const float       TEMPORAL_TEST_CHECKER_SIZE = 0.5f;
+    const D3DXVECTOR3 TEMPORAL_TEST_EYE(0.0f, 1.5f, -2.0f);
+    const D3DXVECTOR3 TEMPORAL_TEST_SKY_COLOR(0.4f, 0.6f, 0.9f);
+    const D3DXVECTOR3 TEMPORAL_TEST_SPHERE_COLOR(0.9f, 0.3f, 0.2f);
+
+    const float       PIPELINE_BENCHMARK_FRAME_TIME = 1.0f / 60.0f;
+    const int         PIPELINE_BENCHMARK_FRAME_LATENCY = 2;
+    const float       PIPELINE_BENCHMARK_SIMULATE_MS = 3.0f;
+    const float       PIPELINE_BENCHMARK_RENDER_MS = 5.0f;
+
+    // The frame state RunPipelineBenchmark() double buffers. The frame
+    // pipeline's simulate function takes no context, so it lives here.
+    struct PipelineBenchmarkFrame
+    {
+        int frame;
+        double inputTime;
+        float result;
+    };
+
+    PipelineBenchmarkFrame g_pipelineBenchmarkStates[2];
+    int g_pipelineBenchmarkSimulated;
+    int g_pipelineBenchmarkSimulateWork;
+
+    void BenchmarkEmptyJob(void *)
+    {
+    }
+
+    void BenchmarkWorkJob(void *pData)
+    {
+        // A fixed amount of floating point work that the compiler can't remove.
+
+        float *pResult = static_cast<float*>(pData);
+        float x = *pResult;
+
+        for (int i = 0; i < JOB_BENCHMARK_WORK; ++i)
+            x = x * 0.999f + 0.5f;
+
+        *pResult = x;
+    }
+
+    void FormatStatsTextWithStream(const HudStats &stats, std::string &output)
+    {
+        // FormatStatsText() as it used to be written, with a std::ostringstream.
+        // RunHudBenchmark() compares the two.
+
+        std::ostringstream stream;
+        const char *pszCurrentBehavior = 0;
+
+        switch (stats.behavior)
+        {
+        default:
+            pszCurrentBehavior = "Unknown";
+            break;
+
+        case Camera::CAMERA_BEHAVIOR_FIRST_PERSON:
+            pszCurrentBehavior = "First Person";
+            break;
+
+        case Camera::CAMERA_BEHAVIOR_FLIGHT:
+            pszCurrentBehavior = "Flight";
+            break;
+
+        case Camera::CAMERA_BEHAVIOR_ORBIT:
+            pszCurrentBehavior = "Orbit";
+            break;
+
+        case Camera::CAMERA_BEHAVIOR_FOLLOW:
+            pszCurrentBehavior = "Follow";
+            break;
+        }
+
+        stream.setf(std::ios::fixed, std::ios::floatfield);
+
+        stream
+            << "FPS: " << stats.framesPerSecond << std::endl
+            << "Input latency: " << std::setprecision(1) << stats.inputLatencyMs << " ms" << std::endl
+            << "Multisample anti-aliasing: " << stats.msaaSamples << "x" << std::endl
+            << "Anisotropic filtering: " << stats.maxAnisotrophy << "x" << std::endl
+            << std::endl
+            << std::setprecision(2)
+            << "Camera" << std::endl
+            << "  Position:"
+            << " x:" << stats.position[0]
+            << " y:" << stats.position[1]
+            << " z:" << stats.position[2] << std::endl
+            << "  Velocity:"
+            << " x:" << stats.velocity[0]
+            << " y:" << stats.velocity[1]
+            << " z:" << stats.velocity[2] << std::endl
+            << "  Behavior: " << pszCurrentBehavior << std::endl
+            << "  Rotation speed: " << stats.rotationSpeed << std::endl
+            << "  Motion prediction: ";
+
+        if (stats.prediction)
+            stream << "enabled (confidence " << stats.predictionConfidence << ")" << std::endl;
+        else
+            stream << "disabled" << std::endl;
+
+        stream
+            << std::endl
+            << "Mouse" << std::endl
+            << "  Smoothing: " << (stats.mouseSmoothing ? "enabled" : "disabled") << std::endl
+            << "  Sensitivity: " << stats.weightModifier << std::endl
+            << "  Raw input: " << (stats.mouseRawInput ? "enabled" : "disabled") << std::endl
+            << std::endl
+            << "Assets" << std::endl
+            << "  Shader load: " << std::setprecision(1) << stats.shaderLoadMs << " ms"
+            << (stats.shaderCacheHit ? " (cached)" : " (compiled)") << std::endl
+            << "  Hot reload: ";
+
+        if (stats.hotReload)
+        {
+            stream << (stats.hotReload == 2 ? "polling" : "watching")
+                << ", " << stats.assetReloads << " reloads";
+
+            if (stats.assetReloadFailed)
+                stream << ", last one failed";
+
+            stream << std::endl;
+        }
+        else
+        {
+            stream << "disabled" << std::endl;
+        }
+
+        stream
+            << std::endl
+            << "Press H to display help";
+
+        output = stream.str();
+    }
+
+    float PipelineBenchmarkWork(float x, int iterations)
+    {
+        // Synthetic simulation or render work for RunPipelineBenchmark(). A
+        // fixed amount of floating point work that the compiler can't remove.
+
+        for (int i = 0; i < iterations; ++i)
+            x = x * 0.999f + 0.5f;
+
+        return x;
+    }
+
+    void SimulatePipelineBenchmarkFrame(int slot, float elapsedTimeSec)
+    {
+        // RunPipelineBenchmark()'s stand in for the application's
+        // SimulateFrame(). The frame's input is sampled when its simulation
+        // starts.
+
+        PipelineBenchmarkFrame &frame = g_pipelineBenchmarkStates[slot];
+
+        frame.frame = g_pipelineBenchmarkSimulated++;
+        frame.inputTime = GetTimeInSeconds();
+        frame.result = PipelineBenchmarkWork(elapsedTimeSec, g_pipelineBenchmarkSimulateWork);
+    }
+
+    D3DXVECTOR3 TraceTemporalTestScene(const D3DXMATRIX &invViewProj, const D3DXMATRIX &viewProj,
+                                       float x, float y, const D3DXVECTOR3 &sphereCenter,
+                                       float *pDepth, int *pObjectId)
+    {
+        // RunTemporalResolveTest()'s renderer. Casts the ray through the
+        // point (x, y) in normalized device coordinates, unprojected with
+        // 'invViewProj', into a checkered floor with a sphere on it, and
+        // returns the color it hits. Optionally returns the hit's depth as
+        // projected by 'viewProj' and the id of the object hit: 0 for the
+        // sphere and -1 for the static floor and sky.
+
+        D3DXVECTOR3 nearPoint(x, y, 0.0f);
+        D3DXVECTOR3 farPoint(x, y, 1.0f);
+        D3DXVECTOR3 direction;
+        D3DXVECTOR3 color = TEMPORAL_TEST_SKY_COLOR;
+        float hitDistance = FLT_MAX;
+        int objectId = -1;
+
+        D3DXVec3TransformCoord(&nearPoint, &nearPoint, &invViewProj);
+        D3DXVec3TransformCoord(&farPoint, &farPoint, &invViewProj);
+        direction = farPoint - nearPoint;
+        D3DXVec3Normalize(&direction, &direction);
+
+        D3DXVECTOR3 toOrigin = nearPoint - sphereCenter;
+        float b = D3DXVec3Dot(&toOrigin, &direction);
+        float c = D3DXVec3Dot(&toOrigin, &toOrigin) - TEMPORAL_TEST_SPHERE_RADIUS * TEMPORAL_TEST_SPHERE_RADIUS;
+        float discriminant = b * b - c;
+
+        if (discriminant >= 0.0f && -b - sqrtf(discriminant) > 0.0f)
+        {
+            hitDistance = -b - sqrtf(discriminant);
+
+            D3DXVECTOR3 normal = (nearPoint + direction * hitDistance - sphereCenter) / TEMPORAL_TEST_SPHERE_RADIUS;
+            color = TEMPORAL_TEST_SPHERE_COLOR * (0.5f + 0.5f * normal.y);
+            objectId = 0;
+        }
+
+        if (direction.y < 0.0f && -nearPoint.y / direction.y < hitDistance)
+        {
+            hitDistance = -nearPoint.y / direction.y;
+
+            D3DXVECTOR3 hit = nearPoint + direction * hitDistance;
+            int checker = static_cast<int>(floorf(hit.x / TEMPORAL_TEST_CHECKER_SIZE)
+                + floorf(hit.z / TEMPORAL_TEST_CHECKER_SIZE)) & 1;
+
+            color = checker ? D3DXVECTOR3(0.9f, 0.9f, 0.9f) : D3DXVECTOR3(0.1f, 0.1f, 0.1f);
+            objectId = -1;
+        }
+
+        if (pDepth)
+        {
+            if (hitDistance < FLT_MAX)
+            {
+                D3DXVECTOR3 hit = nearPoint + direction * hitDistance;
+                D3DXVec3TransformCoord(&hit, &hit, &viewProj);
+                *pDepth = hit.z;
+            }
+            else
+            {
+                *pDepth = 1.0f;
+            }
+        }
+
+        if (pObjectId)
+            *pObjectId = objectId;
+
+        return color;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Tests and benchmarks.
+//-----------------------------------------------------------------------------
+
+int RunDeferredBenchmark(int lightCount, int jobThreadCount, bool pinJobThreads)
+{
+    // Fills a software G-buffer with a view across a large floor, scatters
+    // lightCount point lights over the floor, and shades the G-buffer with
+    // the tiled CPU reference of the lighting pass on all of the processors.
+    // Forward shading would have shaded every floor pixel with every light.
+
+    JobSystem jobSystem;
+    SoftwareDeferredShader shader;
+    LightList lights;
+    std::vector<D3DXVECTOR3> output;
+    TextBuffer text;
+    D3DXMATRIX viewMatrix;
+    D3DXMATRIX projectionMatrix;
+    D3DXMATRIX viewProjectionMatrix;
+    D3DXMATRIX inverseViewProjectionMatrix;
+    D3DXVECTOR3 up(0.0f, 1.0f, 0.0f);
+    D3DXVECTOR3 ambient(0.04f, 0.04f, 0.04f);
+    unsigned int random = 12345;
+    int width = DEFERRED_BENCHMARK_WIDTH;
+    int height = DEFERRED_BENCHMARK_HEIGHT;
+
+    D3DXMatrixLookAtLH(&viewMatrix, &DEFERRED_BENCHMARK_EYE, &DEFERRED_BENCHMARK_TARGET, &up);
+    D3DXMatrixPerspectiveFovLH(&projectionMatrix, D3DXToRadian(60.0f),
+        static_cast<float>(width) / static_cast<float>(height), CAMERA_ZNEAR, CITY_ZFAR);
+    viewProjectionMatrix = viewMatrix * projectionMatrix;
+    D3DXMatrixInverse(&inverseViewProjectionMatrix, 0, &viewProjectionMatrix);
+
+    if (!shader.create(width, height))
+        return 1;
+
+    // Each pixel's view ray is intersected with the floor's plane. The floor
+    // has a checkerboard albedo and a rippled normal in place of the normal
+    // map's.
+
+    SoftwareDeferredShader::GBufferTexel *pGBuffer = shader.getGBuffer();
+    float halfFloorSize = DEFERRED_BENCHMARK_FLOOR_SIZE * 0.5f;
+    int floorPixelCount = 0;
+
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            SoftwareDeferredShader::GBufferTexel &texel = pGBuffer[y * width + x];
+            D3DXVECTOR3 nearPos((x + 0.5f) / width * 2.0f - 1.0f, 1.0f - (y + 0.5f) / height * 2.0f, 0.0f);
+            D3DXVECTOR3 farPos(nearPos.x, nearPos.y, 1.0f);
+
+            D3DXVec3TransformCoord(&nearPos, &nearPos, &inverseViewProjectionMatrix);
+            D3DXVec3TransformCoord(&farPos, &farPos, &inverseViewProjectionMatrix);
+
+            texel.albedo = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+            texel.normal = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+            texel.position = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+
+            if (nearPos.y <= 0.0f || farPos.y >= 0.0f)
+                continue;
+
+            D3DXVECTOR3 pos = nearPos + (farPos - nearPos) * (nearPos.y / (nearPos.y - farPos.y));
+
+            if (fabsf(pos.x) > halfFloorSize || fabsf(pos.z - halfFloorSize) > halfFloorSize)
+                continue;
+
+            D3DXVECTOR3 normal(0.3f * sinf(pos.x * 4.0f), 1.0f, 0.3f * cosf(pos.z * 4.0f));
+            bool isDark = ((static_cast<int>(floorf(pos.x)) + static_cast<int>(floorf(pos.z))) & 1) != 0;
+
+            D3DXVec3Normalize(&texel.normal, &normal);
+            texel.albedo = isDark ? D3DXVECTOR3(0.5f, 0.35f, 0.2f) : D3DXVECTOR3(0.8f, 0.6f, 0.4f);
+            texel.position = pos;
+            ++floorPixelCount;
+        }
+    }
+
+    for (int i = 0; i < lightCount; ++i)
+    {
+        DeferredLight light;
+        float r[6];
+
+        for (int j = 0; j < 6; ++j)
+        {
+            random = random * 1664525 + 1013904223;
+            r[j] = ((random >> 8) & 0xffff) / 65535.0f;
+        }
+
+        light.pos = D3DXVECTOR3((r[0] - 0.5f) * DEFERRED_BENCHMARK_FLOOR_SIZE,
+            0.5f + 1.5f * r[1], r[2] * DEFERRED_BENCHMARK_FLOOR_SIZE);
+        light.radius = DEFERRED_BENCHMARK_LIGHT_RADIUS * (0.5f + r[3]);
+        light.dir = D3DXVECTOR3(0.0f, -1.0f, 0.0f);
+        light.spotCosOuterCone = -2.0f;
+        light.color = D3DXVECTOR3(r[3], r[4], r[5]);
+        light.spotCosInnerCone = -1.0f;
+        lights.add(light);
+    }
+
+    if (!jobSystem.create(jobThreadCount, pinJobThreads))
+        return 1;
+
+    int threadCount = jobSystem.workerCount() + 1;
+    double cullSec = 0.0;
+    double shadeSec = 0.0;
+    long long lightEvaluations = 0;
+
+    output.resize(width * height);
+
+    for (int frame = 0; frame < DEFERRED_BENCHMARK_FRAMES; ++frame)
+    {
+        double startTime = GetTimeInSeconds();
+
+        lights.cull(viewProjectionMatrix, width, height);
+
+        double shadeStartTime = GetTimeInSeconds();
+
+        shader.shade(&jobSystem, lights, ambient, &output[0]);
+
+        double endTime = GetTimeInSeconds();
+
+        cullSec += shadeStartTime - startTime;
+        shadeSec += endTime - shadeStartTime;
+        lightEvaluations += shader.getLightEvaluationCount();
+    }
+
+    jobSystem.destroy();
+
+    double frames = DEFERRED_BENCHMARK_FRAMES;
+    double pixels = frames * width * height;
+    double floorPixels = frames * (floorPixelCount > 0 ? floorPixelCount : 1);
+    int gBufferPixelSize = 0;
+
+    for (int i = 0; i < GBUFFER_TARGET_COUNT; ++i)
+        gBufferPixelSize += GBufferFormatSize(GBufferFormat(static_cast<GBufferTarget>(i), 0));
+
+    text.append("Lights: ").append(lightCount).newline();
+    text.append("Visible lights: ").append(lights.getVisibleCount()).newline();
+    text.append("Resolution: ").append(width).append('x').append(height).newline();
+    text.append("Floor pixels: ").append(floorPixelCount).newline();
+    text.append("Threads: ").append(threadCount).newline();
+    text.append("Frames: ").append(DEFERRED_BENCHMARK_FRAMES).newline();
+    text.append("G-buffer: ").append(gBufferPixelSize).append(" bytes/pixel, ").append(static_cast<float>(gBufferPixelSize * width * height / 1048576.0), 1).append(" MB").newline();
+    text.append("Light culling time: ").append(static_cast<float>(cullSec * 1000.0 / frames), 3).append(" ms/frame").newline();
+    text.append("Shading time: ").append(static_cast<float>(shadeSec * 1000.0 / frames), 3).append(" ms/frame").newline();
+    text.append("Shading cost: ").append(static_cast<float>(shadeSec * 1e9 / pixels), 2).append(" ns/pixel").newline();
+    text.append("Lights shaded per floor pixel: ").append(static_cast<float>(lightEvaluations / floorPixels), 2).newline();
+    text.append("Lights shaded per floor pixel when forward shading: ").append(lightCount).newline();
+
+    fputs(text.c_str(), stdout);
+    fflush(stdout);
+    return 0;
+}
+
+int RunHudBenchmark(int frameCount)
+{
+    // Formats the on screen statistics for frameCount frames of a camera
+    // that flies around for the first half of the frames and then rests.
+    // Times formatting them with a std::ostringstream the way RenderText()
+    // used to, with a TextBuffer every frame, and the way RenderText() does
+    // now, only reformatting when a displayed value has changed. The stream
+    // and TextBuffer texts must be identical, apart from negative zeros.
+    //
+    // ID3DXFont lays text out with GDI. Laying the text out in a memory DC
+    // with the HUD's font stands in for the layout ID3DXFont::DrawText()
+    // repeats every frame. There's no GDI off Windows, so the layout is
+    // reported as unavailable there.
+
+    std::vector<HudStats> frames(frameCount);
+    int movingFrames = frameCount / 2;
+
+    for (int i = 0; i < frameCount; ++i)
+    {
+        // The snapshots are memcmp()'d so their padding must be zeroed.
+
+        HudStats &stats = frames[i];
+        float time = (std::min)(i, movingFrames) * HUD_BENCHMARK_FRAME_TIME;
+        bool moving = i < movingFrames;
+
+        memset(&stats, 0, sizeof(stats));
+        stats.framesPerSecond = 60 + (static_cast<int>(i * HUD_BENCHMARK_FRAME_TIME) % 3);
+        stats.inputLatencyMs = 1.3f;
+        stats.msaaSamples = 4;
+        stats.maxAnisotrophy = 16;
+        stats.position[0] = 20.0f + 15.0f * sinf(0.3f * time);
+        stats.position[1] = 1.0f + 0.5f * sinf(0.7f * time);
+        stats.position[2] = 20.0f + 15.0f * cosf(0.3f * time);
+        stats.velocity[0] = moving ? 4.5f * cosf(0.3f * time) : 0.0f;
+        stats.velocity[1] = moving ? 0.35f * cosf(0.7f * time) : 0.0f;
+        stats.velocity[2] = moving ? -4.5f * sinf(0.3f * time) : 0.0f;
+        stats.behavior = Camera::CAMERA_BEHAVIOR_FLIGHT;
+        stats.rotationSpeed = CAMERA_SPEED_ROTATION;
+        stats.prediction = 1;
+        stats.predictionConfidence = moving ? 0.9f : 1.0f;
+        stats.weightModifier = 0.2f;
+        stats.mouseSmoothing = 1;
+        stats.shaderLoadMs = 12.5f;
+        stats.shaderCacheHit = 1;
+        stats.hotReload = 1;
+
+        // Keep the camera values off exact rounding ties, e.g. 0.125, which
+        // C runtimes round differently.
+
+        for (int j = 0; j < 3; ++j)
+        {
+            stats.position[j] = floorf(stats.position[j] * 512.0f) / 512.0f + 1.0f / 1024.0f;
+            stats.velocity[j] = floorf(stats.velocity[j] * 512.0f) / 512.0f + 1.0f / 1024.0f;
+        }
+    }
+
+    TextBuffer statsText;
+    std::string streamText;
+    int mismatches = 0;
+    int checksum = 0;
+    double startTime = GetTimeInSeconds();
+
+    for (int i = 0; i < frameCount; ++i)
+    {
+        FormatStatsTextWithStream(frames[i], streamText);
+        checksum += static_cast<int>(streamText.size());
+    }
+
+    double streamSec = GetTimeInSeconds() - startTime;
+
+    startTime = GetTimeInSeconds();
+
+    for (int i = 0; i < frameCount; ++i)
+    {
+        FormatStatsText(frames[i], statsText);
+        checksum += statsText.length();
+    }
+
+    double bufferSec = GetTimeInSeconds() - startTime;
+
+    HudStats displayedStats;
+    bool statsTextValid = false;
+    int reformats = 0;
+
+    startTime = GetTimeInSeconds();
+
+    for (int i = 0; i < frameCount; ++i)
+    {
+        if (!statsTextValid || memcmp(&frames[i], &displayedStats, sizeof(displayedStats)) != 0)
+        {
+            FormatStatsText(frames[i], statsText);
+            memcpy(&displayedStats, &frames[i], sizeof(displayedStats));
+            statsTextValid = true;
+            ++reformats;
+        }
+
+        checksum += statsText.length();
+    }
+
+    double cachedSec = GetTimeInSeconds() - startTime;
+
+    for (int i = 0; i < frameCount; ++i)
+    {
+        // TextBuffer doesn't print "-0.00" for small negative values that
+        // round to zero. Neither should the stream's text.
+
+        FormatStatsTextWithStream(frames[i], streamText);
+        FormatStatsText(frames[i], statsText);
+
+        for (std::string::size_type pos = streamText.find("-0."); pos != std::string::npos;
+             pos = streamText.find("-0.", pos + 1))
+        {
+            std::string::size_type end = streamText.find_first_not_of("0.", pos + 1);
+
+            if (end == std::string::npos || !isdigit(static_cast<unsigned char>(streamText[end])))
+                streamText.erase(pos, 1);
+        }
+
+        if (streamText != statsText.c_str())
+            ++mismatches;
+    }
+
+    // Layout, with the font InitFont() asks ID3DXFont for.
+
+    double layoutSec = 0.0;
+    bool layoutOk = false;
+
+#if defined(_WIN32)
+    if (HDC hDC = CreateCompatibleDC(0))
+    {
+        int fontCharHeight = -10 * GetDeviceCaps(hDC, LOGPIXELSY) / 72;
+        HFONT hFont = CreateFont(fontCharHeight, 0, 0, 0, FW_BOLD, FALSE, FALSE, FALSE,
+            DEFAULT_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS, ANTIALIASED_QUALITY,
+            DEFAULT_PITCH | FF_DONTCARE, "Arial");
+
+        if (hFont)
+        {
+            HGDIOBJ hOldFont = SelectObject(hDC, hFont);
+
+            for (int i = 0; i < frameCount; ++i)
+            {
+                RECT rc = {0, 0, 0, 0};
+
+                FormatStatsText(frames[i], statsText);
+                startTime = GetTimeInSeconds();
+                DrawText(hDC, statsText.c_str(), statsText.length(), &rc,
+                    DT_CALCRECT | DT_EXPANDTABS | DT_LEFT);
+                layoutSec += GetTimeInSeconds() - startTime;
+                checksum += rc.bottom;
+            }
+
+            layoutOk = true;
+
+            SelectObject(hDC, hOldFont);
+            DeleteObject(hFont);
+        }
+
+        DeleteDC(hDC);
+    }
+#endif
+
+    bool passed = mismatches == 0;
+    double usPerFrame = 1e6 / (std::max)(frameCount, 1);
+    TextBuffer text;
+
+    text.append("Frames: ").append(frameCount)
+        .append(" (").append(movingFrames).append(" moving)").newline();
+    text.append("Text length: ").append(statsText.length()).append(" characters").newline();
+    text.append("Format with std::ostringstream: ").append(static_cast<float>(streamSec * usPerFrame), 3).append(" us/frame").newline();
+    text.append("Format with TextBuffer: ").append(static_cast<float>(bufferSec * usPerFrame), 3).append(" us/frame").newline();
+    text.append("Format when changed: ").append(static_cast<float>(cachedSec * usPerFrame), 3).append(" us/frame (")
+        .append(reformats).append(" reformats)").newline();
+
+    if (layoutOk)
+        text.append("Layout with GDI: ").append(static_cast<float>(layoutSec * usPerFrame), 3).append(" us/frame").newline();
+    else
+        text.append("Layout with GDI: unavailable").newline();
+
+    text.append("Mismatched texts: ").append(mismatches).newline();
+
+    if (checksum == 0)
+        text.append("Checksum: 0").newline();
+
+    text.newline();
+    text.append(passed ? "PASSED" : "FAILED").newline();
+
+    fputs(text.c_str(), stdout);
+    fflush(stdout);
+    return passed ? 0 : 1;
+}
+
+int RunJobBenchmark(int jobCount, int jobThreadCount, bool pinJobThreads)
+{
+    // Measures the job system with 1, 2, 4, ... threads up to one per
+    // processor (or jobThreadCount plus the main thread). For each thread
+    // count jobCount empty jobs are run to measure the scheduling overhead,
+    // jobCount jobs that each do a fixed amount of work are run to measure
+    // the scaling, and the synthetic city mesh is built with one job per row
+    // of blocks. The jobs are submitted from the main thread in batches of
+    // JOB_BENCHMARK_BATCH. The city is checked against a serial build.
+
+    std::vector<float> results(JOB_BENCHMARK_BATCH * 16, 1.0f);
+    std::vector<D3DXVECTOR3> serialVertices;
+    std::vector<int> serialIndices;
+    std::vector<D3DXVECTOR3> vertices;
+    std::vector<int> indices;
+    std::vector<D3DXVECTOR3> objectMins;
+    std::vector<D3DXVECTOR3> objectMaxs;
+    TextBuffer text;
+    JobSystem jobSystem;
+    int maxThreads = (jobThreadCount >= 0) ? jobThreadCount + 1 : JobSystem::processorCount();
+    double serialWorkSec = 0.0;
+    bool citiesMatch = true;
+
+    maxThreads = (std::max)(1, (std::min)(maxThreads, static_cast<int>(JobSystem::MAX_THREADS)));
+
+    double startTime = GetTimeInSeconds();
+
+    BuildCity(0, JOB_BENCHMARK_CITY_SIZE, serialVertices, serialIndices, objectMins, objectMaxs);
+
+    double serialCitySec = GetTimeInSeconds() - startTime;
+
+    text.append("Jobs: ").append(jobCount).newline();
+    text.append("Work per job: ").append(JOB_BENCHMARK_WORK).append(" iterations").newline();
+    text.append("City blocks: ").append(JOB_BENCHMARK_CITY_SIZE * JOB_BENCHMARK_CITY_SIZE).newline();
+    text.append("Serial city build: ").append(static_cast<float>(serialCitySec * 1000.0), 2).append(" ms").newline();
+
+    for (int threads = 1; ; threads = (std::min)(threads * 2, maxThreads))
+    {
+        if (!jobSystem.create(threads - 1, pinJobThreads))
+            return 1;
+
+        // Empty jobs.
+
+        startTime = GetTimeInSeconds();
+
+        for (int first = 0; first < jobCount; first += JOB_BENCHMARK_BATCH)
+        {
+            JobCounter counter;
+            int count = (std::min)(JOB_BENCHMARK_BATCH, jobCount - first);
+
+            for (int i = 0; i < count; ++i)
+                jobSystem.submit(BenchmarkEmptyJob, 0, &counter);
+
+            jobSystem.wait(&counter);
+        }
+
+        double emptySec = GetTimeInSeconds() - startTime;
+
+        // Jobs doing a fixed amount of work each.
+
+        startTime = GetTimeInSeconds();
+
+        for (int first = 0; first < jobCount; first += JOB_BENCHMARK_BATCH)
+        {
+            JobCounter counter;
+            int count = (std::min)(JOB_BENCHMARK_BATCH, jobCount - first);
+
+            for (int i = 0; i < count; ++i)
+                jobSystem.submit(BenchmarkWorkJob, &results[i * 16], &counter);
+
+            jobSystem.wait(&counter);
+        }
+
+        double workSec = GetTimeInSeconds() - startTime;
+
+        if (threads == 1)
+            serialWorkSec = workSec;
+
+        // The city mesh, one job per row of blocks.
+
+        startTime = GetTimeInSeconds();
+        BuildCity(&jobSystem, JOB_BENCHMARK_CITY_SIZE, vertices, indices, objectMins, objectMaxs);
+
+        double citySec = GetTimeInSeconds() - startTime;
+
+        jobSystem.destroy();
+
+        if (vertices.size() != serialVertices.size() || indices != serialIndices
+            || memcmp(&vertices[0], &serialVertices[0], vertices.size() * sizeof(D3DXVECTOR3)) != 0)
+        {
+            citiesMatch = false;
+        }
+
+        text.append("Threads ").append(threads).append(": ");
+        text.append(static_cast<float>(emptySec > 0.0 ? jobCount / emptySec / 1e6 : 0.0), 2).append(" M empty jobs/s, ");
+        text.append(static_cast<float>(workSec > 0.0 ? jobCount / workSec / 1e3 : 0.0), 1).append(" K work jobs/s (");
+        text.append(static_cast<float>(workSec > 0.0 ? serialWorkSec / workSec : 0.0), 2).append("x), city ");
+        text.append(static_cast<float>(citySec * 1000.0), 2).append(" ms").newline();
+
+        if (threads == maxThreads)
+            break;
+    }
+
+    text.append("City matches serial build: ").append(citiesMatch ? "yes" : "no").newline();
+
+    fputs(text.c_str(), stdout);
+    fflush(stdout);
+    return citiesMatch ? 0 : 1;
+}
+
+int RunMaterialBenchmark(int materialCount)
+{
+    // Fills a material table with materialCount random materials spread
+    // over MATERIAL_BENCHMARK_TEXTURE_SETS texture sets, and gives each of
+    // MATERIAL_BENCHMARK_DRAWS objects a random one. Each frame
+    // MATERIAL_BENCHMARK_CHANGED of the materials change, the dirty ranges
+    // are uploaded to a null backend, and the draws are queued in object
+    // order and sorted.
+
+    MaterialTable materials;
+    DrawQueue draws;
+    std::vector<int> objectMaterials;
+    TextBuffer text;
+    unsigned int random = 24680;
+    int changedCount = (std::max)(1, static_cast<int>(materialCount * MATERIAL_BENCHMARK_CHANGED));
+
+    materialCount = (std::min)(materialCount, static_cast<int>(MaterialTable::MAX_CAPACITY));
+
+    if (!materials.create(materialCount))
+        return 1;
+
+    for (int i = 0; i < materialCount; ++i)
+    {
+        PackedMaterial material = MATERIAL_BENCHMARK_BASE;
+
+        random = random * 1664525 + 1013904223;
+        material.diffuse[0] = ((random >> 8) & 0xff) / 255.0f;
+        material.textureSet = static_cast<float>((random >> 16) % MATERIAL_BENCHMARK_TEXTURE_SETS);
+        materials.add(material);
+    }
+
+    for (int i = 0; i < MATERIAL_BENCHMARK_DRAWS; ++i)
+    {
+        random = random * 1664525 + 1013904223;
+        objectMaterials.push_back((random >> 8) % materialCount);
+    }
+
+    // The initial upload of the whole table isn't part of the per frame
+    // costs.
+
+    int initialBytes = materials.upload(0, 0);
+    long long uploadBytes = 0;
+    long long uploadRanges = 0;
+    long long unsortedMaterialSwitches = 0;
+    long long unsortedTextureSetSwitches = 0;
+    long long sortedMaterialSwitches = 0;
+    long long sortedTextureSetSwitches = 0;
+    double sortSec = 0.0;
+
+    for (int frame = 0; frame < MATERIAL_BENCHMARK_FRAMES; ++frame)
+    {
+        for (int i = 0; i < changedCount; ++i)
+        {
+            random = random * 1664525 + 1013904223;
+
+            int index = (random >> 8) % materialCount;
+            PackedMaterial material = materials.getMaterial(index);
+
+            material.diffuse[1] = ((random >> 4) & 0xff) / 255.0f;
+            materials.set(index, material);
+        }
+
+        uploadBytes += materials.upload(0, 0);
+        uploadRanges += materials.getUploadRangeCount();
+
+        draws.clear();
+
+        for (int i = 0; i < MATERIAL_BENCHMARK_DRAWS; ++i)
+        {
+            int material = objectMaterials[i];
+
+            draws.add(static_cast<int>(materials.getMaterial(material).textureSet), material, i);
+        }
+
+        unsortedMaterialSwitches += draws.countMaterialSwitches();
+        unsortedTextureSetSwitches += draws.countTextureSetSwitches();
+
+        double startTime = GetTimeInSeconds();
+
+        draws.sort();
+        sortSec += GetTimeInSeconds() - startTime;
+
+        sortedMaterialSwitches += draws.countMaterialSwitches();
+        sortedTextureSetSwitches += draws.countTextureSetSwitches();
+    }
+
+    double frames = MATERIAL_BENCHMARK_FRAMES;
+
+    text.append("Materials: ").append(materialCount).newline();
+    text.append("Material size: ").append(static_cast<int>(sizeof(PackedMaterial))).append(" bytes").newline();
+    text.append("Material table: ").append(initialBytes).append(" bytes").newline();
+    text.append("Materials changed: ").append(changedCount).append(" per frame").newline();
+    text.append("Draws: ").append(MATERIAL_BENCHMARK_DRAWS).append(" per frame").newline();
+    text.append("Frames: ").append(MATERIAL_BENCHMARK_FRAMES).newline();
+    text.append("Upload: ").append(static_cast<float>(uploadBytes / frames), 0).append(" bytes/frame in ").append(static_cast<float>(uploadRanges / frames), 1).append(" ranges").newline();
+    text.append("Upload of the whole table: ").append(initialBytes).append(" bytes/frame").newline();
+    text.append("Material switches: ").append(static_cast<float>(sortedMaterialSwitches / frames), 0).append(" per frame sorted, ").append(static_cast<float>(unsortedMaterialSwitches / frames), 0).append(" unsorted").newline();
+    text.append("Texture set switches: ").append(static_cast<float>(sortedTextureSetSwitches / frames), 0).append(" per frame sorted, ").append(static_cast<float>(unsortedTextureSetSwitches / frames), 0).append(" unsorted").newline();
+    text.append("Sort time: ").append(static_cast<float>(sortSec * 1000.0 / frames), 3).append(" ms/frame").newline();
+
+    fputs(text.c_str(), stdout);
+    fflush(stdout);
+    return 0;
+}
+
+int RunNormalMapBaker(int size, int jobThreadCount, bool pinJobThreads)
+{
+    // Bakes a size x size normal map for the application's floor quad from
+    // a high polygon floor covered in a grid of bumps and dips. The bumps
+    // repeat a whole number of times across the floor so that the map
+    // tiles. The floor quad is generated with texture coordinates in [0, 1]
+    // for baking. Saves the map to BAKE_FILENAME.
+
+    NormalMappedQuad lowPolyMesh;
+    TriangleBvh highPolyMesh;
+    NormalMapBaker baker;
+    JobSystem jobSystem;
+    std::vector<D3DXVECTOR3> positions;
+    std::vector<D3DXVECTOR3> normals;
+    std::vector<int> indices;
+    TextBuffer text;
+    int gridSize = BAKE_HIGH_POLY_GRID_SIZE;
+    float frequencyX = 2.0f * D3DX_PI * BAKE_BUMPS / FLOOR_WIDTH;
+    float frequencyZ = 2.0f * D3DX_PI * BAKE_BUMPS / FLOOR_HEIGHT;
+
+    lowPolyMesh.generate(D3DXVECTOR3(0.0f, 0.0f, 0.0f),
+        D3DXVECTOR3(0.0f, 1.0f, 0.0f), D3DXVECTOR3(0.0f, 0.0f, 1.0f),
+        FLOOR_WIDTH, FLOOR_HEIGHT, 1.0f, 1.0f);
+
+    // The height is BAKE_BUMP_HEIGHT * sin(fx * x) * sin(fz * z). The normals
+    // come from its partial derivatives.
+
+    for (int z = 0; z <= gridSize; ++z)
+    {
+        for (int x = 0; x <= gridSize; ++x)
+        {
+            float posX = (static_cast<float>(x) / gridSize - 0.5f) * FLOOR_WIDTH;
+            float posZ = (static_cast<float>(z) / gridSize - 0.5f) * FLOOR_HEIGHT;
+            float sinX = sinf(frequencyX * posX);
+            float sinZ = sinf(frequencyZ * posZ);
+            D3DXVECTOR3 normal(-BAKE_BUMP_HEIGHT * frequencyX * cosf(frequencyX * posX) * sinZ,
+                1.0f, -BAKE_BUMP_HEIGHT * frequencyZ * sinX * cosf(frequencyZ * posZ));
+
+            D3DXVec3Normalize(&normal, &normal);
+            positions.push_back(D3DXVECTOR3(posX, BAKE_BUMP_HEIGHT * sinX * sinZ, posZ));
+            normals.push_back(normal);
+        }
+    }
+
+    for (int z = 0; z < gridSize; ++z)
+    {
+        for (int x = 0; x < gridSize; ++x)
+        {
+            int i = z * (gridSize + 1) + x;
+
+            indices.push_back(i);
+            indices.push_back(i + gridSize + 1);
+            indices.push_back(i + 1);
+            indices.push_back(i + 1);
+            indices.push_back(i + gridSize + 1);
+            indices.push_back(i + gridSize + 2);
+        }
+    }
+
+    int triangleCount = static_cast<int>(indices.size()) / 3;
+    double buildStartTime = GetTimeInSeconds();
+
+    highPolyMesh.build(&positions[0], &normals[0], &indices[0], triangleCount);
+
+    double buildEndTime = GetTimeInSeconds();
+
+    if (!jobSystem.create(jobThreadCount, pinJobThreads))
+        return 1;
+
+    int threadCount = jobSystem.workerCount() + 1;
+    double bakeStartTime = GetTimeInSeconds();
+
+    baker.bake(&jobSystem, lowPolyMesh.getVertices(), lowPolyMesh.getVertexCount(),
+        highPolyMesh, size, size, 2.0f * BAKE_BUMP_HEIGHT);
+
+    double bakeEndTime = GetTimeInSeconds();
+
+    jobSystem.destroy();
+
+    bool saved = baker.save(BAKE_FILENAME);
+    int texelCount = size * size;
+
+    text.append("High polygon triangles: ").append(triangleCount).newline();
+    text.append("BVH nodes: ").append(highPolyMesh.getNodeCount()).newline();
+    text.append("BVH build time: ").append(static_cast<float>((buildEndTime - buildStartTime) * 1000.0), 1).append(" ms").newline();
+    text.append("Normal map: ").append(size).append('x').append(size).newline();
+    text.append("Threads: ").append(threadCount).newline();
+    text.append("Bake time: ").append(static_cast<float>((bakeEndTime - bakeStartTime) * 1000.0), 1).append(" ms").newline();
+    text.append("Bake rate: ").append(static_cast<float>(texelCount / (bakeEndTime - bakeStartTime) / 1e6), 2).append(" million texels/sec").newline();
+    text.append("Texels covered: ").append(baker.getCoveredTexelCount()).append(" of ").append(texelCount).newline();
+    text.append("Rays that hit: ").append(baker.getHitCount()).append(" of ").append(baker.getCoveredTexelCount()).newline();
+    text.append(saved ? "Saved: " : "Failed to save: ").append(BAKE_FILENAME).newline();
+
+    fputs(text.c_str(), stdout);
+    fflush(stdout);
+    return saved ? 0 : 1;
+}
+
+int RunOcclusionBenchmark(int citySize, int jobThreadCount, bool pinJobThreads)
+{
+    // Flies a camera at street level down the middle of a citySize x
+    // citySize block synthetic city while turning it, and each frame draws
+    // the buildings into the occlusion culler and tests the objects that
+    // survive view frustum culling against it.
+
+    std::vector<D3DXVECTOR3> vertices;
+    std::vector<int> indices;
+    std::vector<D3DXVECTOR3> objectMins;
+    std::vector<D3DXVECTOR3> objectMaxs;
+    std::vector<D3DXVECTOR3> objectCenters;
+    std::vector<float> objectRadii;
+    std::vector<unsigned int> viewMasks;
+    JobSystem jobSystem;
+    OcclusionCuller culler;
+    CameraSet cameraSet;
+    Camera camera;
+    TextBuffer text;
+
+    if (!jobSystem.create(jobThreadCount, pinJobThreads))
+        return 1;
+
+    BuildCity(&jobSystem, citySize, vertices, indices, objectMins, objectMaxs);
+
+    int vertexCount = static_cast<int>(vertices.size());
+    int triangleCount = static_cast<int>(indices.size()) / 3;
+    int objectCount = static_cast<int>(objectMins.size());
+
+    for (int i = 0; i < objectCount; ++i)
+    {
+        D3DXVECTOR3 halfExtents = (objectMaxs[i] - objectMins[i]) * 0.5f;
+
+        objectCenters.push_back(objectMins[i] + halfExtents);
+        objectRadii.push_back(D3DXVec3Length(&halfExtents));
+    }
+
+    viewMasks.resize(objectCount);
+
+    int threadCount = jobSystem.workerCount() + 1;
+
+    culler.create(OCCLUSION_BUFFER_WIDTH, OCCLUSION_BUFFER_HEIGHT);
+    camera.perspective(CAMERA_FOVX, static_cast<float>(OCCLUSION_BUFFER_WIDTH)
+        / static_cast<float>(OCCLUSION_BUFFER_HEIGHT), CAMERA_ZNEAR, CITY_ZFAR);
+
+    float cityLength = citySize * CITY_BLOCK_SIZE;
+    float streetZ = (citySize / 2) * CITY_BLOCK_SIZE + CITY_OBJECT_SIZE * 0.5f;
+    double rasterizeSec = 0.0;
+    double testSec = 0.0;
+    long long drawnTriangles = 0;
+    long long visibleObjects = 0;
+    long long occludedObjects = 0;
+
+    for (int frame = 0; frame < OCCLUSION_BENCHMARK_FRAMES; ++frame)
+    {
+        float t = static_cast<float>(frame) / OCCLUSION_BENCHMARK_FRAMES;
+        float heading = 2.0f * D3DX_PI * t;
+        D3DXVECTOR3 eye(cityLength * t, 2.0f, streetZ);
+        D3DXVECTOR3 target = eye + D3DXVECTOR3(cosf(heading), 0.0f, sinf(heading));
+
+        camera.lookAt(eye, target, D3DXVECTOR3(0.0f, 1.0f, 0.0f));
+        cameraSet.update(camera);
+        cameraSet.cull(&objectCenters[0], &objectRadii[0], objectCount, &viewMasks[0]);
+
+        double startTime = GetTimeInSeconds();
+
+        culler.begin(camera.getViewMatrix() * camera.getProjectionMatrix());
+        culler.addOccluder(&vertices[0], vertexCount, &indices[0], triangleCount);
+        culler.rasterize(&jobSystem);
+
+        double rasterizedTime = GetTimeInSeconds();
+
+        for (int i = 0; i < objectCount; ++i)
+        {
+            if (!viewMasks[i])
+                continue;
+
+            ++visibleObjects;
+
+            if (culler.isOccluded(objectMins[i], objectMaxs[i]))
+                ++occludedObjects;
+        }
+
+        testSec += GetTimeInSeconds() - rasterizedTime;
+        rasterizeSec += rasterizedTime - startTime;
+        drawnTriangles += culler.getTriangleCount();
+    }
+
+    jobSystem.destroy();
+
+    double frames = OCCLUSION_BENCHMARK_FRAMES;
+    double submittedTriangles = frames * triangleCount;
+
+    text.append("City blocks: ").append(citySize * citySize).newline();
+    text.append("Occluder triangles: ").append(triangleCount).newline();
+    text.append("Objects: ").append(objectCount).newline();
+    text.append("Threads: ").append(threadCount).newline();
+    text.append("Depth buffer: ").append(culler.getWidth()).append('x').append(culler.getHeight()).newline();
+    text.append("Frames: ").append(OCCLUSION_BENCHMARK_FRAMES).newline();
+    text.append("Rasterize time: ").append(static_cast<float>(rasterizeSec * 1000.0 / frames), 3).append(" ms/frame").newline();
+    text.append("Rasterize time per submitted triangle: ").append(static_cast<float>(rasterizeSec * 1e9 / submittedTriangles), 1).append(" ns").newline();
+    text.append("Rasterize time per drawn triangle: ").append(static_cast<float>(drawnTriangles ? rasterizeSec * 1e9 / drawnTriangles : 0.0), 1).append(" ns").newline();
+    text.append("Drawn triangles: ").append(static_cast<float>(drawnTriangles / frames), 0).append(" per frame").newline();
+    text.append("Box test time: ").append(static_cast<float>(testSec * 1000.0 / frames), 3).append(" ms/frame").newline();
+    text.append("Objects in view: ").append(static_cast<float>(visibleObjects / frames), 0).append(" per frame").newline();
+    text.append("Objects occluded: ").append(static_cast<float>(visibleObjects ? 100.0 * occludedObjects / visibleObjects : 0.0), 1).append("%").newline();
+
+    fputs(text.c_str(), stdout);
+    fflush(stdout);
+    return 0;
+}
+
+int RunPipelineBenchmark(int frameCount, int jobThreadCount, bool pinJobThreads)
+{
+    // Runs frameCount frames through the frame pipeline the way the
+    // application's WinMain() does, with synthetic work standing in for
+    // simulating (PIPELINE_BENCHMARK_SIMULATE_MS) and rendering
+    // (PIPELINE_BENCHMARK_RENDER_MS) each frame. Runs once with the
+    // simulation inline (-framelatency 1) and once pipelined. Latency is
+    // measured from when a frame's input is sampled to when it has been
+    // rendered. Every frame must be rendered exactly once and in order.
+
+    // Work out how many iterations of the synthetic work take a millisecond.
+    // The first run warms up the processor.
+
+    const int calibrationIterations = 10000000;
+    float checksum = PipelineBenchmarkWork(1.0f, calibrationIterations);
+    double startTime = GetTimeInSeconds();
+
+    checksum += PipelineBenchmarkWork(checksum, calibrationIterations);
+
+    double iterationsPerMs = calibrationIterations / (std::max)((GetTimeInSeconds() - startTime) * 1000.0, 1e-6);
+    int renderWork = static_cast<int>(iterationsPerMs * PIPELINE_BENCHMARK_RENDER_MS);
+
+    g_pipelineBenchmarkSimulateWork = static_cast<int>(iterationsPerMs * PIPELINE_BENCHMARK_SIMULATE_MS);
+
+    TextBuffer text;
+    bool passed = true;
+
+    text.append("Frames: ").append(frameCount).newline();
+    text.append("Simulate: ").append(PIPELINE_BENCHMARK_SIMULATE_MS, 1).append(" ms").newline();
+    text.append("Render: ").append(PIPELINE_BENCHMARK_RENDER_MS, 1).append(" ms").newline();
+
+    for (int run = 0; run < 2; ++run)
+    {
+        int frameLatency = (run == 0) ? 1 : PIPELINE_BENCHMARK_FRAME_LATENCY;
+        FramePipeline pipeline;
+        JobSystem jobSystem;
+
+        if (!jobSystem.create(jobThreadCount, pinJobThreads))
+            return 1;
+
+        if (!pipeline.create(SimulatePipelineBenchmarkFrame, &jobSystem, frameLatency > 1))
+        {
+            jobSystem.destroy();
+            return 1;
+        }
+
+        // One extra iteration renders the last frame kicked off when
+        // pipelined.
+
+        std::vector<double> latencies;
+        int lastRendered = -1;
+        int orderErrors = 0;
+
+        g_pipelineBenchmarkSimulated = 0;
+        latencies.reserve(frameCount);
+        startTime = GetTimeInSeconds();
+
+        for (int i = 0; i <= frameCount; ++i)
+        {
+            pipeline.wait();
+
+            if (i < frameCount)
+                pipeline.kick(PIPELINE_BENCHMARK_FRAME_TIME);
+
+            if (!pipeline.hasFrame())
+                continue;
+
+            const PipelineBenchmarkFrame &frame = g_pipelineBenchmarkStates[pipeline.readSlot()];
+
+            if (frame.frame == lastRendered)
+                continue;
+
+            if (frame.frame != lastRendered + 1)
+                ++orderErrors;
+
+            checksum += PipelineBenchmarkWork(frame.result, renderWork);
+            latencies.push_back(GetTimeInSeconds() - frame.inputTime);
+            lastRendered = frame.frame;
+        }
+
+        double totalSec = GetTimeInSeconds() - startTime;
+        bool pipelined = pipeline.isPipelined();
+
+        pipeline.destroy();
+        jobSystem.destroy();
+
+        int rendered = static_cast<int>(latencies.size());
+
+        if (orderErrors > 0 || rendered != frameCount)
+            passed = false;
+
+        std::sort(latencies.begin(), latencies.end());
+
+        double medianMs = 0.0;
+        double p99Ms = 0.0;
+
+        if (!latencies.empty())
+        {
+            medianMs = latencies[latencies.size() / 2] * 1000.0;
+            p99Ms = latencies[(latencies.size() - 1) * 99 / 100] * 1000.0;
+        }
+
+        text.newline();
+        text.append("Frame latency ").append(frameLatency)
+            .append(pipelined ? " (pipelined)" : " (inline)").newline();
+        text.append("Frames rendered: ").append(rendered).newline();
+        text.append("Order errors: ").append(orderErrors).newline();
+        text.append("Throughput: ").append(static_cast<float>(rendered / (std::max)(totalSec, 1e-9)), 1).append(" frames/sec").newline();
+        text.append("Latency median: ").append(static_cast<float>(medianMs), 3).append(" ms").newline();
+        text.append("Latency 99%: ").append(static_cast<float>(p99Ms), 3).append(" ms").newline();
+    }
+
+    if (checksum == 0.0f)
+        text.append("Checksum: 0").newline();
+
+    text.newline();
+    text.append(passed ? "PASSED" : "FAILED").newline();
+
+    fputs(text.c_str(), stdout);
+    fflush(stdout);
+    return passed ? 0 : 1;
+}
+
+int RunShaderStartupBenchmark(int runCount)
+{
+    // Compiles SHADER_FILENAME runCount times with its entry removed from
+    // the shader cache, which is what a cold start does, and runCount times
+    // with the entry in the cache, which is what a warm start does. Creating
+    // the effect from the compiled one needs a device and costs the same
+    // either way, so it isn't timed. The effect compiler is part of D3DX, so
+    // this only runs on Windows. Elsewhere it fails to set up.
+
+#if defined(_WIN32)
+    std::vector<char> source;
+    std::vector<char> compiled;
+    std::string errors;
+    ShaderCache shaderCache;
+    TextBuffer text;
+    bool cacheHit = false;
+    double coldTime = 0.0;
+    double warmTime = 0.0;
+    int warmCacheHits = 0;
+
+    if (!shaderCache.create(SHADER_CACHE_DIRECTORY) || !ReadAssetFile(SHADER_FILENAME, source))
+        return 1;
+
+    unsigned long long key = EffectCacheKey(source);
+
+    for (int i = 0; i < runCount; ++i)
+    {
+        shaderCache.remove(key);
+
+        double startTime = GetTimeInSeconds();
+
+        if (!CompileEffect(SHADER_FILENAME, shaderCache, compiled, errors, cacheHit))
+        {
+            fputs(errors.c_str(), stderr);
+            return 1;
+        }
+
+        double endTime = GetTimeInSeconds();
+
+        coldTime += endTime - startTime;
+        startTime = endTime;
+
+        if (CompileEffect(SHADER_FILENAME, shaderCache, compiled, errors, cacheHit) && cacheHit)
+            ++warmCacheHits;
+
+        warmTime += GetTimeInSeconds() - startTime;
+    }
+
+    double coldMs = coldTime * 1000.0 / runCount;
+    double warmMs = warmTime * 1000.0 / runCount;
+
+    text.append("Effect: ").append(SHADER_FILENAME).append(", ").append(static_cast<int>(source.size())).append(" bytes").newline();
+    text.append("Compiled effect: ").append(static_cast<int>(compiled.size())).append(" bytes").newline();
+    text.append("Runs: ").append(runCount).newline();
+    text.append("Cold start: ").append(static_cast<float>(coldMs), 2).append(" ms").newline();
+    text.append("Warm start: ").append(static_cast<float>(warmMs), 2).append(" ms").newline();
+    text.append("Warm cache hits: ").append(warmCacheHits).append(" of ").append(runCount).newline();
+    text.append("Speedup: ").append(static_cast<float>(warmMs > 0.0 ? coldMs / warmMs : 0.0), 1).append("x").newline();
+
+    fputs(text.c_str(), stdout);
+    fflush(stdout);
+    return 0;
+#else
+    fprintf(stderr, "Compiling %s needs the D3DX effect compiler, which is only available on Windows.\n",
+        SHADER_FILENAME);
+    return 1;
+#endif
+}
+
+int RunShadowBenchmark(int lightCount, int jobThreadCount, bool pinJobThreads)
+{
+    // Places lightCount spot lights over a synthetic city, looking down at
+    // random angles. Each frame a tenth of the lights move and the buildings
+    // are culled against every light's frustum on all of the processors. The
+    // lights a camera flying over the city would see are given atlas slots,
+    // and shadow maps that are still cached don't count as rendered. Finally
+    // the first light's casters are rendered into a software shadow map and
+    // the objects on the streets are shadowed with it.
+
+    std::vector<D3DXVECTOR3> vertices;
+    std::vector<int> indices;
+    std::vector<D3DXVECTOR3> objectMins;
+    std::vector<D3DXVECTOR3> objectMaxs;
+    std::vector<D3DXVECTOR3> casterCenters;
+    std::vector<float> casterRadii;
+    std::vector<D3DXVECTOR3> lightPositions;
+    std::vector<D3DXVECTOR3> lightDirections;
+    std::vector<float> lightCones;
+    std::vector<D3DXMATRIX> lightViewProjs;
+    JobSystem jobSystem;
+    ShadowAtlas atlas;
+    ShadowCasterCuller casterCuller;
+    SoftwareShadowMap shadowMap;
+    TextBuffer text;
+    unsigned int random = 54321;
+
+    if (!jobSystem.create(jobThreadCount, pinJobThreads))
+        return 1;
+
+    BuildCity(&jobSystem, SHADOW_BENCHMARK_CITY_SIZE, vertices, indices, objectMins, objectMaxs);
+
+    // BuildCity() makes each building from 8 vertices with the minimum
+    // corner first and the maximum corner last.
+
+    int buildingCount = static_cast<int>(vertices.size()) / 8;
+    float cityLength = SHADOW_BENCHMARK_CITY_SIZE * CITY_BLOCK_SIZE;
+
+    for (int i = 0; i < buildingCount; ++i)
+    {
+        D3DXVECTOR3 halfExtents = (vertices[i * 8 + 7] - vertices[i * 8]) * 0.5f;
+
+        casterCenters.push_back(vertices[i * 8] + halfExtents);
+        casterRadii.push_back(D3DXVec3Length(&halfExtents));
+    }
+
+    for (int i = 0; i < lightCount; ++i)
+    {
+        float r[4];
+
+        for (int j = 0; j < 4; ++j)
+        {
+            random = random * 1664525 + 1013904223;
+            r[j] = ((random >> 8) & 0xffff) / 65535.0f;
+        }
+
+        D3DXVECTOR3 dir(r[2] - 0.5f, -1.0f, r[3] - 0.5f);
+
+        D3DXVec3Normalize(&dir, &dir);
+        lightPositions.push_back(D3DXVECTOR3(r[0] * cityLength, CITY_MAX_BUILDING_HEIGHT + 10.0f, r[1] * cityLength));
+        lightDirections.push_back(dir);
+        lightCones.push_back(D3DXToRadian(60.0f + 40.0f * r[2]));
+    }
+
+    lightViewProjs.resize(lightCount);
+
+    for (int i = 0; i < lightCount; ++i)
+    {
+        SpotLightViewProjection(lightPositions[i], lightDirections[i], lightCones[i],
+            SHADOW_ZNEAR, SHADOW_BENCHMARK_LIGHT_RADIUS, lightViewProjs[i]);
+    }
+
+    int threadCount = jobSystem.workerCount() + 1;
+    int visibleLightCount = (lightCount + 1) / 2;
+    double cullSec = 0.0;
+    long long casterCount = 0;
+    long long renderedMaps = 0;
+
+    atlas.create(SHADOW_BENCHMARK_ATLAS_SIZE, SHADOW_BENCHMARK_MAP_SIZE);
+
+    for (int frame = 0; frame < SHADOW_BENCHMARK_FRAMES; ++frame)
+    {
+        // A tenth of the lights swing around, which invalidates their
+        // shadow maps.
+
+        for (int i = frame % 10; i < lightCount; i += 10)
+        {
+            float angle = 0.1f * frame;
+            D3DXVECTOR3 dir(0.5f * cosf(angle), -1.0f, 0.5f * sinf(angle));
+
+            D3DXVec3Normalize(&lightDirections[i], &dir);
+            SpotLightViewProjection(lightPositions[i], lightDirections[i], lightCones[i],
+                SHADOW_ZNEAR, SHADOW_BENCHMARK_LIGHT_RADIUS, lightViewProjs[i]);
+            atlas.invalidate(i);
+        }
+
+        double startTime = GetTimeInSeconds();
+
+        casterCuller.cull(&jobSystem, &lightViewProjs[0], lightCount,
+            &casterCenters[0], &casterRadii[0], buildingCount);
+        cullSec += GetTimeInSeconds() - startTime;
+
+        for (int i = 0; i < lightCount; ++i)
+            casterCount += casterCuller.getCasters(i).size();
+
+        // The visible lights are a window sliding over the lights as the
+        // camera moves along.
+
+        atlas.beginFrame();
+
+        for (int i = 0; i < visibleLightCount; ++i)
+        {
+            bool isCached = false;
+            int light = (frame + i) % lightCount;
+
+            if (atlas.allocate(light, isCached) >= 0 && !isCached)
+                ++renderedMaps;
+        }
+    }
+
+    // CPU reference shadowing for the first light.
+
+    const std::vector<int> &casters = casterCuller.getCasters(0);
+    int shadowedObjects = 0;
+
+    shadowMap.create(SHADOW_BENCHMARK_MAP_SIZE);
+
+    double renderStartTime = GetTimeInSeconds();
+
+    shadowMap.begin(lightViewProjs[0]);
+
+    for (size_t i = 0; i < casters.size(); ++i)
+        shadowMap.addCaster(&vertices[casters[i] * 8], 8, &indices[0], 12);
+
+    shadowMap.rasterize(&jobSystem);
+
+    double lookupStartTime = GetTimeInSeconds();
+    int objectCount = static_cast<int>(objectMins.size());
+
+    for (int i = 0; i < objectCount; ++i)
+    {
+        if (shadowMap.shadowFactor(objectMins[i]) < 0.5f)
+            ++shadowedObjects;
+    }
+
+    double lookupEndTime = GetTimeInSeconds();
+
+    jobSystem.destroy();
+
+    double frames = SHADOW_BENCHMARK_FRAMES;
+
+    text.append("Lights: ").append(lightCount).newline();
+    text.append("Shadow casters: ").append(buildingCount).newline();
+    text.append("Threads: ").append(threadCount).newline();
+    text.append("Frames: ").append(SHADOW_BENCHMARK_FRAMES).newline();
+    text.append("Caster culling time: ").append(static_cast<float>(cullSec * 1000.0 / frames), 3).append(" ms/frame").newline();
+    text.append("Caster culling time per light: ").append(static_cast<float>(cullSec * 1e6 / (frames * lightCount)), 2).append(" us").newline();
+    text.append("Casters per light: ").append(static_cast<float>(casterCount / (frames * lightCount)), 1).newline();
+    text.append("Atlas slots: ").append(atlas.getSlotCount()).append(" of ").append(atlas.getSlotSize()).append('x').append(atlas.getSlotSize()).newline();
+    text.append("Atlas hits: ").append(atlas.getHitCount()).newline();
+    text.append("Atlas misses: ").append(atlas.getMissCount()).newline();
+    text.append("Atlas evictions: ").append(atlas.getEvictionCount()).newline();
+    text.append("Shadow maps rendered: ").append(static_cast<float>(renderedMaps / frames), 1).append(" per frame").newline();
+    text.append("Software shadow map render time: ").append(static_cast<float>((lookupStartTime - renderStartTime) * 1000.0), 3).append(" ms").newline();
+    text.append("Software shadow lookups: ").append(static_cast<float>(objectCount / (lookupEndTime - lookupStartTime) / 1e6), 2).append(" million/sec").newline();
+    text.append("Objects shadowed by the first light: ").append(shadowedObjects).append(" of ").append(objectCount).newline();
+
+    fputs(text.c_str(), stdout);
+    fflush(stdout);
+    return 0;
+}
+
+int RunTemporalResolveTest(int frameCount)
+{
+    // Renders frameCount frames of a camera panning across a checkered
+    // floor while a sphere swings from side to side in front of it, with one
+    // jittered sample per pixel (see TraceTemporalTestScene()). Resolves the
+    // frames with TemporalResolve twice: with camera motion vectors only,
+    // and with the sphere's own motion vectors on top. After
+    // TEMPORAL_TEST_WARMUP_FRAMES frames both, and one unjittered sample per
+    // pixel, are compared with a supersampled reference of each frame, over
+    // the whole image and around the sphere (where it is or was last
+    // frame). The resolve with object motion vectors must beat no
+    // anti-aliasing over the whole image, and the camera only resolve around
+    // the sphere. Also reports the cost of the motion vectors and the
+    // resolve.
+
+    const int pixelCount = TEMPORAL_TEST_WIDTH * TEMPORAL_TEST_HEIGHT;
+    const float referenceWeight = 1.0f / (TEMPORAL_TEST_REFERENCE_GRID * TEMPORAL_TEST_REFERENCE_GRID);
+
+    std::vector<D3DXVECTOR3> color(pixelCount);
+    std::vector<D3DXVECTOR3> unjittered(pixelCount);
+    std::vector<D3DXVECTOR3> reference(pixelCount);
+    std::vector<D3DXVECTOR3> output[2];
+    std::vector<D3DXVECTOR2> motion[2];
+    std::vector<float> depth(pixelCount);
+    std::vector<int> objectIds(pixelCount);
+    std::vector<int> sphereMask(pixelCount, 0);
+    TemporalResolve resolves[2];
+    Camera camera;
+    TextBuffer text;
+    D3DXMATRIX world;
+    D3DXMATRIX previousWorld;
+    double squaredError[3] = {0.0, 0.0, 0.0};
+    double sphereSquaredError[3] = {0.0, 0.0, 0.0};
+    double motionSec = 0.0;
+    double resolveSec = 0.0;
+    int comparedPixels = 0;
+    int spherePixels = 0;
+
+    for (int i = 0; i < 2; ++i)
+    {
+        output[i].resize(pixelCount);
+        motion[i].resize(pixelCount);
+        resolves[i].create(TEMPORAL_TEST_WIDTH, TEMPORAL_TEST_HEIGHT);
+    }
+
+    camera.perspective(CAMERA_FOVX, static_cast<float>(TEMPORAL_TEST_WIDTH) / TEMPORAL_TEST_HEIGHT,
+        CAMERA_ZNEAR, CAMERA_ZFAR);
+    camera.setJitter(TEMPORAL_TEST_JITTER_SAMPLES, TEMPORAL_TEST_WIDTH, TEMPORAL_TEST_HEIGHT);
+    camera.lookAt(TEMPORAL_TEST_EYE, TEMPORAL_TEST_EYE + D3DXVECTOR3(0.0f, -0.4f, 1.0f),
+        D3DXVECTOR3(0.0f, 1.0f, 0.0f));
+
+    for (int frame = 0; frame < frameCount; ++frame)
+    {
+        float time = frame * TEMPORAL_TEST_FRAME_TIME;
+        float swing = 3.0f;
+        D3DXVECTOR3 sphereCenter(swing * sinf(time * TEMPORAL_TEST_SPHERE_SPEED / swing),
+            TEMPORAL_TEST_SPHERE_RADIUS, 4.0f);
+
+        camera.setPosition(TEMPORAL_TEST_EYE + D3DXVECTOR3(TEMPORAL_TEST_CAMERA_SPEED * time, 0.0f, 0.0f));
+        D3DXMatrixTranslation(&world, sphereCenter.x, sphereCenter.y, sphereCenter.z);
+
+        if (frame == 0)
+            previousWorld = world;
+
+        D3DXMATRIX viewProj = camera.getUnjitteredViewProjectionMatrix();
+        D3DXMATRIX jitteredViewProj = camera.getViewMatrix() * camera.getProjectionMatrix();
+        D3DXMATRIX invViewProj;
+        D3DXMATRIX invJitteredViewProj;
+
+        D3DXMatrixInverse(&invViewProj, 0, &viewProj);
+        D3DXMatrixInverse(&invJitteredViewProj, 0, &jitteredViewProj);
+
+        for (int y = 0; y < TEMPORAL_TEST_HEIGHT; ++y)
+        {
+            for (int x = 0; x < TEMPORAL_TEST_WIDTH; ++x)
+            {
+                int index = y * TEMPORAL_TEST_WIDTH + x;
+                float ndcX = (x + 0.5f) * 2.0f / TEMPORAL_TEST_WIDTH - 1.0f;
+                float ndcY = 1.0f - (y + 0.5f) * 2.0f / TEMPORAL_TEST_HEIGHT;
+                int unjitteredId = -1;
+
+                color[index] = TraceTemporalTestScene(invJitteredViewProj, viewProj, ndcX, ndcY,
+                    sphereCenter, &depth[index], &objectIds[index]);
+                unjittered[index] = TraceTemporalTestScene(invViewProj, viewProj, ndcX, ndcY,
+                    sphereCenter, 0, &unjitteredId);
+                reference[index] = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+
+                for (int j = 0; j < TEMPORAL_TEST_REFERENCE_GRID; ++j)
+                {
+                    for (int i = 0; i < TEMPORAL_TEST_REFERENCE_GRID; ++i)
+                    {
+                        float sampleX = (x + (i + 0.5f) / TEMPORAL_TEST_REFERENCE_GRID) * 2.0f / TEMPORAL_TEST_WIDTH - 1.0f;
+                        float sampleY = 1.0f - (y + (j + 0.5f) / TEMPORAL_TEST_REFERENCE_GRID) * 2.0f / TEMPORAL_TEST_HEIGHT;
+
+                        reference[index] += TraceTemporalTestScene(invViewProj, viewProj, sampleX, sampleY,
+                            sphereCenter, 0, 0) * referenceWeight;
+                    }
+                }
+
+                // Around the sphere is where it is now or was last frame.
+                sphereMask[index] = (sphereMask[index] & 1) << 1 | (unjitteredId == 0 ? 1 : 0);
+            }
+        }
+
+        double startTime = GetTimeInSeconds();
+
+        TemporalResolve::cameraMotionVectors(camera, &depth[0], TEMPORAL_TEST_WIDTH, TEMPORAL_TEST_HEIGHT, &motion[0][0]);
+        motion[1] = motion[0];
+        TemporalResolve::objectMotionVectors(camera, &depth[0], &objectIds[0], &world, &previousWorld, 1,
+            TEMPORAL_TEST_WIDTH, TEMPORAL_TEST_HEIGHT, &motion[1][0]);
+
+        motionSec += GetTimeInSeconds() - startTime;
+        startTime = GetTimeInSeconds();
+
+        for (int i = 0; i < 2; ++i)
+            resolves[i].resolve(&color[0], &motion[i][0], &output[i][0]);
+
+        resolveSec += (GetTimeInSeconds() - startTime) * 0.5;
+
+        if (frame >= TEMPORAL_TEST_WARMUP_FRAMES)
+        {
+            for (int i = 0; i < pixelCount; ++i)
+            {
+                const D3DXVECTOR3 *pResults[3] = {&unjittered[i], &output[0][i], &output[1][i]};
+
+                for (int r = 0; r < 3; ++r)
+                {
+                    D3DXVECTOR3 error = *pResults[r] - reference[i];
+                    float errorSq = D3DXVec3LengthSq(&error);
+
+                    squaredError[r] += errorSq;
+
+                    if (sphereMask[i])
+                        sphereSquaredError[r] += errorSq;
+                }
+
+                if (sphereMask[i])
+                    ++spherePixels;
+            }
+
+            comparedPixels += pixelCount;
+        }
+
+        previousWorld = world;
+        camera.advanceFrame();
+    }
+
+    float rmsError[3];
+    float sphereRmsError[3];
+
+    for (int r = 0; r < 3; ++r)
+    {
+        rmsError[r] = static_cast<float>(sqrt(squaredError[r] / (std::max)(comparedPixels, 1)));
+        sphereRmsError[r] = static_cast<float>(sqrt(sphereSquaredError[r] / (std::max)(spherePixels, 1)));
+    }
+
+    bool passed = comparedPixels > 0 && spherePixels > 0
+        && rmsError[2] < rmsError[0] && sphereRmsError[2] < sphereRmsError[1];
+
+    const char *pszNames[3] = {"No anti-aliasing", "Camera motion vectors", "Object motion vectors"};
+    int frames = (std::max)(frameCount, 1);
+
+    text.append("Resolution: ").append(TEMPORAL_TEST_WIDTH).append('x').append(TEMPORAL_TEST_HEIGHT).newline();
+    text.append("Frames: ").append(frameCount).newline();
+    text.append("Jitter samples: ").append(TEMPORAL_TEST_JITTER_SAMPLES).newline();
+    text.append("Reference samples per pixel: ").append(TEMPORAL_TEST_REFERENCE_GRID * TEMPORAL_TEST_REFERENCE_GRID).newline();
+
+    for (int r = 0; r < 3; ++r)
+    {
+        text.newline();
+        text.append(pszNames[r]).newline();
+        text.append("RMS error: ").append(rmsError[r], 4).newline();
+        text.append("RMS error around the sphere: ").append(sphereRmsError[r], 4).newline();
+    }
+
+    text.newline();
+    text.append("Motion vectors: ").append(static_cast<float>(motionSec * 1000.0 / frames), 3).append(" ms per frame").newline();
+    text.append("Resolve: ").append(static_cast<float>(resolveSec * 1000.0 / frames), 3).append(" ms per frame").newline();
+    text.append("Resolve per megapixel: ");
+    text.append(static_cast<float>(resolveSec * 1000.0 / frames * 1e6 / pixelCount), 1).append(" ms").newline();
+    text.newline();
+    text.append(passed ? "PASSED" : "FAILED").newline();
+
+    fputs(text.c_str(), stdout);
+    fflush(stdout);
+    return passed ? 0 : 1;
+}
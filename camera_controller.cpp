@@ -0,0 +1,226 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cfloat>
+#include "camera.h"
+#include "camera_controller.h"
+
+namespace
+{
+    const float DEFAULT_FLIGHT_YAW_SPEED = 100.0f;
+}
+
+CameraController::CameraController()
+{
+    m_boundsMin = D3DXVECTOR3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    m_boundsMax = D3DXVECTOR3(FLT_MAX, FLT_MAX, FLT_MAX);
+    m_boundsOrigin = WorldPosition(0.0, 0.0, 0.0);
+    m_flightYawSpeed = DEFAULT_FLIGHT_YAW_SPEED;
+}
+
+CameraController::~CameraController()
+{
+}
+
+void CameraController::clampToBounds(Camera &camera) const
+{
+    clampCamera(camera);
+}
+
+void CameraController::clampToBounds(FirstPersonCamera &camera) const
+{
+    clampCamera(camera);
+}
+
+void CameraController::clampToBounds(FlightCamera &camera) const
+{
+    clampCamera(camera);
+}
+
+void CameraController::clampToBounds(FollowCamera &camera) const
+{
+    clampCamera(camera);
+}
+
+void CameraController::clampToBounds(OrbitCamera &camera) const
+{
+    clampCamera(camera);
+}
+
+template <typename CameraType>
+void CameraController::clampCamera(CameraType &camera) const
+{
+    // The camera's position is relative to the camera's origin. Move the
+    // bounds there too. The offset between the two origins is calculated in
+    // double precision so this stays accurate far away from the world origin.
+
+    D3DXVECTOR3 originOffset = WorldOffset(m_boundsOrigin, camera.getOrigin());
+    D3DXVECTOR3 boundsMin = m_boundsMin + originOffset;
+    D3DXVECTOR3 boundsMax = m_boundsMax + originOffset;
+
+    if (camera.getBehavior() == CameraBase::CAMERA_BEHAVIOR_ORBIT
+        || camera.getBehavior() == CameraBase::CAMERA_BEHAVIOR_FOLLOW)
+    {
+        // Moving the eye on its own would leave the orbit target behind, and
+        // the next rotation would put the eye back outside. Clamp the target
+        // and place the eye behind it again, no further away than the bounds
+        // allow. The orbit distance is left alone so that the camera moves
+        // back out once there's room.
+
+        const D3DXVECTOR3 &target = camera.getOrbitTarget();
+        const D3DXVECTOR3 &zAxis = camera.getZAxis();
+        D3DXVECTOR3 newTarget;
+        float distance = camera.getOrbitDistance();
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            newTarget[axis] = (std::min)((std::max)(target[axis], boundsMin[axis]), boundsMax[axis]);
+
+            if (zAxis[axis] > 0.0f)
+                distance = (std::min)(distance, (newTarget[axis] - boundsMin[axis]) / zAxis[axis]);
+            else if (zAxis[axis] < 0.0f)
+                distance = (std::min)(distance, (newTarget[axis] - boundsMax[axis]) / zAxis[axis]);
+        }
+
+        camera.setOrbitTarget(newTarget);
+        camera.orbit(newTarget, distance);
+        return;
+    }
+
+    const D3DXVECTOR3 &pos = camera.getPosition();
+    D3DXVECTOR3 newPos(pos);
+
+    if (pos.x > boundsMax.x)
+        newPos.x = boundsMax.x;
+
+    if (pos.x < boundsMin.x)
+        newPos.x = boundsMin.x;
+
+    if (pos.y > boundsMax.y)
+        newPos.y = boundsMax.y;
+
+    if (pos.y < boundsMin.y)
+        newPos.y = boundsMin.y;
+
+    if (pos.z > boundsMax.z)
+        newPos.z = boundsMax.z;
+
+    if (pos.z < boundsMin.z)
+        newPos.z = boundsMin.z;
+
+    camera.setPosition(newPos);
+}
+
+template <typename CameraType>
+void CameraController::updateCamera(const CameraInput &input, float elapsedTimeSec,
+                                    CameraType &camera) const
+{
+    // For a BasicCamera getBehavior() is a compile time constant and the
+    // switch below folds away.
+
+    float heading = 0.0f;
+    float pitch = 0.0f;
+    float roll = 0.0f;
+    float rotationSpeed = camera.getRotationSpeed();
+    D3DXVECTOR3 direction = input.direction;
+    D3DXVECTOR3 velocity = camera.getCurrentVelocity();
+
+    // When movement along an axis starts the camera's current velocity along
+    // that axis is reset so that the camera doesn't drift in the direction
+    // it was previously moving in. Each started axis used to overwrite the
+    // whole velocity with the same snapshot (z axis first, then x, then y),
+    // so when several axes start on the same frame only the last one is
+    // actually reset. That order is kept here so replays stay identical.
+
+    if (input.started & CameraInput::STARTED_Y)
+        camera.setCurrentVelocity(velocity.x, 0.0f, velocity.z);
+    else if (input.started & CameraInput::STARTED_X)
+        camera.setCurrentVelocity(0.0f, velocity.y, velocity.z);
+    else if (input.started & CameraInput::STARTED_Z)
+        camera.setCurrentVelocity(velocity.x, velocity.y, 0.0f);
+
+    switch (camera.getBehavior())
+    {
+    case CameraBase::CAMERA_BEHAVIOR_FIRST_PERSON:
+    case CameraBase::CAMERA_BEHAVIOR_ORBIT:
+    case CameraBase::CAMERA_BEHAVIOR_FOLLOW:
+        pitch = input.mouseY * rotationSpeed;
+        heading = input.mouseX * rotationSpeed;
+
+        camera.rotate(heading, pitch, 0.0f);
+        break;
+
+    case CameraBase::CAMERA_BEHAVIOR_FLIGHT:
+        heading = direction.x * m_flightYawSpeed * elapsedTimeSec;
+        pitch = -input.mouseY * rotationSpeed;
+        roll = input.mouseX * rotationSpeed;
+
+        camera.rotate(heading, pitch, roll);
+        direction.x = 0.0f; // ignore yaw motion when updating camera velocity
+        break;
+    }
+
+    camera.updatePosition(direction, elapsedTimeSec);
+    clampToBounds(camera);
+}
+
+void CameraController::update(const CameraInput &input, float elapsedTimeSec, Camera &camera) const
+{
+    updateCamera(input, elapsedTimeSec, camera);
+}
+
+void CameraController::update(const CameraInput &input, float elapsedTimeSec, FirstPersonCamera &camera) const
+{
+    updateCamera(input, elapsedTimeSec, camera);
+}
+
+void CameraController::update(const CameraInput &input, float elapsedTimeSec, FlightCamera &camera) const
+{
+    updateCamera(input, elapsedTimeSec, camera);
+}
+
+void CameraController::update(const CameraInput &input, float elapsedTimeSec, FollowCamera &camera) const
+{
+    updateCamera(input, elapsedTimeSec, camera);
+}
+
+void CameraController::update(const CameraInput &input, float elapsedTimeSec, OrbitCamera &camera) const
+{
+    updateCamera(input, elapsedTimeSec, camera);
+}
+
+void CameraController::setBounds(const D3DXVECTOR3 &boundsMin, const D3DXVECTOR3 &boundsMax)
+{
+    m_boundsMin = boundsMin;
+    m_boundsMax = boundsMax;
+}
+
+void CameraController::setBoundsOrigin(const WorldPosition &origin)
+{
+    m_boundsOrigin = origin;
+}
+
+void CameraController::setFlightYawSpeed(float degreesPerSec)
+{
+    m_flightYawSpeed = degreesPerSec;
+}
@@ -0,0 +1,120 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(CAMERA_CONTROLLER_H)
+#define CAMERA_CONTROLLER_H
+
+#include <d3dx9.h>
+#include "camera.h"
+
+//-----------------------------------------------------------------------------
+// The input that drives a camera for one update. It's independent of where
+// the input came from: the live devices, a recorded input log, or a
+// synthetic generator.
+//-----------------------------------------------------------------------------
+
+struct CameraInput
+{
+    enum
+    {
+        STARTED_X = 1,      // movement along the camera's x axis started
+        STARTED_Y = 2,      // movement along the camera's y axis started
+        STARTED_Z = 4       // movement along the camera's z axis started
+    };
+
+    D3DXVECTOR3 direction;  // movement direction, each axis in the range [-1,1]
+    unsigned int started;   // STARTED_X, STARTED_Y, and STARTED_Z flags
+    float mouseX;           // relative mouse movement
+    float mouseY;
+};
+
+//-----------------------------------------------------------------------------
+// The CameraController class applies CameraInput to a Camera: it turns the
+// camera according to its behavior, moves it, and keeps it inside a bounding
+// box. The box is given relative to a bounds origin so that it works with
+// cameras whose origin isn't the world origin (see CameraBase). Orbit and
+// follow cameras keep their orbit target inside the box instead, and are
+// pulled in towards the target when the box cuts their orbit short. It doesn't
+// touch any devices or windows, and update() only modifies
+// the camera passed to it, so one controller can update any number of
+// cameras from any number of threads at once. There is an update() overload
+// for each BasicCamera so that the behavior isn't switched on for those.
+//-----------------------------------------------------------------------------
+
+class CameraController
+{
+public:
+    CameraController();
+    ~CameraController();
+
+    void clampToBounds(Camera &camera) const;
+    void clampToBounds(FirstPersonCamera &camera) const;
+    void clampToBounds(FlightCamera &camera) const;
+    void clampToBounds(FollowCamera &camera) const;
+    void clampToBounds(OrbitCamera &camera) const;
+    void update(const CameraInput &input, float elapsedTimeSec, Camera &camera) const;
+    void update(const CameraInput &input, float elapsedTimeSec, FirstPersonCamera &camera) const;
+    void update(const CameraInput &input, float elapsedTimeSec, FlightCamera &camera) const;
+    void update(const CameraInput &input, float elapsedTimeSec, FollowCamera &camera) const;
+    void update(const CameraInput &input, float elapsedTimeSec, OrbitCamera &camera) const;
+
+    // Getter methods.
+
+    const D3DXVECTOR3 &getBoundsMax() const;
+    const D3DXVECTOR3 &getBoundsMin() const;
+    const WorldPosition &getBoundsOrigin() const;
+    float getFlightYawSpeed() const;
+
+    // Setter methods.
+
+    void setBounds(const D3DXVECTOR3 &boundsMin, const D3DXVECTOR3 &boundsMax);
+    void setBoundsOrigin(const WorldPosition &origin);
+    void setFlightYawSpeed(float degreesPerSec);
+
+private:
+    template <typename CameraType>
+    void clampCamera(CameraType &camera) const;
+
+    template <typename CameraType>
+    void updateCamera(const CameraInput &input, float elapsedTimeSec, CameraType &camera) const;
+
+    D3DXVECTOR3 m_boundsMin;
+    D3DXVECTOR3 m_boundsMax;
+    WorldPosition m_boundsOrigin;
+    float m_flightYawSpeed;
+};
+
+//-----------------------------------------------------------------------------
+
+inline const D3DXVECTOR3 &CameraController::getBoundsMax() const
+{ return m_boundsMax; }
+
+inline const D3DXVECTOR3 &CameraController::getBoundsMin() const
+{ return m_boundsMin; }
+
+inline const WorldPosition &CameraController::getBoundsOrigin() const
+{ return m_boundsOrigin; }
+
+inline float CameraController::getFlightYawSpeed() const
+{ return m_flightYawSpeed; }
+
+#endif
@@ -0,0 +1,106 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include "camera_input.h"
+#include "input.h"
+#include "input_recorder.h"
+
+void BindCameraActions(ActionMap &actionMap)
+{
+    actionMap.bind(ACTION_MOVE_FORWARDS, Keyboard::KEY_UP);
+    actionMap.bind(ACTION_MOVE_FORWARDS, Keyboard::KEY_W);
+    actionMap.bind(ACTION_MOVE_BACKWARDS, Keyboard::KEY_DOWN);
+    actionMap.bind(ACTION_MOVE_BACKWARDS, Keyboard::KEY_S);
+    actionMap.bind(ACTION_MOVE_RIGHT, Keyboard::KEY_RIGHT);
+    actionMap.bind(ACTION_MOVE_RIGHT, Keyboard::KEY_D);
+    actionMap.bind(ACTION_MOVE_LEFT, Keyboard::KEY_LEFT);
+    actionMap.bind(ACTION_MOVE_LEFT, Keyboard::KEY_A);
+    actionMap.bind(ACTION_MOVE_UP, Keyboard::KEY_E);
+    actionMap.bind(ACTION_MOVE_UP, Keyboard::KEY_PAGEUP);
+    actionMap.bind(ACTION_MOVE_DOWN, Keyboard::KEY_Q);
+    actionMap.bind(ACTION_MOVE_DOWN, Keyboard::KEY_PAGEDOWN);
+}
+
+void GetCameraInput(const ActionMap &actionMap, float mouseX, float mouseY,
+                    CameraInput &input)
+{
+    input.direction.x = actionMap.axis(ACTION_MOVE_RIGHT, ACTION_MOVE_LEFT);
+    input.direction.y = actionMap.axis(ACTION_MOVE_UP, ACTION_MOVE_DOWN);
+    input.direction.z = actionMap.axis(ACTION_MOVE_FORWARDS, ACTION_MOVE_BACKWARDS);
+    input.started = 0;
+    input.mouseX = mouseX;
+    input.mouseY = mouseY;
+
+    if (actionMap.started(ACTION_MOVE_RIGHT) || actionMap.started(ACTION_MOVE_LEFT))
+        input.started |= CameraInput::STARTED_X;
+
+    if (actionMap.started(ACTION_MOVE_UP) || actionMap.started(ACTION_MOVE_DOWN))
+        input.started |= CameraInput::STARTED_Y;
+
+    if (actionMap.started(ACTION_MOVE_FORWARDS) || actionMap.started(ACTION_MOVE_BACKWARDS))
+        input.started |= CameraInput::STARTED_Z;
+}
+
+void ReadCameraInputs(InputPlayback &playback, std::vector<CameraInput> &inputs)
+{
+    // A key is pressed on the frame it went down and on any frame it was
+    // tapped on.
+
+    ActionMap actionMap;
+    InputFrame frame;
+    InputBits down;
+    InputBits pressed;
+    InputBits prevDown;
+    CameraInput input;
+
+    BindCameraActions(actionMap);
+    actionMap.compile();
+    prevDown.clear();
+
+    while (playback.read(frame))
+    {
+        down.clear();
+        pressed.clear();
+
+        for (int i = 0; i < 256; ++i)
+        {
+            if (frame.keyStates[i] & 0x80)
+            {
+                down.set(i);
+
+                if (!prevDown.test(i))
+                    pressed.set(i);
+            }
+
+            if (frame.keyTaps[i] & 0x80)
+                pressed.set(i);
+        }
+
+        prevDown = down;
+        actionMap.evaluate(down, pressed);
+
+        GetCameraInput(actionMap, static_cast<float>(frame.mouseX),
+            static_cast<float>(frame.mouseY), input);
+
+        inputs.push_back(input);
+    }
+}
@@ -0,0 +1,62 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(CAMERA_INPUT_H)
+#define CAMERA_INPUT_H
+
+#include <vector>
+#include "action_map.h"
+#include "camera_controller.h"
+
+class InputPlayback;
+
+//-----------------------------------------------------------------------------
+// The camera movement actions and their default key bindings. These are
+// shared by the interactive application and the headless camera server so
+// that both turn the same keys (live or from a recorded input log) into the
+// same CameraInput. Applications number their own actions from
+// CAMERA_ACTION_COUNT onwards.
+//-----------------------------------------------------------------------------
+
+enum CameraAction
+{
+    ACTION_MOVE_FORWARDS,
+    ACTION_MOVE_BACKWARDS,
+    ACTION_MOVE_RIGHT,
+    ACTION_MOVE_LEFT,
+    ACTION_MOVE_UP,
+    ACTION_MOVE_DOWN,
+    CAMERA_ACTION_COUNT
+};
+
+// Binds the movement keys to the camera actions. Doesn't compile the map.
+void BindCameraActions(ActionMap &actionMap);
+
+// Translates the camera actions of an evaluated action map into camera input.
+void GetCameraInput(const ActionMap &actionMap, float mouseX, float mouseY,
+                    CameraInput &input);
+
+// Converts the rest of a recorded input log into camera input, one per frame.
+// The mouse movement is used as recorded, without the Mouse class' filtering.
+void ReadCameraInputs(InputPlayback &playback, std::vector<CameraInput> &inputs);
+
+#endif
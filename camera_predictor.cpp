@@ -0,0 +1,265 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <cmath>
+#include "camera.h"
+#include "camera_predictor.h"
+
+namespace
+{
+    // Time constants of the exponential smoothing applied to the estimated
+    // acceleration and angular velocity. Mouse input in particular is noisy.
+    const float ACCELERATION_SMOOTHING_SEC = 0.05f;
+    const float ANGULAR_VELOCITY_SMOOTHING_SEC = 0.03f;
+
+    // Weight given to each new misprediction measurement.
+    const float ERROR_SMOOTHING = 0.1f;
+
+    // Mispredictions of this size halve the confidence.
+    const float POSITION_ERROR_TOLERANCE = 0.02f;
+    const float ANGLE_ERROR_TOLERANCE_DEGREES = 0.5f;
+
+    // Never extrapolate further than this no matter what the caller asks for.
+    const float MAX_LEAD_TIME_SEC = 0.1f;
+
+    const D3DXVECTOR3 WORLD_YAXIS(0.0f, 1.0f, 0.0f);
+
+    float AngleBetween(const D3DXQUATERNION &a, const D3DXQUATERNION &b)
+    {
+        // Returns the angle in degrees of the rotation taking a to b.
+
+        float cosHalfAngle = fabsf(D3DXQuaternionDot(&a, &b));
+
+        if (cosHalfAngle >= 1.0f)
+            return 0.0f;
+
+        return D3DXToDegree(2.0f * acosf(cosHalfAngle));
+    }
+
+    float SmoothingFactor(float elapsedTimeSec, float timeConstantSec)
+    {
+        return 1.0f - expf(-elapsedTimeSec / timeConstantSec);
+    }
+}
+
+CameraPredictor::CameraPredictor()
+{
+    reset();
+}
+
+CameraPredictor::~CameraPredictor()
+{
+}
+
+void CameraPredictor::predict(float leadTimeSec, Camera &camera)
+{
+    // Replaces the camera's pose with the pose predicted for leadTimeSec
+    // seconds after the last update().
+
+    if (leadTimeSec > MAX_LEAD_TIME_SEC)
+        leadTimeSec = MAX_LEAD_TIME_SEC;
+    else if (leadTimeSec < 0.0f)
+        leadTimeSec = 0.0f;
+
+    D3DXVECTOR3 currentEye = camera.getPosition();
+    D3DXQUATERNION currentOrientation = camera.getOrientation();
+    D3DXVECTOR3 eye;
+    D3DXQUATERNION orientation;
+
+    // Mispredictions are measured against the full lead time prediction. If
+    // they were measured against the displayed one, the lag introduced by a
+    // low confidence would itself be counted as error and the confidence
+    // would never recover.
+
+    extrapolate(leadTimeSec, currentEye, currentOrientation, eye, orientation);
+
+    if (m_predictionCount == MAX_PREDICTIONS)
+    {
+        m_firstPrediction = (m_firstPrediction + 1) % MAX_PREDICTIONS;
+        --m_predictionCount;
+    }
+
+    Prediction &prediction = m_predictions[(m_firstPrediction + m_predictionCount) % MAX_PREDICTIONS];
+
+    prediction.time = m_time + leadTimeSec;
+    prediction.eye = eye;
+    prediction.orientation = orientation;
+    ++m_predictionCount;
+
+    extrapolate(leadTimeSec * m_confidence, currentEye, currentOrientation, eye, orientation);
+
+    camera.setPosition(eye);
+    camera.setOrientation(orientation);
+}
+
+void CameraPredictor::reset()
+{
+    m_hasPreviousPose = false;
+    m_time = 0.0f;
+    m_positionError = 0.0f;
+    m_angleError = 0.0f;
+    m_confidence = 1.0f;
+    m_velocity = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+    m_acceleration = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+    m_angularVelocity = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+    D3DXQuaternionIdentity(&m_prevOrientation);
+    m_predictionCount = 0;
+    m_firstPrediction = 0;
+}
+
+void CameraPredictor::update(float elapsedTimeSec, const Camera &camera)
+{
+    const D3DXVECTOR3 &localVelocity = camera.getCurrentVelocity();
+    const D3DXVECTOR3 &xAxis = camera.getXAxis();
+    D3DXQUATERNION orientation = camera.getOrientation();
+    D3DXVECTOR3 forwards;
+
+    m_time += elapsedTimeSec;
+
+    // The camera's current velocity is along the same directions that
+    // Camera::move() moves the camera in.
+
+    if (camera.getBehavior() == Camera::CAMERA_BEHAVIOR_FIRST_PERSON)
+    {
+        D3DXVec3Cross(&forwards, &xAxis, &WORLD_YAXIS);
+        D3DXVec3Normalize(&forwards, &forwards);
+    }
+    else
+    {
+        forwards = camera.getViewDirection();
+    }
+
+    D3DXVECTOR3 velocity = xAxis * localVelocity.x
+        + WORLD_YAXIS * localVelocity.y + forwards * localVelocity.z;
+
+    if (m_hasPreviousPose && elapsedTimeSec > 0.0f)
+    {
+        // The camera's acceleration setting is the most it will ever
+        // accelerate by. Anything larger is a change in direction between
+        // two frames that isn't worth extrapolating.
+
+        D3DXVECTOR3 acceleration = (velocity - m_velocity) / elapsedTimeSec;
+        float maxAcceleration = D3DXVec3Length(&camera.getAcceleration());
+        float length = D3DXVec3Length(&acceleration);
+
+        if (length > maxAcceleration)
+            acceleration *= maxAcceleration / length;
+
+        m_acceleration += (acceleration - m_acceleration)
+            * SmoothingFactor(elapsedTimeSec, ACCELERATION_SMOOTHING_SEC);
+
+        // The world space rotation from the previous orientation to the
+        // current one, converted to an angular velocity vector.
+
+        D3DXQUATERNION inversePrev;
+        D3DXQUATERNION delta;
+
+        D3DXQuaternionConjugate(&inversePrev, &m_prevOrientation);
+        D3DXQuaternionMultiply(&delta, &inversePrev, &orientation);
+
+        if (delta.w < 0.0f)
+            delta = -delta;
+
+        D3DXVECTOR3 axis(delta.x, delta.y, delta.z);
+        D3DXVECTOR3 angularVelocity(0.0f, 0.0f, 0.0f);
+        float sinHalfAngle = D3DXVec3Length(&axis);
+
+        if (sinHalfAngle > 1e-7f)
+        {
+            float angle = 2.0f * atan2f(sinHalfAngle, delta.w);
+            angularVelocity = axis * (angle / (sinHalfAngle * elapsedTimeSec));
+        }
+
+        m_angularVelocity += (angularVelocity - m_angularVelocity)
+            * SmoothingFactor(elapsedTimeSec, ANGULAR_VELOCITY_SMOOTHING_SEC);
+    }
+
+    m_velocity = velocity;
+    m_prevOrientation = orientation;
+    m_hasPreviousPose = true;
+
+    checkPredictions(camera.getPosition(), orientation);
+}
+
+void CameraPredictor::checkPredictions(const D3DXVECTOR3 &eye, const D3DXQUATERNION &orientation)
+{
+    // Compares the predictions whose display time has now passed with the
+    // actual pose and updates the confidence.
+
+    while (m_predictionCount > 0 && m_predictions[m_firstPrediction].time <= m_time)
+    {
+        const Prediction &prediction = m_predictions[m_firstPrediction];
+        D3DXVECTOR3 offset = prediction.eye - eye;
+
+        m_positionError += (D3DXVec3Length(&offset) - m_positionError) * ERROR_SMOOTHING;
+        m_angleError += (AngleBetween(prediction.orientation, orientation) - m_angleError) * ERROR_SMOOTHING;
+
+        m_firstPrediction = (m_firstPrediction + 1) % MAX_PREDICTIONS;
+        --m_predictionCount;
+    }
+
+    m_confidence = (POSITION_ERROR_TOLERANCE / (POSITION_ERROR_TOLERANCE + m_positionError))
+        * (ANGLE_ERROR_TOLERANCE_DEGREES / (ANGLE_ERROR_TOLERANCE_DEGREES + m_angleError));
+}
+
+void CameraPredictor::extrapolate(float timeSec, const D3DXVECTOR3 &eye,
+                                  const D3DXQUATERNION &orientation,
+                                  D3DXVECTOR3 &predictedEye,
+                                  D3DXQUATERNION &predictedOrientation) const
+{
+    // Constant acceleration, except that an axis that is decelerating stops
+    // at rest instead of reversing. That's how the camera itself behaves once
+    // the movement keys are released.
+
+    const float *pVelocity = m_velocity;
+    const float *pAcceleration = m_acceleration;
+    const float *pEye = eye;
+    float *pPredictedEye = predictedEye;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        float v = pVelocity[i];
+        float a = pAcceleration[i];
+        float t = timeSec;
+
+        if (v * a < 0.0f && -v / a < t)
+            t = -v / a;
+
+        pPredictedEye[i] = pEye[i] + v * t + 0.5f * a * t * t;
+    }
+
+    // Constant angular velocity.
+
+    float angularSpeed = D3DXVec3Length(&m_angularVelocity);
+
+    predictedOrientation = orientation;
+
+    if (angularSpeed > 1e-6f)
+    {
+        D3DXVECTOR3 axis = m_angularVelocity / angularSpeed;
+        D3DXQUATERNION rotation;
+
+        D3DXQuaternionRotationAxis(&rotation, &axis, angularSpeed * timeSec);
+        D3DXQuaternionMultiply(&predictedOrientation, &orientation, &rotation);
+        D3DXQuaternionNormalize(&predictedOrientation, &predictedOrientation);
+    }
+}
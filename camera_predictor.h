@@ -0,0 +1,122 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(CAMERA_PREDICTOR_H)
+#define CAMERA_PREDICTOR_H
+
+#include <d3dx9.h>
+
+class Camera;
+
+//-----------------------------------------------------------------------------
+// The CameraPredictor class extrapolates the camera's pose to the time the
+// frame being simulated will actually be displayed. Several frames usually
+// pass between sampling the input and the frame reaching the screen. Drawing
+// the predicted rather than the sampled pose hides most of that latency.
+//
+// update() is called once per simulation step after the camera has moved. It
+// converts the camera's current velocity into world space, estimates the
+// acceleration from the change in velocity, and estimates the angular
+// velocity from the change in orientation.
+//
+// predict() moves a copy of the camera forwards in time by the given lead
+// time. Position uses constant acceleration, but stops at the point where
+// deceleration would bring the camera to rest rather than reversing it.
+// Orientation keeps turning at the estimated angular velocity.
+//
+// Mispredictions are measured by comparing each prediction with the actual
+// pose once its display time has passed. The smoothed errors drive a
+// confidence value in the range (0,1] that scales the lead time, so the
+// predictor backs off whenever the motion stops being predictable (e.g.,
+// sudden changes in direction) and recovers once it is predictable again.
+//-----------------------------------------------------------------------------
+
+class CameraPredictor
+{
+public:
+    CameraPredictor();
+    ~CameraPredictor();
+
+    void predict(float leadTimeSec, Camera &camera);
+    void reset();
+    void update(float elapsedTimeSec, const Camera &camera);
+
+    // Getter methods.
+
+    const D3DXVECTOR3 &getAcceleration() const;
+    float getAngleError() const;
+    const D3DXVECTOR3 &getAngularVelocity() const;
+    float getConfidence() const;
+    float getPositionError() const;
+    const D3DXVECTOR3 &getVelocity() const;
+
+private:
+    struct Prediction
+    {
+        float time;
+        D3DXVECTOR3 eye;
+        D3DXQUATERNION orientation;
+    };
+
+    enum { MAX_PREDICTIONS = 16 };
+
+    void checkPredictions(const D3DXVECTOR3 &eye, const D3DXQUATERNION &orientation);
+    void extrapolate(float timeSec, const D3DXVECTOR3 &eye,
+                     const D3DXQUATERNION &orientation,
+                     D3DXVECTOR3 &predictedEye,
+                     D3DXQUATERNION &predictedOrientation) const;
+
+    bool m_hasPreviousPose;
+    float m_time;
+    float m_positionError;
+    float m_angleError;
+    float m_confidence;
+    D3DXVECTOR3 m_velocity;
+    D3DXVECTOR3 m_acceleration;
+    D3DXVECTOR3 m_angularVelocity;
+    D3DXQUATERNION m_prevOrientation;
+    int m_predictionCount;
+    int m_firstPrediction;
+    Prediction m_predictions[MAX_PREDICTIONS];
+};
+
+//-----------------------------------------------------------------------------
+
+inline const D3DXVECTOR3 &CameraPredictor::getAcceleration() const
+{ return m_acceleration; }
+
+inline float CameraPredictor::getAngleError() const
+{ return m_angleError; }
+
+inline const D3DXVECTOR3 &CameraPredictor::getAngularVelocity() const
+{ return m_angularVelocity; }
+
+inline float CameraPredictor::getConfidence() const
+{ return m_confidence; }
+
+inline float CameraPredictor::getPositionError() const
+{ return m_positionError; }
+
+inline const D3DXVECTOR3 &CameraPredictor::getVelocity() const
+{ return m_velocity; }
+
+#endif
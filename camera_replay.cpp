@@ -0,0 +1,251 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstring>
+#include "app_camera.h"
+#include "app_input.h"
+#include "camera_input.h"
+#include "camera_replay.h"
+#include "input.h"
+
+void GetCameraState(const Camera &camera, CameraState &state)
+{
+    state.behavior = camera.getBehavior();
+    state.position = camera.getWorldPosition();
+    state.orientation = camera.getOrientation();
+    state.velocity = camera.getCurrentVelocity();
+    state.rotationSpeed = camera.getRotationSpeed();
+}
+
+bool LoadCameraState(const char *pszFilename, CameraState &state)
+{
+    FILE *pFile = fopen(pszFilename, "r");
+
+    if (!pFile)
+        return false;
+
+    bool loaded = fscanf(pFile, " behavior %d", &state.behavior) == 1 &&
+        fscanf(pFile, " position %lf %lf %lf", &state.position.x, &state.position.y, &state.position.z) == 3 &&
+        fscanf(pFile, " orientation %f %f %f %f", &state.orientation.x, &state.orientation.y,
+            &state.orientation.z, &state.orientation.w) == 4 &&
+        fscanf(pFile, " velocity %f %f %f", &state.velocity.x, &state.velocity.y, &state.velocity.z) == 3 &&
+        fscanf(pFile, " rotationspeed %f", &state.rotationSpeed) == 1;
+
+    fclose(pFile);
+    return loaded;
+}
+
+bool SaveCameraState(const char *pszFilename, const CameraState &state)
+{
+    // A text file. Enough digits are written for the values to read back
+    // exactly.
+
+    FILE *pFile = fopen(pszFilename, "w");
+
+    if (!pFile)
+        return false;
+
+    fprintf(pFile, "behavior %d\n", state.behavior);
+    fprintf(pFile, "position %.17g %.17g %.17g\n", state.position.x, state.position.y, state.position.z);
+    fprintf(pFile, "orientation %.9g %.9g %.9g %.9g\n", state.orientation.x, state.orientation.y,
+        state.orientation.z, state.orientation.w);
+    fprintf(pFile, "velocity %.9g %.9g %.9g\n", state.velocity.x, state.velocity.y, state.velocity.z);
+    fprintf(pFile, "rotationspeed %.9g\n", state.rotationSpeed);
+
+    bool saved = ferror(pFile) == 0;
+
+    return (fclose(pFile) == 0) && saved;
+}
+
+CameraReplay::CameraReplay()
+{
+    m_elapsedTimeSec = 0.0f;
+    m_followSubjectTimeSec = 0.0f;
+    m_flightModeEnabled = false;
+    m_behaviorChanged = false;
+}
+
+CameraReplay::~CameraReplay()
+{
+    close();
+}
+
+bool CameraReplay::open(const char *pszFilename)
+{
+    // As the application's InitActionMap(), InitCamera() and
+    // InitCameraController() without -worldoffset.
+
+    close();
+
+    if (!m_playback.open(pszFilename))
+        return false;
+
+    InitActionMap(m_actionMap);
+
+    m_camera = Camera();
+    m_camera.setBehavior(Camera::CAMERA_BEHAVIOR_FIRST_PERSON);
+    m_camera.setWorldPosition(WorldPosition(CAMERA_POS));
+    m_camera.setAcceleration(CAMERA_ACCELERATION);
+    m_camera.setVelocity(CAMERA_VELOCITY);
+
+    m_controller = CameraController();
+    m_controller.setBounds(D3DXVECTOR3(-FLOOR_WIDTH / 2.0f, CAMERA_POS.y, -FLOOR_HEIGHT / 2.0f),
+        D3DXVECTOR3(FLOOR_WIDTH / 2.0f, 4.0f, FLOOR_HEIGHT / 2.0f));
+    m_controller.setFlightYawSpeed(CAMERA_SPEED_FLIGHT_YAW);
+
+    m_rig = CameraRig();
+    m_followSubjectTimeSec = 0.0f;
+    m_flightModeEnabled = false;
+
+    return true;
+}
+
+void CameraReplay::close()
+{
+    m_playback.close();
+    m_elapsedTimeSec = 0.0f;
+    m_behaviorChanged = false;
+}
+
+bool CameraReplay::update()
+{
+    // As the application's UpdateInputFromPlayback(), ProcessUserInput() and
+    // UpdateCamera(). Keep them in step. The behavior changes are as in
+    // ToggleFlightMode() and CycleCameraMode().
+
+    Keyboard &keyboard = Keyboard::instance();
+    Mouse &mouse = Mouse::instance();
+    InputFrame frame;
+    DIMOUSESTATE mouseState;
+    CameraInput input;
+    D3DXVECTOR3 subjectPos;
+    float subjectHeading = 0.0f;
+
+    m_behaviorChanged = false;
+
+    if (!m_playback.isOpen() || !m_playback.read(frame))
+        return false;
+
+    mouseState.lX = frame.mouseX;
+    mouseState.lY = frame.mouseY;
+    mouseState.lZ = frame.mouseWheel;
+    memcpy(mouseState.rgbButtons, frame.mouseButtons, sizeof(mouseState.rgbButtons));
+
+    keyboard.update(frame.keyStates, frame.keyTaps);
+    mouse.update(mouseState, frame.mouseButtonTaps, frame.mouseRawInput,
+        frame.pMouseReports, frame.mouseReportCount);
+
+    m_elapsedTimeSec = frame.elapsedTimeSec;
+    UpdateActionMap(m_actionMap);
+
+    if (m_actionMap.triggered(ACTION_INCREASE_ROTATION_SPEED))
+    {
+        m_camera.setRotationSpeed(m_camera.getRotationSpeed() + 0.01f);
+
+        if (m_camera.getRotationSpeed() > 1.0f)
+            m_camera.setRotationSpeed(1.0f);
+    }
+
+    if (m_actionMap.triggered(ACTION_DECREASE_ROTATION_SPEED))
+    {
+        m_camera.setRotationSpeed(m_camera.getRotationSpeed() - 0.01f);
+
+        if (m_camera.getRotationSpeed() <= 0.0f)
+            m_camera.setRotationSpeed(0.01f);
+    }
+
+    if (m_actionMap.triggered(ACTION_INCREASE_MOUSE_WEIGHT))
+    {
+        mouse.setWeightModifier(mouse.weightModifier() + 0.1f);
+
+        if (mouse.weightModifier() > 1.0f)
+            mouse.setWeightModifier(1.0f);
+    }
+
+    if (m_actionMap.triggered(ACTION_DECREASE_MOUSE_WEIGHT))
+    {
+        mouse.setWeightModifier(mouse.weightModifier() - 0.1f);
+
+        if (mouse.weightModifier() < 0.0f)
+            mouse.setWeightModifier(0.0f);
+    }
+
+    if (m_actionMap.triggered(ACTION_TOGGLE_MOUSE_SMOOTHING))
+        mouse.smoothMouse(!mouse.isMouseSmoothing());
+
+    if (m_actionMap.triggered(ACTION_TOGGLE_FLIGHT_MODE))
+    {
+        m_flightModeEnabled = !m_flightModeEnabled;
+        m_behaviorChanged = true;
+
+        if (m_flightModeEnabled)
+            m_camera.setBehavior(Camera::CAMERA_BEHAVIOR_FLIGHT);
+        else
+            setFirstPersonBehavior();
+    }
+
+    if (m_actionMap.triggered(ACTION_CYCLE_CAMERA_MODE))
+    {
+        m_flightModeEnabled = false;
+        m_behaviorChanged = true;
+
+        switch (m_camera.getBehavior())
+        {
+        case Camera::CAMERA_BEHAVIOR_FIRST_PERSON:
+        case Camera::CAMERA_BEHAVIOR_FLIGHT:
+            m_camera.setBehavior(Camera::CAMERA_BEHAVIOR_ORBIT);
+            break;
+
+        case Camera::CAMERA_BEHAVIOR_ORBIT:
+            m_camera.setBehavior(Camera::CAMERA_BEHAVIOR_FOLLOW);
+            break;
+
+        default:
+            setFirstPersonBehavior();
+            break;
+        }
+
+        m_rig.reset(m_camera);
+    }
+
+    GetCameraInput(m_actionMap, mouse.xPosRelative(), mouse.yPosRelative(), input);
+    m_controller.update(input, m_elapsedTimeSec, m_camera);
+
+    m_followSubjectTimeSec += m_elapsedTimeSec;
+    GetFollowSubject(m_followSubjectTimeSec, subjectPos, subjectHeading);
+
+    m_rig.setSubject(subjectPos, subjectHeading);
+    m_rig.update(m_elapsedTimeSec, m_camera);
+
+    return true;
+}
+
+void CameraReplay::setFirstPersonBehavior()
+{
+    // Back down to eye height above the floor.
+
+    const D3DXVECTOR3 &cameraPos = m_camera.getPosition();
+
+    m_camera.setBehavior(Camera::CAMERA_BEHAVIOR_FIRST_PERSON);
+    m_camera.setPosition(cameraPos.x, CAMERA_POS.y, cameraPos.z);
+}
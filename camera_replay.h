@@ -0,0 +1,125 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(CAMERA_REPLAY_H)
+#define CAMERA_REPLAY_H
+
+#include "action_map.h"
+#include "camera.h"
+#include "camera_controller.h"
+#include "camera_rig.h"
+#include "input_recorder.h"
+
+//-----------------------------------------------------------------------------
+// The state of a camera at the end of a session: where it is, which way it
+// faces, how fast it moves and turns. The application saves it with its
+// -savecamera option so that a headless replay of the session's input log can
+// be checked against it.
+//-----------------------------------------------------------------------------
+
+struct CameraState
+{
+    int behavior;
+    WorldPosition position;
+    D3DXQUATERNION orientation;
+    D3DXVECTOR3 velocity;
+    float rotationSpeed;
+};
+
+void GetCameraState(const Camera &camera, CameraState &state);
+bool LoadCameraState(const char *pszFilename, CameraState &state);
+bool SaveCameraState(const char *pszFilename, const CameraState &state);
+
+//-----------------------------------------------------------------------------
+// The CameraReplay class replays an input log recorded with the application's
+// -record option without a window or a device. Each update() feeds the next
+// frame's keys, buttons and mouse movement to the Keyboard and Mouse classes,
+// evaluates the application's action map, applies the actions that affect
+// the camera and the mouse the way ProcessUserInput() does, and moves the
+// camera and its rig the way UpdateCamera() does. The camera is set up the way the
+// application sets it up without -worldoffset, so replaying a session
+// recorded without it ends with the same camera state as the session.
+//
+// The mouse's filter history and settings live in the Mouse singleton. Only
+// one log should be replayed per process for the results to match the
+// application's.
+//-----------------------------------------------------------------------------
+
+class CameraReplay
+{
+public:
+    CameraReplay();
+    ~CameraReplay();
+
+    bool open(const char *pszFilename);
+    void close();
+
+    // Replays the next frame. Returns false once the log has been consumed.
+    bool update();
+
+    // Getter methods.
+
+    const Camera &getCamera() const;
+    const CameraController &getController() const;
+    float getElapsedTimeSec() const;
+    int getFrameCount() const;
+    const CameraRig &getRig() const;
+    bool isBehaviorChanged() const;
+
+private:
+    CameraReplay(const CameraReplay &);
+    CameraReplay &operator=(const CameraReplay &);
+
+    void setFirstPersonBehavior();
+
+    InputPlayback m_playback;
+    ActionMap m_actionMap;
+    Camera m_camera;
+    CameraController m_controller;
+    CameraRig m_rig;
+    float m_elapsedTimeSec;
+    float m_followSubjectTimeSec;
+    bool m_flightModeEnabled;
+    bool m_behaviorChanged;
+};
+
+//-----------------------------------------------------------------------------
+
+inline const Camera &CameraReplay::getCamera() const
+{ return m_camera; }
+
+inline const CameraController &CameraReplay::getController() const
+{ return m_controller; }
+
+inline float CameraReplay::getElapsedTimeSec() const
+{ return m_elapsedTimeSec; }
+
+inline int CameraReplay::getFrameCount() const
+{ return m_playback.frameCount(); }
+
+inline const CameraRig &CameraReplay::getRig() const
+{ return m_rig; }
+
+inline bool CameraReplay::isBehaviorChanged() const
+{ return m_behaviorChanged; }
+
+#endif
@@ -0,0 +1,202 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+//
+// A console front end for CameraReplay. Replays an input log recorded with
+// the application's -record option without any window or device, and
+// compares the camera's final state with the one the application saved with
+// -savecamera. Exits with 0 if they match and 1 if they don't. Like the
+// camera server it builds with Visual C++ on Windows and with CMake
+// everywhere else.
+//-----------------------------------------------------------------------------
+
+#if defined(_MSC_VER)
+#pragma comment(lib, "d3dx9.lib")
+#pragma comment(lib, "dinput8.lib")
+#pragma comment(lib, "dxguid.lib")
+#endif
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "camera_replay.h"
+#include "text_buffer.h"
+#include "timer.h"
+
+//-----------------------------------------------------------------------------
+// Constants.
+//-----------------------------------------------------------------------------
+
+// The replay runs the same code as the application, but not necessarily
+// built by the same compiler or against the same D3DX. Rounding differences
+// are allowed to add up to this much over a session.
+const double      POSITION_TOLERANCE = 0.001;
+const float       ANGLE_TOLERANCE_DEGREES = 0.1f;
+const float       VELOCITY_TOLERANCE = 0.001f;
+
+const char        USAGE_TEXT[] =
+    "Usage: camera_replay <file> [-expect <file>] [-save <file>]\n"
+    "  <file>            Input log recorded with the application's -record\n"
+    "                    option.\n"
+    "  -expect <file>    Camera state to compare the replay's final camera\n"
+    "                    state with, saved by the application's -savecamera\n"
+    "                    option or by -save.\n"
+    "  -save <file>      Saves the replay's final camera state.\n";
+
+//-----------------------------------------------------------------------------
+// Functions.
+//-----------------------------------------------------------------------------
+
+void AppendCameraState(const char *pszLabel, const CameraState &state, TextBuffer &text)
+{
+    text.append(pszLabel).newline();
+    text.append("  Behavior: ").append(state.behavior).newline();
+    text.append("  Position: ").append(static_cast<float>(state.position.x), 4)
+        .append(" ").append(static_cast<float>(state.position.y), 4)
+        .append(" ").append(static_cast<float>(state.position.z), 4).newline();
+    text.append("  Orientation: ").append(state.orientation.x, 4)
+        .append(" ").append(state.orientation.y, 4)
+        .append(" ").append(state.orientation.z, 4)
+        .append(" ").append(state.orientation.w, 4).newline();
+    text.append("  Velocity: ").append(state.velocity.x, 4)
+        .append(" ").append(state.velocity.y, 4)
+        .append(" ").append(state.velocity.z, 4).newline();
+    text.append("  Rotation speed: ").append(state.rotationSpeed, 2).newline();
+}
+
+int main(int argc, char *argv[])
+{
+    const char *pszLogFilename = 0;
+    const char *pszExpectFilename = 0;
+    const char *pszSaveFilename = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char *pszOption = argv[i];
+        const char *pszArg = (i + 1 < argc) ? argv[i + 1] : 0;
+        bool valid = true;
+
+        if (strcmp(pszOption, "-expect") == 0)
+        {
+            pszExpectFilename = pszArg;
+            valid = pszArg != 0;
+            ++i;
+        }
+        else if (strcmp(pszOption, "-save") == 0)
+        {
+            pszSaveFilename = pszArg;
+            valid = pszArg != 0;
+            ++i;
+        }
+        else if (pszOption[0] != '-' && !pszLogFilename)
+        {
+            pszLogFilename = pszOption;
+        }
+        else
+        {
+            valid = false;
+        }
+
+        if (!valid)
+        {
+            fprintf(stderr, "Invalid option: %s\n\n%s", pszOption, USAGE_TEXT);
+            return 1;
+        }
+    }
+
+    if (!pszLogFilename)
+    {
+        fputs(USAGE_TEXT, stderr);
+        return 1;
+    }
+
+    CameraReplay replay;
+    CameraState state;
+    CameraState expected;
+    TextBuffer text;
+    double seconds = 0.0;
+
+    if (!replay.open(pszLogFilename))
+    {
+        fprintf(stderr, "Failed to open the input log %s\n", pszLogFilename);
+        return 1;
+    }
+
+    if (pszExpectFilename && !LoadCameraState(pszExpectFilename, expected))
+    {
+        fprintf(stderr, "Failed to load the camera state %s\n", pszExpectFilename);
+        return 1;
+    }
+
+    double startTime = GetTimeInSeconds();
+
+    while (replay.update())
+        seconds += replay.getElapsedTimeSec();
+
+    double elapsedSec = GetTimeInSeconds() - startTime;
+    int frames = replay.getFrameCount();
+    bool passed = frames > 0;
+
+    GetCameraState(replay.getCamera(), state);
+
+    text.append("Input log: ").append(pszLogFilename).newline();
+    text.append("Frames: ").append(frames).newline();
+    text.append("Seconds: ").append(static_cast<float>(seconds), 1).newline();
+    text.append("Replay rate: ").append(static_cast<float>(frames / (elapsedSec > 0.0 ? elapsedSec : 1.0)), 0)
+        .append(" frames/sec").newline();
+
+    AppendCameraState("Final camera state", state, text);
+
+    if (pszExpectFilename)
+    {
+        double dx = state.position.x - expected.position.x;
+        double dy = state.position.y - expected.position.y;
+        double dz = state.position.z - expected.position.z;
+        double positionError = sqrt(dx * dx + dy * dy + dz * dz);
+        float cosHalfAngle = fabsf(D3DXQuaternionDot(&state.orientation, &expected.orientation));
+        float angleError = (cosHalfAngle < 1.0f) ? D3DXToDegree(2.0f * acosf(cosHalfAngle)) : 0.0f;
+        D3DXVECTOR3 velocityOffset = state.velocity - expected.velocity;
+        float velocityError = D3DXVec3Length(&velocityOffset);
+
+        AppendCameraState("Expected camera state", expected, text);
+
+        text.append("Position error: ").append(static_cast<float>(positionError * 1000.0), 3).append(" mm").newline();
+        text.append("Angle error: ").append(angleError, 4).append(" degrees").newline();
+        text.append("Velocity error: ").append(velocityError * 1000.0f, 3).append(" mm/sec").newline();
+
+        passed = passed && state.behavior == expected.behavior &&
+            positionError <= POSITION_TOLERANCE && angleError <= ANGLE_TOLERANCE_DEGREES &&
+            velocityError <= VELOCITY_TOLERANCE && state.rotationSpeed == expected.rotationSpeed;
+    }
+
+    if (pszSaveFilename && !SaveCameraState(pszSaveFilename, state))
+    {
+        text.append("Failed to save the camera state ").append(pszSaveFilename).newline();
+        passed = false;
+    }
+
+    text.append(passed ? "PASSED" : "FAILED").newline();
+
+    fputs(text.c_str(), stdout);
+    fflush(stdout);
+    return passed ? 0 : 1;
+}
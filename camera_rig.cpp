@@ -0,0 +1,249 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <cfloat>
+#include <cmath>
+#include "camera_rig.h"
+
+namespace
+{
+    const float DEFAULT_COLLISION_RADIUS = 0.2f;
+    const float DEFAULT_FOLLOW_HEIGHT = 1.5f;
+    const float DEFAULT_TARGET_SMOOTHING_TIME = 0.15f;
+    const float DEFAULT_DISTANCE_SMOOTHING_TIME = 0.25f;
+    const float DEFAULT_HEADING_SMOOTHING_TIME = 0.4f;
+
+    float CameraHeading(const CameraBase &camera)
+    {
+        // The heading about the world y axis in the same sense as
+        // Camera::rotate(). Orbit and follow cameras don't roll so their x
+        // axis always lies in the x-z plane. Unlike the z axis it doesn't
+        // degenerate when looking straight up or down.
+
+        const D3DXVECTOR3 &xAxis = camera.getXAxis();
+        return D3DXToDegree(atan2f(-xAxis.z, xAxis.x));
+    }
+
+    bool ClipSlab(float origin, float direction, float slabMin, float slabMax,
+                  float &tEnter, float &tExit)
+    {
+        // Narrows the ray's [tEnter, tExit] interval to the part between the
+        // two planes of one slab. Returns false once the interval is empty.
+
+        if (fabsf(direction) < FLT_EPSILON)
+            return origin >= slabMin && origin <= slabMax;
+
+        float invDirection = 1.0f / direction;
+        float t0 = (slabMin - origin) * invDirection;
+        float t1 = (slabMax - origin) * invDirection;
+
+        if (t0 > t1)
+        {
+            float temp = t0;
+            t0 = t1;
+            t1 = temp;
+        }
+
+        if (t0 > tEnter)
+            tEnter = t0;
+
+        if (t1 < tExit)
+            tExit = t1;
+
+        return tEnter <= tExit;
+    }
+
+    float WrapDegrees(float degrees)
+    {
+        // Wraps an angle into the range [-180,180).
+
+        return degrees - 360.0f * floorf((degrees + 180.0f) / 360.0f);
+    }
+}
+
+CameraRig::CameraRig()
+{
+    m_pBoxMins = 0;
+    m_pBoxMaxs = 0;
+    m_boxCount = 0;
+    m_collisionRadius = DEFAULT_COLLISION_RADIUS;
+    m_followHeight = DEFAULT_FOLLOW_HEIGHT;
+    m_targetSmoothingTime = DEFAULT_TARGET_SMOOTHING_TIME;
+    m_distanceSmoothingTime = DEFAULT_DISTANCE_SMOOTHING_TIME;
+    m_headingSmoothingTime = DEFAULT_HEADING_SMOOTHING_TIME;
+    m_subjectHeading = 0.0f;
+    m_distance = 0.0f;
+    m_distanceVelocity = 0.0f;
+    m_headingVelocity = 0.0f;
+    m_subjectPosition = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+    m_target = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+    m_targetVelocity = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+}
+
+CameraRig::~CameraRig()
+{
+}
+
+float CameraRig::findClearDistance(const D3DXVECTOR3 &origin, const D3DXVECTOR3 &direction,
+                                   float maxDistance) const
+{
+    // Returns how far along the normalized 'direction' a sphere of the
+    // collision radius can travel from 'origin' before it touches one of the
+    // obstacles, up to 'maxDistance'. Each box is grown by the radius and
+    // intersected with the ray using the slab test. This treats the box's
+    // edges and corners as sharp, which errs on the side of keeping the
+    // camera a little further away.
+
+    float clearDistance = maxDistance;
+
+    for (int i = 0; i < m_boxCount; ++i)
+    {
+        const D3DXVECTOR3 &boxMin = m_pBoxMins[i];
+        const D3DXVECTOR3 &boxMax = m_pBoxMaxs[i];
+        float tEnter = -FLT_MAX;
+        float tExit = FLT_MAX;
+
+        if (!ClipSlab(origin.x, direction.x, boxMin.x - m_collisionRadius,
+                boxMax.x + m_collisionRadius, tEnter, tExit))
+            continue;
+
+        if (!ClipSlab(origin.y, direction.y, boxMin.y - m_collisionRadius,
+                boxMax.y + m_collisionRadius, tEnter, tExit))
+            continue;
+
+        if (!ClipSlab(origin.z, direction.z, boxMin.z - m_collisionRadius,
+                boxMax.z + m_collisionRadius, tEnter, tExit))
+            continue;
+
+        // A negative entry distance means the origin is inside the box.
+        if (tEnter >= 0.0f && tEnter < clearDistance)
+            clearDistance = tEnter;
+    }
+
+    return clearDistance;
+}
+
+void CameraRig::reset(const CameraBase &camera)
+{
+    // Starts smoothing from the camera's current orbit with the camera at
+    // rest. Call this whenever the camera is placed directly.
+
+    m_target = camera.getOrbitTarget();
+    m_distance = camera.getOrbitDistance();
+    m_targetVelocity = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+    m_distanceVelocity = 0.0f;
+    m_headingVelocity = 0.0f;
+}
+
+template <typename CameraType>
+void CameraRig::updateCamera(float elapsedTimeSec, CameraType &camera)
+{
+    // Only orbit and follow cameras are rigged. For a BasicCamera the
+    // behavior tests are compile time constants.
+
+    if (camera.getBehavior() != CameraBase::CAMERA_BEHAVIOR_ORBIT
+        && camera.getBehavior() != CameraBase::CAMERA_BEHAVIOR_FOLLOW)
+        return;
+
+    if (camera.getBehavior() == CameraBase::CAMERA_BEHAVIOR_FOLLOW)
+    {
+        camera.setOrbitTarget(m_subjectPosition + D3DXVECTOR3(0.0f, m_followHeight, 0.0f));
+
+        // Spring the heading along the shortest way around. The camera's
+        // current heading is the spring's value so that turning the camera
+        // by hand is smoothed back out as well.
+
+        float heading = CameraHeading(camera);
+        float targetHeading = heading + WrapDegrees(m_subjectHeading - heading);
+        float newHeading = heading;
+
+        CriticallyDampedSpring(newHeading, m_headingVelocity, targetHeading,
+            m_headingSmoothingTime, elapsedTimeSec);
+
+        if (newHeading != heading)
+            camera.rotate(newHeading - heading, 0.0f, 0.0f);
+    }
+
+    CriticallyDampedSpring(m_target, m_targetVelocity, camera.getOrbitTarget(),
+        m_targetSmoothingTime, elapsedTimeSec);
+
+    CriticallyDampedSpring(m_distance, m_distanceVelocity, camera.getOrbitDistance(),
+        m_distanceSmoothingTime, elapsedTimeSec);
+
+    // Pull the camera in front of anything blocking the line of sight. The
+    // spring restarts from rest so the camera eases back out afterwards.
+
+    float clearDistance = findClearDistance(m_target, -camera.getZAxis(), m_distance);
+
+    if (clearDistance < m_distance)
+    {
+        m_distance = clearDistance;
+        m_distanceVelocity = 0.0f;
+    }
+
+    camera.orbit(m_target, m_distance);
+}
+
+void CameraRig::update(float elapsedTimeSec, Camera &camera)
+{
+    updateCamera(elapsedTimeSec, camera);
+}
+
+void CameraRig::update(float elapsedTimeSec, FollowCamera &camera)
+{
+    updateCamera(elapsedTimeSec, camera);
+}
+
+void CameraRig::update(float elapsedTimeSec, OrbitCamera &camera)
+{
+    updateCamera(elapsedTimeSec, camera);
+}
+
+void CameraRig::setCollisionRadius(float radius)
+{
+    m_collisionRadius = radius;
+}
+
+void CameraRig::setFollowHeight(float height)
+{
+    m_followHeight = height;
+}
+
+void CameraRig::setObstacles(const D3DXVECTOR3 *pBoxMins, const D3DXVECTOR3 *pBoxMaxs, int count)
+{
+    m_pBoxMins = pBoxMins;
+    m_pBoxMaxs = pBoxMaxs;
+    m_boxCount = count;
+}
+
+void CameraRig::setSmoothingTimes(float targetSec, float distanceSec, float headingSec)
+{
+    m_targetSmoothingTime = targetSec;
+    m_distanceSmoothingTime = distanceSec;
+    m_headingSmoothingTime = headingSec;
+}
+
+void CameraRig::setSubject(const D3DXVECTOR3 &position, float headingDegrees)
+{
+    m_subjectPosition = position;
+    m_subjectHeading = headingDegrees;
+}
@@ -0,0 +1,191 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(CAMERA_RIG_H)
+#define CAMERA_RIG_H
+
+#include <cmath>
+#include <d3dx9.h>
+#include "camera.h"
+
+//-----------------------------------------------------------------------------
+// Moves 'value' towards 'target' like a critically damped spring. The spring
+// is solved in closed form rather than integrated:
+//
+//  x(t) = target + (x0 - target + (v0 + w * (x0 - target)) * t) * e^(-w * t)
+//  v(t) = (v0 - w * (v0 + w * (x0 - target)) * t) * e^(-w * t)
+//
+// with w = 2 / smoothingTime. So the result is exact for any elapsed time
+// and the spring never overshoots or blows up, however long the frame took.
+// The smoothing time is roughly how long it takes to get most of the way to
+// the target. A smoothing time of 0 snaps straight to the target.
+//-----------------------------------------------------------------------------
+
+inline void CriticallyDampedSpring(float &value, float &velocity, float target,
+                                   float smoothingTime, float elapsedTimeSec)
+{
+    if (smoothingTime <= 0.0f)
+    {
+        value = target;
+        velocity = 0.0f;
+        return;
+    }
+
+    float omega = 2.0f / smoothingTime;
+    float decay = expf(-omega * elapsedTimeSec);
+    float offset = value - target;
+    float temp = (velocity + omega * offset) * elapsedTimeSec;
+
+    value = target + (offset + temp) * decay;
+    velocity = (velocity - omega * temp) * decay;
+}
+
+inline void CriticallyDampedSpring(D3DXVECTOR3 &value, D3DXVECTOR3 &velocity,
+                                   const D3DXVECTOR3 &target, float smoothingTime,
+                                   float elapsedTimeSec)
+{
+    if (smoothingTime <= 0.0f)
+    {
+        value = target;
+        velocity = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+        return;
+    }
+
+    float omega = 2.0f / smoothingTime;
+    float decay = expf(-omega * elapsedTimeSec);
+    D3DXVECTOR3 offset = value - target;
+    D3DXVECTOR3 temp = (velocity + offset * omega) * elapsedTimeSec;
+
+    value = target + (offset + temp) * decay;
+    velocity = (velocity - temp * omega) * decay;
+}
+
+//-----------------------------------------------------------------------------
+// The CameraRig class smooths the motion of orbit and follow cameras.
+//
+// The camera's orbit target and distance say where the camera should be.
+// update() springs the rig's own target and distance towards them and places
+// the camera there using CameraBase::orbit(), so pans, zooms, and jumps of
+// the target all ease in and out. In follow mode update() first makes the
+// subject's position (raised by the follow height) the orbit target, and
+// springs the camera's heading towards the subject's heading so that the
+// camera swings around behind the subject. The camera can still be turned
+// away from the subject, and then swings back.
+//
+// Obstacles are axis aligned boxes. The camera is kept out of them by
+// casting a ray from the target towards the camera, with the boxes grown by
+// the collision radius. When the line of sight is blocked the camera snaps
+// in front of the obstacle at once and eases back out once the line of
+// sight is clear again. Obstacles that contain the target are ignored since
+// there is nowhere to move the camera to. The obstacle arrays aren't copied
+// and must stay valid while the rig is in use.
+//
+// getTarget() and getDistance() return the smoothed orbit the camera was
+// last placed on. A rig holds the smoothing state of one camera. isRigged()
+// tells whether update() places a camera. A rigged camera's velocity doesn't
+// describe how its eye moves, so CameraPredictor can't extrapolate it.
+//-----------------------------------------------------------------------------
+
+class CameraRig
+{
+public:
+    CameraRig();
+    ~CameraRig();
+
+    static bool isRigged(const Camera &camera);
+
+    float findClearDistance(const D3DXVECTOR3 &origin, const D3DXVECTOR3 &direction,
+                            float maxDistance) const;
+    void reset(const CameraBase &camera);
+    void update(float elapsedTimeSec, Camera &camera);
+    void update(float elapsedTimeSec, FollowCamera &camera);
+    void update(float elapsedTimeSec, OrbitCamera &camera);
+
+    // Getter methods.
+
+    float getCollisionRadius() const;
+    float getDistance() const;
+    float getDistanceSmoothingTime() const;
+    float getFollowHeight() const;
+    float getHeadingSmoothingTime() const;
+    const D3DXVECTOR3 &getTarget() const;
+    float getTargetSmoothingTime() const;
+
+    // Setter methods.
+
+    void setCollisionRadius(float radius);
+    void setFollowHeight(float height);
+    void setObstacles(const D3DXVECTOR3 *pBoxMins, const D3DXVECTOR3 *pBoxMaxs, int count);
+    void setSmoothingTimes(float targetSec, float distanceSec, float headingSec);
+    void setSubject(const D3DXVECTOR3 &position, float headingDegrees);
+
+private:
+    template <typename CameraType>
+    void updateCamera(float elapsedTimeSec, CameraType &camera);
+
+    const D3DXVECTOR3 *m_pBoxMins;
+    const D3DXVECTOR3 *m_pBoxMaxs;
+    int m_boxCount;
+    float m_collisionRadius;
+    float m_followHeight;
+    float m_targetSmoothingTime;
+    float m_distanceSmoothingTime;
+    float m_headingSmoothingTime;
+    float m_subjectHeading;
+    float m_distance;
+    float m_distanceVelocity;
+    float m_headingVelocity;
+    D3DXVECTOR3 m_subjectPosition;
+    D3DXVECTOR3 m_target;
+    D3DXVECTOR3 m_targetVelocity;
+};
+
+//-----------------------------------------------------------------------------
+
+inline bool CameraRig::isRigged(const Camera &camera)
+{
+    return camera.getBehavior() == Camera::CAMERA_BEHAVIOR_ORBIT
+        || camera.getBehavior() == Camera::CAMERA_BEHAVIOR_FOLLOW;
+}
+
+inline float CameraRig::getCollisionRadius() const
+{ return m_collisionRadius; }
+
+inline float CameraRig::getDistance() const
+{ return m_distance; }
+
+inline float CameraRig::getDistanceSmoothingTime() const
+{ return m_distanceSmoothingTime; }
+
+inline float CameraRig::getFollowHeight() const
+{ return m_followHeight; }
+
+inline float CameraRig::getHeadingSmoothingTime() const
+{ return m_headingSmoothingTime; }
+
+inline const D3DXVECTOR3 &CameraRig::getTarget() const
+{ return m_target; }
+
+inline float CameraRig::getTargetSmoothingTime() const
+{ return m_targetSmoothingTime; }
+
+#endif
@@ -0,0 +1,333 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <cmath>
+#include "camera_server.h"
+#include "job_system.h"
+#include "timer.h"
+
+namespace
+{
+    // Batches per thread. More batches than threads lets the work stealing
+    // even out threads that fall behind.
+    const int BATCHES_PER_THREAD = 8;
+    const int MAX_BATCHES = 512;
+
+    // Synthetic input.
+    const float MIN_INPUT_CHANGE_SEC = 0.25f;
+    const float MAX_INPUT_CHANGE_SEC = 2.0f;
+    const float MOUSE_STEP = 4.0f;
+    const float MAX_MOUSE = 20.0f;
+
+    // Spreads out the cameras' starting points in a shared input sequence.
+    const int INPUT_OFFSET_STRIDE = 7919;
+
+    // Update latency histogram. Every power of two is split into this many
+    // equally sized buckets, so each bucket is within about 3% of its value.
+    const int LATENCY_SUB_BUCKETS = 32;
+    const int LATENCY_OCTAVES = 48;
+    const int LATENCY_BUCKET_COUNT = LATENCY_SUB_BUCKETS * LATENCY_OCTAVES;
+
+    unsigned int NextRandom(unsigned int &state)
+    {
+        // Marsaglia's xorshift generator. The state must never be 0.
+
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    float RandomFloat(unsigned int &state)
+    {
+        // Returns a random number in the range [0,1).
+        return static_cast<float>(NextRandom(state) >> 8) * (1.0f / 16777216.0f);
+    }
+
+    int LatencyBucket(long long ticks)
+    {
+        // frexp() splits the value into a mantissa in [0.5,1) and a power of
+        // two. Bucket 0 only ever holds 0 ticks, and negative readings from a
+        // thread that changed processors mid update.
+
+        if (ticks <= 0)
+            return 0;
+
+        int exponent = 0;
+        double mantissa = frexp(static_cast<double>(ticks), &exponent);
+        int bucket = exponent * LATENCY_SUB_BUCKETS
+            + static_cast<int>((mantissa - 0.5) * (2 * LATENCY_SUB_BUCKETS));
+
+        return (bucket < LATENCY_BUCKET_COUNT) ? bucket : LATENCY_BUCKET_COUNT - 1;
+    }
+
+    double LatencyBucketStart(int bucket)
+    {
+        if (bucket < LATENCY_SUB_BUCKETS)
+            return 0.0;
+
+        double mantissa = 0.5 + (bucket % LATENCY_SUB_BUCKETS) * (0.5 / LATENCY_SUB_BUCKETS);
+        return ldexp(mantissa, bucket / LATENCY_SUB_BUCKETS);
+    }
+
+    double LatencyPercentile(const std::vector<long long> &counts, long long total,
+                             long long maxTicks, double fraction)
+    {
+        // Returns the upper end of the bucket holding the percentile. That's
+        // clamped to the slowest update, which is known exactly.
+
+        long long index = static_cast<long long>(fraction * total);
+        long long seen = 0;
+        double ticks = static_cast<double>(maxTicks);
+
+        for (int i = 0; i < LATENCY_BUCKET_COUNT; ++i)
+        {
+            seen += counts[i];
+
+            if (seen > index)
+            {
+                if (LatencyBucketStart(i + 1) < ticks)
+                    ticks = LatencyBucketStart(i + 1);
+
+                break;
+            }
+        }
+
+        return ticks;
+    }
+}
+
+CameraServer::CameraServer() : m_tickTimeSec(0.0f)
+{
+}
+
+CameraServer::~CameraServer()
+{
+    destroy();
+}
+
+void CameraServer::create(int cameraCount, const Camera &prototype, const CameraController &controller)
+{
+    m_controller = controller;
+    m_viewers.resize(cameraCount);
+
+    for (int i = 0; i < cameraCount; ++i)
+    {
+        Viewer &viewer = m_viewers[i];
+
+        viewer.camera = prototype;
+        viewer.input.direction = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+        viewer.input.started = 0;
+        viewer.input.mouseX = 0.0f;
+        viewer.input.mouseY = 0.0f;
+        viewer.random = 2654435761U * static_cast<unsigned int>(i + 1);
+        viewer.timeToNextChange = 0.0f;
+        viewer.inputIndex = 0;
+
+        if (viewer.random == 0)
+            viewer.random = 1;
+    }
+
+    setInputSequence(m_inputs);
+}
+
+void CameraServer::destroy()
+{
+    m_viewers.clear();
+}
+
+void CameraServer::run(JobSystem &jobSystem, int tickCount, float tickTimeSec, CameraServerReport &report)
+{
+    int cameraCount = static_cast<int>(m_viewers.size());
+    int threadCount = jobSystem.workerCount() + 1;
+    int batchCount = threadCount * BATCHES_PER_THREAD;
+    std::vector<Batch> batches;
+
+    if (batchCount > MAX_BATCHES)
+        batchCount = MAX_BATCHES;
+
+    if (batchCount > cameraCount)
+        batchCount = cameraCount;
+
+    for (int i = 0; i < batchCount; ++i)
+    {
+        Batch batch;
+
+        batch.pServer = this;
+        batch.first = static_cast<int>(static_cast<long long>(cameraCount) * i / batchCount);
+        batch.count = static_cast<int>(static_cast<long long>(cameraCount) * (i + 1) / batchCount) - batch.first;
+        batch.maxTicks = 0;
+        batches.push_back(batch);
+        batches.back().latencyCounts.assign(LATENCY_BUCKET_COUNT, 0);
+    }
+
+    m_tickTimeSec = tickTimeSec;
+
+    double startTime = GetTimeInSeconds();
+
+    for (int tick = 0; tick < tickCount; ++tick)
+    {
+        JobCounter counter;
+
+        for (int i = 0; i < batchCount; ++i)
+            jobSystem.submit(updateBatchJob, &batches[i], &counter);
+
+        jobSystem.wait(&counter);
+    }
+
+    double elapsedSec = GetTimeInSeconds() - startTime;
+
+    std::vector<long long> latencyCounts(LATENCY_BUCKET_COUNT, 0);
+    long long maxTicks = 0;
+    long long updateCount = static_cast<long long>(cameraCount) * tickCount;
+    double usPerTick = GetTimerTickSeconds() * 1000000.0;
+
+    for (int i = 0; i < batchCount; ++i)
+    {
+        for (int j = 0; j < LATENCY_BUCKET_COUNT; ++j)
+            latencyCounts[j] += batches[i].latencyCounts[j];
+
+        if (batches[i].maxTicks > maxTicks)
+            maxTicks = batches[i].maxTicks;
+    }
+
+
+    report.cameraCount = cameraCount;
+    report.threadCount = threadCount;
+    report.tickCount = tickCount;
+    report.elapsedSec = elapsedSec;
+    report.updatesPerSec = (elapsedSec > 0.0) ? static_cast<double>(cameraCount) * tickCount / elapsedSec : 0.0;
+    report.medianUpdateUs = LatencyPercentile(latencyCounts, updateCount, maxTicks, 0.5) * usPerTick;
+    report.p99UpdateUs = LatencyPercentile(latencyCounts, updateCount, maxTicks, 0.99) * usPerTick;
+    report.p999UpdateUs = LatencyPercentile(latencyCounts, updateCount, maxTicks, 0.999) * usPerTick;
+    report.maxUpdateUs = static_cast<double>(maxTicks) * usPerTick;
+}
+
+void CameraServer::setInputSequence(const std::vector<CameraInput> &inputs)
+{
+    // An empty sequence switches back to synthetic input.
+
+    if (&inputs != &m_inputs)
+        m_inputs = inputs;
+
+    int inputCount = static_cast<int>(m_inputs.size());
+
+    for (size_t i = 0; i < m_viewers.size(); ++i)
+    {
+        if (inputCount > 0)
+            m_viewers[i].inputIndex = static_cast<int>((static_cast<long long>(i) * INPUT_OFFSET_STRIDE) % inputCount);
+        else
+            m_viewers[i].inputIndex = 0;
+    }
+}
+
+void CameraServer::updateBatchJob(void *pData)
+{
+    Batch *pBatch = static_cast<Batch *>(pData);
+    pBatch->pServer->updateBatch(*pBatch);
+}
+
+void CameraServer::nextSyntheticInput(Viewer &viewer)
+{
+    // Every so often pick a new movement direction with each axis being one
+    // of -1, 0, or 1. The mouse moves in a bounded random walk.
+
+    CameraInput &input = viewer.input;
+
+    input.started = 0;
+    viewer.timeToNextChange -= m_tickTimeSec;
+
+    if (viewer.timeToNextChange <= 0.0f)
+    {
+        float *pDirection = input.direction;
+
+        for (int i = 0; i < 3; ++i)
+        {
+            float direction = static_cast<float>(static_cast<int>(NextRandom(viewer.random) % 3) - 1);
+
+            if (direction != 0.0f && direction != pDirection[i])
+                input.started |= 1U << i;
+
+            pDirection[i] = direction;
+        }
+
+        viewer.timeToNextChange = MIN_INPUT_CHANGE_SEC
+            + (MAX_INPUT_CHANGE_SEC - MIN_INPUT_CHANGE_SEC) * RandomFloat(viewer.random);
+    }
+
+    input.mouseX += (RandomFloat(viewer.random) - 0.5f) * MOUSE_STEP;
+    input.mouseY += (RandomFloat(viewer.random) - 0.5f) * MOUSE_STEP;
+
+    if (input.mouseX > MAX_MOUSE)
+        input.mouseX = MAX_MOUSE;
+    else if (input.mouseX < -MAX_MOUSE)
+        input.mouseX = -MAX_MOUSE;
+
+    if (input.mouseY > MAX_MOUSE)
+        input.mouseY = MAX_MOUSE;
+    else if (input.mouseY < -MAX_MOUSE)
+        input.mouseY = -MAX_MOUSE;
+}
+
+void CameraServer::updateBatch(Batch &batch)
+{
+    // Each update is timed from the end of the previous one, so there's only
+    // one counter read per update. That means the time taken to record an
+    // update's latency is charged to the next update. Only this batch's job
+    // touches its histogram, so no synchronization is needed.
+
+    int inputCount = static_cast<int>(m_inputs.size());
+    long long *pLatencyCounts = &batch.latencyCounts[0];
+    long long maxTicks = batch.maxTicks;
+    long long startTicks = GetTimerTicks();
+
+    for (int i = batch.first; i < batch.first + batch.count; ++i)
+    {
+        Viewer &viewer = m_viewers[i];
+
+        if (inputCount > 0)
+        {
+            viewer.input = m_inputs[viewer.inputIndex];
+
+            if (++viewer.inputIndex == inputCount)
+                viewer.inputIndex = 0;
+        }
+        else
+        {
+            nextSyntheticInput(viewer);
+        }
+
+        m_controller.update(viewer.input, m_tickTimeSec, viewer.camera);
+
+        long long endTicks = GetTimerTicks();
+        long long ticks = endTicks - startTicks;
+
+        ++pLatencyCounts[LatencyBucket(ticks)];
+
+        if (ticks > maxTicks)
+            maxTicks = ticks;
+
+        startTicks = endTicks;
+    }
+
+    batch.maxTicks = maxTicks;
+}
@@ -0,0 +1,120 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(CAMERA_SERVER_H)
+#define CAMERA_SERVER_H
+
+#include <vector>
+#include "camera.h"
+#include "camera_controller.h"
+
+class JobSystem;
+
+//-----------------------------------------------------------------------------
+// The results of a CameraServer run. Update latency is the time taken by a
+// single camera update, including generating that camera's input. Updates per
+// second counts individual camera updates.
+//-----------------------------------------------------------------------------
+
+struct CameraServerReport
+{
+    int cameraCount;
+    int threadCount;
+    int tickCount;
+    double elapsedSec;
+    double updatesPerSec;
+    double medianUpdateUs;
+    double p99UpdateUs;
+    double p999UpdateUs;
+    double maxUpdateUs;
+};
+
+//-----------------------------------------------------------------------------
+// The CameraServer class simulates a large number of cameras without any
+// window or device. It's used to load test the camera code the way a server
+// validating client viewpoints would use it.
+//
+// Every camera starts out as a copy of the prototype camera and is updated by
+// the same CameraController. Each camera is driven by its own input stream.
+// If an input sequence has been supplied (e.g., converted from a recorded
+// input log) every camera plays it back in a loop starting at a different
+// offset. Otherwise each camera gets a synthetic stream from its own random
+// number generator that changes movement direction every so often and moves
+// the mouse in a random walk. Either way the runs are deterministic.
+//
+// run() updates all of the cameras once per tick with a fixed tick time. The
+// cameras are split into batches that run as jobs on the JobSystem, so every
+// processor takes part. Each batch times every camera update it makes into
+// its own latency histogram. The histograms are merged once the run is over.
+//-----------------------------------------------------------------------------
+
+class CameraServer
+{
+public:
+    CameraServer();
+    ~CameraServer();
+
+    void create(int cameraCount, const Camera &prototype, const CameraController &controller);
+    void destroy();
+    void run(JobSystem &jobSystem, int tickCount, float tickTimeSec, CameraServerReport &report);
+    void setInputSequence(const std::vector<CameraInput> &inputs);
+
+    int cameraCount() const
+    { return static_cast<int>(m_viewers.size()); }
+
+    const Camera &camera(int i) const
+    { return m_viewers[i].camera; }
+
+private:
+    struct Viewer
+    {
+        Camera camera;
+        CameraInput input;
+        unsigned int random;
+        float timeToNextChange;
+        int inputIndex;
+    };
+
+    struct Batch
+    {
+        CameraServer *pServer;
+        int first;
+        int count;
+        long long maxTicks;
+        std::vector<long long> latencyCounts;
+    };
+
+    CameraServer(const CameraServer &);
+    CameraServer &operator=(const CameraServer &);
+
+    static void updateBatchJob(void *pData);
+
+    void nextSyntheticInput(Viewer &viewer);
+    void updateBatch(Batch &batch);
+
+    CameraController m_controller;
+    float m_tickTimeSec;
+    std::vector<Viewer> m_viewers;
+    std::vector<CameraInput> m_inputs;
+};
+
+#endif
@@ -0,0 +1,197 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+//
+// A console front end for CameraServer. Simulates a number of cameras without
+// any window or device and writes a report to the standard output. This is
+// the portable part of the project: it builds with Visual C++ on Windows and
+// with CMake everywhere else (see CMakeLists.txt and the portable directory).
+//-----------------------------------------------------------------------------
+
+#if defined(_MSC_VER)
+#pragma comment(lib, "d3dx9.lib")
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "app_camera.h"
+#include "camera.h"
+#include "camera_controller.h"
+#include "camera_input.h"
+#include "camera_server.h"
+#include "input_recorder.h"
+#include "job_system.h"
+#include "text_buffer.h"
+
+//-----------------------------------------------------------------------------
+// Constants.
+//-----------------------------------------------------------------------------
+
+const int         DEFAULT_CAMERA_COUNT = 10000;
+const int         DEFAULT_TICK_COUNT = 600;
+const float       TICK_TIME = 1.0f / 60.0f;
+
+const char        USAGE_TEXT[] =
+    "Usage: camera_server [options]\n"
+    "  -cameras <n>      Number of cameras to simulate. Defaults to 10000.\n"
+    "  -ticks <n>        Number of ticks to run. Every camera is updated once\n"
+    "                    per tick. Defaults to 600.\n"
+    "  -jobthreads <n>   Number of job system worker threads. Defaults to one\n"
+    "                    per processor, minus one for the main thread.\n"
+    "  -pinthreads       Pins each worker thread to its own processor.\n"
+    "  -replay <file>    Drives the cameras with an input log recorded by the\n"
+    "                    application's -record option rather than with\n"
+    "                    synthetic input.\n";
+
+//-----------------------------------------------------------------------------
+// Functions.
+//-----------------------------------------------------------------------------
+
+bool ParseCount(const char *pszArg, int minValue, int &value)
+{
+    int count = 0;
+    char extra = 0;
+
+    if (!pszArg || sscanf(pszArg, "%d%c", &count, &extra) != 1 || count < minValue)
+        return false;
+
+    value = count;
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    int cameraCount = DEFAULT_CAMERA_COUNT;
+    int tickCount = DEFAULT_TICK_COUNT;
+    int jobThreadCount = -1;
+    bool pinJobThreads = false;
+    const char *pszReplayFilename = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char *pszOption = argv[i];
+        const char *pszArg = (i + 1 < argc) ? argv[i + 1] : 0;
+        bool valid = true;
+
+        if (strcmp(pszOption, "-cameras") == 0)
+        {
+            valid = ParseCount(pszArg, 1, cameraCount);
+            ++i;
+        }
+        else if (strcmp(pszOption, "-ticks") == 0)
+        {
+            valid = ParseCount(pszArg, 1, tickCount);
+            ++i;
+        }
+        else if (strcmp(pszOption, "-jobthreads") == 0)
+        {
+            valid = ParseCount(pszArg, 0, jobThreadCount);
+            ++i;
+        }
+        else if (strcmp(pszOption, "-pinthreads") == 0)
+        {
+            pinJobThreads = true;
+        }
+        else if (strcmp(pszOption, "-replay") == 0)
+        {
+            pszReplayFilename = pszArg;
+            valid = pszArg != 0;
+            ++i;
+        }
+        else
+        {
+            valid = false;
+        }
+
+        if (!valid)
+        {
+            fprintf(stderr, "Invalid option: %s\n\n%s", pszOption, USAGE_TEXT);
+            return 1;
+        }
+    }
+
+    CameraServer server;
+    CameraServerReport report;
+    CameraController controller;
+    Camera prototype;
+    JobSystem jobSystem;
+    TextBuffer text;
+
+    prototype.setBehavior(Camera::CAMERA_BEHAVIOR_FIRST_PERSON);
+    prototype.setPosition(CAMERA_POS);
+    prototype.setAcceleration(CAMERA_ACCELERATION);
+    prototype.setVelocity(CAMERA_VELOCITY);
+
+    // Keep the cameras above the floor.
+
+    controller.setBounds(D3DXVECTOR3(-FLOOR_WIDTH / 2.0f, CAMERA_POS.y, -FLOOR_HEIGHT / 2.0f),
+        D3DXVECTOR3(FLOOR_WIDTH / 2.0f, 4.0f, FLOOR_HEIGHT / 2.0f));
+    controller.setFlightYawSpeed(CAMERA_SPEED_FLIGHT_YAW);
+
+    if (pszReplayFilename)
+    {
+        InputPlayback playback;
+        std::vector<CameraInput> inputs;
+
+        if (!playback.open(pszReplayFilename))
+        {
+            fprintf(stderr, "Failed to open the input log %s\n", pszReplayFilename);
+            return 1;
+        }
+
+        ReadCameraInputs(playback, inputs);
+
+        if (inputs.empty())
+        {
+            fprintf(stderr, "The input log %s has no frames\n", pszReplayFilename);
+            return 1;
+        }
+
+        server.setInputSequence(inputs);
+    }
+
+    if (!jobSystem.create(jobThreadCount, pinJobThreads))
+    {
+        fprintf(stderr, "Failed to create the job system\n");
+        return 1;
+    }
+
+    server.create(cameraCount, prototype, controller);
+    server.run(jobSystem, tickCount, TICK_TIME, report);
+    jobSystem.destroy();
+
+    text.append("Cameras: ").append(report.cameraCount).newline();
+    text.append("Threads: ").append(report.threadCount).newline();
+    text.append("Ticks: ").append(report.tickCount).newline();
+    text.append("Input: ").append(pszReplayFilename ? pszReplayFilename : "synthetic").newline();
+    text.append("Elapsed: ").append(static_cast<float>(report.elapsedSec), 3).append(" s").newline();
+    text.append("Camera updates/sec: ").append(static_cast<float>(report.updatesPerSec), 0).newline();
+    text.append("Update latency median: ").append(static_cast<float>(report.medianUpdateUs), 3).append(" us").newline();
+    text.append("Update latency 99%: ").append(static_cast<float>(report.p99UpdateUs), 3).append(" us").newline();
+    text.append("Update latency 99.9%: ").append(static_cast<float>(report.p999UpdateUs), 3).append(" us").newline();
+    text.append("Update latency max: ").append(static_cast<float>(report.maxUpdateUs), 3).append(" us").newline();
+
+    fputs(text.c_str(), stdout);
+    fflush(stdout);
+    return 0;
+}
@@ -0,0 +1,426 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <cfloat>
+#include <cmath>
+#include <xmmintrin.h>
+#include "camera.h"
+#include "camera_set.h"
+
+namespace
+{
+    const float DEFAULT_EYE_SEPARATION = 0.065f;
+    const float DEFAULT_CONVERGENCE_DISTANCE = 2.0f;
+    const float DEFAULT_CUBE_MAP_ZNEAR = 0.1f;
+    const float DEFAULT_CUBE_MAP_ZFAR = 100.0f;
+
+    // Look and up directions of the cube map faces in the order of the
+    // D3DCUBEMAP_FACES enumeration.
+    const float CUBE_MAP_FACES[6][2][3] =
+    {
+        { {  1.0f,  0.0f,  0.0f }, { 0.0f, 1.0f,  0.0f } },     // +x
+        { { -1.0f,  0.0f,  0.0f }, { 0.0f, 1.0f,  0.0f } },     // -x
+        { {  0.0f,  1.0f,  0.0f }, { 0.0f, 0.0f, -1.0f } },     // +y
+        { {  0.0f, -1.0f,  0.0f }, { 0.0f, 0.0f,  1.0f } },     // -y
+        { {  0.0f,  0.0f,  1.0f }, { 0.0f, 1.0f,  0.0f } },     // +z
+        { {  0.0f,  0.0f, -1.0f }, { 0.0f, 1.0f,  0.0f } }      // -z
+    };
+
+    void BuildViewMatrix(const D3DXVECTOR3 &xAxis, const D3DXVECTOR3 &yAxis,
+                         const D3DXVECTOR3 &zAxis, const D3DXVECTOR3 &eye,
+                         D3DXMATRIX &viewMatrix)
+    {
+        // Same layout as the view matrix built by the Camera class.
+
+        viewMatrix(0,0) = xAxis.x;
+        viewMatrix(1,0) = xAxis.y;
+        viewMatrix(2,0) = xAxis.z;
+        viewMatrix(3,0) = -D3DXVec3Dot(&xAxis, &eye);
+
+        viewMatrix(0,1) = yAxis.x;
+        viewMatrix(1,1) = yAxis.y;
+        viewMatrix(2,1) = yAxis.z;
+        viewMatrix(3,1) = -D3DXVec3Dot(&yAxis, &eye);
+
+        viewMatrix(0,2) = zAxis.x;
+        viewMatrix(1,2) = zAxis.y;
+        viewMatrix(2,2) = zAxis.z;
+        viewMatrix(3,2) = -D3DXVec3Dot(&zAxis, &eye);
+
+        viewMatrix(0,3) = 0.0f;
+        viewMatrix(1,3) = 0.0f;
+        viewMatrix(2,3) = 0.0f;
+        viewMatrix(3,3) = 1.0f;
+    }
+
+    void MultiplyMatrices(const D3DXMATRIX &a, const D3DXMATRIX &b, D3DXMATRIX &result)
+    {
+        // Each row of the result is a linear combination of the rows of b.
+        // The matrices aren't necessarily 16 byte aligned.
+
+        __m128 b0 = _mm_loadu_ps(b.m[0]);
+        __m128 b1 = _mm_loadu_ps(b.m[1]);
+        __m128 b2 = _mm_loadu_ps(b.m[2]);
+        __m128 b3 = _mm_loadu_ps(b.m[3]);
+
+        for (int i = 0; i < 4; ++i)
+        {
+            __m128 row = _mm_mul_ps(_mm_set1_ps(a.m[i][0]), b0);
+
+            row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a.m[i][1]), b1));
+            row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a.m[i][2]), b2));
+            row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a.m[i][3]), b3));
+
+            _mm_storeu_ps(result.m[i], row);
+        }
+    }
+
+    void SetViewport(CameraView &view, float x, float y, float width, float height)
+    {
+        view.viewport[0] = x;
+        view.viewport[1] = y;
+        view.viewport[2] = width;
+        view.viewport[3] = height;
+    }
+}
+
+CameraSet::CameraSet()
+{
+    m_layout = LAYOUT_SINGLE;
+    m_viewCount = 1;
+    m_eyeSeparation = DEFAULT_EYE_SEPARATION;
+    m_convergenceDistance = DEFAULT_CONVERGENCE_DISTANCE;
+    m_cubeMapZNear = DEFAULT_CUBE_MAP_ZNEAR;
+    m_cubeMapZFar = DEFAULT_CUBE_MAP_ZFAR;
+    m_boundsMin = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+    m_boundsMax = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+
+    for (int i = 0; i < MAX_VIEWS; ++i)
+    {
+        D3DXMatrixIdentity(&m_views[i].viewMatrix);
+        D3DXMatrixIdentity(&m_views[i].projectionMatrix);
+        D3DXMatrixIdentity(&m_views[i].viewProjectionMatrix);
+        m_views[i].eye = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+        SetViewport(m_views[i], 0.0f, 0.0f, 1.0f, 1.0f);
+        extractPlanes(m_views[i].viewProjectionMatrix, m_planes[i]);
+    }
+}
+
+CameraSet::~CameraSet()
+{
+}
+
+void CameraSet::cull(const D3DXVECTOR3 *pCenters, const float *pRadii, int count,
+                     unsigned int *pViewMasks) const
+{
+    // Writes a bit mask for each sphere. Bit i is set if the sphere is at
+    // least partially inside view i's frustum.
+
+    for (int i = 0; i < count; ++i)
+    {
+        const D3DXVECTOR3 &center = pCenters[i];
+        float radius = pRadii[i];
+        unsigned int mask = 0;
+
+        pViewMasks[i] = 0;
+
+        if (center.x + radius < m_boundsMin.x || center.x - radius > m_boundsMax.x
+            || center.y + radius < m_boundsMin.y || center.y - radius > m_boundsMax.y
+            || center.z + radius < m_boundsMin.z || center.z - radius > m_boundsMax.z)
+        {
+            continue;
+        }
+
+        __m128 cx = _mm_set1_ps(center.x);
+        __m128 cy = _mm_set1_ps(center.y);
+        __m128 cz = _mm_set1_ps(center.z);
+        __m128 negRadius = _mm_set1_ps(-radius);
+
+        for (int v = 0; v < m_viewCount; ++v)
+        {
+            const FrustumPlanes &planes = m_planes[v];
+            int outside = 0;
+
+            for (int j = 0; j < PLANE_COUNT; j += 4)
+            {
+                __m128 dist = _mm_mul_ps(_mm_loadu_ps(&planes.n[0][j]), cx);
+
+                dist = _mm_add_ps(dist, _mm_mul_ps(_mm_loadu_ps(&planes.n[1][j]), cy));
+                dist = _mm_add_ps(dist, _mm_mul_ps(_mm_loadu_ps(&planes.n[2][j]), cz));
+                dist = _mm_add_ps(dist, _mm_loadu_ps(&planes.n[3][j]));
+
+                outside |= _mm_movemask_ps(_mm_cmplt_ps(dist, negRadius));
+            }
+
+            if (!outside)
+                mask |= 1U << v;
+        }
+
+        pViewMasks[i] = mask;
+    }
+}
+
+void CameraSet::update(const Camera &camera)
+{
+    const D3DXMATRIX &cameraProj = camera.getProjectionMatrix();
+    const D3DXVECTOR3 &eye = camera.getPosition();
+    const D3DXVECTOR3 &xAxis = camera.getXAxis();
+    const D3DXVECTOR3 &yAxis = camera.getYAxis();
+    const D3DXVECTOR3 &zAxis = camera.getZAxis();
+
+    switch (m_layout)
+    {
+    default:
+    case LAYOUT_SINGLE:
+        m_viewCount = 1;
+        m_views[0].eye = eye;
+        m_views[0].projectionMatrix = cameraProj;
+        BuildViewMatrix(xAxis, yAxis, zAxis, eye, m_views[0].viewMatrix);
+        SetViewport(m_views[0], 0.0f, 0.0f, 1.0f, 1.0f);
+        break;
+
+    case LAYOUT_STEREO:
+        // Parallel eyes with the projection shifted so that both frustums
+        // meet at the convergence distance. Each eye gets half of the render
+        // target (the half width side by side format used by stereo displays).
+
+        m_viewCount = 2;
+
+        for (int i = 0; i < 2; ++i)
+        {
+            CameraView &view = m_views[i];
+            float offset = (i == 0 ? -0.5f : 0.5f) * m_eyeSeparation;
+
+            view.eye = eye + xAxis * offset;
+            view.projectionMatrix = cameraProj;
+            view.projectionMatrix(2,0) += offset * cameraProj(0,0) / m_convergenceDistance;
+            BuildViewMatrix(xAxis, yAxis, zAxis, view.eye, view.viewMatrix);
+            SetViewport(view, 0.5f * i, 0.0f, 0.5f, 1.0f);
+        }
+        break;
+
+    case LAYOUT_SPLIT_SCREEN:
+        // The views turn clockwise in 90 degree steps about the camera's y
+        // axis. The viewports go clockwise around the screen starting at the
+        // top left. Each quarter has the same aspect ratio as the whole render
+        // target so the camera's projection can be used as is.
+
+        m_viewCount = 4;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            static const float VIEWPORTS[4][2] =
+            {
+                { 0.0f, 0.0f }, { 0.5f, 0.0f }, { 0.5f, 0.5f }, { 0.0f, 0.5f }
+            };
+
+            static const float SIN_YAW[4] = { 0.0f, 1.0f, 0.0f, -1.0f };
+            static const float COS_YAW[4] = { 1.0f, 0.0f, -1.0f, 0.0f };
+
+            CameraView &view = m_views[i];
+            D3DXVECTOR3 viewXAxis = xAxis * COS_YAW[i] - zAxis * SIN_YAW[i];
+            D3DXVECTOR3 viewZAxis = xAxis * SIN_YAW[i] + zAxis * COS_YAW[i];
+
+            view.eye = eye;
+            view.projectionMatrix = cameraProj;
+            BuildViewMatrix(viewXAxis, yAxis, viewZAxis, eye, view.viewMatrix);
+            SetViewport(view, VIEWPORTS[i][0], VIEWPORTS[i][1], 0.5f, 0.5f);
+        }
+        break;
+
+    case LAYOUT_CUBE_MAP:
+        {
+            // The faces are square. Lay them out in a 3x2 grid of square cells
+            // that fits the camera's aspect ratio. The camera's projection
+            // matrix stores yScale = xScale * aspect.
+
+            float aspect = cameraProj(1,1) / cameraProj(0,0);
+            float cellWidth = (0.5f / aspect < 1.0f / 3.0f) ? 0.5f / aspect : 1.0f / 3.0f;
+            float cellHeight = cellWidth * aspect;
+            float zScale = 0.0f;
+            float zOffset = 0.0f;
+
+            // The faces share the depth buffer and depth test with the other
+            // views so they have to use the camera's depth mode.
+            Camera::depthProjection(camera.getDepthMode(), m_cubeMapZNear,
+                m_cubeMapZFar, zScale, zOffset);
+
+            m_viewCount = 6;
+
+            for (int i = 0; i < 6; ++i)
+            {
+                CameraView &view = m_views[i];
+                D3DXVECTOR3 viewZAxis(CUBE_MAP_FACES[i][0]);
+                D3DXVECTOR3 viewYAxis(CUBE_MAP_FACES[i][1]);
+                D3DXVECTOR3 viewXAxis;
+
+                D3DXVec3Cross(&viewXAxis, &viewYAxis, &viewZAxis);
+
+                view.eye = eye;
+                BuildViewMatrix(viewXAxis, viewYAxis, viewZAxis, eye, view.viewMatrix);
+
+                // 90 degree field of view with an aspect ratio of 1.
+                D3DXMatrixIdentity(&view.projectionMatrix);
+                view.projectionMatrix(2,2) = zScale;
+                view.projectionMatrix(3,2) = zOffset;
+                view.projectionMatrix(2,3) = 1.0f;
+                view.projectionMatrix(3,3) = 0.0f;
+
+                SetViewport(view, cellWidth * (i % 3), cellHeight * (i / 3), cellWidth, cellHeight);
+            }
+        }
+        break;
+    }
+
+    for (int i = 0; i < m_viewCount; ++i)
+    {
+        CameraView &view = m_views[i];
+
+        MultiplyMatrices(view.viewMatrix, view.projectionMatrix, view.viewProjectionMatrix);
+        extractPlanes(view.viewProjectionMatrix, m_planes[i]);
+    }
+
+    updateBounds();
+}
+
+void CameraSet::setCubeMapClipPlanes(float znear, float zfar)
+{
+    m_cubeMapZNear = znear;
+    m_cubeMapZFar = zfar;
+}
+
+void CameraSet::setLayout(Layout layout)
+{
+    m_layout = layout;
+}
+
+void CameraSet::setStereoParams(float eyeSeparation, float convergenceDistance)
+{
+    m_eyeSeparation = eyeSeparation;
+    m_convergenceDistance = convergenceDistance;
+}
+
+void CameraSet::extractPlanes(const D3DXMATRIX &viewProj, FrustumPlanes &planes) const
+{
+    // Extracts the frustum planes from the combined view-projection matrix.
+    // The planes point into the frustum. A point p is inside a plane when
+    // dot(n, p) + d >= 0.
+    //
+    // The depth planes are 0 <= z and z <= w. With reverse-Z these are the far
+    // and near planes rather than the other way around. With an infinite far
+    // plane the far plane's normal is zero and the plane is cleared to all
+    // zeros, which every sphere passes.
+    //
+    // Based on "Fast Extraction of Viewing Frustum Planes from the World-
+    // View-Projection Matrix" by Gil Gribb and Klaus Hartmann.
+
+    float n[6][4];
+
+    for (int j = 0; j < 4; ++j)
+    {
+        n[0][j] = viewProj(j,3) + viewProj(j,0);    // left
+        n[1][j] = viewProj(j,3) - viewProj(j,0);    // right
+        n[2][j] = viewProj(j,3) + viewProj(j,1);    // bottom
+        n[3][j] = viewProj(j,3) - viewProj(j,1);    // top
+        n[4][j] = viewProj(j,2);                    // z >= 0
+        n[5][j] = viewProj(j,3) - viewProj(j,2);    // z <= w
+    }
+
+    for (int i = 0; i < 6; ++i)
+    {
+        float length = sqrtf(n[i][0] * n[i][0] + n[i][1] * n[i][1] + n[i][2] * n[i][2]);
+        float invLength = (length > 1e-6f * fabsf(n[i][3])) ? 1.0f / length : 0.0f;
+
+        for (int j = 0; j < 4; ++j)
+            planes.n[j][i] = n[i][j] * invLength;
+    }
+
+    // Padding planes that every sphere is inside of.
+
+    for (int i = 6; i < PLANE_COUNT; ++i)
+    {
+        planes.n[0][i] = 0.0f;
+        planes.n[1][i] = 0.0f;
+        planes.n[2][i] = 0.0f;
+        planes.n[3][i] = 1.0f;
+    }
+}
+
+void CameraSet::updateBounds()
+{
+    // The combined bounds are the bounding box of the corners of all of the
+    // view frustums. The corners are found by transforming the corners of the
+    // clip space cube back into world space. Far corners of an infinite far
+    // plane end up with w = 0, i.e. they are directions rather than points.
+    // The bounds are left open in the directions that they point in.
+
+    bool first = true;
+
+    for (int i = 0; i < m_viewCount; ++i)
+    {
+        D3DXMATRIX invViewProj;
+
+        if (!D3DXMatrixInverse(&invViewProj, 0, &m_views[i].viewProjectionMatrix))
+            continue;
+
+        for (int j = 0; j < 8; ++j)
+        {
+            D3DXVECTOR4 clip((j & 1) ? 1.0f : -1.0f, (j & 2) ? 1.0f : -1.0f, (j & 4) ? 1.0f : 0.0f, 1.0f);
+            D3DXVECTOR4 world;
+            D3DXVECTOR3 corner;
+
+            D3DXVec4Transform(&world, &clip, &invViewProj);
+
+            if (fabsf(world.w) > 1e-6f * (fabsf(world.x) + fabsf(world.y) + fabsf(world.z)))
+            {
+                corner = D3DXVECTOR3(world.x, world.y, world.z) / world.w;
+            }
+            else
+            {
+                // Push the corner out to infinity along its direction. The
+                // homogeneous vector's sign is arbitrary here, so orient the
+                // direction along the view's z axis.
+
+                const D3DXMATRIX &view = m_views[i].viewMatrix;
+                D3DXVECTOR3 dir(world.x, world.y, world.z);
+
+                if (dir.x * view(0,2) + dir.y * view(1,2) + dir.z * view(2,2) < 0.0f)
+                    dir = -dir;
+
+                corner.x = (dir.x > 0.0f) ? FLT_MAX : ((dir.x < 0.0f) ? -FLT_MAX : m_views[i].eye.x);
+                corner.y = (dir.y > 0.0f) ? FLT_MAX : ((dir.y < 0.0f) ? -FLT_MAX : m_views[i].eye.y);
+                corner.z = (dir.z > 0.0f) ? FLT_MAX : ((dir.z < 0.0f) ? -FLT_MAX : m_views[i].eye.z);
+            }
+
+            if (first)
+            {
+                m_boundsMin = m_boundsMax = corner;
+                first = false;
+            }
+            else
+            {
+                D3DXVec3Minimize(&m_boundsMin, &m_boundsMin, &corner);
+                D3DXVec3Maximize(&m_boundsMax, &m_boundsMax, &corner);
+            }
+        }
+    }
+}
@@ -0,0 +1,149 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(CAMERA_SET_H)
+#define CAMERA_SET_H
+
+#include <d3dx9.h>
+
+class Camera;
+
+//-----------------------------------------------------------------------------
+// A single view derived from a Camera by a CameraSet. The viewport is given
+// as fractions of the render target's width and height so that it doesn't
+// need to be recalculated when the render target is resized.
+//-----------------------------------------------------------------------------
+
+struct CameraView
+{
+    D3DXMATRIX viewMatrix;
+    D3DXMATRIX projectionMatrix;
+    D3DXMATRIX viewProjectionMatrix;
+    D3DXVECTOR3 eye;
+    float viewport[4];      // x, y, width, height
+};
+
+//-----------------------------------------------------------------------------
+// The CameraSet class derives several views from one Camera. The supported
+// layouts are:
+//
+//  LAYOUT_SINGLE       The camera's own view.
+//  LAYOUT_STEREO       A left and right eye pair rendered side by side. The
+//                      eyes are offset along the camera's x axis and use
+//                      asymmetric frustums that converge at the convergence
+//                      distance.
+//  LAYOUT_SPLIT_SCREEN Four views in the corners of the screen looking
+//                      forwards, right, backwards, and left.
+//  LAYOUT_CUBE_MAP     The six world aligned 90 degree cube map faces as seen
+//                      from the camera's eye. These follow the Direct3D cube
+//                      map face order and orientation so they can be rendered
+//                      directly into a cube texture. The viewports arrange the
+//                      faces in a 3x2 grid for display.
+//
+// update() recalculates all of the views' matrices in a single pass using SSE
+// for the matrix products. It also extracts each view's frustum planes and
+// the bounding box enclosing all of the frustums.
+//
+// cull() tests bounding spheres against the views. Each sphere is first
+// tested once against the combined bounding box. Only spheres that pass are
+// tested against the individual frustums, 4 planes at a time.
+//-----------------------------------------------------------------------------
+
+class CameraSet
+{
+public:
+    enum Layout
+    {
+        LAYOUT_SINGLE,
+        LAYOUT_STEREO,
+        LAYOUT_SPLIT_SCREEN,
+        LAYOUT_CUBE_MAP,
+        LAYOUT_COUNT
+    };
+
+    enum { MAX_VIEWS = 6 };
+
+    CameraSet();
+    ~CameraSet();
+
+    void cull(const D3DXVECTOR3 *pCenters, const float *pRadii, int count,
+              unsigned int *pViewMasks) const;
+    void update(const Camera &camera);
+
+    // Getter methods.
+
+    const D3DXVECTOR3 &getBoundsMax() const;
+    const D3DXVECTOR3 &getBoundsMin() const;
+    Layout getLayout() const;
+    const CameraView &getView(int i) const;
+    int getViewCount() const;
+
+    // Setter methods.
+
+    void setCubeMapClipPlanes(float znear, float zfar);
+    void setLayout(Layout layout);
+    void setStereoParams(float eyeSeparation, float convergenceDistance);
+
+private:
+    // Frustum planes in structure of arrays form: 8 nx, then 8 ny, 8 nz, and
+    // 8 d values. Only the first 6 planes are used. The last 2 are padding
+    // that every sphere passes.
+    enum { PLANE_COUNT = 8 };
+
+    struct FrustumPlanes
+    {
+        float n[4][PLANE_COUNT];
+    };
+
+    void extractPlanes(const D3DXMATRIX &viewProj, FrustumPlanes &planes) const;
+    void updateBounds();
+
+    Layout m_layout;
+    int m_viewCount;
+    float m_eyeSeparation;
+    float m_convergenceDistance;
+    float m_cubeMapZNear;
+    float m_cubeMapZFar;
+    D3DXVECTOR3 m_boundsMin;
+    D3DXVECTOR3 m_boundsMax;
+    CameraView m_views[MAX_VIEWS];
+    FrustumPlanes m_planes[MAX_VIEWS];
+};
+
+//-----------------------------------------------------------------------------
+
+inline const D3DXVECTOR3 &CameraSet::getBoundsMax() const
+{ return m_boundsMax; }
+
+inline const D3DXVECTOR3 &CameraSet::getBoundsMin() const
+{ return m_boundsMin; }
+
+inline CameraSet::Layout CameraSet::getLayout() const
+{ return m_layout; }
+
+inline const CameraView &CameraSet::getView(int i) const
+{ return m_views[i]; }
+
+inline int CameraSet::getViewCount() const
+{ return m_viewCount; }
+
+#endif
@@ -0,0 +1,685 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include "camera.h"
+#include "camera_track.h"
+
+namespace
+{
+    // Version 1 files quantized the positions relative to a single bounding
+    // box for the whole track. They're still loaded as a track with a single
+    // block.
+    const char FILE_MAGIC[4] = {'C', 'T', 'K', '2'};
+    const char FILE_MAGIC_V1[4] = {'C', 'T', 'K', '1'};
+
+    // Size of the file header (magic, block count, and key count), of a
+    // single block (bounding box and key count), and of a single keyframe in
+    // the file.
+    const int FILE_HEADER_SIZE = 4 + 4 + 4;
+    const int FILE_BLOCK_SIZE = 6 * 4 + 4;
+    const int FILE_KEY_SIZE = 4 + 3 * 2 + 4;
+
+    // Upper limit on the number of recorded samples that a single keyframe
+    // segment may replace. This bounds the cost of compress() on long tracks.
+    const int MAX_SAMPLES_PER_SEGMENT = 256;
+
+    const float POSITION_SCALE = 65535.0f;
+
+    // The three smallest components of a unit quaternion are always within
+    // [-1/sqrt(2), 1/sqrt(2)]. They're quantized to 10 bits each.
+    const float QUATERNION_COMPONENT_MAX = 0.70710678f;
+    const float QUATERNION_COMPONENT_SCALE = 1023.0f;
+
+    unsigned int QuantizeUnit(float value, float scale)
+    {
+        // Maps value in the range [0,1] to an integer in the range [0,scale].
+
+        if (value < 0.0f)
+            value = 0.0f;
+        else if (value > 1.0f)
+            value = 1.0f;
+
+        return static_cast<unsigned int>(value * scale + 0.5f);
+    }
+
+    unsigned int PackQuaternion(const D3DXQUATERNION &orientation)
+    {
+        D3DXQUATERNION q;
+        D3DXQuaternionNormalize(&q, &orientation);
+
+        const float components[4] = {q.x, q.y, q.z, q.w};
+        int largest = 0;
+
+        for (int i = 1; i < 4; ++i)
+        {
+            if (fabsf(components[i]) > fabsf(components[largest]))
+                largest = i;
+        }
+
+        // q and -q are the same rotation. Flip the sign so that the largest
+        // component is positive. It can then be reconstructed from the other
+        // three without storing its sign.
+
+        float sign = (components[largest] < 0.0f) ? -1.0f : 1.0f;
+        unsigned int bits = static_cast<unsigned int>(largest);
+        int shift = 2;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            if (i == largest)
+                continue;
+
+            float value = components[i] * sign;
+            float unit = (value + QUATERNION_COMPONENT_MAX) / (2.0f * QUATERNION_COMPONENT_MAX);
+
+            bits |= QuantizeUnit(unit, QUATERNION_COMPONENT_SCALE) << shift;
+            shift += 10;
+        }
+
+        return bits;
+    }
+
+    void UnpackQuaternion(unsigned int bits, D3DXQUATERNION &orientation)
+    {
+        float components[4];
+        int largest = static_cast<int>(bits & 3);
+        int shift = 2;
+        float sumSquares = 0.0f;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            if (i == largest)
+                continue;
+
+            float unit = static_cast<float>((bits >> shift) & 1023) / QUATERNION_COMPONENT_SCALE;
+
+            components[i] = unit * 2.0f * QUATERNION_COMPONENT_MAX - QUATERNION_COMPONENT_MAX;
+            sumSquares += components[i] * components[i];
+            shift += 10;
+        }
+
+        components[largest] = sqrtf(std::max(0.0f, 1.0f - sumSquares));
+
+        orientation = D3DXQUATERNION(components[0], components[1], components[2], components[3]);
+        D3DXQuaternionNormalize(&orientation, &orientation);
+    }
+
+    void MakeContinuous(const D3DXQUATERNION &prev, D3DXQUATERNION &q)
+    {
+        // Keeps consecutive orientations in the same hemisphere so that the
+        // interpolation takes the shortest path between them.
+
+        if (D3DXQuaternionDot(&prev, &q) < 0.0f)
+            q = -q;
+    }
+}
+
+const float CameraTrack::BLOCK_DURATION = 2.0f;
+
+CameraTrack::CameraTrack()
+{
+    m_cachedSegment = 0;
+}
+
+CameraTrack::~CameraTrack()
+{
+}
+
+void CameraTrack::clear()
+{
+    m_samples.clear();
+    m_packedKeys.clear();
+    m_blocks.clear();
+    decode();
+}
+
+void CameraTrack::record(float time, const Camera &camera)
+{
+    // Samples must be in increasing time order. Samples that don't advance
+    // the time (e.g., a paused frame) are simply dropped.
+
+    if (!m_samples.empty() && time <= m_samples.back().time)
+        return;
+
+    Sample sample;
+
+    sample.time = time;
+    sample.position = camera.getPosition();
+    sample.orientation = camera.getOrientation();
+
+    if (!m_samples.empty())
+        MakeContinuous(m_samples.back().orientation, sample.orientation);
+
+    m_samples.push_back(sample);
+}
+
+void CameraTrack::compress(float positionTolerance, float angleToleranceDegrees,
+                           float blockDuration)
+{
+    m_packedKeys.clear();
+    m_blocks.clear();
+
+    if (m_samples.empty())
+    {
+        decode();
+        return;
+    }
+
+    // A sample's block only depends on its time. That way every sample can
+    // be quantized before it's known which of them will become keyframes.
+    // A blockDuration of 0 puts the whole track into a single block.
+
+    int count = static_cast<int>(m_samples.size());
+    float startTime = m_samples[0].time;
+    std::vector<int> sampleBlocks(count);
+
+    for (int i = 0; i < count; ++i)
+    {
+        int block = 0;
+
+        if (blockDuration > 0.0f)
+            block = static_cast<int>((m_samples[i].time - startTime) / blockDuration);
+
+        sampleBlocks[i] = block;
+
+        if (block == static_cast<int>(m_blocks.size()) - 1)
+        {
+            D3DXVec3Minimize(&m_blocks.back().boundsMin, &m_blocks.back().boundsMin, &m_samples[i].position);
+            D3DXVec3Maximize(&m_blocks.back().boundsMax, &m_blocks.back().boundsMax, &m_samples[i].position);
+            continue;
+        }
+
+        // Blocks that no sample falls into (a gap in the recording) are
+        // left empty. They're removed again below.
+
+        Block empty = {m_samples[i].position, m_samples[i].position, 0};
+
+        m_blocks.resize(block + 1, empty);
+    }
+
+    // The keyframe reduction works on the samples as they will look after
+    // they've been quantized. The error bound is therefore relative to the
+    // quantized path, which is within half a quantization step of the
+    // recorded path.
+
+    std::vector<Sample> quantized(count);
+    PackedKey key;
+
+    for (int i = 0; i < count; ++i)
+    {
+        packKey(m_samples[i], m_blocks[sampleBlocks[i]], key);
+        unpackKey(key, m_blocks[sampleBlocks[i]], quantized[i]);
+
+        if (i > 0)
+            MakeContinuous(quantized[i - 1].orientation, quantized[i].orientation);
+    }
+
+    // The keyframes still in use form a doubly linked list over the samples.
+    // Each interior keyframe is removed in turn if every sample in the segments
+    // affected by its removal stays within the tolerances. A Catmull-Rom
+    // segment depends on the keyframe before and after it as well, so the
+    // affected samples span two keyframes either side of the removed one.
+
+    std::vector<int> prev(count);
+    std::vector<int> next(count);
+    float cosHalfAngleTolerance = cosf(D3DXToRadian(angleToleranceDegrees) * 0.5f);
+
+    for (int i = 0; i < count; ++i)
+    {
+        prev[i] = i - 1;
+        next[i] = (i + 1 < count) ? i + 1 : -1;
+    }
+
+    for (int i = (count > 2) ? 1 : -1; i != -1 && next[i] != -1; )
+    {
+        int before = prev[i];
+        int after = next[i];
+
+        if (after - before <= MAX_SAMPLES_PER_SEGMENT)
+        {
+            int first = (prev[before] != -1) ? prev[before] : before;
+            int last = (next[after] != -1) ? next[after] : after;
+
+            next[before] = after;
+            prev[after] = before;
+
+            if (!checkSegment(quantized, prev, next, first, last,
+                    positionTolerance, cosHalfAngleTolerance))
+            {
+                next[before] = i;
+                prev[after] = i;
+            }
+        }
+
+        i = after;
+    }
+
+    // Only the blocks that ended up with keyframes are kept.
+
+    std::vector<Block> blocks;
+
+    for (int i = 0; i != -1; i = next[i])
+    {
+        const Block &block = m_blocks[sampleBlocks[i]];
+
+        if (i == 0 || sampleBlocks[i] != sampleBlocks[prev[i]])
+        {
+            blocks.push_back(block);
+            blocks.back().firstKey = static_cast<int>(m_packedKeys.size());
+        }
+
+        packKey(m_samples[i], block, key);
+        m_packedKeys.push_back(key);
+    }
+
+    m_blocks.swap(blocks);
+    decode();
+}
+
+bool CameraTrack::load(const char *pszFilename)
+{
+    FILE *pFile = fopen(pszFilename, "rb");
+
+    if (!pFile)
+        return false;
+
+    char magic[4];
+    int blockCount = 1;
+    int count = 0;
+    float bounds[6];
+    bool ok = fread(magic, sizeof(magic), 1, pFile) == 1;
+    bool version1 = ok && memcmp(magic, FILE_MAGIC_V1, sizeof(magic)) == 0;
+
+    std::vector<Block> blocks;
+    std::vector<PackedKey> keys;
+
+    if (version1)
+    {
+        ok = fread(&count, sizeof(count), 1, pFile) == 1
+          && count >= 0
+          && fread(bounds, sizeof(bounds), 1, pFile) == 1;
+    }
+    else
+    {
+        ok = ok && memcmp(magic, FILE_MAGIC, sizeof(magic)) == 0
+          && fread(&blockCount, sizeof(blockCount), 1, pFile) == 1
+          && fread(&count, sizeof(count), 1, pFile) == 1
+          && blockCount >= 0 && count >= 0;
+    }
+
+    if (ok)
+        blocks.resize(blockCount);
+
+    // Every block has at least one keyframe, and all of the keyframes belong
+    // to a block.
+
+    for (int i = 0, firstKey = 0; ok && i < blockCount; ++i)
+    {
+        int blockKeyCount = count;
+
+        if (!version1)
+        {
+            ok = fread(bounds, sizeof(bounds), 1, pFile) == 1
+              && fread(&blockKeyCount, sizeof(blockKeyCount), 1, pFile) == 1
+              && blockKeyCount > 0 && blockKeyCount <= count - firstKey;
+        }
+
+        blocks[i].boundsMin = D3DXVECTOR3(bounds[0], bounds[1], bounds[2]);
+        blocks[i].boundsMax = D3DXVECTOR3(bounds[3], bounds[4], bounds[5]);
+        blocks[i].firstKey = firstKey;
+        firstKey += blockKeyCount;
+
+        if (ok && i == blockCount - 1 && firstKey != count)
+            ok = false;
+    }
+
+    if (ok && !version1 && blockCount == 0 && count != 0)
+        ok = false;
+
+    if (ok && version1 && count == 0)
+        blocks.clear();
+
+    if (ok)
+    {
+        keys.resize(count);
+
+        for (int i = 0; ok && i < count; ++i)
+        {
+            PackedKey &key = keys[i];
+
+            ok = fread(&key.time, sizeof(key.time), 1, pFile) == 1
+              && fread(key.position, sizeof(key.position), 1, pFile) == 1
+              && fread(&key.orientation, sizeof(key.orientation), 1, pFile) == 1;
+
+            // Keyframe times must be strictly increasing.
+            if (ok && i > 0 && key.time <= keys[i - 1].time)
+                ok = false;
+        }
+    }
+
+    fclose(pFile);
+
+    if (!ok)
+        return false;
+
+    m_samples.clear();
+    m_packedKeys.swap(keys);
+    m_blocks.swap(blocks);
+
+    decode();
+    return true;
+}
+
+bool CameraTrack::save(const char *pszFilename) const
+{
+    FILE *pFile = fopen(pszFilename, "wb");
+
+    if (!pFile)
+        return false;
+
+    int blockCount = static_cast<int>(m_blocks.size());
+    int count = static_cast<int>(m_packedKeys.size());
+
+    bool ok = fwrite(FILE_MAGIC, sizeof(FILE_MAGIC), 1, pFile) == 1
+           && fwrite(&blockCount, sizeof(blockCount), 1, pFile) == 1
+           && fwrite(&count, sizeof(count), 1, pFile) == 1;
+
+    for (int i = 0; ok && i < blockCount; ++i)
+    {
+        const Block &block = m_blocks[i];
+        int nextKey = (i + 1 < blockCount) ? m_blocks[i + 1].firstKey : count;
+        int blockKeyCount = nextKey - block.firstKey;
+        float bounds[6] =
+        {
+            block.boundsMin.x, block.boundsMin.y, block.boundsMin.z,
+            block.boundsMax.x, block.boundsMax.y, block.boundsMax.z
+        };
+
+        ok = fwrite(bounds, sizeof(bounds), 1, pFile) == 1
+          && fwrite(&blockKeyCount, sizeof(blockKeyCount), 1, pFile) == 1;
+    }
+
+    for (int i = 0; ok && i < count; ++i)
+    {
+        const PackedKey &key = m_packedKeys[i];
+
+        ok = fwrite(&key.time, sizeof(key.time), 1, pFile) == 1
+          && fwrite(key.position, sizeof(key.position), 1, pFile) == 1
+          && fwrite(&key.orientation, sizeof(key.orientation), 1, pFile) == 1;
+    }
+
+    if (fclose(pFile) != 0)
+        ok = false;
+
+    return ok;
+}
+
+void CameraTrack::apply(float time, Camera &camera) const
+{
+    D3DXVECTOR3 position;
+    D3DXQUATERNION orientation;
+
+    evaluate(time, position, orientation);
+
+    camera.setOrientation(orientation);
+    camera.setPosition(position);
+}
+
+void CameraTrack::evaluate(float time, D3DXVECTOR3 &position, D3DXQUATERNION &orientation) const
+{
+    int count = keyCount();
+
+    if (count == 0)
+    {
+        position = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+        D3DXQuaternionIdentity(&orientation);
+        return;
+    }
+
+    if (count == 1 || time <= m_keyTimes[0])
+    {
+        position = m_keyPositions[0];
+        orientation = m_keyOrientations[0];
+        return;
+    }
+
+    if (time >= m_keyTimes[count - 1])
+    {
+        position = m_keyPositions[count - 1];
+        orientation = m_keyOrientations[count - 1];
+        return;
+    }
+
+    int i = findSegment(time);
+    int i0 = (i > 0) ? i - 1 : 0;
+    int i3 = (i + 2 < count) ? i + 2 : count - 1;
+    float t = (time - m_keyTimes[i]) / (m_keyTimes[i + 1] - m_keyTimes[i]);
+    const Segment &segment = m_segments[i];
+
+    D3DXVec3CatmullRom(&position, &m_keyPositions[i0], &m_keyPositions[i],
+        &m_keyPositions[i + 1], &m_keyPositions[i3], t);
+
+    D3DXQuaternionSquad(&orientation, &m_keyOrientations[i],
+        &segment.a, &segment.b, &segment.c, t);
+}
+
+int CameraTrack::compressedSize() const
+{
+    return FILE_HEADER_SIZE + FILE_BLOCK_SIZE * static_cast<int>(m_blocks.size())
+        + FILE_KEY_SIZE * static_cast<int>(m_packedKeys.size());
+}
+
+void CameraTrack::measureError(float &maxPositionError, float &maxAngleErrorDegrees) const
+{
+    // Plays the compressed track back at the time of every recorded sample
+    // and returns the largest differences from the recorded position and
+    // orientation. Only works on a track that was recorded and compressed,
+    // not one that was loaded.
+
+    D3DXVECTOR3 position;
+    D3DXQUATERNION orientation;
+    float maxErrorSq = 0.0f;
+    float minDot = 1.0f;
+
+    for (int i = 0; i < sampleCount(); ++i)
+    {
+        const Sample &sample = m_samples[i];
+
+        evaluate(sample.time, position, orientation);
+
+        D3DXVECTOR3 error = position - sample.position;
+
+        maxErrorSq = std::max(maxErrorSq, D3DXVec3LengthSq(&error));
+        minDot = std::min(minDot, fabsf(D3DXQuaternionDot(&orientation, &sample.orientation)));
+    }
+
+    maxPositionError = sqrtf(maxErrorSq);
+    maxAngleErrorDegrees = D3DXToDegree(2.0f * acosf(std::min(minDot, 1.0f)));
+}
+
+void CameraTrack::interpolate(const Sample &k0, const Sample &k1,
+                              const Sample &k2, const Sample &k3, float t,
+                              D3DXVECTOR3 &position, D3DXQUATERNION &orientation)
+{
+    // Same interpolation as evaluate() but without any precomputed data. Used
+    // to measure the error of candidate keyframe sets during compression.
+
+    D3DXQUATERNION a;
+    D3DXQUATERNION b;
+    D3DXQUATERNION c;
+
+    D3DXVec3CatmullRom(&position, &k0.position, &k1.position, &k2.position, &k3.position, t);
+    D3DXQuaternionSquadSetup(&a, &b, &c, &k0.orientation, &k1.orientation, &k2.orientation, &k3.orientation);
+    D3DXQuaternionSquad(&orientation, &k1.orientation, &a, &b, &c, t);
+}
+
+bool CameraTrack::checkSegment(const std::vector<Sample> &samples,
+                               const std::vector<int> &prev, const std::vector<int> &next,
+                               int first, int last, float positionTolerance,
+                               float cosHalfAngleTolerance) const
+{
+    // Checks every sample between the keyframes first and last against the
+    // path interpolated from the keyframes currently in the linked list.
+
+    float positionToleranceSq = positionTolerance * positionTolerance;
+    D3DXVECTOR3 position;
+    D3DXQUATERNION orientation;
+
+    for (int k1 = first; k1 != last; k1 = next[k1])
+    {
+        int k2 = next[k1];
+        int k0 = (prev[k1] != -1) ? prev[k1] : k1;
+        int k3 = (next[k2] != -1) ? next[k2] : k2;
+        float span = samples[k2].time - samples[k1].time;
+
+        for (int i = k1 + 1; i < k2; ++i)
+        {
+            float t = (samples[i].time - samples[k1].time) / span;
+
+            interpolate(samples[k0], samples[k1], samples[k2], samples[k3], t, position, orientation);
+
+            D3DXVECTOR3 error = position - samples[i].position;
+
+            if (D3DXVec3LengthSq(&error) > positionToleranceSq)
+                return false;
+
+            // The angle between two rotations is 2 * acos(|q1 . q2|).
+            if (fabsf(D3DXQuaternionDot(&orientation, &samples[i].orientation)) < cosHalfAngleTolerance)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+void CameraTrack::decode()
+{
+    // Unpacks the keyframes into separate arrays for playback and precomputes
+    // the squad control points for each segment.
+
+    int count = static_cast<int>(m_packedKeys.size());
+    int block = 0;
+    Sample sample;
+
+    m_keyTimes.resize(count);
+    m_keyPositions.resize(count);
+    m_keyOrientations.resize(count);
+    m_segments.resize((count > 1) ? count - 1 : 0);
+    m_cachedSegment = 0;
+
+    for (int i = 0; i < count; ++i)
+    {
+        while (block + 1 < static_cast<int>(m_blocks.size()) && m_blocks[block + 1].firstKey <= i)
+            ++block;
+
+        unpackKey(m_packedKeys[i], m_blocks[block], sample);
+
+        if (i > 0)
+            MakeContinuous(m_keyOrientations[i - 1], sample.orientation);
+
+        m_keyTimes[i] = sample.time;
+        m_keyPositions[i] = sample.position;
+        m_keyOrientations[i] = sample.orientation;
+    }
+
+    for (int i = 0; i + 1 < count; ++i)
+    {
+        int i0 = (i > 0) ? i - 1 : 0;
+        int i3 = (i + 2 < count) ? i + 2 : count - 1;
+        Segment &segment = m_segments[i];
+
+        D3DXQuaternionSquadSetup(&segment.a, &segment.b, &segment.c,
+            &m_keyOrientations[i0], &m_keyOrientations[i],
+            &m_keyOrientations[i + 1], &m_keyOrientations[i3]);
+    }
+}
+
+int CameraTrack::findSegment(float time) const
+{
+    // Returns the index of the segment [m_keyTimes[i], m_keyTimes[i + 1])
+    // containing time. The caller has already handled times outside of the
+    // track, so there are always at least two keyframes here.
+
+    int lastSegment = keyCount() - 2;
+    int segment = m_cachedSegment;
+
+    if (segment <= lastSegment && time >= m_keyTimes[segment])
+    {
+        if (time < m_keyTimes[segment + 1])
+            return segment;
+
+        if (segment < lastSegment && time < m_keyTimes[segment + 2])
+            return m_cachedSegment = segment + 1;
+    }
+
+    segment = static_cast<int>(std::upper_bound(m_keyTimes.begin(),
+        m_keyTimes.end(), time) - m_keyTimes.begin()) - 1;
+
+    if (segment < 0)
+        segment = 0;
+    else if (segment > lastSegment)
+        segment = lastSegment;
+
+    return m_cachedSegment = segment;
+}
+
+void CameraTrack::packKey(const Sample &sample, const Block &block, PackedKey &key)
+{
+    const float *pMin = block.boundsMin;
+    const float *pMax = block.boundsMax;
+    const float *pPos = sample.position;
+
+    key.time = sample.time;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        float extent = pMax[i] - pMin[i];
+        float unit = (extent > 0.0f) ? (pPos[i] - pMin[i]) / extent : 0.0f;
+
+        key.position[i] = static_cast<unsigned short>(QuantizeUnit(unit, POSITION_SCALE));
+    }
+
+    key.orientation = PackQuaternion(sample.orientation);
+}
+
+void CameraTrack::unpackKey(const PackedKey &key, const Block &block, Sample &sample)
+{
+    const float *pMin = block.boundsMin;
+    const float *pMax = block.boundsMax;
+    float position[3];
+
+    sample.time = key.time;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        float extent = pMax[i] - pMin[i];
+
+        position[i] = pMin[i] + extent * (static_cast<float>(key.position[i]) / POSITION_SCALE);
+    }
+
+    sample.position = D3DXVECTOR3(position[0], position[1], position[2]);
+    UnpackQuaternion(key.orientation, sample.orientation);
+}
@@ -0,0 +1,154 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(CAMERA_TRACK_H)
+#define CAMERA_TRACK_H
+
+#include <vector>
+#include <d3dx9.h>
+
+class Camera;
+
+//-----------------------------------------------------------------------------
+// The CameraTrack class records the path a Camera takes and plays it back.
+// It's used to capture fly-throughs for automated performance testing.
+//
+// record() samples the camera's eye position and orientation, normally once
+// per frame. compress() then turns the recorded samples into keyframes:
+//
+//  - The track is split into blocks of blockDuration seconds. Positions are
+//    quantized to 16 bits per component relative to the bounding box of the
+//    block they're in, so the precision doesn't depend on the length of the
+//    track, only on how far the camera moves within a block.
+//  - Orientations are stored using the smallest three encoding: the index of
+//    the largest quaternion component in 2 bits, and the remaining three
+//    components in 10 bits each.
+//  - Keyframes are removed for as long as the interpolated path stays within
+//    the given position and angle tolerances of the quantized samples.
+//
+// Each keyframe takes up 14 bytes in the file: a float time stamp, 3 shorts
+// for the position, and 32 bits for the orientation. Each block that has any
+// keyframes adds 28 bytes for its bounding box and keyframe count. Playback
+// interpolates the positions using Catmull-Rom splines and the orientations
+// using squad.
+//
+// measureError() compares the compressed track against the recorded samples
+// it was compressed from.
+//
+// evaluate() finds the keyframe segment using a binary search, but first
+// checks the segment used by the previous call and the one after it. Playing
+// back the track with increasing times is therefore constant time per call.
+// Because of this cached segment a CameraTrack must not be evaluated by
+// several threads at once.
+//-----------------------------------------------------------------------------
+
+class CameraTrack
+{
+public:
+    static const float BLOCK_DURATION;
+
+    CameraTrack();
+    ~CameraTrack();
+
+    void clear();
+    void record(float time, const Camera &camera);
+    void compress(float positionTolerance, float angleToleranceDegrees,
+                  float blockDuration = BLOCK_DURATION);
+    void measureError(float &maxPositionError, float &maxAngleErrorDegrees) const;
+
+    bool load(const char *pszFilename);
+    bool save(const char *pszFilename) const;
+
+    void apply(float time, Camera &camera) const;
+    void evaluate(float time, D3DXVECTOR3 &position, D3DXQUATERNION &orientation) const;
+
+    // Size in bytes of the compressed track as stored in a file.
+    int compressedSize() const;
+
+    int blockCount() const
+    { return static_cast<int>(m_blocks.size()); }
+
+    float endTime() const
+    { return m_keyTimes.empty() ? 0.0f : m_keyTimes.back(); }
+
+    int keyCount() const
+    { return static_cast<int>(m_keyTimes.size()); }
+
+    int sampleCount() const
+    { return static_cast<int>(m_samples.size()); }
+
+private:
+    struct Sample
+    {
+        float time;
+        D3DXVECTOR3 position;
+        D3DXQUATERNION orientation;
+    };
+
+    struct PackedKey
+    {
+        float time;
+        unsigned short position[3];
+        unsigned int orientation;
+    };
+
+    // The keyframes quantized relative to the same bounding box. The block's
+    // keyframes are m_packedKeys[firstKey] up to the next block's firstKey.
+    struct Block
+    {
+        D3DXVECTOR3 boundsMin;
+        D3DXVECTOR3 boundsMax;
+        int firstKey;
+    };
+
+    // Squad control points for the orientations between two keyframes.
+    struct Segment
+    {
+        D3DXQUATERNION a;
+        D3DXQUATERNION b;
+        D3DXQUATERNION c;
+    };
+
+    static void interpolate(const Sample &k0, const Sample &k1,
+                            const Sample &k2, const Sample &k3, float t,
+                            D3DXVECTOR3 &position, D3DXQUATERNION &orientation);
+    static void packKey(const Sample &sample, const Block &block, PackedKey &key);
+    static void unpackKey(const PackedKey &key, const Block &block, Sample &sample);
+
+    bool checkSegment(const std::vector<Sample> &samples,
+                      const std::vector<int> &prev, const std::vector<int> &next,
+                      int first, int last, float positionTolerance,
+                      float cosHalfAngleTolerance) const;
+    void decode();
+    int findSegment(float time) const;
+
+    std::vector<Sample> m_samples;
+    std::vector<PackedKey> m_packedKeys;
+    std::vector<Block> m_blocks;
+    std::vector<float> m_keyTimes;
+    std::vector<D3DXVECTOR3> m_keyPositions;
+    std::vector<D3DXQUATERNION> m_keyOrientations;
+    std::vector<Segment> m_segments;
+    mutable int m_cachedSegment;
+};
+
+#endif
@@ -0,0 +1,347 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <cmath>
+#include <cfloat>
+#include "deferred_shading.h"
+#include "job_system.h"
+
+namespace
+{
+    // Formats for each G-buffer target, best first. The first choices are
+    // all 32 bits per pixel since many cards can only render to several
+    // targets at once if they all have the same bit depth.
+    const D3DFORMAT GBUFFER_FORMATS[GBUFFER_TARGET_COUNT][3] =
+    {
+        { D3DFMT_A8R8G8B8,    D3DFMT_X8R8G8B8,      D3DFMT_UNKNOWN },     // albedo
+        { D3DFMT_A2R10G10B10, D3DFMT_A8R8G8B8,      D3DFMT_UNKNOWN },     // normal
+        { D3DFMT_R32F,        D3DFMT_G16R16F,       D3DFMT_UNKNOWN }      // depth
+    };
+
+    const float MIN_W = 1e-3f;
+
+    inline float Saturate(float value)
+    {
+        return (value < 0.0f) ? 0.0f : ((value > 1.0f) ? 1.0f : value);
+    }
+
+    inline float SmoothStep(float edge0, float edge1, float x)
+    {
+        float t = Saturate((x - edge0) / (edge1 - edge0));
+        return t * t * (3.0f - 2.0f * t);
+    }
+}
+
+D3DFORMAT GBufferFormat(GBufferTarget target, int preference)
+{
+    // Returns D3DFMT_UNKNOWN once the preferences have run out.
+
+    if (target < 0 || target >= GBUFFER_TARGET_COUNT || preference < 0 || preference >= 3)
+        return D3DFMT_UNKNOWN;
+
+    return GBUFFER_FORMATS[target][preference];
+}
+
+int GBufferFormatSize(D3DFORMAT format)
+{
+    // Bytes per pixel of the formats used by the G-buffer.
+
+    switch (format)
+    {
+    case D3DFMT_A8R8G8B8:
+    case D3DFMT_X8R8G8B8:
+    case D3DFMT_A2R10G10B10:
+    case D3DFMT_R32F:
+    case D3DFMT_G16R16F:
+        return 4;
+
+    case D3DFMT_A16B16G16R16F:
+        return 8;
+
+    default:
+        return 0;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// LightList.
+//-----------------------------------------------------------------------------
+
+LightList::LightList()
+{
+}
+
+LightList::~LightList()
+{
+}
+
+void LightList::add(const DeferredLight &light)
+{
+    m_lights.push_back(light);
+}
+
+void LightList::clear()
+{
+    m_lights.clear();
+    m_visible.clear();
+}
+
+void LightList::cull(const D3DXMATRIX &viewProj, int viewportWidth, int viewportHeight)
+{
+    // The screen rectangle of a light is the projection of the box around
+    // its bounding sphere. Rectangles are in pixels relative to the
+    // viewport's top left corner, with right and bottom exclusive.
+
+    m_visible.clear();
+
+    for (int i = 0; i < static_cast<int>(m_lights.size()); ++i)
+    {
+        const DeferredLight &light = m_lights[i];
+        float minX = FLT_MAX;
+        float minY = FLT_MAX;
+        float maxX = -FLT_MAX;
+        float maxY = -FLT_MAX;
+        float minZ = FLT_MAX;
+        bool crossesNearPlane = false;
+
+        for (int corner = 0; corner < 8; ++corner)
+        {
+            D3DXVECTOR3 pos(light.pos.x + ((corner & 1) ? light.radius : -light.radius),
+                light.pos.y + ((corner & 2) ? light.radius : -light.radius),
+                light.pos.z + ((corner & 4) ? light.radius : -light.radius));
+            D3DXVECTOR4 clip;
+
+            D3DXVec3Transform(&clip, &pos, &viewProj);
+
+            if (clip.w < MIN_W)
+            {
+                crossesNearPlane = true;
+                break;
+            }
+
+            float x = clip.x / clip.w;
+            float y = clip.y / clip.w;
+
+            minX = (x < minX) ? x : minX;
+            maxX = (x > maxX) ? x : maxX;
+            minY = (y < minY) ? y : minY;
+            maxY = (y > maxY) ? y : maxY;
+            minZ = (clip.z / clip.w < minZ) ? clip.z / clip.w : minZ;
+        }
+
+        ScreenRect rect;
+
+        rect.light = i;
+
+        if (crossesNearPlane)
+        {
+            rect.left = 0;
+            rect.top = 0;
+            rect.right = viewportWidth;
+            rect.bottom = viewportHeight;
+        }
+        else
+        {
+            // Entirely outside the view. The depth test only works for
+            // standard depth; with reverse-Z the box is never rejected here.
+
+            if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f || minZ > 1.0f)
+                continue;
+
+            rect.left = static_cast<int>(floorf((minX * 0.5f + 0.5f) * viewportWidth));
+            rect.right = static_cast<int>(ceilf((maxX * 0.5f + 0.5f) * viewportWidth));
+            rect.top = static_cast<int>(floorf((0.5f - maxY * 0.5f) * viewportHeight));
+            rect.bottom = static_cast<int>(ceilf((0.5f - minY * 0.5f) * viewportHeight));
+
+            rect.left = (rect.left < 0) ? 0 : rect.left;
+            rect.top = (rect.top < 0) ? 0 : rect.top;
+            rect.right = (rect.right > viewportWidth) ? viewportWidth : rect.right;
+            rect.bottom = (rect.bottom > viewportHeight) ? viewportHeight : rect.bottom;
+
+            if (rect.left >= rect.right || rect.top >= rect.bottom)
+                continue;
+        }
+
+        m_visible.push_back(rect);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// SoftwareDeferredShader.
+//-----------------------------------------------------------------------------
+
+SoftwareDeferredShader::SoftwareDeferredShader()
+{
+    m_pLights = 0;
+    m_pAmbient = 0;
+    m_pOutput = 0;
+    m_width = 0;
+    m_height = 0;
+    m_lightEvaluationCount = 0;
+}
+
+SoftwareDeferredShader::~SoftwareDeferredShader()
+{
+    destroy();
+}
+
+bool SoftwareDeferredShader::create(int width, int height)
+{
+    if (width <= 0 || height <= 0)
+        return false;
+
+    GBufferTexel empty;
+
+    empty.albedo = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+    empty.normal = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+    empty.position = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+
+    m_width = width;
+    m_height = height;
+    m_gBuffer.assign(width * height, empty);
+    m_tileRows.resize((height + TILE_SIZE - 1) / TILE_SIZE);
+    return true;
+}
+
+void SoftwareDeferredShader::destroy()
+{
+    std::vector<GBufferTexel>().swap(m_gBuffer);
+    std::vector<TileRow>().swap(m_tileRows);
+    m_width = 0;
+    m_height = 0;
+}
+
+void SoftwareDeferredShader::shade(JobSystem *pJobSystem, const LightList &lights,
+                                   const D3DXVECTOR3 &ambient, D3DXVECTOR3 *pOutput)
+{
+    // Pass a null job system to shade on the calling thread.
+
+    m_pLights = &lights;
+    m_pAmbient = &ambient;
+    m_pOutput = pOutput;
+    m_lightEvaluationCount = 0;
+
+    int rowCount = static_cast<int>(m_tileRows.size());
+
+    for (int i = 0; i < rowCount; ++i)
+    {
+        m_tileRows[i].pShader = this;
+        m_tileRows[i].row = i;
+        m_tileRows[i].lightEvaluations = 0;
+    }
+
+    if (pJobSystem)
+    {
+        JobCounter counter;
+
+        for (int i = 0; i < rowCount; ++i)
+            pJobSystem->submit(shadeTileRowJob, &m_tileRows[i], &counter);
+
+        pJobSystem->wait(&counter);
+    }
+    else
+    {
+        for (int i = 0; i < rowCount; ++i)
+            shadeTileRow(m_tileRows[i]);
+    }
+
+    for (int i = 0; i < rowCount; ++i)
+        m_lightEvaluationCount += m_tileRows[i].lightEvaluations;
+}
+
+void SoftwareDeferredShader::shadeTileRowJob(void *pData)
+{
+    TileRow *pTileRow = static_cast<TileRow *>(pData);
+
+    pTileRow->pShader->shadeTileRow(*pTileRow);
+}
+
+void SoftwareDeferredShader::shadeTileRow(TileRow &tileRow)
+{
+    // Each tile row has its own light list and counter, so rows run in
+    // parallel without sharing anything they write to.
+
+    const LightList &lights = *m_pLights;
+    int top = tileRow.row * TILE_SIZE;
+    int bottom = (top + TILE_SIZE < m_height) ? top + TILE_SIZE : m_height;
+
+    for (int left = 0; left < m_width; left += TILE_SIZE)
+    {
+        int right = (left + TILE_SIZE < m_width) ? left + TILE_SIZE : m_width;
+
+        tileRow.tileLights.clear();
+
+        for (int i = 0; i < lights.getVisibleCount(); ++i)
+        {
+            const LightList::ScreenRect &rect = lights.getVisibleRect(i);
+
+            if (rect.left < right && rect.right > left && rect.top < bottom && rect.bottom > top)
+                tileRow.tileLights.push_back(rect.light);
+        }
+
+        int tileLightCount = static_cast<int>(tileRow.tileLights.size());
+
+        for (int y = top; y < bottom; ++y)
+        {
+            for (int x = left; x < right; ++x)
+            {
+                const GBufferTexel &texel = m_gBuffer[y * m_width + x];
+                D3DXVECTOR3 &output = m_pOutput[y * m_width + x];
+
+                output.x = texel.albedo.x * m_pAmbient->x;
+                output.y = texel.albedo.y * m_pAmbient->y;
+                output.z = texel.albedo.z * m_pAmbient->z;
+
+                if (texel.normal.x == 0.0f && texel.normal.y == 0.0f && texel.normal.z == 0.0f)
+                    continue;
+
+                tileRow.lightEvaluations += tileLightCount;
+
+                for (int i = 0; i < tileLightCount; ++i)
+                {
+                    const DeferredLight &light = lights.getLight(tileRow.tileLights[i]);
+                    D3DXVECTOR3 l = light.pos - texel.position;
+                    float distanceSq = D3DXVec3Dot(&l, &l);
+                    float atten = 1.0f - distanceSq / (light.radius * light.radius);
+
+                    if (atten <= 0.0f)
+                        continue;
+
+                    l *= 1.0f / sqrtf(distanceSq);
+
+                    float nDotL = D3DXVec3Dot(&texel.normal, &l);
+
+                    if (nDotL <= 0.0f)
+                        continue;
+
+                    float spotDot = -D3DXVec3Dot(&l, &light.dir);
+                    float spot = SmoothStep(light.spotCosOuterCone, light.spotCosInnerCone, spotDot);
+                    float intensity = nDotL * atten * spot;
+
+                    output.x += texel.albedo.x * light.color.x * intensity;
+                    output.y += texel.albedo.y * light.color.y * intensity;
+                    output.z += texel.albedo.z * light.color.z * intensity;
+                }
+            }
+        }
+    }
+}
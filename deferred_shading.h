@@ -0,0 +1,199 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(DEFERRED_SHADING_H)
+#define DEFERRED_SHADING_H
+
+#include <vector>
+#include <d3dx9.h>
+
+class JobSystem;
+
+//-----------------------------------------------------------------------------
+// Deferred shading.
+//
+// The scene is rendered once into a G-buffer: the surface's albedo, its world
+// space normal (the normal map's tangent space normal already transformed by
+// the tangent frame), and its depth. The lights are then applied one at a
+// time by drawing each light's screen rectangle with additive blending and
+// reading the surface back from the G-buffer. Each light only shades the
+// pixels it can reach, so the cost no longer grows with the number of lights
+// times the number of pixels drawn.
+//
+// The G-buffer targets and the formats tried for them, best first, are
+// listed by GBufferFormat(). The albedo target doubles as the G-buffer's
+// first render target, so it must be supported for the others to be used.
+//
+// DeferredLight is laid out as three float4s so that a light can be uploaded
+// to the effect as a float4 array. Point lights use cone cosines of -2
+// (outer) and -1 (inner), which make the spot falloff 1 in every direction.
+//-----------------------------------------------------------------------------
+
+enum GBufferTarget
+{
+    GBUFFER_ALBEDO,
+    GBUFFER_NORMAL,
+    GBUFFER_DEPTH,
+    GBUFFER_TARGET_COUNT
+};
+
+struct DeferredLight
+{
+    D3DXVECTOR3 pos;
+    float radius;
+    D3DXVECTOR3 dir;
+    float spotCosOuterCone;
+    D3DXVECTOR3 color;
+    float spotCosInnerCone;
+};
+
+D3DFORMAT GBufferFormat(GBufferTarget target, int preference);
+int GBufferFormatSize(D3DFORMAT format);
+
+//-----------------------------------------------------------------------------
+// The LightList class holds the lights of a frame. cull() finds the lights
+// that can affect a view and the screen rectangle each one covers, from the
+// light's bounding sphere. Lights whose sphere crosses the near plane cover
+// the whole viewport.
+//-----------------------------------------------------------------------------
+
+class LightList
+{
+public:
+    struct ScreenRect
+    {
+        int light;
+        int left;
+        int top;
+        int right;
+        int bottom;
+    };
+
+    LightList();
+    ~LightList();
+
+    void add(const DeferredLight &light);
+    void clear();
+    void cull(const D3DXMATRIX &viewProj, int viewportWidth, int viewportHeight);
+
+    // Getter methods.
+
+    int getCount() const;
+    const DeferredLight &getLight(int i) const;
+    int getVisibleCount() const;
+    const ScreenRect &getVisibleRect(int i) const;
+
+private:
+    std::vector<DeferredLight> m_lights;
+    std::vector<ScreenRect> m_visible;
+};
+
+//-----------------------------------------------------------------------------
+// The SoftwareDeferredShader class is a CPU reference of the lighting pass.
+// The G-buffer is filled in by the caller. shade() splits the screen into
+// 16x16 pixel tiles, finds the lights whose screen rectangles overlap each
+// tile, and shades the tile's pixels with only those lights, using the same
+// lighting as the DeferredLighting technique. Rows of tiles are shaded as
+// jobs on a JobSystem. The light list must have been culled for the same
+// size as the G-buffer.
+//-----------------------------------------------------------------------------
+
+class SoftwareDeferredShader
+{
+public:
+    enum { TILE_SIZE = 16 };
+
+    struct GBufferTexel
+    {
+        D3DXVECTOR3 albedo;
+        D3DXVECTOR3 normal;     // zero where nothing was drawn
+        D3DXVECTOR3 position;
+    };
+
+    SoftwareDeferredShader();
+    ~SoftwareDeferredShader();
+
+    bool create(int width, int height);
+    void destroy();
+    void shade(JobSystem *pJobSystem, const LightList &lights,
+               const D3DXVECTOR3 &ambient, D3DXVECTOR3 *pOutput);
+
+    // Getter methods.
+
+    GBufferTexel *getGBuffer();
+    int getHeight() const;
+    long long getLightEvaluationCount() const;
+    int getWidth() const;
+
+private:
+    struct TileRow
+    {
+        SoftwareDeferredShader *pShader;
+        int row;
+        long long lightEvaluations;
+        std::vector<int> tileLights;
+    };
+
+    SoftwareDeferredShader(const SoftwareDeferredShader &);
+    SoftwareDeferredShader &operator=(const SoftwareDeferredShader &);
+
+    static void shadeTileRowJob(void *pData);
+
+    void shadeTileRow(TileRow &tileRow);
+
+    std::vector<GBufferTexel> m_gBuffer;
+    std::vector<TileRow> m_tileRows;
+    const LightList *m_pLights;
+    const D3DXVECTOR3 *m_pAmbient;
+    D3DXVECTOR3 *m_pOutput;
+    int m_width;
+    int m_height;
+    long long m_lightEvaluationCount;
+};
+
+//-----------------------------------------------------------------------------
+
+inline int LightList::getCount() const
+{ return static_cast<int>(m_lights.size()); }
+
+inline const DeferredLight &LightList::getLight(int i) const
+{ return m_lights[i]; }
+
+inline int LightList::getVisibleCount() const
+{ return static_cast<int>(m_visible.size()); }
+
+inline const LightList::ScreenRect &LightList::getVisibleRect(int i) const
+{ return m_visible[i]; }
+
+inline SoftwareDeferredShader::GBufferTexel *SoftwareDeferredShader::getGBuffer()
+{ return m_gBuffer.empty() ? 0 : &m_gBuffer[0]; }
+
+inline int SoftwareDeferredShader::getHeight() const
+{ return m_height; }
+
+inline long long SoftwareDeferredShader::getLightEvaluationCount() const
+{ return m_lightEvaluationCount; }
+
+inline int SoftwareDeferredShader::getWidth() const
+{ return m_width; }
+
+#endif
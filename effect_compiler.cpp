@@ -0,0 +1,131 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <cstdio>
+#include "effect_compiler.h"
+#include "shader_cache.h"
+
+#define SAFE_RELEASE(x) if ((x) != 0) { (x)->Release(); (x) = 0; }
+
+bool CompileEffect(const char *pszFilename, const ShaderCache &cache,
+                   std::vector<char> &compiled, std::string &errors, bool &cacheHit)
+{
+    // Compiles an effect file without creating the effect. This doesn't need
+    // the device so it's safe to call from any thread. The compiled effect is
+    // looked up in the shader cache first, and stored in it after compiling.
+    // Compilation errors are returned in 'errors'.
+
+    std::vector<char> source;
+
+    errors.clear();
+    cacheHit = false;
+
+    if (!ReadAssetFile(pszFilename, source))
+    {
+        errors = std::string("Failed to read: ") + pszFilename + ".";
+        return false;
+    }
+
+    unsigned long long key = EffectCacheKey(source);
+
+    if (cache.load(key, compiled))
+    {
+        cacheHit = true;
+        return true;
+    }
+
+    ID3DXEffectCompiler *pCompiler = 0;
+    ID3DXBuffer *pCompiledEffect = 0;
+    ID3DXBuffer *pCompilationErrors = 0;
+
+    HRESULT hr = D3DXCreateEffectCompiler(&source[0], static_cast<UINT>(source.size()),
+                    0, 0, SHADER_COMPILE_FLAGS, &pCompiler, &pCompilationErrors);
+
+    if (SUCCEEDED(hr))
+    {
+        SAFE_RELEASE(pCompilationErrors);
+        hr = pCompiler->CompileEffect(SHADER_COMPILE_FLAGS, &pCompiledEffect, &pCompilationErrors);
+        pCompiler->Release();
+    }
+
+    if (pCompilationErrors)
+    {
+        errors = static_cast<const char *>(pCompilationErrors->GetBufferPointer());
+        pCompilationErrors->Release();
+    }
+
+    if (FAILED(hr) || !pCompiledEffect)
+    {
+        SAFE_RELEASE(pCompiledEffect);
+        compiled.clear();
+        return false;
+    }
+
+    const char *pBytes = static_cast<const char *>(pCompiledEffect->GetBufferPointer());
+
+    compiled.assign(pBytes, pBytes + pCompiledEffect->GetBufferSize());
+    pCompiledEffect->Release();
+
+    cache.store(key, &compiled[0], static_cast<unsigned int>(compiled.size()));
+    return true;
+}
+
+unsigned long long EffectCacheKey(const std::vector<char> &source)
+{
+    // Everything that changes the compiled effect goes into its shader cache
+    // key. normal_mapping.fx doesn't #include any other files, so its own
+    // source text is all of the source there is.
+
+    DWORD flags = SHADER_COMPILE_FLAGS;
+    DWORD version = D3DX_SDK_VERSION;
+    unsigned long long key = ShaderCache::hash(&source[0], static_cast<unsigned int>(source.size()));
+
+    key = ShaderCache::hash(&flags, sizeof(flags), key);
+    key = ShaderCache::hash(&version, sizeof(version), key);
+    return key;
+}
+
+bool ReadAssetFile(const char *pszFilename, std::vector<char> &data)
+{
+    // Reads a whole file into memory. Fails for empty files.
+
+    FILE *pFile = fopen(pszFilename, "rb");
+
+    if (!pFile)
+        return false;
+
+    long size = 0;
+    bool read = false;
+
+    if (fseek(pFile, 0, SEEK_END) == 0 && (size = ftell(pFile)) > 0 && fseek(pFile, 0, SEEK_SET) == 0)
+    {
+        data.resize(size);
+        read = fread(&data[0], size, 1, pFile) == 1;
+    }
+
+    fclose(pFile);
+
+    if (!read)
+        data.clear();
+
+    return read;
+}
@@ -0,0 +1,45 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(EFFECT_COMPILER_H)
+#define EFFECT_COMPILER_H
+
+#include <string>
+#include <vector>
+#include <d3dx9.h>
+
+class ShaderCache;
+
+//-----------------------------------------------------------------------------
+// Compiles the application's effect files with the D3DX effect compiler,
+// going through the shader cache. None of these need a device, so they can be
+// called from any thread and by the headless benchmarks.
+//-----------------------------------------------------------------------------
+
+const DWORD SHADER_COMPILE_FLAGS = D3DXSHADER_NO_PRESHADER;
+
+bool CompileEffect(const char *pszFilename, const ShaderCache &cache,
+                   std::vector<char> &compiled, std::string &errors, bool &cacheHit);
+unsigned long long EffectCacheKey(const std::vector<char> &source);
+bool ReadAssetFile(const char *pszFilename, std::vector<char> &data);
+
+#endif
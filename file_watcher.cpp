@@ -0,0 +1,211 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include "file_watcher.h"
+
+FileWatcher::FileWatcher()
+{
+    m_lastPollTime = 0;
+    m_polledDirectoryCount = 0;
+    m_created = false;
+}
+
+FileWatcher::~FileWatcher()
+{
+    destroy();
+}
+
+int FileWatcher::add(const char *pszFilename)
+{
+    // Files must be added before create() is called. Returns the file's
+    // index, which is what poll() reports.
+
+    File file;
+    WIN32_FILE_ATTRIBUTE_DATA data;
+
+    file.filename = pszFilename;
+    file.changeTime = 0;
+    file.changed = false;
+
+    std::string::size_type slash = file.filename.find_last_of("\\/");
+    std::string path = (slash == std::string::npos) ? "." : file.filename.substr(0, slash + 1);
+
+    file.directory = findDirectory(path);
+
+    if (file.directory < 0)
+    {
+        Directory directory;
+
+        directory.path = path;
+        directory.hNotification = INVALID_HANDLE_VALUE;
+        directory.signaled = false;
+
+        file.directory = static_cast<int>(m_directories.size());
+        m_directories.push_back(directory);
+    }
+
+    if (GetFileAttributesEx(pszFilename, GetFileExInfoStandard, &data))
+    {
+        file.lastWriteTime = data.ftLastWriteTime;
+        file.size = data.nFileSizeLow;
+    }
+    else
+    {
+        file.lastWriteTime.dwLowDateTime = 0;
+        file.lastWriteTime.dwHighDateTime = 0;
+        file.size = 0;
+    }
+
+    m_files.push_back(file);
+    return static_cast<int>(m_files.size()) - 1;
+}
+
+bool FileWatcher::create(bool forcePolling)
+{
+    // Some editors save by writing a new file and renaming it over the old
+    // one, so file name changes are watched as well as writes.
+
+    const DWORD filter = FILE_NOTIFY_CHANGE_LAST_WRITE
+        | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_FILE_NAME;
+
+    m_polledDirectoryCount = 0;
+
+    for (int i = 0; i < static_cast<int>(m_directories.size()); ++i)
+    {
+        Directory &directory = m_directories[i];
+
+        if (!forcePolling && directory.hNotification == INVALID_HANDLE_VALUE)
+            directory.hNotification = FindFirstChangeNotification(directory.path.c_str(), FALSE, filter);
+
+        if (directory.hNotification == INVALID_HANDLE_VALUE)
+            ++m_polledDirectoryCount;
+    }
+
+    m_lastPollTime = GetTickCount();
+    m_created = true;
+    return true;
+}
+
+void FileWatcher::destroy()
+{
+    for (int i = 0; i < static_cast<int>(m_directories.size()); ++i)
+    {
+        if (m_directories[i].hNotification != INVALID_HANDLE_VALUE)
+            FindCloseChangeNotification(m_directories[i].hNotification);
+    }
+
+    m_files.clear();
+    m_directories.clear();
+    m_polledDirectoryCount = 0;
+    m_created = false;
+}
+
+int FileWatcher::poll(std::vector<int> &changed)
+{
+    // Returns the number of changed files. Their indices are stored in
+    // 'changed'.
+
+    changed.clear();
+
+    if (!m_created)
+        return 0;
+
+    DWORD now = GetTickCount();
+    bool pollAll = false;
+
+    if (m_polledDirectoryCount > 0 && now - m_lastPollTime >= POLL_INTERVAL_MS)
+    {
+        m_lastPollTime = now;
+        pollAll = true;
+    }
+
+    for (int i = 0; i < static_cast<int>(m_directories.size()); ++i)
+    {
+        Directory &directory = m_directories[i];
+
+        if (directory.hNotification == INVALID_HANDLE_VALUE)
+        {
+            directory.signaled = pollAll;
+        }
+        else if (WaitForSingleObject(directory.hNotification, 0) == WAIT_OBJECT_0)
+        {
+            directory.signaled = true;
+            FindNextChangeNotification(directory.hNotification);
+        }
+    }
+
+    // Files that are still settling are checked on every call.
+
+    for (int i = 0; i < static_cast<int>(m_files.size()); ++i)
+    {
+        File &file = m_files[i];
+
+        if ((file.changed || m_directories[file.directory].signaled) && checkFile(file, now))
+            changed.push_back(i);
+    }
+
+    for (int i = 0; i < static_cast<int>(m_directories.size()); ++i)
+        m_directories[i].signaled = false;
+
+    return static_cast<int>(changed.size());
+}
+
+bool FileWatcher::checkFile(File &file, DWORD now)
+{
+    // Returns true once a changed file has settled. A file that can't be
+    // read right now (e.g., it's in the middle of being replaced) is left
+    // as it is and checked again on the next call.
+
+    WIN32_FILE_ATTRIBUTE_DATA data;
+
+    if (!GetFileAttributesEx(file.filename.c_str(), GetFileExInfoStandard, &data))
+        return false;
+
+    if (CompareFileTime(&data.ftLastWriteTime, &file.lastWriteTime) != 0
+        || data.nFileSizeLow != file.size)
+    {
+        file.lastWriteTime = data.ftLastWriteTime;
+        file.size = data.nFileSizeLow;
+        file.changeTime = now;
+        file.changed = true;
+        return false;
+    }
+
+    if (file.changed && now - file.changeTime >= SETTLE_TIME_MS)
+    {
+        file.changed = false;
+        return true;
+    }
+
+    return false;
+}
+
+int FileWatcher::findDirectory(const std::string &path) const
+{
+    for (int i = 0; i < static_cast<int>(m_directories.size()); ++i)
+    {
+        if (m_directories[i].path == path)
+            return i;
+    }
+
+    return -1;
+}
@@ -0,0 +1,110 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(FILE_WATCHER_H)
+#define FILE_WATCHER_H
+
+#include <windows.h>
+#include <string>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// The FileWatcher class reports files that have been changed on disk.
+//
+// Each directory holding a watched file gets a change notification handle
+// (FindFirstChangeNotification()). poll() doesn't block. It checks the
+// handles and only looks at the files in directories that were signaled.
+// When a directory can't be watched (e.g., on some network shares), or
+// when polling is forced, every file's last write time is compared instead,
+// at most once every POLL_INTERVAL_MS milliseconds.
+//
+// Editors often save a file in several steps, so a changed file is only
+// reported once its last write time and size have stayed the same for
+// SETTLE_TIME_MS milliseconds. Each change is reported once.
+//-----------------------------------------------------------------------------
+
+class FileWatcher
+{
+public:
+    enum { POLL_INTERVAL_MS = 500, SETTLE_TIME_MS = 100 };
+
+    FileWatcher();
+    ~FileWatcher();
+
+    int add(const char *pszFilename);
+    bool create(bool forcePolling);
+    void destroy();
+    int poll(std::vector<int> &changed);
+
+    // Getter methods.
+
+    int getCount() const;
+    const char *getFilename(int file) const;
+    int getPolledDirectoryCount() const;
+    int getWatchedDirectoryCount() const;
+
+private:
+    struct File
+    {
+        std::string filename;
+        int directory;
+        FILETIME lastWriteTime;
+        DWORD size;
+        DWORD changeTime;
+        bool changed;
+    };
+
+    struct Directory
+    {
+        std::string path;
+        HANDLE hNotification;
+        bool signaled;
+    };
+
+    FileWatcher(const FileWatcher &);
+    FileWatcher &operator=(const FileWatcher &);
+
+    bool checkFile(File &file, DWORD now);
+    int findDirectory(const std::string &path) const;
+
+    std::vector<File> m_files;
+    std::vector<Directory> m_directories;
+    DWORD m_lastPollTime;
+    int m_polledDirectoryCount;
+    bool m_created;
+};
+
+//-----------------------------------------------------------------------------
+
+inline int FileWatcher::getCount() const
+{ return static_cast<int>(m_files.size()); }
+
+inline const char *FileWatcher::getFilename(int file) const
+{ return m_files[file].filename.c_str(); }
+
+inline int FileWatcher::getPolledDirectoryCount() const
+{ return m_polledDirectoryCount; }
+
+inline int FileWatcher::getWatchedDirectoryCount() const
+{ return static_cast<int>(m_directories.size()) - m_polledDirectoryCount; }
+
+#endif
@@ -0,0 +1,116 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include "frame_pipeline.h"
+
+FramePipeline::FramePipeline()
+{
+    m_pfnSimulate = 0;
+    m_pJobSystem = 0;
+    m_busy = false;
+    m_elapsedTimeSec = 0.0f;
+    m_readSlot = 0;
+    m_writeSlot = 0;
+    m_frameCount = 0;
+}
+
+FramePipeline::~FramePipeline()
+{
+    destroy();
+}
+
+bool FramePipeline::create(SimulateFunc pfnSimulate, JobSystem *pJobSystem, bool pipelined)
+{
+    destroy();
+
+    if (!pfnSimulate)
+        return false;
+
+    m_pfnSimulate = pfnSimulate;
+    m_readSlot = 1;
+    m_writeSlot = 0;
+    m_frameCount = 0;
+
+    // Without any worker threads the simulation job would only ever run when
+    // wait() is called, so there's nothing to be gained from pipelining.
+
+    if (pipelined && pJobSystem && pJobSystem->workerCount() > 0)
+        m_pJobSystem = pJobSystem;
+
+    return true;
+}
+
+void FramePipeline::destroy()
+{
+    wait();
+    m_pJobSystem = 0;
+}
+
+void FramePipeline::kick(float elapsedTimeSec)
+{
+    if (!m_pfnSimulate)
+        return;
+
+    // Only one frame can be simulated at a time. This is what bounds the
+    // simulation to at most one frame ahead of the renderer.
+    wait();
+
+    m_elapsedTimeSec = elapsedTimeSec;
+
+    if (m_pJobSystem)
+    {
+        m_busy = true;
+        m_pJobSystem->submit(simulateJob, this, &m_counter);
+    }
+    else
+    {
+        m_pfnSimulate(m_writeSlot, m_elapsedTimeSec);
+        publish();
+    }
+}
+
+void FramePipeline::wait()
+{
+    if (!m_busy)
+        return;
+
+    // The JobSystem's interlocked counter updates act as full memory barriers.
+    // Everything the simulation job wrote is visible once the wait returns.
+
+    m_pJobSystem->wait(&m_counter);
+    m_busy = false;
+    publish();
+}
+
+void FramePipeline::publish()
+{
+    m_readSlot = m_writeSlot;
+    m_writeSlot ^= 1;
+    ++m_frameCount;
+}
+
+void FramePipeline::simulateJob(void *pData)
+{
+    FramePipeline *pPipeline = static_cast<FramePipeline*>(pData);
+
+    pPipeline->m_pfnSimulate(pPipeline->m_writeSlot, pPipeline->m_elapsedTimeSec);
+}
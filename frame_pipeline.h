@@ -0,0 +1,94 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(FRAME_PIPELINE_H)
+#define FRAME_PIPELINE_H
+
+#include "job_system.h"
+
+//-----------------------------------------------------------------------------
+// The FramePipeline class overlaps the simulation of one frame with the
+// rendering of the previous frame.
+//
+// The frame state is double buffered. The application owns the two frame
+// state slots and supplies a function that simulates a frame into a given
+// slot. kick() submits a job to the JobSystem that simulates into the write
+// slot, and returns immediately. wait() blocks until that job is finished and
+// then publishes the frame as the read slot, which the main thread renders
+// from. The job never touches the read slot, so no locking is needed around
+// the frame state itself.
+//
+// A typical frame looks like this:
+//  pipeline.wait();        // frame N is now in readSlot()
+//  ...input...             // simulation is idle, safe to change its inputs
+//  pipeline.kick(dt);      // simulate frame N+1 on a worker thread
+//  render(readSlot());     // render frame N at the same time
+//
+// When pipelining is disabled, or the JobSystem has no worker threads, kick()
+// runs the simulation on the calling thread and publishes the frame straight
+// away. wait() then does nothing. This removes the extra frame of latency at
+// the cost of throughput.
+//-----------------------------------------------------------------------------
+
+class FramePipeline
+{
+public:
+    typedef void (*SimulateFunc)(int slot, float elapsedTimeSec);
+
+    FramePipeline();
+    ~FramePipeline();
+
+    bool create(SimulateFunc pfnSimulate, JobSystem *pJobSystem, bool pipelined);
+    void destroy();
+
+    void kick(float elapsedTimeSec);
+    void wait();
+
+    // Returns true once at least one frame has been published.
+    bool hasFrame() const
+    { return m_frameCount > 0; }
+
+    bool isPipelined() const
+    { return m_pJobSystem != 0; }
+
+    int readSlot() const
+    { return m_readSlot; }
+
+private:
+    FramePipeline(const FramePipeline &);
+    FramePipeline &operator=(const FramePipeline &);
+
+    static void simulateJob(void *pData);
+
+    void publish();
+
+    SimulateFunc m_pfnSimulate;
+    JobSystem *m_pJobSystem;
+    JobCounter m_counter;
+    bool m_busy;
+    float m_elapsedTimeSec;
+    int m_readSlot;
+    int m_writeSlot;
+    unsigned int m_frameCount;
+};
+
+#endif
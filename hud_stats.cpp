@@ -0,0 +1,115 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include "camera.h"
+#include "hud_stats.h"
+#include "text_buffer.h"
+
+void FormatStatsText(const HudStats &stats, TextBuffer &output)
+{
+    const char *pszCurrentBehavior = 0;
+
+    switch (stats.behavior)
+    {
+    default:
+        pszCurrentBehavior = "Unknown";
+        break;
+
+    case Camera::CAMERA_BEHAVIOR_FIRST_PERSON:
+        pszCurrentBehavior = "First Person";
+        break;
+
+    case Camera::CAMERA_BEHAVIOR_FLIGHT:
+        pszCurrentBehavior = "Flight";
+        break;
+
+    case Camera::CAMERA_BEHAVIOR_ORBIT:
+        pszCurrentBehavior = "Orbit";
+        break;
+
+    case Camera::CAMERA_BEHAVIOR_FOLLOW:
+        pszCurrentBehavior = "Follow";
+        break;
+    }
+
+    output.clear();
+
+    output.append("FPS: ").append(stats.framesPerSecond).newline();
+    output.append("Input latency: ").append(stats.inputLatencyMs, 1).append(" ms").newline();
+    output.append("Multisample anti-aliasing: ")
+        .append(static_cast<int>(stats.msaaSamples)).append("x").newline();
+    output.append("Anisotropic filtering: ")
+        .append(static_cast<int>(stats.maxAnisotrophy)).append("x").newline();
+    output.newline();
+
+    output.append("Camera").newline();
+    output.append("  Position:")
+        .append(" x:").append(stats.position[0], 2)
+        .append(" y:").append(stats.position[1], 2)
+        .append(" z:").append(stats.position[2], 2).newline();
+    output.append("  Velocity:")
+        .append(" x:").append(stats.velocity[0], 2)
+        .append(" y:").append(stats.velocity[1], 2)
+        .append(" z:").append(stats.velocity[2], 2).newline();
+    output.append("  Behavior: ").append(pszCurrentBehavior).newline();
+    output.append("  Rotation speed: ").append(stats.rotationSpeed, 2).newline();
+    output.append("  Motion prediction: ");
+
+    if (stats.prediction)
+        output.append("enabled (confidence ").append(stats.predictionConfidence, 2).append(")").newline();
+    else
+        output.append("disabled").newline();
+
+    output.newline();
+
+    output.append("Mouse").newline();
+    output.append("  Smoothing: ")
+        .append(stats.mouseSmoothing ? "enabled" : "disabled").newline();
+    output.append("  Sensitivity: ").append(stats.weightModifier, 2).newline();
+    output.append("  Raw input: ")
+        .append(stats.mouseRawInput ? "enabled" : "disabled").newline();
+    output.newline();
+
+    output.append("Assets").newline();
+    output.append("  Shader load: ").append(stats.shaderLoadMs, 1).append(" ms")
+        .append(stats.shaderCacheHit ? " (cached)" : " (compiled)").newline();
+    output.append("  Hot reload: ");
+
+    if (stats.hotReload)
+    {
+        output.append(stats.hotReload == 2 ? "polling" : "watching")
+            .append(", ").append(stats.assetReloads).append(" reloads");
+
+        if (stats.assetReloadFailed)
+            output.append(", last one failed");
+
+        output.newline();
+    }
+    else
+    {
+        output.append("disabled").newline();
+    }
+
+    output.newline();
+
+    output.append("Press H to display help");
+}
@@ -0,0 +1,64 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(HUD_STATS_H)
+#define HUD_STATS_H
+
+#include <windows.h>
+
+class TextBuffer;
+
+//-----------------------------------------------------------------------------
+// Snapshot of the values the application's on screen statistics display.
+// RenderText() only reformats the statistics when this snapshot changes, and
+// compares snapshots with memcmp(), so zero them before filling them in.
+//-----------------------------------------------------------------------------
+
+struct HudStats
+{
+    int framesPerSecond;
+    float inputLatencyMs;
+    DWORD msaaSamples;
+    DWORD maxAnisotrophy;
+    float position[3];
+    float velocity[3];
+    int behavior;
+    float rotationSpeed;
+    int prediction;
+    float predictionConfidence;
+    float weightModifier;
+    int mouseSmoothing;
+    int mouseRawInput;
+    float shaderLoadMs;
+    int shaderCacheHit;
+    int hotReload;
+    int assetReloads;
+    int assetReloadFailed;
+};
+
+//-----------------------------------------------------------------------------
+// Formats the on screen statistics text for a snapshot into output.
+//-----------------------------------------------------------------------------
+
+void FormatStatsText(const HudStats &stats, TextBuffer &output);
+
+#endif
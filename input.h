@@ -29,8 +29,9 @@
 #include <dinput.h>
 #include <utility>
 #include <vector>
+#include "input_events.h"
 
-class Keyboard
+class Keyboard : public InputEventSource
 {
 public:
     enum Key
@@ -175,20 +176,62 @@ public:
     void handleMsg(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
     void update();
 
+    // Uses the supplied 256 byte key state array (e.g., from a recorded
+    // input log) rather than reading the state from the keyboard device.
+    // The keys flagged (0x80) in the optional 256 byte pKeyTaps array are
+    // reported as pressed even if they have already been released again.
+    void update(const unsigned char *pKeyStates, const unsigned char *pKeyTaps = 0);
+
+    const unsigned char *getKeyStates() const
+    { return m_pCurrKeyStates; }
+
+    // The key states are also available as 256-bit sets (8 words, 1 bit per
+    // key, indexed by the Key values). These are rebuilt once per update().
+
+    const unsigned int *getKeyDownBits() const
+    { return m_keyDownBits; }
+
+    const unsigned int *getKeyPressedBits() const
+    { return m_keyPressedBits; }
+
+    const unsigned int *getKeyReleasedBits() const
+    { return m_keyReleasedBits; }
+
+    // The keys that went down at any time since the last update(), as read
+    // from the device's buffer. Includes keys that are already up again.
+    const unsigned int *getKeyTapBits() const
+    { return m_bufferedKeyDownBits; }
+
     char getLastChar() const
     { return m_lastChar; }
 
     bool keyDown(Key key) const
-    { return (m_pCurrKeyStates[key] & 0x80) ? true : false; }
+    { return testKeyBit(m_keyDownBits, key); }
 
     bool keyUp(Key key) const
-    { return (m_pCurrKeyStates[key] & 0x80) ? false : true; }
+    { return !testKeyBit(m_keyDownBits, key); }
 
+    // A key is considered pressed if it went down at any time since the
+    // last update(). Key presses shorter than a frame are reported too.
     bool keyPressed(Key key) const
-    { 
-        return ((m_pCurrKeyStates[key] & 0x80)
-            && !(m_pPrevKeyStates[key] & 0x80)) ? true : false;
-    }
+    { return testKeyBit(m_keyPressedBits, key); }
+
+    bool keyReleased(Key key) const
+    { return testKeyBit(m_keyReleasedBits, key); }
+
+    // Iterate over the keys that changed state during the last update().
+    // Pass -1 to get the first key. Returns -1 once there are no more keys:
+    //  for (int key = nextPressedKey(-1); key != -1; key = nextPressedKey(key))
+    int nextPressedKey(int prevKey) const
+    { return findNextKey(m_keyPressedBits, prevKey + 1); }
+
+    int nextReleasedKey(int prevKey) const
+    { return findNextKey(m_keyReleasedBits, prevKey + 1); }
+
+    // Timestamped key events are pushed onto the supplied queue as they are
+    // read from the device. Pass 0 to stop generating events.
+    void setEventQueue(InputEventQueue *pQueue)
+    { m_pEventQueue = pQueue; }
 
 private:
     Keyboard();
@@ -196,24 +239,41 @@ private:
 
     bool create();
     void destroy();
+    void readBufferedData();
+    void updateKeyBits();
+
+    static int findNextKey(const unsigned int *pBits, int firstKey);
+
+    static bool testKeyBit(const unsigned int *pBits, int key)
+    { return (pBits[key >> 5] & (1U << (key & 31))) != 0; }
+
+    static const DWORD BUFFER_SIZE;
     
     IDirectInput8 *m_pDirectInput;
     IDirectInputDevice8 *m_pDevice;
+    InputEventQueue *m_pEventQueue;
     unsigned char *m_pCurrKeyStates;
     unsigned char *m_pPrevKeyStates;
     unsigned char m_keyStates[2][256];
+    unsigned int m_keyDownBits[8];
+    unsigned int m_prevKeyDownBits[8];
+    unsigned int m_keyPressedBits[8];
+    unsigned int m_keyReleasedBits[8];
+    unsigned int m_bufferedKeyDownBits[8];
+    bool m_buffered;
     char m_lastChar;
 };
 
 
-class Mouse
+class Mouse : public InputEventSource
 {
 public:
     enum MouseButton
     {
         BUTTON_LEFT   = 0x00,
         BUTTON_RIGHT  = 0x01,
-        BUTTON_MIDDLE = 0x02
+        BUTTON_MIDDLE = 0x02,
+        BUTTON_4      = 0x03
     };
 
     static Mouse &instance();
@@ -223,32 +283,73 @@ public:
 
     bool buttonPressed(MouseButton button) const
     {
-        return ((m_pCurrMouseState->rgbButtons[button] & 0x80)
-            && !(m_pPrevMouseState->rgbButtons[button] & 0x80)) ? true : false;
+        return (((m_pCurrMouseState->rgbButtons[button] & 0x80)
+            && !(m_pPrevMouseState->rgbButtons[button] & 0x80))
+            || m_buttonDownEdges[button]) ? true : false;
     }
 
     bool buttonUp(MouseButton button) const
     { return (m_pCurrMouseState->rgbButtons[button] & 0x80) ? false : true; }
 
+    // The buttons that went down at any time since the last update(), 1 byte
+    // per button (0x80 if it went down). Includes buttons that are already
+    // up again.
+    const unsigned char *buttonTaps() const
+    { return m_buttonDownEdges; }
+
     bool isMouseSmoothing() const
     { return m_enableFiltering; }
 
+    bool isRawInput() const
+    { return m_rawInput; }
+
+    // True if the last update() took the movement from individually filtered
+    // device reports rather than from the polled device state.
+    bool isReportFiltered() const
+    { return m_reportFiltered; }
+
+    // The device reports received during the last update(), unfiltered.
+    const std::vector<MouseReport> &reports() const
+    { return m_reports; }
+
     float xPosRelative() const
     { return m_deltaMouseX; }
 
     float yPosRelative() const
     { return m_deltaMouseY; }
 
+    int historyBufferSize() const
+    { return m_historyBufferSize; }
+
     float weightModifier() const
     { return m_weightModifier; }
 
     float wheelPos() const
     { return m_deltaMouseWheel; }
 
+    const DIMOUSESTATE &mouseState() const
+    { return *m_pCurrMouseState; }
+
+    void setEventQueue(InputEventQueue *pQueue)
+    { m_pEventQueue = pQueue; }
+
+    void setHistoryBufferSize(int size);
+    void setRawInput(bool rawInput);
     void setWeightModifier(float weightModifier);
     void smoothMouse(bool smooth);
     void update();
 
+    // Uses the supplied mouse state (e.g., from a recorded input log) rather
+    // than reading the state from the mouse device. The buttons flagged
+    // (0x80) in the optional 4 byte pButtonTaps array are reported as pressed
+    // even if they have already been released again. When filterReports is
+    // true the movement is taken from the reportCount device reports in
+    // pReports, each filtered individually as in raw input mode, rather than
+    // from the state's lX and lY.
+    void update(const DIMOUSESTATE &state, const unsigned char *pButtonTaps = 0,
+                bool filterReports = false, const MouseReport *pReports = 0,
+                int reportCount = 0);
+
 private:
     Mouse();
     ~Mouse();
@@ -257,12 +358,20 @@ private:
     void destroy();
     void performMouseSmoothing(float x, float y);
     void performMouseFiltering(float x, float y);
+    void processMouseState(bool integrateReports);
+    void processReport();
+    void readBufferedData();
+    void rebuildHistoryWeights();
+    void resetFilters();
+    void resyncFilterSums();
             
     static const float WEIGHT_MODIFIER;
     static const int HISTORY_BUFFER_SIZE;
+    static const DWORD BUFFER_SIZE;
 
     IDirectInput8 *m_pDirectInput;
     IDirectInputDevice8 *m_pDevice;
+    InputEventQueue *m_pEventQueue;
     DIMOUSESTATE *m_pCurrMouseState;
     DIMOUSESTATE *m_pPrevMouseState;
     DIMOUSESTATE m_mouseStates[2];
@@ -270,10 +379,28 @@ private:
     float m_deltaMouseY;
     float m_deltaMouseWheel;
     float m_weightModifier;
+    float m_weightModifierPowN;
+    float m_invHistoryWeightTotal;
+    float m_filterSumX;
+    float m_filterSumY;
+    float m_reportSumX;
+    float m_reportSumY;
+    int m_reportX;
+    int m_reportY;
+    DWORD m_reportSequence;
     int m_historyBufferSize;
+    int m_historyIndex;
     int m_mouseIndex;
     bool m_enableFiltering;
-    std::vector< std::pair<float,float> > m_historyBuffer;
+    bool m_rawInput;
+    bool m_reportFiltered;
+    bool m_reportPending;
+    bool m_buffered;
+    unsigned char m_buttonDownEdges[4];
+    std::vector<float> m_historyX;
+    std::vector<float> m_historyY;
+    std::vector<float> m_historyWeights;
+    std::vector<MouseReport> m_reports;
     std::pair<float,float> m_mouseMovement[2];
 };
 
@@ -0,0 +1,184 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(INPUT_EVENTS_H)
+#define INPUT_EVENTS_H
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#pragma intrinsic(_ReadWriteBarrier)
+#endif
+
+//-----------------------------------------------------------------------------
+// A single timestamped input event. Input events are platform neutral. They
+// are generated from buffered DirectInput device data by the Keyboard and
+// Mouse classes, but any other source (e.g., a synthetic event generator or a
+// recorded input stream) can produce them as well.
+//
+// 'time' is when the event happened in seconds, in the same time base as
+// GetTimeInSeconds(). 'timeStamp' is the device's own millisecond time stamp
+// and is only used to work out how long the event waited in the device's
+// buffer.
+//-----------------------------------------------------------------------------
+
+struct InputEvent
+{
+    enum Type
+    {
+        KEY_DOWN,
+        KEY_UP,
+        MOUSE_BUTTON_DOWN,
+        MOUSE_BUTTON_UP,
+        MOUSE_MOVE_X,
+        MOUSE_MOVE_Y,
+        MOUSE_WHEEL
+    };
+
+    Type type;
+    int code;                   // key or mouse button; unused for movement
+    int value;                  // relative movement for the mouse axes
+    unsigned int timeStamp;     // milliseconds, same time base as GetTickCount()
+    unsigned int sequence;      // events from the same device report share this
+    double time;                // seconds, same time base as GetTimeInSeconds()
+};
+
+//-----------------------------------------------------------------------------
+// The relative movement of a single mouse device report. In raw input mode
+// the Mouse class filters each report individually rather than the movement
+// accumulated over a whole frame.
+//-----------------------------------------------------------------------------
+
+struct MouseReport
+{
+    int x;
+    int y;
+};
+
+//-----------------------------------------------------------------------------
+// A bounded lock-free single producer single consumer queue. The producer and
+// the consumer may run on different threads without any locking. Capacity
+// must be a power of two. When the queue is full push() fails and the item is
+// dropped.
+//-----------------------------------------------------------------------------
+
+// The producer publishes an item by storing the new tail with release
+// semantics after writing the item, and the consumer reads the tail with
+// acquire semantics before reading the item. The consumer hands a slot back
+// the same way through the head. Visual C++ is only used for x86 and x64
+// here, which never reorder loads with loads or stores with stores, so a
+// compiler barrier is all it needs. Everywhere else real atomics are used.
+
+#if defined(_MSC_VER) && !defined(_M_IX86) && !defined(_M_X64)
+#error SpscQueue assumes an x86 or x64 processor under Visual C++.
+#endif
+
+inline unsigned int SpscLoadAcquire(const volatile unsigned int &index)
+{
+#if defined(_MSC_VER)
+    unsigned int value = index;
+    _ReadWriteBarrier();
+    return value;
+#else
+    return __atomic_load_n(&index, __ATOMIC_ACQUIRE);
+#endif
+}
+
+inline void SpscStoreRelease(volatile unsigned int &index, unsigned int value)
+{
+#if defined(_MSC_VER)
+    _ReadWriteBarrier();
+    index = value;
+#else
+    __atomic_store_n(&index, value, __ATOMIC_RELEASE);
+#endif
+}
+
+template <typename T, unsigned int Capacity>
+class SpscQueue
+{
+public:
+    SpscQueue() : m_head(0), m_tail(0) {}
+
+    bool empty() const
+    { return SpscLoadAcquire(m_head) == SpscLoadAcquire(m_tail); }
+
+    unsigned int size() const
+    { return SpscLoadAcquire(m_tail) - SpscLoadAcquire(m_head); }
+
+    bool push(const T &item)
+    {
+        // Only the producer stores the tail, so it can read it plainly. The
+        // head must be acquired so the consumer has finished reading a slot
+        // before it's overwritten.
+
+        unsigned int tail = m_tail;
+
+        if (tail - SpscLoadAcquire(m_head) == Capacity)
+            return false;
+
+        m_items[tail & (Capacity - 1)] = item;
+        SpscStoreRelease(m_tail, tail + 1);
+        return true;
+    }
+
+    bool pop(T &item)
+    {
+        unsigned int head = m_head;
+
+        if (head == SpscLoadAcquire(m_tail))
+            return false;
+
+        item = m_items[head & (Capacity - 1)];
+        SpscStoreRelease(m_head, head + 1);
+        return true;
+    }
+
+private:
+    // Wrap around of the unsigned indices is well defined and handled by the
+    // masking above as long as Capacity is a power of two.
+    typedef char CapacityMustBeAPowerOfTwo[(Capacity & (Capacity - 1)) == 0 ? 1 : -1];
+
+    T m_items[Capacity];
+    volatile unsigned int m_head;
+    volatile unsigned int m_tail;
+};
+
+typedef SpscQueue<InputEvent, 1024> InputEventQueue;
+
+//-----------------------------------------------------------------------------
+// The interface shared by everything that generates InputEvents: the
+// DirectInput backed Keyboard and Mouse classes and the platform neutral
+// SyntheticInputSource class. update() reads the input that arrived since
+// the last call and pushes an event for each change onto the queue given
+// to setEventQueue(). Events that don't fit into the queue are dropped.
+//-----------------------------------------------------------------------------
+
+class InputEventSource
+{
+public:
+    virtual ~InputEventSource() {}
+
+    virtual void setEventQueue(InputEventQueue *pQueue) = 0;
+    virtual void update() = 0;
+};
+
+#endif
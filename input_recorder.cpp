@@ -0,0 +1,346 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+
+#include <cstring>
+#include "input_recorder.h"
+
+namespace
+{
+    // Version 1 logs never set flags bits 5 to 7, so they read back as logs
+    // without any taps or mouse reports.
+    const char FILE_MAGIC[4] = {'C', 'I', 'R', '2'};
+    const char FILE_MAGIC_V1[4] = {'C', 'I', 'R', '1'};
+
+    const unsigned char FLAG_KEYS_CHANGED = 0x01;
+    const int FLAG_BUTTON_SHIFT = 1;
+    const unsigned char FLAG_BUTTON_MASK = 0x1e;
+    const unsigned char FLAG_KEY_TAPS = 0x20;
+    const unsigned char FLAG_BUTTON_TAPS = 0x40;
+    const unsigned char FLAG_RAW_MOUSE = 0x80;
+
+    short ClampToShort(int value)
+    {
+        if (value > 32767)
+            return 32767;
+
+        if (value < -32768)
+            return -32768;
+
+        return static_cast<short>(value);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// InputRecorder.
+//-----------------------------------------------------------------------------
+
+InputRecorder::InputRecorder()
+{
+    m_pFile = 0;
+    m_frameCount = 0;
+    m_prevButtonBits = 0;
+    memset(m_prevKeyBits, 0, sizeof(m_prevKeyBits));
+}
+
+InputRecorder::~InputRecorder()
+{
+    close();
+}
+
+bool InputRecorder::open(const char *pszFilename)
+{
+    close();
+
+    if (!(m_pFile = fopen(pszFilename, "wb")))
+        return false;
+
+    if (fwrite(FILE_MAGIC, sizeof(FILE_MAGIC), 1, m_pFile) != 1)
+    {
+        close();
+        return false;
+    }
+
+    m_frameCount = 0;
+    m_prevButtonBits = 0;
+    memset(m_prevKeyBits, 0, sizeof(m_prevKeyBits));
+    return true;
+}
+
+void InputRecorder::close()
+{
+    if (m_pFile)
+    {
+        fclose(m_pFile);
+        m_pFile = 0;
+    }
+}
+
+bool InputRecorder::write(const InputFrame &frame)
+{
+    if (!m_pFile)
+        return false;
+
+    unsigned char keyBits[32] = {0};
+    unsigned char tapBits[32] = {0};
+    unsigned char buttonTaps = 0;
+    unsigned char flags = 0;
+
+    for (int i = 0; i < 256; ++i)
+    {
+        if (frame.keyStates[i] & 0x80)
+            keyBits[i >> 3] |= static_cast<unsigned char>(1 << (i & 7));
+    }
+
+    // The very first frame always stores the key states.
+    if (m_frameCount == 0 || memcmp(keyBits, m_prevKeyBits, sizeof(keyBits)) != 0)
+        flags |= FLAG_KEYS_CHANGED;
+
+    for (int i = 0; i < 4; ++i)
+    {
+        if (frame.mouseButtons[i] & 0x80)
+            flags |= static_cast<unsigned char>(1 << (i + FLAG_BUTTON_SHIFT));
+    }
+
+    // Only store the taps that can't be worked out from the states, i.e.,
+    // keys and buttons that aren't down now or were already down before.
+
+    for (int i = 0; i < 256; ++i)
+    {
+        unsigned char bit = static_cast<unsigned char>(1 << (i & 7));
+        bool wentDown = (keyBits[i >> 3] & bit) && !(m_prevKeyBits[i >> 3] & bit);
+
+        if ((frame.keyTaps[i] & 0x80) && !wentDown)
+        {
+            tapBits[i >> 3] |= bit;
+            flags |= FLAG_KEY_TAPS;
+        }
+    }
+
+    for (int i = 0; i < 4; ++i)
+    {
+        unsigned char bit = static_cast<unsigned char>(1 << (i + FLAG_BUTTON_SHIFT));
+        bool wentDown = (flags & bit) && !(m_prevButtonBits & bit);
+
+        if ((frame.mouseButtonTaps[i] & 0x80) && !wentDown)
+        {
+            buttonTaps |= static_cast<unsigned char>(1 << i);
+            flags |= FLAG_BUTTON_TAPS;
+        }
+    }
+
+    if (frame.mouseRawInput)
+        flags |= FLAG_RAW_MOUSE;
+
+    short mouse[3] =
+    {
+        ClampToShort(frame.mouseX),
+        ClampToShort(frame.mouseY),
+        ClampToShort(frame.mouseWheel)
+    };
+
+    bool ok = fwrite(&frame.elapsedTimeSec, sizeof(frame.elapsedTimeSec), 1, m_pFile) == 1
+           && fwrite(&flags, sizeof(flags), 1, m_pFile) == 1;
+
+    if (ok && (flags & FLAG_KEYS_CHANGED))
+        ok = fwrite(keyBits, sizeof(keyBits), 1, m_pFile) == 1;
+
+    if (ok && (flags & FLAG_KEY_TAPS))
+        ok = fwrite(tapBits, sizeof(tapBits), 1, m_pFile) == 1;
+
+    if (ok && (flags & FLAG_BUTTON_TAPS))
+        ok = fwrite(&buttonTaps, sizeof(buttonTaps), 1, m_pFile) == 1;
+
+    if (ok)
+        ok = fwrite(mouse, sizeof(mouse), 1, m_pFile) == 1;
+
+    if (ok && (flags & FLAG_RAW_MOUSE))
+    {
+        int count = frame.mouseReportCount;
+
+        m_reports.resize(count * 2);
+
+        for (int i = 0; i < count; ++i)
+        {
+            m_reports[i * 2] = ClampToShort(frame.pMouseReports[i].x);
+            m_reports[i * 2 + 1] = ClampToShort(frame.pMouseReports[i].y);
+        }
+
+        ok = fwrite(&count, sizeof(count), 1, m_pFile) == 1
+          && (count == 0 || fwrite(&m_reports[0], sizeof(short) * 2, count, m_pFile) == static_cast<size_t>(count));
+    }
+
+    if (!ok)
+    {
+        close();
+        return false;
+    }
+
+    memcpy(m_prevKeyBits, keyBits, sizeof(keyBits));
+    m_prevButtonBits = flags & FLAG_BUTTON_MASK;
+    ++m_frameCount;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// InputPlayback.
+//-----------------------------------------------------------------------------
+
+InputPlayback::InputPlayback()
+{
+    m_pFile = 0;
+    m_frameCount = 0;
+    m_buttonBits = 0;
+    memset(m_keyBits, 0, sizeof(m_keyBits));
+    memset(m_prevKeyBits, 0, sizeof(m_prevKeyBits));
+}
+
+InputPlayback::~InputPlayback()
+{
+    close();
+}
+
+bool InputPlayback::open(const char *pszFilename)
+{
+    close();
+
+    if (!(m_pFile = fopen(pszFilename, "rb")))
+        return false;
+
+    char magic[sizeof(FILE_MAGIC)];
+
+    if (fread(magic, sizeof(magic), 1, m_pFile) != 1
+        || (memcmp(magic, FILE_MAGIC, sizeof(magic)) != 0
+            && memcmp(magic, FILE_MAGIC_V1, sizeof(magic)) != 0))
+    {
+        close();
+        return false;
+    }
+
+    m_frameCount = 0;
+    m_buttonBits = 0;
+    memset(m_keyBits, 0, sizeof(m_keyBits));
+    memset(m_prevKeyBits, 0, sizeof(m_prevKeyBits));
+    return true;
+}
+
+void InputPlayback::close()
+{
+    if (m_pFile)
+    {
+        fclose(m_pFile);
+        m_pFile = 0;
+    }
+}
+
+bool InputPlayback::read(InputFrame &frame)
+{
+    // Returns false once the end of the log has been reached. A truncated
+    // final frame is treated as the end of the log.
+
+    if (!m_pFile)
+        return false;
+
+    unsigned char flags = 0;
+    unsigned char tapBits[32] = {0};
+    unsigned char buttonTaps = 0;
+    short mouse[3];
+    int reportCount = 0;
+
+    if (fread(&frame.elapsedTimeSec, sizeof(frame.elapsedTimeSec), 1, m_pFile) != 1
+        || fread(&flags, sizeof(flags), 1, m_pFile) != 1)
+        return false;
+
+    memcpy(m_prevKeyBits, m_keyBits, sizeof(m_keyBits));
+
+    if (flags & FLAG_KEYS_CHANGED)
+    {
+        if (fread(m_keyBits, sizeof(m_keyBits), 1, m_pFile) != 1)
+            return false;
+    }
+
+    if (flags & FLAG_KEY_TAPS)
+    {
+        if (fread(tapBits, sizeof(tapBits), 1, m_pFile) != 1)
+            return false;
+    }
+
+    if (flags & FLAG_BUTTON_TAPS)
+    {
+        if (fread(&buttonTaps, sizeof(buttonTaps), 1, m_pFile) != 1)
+            return false;
+    }
+
+    if (fread(mouse, sizeof(mouse), 1, m_pFile) != 1)
+        return false;
+
+    if (flags & FLAG_RAW_MOUSE)
+    {
+        if (fread(&reportCount, sizeof(reportCount), 1, m_pFile) != 1 || reportCount < 0)
+            return false;
+
+        m_reportData.resize(reportCount * 2);
+        m_reports.resize(reportCount);
+
+        if (reportCount > 0 && fread(&m_reportData[0], sizeof(short) * 2, reportCount, m_pFile)
+                != static_cast<size_t>(reportCount))
+            return false;
+
+        for (int i = 0; i < reportCount; ++i)
+        {
+            m_reports[i].x = m_reportData[i * 2];
+            m_reports[i].y = m_reportData[i * 2 + 1];
+        }
+    }
+
+    // Keys and buttons that went down during the frame and are still down
+    // weren't stored as taps.
+
+    for (int i = 0; i < 256; ++i)
+    {
+        unsigned char bit = static_cast<unsigned char>(1 << (i & 7));
+        bool wentDown = (m_keyBits[i >> 3] & bit) && !(m_prevKeyBits[i >> 3] & bit);
+
+        frame.keyStates[i] = (m_keyBits[i >> 3] & bit) ? 0x80 : 0;
+        frame.keyTaps[i] = (wentDown || (tapBits[i >> 3] & bit)) ? 0x80 : 0;
+    }
+
+    for (int i = 0; i < 4; ++i)
+    {
+        unsigned char bit = static_cast<unsigned char>(1 << (i + FLAG_BUTTON_SHIFT));
+        bool wentDown = (flags & bit) && !(m_buttonBits & bit);
+
+        frame.mouseButtons[i] = (flags & bit) ? 0x80 : 0;
+        frame.mouseButtonTaps[i] = (wentDown || (buttonTaps & (1 << i))) ? 0x80 : 0;
+    }
+
+    frame.mouseX = mouse[0];
+    frame.mouseY = mouse[1];
+    frame.mouseWheel = mouse[2];
+    frame.mouseRawInput = (flags & FLAG_RAW_MOUSE) != 0;
+    frame.mouseReportCount = reportCount;
+    frame.pMouseReports = (reportCount > 0) ? &m_reports[0] : 0;
+
+    m_buttonBits = flags & FLAG_BUTTON_MASK;
+    ++m_frameCount;
+    return true;
+}
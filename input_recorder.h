@@ -0,0 +1,147 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+
+#if !defined(INPUT_RECORDER_H)
+#define INPUT_RECORDER_H
+
+#include <cstdio>
+#include <vector>
+#include "input_events.h"
+
+//-----------------------------------------------------------------------------
+// The state of the keyboard and the mouse for a single frame along with the
+// elapsed time used to update that frame. Key and button states use the
+// DirectInput convention: the high bit (0x80) is set when the key or button
+// is down. The key and button taps flag the keys and buttons that went down
+// at any time during the frame, including ones that were released again
+// before the end of the frame.
+//
+// When mouseRawInput is set the mouse movement was filtered one device
+// report at a time, and pMouseReports holds the frame's mouseReportCount
+// reports. InputPlayback owns the reports; they stay valid until the next
+// call to read().
+//-----------------------------------------------------------------------------
+
+struct InputFrame
+{
+    float elapsedTimeSec;
+    unsigned char keyStates[256];
+    unsigned char keyTaps[256];
+    unsigned char mouseButtons[4];
+    unsigned char mouseButtonTaps[4];
+    int mouseX;
+    int mouseY;
+    int mouseWheel;
+    bool mouseRawInput;
+    int mouseReportCount;
+    const MouseReport *pMouseReports;
+};
+
+//-----------------------------------------------------------------------------
+// The InputRecorder class serializes InputFrames into a compact binary log.
+// Each frame is stored as:
+//
+//  float          elapsed time in seconds
+//  unsigned char  flags: bit 0 set if the key states changed since the
+//                 previous frame, bits 1-4 hold the mouse button states,
+//                 bit 5 set if there are key taps, bit 6 set if there are
+//                 mouse button taps, bit 7 set for raw mouse input
+//  unsigned char  [32] key states, 1 bit per key (only if flags bit 0 is set)
+//  unsigned char  [32] key taps, 1 bit per key (only if flags bit 5 is set)
+//  unsigned char  mouse button taps in bits 0-3 (only if flags bit 6 is set)
+//  short          [3] relative mouse x, y, and wheel movement
+//  int            number of mouse reports (only if flags bit 7 is set)
+//  short          [2] relative x and y movement of each mouse report
+//
+// Keys and buttons that went down during the frame and are still down are
+// implied by the states and aren't stored as taps. Most frames don't change
+// the key states and have no taps so a typical frame takes up 11 bytes plus
+// 4 bytes per report in raw mouse input mode. All values are written in the
+// native (little endian) byte order. Logs written before the taps and the
+// reports were added are still read back.
+//-----------------------------------------------------------------------------
+
+class InputRecorder
+{
+public:
+    InputRecorder();
+    ~InputRecorder();
+
+    bool open(const char *pszFilename);
+    void close();
+    bool write(const InputFrame &frame);
+
+    bool isOpen() const
+    { return m_pFile != 0; }
+
+    int frameCount() const
+    { return m_frameCount; }
+
+private:
+    InputRecorder(const InputRecorder &);
+    InputRecorder &operator=(const InputRecorder &);
+
+    FILE *m_pFile;
+    int m_frameCount;
+    unsigned char m_prevKeyBits[32];
+    unsigned char m_prevButtonBits;
+    std::vector<short> m_reports;
+};
+
+//-----------------------------------------------------------------------------
+// The InputPlayback class reads back the InputFrames written by the
+// InputRecorder class. The frames are returned in the order they were
+// recorded. Feeding them to the Keyboard and Mouse classes in place of the
+// live device state reproduces the recorded session exactly.
+//-----------------------------------------------------------------------------
+
+class InputPlayback
+{
+public:
+    InputPlayback();
+    ~InputPlayback();
+
+    bool open(const char *pszFilename);
+    void close();
+    bool read(InputFrame &frame);
+
+    bool isOpen() const
+    { return m_pFile != 0; }
+
+    int frameCount() const
+    { return m_frameCount; }
+
+private:
+    InputPlayback(const InputPlayback &);
+    InputPlayback &operator=(const InputPlayback &);
+
+    FILE *m_pFile;
+    int m_frameCount;
+    unsigned char m_keyBits[32];
+    unsigned char m_prevKeyBits[32];
+    unsigned char m_buttonBits;
+    std::vector<short> m_reportData;
+    std::vector<MouseReport> m_reports;
+};
+
+#endif
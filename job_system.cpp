@@ -0,0 +1,443 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <intrin.h>
+#include <process.h>
+#include "job_system.h"
+
+#if defined(_MSC_VER)
+#pragma intrinsic(_ReadWriteBarrier)
+
+// The deque's acquire and release fences are plain _ReadWriteBarrier()
+// compiler barriers under Visual C++, which is only enough on x86 and x64.
+// The stand in intrin.h used by other compilers emits real fences instead.
+#if !defined(_M_IX86) && !defined(_M_X64)
+#error The job system memory ordering assumes an x86 or x64 processor.
+#endif
+#endif
+
+namespace
+{
+    // Number of times an idle worker looks for jobs to steal before it goes
+    // to sleep.
+    const int IDLE_SPIN_COUNT = 64;
+
+    const LONG MAX_WAKE_COUNT = 0x7fffffff;
+}
+
+//-----------------------------------------------------------------------------
+// JobSystem::WorkStealingDeque.
+//
+// Based on the deque described in "Dynamic Circular Work-Stealing Deque" by
+// David Chase and Yossi Lev. The owning thread works at the bottom of the
+// deque and only needs an interlocked operation when taking the last job.
+// Thieves take jobs from the top using a compare and swap.
+//
+// The indices only ever increase (apart from pop() temporarily decrementing
+// bottom) and are masked to index into the fixed size ring of jobs.
+//-----------------------------------------------------------------------------
+
+JobSystem::WorkStealingDeque::WorkStealingDeque()
+{
+    clear();
+}
+
+void JobSystem::WorkStealingDeque::clear()
+{
+    m_top = 0;
+    m_bottom = 0;
+}
+
+bool JobSystem::WorkStealingDeque::push(const Job &job)
+{
+    LONG bottom = m_bottom;
+    LONG top = m_top;
+
+    if (bottom - top >= DEQUE_CAPACITY)
+        return false;
+
+    m_jobs[bottom & (DEQUE_CAPACITY - 1)] = job;
+
+    // Release: the job must be written before the new bottom is published.
+    // On x86 stores aren't reordered with other stores, so this only stops
+    // the compiler. Elsewhere it's a real fence; see intrin.h.
+    _ReadWriteBarrier();
+
+    m_bottom = bottom + 1;
+    return true;
+}
+
+bool JobSystem::WorkStealingDeque::pop(Job &job)
+{
+    LONG bottom = m_bottom - 1;
+
+    // The new bottom must be visible to thieves before top is read. This is
+    // the one place where a full fence is required.
+    InterlockedExchange(&m_bottom, bottom);
+
+    LONG top = m_top;
+
+    if (top > bottom)
+    {
+        // The deque was empty.
+        m_bottom = top;
+        return false;
+    }
+
+    job = m_jobs[bottom & (DEQUE_CAPACITY - 1)];
+
+    if (top != bottom)
+        return true;
+
+    // This is the last job. Race any thieves for it.
+
+    bool taken = InterlockedCompareExchange(&m_top, top + 1, top) == top;
+
+    m_bottom = top + 1;
+    return taken;
+}
+
+bool JobSystem::WorkStealingDeque::steal(Job &job)
+{
+    LONG top = m_top;
+
+    // Acquire: top must be read before bottom.
+    _ReadWriteBarrier();
+
+    LONG bottom = m_bottom;
+
+    if (top >= bottom)
+        return false;
+
+    // Acquire: pairs with the release in push() so the job is read only after
+    // the bottom that published it.
+    _ReadWriteBarrier();
+
+    Job stolen = m_jobs[top & (DEQUE_CAPACITY - 1)];
+
+    if (InterlockedCompareExchange(&m_top, top + 1, top) != top)
+        return false;
+
+    job = stolen;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// JobSystem.
+//-----------------------------------------------------------------------------
+
+JobSystem::JobSystem()
+{
+    m_hWakeSemaphore = 0;
+    m_tlsIndex = TLS_OUT_OF_INDEXES;
+    m_threadCount = 0;
+    m_sleepingWorkers = 0;
+    m_quit = false;
+
+    for (int i = 0; i < MAX_THREADS; ++i)
+        m_hThreads[i] = 0;
+}
+
+JobSystem::~JobSystem()
+{
+    destroy();
+}
+
+bool JobSystem::create(int workerCount, bool pinThreads)
+{
+    destroy();
+
+    if (workerCount < 0)
+        workerCount = processorCount() - 1;
+
+    if (workerCount > MAX_THREADS - 1)
+        workerCount = MAX_THREADS - 1;
+
+    m_tlsIndex = TlsAlloc();
+
+    if (m_tlsIndex == TLS_OUT_OF_INDEXES)
+        return false;
+
+    m_hWakeSemaphore = CreateSemaphore(0, 0, MAX_WAKE_COUNT, 0);
+
+    if (!m_hWakeSemaphore)
+    {
+        destroy();
+        return false;
+    }
+
+    for (int i = 0; i < MAX_THREADS; ++i)
+        m_deques[i].clear();
+
+    m_quit = false;
+    m_sleepingWorkers = 0;
+
+    // Thread indices are stored off by one so that threads outside of the
+    // job system read back as -1. The calling thread is always thread 0.
+
+    TlsSetValue(m_tlsIndex, reinterpret_cast<void*>(1));
+    m_threadCount = 1;
+
+    // Collect the processors this process is allowed to run on. The first one
+    // is left to the calling thread.
+
+    DWORD_PTR processors[sizeof(DWORD_PTR) * 8];
+    DWORD_PTR processMask = 0;
+    DWORD_PTR systemMask = 0;
+    int pinCount = 0;
+
+    if (pinThreads && GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+    {
+        for (int i = 0; i < static_cast<int>(sizeof(DWORD_PTR) * 8); ++i)
+        {
+            DWORD_PTR mask = static_cast<DWORD_PTR>(1) << i;
+
+            if (processMask & mask)
+                processors[pinCount++] = mask;
+        }
+    }
+
+    // The workers are created suspended and only started once they have all
+    // been created. That way they never see a partially initialized system.
+
+    for (int i = 1; i <= workerCount; ++i)
+    {
+        m_startInfo[i].pJobSystem = this;
+        m_startInfo[i].threadIndex = i;
+
+        m_hThreads[i] = reinterpret_cast<HANDLE>(_beginthreadex(0, 0,
+            workerThreadProc, &m_startInfo[i], CREATE_SUSPENDED, 0));
+
+        if (!m_hThreads[i])
+        {
+            destroy();
+            return false;
+        }
+
+        if (pinCount > 1)
+            SetThreadAffinityMask(m_hThreads[i], processors[1 + (i - 1) % (pinCount - 1)]);
+
+        ++m_threadCount;
+    }
+
+    for (int i = 1; i < m_threadCount; ++i)
+        ResumeThread(m_hThreads[i]);
+
+    return true;
+}
+
+void JobSystem::destroy()
+{
+    // Must be called from the thread that called create(). Any jobs that are
+    // still queued are run before the system shuts down.
+
+    if (m_threadCount > 0)
+    {
+        m_quit = true;
+        ReleaseSemaphore(m_hWakeSemaphore, workerCount(), 0);
+
+        for (int i = 1; i < m_threadCount; ++i)
+        {
+            if (m_hThreads[i])
+            {
+                // Suspended threads are left behind if create() failed half
+                // way through. Let them run so that they see m_quit.
+
+                ResumeThread(m_hThreads[i]);
+                WaitForSingleObject(m_hThreads[i], INFINITE);
+                CloseHandle(m_hThreads[i]);
+                m_hThreads[i] = 0;
+            }
+        }
+
+        Job job;
+
+        for (int i = 0; i < m_threadCount; ++i)
+        {
+            while (m_deques[i].steal(job))
+                runJob(job);
+        }
+
+        m_threadCount = 0;
+    }
+
+    if (m_hWakeSemaphore)
+    {
+        CloseHandle(m_hWakeSemaphore);
+        m_hWakeSemaphore = 0;
+    }
+
+    if (m_tlsIndex != TLS_OUT_OF_INDEXES)
+    {
+        TlsSetValue(m_tlsIndex, 0);
+        TlsFree(m_tlsIndex);
+        m_tlsIndex = TLS_OUT_OF_INDEXES;
+    }
+}
+
+void JobSystem::submit(JobFunc pfnJob, void *pData, JobCounter *pCounter)
+{
+    Job job;
+
+    job.pfnJob = pfnJob;
+    job.pData = pData;
+    job.pCounter = pCounter;
+
+    if (pCounter)
+        InterlockedIncrement(&pCounter->m_count);
+
+    int threadIndex = currentThreadIndex();
+
+    if (threadIndex < 0 || !m_deques[threadIndex].push(job))
+    {
+        runJob(job);
+        return;
+    }
+
+    // The push must be visible before the sleeping worker count is read.
+    // Otherwise a worker that is just about to sleep could miss the new job.
+    MemoryBarrier();
+
+    if (m_sleepingWorkers > 0)
+        ReleaseSemaphore(m_hWakeSemaphore, 1, 0);
+}
+
+void JobSystem::wait(JobCounter *pCounter)
+{
+    if (!pCounter)
+        return;
+
+    int threadIndex = currentThreadIndex();
+    Job job;
+
+    while (pCounter->m_count != 0)
+    {
+        if (threadIndex >= 0 && findJob(threadIndex, job))
+            runJob(job);
+        else
+            YieldProcessor();
+    }
+}
+
+int JobSystem::processorCount()
+{
+    DWORD_PTR processMask = 0;
+    DWORD_PTR systemMask = 0;
+    int count = 0;
+
+    if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+        return 1;
+
+    for (; processMask != 0; processMask &= processMask - 1)
+        ++count;
+
+    return (count > 0) ? count : 1;
+}
+
+bool JobSystem::findJob(int threadIndex, Job &job)
+{
+    // Prefer the most recently submitted job from our own deque since its data
+    // is most likely still in the cache. Otherwise steal the oldest job from
+    // one of the other threads.
+
+    if (m_deques[threadIndex].pop(job))
+        return true;
+
+    for (int i = 1; i < m_threadCount; ++i)
+    {
+        if (m_deques[(threadIndex + i) % m_threadCount].steal(job))
+            return true;
+    }
+
+    return false;
+}
+
+bool JobSystem::hasJobs() const
+{
+    for (int i = 0; i < m_threadCount; ++i)
+    {
+        if (!m_deques[i].empty())
+            return true;
+    }
+
+    return false;
+}
+
+int JobSystem::currentThreadIndex() const
+{
+    if (m_tlsIndex == TLS_OUT_OF_INDEXES)
+        return -1;
+
+    return static_cast<int>(reinterpret_cast<INT_PTR>(TlsGetValue(m_tlsIndex))) - 1;
+}
+
+void JobSystem::runJob(const Job &job)
+{
+    job.pfnJob(job.pData);
+
+    if (job.pCounter)
+        InterlockedDecrement(&job.pCounter->m_count);
+}
+
+void JobSystem::workerLoop(int threadIndex)
+{
+    Job job;
+    int idleSpins = 0;
+
+    while (!m_quit)
+    {
+        if (findJob(threadIndex, job))
+        {
+            runJob(job);
+            idleSpins = 0;
+            continue;
+        }
+
+        if (++idleSpins < IDLE_SPIN_COUNT)
+        {
+            YieldProcessor();
+            continue;
+        }
+
+        // Announce that we're about to sleep and then check one last time.
+        // The interlocked increment is a full fence that pairs with the one
+        // in submit().
+
+        InterlockedIncrement(&m_sleepingWorkers);
+
+        if (!hasJobs() && !m_quit)
+            WaitForSingleObject(m_hWakeSemaphore, INFINITE);
+
+        InterlockedDecrement(&m_sleepingWorkers);
+        idleSpins = 0;
+    }
+}
+
+unsigned int __stdcall JobSystem::workerThreadProc(void *pArg)
+{
+    const WorkerStartInfo *pInfo = static_cast<const WorkerStartInfo*>(pArg);
+    JobSystem *pJobSystem = pInfo->pJobSystem;
+
+    TlsSetValue(pJobSystem->m_tlsIndex, reinterpret_cast<void*>(static_cast<INT_PTR>(pInfo->threadIndex + 1)));
+    pJobSystem->workerLoop(pInfo->threadIndex);
+    return 0;
+}
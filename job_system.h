@@ -0,0 +1,156 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(JOB_SYSTEM_H)
+#define JOB_SYSTEM_H
+
+#include <windows.h>
+
+//-----------------------------------------------------------------------------
+// A JobCounter tracks a group of submitted jobs. It's incremented when a job
+// is submitted and decremented once the job has run. JobSystem::wait() is
+// used to wait for all of the jobs in the group to complete. Counters are
+// how dependencies between jobs are expressed: a job that depends on the
+// results of other jobs waits on their counter.
+//-----------------------------------------------------------------------------
+
+class JobCounter
+{
+public:
+    JobCounter() : m_count(0) {}
+
+    bool isDone() const
+    { return m_count == 0; }
+
+private:
+    friend class JobSystem;
+
+    volatile LONG m_count;
+};
+
+//-----------------------------------------------------------------------------
+// The JobSystem class runs small units of work on a pool of worker threads.
+//
+// Each thread in the system (the thread that called create() plus the worker
+// threads) owns a Chase-Lev work stealing deque. Jobs are pushed onto and
+// popped off the bottom of the submitting thread's own deque without any
+// locking. Idle threads steal jobs from the top of the other threads' deques.
+// Workers that can't find anything to do sleep on a semaphore until new jobs
+// are submitted.
+//
+// wait() doesn't block. The waiting thread keeps running jobs until the
+// counter reaches zero, so it's safe to wait from inside a job.
+//
+// Only the thread that called create() and the worker threads may submit
+// jobs. Jobs submitted from any other thread are run immediately on that
+// thread. A job that doesn't fit into a full deque is also run immediately.
+//
+// Worker threads can optionally be pinned to processors. Each worker gets its
+// own processor from the process affinity mask, skipping the first one which
+// is left for the thread that called create().
+//-----------------------------------------------------------------------------
+
+class JobSystem
+{
+public:
+    typedef void (*JobFunc)(void *pData);
+
+    enum
+    {
+        MAX_THREADS = 32,
+        DEQUE_CAPACITY = 1024
+    };
+
+    JobSystem();
+    ~JobSystem();
+
+    // Use a worker count of -1 to create one worker per available processor,
+    // not counting the processor used by the calling thread.
+    bool create(int workerCount, bool pinThreads);
+    void destroy();
+
+    void submit(JobFunc pfnJob, void *pData, JobCounter *pCounter);
+    void wait(JobCounter *pCounter);
+
+    static int processorCount();
+
+    int workerCount() const
+    { return m_threadCount > 0 ? m_threadCount - 1 : 0; }
+
+private:
+    struct Job
+    {
+        JobFunc pfnJob;
+        void *pData;
+        JobCounter *pCounter;
+    };
+
+    class WorkStealingDeque
+    {
+    public:
+        WorkStealingDeque();
+
+        void clear();
+        bool push(const Job &job);
+        bool pop(Job &job);
+        bool steal(Job &job);
+
+        bool empty() const
+        { return m_bottom <= m_top; }
+
+    private:
+        Job m_jobs[DEQUE_CAPACITY];
+        volatile LONG m_top;
+        volatile LONG m_bottom;
+
+        // Keep the indices of neighboring deques on different cache lines.
+        char m_padding[64];
+    };
+
+    struct WorkerStartInfo
+    {
+        JobSystem *pJobSystem;
+        int threadIndex;
+    };
+
+    JobSystem(const JobSystem &);
+    JobSystem &operator=(const JobSystem &);
+
+    static unsigned int __stdcall workerThreadProc(void *pArg);
+
+    bool findJob(int threadIndex, Job &job);
+    bool hasJobs() const;
+    int currentThreadIndex() const;
+    void runJob(const Job &job);
+    void workerLoop(int threadIndex);
+
+    WorkStealingDeque m_deques[MAX_THREADS];
+    WorkerStartInfo m_startInfo[MAX_THREADS];
+    HANDLE m_hThreads[MAX_THREADS];
+    HANDLE m_hWakeSemaphore;
+    DWORD m_tlsIndex;
+    int m_threadCount;
+    volatile LONG m_sleepingWorkers;
+    volatile bool m_quit;
+};
+
+#endif
@@ -44,18 +44,51 @@
 #include <windows.h>
 #include <d3d9.h>
 #include <d3dx9.h>
-#include <iomanip>
+#include <process.h>
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 #if defined(_DEBUG)
 #include <crtdbg.h>
 #endif
 
+#include "action_map.h"
+#include "app_camera.h"
+#include "app_input.h"
 #include "camera.h"
+#include "camera_controller.h"
+#include "camera_input.h"
+#include "camera_predictor.h"
+#include "camera_replay.h"
+#include "camera_rig.h"
+#include "camera_set.h"
+#include "camera_track.h"
+#include "deferred_shading.h"
+#include "effect_compiler.h"
+#include "file_watcher.h"
+#include "frame_pipeline.h"
+#include "hud_stats.h"
 #include "input.h"
+#include "input_recorder.h"
+#include "job_system.h"
+#include "material_table.h"
 #include "normal_mapping_utils.h"
+#include "shader_cache.h"
+#include "shadow_map.h"
+#include "synthetic_city.h"
+#include "synthetic_input.h"
+#include "text_buffer.h"
+#include "timer.h"
+#include "world_position.h"
 
 //-----------------------------------------------------------------------------
 // Macros.
@@ -73,19 +106,18 @@
 
 #define APP_TITLE "D3D Vector Camera Demo"
 
-const D3DXVECTOR3 CAMERA_ACCELERATION(8.0f, 8.0f, 8.0f);
-const float       CAMERA_FOVX = 90.0f;
-const D3DXVECTOR3 CAMERA_POS(0.0f, 1.0f, 0.0f);
-const float       CAMERA_SPEED_ROTATION = 0.2f;
-const float       CAMERA_SPEED_FLIGHT_YAW = 100.0f;
-const D3DXVECTOR3 CAMERA_VELOCITY(2.0f, 2.0f, 2.0f);
-const float       CAMERA_ZFAR = 100.0f;
-const float       CAMERA_ZNEAR = 0.1f;
-
-const float       FLOOR_WIDTH = 16.0f;
-const float       FLOOR_HEIGHT = 16.0f;
+const float       CAMERA_TRACK_ANGLE_TOLERANCE = 0.25f;
+const float       CAMERA_TRACK_POSITION_TOLERANCE = 0.01f;
+
+const char        COLOR_MAP_FILENAME[] = "wood_color_map.jpg";
+
+const int         DEFAULT_FRAME_LATENCY = 2;
+const int         MAX_FRAME_LATENCY = 3;
+
 const float       FLOOR_TILE_U = 8.0f;
 const float       FLOOR_TILE_V = 8.0f;
+const D3DXVECTOR3 FLOOR_BOUNDS_CENTER(0.0f, 0.0f, 0.0f);
+const float       FLOOR_BOUNDS_RADIUS = 0.5f * sqrtf(FLOOR_WIDTH * FLOOR_WIDTH + FLOOR_HEIGHT * FLOOR_HEIGHT);
 
 const float       LIGHT_RADIUS = max(FLOOR_WIDTH, FLOOR_HEIGHT);
 const float       LIGHT_SPOT_INNER_CONE = D3DXToRadian(30.0f);
@@ -93,10 +125,72 @@ const float       LIGHT_SPOT_OUTER_CONE = D3DXToRadian(100.0f);
 const D3DXVECTOR3 LIGHT_DIR(0.0f, -1.0f, 0.0f);
 const D3DXVECTOR3 LIGHT_POS(0.0f, LIGHT_RADIUS * 0.5f, 0.0f);
 
+const int         DEFERRED_POINT_LIGHTS = 32;
+const float       DEFERRED_POINT_LIGHT_HEIGHT = 0.5f;
+const float       DEFERRED_POINT_LIGHT_RADIUS = 3.0f;
+
+const int         MAX_MATERIALS = 4096;
+const int         MATERIAL_TEXELS = sizeof(PackedMaterial) / 16;
+const UINT        MATERIAL_EFFECT_SIZE = offsetof(PackedMaterial, textureSet);
+
+const char        SHADER_FILENAME[] = "normal_mapping.fx";
+const char        SHADER_CACHE_DIRECTORY[] = "shader_cache";
+const DWORD       SHADER_EFFECT_FLAGS = D3DXFX_NOT_CLONEABLE;
+
+const int         SHADOW_ATLAS_SIZE = 2048;
+const int         SHADOW_MAP_SIZE = 1024;
+const float       SHADOW_BIAS = 0.0005f;
+const float       SHADOW_ZNEAR = 0.5f;
+const int         SHADOW_SPOT_LIGHT_ID = 0;
+
+const char        HELP_TEXT[] =
+    "First Person behavior\n"
+    "  Press W and S to move forwards and backwards\n"
+    "  Press A and D to strafe left and right\n"
+    "  Press E and Q to move up and down\n"
+    "  Move mouse to free look\n"
+    "\n"
+    "Flight behavior\n"
+    "  Press W and S to move forwards and backwards\n"
+    "  Press A and D to yaw left and right\n"
+    "  Press E and Q to move up and down\n"
+    "  Move mouse up and down to change pitch\n"
+    "  Move mouse left and right to change roll\n"
+    "\n"
+    "Orbit and Follow behaviors\n"
+    "  Press W and S to zoom in and out\n"
+    "  Press A, D, E and Q to move the orbit target (orbit only)\n"
+    "  Move mouse to swing around the target\n"
+    "\n"
+    "Press M to enable/disable mouse smoothing\n"
+    "Press T to enable/disable the floor color map texture\n"
+    "Press + and - to change camera rotation speed\n"
+    "Press , and . to change mouse sensitivity\n"
+    "Press SPACE to toggle between first person and flight behaviors\n"
+    "Press C to cycle through the first person, orbit and follow behaviors\n"
+    "Press P to enable/disable camera motion prediction\n"
+    "Press V to cycle through the single, stereo, split screen and cube map views\n"
+    "Press ALT and ENTER to toggle full screen\n"
+    "Press ESC to exit\n"
+    "\n"
+    "Press H to hide help";
+
 //-----------------------------------------------------------------------------
 // Types.
 //-----------------------------------------------------------------------------
 
+// A batch of changed assets. ReloadAssetsThreadProc() compiles the effect
+// and reads the textures' files on a background thread, and UpdateAssets()
+// then swaps the new effect and textures in between frames. data[i] holds
+// the compiled effect or the file's contents for assets[i], and is empty if
+// that failed.
+struct AssetReload
+{
+    std::vector<int> assets;
+    std::vector<std::vector<char> > data;
+    std::string errors;
+};
+
 struct Light
 {
     float dir[3];
@@ -109,13 +203,32 @@ struct Light
     float radius;
 };
 
-struct Material
+// The textures a material refers to by its texture set index.
+struct MaterialTextureSet
 {
-    float ambient[4];
-    float diffuse[4];
-    float emissive[4];
-    float specular[4];
-    float shininess;
+    IDirect3DTexture9 *pColorMap;
+    IDirect3DTexture9 *pNormalMap;
+};
+
+// Everything RenderFrame() needs to draw one frame. SimulateFrame() fills one
+// of these in on a worker thread while the previous one is rendered.
+struct FrameState
+{
+    D3DXMATRIX viewMatrix;
+    D3DXMATRIX projectionMatrix;
+    D3DXMATRIX viewProjectionMatrix;
+    D3DXMATRIX previousViewProjectionMatrix;
+    D3DXVECTOR3 cameraPos;
+    D3DXMATRIX floorWorldMatrix;
+    D3DXVECTOR3 floorBoundsCenter;
+    D3DXMATRIX shadowViewProjectionMatrix;
+    bool floorCastsShadow;
+    LightList lights;
+    CameraSet cameraSet;
+    Light light;
+    DrawQueue draws;
+    float globalAmbient[4];
+    HudStats stats;
 };
 
 //-----------------------------------------------------------------------------
@@ -128,28 +241,92 @@ D3DPRESENT_PARAMETERS        g_params;
 IDirect3D9                  *g_pDirect3D;
 IDirect3DDevice9            *g_pDevice;
 ID3DXFont                   *g_pFont;
+ID3DXSprite                 *g_pTextSprite;
 ID3DXEffect                 *g_pEffect;
 IDirect3DVertexDeclaration9 *g_pFloorVertexDeclaration;
 IDirect3DVertexBuffer9      *g_pFloorVertexBuffer;
 IDirect3DTexture9           *g_pNullTexture;
 IDirect3DTexture9           *g_pColorMapTexture;
 IDirect3DTexture9           *g_pNormalMapTexture;
+IDirect3DTexture9           *g_pMaterialTableTexture;
+IDirect3DTexture9           *g_pShadowAtlasTexture;
+IDirect3DSurface9           *g_pShadowAtlasDepthSurface;
+IDirect3DTexture9           *g_pGBufferTextures[GBUFFER_TARGET_COUNT];
+IDirect3DSurface9           *g_pGBufferDepthSurface;
+IDirect3DVertexDeclaration9 *g_pFullScreenVertexDeclaration;
+IDirect3DQuery9             *g_pFrameQueries[MAX_FRAME_LATENCY];
+bool                         g_frameQueryIssued[MAX_FRAME_LATENCY];
+int                          g_frameQueryIndex;
+int                          g_maxFrameLatency = DEFAULT_FRAME_LATENCY;
+int                          g_jobThreadCount = -1;
+bool                         g_pinJobThreads;
 bool                         g_enableVerticalSync;
 bool                         g_isFullScreen;
 bool                         g_hasFocus;
 bool                         g_displayHelp;
 bool                         g_disableColorMapTexture;
+bool                         g_normalMapReconstructZ;
 bool                         g_flightModeEnabled;
+bool                         g_enableShadows;
+bool                         g_enableDeferred;
+bool                         g_enableShaderCache = true;
+bool                         g_enableHotReload;
+bool                         g_pollAssets;
+bool                         g_shaderCacheHit;
+bool                         g_assetReloadFailed;
+float                        g_shaderLoadMs;
 DWORD                        g_msaaSamples;
 DWORD                        g_maxAnisotrophy;
 int                          g_framesPerSecond;
+float                        g_inputLatencyMs;
 int                          g_windowWidth;
 int                          g_windowHeight;
+int                          g_gBufferWidth;
+int                          g_gBufferHeight;
 NormalMappedQuad             g_floorQuad;
 Camera                       g_camera;
-D3DXVECTOR3                  g_cameraBoundsMax;
-D3DXVECTOR3                  g_cameraBoundsMin;
+Camera::DepthMode            g_depthMode = Camera::DEPTH_MODE_STANDARD;
+CameraSet                    g_cameraSet;
+CameraPredictor              g_cameraPredictor;
+CameraRig                    g_cameraRig;
+float                        g_followSubjectTimeSec;
+bool                         g_enablePrediction = true;
+SectorPosition               g_scenePosition = ToSectorPosition(WorldPosition());
+bool                         g_largeWorld;
+int                          g_floorMaterial;
+int                          g_boundMaterial = -1;
+ActionMap                    g_actionMap;
+CameraController             g_cameraController;
 float                        g_globalAmbient[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+InputEventQueue              g_inputEvents;
+InputRecorder                g_inputRecorder;
+InputPlayback                g_inputPlayback;
+double                       g_playbackStartTime;
+std::string                  g_cameraStateFilename;
+CameraTrack                  g_cameraTrack;
+std::string                  g_cameraTrackFilename;
+std::string                  g_normalMapFilename = "wood_normal_map.jpg";
+bool                         g_isRecordingCameraTrack;
+bool                         g_isPlayingCameraTrack;
+float                        g_cameraTrackTime;
+double                       g_cameraTrackStartTime;
+int                          g_cameraTrackFrames;
+JobSystem                    g_jobSystem;
+FramePipeline                g_framePipeline;
+FrameState                   g_frameStates[2];
+ShadowAtlas                  g_shadowAtlas;
+ShadowCasterCuller           g_shadowCasterCuller;
+std::vector<DeferredLight>   g_deferredLights;
+MaterialTable                g_materialTable;
+std::vector<MaterialTextureSet> g_materialTextureSets;
+ShaderCache                  g_shaderCache;
+FileWatcher                  g_assetWatcher;
+AssetReload                  g_assetReload;
+HANDLE                       g_hAssetReloadThread;
+int                          g_shaderAsset = -1;
+int                          g_colorMapAsset = -1;
+int                          g_normalMapAsset = -1;
+int                          g_assetReloadCount;
 
 Light g_light =
 {
@@ -163,51 +340,88 @@ Light g_light =
     LIGHT_RADIUS                                // radius
 };
 
-Material g_material =
+const PackedMaterial FLOOR_MATERIAL =
 {
     0.2f, 0.2f, 0.2f, 1.0f,                     // ambient
     0.8f, 0.8f, 0.8f, 1.0f,                     // diffuse
     0.0f, 0.0f, 0.0f, 1.0f,                     // emissive
     0.0f, 0.0f, 0.0f, 1.0f,                     // specular
-    0.0f                                        // shininess
+    0.0f,                                       // shininess
+    0.0f,                                       // textureSet
+    0.0f, 0.0f                                  // reserved
 };
 
 //-----------------------------------------------------------------------------
 // Function Prototypes.
 //-----------------------------------------------------------------------------
 
+void    BindMaterial(int material);
+void    CameraTrackFinished();
 void    ChooseBestMSAAMode(D3DFORMAT backBufferFmt, D3DFORMAT depthStencilFmt,
                            BOOL windowed, D3DMULTISAMPLE_TYPE &type,
                            DWORD &qualityLevels, DWORD &samplesPerPixel);
 void    Cleanup();
 void    CleanupApp();
 HWND    CreateAppWindow(const WNDCLASSEX &wcl, const char *pszTitle);
+bool    CreateEffect(const std::vector<char> &compiled, LPD3DXEFFECT &pEffect);
+void    CreateFrameQueries();
+bool    CreateGBuffer();
+bool    CreateMaterialTable();
 bool    CreateNullTexture(int width, int height, LPDIRECT3DTEXTURE9 &pTexture);
+bool    CreateShadowMap();
+void    CycleCameraMode();
 bool    DeviceIsValid();
+void    DrawFullScreenQuad();
 float   GetElapsedTimeInSeconds();
-void    GetMovementDirection(D3DXVECTOR3 &direction);
 bool    Init();
 void    InitApp();
+void    InitCamera(Camera &camera);
+void    InitCameraController();
 bool    InitD3D();
+void    InitDeferredLights();
 void    InitFloor();
 bool    InitFont(const char *pszFont, int ptSize, LPD3DXFONT &pFont);
+bool    IsTwoChannelNormalMap(IDirect3DTexture9 *pTexture);
+void    LimitFrameLatency();
 bool    LoadShader(const char *pszFilename, LPD3DXEFFECT &pEffect);
 void    Log(const char *pszMessage);
+void    ParseCommandLine(const char *pszCmdLine);
 bool    MSAAModeSupported(D3DMULTISAMPLE_TYPE type, D3DFORMAT backBufferFmt,
                           D3DFORMAT depthStencilFmt, BOOL windowed,
                           DWORD &qualityLevels);
-void    PerformCameraCollisionDetection();
+void    PlaybackFinished();
 void    ProcessUserInput();
-void    RenderFloor();
-void    RenderFrame();
-void    RenderText();
+void    RenderFloor(const char *pszTechnique);
+void    RecordInput(float elapsedTimeSec);
+void    ReleaseFrameQueries();
+void    ReleaseGBuffer();
+void    ReleaseShadowMap();
+unsigned int __stdcall ReloadAssetsThreadProc(void *pArg);
+void    RenderDeferredView(const FrameState &frame, const CameraView &view,
+                           const D3DVIEWPORT9 &viewport);
+void    RenderDraws(const DrawQueue &draws, const char *pszTechnique);
+void    RenderFrame(const FrameState &frame);
+void    RenderShadowMaps(const FrameState &frame);
+void    RenderText(const FrameState &frame);
+void    RenderViews(const FrameState &frame);
+void    ReplaceTexture(IDirect3DTexture9 *&pTexture, IDirect3DTexture9 *pNewTexture);
 bool    ResetDevice();
-void    SetProcessorAffinity();
+void    SaveFinalCameraState();
+void    SetFirstPersonBehavior();
+void    SimulateFrame(int slot, float elapsedTimeSec);
+void    ToggleFlightMode();
 void    ToggleFullScreen();
+void    UpdateAssets();
 void    UpdateCamera(float elapsedTimeSec);
-void    UpdateEffect();
+void    UpdateEffect(const FrameState &frame);
+void    UpdateEffectView(const FrameState &frame, const CameraView &view);
 void    UpdateFrame(float elapsedTimeSec);
 void    UpdateFrameRate(float elapsedTimeSec);
+void    UpdateFrameState(FrameState &frame, float elapsedTimeSec);
+void    UpdateInputFromPlayback(float &elapsedTimeSec);
+void    UpdateInputLatency();
+void    UploadMaterials(void *pContext, int first, int count,
+                        const PackedMaterial *pMaterials);
 LRESULT CALLBACK WindowProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
 
 //-----------------------------------------------------------------------------
@@ -225,6 +439,8 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     MSG msg = {0};
     WNDCLASSEX wcl = {0};
 
+    ParseCommandLine(lpCmdLine);
+
     wcl.cbSize = sizeof(wcl);
     wcl.style = CS_OWNDC | CS_HREDRAW | CS_VREDRAW;
     wcl.lpfnWndProc = WindowProc;
@@ -245,8 +461,6 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 
     if (g_hWnd)
     {
-        SetProcessorAffinity();
-
         if (Init())
         {
             ShowWindow(g_hWnd, nShowCmd);
@@ -254,6 +468,12 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 
             while (true)
             {
+                // The simulation job may still be working on the frame
+                // kicked off last time around. Wait for it before handling
+                // any window messages since these can change the camera.
+
+                g_framePipeline.wait();
+
                 while (PeekMessage(&msg, 0, 0, 0, PM_REMOVE))
                 {
                     if (msg.message == WM_QUIT)
@@ -266,12 +486,24 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
                 if (msg.message == WM_QUIT)
                     break;
 
-                if (g_hasFocus)
+                // Recorded input is replayed as fast as possible even when
+                // the window doesn't have the input focus.
+
+                if (g_hasFocus || g_inputPlayback.isOpen())
                 {
                     UpdateFrame(GetElapsedTimeInSeconds());
 
-                    if (DeviceIsValid())
-                        RenderFrame();
+                    // When pipelined this renders the previous frame while
+                    // the simulation job works on the new one. Reloaded
+                    // assets are only ever swapped in between frames.
+
+                    if (g_framePipeline.hasFrame() && DeviceIsValid())
+                    {
+                        if (g_enableHotReload)
+                            UpdateAssets();
+
+                        RenderFrame(g_frameStates[g_framePipeline.readSlot()]);
+                    }
                 }
                 else
                 {
@@ -328,6 +560,51 @@ LRESULT CALLBACK WindowProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
     return DefWindowProc(hWnd, msg, wParam, lParam);
 }
 
+void BindMaterial(int material)
+{
+    // Sets a material's constants and textures. Draws are sorted by
+    // material, so this only reaches the effect once per material per view.
+    // The material's first MATERIAL_EFFECT_SIZE bytes are laid out the same
+    // as the effect's Material struct.
+
+    if (material == g_boundMaterial)
+        return;
+
+    const PackedMaterial &packed = g_materialTable.getMaterial(material);
+    const MaterialTextureSet &textures = g_materialTextureSets[static_cast<int>(packed.textureSet)];
+
+    g_pEffect->SetValue("material", &packed, MATERIAL_EFFECT_SIZE);
+    g_pEffect->SetFloat("materialIndex", static_cast<float>(material));
+
+    if (g_disableColorMapTexture)
+        g_pEffect->SetTexture("colorMapTexture", g_pNullTexture);
+    else
+        g_pEffect->SetTexture("colorMapTexture", textures.pColorMap);
+
+    g_pEffect->SetTexture("normalMapTexture", textures.pNormalMap);
+    g_boundMaterial = material;
+}
+
+void CameraTrackFinished()
+{
+    // Report how quickly the camera track was played back and then exit.
+
+    std::ostringstream msg;
+    double elapsedTimeSec = GetTimeInSeconds() - g_cameraTrackStartTime;
+
+    g_isPlayingCameraTrack = false;
+
+    msg << "Played back " << g_cameraTrack.endTime() << " seconds of camera track ("
+        << g_cameraTrack.keyCount() << " keyframes) in " << g_cameraTrackFrames
+        << " frames";
+
+    if (elapsedTimeSec > 0.0)
+        msg << " (" << g_cameraTrackFrames / elapsedTimeSec << " frames/sec)";
+
+    MessageBox(g_hWnd, msg.str().c_str(), "Camera Track", MB_ICONINFORMATION);
+    PostMessage(g_hWnd, WM_CLOSE, 0, 0);
+}
+
 void ChooseBestMSAAMode(D3DFORMAT backBufferFmt, D3DFORMAT depthStencilFmt,
                         BOOL windowed, D3DMULTISAMPLE_TYPE &type,
                         DWORD &qualityLevels, DWORD &samplesPerPixel)
@@ -379,8 +656,25 @@ void ChooseBestMSAAMode(D3DFORMAT backBufferFmt, D3DFORMAT depthStencilFmt,
 
 void Cleanup()
 {
+    g_framePipeline.destroy();
+    g_jobSystem.destroy();
+    SaveFinalCameraState();
+
+    if (g_isRecordingCameraTrack)
+    {
+        g_isRecordingCameraTrack = false;
+        g_cameraTrack.compress(CAMERA_TRACK_POSITION_TOLERANCE, CAMERA_TRACK_ANGLE_TOLERANCE);
+
+        if (!g_cameraTrack.save(g_cameraTrackFilename.c_str()))
+            Log("Failed to save the camera track.");
+    }
+
     CleanupApp();
+    ReleaseFrameQueries();
+    ReleaseShadowMap();
+    ReleaseGBuffer();
    
+    SAFE_RELEASE(g_pTextSprite);
     SAFE_RELEASE(g_pFont);
     SAFE_RELEASE(g_pDevice);
     SAFE_RELEASE(g_pDirect3D);
@@ -388,7 +682,20 @@ void Cleanup()
 
 void CleanupApp()
 {
+    if (g_hAssetReloadThread)
+    {
+        WaitForSingleObject(g_hAssetReloadThread, INFINITE);
+        CloseHandle(g_hAssetReloadThread);
+        g_hAssetReloadThread = 0;
+    }
+
+    g_assetWatcher.destroy();
+    g_shaderCache.destroy();
+    g_materialTable.destroy();
+    g_materialTextureSets.clear();
+
     SAFE_RELEASE(g_pEffect);
+    SAFE_RELEASE(g_pMaterialTableTexture);
     SAFE_RELEASE(g_pColorMapTexture);
     SAFE_RELEASE(g_pNormalMapTexture);
     SAFE_RELEASE(g_pNullTexture);
@@ -430,6 +737,136 @@ HWND CreateAppWindow(const WNDCLASSEX &wcl, const char *pszTitle)
     return hWnd;
 }
 
+bool CreateEffect(const std::vector<char> &compiled, LPD3DXEFFECT &pEffect)
+{
+    // Creates an effect from one compiled by CompileEffect(). This is cheap
+    // compared to compiling it, but needs the device.
+
+    HRESULT hr = D3DXCreateEffect(g_pDevice, &compiled[0], static_cast<UINT>(compiled.size()),
+                    0, 0, SHADER_EFFECT_FLAGS, 0, &pEffect, 0);
+
+    return SUCCEEDED(hr) && pEffect != 0;
+}
+
+void CreateFrameQueries()
+{
+    // Event queries aren't supported by every driver. Without them the
+    // number of frames the driver queues up simply isn't limited.
+
+    for (int i = 0; i < MAX_FRAME_LATENCY; ++i)
+    {
+        if (FAILED(g_pDevice->CreateQuery(D3DQUERYTYPE_EVENT, &g_pFrameQueries[i])))
+            g_pFrameQueries[i] = 0;
+
+        g_frameQueryIssued[i] = false;
+    }
+
+    g_frameQueryIndex = 0;
+}
+
+bool CreateGBuffer()
+{
+    // The G-buffer's render targets are the size of the back buffer. Each
+    // one uses the first of its formats (see GBufferFormat()) the card can
+    // render to. The G-buffer has a depth buffer of its own since the back
+    // buffer's may be multisampled. Deferred shading needs 3 simultaneous
+    // render targets and shader model 3.0 for VPOS. Without either the
+    // forward techniques are used.
+
+    D3DCAPS9 caps;
+    D3DDISPLAYMODE desktop;
+    D3DSURFACE_DESC desc;
+    IDirect3DSurface9 *pBackBuffer = 0;
+
+    if (FAILED(g_pDevice->GetDeviceCaps(&caps))
+        || caps.NumSimultaneousRTs < GBUFFER_TARGET_COUNT
+        || caps.PixelShaderVersion < D3DPS_VERSION(3, 0))
+        return false;
+
+    if (FAILED(g_pDirect3D->GetAdapterDisplayMode(D3DADAPTER_DEFAULT, &desktop)))
+        return false;
+
+    if (FAILED(g_pDevice->GetBackBuffer(0, 0, D3DBACKBUFFER_TYPE_MONO, &pBackBuffer)))
+        return false;
+
+    pBackBuffer->GetDesc(&desc);
+    pBackBuffer->Release();
+
+    g_gBufferWidth = static_cast<int>(desc.Width);
+    g_gBufferHeight = static_cast<int>(desc.Height);
+
+    for (int i = 0; i < GBUFFER_TARGET_COUNT; ++i)
+    {
+        GBufferTarget target = static_cast<GBufferTarget>(i);
+        D3DFORMAT format = D3DFMT_UNKNOWN;
+
+        for (int preference = 0; (format = GBufferFormat(target, preference)) != D3DFMT_UNKNOWN; ++preference)
+        {
+            if (FAILED(g_pDirect3D->CheckDeviceFormat(D3DADAPTER_DEFAULT,
+                    D3DDEVTYPE_HAL, desktop.Format, D3DUSAGE_RENDERTARGET,
+                    D3DRTYPE_TEXTURE, format)))
+                continue;
+
+            if (SUCCEEDED(g_pDevice->CreateTexture(desc.Width, desc.Height, 1,
+                    D3DUSAGE_RENDERTARGET, format, D3DPOOL_DEFAULT, &g_pGBufferTextures[i], 0)))
+                break;
+        }
+
+        if (!g_pGBufferTextures[i])
+        {
+            ReleaseGBuffer();
+            return false;
+        }
+    }
+
+    if (FAILED(g_pDevice->CreateDepthStencilSurface(desc.Width, desc.Height,
+            D3DFMT_D24S8, D3DMULTISAMPLE_NONE, 0, TRUE, &g_pGBufferDepthSurface, 0)))
+    {
+        ReleaseGBuffer();
+        return false;
+    }
+
+    D3DVERTEXELEMENT9 fullScreenVertexElements[] =
+    {
+        {0, 0, D3DDECLTYPE_FLOAT2, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_POSITION, 0},
+        D3DDECL_END()
+    };
+
+    if (FAILED(g_pDevice->CreateVertexDeclaration(fullScreenVertexElements,
+            &g_pFullScreenVertexDeclaration)))
+    {
+        ReleaseGBuffer();
+        return false;
+    }
+
+    return true;
+}
+
+bool CreateMaterialTable()
+{
+    // Adds the floor's material to the material table. The renderer's copy
+    // of the table is a floating point texture with a row of MATERIAL_TEXELS
+    // texels per material, which the deferred lighting passes read the
+    // materials from. It's a managed texture, so it survives device resets.
+    // Without it there's no deferred shading.
+
+    MaterialTextureSet woodTextures = {g_pColorMapTexture, g_pNormalMapTexture};
+
+    g_materialTextureSets.clear();
+    g_materialTextureSets.push_back(woodTextures);
+
+    if (!g_materialTable.create(MAX_MATERIALS))
+        return false;
+
+    g_floorMaterial = g_materialTable.add(FLOOR_MATERIAL);
+
+    if (FAILED(g_pDevice->CreateTexture(MATERIAL_TEXELS, MAX_MATERIALS, 1, 0,
+            D3DFMT_A32B32G32R32F, D3DPOOL_MANAGED, &g_pMaterialTableTexture, 0)))
+        g_pMaterialTableTexture = 0;
+
+    return true;
+}
+
 bool CreateNullTexture(int width, int height, LPDIRECT3DTEXTURE9 &pTexture)
 {
     // Create an empty white texture. This texture is applied to geometry
@@ -475,6 +912,61 @@ bool CreateNullTexture(int width, int height, LPDIRECT3DTEXTURE9 &pTexture)
     return false;
 }
 
+bool CreateShadowMap()
+{
+    // The shadow atlas is a 32-bit floating point render target with a depth
+    // buffer of its own. The shadowed technique needs shader model 3.0 for
+    // its shadow map lookups. Without either there are no shadows.
+
+    D3DCAPS9 caps;
+
+    if (FAILED(g_pDevice->GetDeviceCaps(&caps)) || caps.PixelShaderVersion < D3DPS_VERSION(3, 0))
+        return false;
+
+    if (FAILED(g_pDevice->CreateTexture(SHADOW_ATLAS_SIZE, SHADOW_ATLAS_SIZE, 1,
+            D3DUSAGE_RENDERTARGET, D3DFMT_R32F, D3DPOOL_DEFAULT, &g_pShadowAtlasTexture, 0)))
+        return false;
+
+    if (FAILED(g_pDevice->CreateDepthStencilSurface(SHADOW_ATLAS_SIZE, SHADOW_ATLAS_SIZE,
+            D3DFMT_D24S8, D3DMULTISAMPLE_NONE, 0, TRUE, &g_pShadowAtlasDepthSurface, 0)))
+    {
+        SAFE_RELEASE(g_pShadowAtlasTexture);
+        return false;
+    }
+
+    // A new texture holds none of the shadow maps cached in the atlas.
+    g_shadowAtlas.invalidate(-1);
+    return true;
+}
+
+void CycleCameraMode()
+{
+    // First person, orbit, follow, and back to first person. Flight mode
+    // moves on to orbit mode. The camera rig eases the camera from wherever
+    // it is to where the new mode puts it.
+
+    g_cameraPredictor.reset();
+    g_flightModeEnabled = false;
+
+    switch (g_camera.getBehavior())
+    {
+    case Camera::CAMERA_BEHAVIOR_FIRST_PERSON:
+    case Camera::CAMERA_BEHAVIOR_FLIGHT:
+        g_camera.setBehavior(Camera::CAMERA_BEHAVIOR_ORBIT);
+        break;
+
+    case Camera::CAMERA_BEHAVIOR_ORBIT:
+        g_camera.setBehavior(Camera::CAMERA_BEHAVIOR_FOLLOW);
+        break;
+
+    default:
+        SetFirstPersonBehavior();
+        break;
+    }
+
+    g_cameraRig.reset(g_camera);
+}
+
 bool DeviceIsValid()
 {
     HRESULT hr = g_pDevice->TestCooperativeLevel();
@@ -488,35 +980,49 @@ bool DeviceIsValid()
     return true;
 }
 
+void DrawFullScreenQuad()
+{
+    // Two triangles covering the current viewport. Called between an effect
+    // pass's BeginPass() and EndPass().
+
+    static const float vertices[] =
+    {
+        -1.0f, -1.0f,
+        -1.0f,  1.0f,
+         1.0f, -1.0f,
+         1.0f,  1.0f
+    };
+
+    g_pDevice->SetVertexDeclaration(g_pFullScreenVertexDeclaration);
+    g_pDevice->DrawPrimitiveUP(D3DPT_TRIANGLESTRIP, 2, vertices, 2 * sizeof(float));
+}
+
 float GetElapsedTimeInSeconds()
 {
     // Returns the elapsed time (in seconds) since the last time this function
     // was called. This elaborate setup is to guard against large spikes in
-    // the time returned by QueryPerformanceCounter().
+    // the time returned by QueryPerformanceCounter(). GetTimeInSeconds()
+    // never goes backwards so the main thread no longer needs to be pinned
+    // to a single processor.
 
     static const int MAX_SAMPLE_COUNT = 50;
 
     static float frameTimes[MAX_SAMPLE_COUNT];
-    static float timeScale = 0.0f;
     static float actualElapsedTimeSec = 0.0f;
-    static INT64 freq = 0;
-    static INT64 lastTime = 0;
+    static double lastTime = 0.0;
     static int sampleCount = 0;
     static bool initialized = false;
 
-    INT64 time = 0;
+    double time = GetTimeInSeconds();
     float elapsedTimeSec = 0.0f;
 
     if (!initialized)
     {
         initialized = true;
-        QueryPerformanceFrequency(reinterpret_cast<LARGE_INTEGER*>(&freq));
-        QueryPerformanceCounter(reinterpret_cast<LARGE_INTEGER*>(&lastTime));
-        timeScale = 1.0f / freq;
+        lastTime = time;
     }
 
-    QueryPerformanceCounter(reinterpret_cast<LARGE_INTEGER*>(&time));
-    elapsedTimeSec = (time - lastTime) * timeScale;
+    elapsedTimeSec = static_cast<float>(time - lastTime);
     lastTime = time;
 
     if (fabsf(elapsedTimeSec - actualElapsedTimeSec) < 1.0f)
@@ -539,111 +1045,6 @@ float GetElapsedTimeInSeconds()
     return actualElapsedTimeSec;
 }
 
-void GetMovementDirection(D3DXVECTOR3 &direction)
-{
-    static bool moveForwardsPressed = false;
-    static bool moveBackwardsPressed = false;
-    static bool moveRightPressed = false;
-    static bool moveLeftPressed = false;
-    static bool moveUpPressed = false;
-    static bool moveDownPressed = false;
-
-    D3DXVECTOR3 velocity = g_camera.getCurrentVelocity();
-    Keyboard &keyboard = Keyboard::instance();
-
-    direction.x = direction.y = direction.z = 0.0f;
-
-    if (keyboard.keyDown(Keyboard::KEY_UP) || keyboard.keyDown(Keyboard::KEY_W))
-    {
-        if (!moveForwardsPressed)
-        {
-            moveForwardsPressed = true;
-            g_camera.setCurrentVelocity(velocity.x, velocity.y, 0.0f);
-        }
-
-        direction.z += 1.0f;
-    }
-    else
-    {
-        moveForwardsPressed = false;
-    }
-
-    if (keyboard.keyDown(Keyboard::KEY_DOWN) || keyboard.keyDown(Keyboard::KEY_S))
-    {
-        if (!moveBackwardsPressed)
-        {
-            moveBackwardsPressed = true;
-            g_camera.setCurrentVelocity(velocity.x, velocity.y, 0.0f);
-        }
-
-        direction.z -= 1.0f;
-    }
-    else
-    {
-        moveBackwardsPressed = false;
-    }
-
-    if (keyboard.keyDown(Keyboard::KEY_RIGHT) || keyboard.keyDown(Keyboard::KEY_D))
-    {
-        if (!moveRightPressed)
-        {
-            moveRightPressed = true;
-            g_camera.setCurrentVelocity(0.0f, velocity.y, velocity.z);
-        }
-
-        direction.x += 1.0f;
-    }
-    else
-    {
-        moveRightPressed = false;
-    }
-
-    if (keyboard.keyDown(Keyboard::KEY_LEFT) || keyboard.keyDown(Keyboard::KEY_A))
-    {
-        if (!moveLeftPressed)
-        {
-            moveLeftPressed = true;
-            g_camera.setCurrentVelocity(0.0f, velocity.y, velocity.z);
-        }
-
-        direction.x -= 1.0f;
-    }
-    else
-    {
-        moveLeftPressed = false;
-    }
-
-    if (keyboard.keyDown(Keyboard::KEY_E) || keyboard.keyDown(Keyboard::KEY_PAGEUP))
-    {
-        if (!moveUpPressed)
-        {
-            moveUpPressed = true;
-            g_camera.setCurrentVelocity(velocity.x, 0.0f, velocity.z);
-        }
-
-        direction.y += 1.0f;
-    }
-    else
-    {
-        moveUpPressed = false;
-    }
-
-    if (keyboard.keyDown(Keyboard::KEY_Q) || keyboard.keyDown(Keyboard::KEY_PAGEDOWN))
-    {
-        if (!moveDownPressed)
-        {
-            moveDownPressed = true;
-            g_camera.setCurrentVelocity(velocity.x, 0.0f, velocity.z);
-        }
-
-        direction.y -= 1.0f;
-    }
-    else
-    {
-        moveDownPressed = false;
-    }
-}
-
 bool Init()
 {
     if (!InitD3D())
@@ -676,48 +1077,132 @@ void InitApp()
     if (!InitFont("Arial", 10, g_pFont))
         throw std::runtime_error("Failed to create font.");
 
+    // Rasterize the printable ASCII glyphs into the font's texture atlas up
+    // front so that the first frames don't stall on glyph creation.
+    g_pFont->PreloadCharacters(32, 126);
+
+    // All of the on screen text is batched through a single sprite so that
+    // it's submitted as one draw call rather than one per DrawText() call.
+    if (FAILED(D3DXCreateSprite(g_pDevice, &g_pTextSprite)))
+        throw std::runtime_error("Failed to create text sprite.");
+
     // Setup textures.
 
     if (!CreateNullTexture(2, 2, g_pNullTexture))
         throw std::runtime_error("Failed to create null texture.");
 
     if (FAILED(D3DXCreateTextureFromFile(g_pDevice,
-            "wood_color_map.jpg", &g_pColorMapTexture)))
-        throw std::runtime_error("Failed to load texture: wood_color_map.jpg.");
+            COLOR_MAP_FILENAME, &g_pColorMapTexture)))
+        throw std::runtime_error(std::string("Failed to load texture: ") + COLOR_MAP_FILENAME + ".");
     
     if (FAILED(D3DXCreateTextureFromFile(g_pDevice,
-            "wood_normal_map.jpg", &g_pNormalMapTexture)))
-        throw std::runtime_error("Failed to load texture: wood_normal_map.jpg.");
+            g_normalMapFilename.c_str(), &g_pNormalMapTexture)))
+        throw std::runtime_error("Failed to load texture: " + g_normalMapFilename + ".");
 
-    // Setup shader.
+    g_normalMapReconstructZ = IsTwoChannelNormalMap(g_pNormalMapTexture);
 
-    if (!LoadShader("normal_mapping.fx", g_pEffect))
-        throw std::runtime_error("Failed to load shader: normal_mapping.fx.");
+    // Setup shader. Without the shader cache the effect is compiled from
+    // source on every start.
+
+    if (g_enableShaderCache)
+        g_shaderCache.create(SHADER_CACHE_DIRECTORY);
+
+    if (!LoadShader(SHADER_FILENAME, g_pEffect))
+        throw std::runtime_error(std::string("Failed to load shader: ") + SHADER_FILENAME + ".");
+
+    // Setup materials.
+
+    if (!CreateMaterialTable())
+        throw std::runtime_error("Failed to create the material table.");
+
+    // Setup hot reloading of the effect and the floor's textures.
+
+    if (g_enableHotReload)
+    {
+        g_shaderAsset = g_assetWatcher.add(SHADER_FILENAME);
+        g_colorMapAsset = g_assetWatcher.add(COLOR_MAP_FILENAME);
+        g_normalMapAsset = g_assetWatcher.add(g_normalMapFilename.c_str());
+        g_assetWatcher.create(g_pollAssets);
+    }
+
+    // Setup input. Key bindings.
+
+    InitActionMap(g_actionMap);
+
+    // Both devices report their timestamped events to the same
+    // queue. UpdateInputLatency() consumes them once the camera is updated.
+
+    Keyboard::instance().setEventQueue(&g_inputEvents);
+    Mouse::instance().setEventQueue(&g_inputEvents);
 
     // Setup camera.
 
+    g_camera.setDepthMode(g_depthMode);
     g_camera.perspective(CAMERA_FOVX,
         static_cast<float>(g_windowWidth) / static_cast<float>(g_windowHeight),
         CAMERA_ZNEAR, CAMERA_ZFAR);
 
-    g_camera.setBehavior(Camera::CAMERA_BEHAVIOR_FIRST_PERSON);
-    g_camera.setPosition(CAMERA_POS);
-    g_camera.setAcceleration(CAMERA_ACCELERATION);
-    g_camera.setVelocity(CAMERA_VELOCITY);
+    InitCamera(g_camera);
+    InitCameraController();
 
     g_flightModeEnabled = g_camera.getBehavior() == Camera::CAMERA_BEHAVIOR_FLIGHT;
 
-    g_cameraBoundsMax.x = FLOOR_WIDTH / 2.0f;
-    g_cameraBoundsMax.y = 4.0f;
-    g_cameraBoundsMax.z = FLOOR_HEIGHT / 2.0f;
-
-    g_cameraBoundsMin.x = -FLOOR_WIDTH / 2.0f;
-    g_cameraBoundsMin.y = CAMERA_POS.y;
-    g_cameraBoundsMin.z = -FLOOR_HEIGHT / 2.0f;
-
     // Setup floor geometry.
 
     InitFloor();
+
+    // Setup the job system and the frame pipeline. The camera simulation
+    // runs as a job. A frame latency of 1 disables pipelining and runs the
+    // simulation on this thread.
+
+    if (!g_jobSystem.create(g_jobThreadCount, g_pinJobThreads))
+        throw std::runtime_error("Failed to create the job system.");
+
+    CreateFrameQueries();
+
+    // Setup shadows.
+
+    g_shadowAtlas.create(SHADOW_ATLAS_SIZE, SHADOW_MAP_SIZE);
+
+    if (g_enableShadows && !CreateShadowMap())
+        g_enableShadows = false;
+
+    // Setup deferred shading.
+
+    if (g_enableDeferred && (!g_pMaterialTableTexture || !CreateGBuffer()))
+        g_enableDeferred = false;
+
+    InitDeferredLights();
+
+    if (!g_framePipeline.create(SimulateFrame, &g_jobSystem, g_maxFrameLatency > 1))
+        throw std::runtime_error("Failed to create the frame pipeline.");
+}
+
+void InitCamera(Camera &camera)
+{
+    // In large world mode the camera's origin is the origin of the scene's
+    // sector, which keeps the camera's float position small. Otherwise the
+    // camera works in plain world coordinates.
+
+    if (g_largeWorld)
+        camera.setOrigin(SectorOrigin(g_scenePosition));
+
+    camera.setBehavior(Camera::CAMERA_BEHAVIOR_FIRST_PERSON);
+    camera.setWorldPosition(ToWorldPosition(g_scenePosition) + CAMERA_POS);
+    camera.setAcceleration(CAMERA_ACCELERATION);
+    camera.setVelocity(CAMERA_VELOCITY);
+}
+
+void InitCameraController()
+{
+    // Keep the camera above the floor.
+
+    D3DXVECTOR3 boundsMax(FLOOR_WIDTH / 2.0f, 4.0f, FLOOR_HEIGHT / 2.0f);
+    D3DXVECTOR3 boundsMin(-FLOOR_WIDTH / 2.0f, CAMERA_POS.y, -FLOOR_HEIGHT / 2.0f);
+
+    g_cameraController.setBounds(boundsMin, boundsMax);
+    g_cameraController.setBoundsOrigin(ToWorldPosition(g_scenePosition));
+    g_cameraController.setFlightYawSpeed(CAMERA_SPEED_FLIGHT_YAW);
 }
 
 bool InitD3D()
@@ -749,6 +1234,19 @@ bool InitD3D()
     g_params.Windowed = TRUE;
     g_params.EnableAutoDepthStencil = TRUE;
     g_params.AutoDepthStencilFormat = D3DFMT_D24S8;
+
+    // Reverse-Z only pays off with a floating point depth buffer. Use one if
+    // the card supports it.
+    if ((g_depthMode & Camera::DEPTH_MODE_REVERSE_Z)
+        && SUCCEEDED(g_pDirect3D->CheckDeviceFormat(D3DADAPTER_DEFAULT,
+            D3DDEVTYPE_HAL, desktop.Format, D3DUSAGE_DEPTHSTENCIL,
+            D3DRTYPE_SURFACE, D3DFMT_D24FS8))
+        && SUCCEEDED(g_pDirect3D->CheckDepthStencilMatch(D3DADAPTER_DEFAULT,
+            D3DDEVTYPE_HAL, desktop.Format, desktop.Format, D3DFMT_D24FS8)))
+    {
+        g_params.AutoDepthStencilFormat = D3DFMT_D24FS8;
+    }
+
     g_params.Flags = D3DPRESENTFLAG_DISCARD_DEPTHSTENCIL;
     g_params.FullScreen_RefreshRateInHz = 0;
 
@@ -802,6 +1300,36 @@ bool InitD3D()
     return true;
 }
 
+void InitDeferredLights()
+{
+    // Lays DEFERRED_POINT_LIGHTS small point lights of different colors out
+    // in a grid just above the floor. The positions are relative to the
+    // scene's position.
+
+    int lightsPerRow = static_cast<int>(ceilf(sqrtf(static_cast<float>(DEFERRED_POINT_LIGHTS))));
+
+    g_deferredLights.clear();
+
+    for (int i = 0; i < DEFERRED_POINT_LIGHTS; ++i)
+    {
+        DeferredLight light;
+        float hue = 2.4f * i;
+
+        light.pos.x = ((i % lightsPerRow + 0.5f) / lightsPerRow - 0.5f) * FLOOR_WIDTH;
+        light.pos.y = DEFERRED_POINT_LIGHT_HEIGHT;
+        light.pos.z = ((i / lightsPerRow + 0.5f) / lightsPerRow - 0.5f) * FLOOR_HEIGHT;
+        light.radius = DEFERRED_POINT_LIGHT_RADIUS;
+        light.dir = LIGHT_DIR;
+        light.spotCosOuterCone = -2.0f;
+        light.color.x = 0.5f + 0.5f * cosf(hue);
+        light.color.y = 0.5f + 0.5f * cosf(hue + 2.1f);
+        light.color.z = 0.5f + 0.5f * cosf(hue + 4.2f);
+        light.spotCosInnerCone = -1.0f;
+
+        g_deferredLights.push_back(light);
+    }
+}
+
 void InitFloor()
 {
     HRESULT hr = 0;
@@ -884,47 +1412,73 @@ bool InitFont(const char *pszFont, int ptSize, LPD3DXFONT &pFont)
     return SUCCEEDED(hr) ? true : false;
 }
 
-bool LoadShader(const char *pszFilename, LPD3DXEFFECT &pEffect)
+bool IsTwoChannelNormalMap(IDirect3DTexture9 *pTexture)
 {
-    ID3DXBuffer *pCompilationErrors = 0;
-    DWORD dwShaderFlags = D3DXFX_NOT_CLONEABLE | D3DXSHADER_NO_PRESHADER;
+    // Normal maps baked by camera_bench -bake only store x and y. The
+    // shaders rebuild z for them.
 
+    D3DSURFACE_DESC desc;
+
+    return SUCCEEDED(pTexture->GetLevelDesc(0, &desc)) && desc.Format == D3DFMT_G16R16;
+}
+
+void LimitFrameLatency()
+{
+    // Direct3D 9 lets the driver queue up several frames of commands ahead of
+    // the GPU, and each queued frame adds to the input latency. An event query
+    // is issued after every Present(). Before submitting a new frame we wait
+    // for the query issued g_maxFrameLatency frames ago to complete.
+
+    IDirect3DQuery9 *pQuery = g_pFrameQueries[g_frameQueryIndex];
+
+    if (!pQuery || !g_frameQueryIssued[g_frameQueryIndex])
+        return;
+
+    while (pQuery->GetData(0, 0, D3DGETDATA_FLUSH) == S_FALSE)
+        Sleep(0);
+
+    g_frameQueryIssued[g_frameQueryIndex] = false;
+}
+
+bool LoadShader(const char *pszFilename, LPD3DXEFFECT &pEffect)
+{
     // Both vertex and pixel shaders can be debugged. To enable shader
-    // debugging add the following flag to the dwShaderFlags variable:
-    //      dwShaderFlags |= D3DXSHADER_DEBUG;
+    // debugging add the following flag to SHADER_COMPILE_FLAGS:
+    //      D3DXSHADER_DEBUG
     //
     // Vertex shaders can be debugged with either the REF device or a device
     // created for software vertex processing (i.e., the IDirect3DDevice9
     // object must be created with the D3DCREATE_SOFTWARE_VERTEXPROCESSING
     // behavior). Pixel shaders can be debugged only using the REF device.
     //
-    // To enable vertex shader debugging add the following flag to the
-    // dwShaderFlags variable:
-    //     dwShaderFlags |= D3DXSHADER_FORCE_VS_SOFTWARE_NOOPT;
+    // To enable vertex shader debugging add the following flag to
+    // SHADER_COMPILE_FLAGS:
+    //      D3DXSHADER_FORCE_VS_SOFTWARE_NOOPT
+    //
+    // To enable pixel shader debugging add the following flag to
+    // SHADER_COMPILE_FLAGS:
+    //      D3DXSHADER_FORCE_PS_SOFTWARE_NOOPT
     //
-    // To enable pixel shader debugging add the following flag to the
-    // dwShaderFlags variable:
-    //     dwShaderFlags |= D3DXSHADER_FORCE_PS_SOFTWARE_NOOPT;
+    // The time taken is displayed on screen. It's much shorter when the
+    // compiled effect comes from the shader cache.
 
-    HRESULT hr = D3DXCreateEffectFromFile(g_pDevice, pszFilename, 0, 0,
-                    dwShaderFlags, 0, &pEffect, &pCompilationErrors);
+    std::vector<char> compiled;
+    std::string errors;
+    double startTime = GetTimeInSeconds();
 
-    if (FAILED(hr))
+    if (!CompileEffect(pszFilename, g_shaderCache, compiled, errors, g_shaderCacheHit))
     {
-        if (pCompilationErrors)
-        {
-            std::string compilationErrors(static_cast<const char *>(
-                            pCompilationErrors->GetBufferPointer()));
+        if (!errors.empty())
+            throw std::runtime_error(errors);
 
-            pCompilationErrors->Release();
-            throw std::runtime_error(compilationErrors);
-        }
+        return false;
     }
 
-    if (pCompilationErrors)
-        pCompilationErrors->Release();
+    if (!CreateEffect(compiled, pEffect))
+        return false;
 
-    return pEffect != 0;
+    g_shaderLoadMs = static_cast<float>((GetTimeInSeconds() - startTime) * 1000.0);
+    return true;
 }
 
 void Log(const char *pszMessage)
@@ -969,47 +1523,226 @@ bool MSAAModeSupported(D3DMULTISAMPLE_TYPE type, D3DFORMAT backBufferFmt,
     return false;
 }
 
-void PerformCameraCollisionDetection()
+void ParseCommandLine(const char *pszCmdLine)
 {
-    const D3DXVECTOR3 &pos = g_camera.getPosition();
-    D3DXVECTOR3 newPos(pos);
-
-    if (pos.x > g_cameraBoundsMax.x)
-        newPos.x = g_cameraBoundsMax.x;
+    // Supported command line options:
+    //  -record <filename>  Records the keyboard and mouse input to a file.
+    //  -replay <filename>  Replays previously recorded input and then exits.
+    //  -savecamera <file>  Saves the camera's final state when the replay
+    //                      finishes, or on exit. camera_replay checks that a
+    //                      headless replay of the input log ends in the same
+    //                      state. Don't use it with -worldoffset.
+    //  -rawmouse           Filters every mouse report rather than once per
+    //                      frame. Intended for mice with high polling rates.
+    //  -framelatency <n>   Maximum number of frames (1 to 3) the CPU and GPU
+    //                      may run ahead of the display. The default of 2
+    //                      simulates the next frame while the current one is
+    //                      rendered. 1 runs everything serially.
+    //  -jobthreads <n>     Number of job system worker threads. Defaults to
+    //                      one per processor, minus one for the main thread.
+    //  -pinthreads         Pins each job system worker thread to its own
+    //                      processor.
+    //  -views <layout>     Renders several views derived from the camera.
+    //                      The layout is one of single, stereo, split, or
+    //                      cube. Press V to cycle through them at run time.
+    //  -noprediction       Draws the camera's sampled pose rather than the
+    //                      pose predicted for when the frame is displayed.
+    //  -reversez           Maps the far plane to a depth of 0 and the near
+    //                      plane to 1. Uses a floating point depth buffer
+    //                      if the card has one.
+    //  -infinitefar        Moves the camera's far plane out to infinity.
+    //  -worldoffset <d>    Places the scene d world units from the world
+    //                      origin along both the x and z axes.
+    //  -largeworld         Uses double precision world positions and camera
+    //                      relative rendering. Without it the scene starts to
+    //                      visibly jitter at world offsets of around 1e4.
+    //  -jitter <n>         Not supported. Jittering the projection only makes
+    //                      the image shimmer without a temporal resolve, and
+    //                      the renderer doesn't have one. TemporalResolve is
+    //                      the CPU reference for it (see camera_bench
+    //                      -taatest).
+    //  -shadows            Renders a shadow map for the spot light. Needs a
+    //                      shader model 3.0 card.
+    //  -deferred           Uses deferred shading, which adds a grid of
+    //                      point lights over the floor. Needs a shader model
+    //                      3.0 card that renders to 3 targets at once. The
+    //                      deferred lights aren't shadowed.
+    //  -normalmap <file>   Loads the floor's normal map from the file rather
+    //                      than wood_normal_map.jpg, e.g., a baked one.
+    //  -hotreload          Watches normal_mapping.fx and the floor's
+    //                      textures, and reloads them when they're changed.
+    //                      An effect that fails to compile is ignored.
+    //  -pollassets         Same as -hotreload, but checks the files twice a
+    //                      second rather than relying on change
+    //                      notifications.
+    //  -noshadercache      Compiles normal_mapping.fx on every start rather
+    //                      than loading the compiled effect from the
+    //                      shader_cache directory.
+    //  -recordpath <file>  Records the path the camera takes and saves it as
+    //                      a compressed camera track on exit.
+    //  -playpath <file>    Flies the camera along a recorded camera track,
+    //                      reports the frame rate, and then exits.
+    //
+    // Replaying feeds the recorded input and frame times to the Keyboard and
+    // Mouse classes in place of the devices. The camera then follows exactly
+    // the same path as it did during recording.
+
+    std::istringstream args(pszCmdLine);
+    std::string option;
+    std::string filename;
+    std::string layout;
+    int latency = 0;
+    int threads = 0;
+    int count = 0;
+    double offset = 0.0;
+
+    while (args >> option)
+    {
+        if (option == "-record" && (args >> filename))
+        {
+            if (!g_inputRecorder.open(filename.c_str()))
+                Log("Failed to open the input log for recording.");
+        }
+        else if (option == "-replay" && (args >> filename))
+        {
+            if (!g_inputPlayback.open(filename.c_str()))
+                Log("Failed to open the input log for replay.");
+        }
+        else if (option == "-savecamera" && (args >> filename))
+        {
+            g_cameraStateFilename = filename;
+        }
+        else if (option == "-rawmouse")
+        {
+            Mouse::instance().setRawInput(true);
+        }
+        else if (option == "-framelatency" && (args >> latency))
+        {
+            g_maxFrameLatency = max(1, min(latency, MAX_FRAME_LATENCY));
+        }
+        else if (option == "-jobthreads" && (args >> threads))
+        {
+            g_jobThreadCount = max(0, threads);
+        }
+        else if (option == "-pinthreads")
+        {
+            g_pinJobThreads = true;
+        }
+        else if (option == "-views" && (args >> layout))
+        {
+            if (layout == "stereo")
+                g_cameraSet.setLayout(CameraSet::LAYOUT_STEREO);
+            else if (layout == "split")
+                g_cameraSet.setLayout(CameraSet::LAYOUT_SPLIT_SCREEN);
+            else if (layout == "cube")
+                g_cameraSet.setLayout(CameraSet::LAYOUT_CUBE_MAP);
+            else
+                g_cameraSet.setLayout(CameraSet::LAYOUT_SINGLE);
+        }
+        else if (option == "-shadows")
+        {
+            g_enableShadows = true;
+        }
+        else if (option == "-deferred")
+        {
+            g_enableDeferred = true;
+        }
+        else if (option == "-normalmap" && (args >> filename))
+        {
+            g_normalMapFilename = filename;
+        }
+        else if (option == "-hotreload")
+        {
+            g_enableHotReload = true;
+        }
+        else if (option == "-pollassets")
+        {
+            g_enableHotReload = true;
+            g_pollAssets = true;
+        }
+        else if (option == "-noshadercache")
+        {
+            g_enableShaderCache = false;
+        }
+        else if (option == "-noprediction")
+        {
+            g_enablePrediction = false;
+        }
+        else if (option == "-reversez")
+        {
+            g_depthMode = static_cast<Camera::DepthMode>(g_depthMode | Camera::DEPTH_MODE_REVERSE_Z);
+        }
+        else if (option == "-infinitefar")
+        {
+            g_depthMode = static_cast<Camera::DepthMode>(g_depthMode | Camera::DEPTH_MODE_INFINITE_FAR);
+        }
+        else if (option == "-worldoffset" && (args >> offset))
+        {
+            g_scenePosition = ToSectorPosition(WorldPosition(offset, 0.0, offset));
+        }
+        else if (option == "-largeworld")
+        {
+            g_largeWorld = true;
+        }
+        else if (option == "-jitter" && (args >> count))
+        {
+            Log("-jitter needs a temporal resolve, which the renderer doesn't have. Ignored.");
+        }
+        else if (option == "-recordpath" && (args >> filename))
+        {
+            g_cameraTrackFilename = filename;
+            g_isRecordingCameraTrack = true;
+            g_isPlayingCameraTrack = false;
+        }
+        else if (option == "-playpath" && (args >> filename))
+        {
+            if (g_cameraTrack.load(filename.c_str()))
+            {
+                g_isPlayingCameraTrack = true;
+                g_isRecordingCameraTrack = false;
+            }
+            else
+            {
+                Log("Failed to load the camera track.");
+            }
+        }
+    }
+}
 
-    if (pos.x < g_cameraBoundsMin.x)
-        newPos.x = g_cameraBoundsMin.x;
+void PlaybackFinished()
+{
+    // Report how quickly the recorded input was replayed and then exit.
 
-    if (pos.y > g_cameraBoundsMax.y)
-        newPos.y = g_cameraBoundsMax.y;
+    std::ostringstream msg;
+    int frames = g_inputPlayback.frameCount();
+    double elapsedTimeSec = GetTimeInSeconds() - g_playbackStartTime;
 
-    if (pos.y < g_cameraBoundsMin.y)
-        newPos.y = g_cameraBoundsMin.y;
+    g_inputPlayback.close();
+    SaveFinalCameraState();
 
-    if (pos.z > g_cameraBoundsMax.z)
-        newPos.z = g_cameraBoundsMax.z;
+    msg << "Replayed " << frames << " frames in " << elapsedTimeSec << " seconds";
 
-    if (pos.z < g_cameraBoundsMin.z)
-        newPos.z = g_cameraBoundsMin.z;
+    if (elapsedTimeSec > 0.0)
+        msg << " (" << frames / elapsedTimeSec << " frames/sec)";
 
-    g_camera.setPosition(newPos);
+    MessageBox(g_hWnd, msg.str().c_str(), "Input Replay", MB_ICONINFORMATION);
+    PostMessage(g_hWnd, WM_CLOSE, 0, 0);
 }
 
 void ProcessUserInput()
 {
-    Keyboard &keyboard = Keyboard::instance();
     Mouse &mouse = Mouse::instance();
 
-    if (keyboard.keyPressed(Keyboard::KEY_ESCAPE))
+    if (g_actionMap.triggered(ACTION_EXIT))
         PostMessage(g_hWnd, WM_CLOSE, 0, 0);
     
-    if (keyboard.keyPressed(Keyboard::KEY_H))
+    if (g_actionMap.triggered(ACTION_TOGGLE_HELP))
         g_displayHelp = !g_displayHelp;
 
-    if (keyboard.keyPressed(Keyboard::KEY_T))
+    if (g_actionMap.triggered(ACTION_TOGGLE_COLOR_MAP))
         g_disableColorMapTexture = !g_disableColorMapTexture;
 
-    if (keyboard.keyPressed(Keyboard::KEY_ADD) || keyboard.keyPressed(Keyboard::KEY_NUMPAD_ADD))
+    if (g_actionMap.triggered(ACTION_INCREASE_ROTATION_SPEED))
     {
         g_camera.setRotationSpeed(g_camera.getRotationSpeed() + 0.01f);
 
@@ -1017,7 +1750,7 @@ void ProcessUserInput()
             g_camera.setRotationSpeed(1.0f);
     }     
 
-    if (keyboard.keyPressed(Keyboard::KEY_MINUS) || keyboard.keyPressed(Keyboard::KEY_NUMPAD_MINUS))
+    if (g_actionMap.triggered(ACTION_DECREASE_ROTATION_SPEED))
     {
         g_camera.setRotationSpeed(g_camera.getRotationSpeed() - 0.01f);
 
@@ -1025,7 +1758,7 @@ void ProcessUserInput()
             g_camera.setRotationSpeed(0.01f);
     }
 
-    if (keyboard.keyPressed(Keyboard::KEY_PERIOD))
+    if (g_actionMap.triggered(ACTION_INCREASE_MOUSE_WEIGHT))
     {
         mouse.setWeightModifier(mouse.weightModifier() + 0.1f);
 
@@ -1033,7 +1766,7 @@ void ProcessUserInput()
             mouse.setWeightModifier(1.0f);
     }     
 
-    if (keyboard.keyPressed(Keyboard::KEY_COMMA))
+    if (g_actionMap.triggered(ACTION_DECREASE_MOUSE_WEIGHT))
     {
         mouse.setWeightModifier(mouse.weightModifier() - 0.1f);
 
@@ -1041,36 +1774,111 @@ void ProcessUserInput()
             mouse.setWeightModifier(0.0f);
     }
 
-    if (keyboard.keyPressed(Keyboard::KEY_M))
+    if (g_actionMap.triggered(ACTION_TOGGLE_MOUSE_SMOOTHING))
         mouse.smoothMouse(!mouse.isMouseSmoothing());
 
-    if (keyboard.keyDown(Keyboard::KEY_LALT) || keyboard.keyDown(Keyboard::KEY_RALT))
+    if (g_actionMap.triggered(ACTION_TOGGLE_FULL_SCREEN))
+        ToggleFullScreen();
+
+    if (g_actionMap.triggered(ACTION_CYCLE_VIEW_LAYOUT))
     {
-        if (keyboard.keyPressed(Keyboard::KEY_ENTER))
-            ToggleFullScreen();
+        int layout = (g_cameraSet.getLayout() + 1) % CameraSet::LAYOUT_COUNT;
+        g_cameraSet.setLayout(static_cast<CameraSet::Layout>(layout));
     }
 
-    if (keyboard.keyPressed(Keyboard::KEY_SPACE))
+    if (g_actionMap.triggered(ACTION_TOGGLE_PREDICTION))
     {
-        g_flightModeEnabled = !g_flightModeEnabled;
+        g_enablePrediction = !g_enablePrediction;
+        g_cameraPredictor.reset();
+    }
 
-        if (g_flightModeEnabled)
-        {
-            g_camera.setBehavior(Camera::CAMERA_BEHAVIOR_FLIGHT);
-        }
-        else
-        {
-            const D3DXVECTOR3 &cameraPos = g_camera.getPosition();
+    if (g_actionMap.triggered(ACTION_TOGGLE_FLIGHT_MODE))
+        ToggleFlightMode();
 
-            g_camera.setBehavior(Camera::CAMERA_BEHAVIOR_FIRST_PERSON);
-            g_camera.setPosition(cameraPos.x, CAMERA_POS.y, cameraPos.z);
-        }
+    if (g_actionMap.triggered(ACTION_CYCLE_CAMERA_MODE))
+        CycleCameraMode();
+}
+
+void RecordInput(float elapsedTimeSec)
+{
+    const Keyboard &keyboard = Keyboard::instance();
+    const Mouse &mouse = Mouse::instance();
+    const unsigned int *pKeyTapBits = keyboard.getKeyTapBits();
+    const DIMOUSESTATE &mouseState = mouse.mouseState();
+    const std::vector<MouseReport> &reports = mouse.reports();
+    InputFrame frame;
+
+    frame.elapsedTimeSec = elapsedTimeSec;
+    memcpy(frame.keyStates, keyboard.getKeyStates(), sizeof(frame.keyStates));
+    memcpy(frame.mouseButtons, mouseState.rgbButtons, sizeof(frame.mouseButtons));
+    memcpy(frame.mouseButtonTaps, mouse.buttonTaps(), sizeof(frame.mouseButtonTaps));
+    frame.mouseX = mouseState.lX;
+    frame.mouseY = mouseState.lY;
+    frame.mouseWheel = mouseState.lZ;
+    frame.mouseRawInput = mouse.isReportFiltered();
+    frame.mouseReportCount = static_cast<int>(reports.size());
+    frame.pMouseReports = reports.empty() ? 0 : &reports[0];
+
+    for (int i = 0; i < 256; ++i)
+        frame.keyTaps[i] = (pKeyTapBits[i >> 5] & (1U << (i & 31))) ? 0x80 : 0;
+
+    if (!g_inputRecorder.write(frame))
+        Log("Failed to write to the input log. Recording has stopped.");
+}
+
+void ReleaseFrameQueries()
+{
+    for (int i = 0; i < MAX_FRAME_LATENCY; ++i)
+    {
+        SAFE_RELEASE(g_pFrameQueries[i]);
+        g_frameQueryIssued[i] = false;
     }
 }
 
-void RenderFloor()
+void ReleaseGBuffer()
 {
-    D3DXHANDLE hTechnique = g_pEffect->GetTechniqueByName("NormalMappingSpotLighting");
+    SAFE_RELEASE(g_pFullScreenVertexDeclaration);
+    SAFE_RELEASE(g_pGBufferDepthSurface);
+
+    for (int i = 0; i < GBUFFER_TARGET_COUNT; ++i)
+        SAFE_RELEASE(g_pGBufferTextures[i]);
+}
+
+void ReleaseShadowMap()
+{
+    SAFE_RELEASE(g_pShadowAtlasDepthSurface);
+    SAFE_RELEASE(g_pShadowAtlasTexture);
+}
+
+unsigned int __stdcall ReloadAssetsThreadProc(void *pArg)
+{
+    // Does the device independent part of reloading g_assetReload's assets:
+    // compiling the effect and reading the textures' files. This runs on a
+    // thread of its own rather than as a job. A job would sit in the main
+    // thread's deque, and the main thread could end up running it the next
+    // time it waits on the frame pipeline, stalling that frame.
+
+    AssetReload &reload = *static_cast<AssetReload *>(pArg);
+    bool cacheHit = false;
+
+    reload.data.resize(reload.assets.size());
+
+    for (int i = 0; i < static_cast<int>(reload.assets.size()); ++i)
+    {
+        const char *pszFilename = g_assetWatcher.getFilename(reload.assets[i]);
+
+        if (reload.assets[i] == g_shaderAsset)
+            CompileEffect(pszFilename, g_shaderCache, reload.data[i], reload.errors, cacheHit);
+        else
+            ReadAssetFile(pszFilename, reload.data[i]);
+    }
+
+    return 0;
+}
+
+void RenderFloor(const char *pszTechnique)
+{
+    D3DXHANDLE hTechnique = g_pEffect->GetTechniqueByName(pszTechnique);
 
     if (FAILED(g_pEffect->SetTechnique(hTechnique)))
         return;
@@ -1095,104 +1903,370 @@ void RenderFloor()
     g_pEffect->End();
 }
 
-void RenderFrame()
+void RenderDeferredView(const FrameState &frame, const CameraView &view,
+                        const D3DVIEWPORT9 &viewport)
 {
-    g_pDevice->Clear(0, 0, D3DCLEAR_TARGET | D3DCLEAR_ZBUFFER, 0, 1.0f, 0);
+    // Draws the floor into the G-buffer, lights it with the ambient light
+    // into the back buffer, and then adds each light that reaches the view
+    // within its screen rectangle. The lighting draws share one effect pass
+    // and only commit the changed light in between.
 
-    if (FAILED(g_pDevice->BeginScene()))
+    static LightList visibleLights;
+
+    IDirect3DSurface9 *pBackBuffer = 0;
+    IDirect3DSurface9 *pDepthStencil = 0;
+    IDirect3DSurface9 *pTargets[GBUFFER_TARGET_COUNT] = {0};
+    float clearDepth = (g_depthMode & Camera::DEPTH_MODE_REVERSE_Z) ? 0.0f : 1.0f;
+    UINT totalPasses = 0;
+
+    g_pDevice->GetRenderTarget(0, &pBackBuffer);
+    g_pDevice->GetDepthStencilSurface(&pDepthStencil);
+
+    for (int i = 0; i < GBUFFER_TARGET_COUNT; ++i)
+    {
+        g_pGBufferTextures[i]->GetSurfaceLevel(0, &pTargets[i]);
+        g_pDevice->SetRenderTarget(i, pTargets[i]);
+    }
+
+    g_pDevice->SetDepthStencilSurface(g_pGBufferDepthSurface);
+    g_pDevice->SetViewport(&viewport);
+    g_pDevice->Clear(0, 0, D3DCLEAR_TARGET | D3DCLEAR_ZBUFFER, 0, clearDepth, 0);
+
+    UpdateEffectView(frame, view);
+    RenderDraws(frame.draws, "DeferredGBuffer");
+
+    // Setting render target 0 resets the viewport to cover the back buffer.
+
+    for (int i = GBUFFER_TARGET_COUNT - 1; i > 0; --i)
+        g_pDevice->SetRenderTarget(i, 0);
+
+    g_pDevice->SetRenderTarget(0, pBackBuffer);
+    g_pDevice->SetDepthStencilSurface(pDepthStencil);
+    g_pDevice->SetViewport(&viewport);
+
+    for (int i = 0; i < GBUFFER_TARGET_COUNT; ++i)
+        SAFE_RELEASE(pTargets[i]);
+
+    SAFE_RELEASE(pDepthStencil);
+    SAFE_RELEASE(pBackBuffer);
+
+    D3DXMATRIX inverseViewProjectionMatrix;
+    D3DXVECTOR4 viewportRect(static_cast<float>(viewport.X), static_cast<float>(viewport.Y),
+        static_cast<float>(viewport.Width), static_cast<float>(viewport.Height));
+    float gBufferSize[2] = {static_cast<float>(g_gBufferWidth), static_cast<float>(g_gBufferHeight)};
+
+    D3DXMatrixInverse(&inverseViewProjectionMatrix, 0, &view.viewProjectionMatrix);
+
+    g_pEffect->SetMatrix("inverseViewProjectionMatrix", &inverseViewProjectionMatrix);
+    g_pEffect->SetVector("viewportRect", &viewportRect);
+    g_pEffect->SetValue("gBufferSize", gBufferSize, sizeof(gBufferSize));
+    g_pEffect->SetTexture("gBufferAlbedoTexture", g_pGBufferTextures[GBUFFER_ALBEDO]);
+    g_pEffect->SetTexture("gBufferNormalTexture", g_pGBufferTextures[GBUFFER_NORMAL]);
+    g_pEffect->SetTexture("gBufferDepthTexture", g_pGBufferTextures[GBUFFER_DEPTH]);
+
+    // The G-buffer doesn't store material indices yet. All of it is the
+    // floor's material.
+
+    g_pEffect->SetFloat("materialIndex", static_cast<float>(g_floorMaterial));
+
+    if (SUCCEEDED(g_pEffect->SetTechnique(g_pEffect->GetTechniqueByName("DeferredAmbient")))
+        && SUCCEEDED(g_pEffect->Begin(&totalPasses, 0)))
+    {
+        if (SUCCEEDED(g_pEffect->BeginPass(0)))
+        {
+            DrawFullScreenQuad();
+            g_pEffect->EndPass();
+        }
+
+        g_pEffect->End();
+    }
+
+    // Copying the frame's lights reuses the list's memory after the first
+    // frame.
+
+    visibleLights = frame.lights;
+    visibleLights.cull(view.viewProjectionMatrix, viewport.Width, viewport.Height);
+
+    if (visibleLights.getVisibleCount() == 0)
+        return;
+
+    if (FAILED(g_pEffect->SetTechnique(g_pEffect->GetTechniqueByName("DeferredLighting")))
+        || FAILED(g_pEffect->Begin(&totalPasses, 0)))
         return;
 
-    RenderFloor();
-    RenderText();
+    if (SUCCEEDED(g_pEffect->BeginPass(0)))
+    {
+        for (int i = 0; i < visibleLights.getVisibleCount(); ++i)
+        {
+            const LightList::ScreenRect &rect = visibleLights.getVisibleRect(i);
+            const DeferredLight &light = visibleLights.getLight(rect.light);
+            RECT scissorRect;
+
+            scissorRect.left = viewport.X + rect.left;
+            scissorRect.top = viewport.Y + rect.top;
+            scissorRect.right = viewport.X + rect.right;
+            scissorRect.bottom = viewport.Y + rect.bottom;
+
+            g_pDevice->SetScissorRect(&scissorRect);
+            g_pEffect->SetVectorArray("deferredLight", reinterpret_cast<const D3DXVECTOR4 *>(&light), 3);
+            g_pEffect->CommitChanges();
+            DrawFullScreenQuad();
+        }
 
-    g_pDevice->EndScene();
-    g_pDevice->Present(0, 0, 0, 0);
+        g_pEffect->EndPass();
+    }
+
+    g_pEffect->End();
 }
 
-void RenderText()
+void RenderDraws(const DrawQueue &draws, const char *pszTechnique)
 {
-    std::ostringstream output;
-    RECT rcClient;
+    // The floor is the only object there is, so every draw draws the floor.
+
+    for (int i = 0; i < draws.getCount(); ++i)
+    {
+        BindMaterial(draws.getMaterial(i));
+        RenderFloor(pszTechnique);
+    }
+}
+
+void RenderFrame(const FrameState &frame)
+{
+    LimitFrameLatency();
+    UpdateEffect(frame);
+    g_materialTable.upload(UploadMaterials, g_pMaterialTableTexture);
+
+    if (FAILED(g_pDevice->BeginScene()))
+        return;
+
+    RenderShadowMaps(frame);
+
+    // Reverse-Z maps the far plane to 0, so the depth buffer is cleared to 0
+    // and nearer fragments are the ones with greater depth values.
 
-    if (g_displayHelp)
-    {
-        output
-            << "First Person behavior" << std::endl
-            << "  Press W and S to move forwards and backwards" << std::endl
-            << "  Press A and D to strafe left and right" << std::endl
-            << "  Press E and Q to move up and down" << std::endl
-            << "  Move mouse to free look" << std::endl
-            << std::endl
-            << "Flight behavior" << std::endl
-            << "  Press W and S to move forwards and backwards" << std::endl
-            << "  Press A and D to yaw left and right" << std::endl
-            << "  Press E and Q to move up and down" << std::endl
-            << "  Move mouse up and down to change pitch" << std::endl
-            << "  Move mouse left and right to change roll" << std::endl
-            << std::endl
-            << "Press M to enable/disable mouse smoothing" << std::endl
-            << "Press T to enable/disable the floor color map texture" << std::endl
-            << "Press + and - to change camera rotation speed" << std::endl
-            << "Press , and . to change mouse sensitivity" << std::endl
-            << "Press SPACE to toggle between first person and flight behaviors" << std::endl
-            << "Press ALT and ENTER to toggle full screen" << std::endl
-            << "Press ESC to exit" << std::endl
-            << std::endl
-            << "Press H to hide help";
+    if (g_depthMode & Camera::DEPTH_MODE_REVERSE_Z)
+    {
+        g_pDevice->SetRenderState(D3DRS_ZFUNC, D3DCMP_GREATEREQUAL);
+        g_pDevice->Clear(0, 0, D3DCLEAR_TARGET | D3DCLEAR_ZBUFFER, 0, 0.0f, 0);
     }
     else
     {
-        const char *pszCurrentBehavior = 0;
-        const Mouse &mouse = Mouse::instance();
+        g_pDevice->SetRenderState(D3DRS_ZFUNC, D3DCMP_LESSEQUAL);
+        g_pDevice->Clear(0, 0, D3DCLEAR_TARGET | D3DCLEAR_ZBUFFER, 0, 1.0f, 0);
+    }
+
+    RenderViews(frame);
+    RenderText(frame);
+
+    g_pDevice->EndScene();
+    g_pDevice->Present(0, 0, 0, 0);
+
+    if (g_pFrameQueries[g_frameQueryIndex])
+    {
+        g_pFrameQueries[g_frameQueryIndex]->Issue(D3DISSUE_END);
+        g_frameQueryIssued[g_frameQueryIndex] = true;
+    }
 
-        switch (g_camera.getBehavior())
+    g_frameQueryIndex = (g_frameQueryIndex + 1) % g_maxFrameLatency;
+}
+
+void RenderShadowMaps(const FrameState &frame)
+{
+    // Renders the spot light's shadow map into its atlas slot, unless the
+    // slot still holds it from an earlier frame. Neither the light nor the
+    // floor ever move, so the map is only rendered again after the device
+    // has been reset. The matrices are relative to the frame's camera
+    // origin, but the light and the casters move with the origin together,
+    // so a cached map stays valid when the origin changes.
+
+    if (!g_pShadowAtlasTexture)
+        return;
+
+    bool isCached = false;
+
+    g_shadowAtlas.beginFrame();
+
+    int slot = g_shadowAtlas.allocate(SHADOW_SPOT_LIGHT_ID, isCached);
+
+    if (slot < 0)
+        return;
+
+    if (!isCached)
+    {
+        IDirect3DSurface9 *pBackBuffer = 0;
+        IDirect3DSurface9 *pDepthStencil = 0;
+        IDirect3DSurface9 *pAtlasSurface = 0;
+        D3DVIEWPORT9 viewport = {0};
+        int x = 0;
+        int y = 0;
+        int size = 0;
+
+        g_shadowAtlas.getSlotRect(slot, x, y, size);
+        viewport.X = x;
+        viewport.Y = y;
+        viewport.Width = size;
+        viewport.Height = size;
+        viewport.MinZ = 0.0f;
+        viewport.MaxZ = 1.0f;
+
+        g_pDevice->GetRenderTarget(0, &pBackBuffer);
+        g_pDevice->GetDepthStencilSurface(&pDepthStencil);
+        g_pShadowAtlasTexture->GetSurfaceLevel(0, &pAtlasSurface);
+
+        // Clearing only clears the viewport, i.e. this light's slot. The
+        // shadow map is cleared to the far plane.
+
+        g_pDevice->SetRenderTarget(0, pAtlasSurface);
+        g_pDevice->SetDepthStencilSurface(g_pShadowAtlasDepthSurface);
+        g_pDevice->SetViewport(&viewport);
+        g_pDevice->SetRenderState(D3DRS_ZFUNC, D3DCMP_LESSEQUAL);
+        g_pDevice->Clear(0, 0, D3DCLEAR_TARGET | D3DCLEAR_ZBUFFER, 0xffffffff, 1.0f, 0);
+
+        if (frame.floorCastsShadow)
         {
-        default:
-            pszCurrentBehavior = "Unknown";
-            break;
+            g_pEffect->SetMatrix("lightViewProjectionMatrix", &frame.shadowViewProjectionMatrix);
+            RenderFloor("ShadowMapDepth");
+        }
 
-        case Camera::CAMERA_BEHAVIOR_FIRST_PERSON:
-            pszCurrentBehavior = "First Person";
-            break;
+        // Setting the back buffer back also resets the viewport to cover it.
 
-        case Camera::CAMERA_BEHAVIOR_FLIGHT:
-            pszCurrentBehavior = "Flight";
-            break;
+        g_pDevice->SetRenderTarget(0, pBackBuffer);
+        g_pDevice->SetDepthStencilSurface(pDepthStencil);
+
+        SAFE_RELEASE(pAtlasSurface);
+        SAFE_RELEASE(pDepthStencil);
+        SAFE_RELEASE(pBackBuffer);
+    }
+
+    D3DXMATRIX textureMatrix;
+    D3DXMATRIX shadowMatrix;
+
+    g_shadowAtlas.textureMatrix(slot, textureMatrix);
+    shadowMatrix = frame.shadowViewProjectionMatrix * textureMatrix;
+
+    g_pEffect->SetMatrix("shadowMatrix", &shadowMatrix);
+    g_pEffect->SetTexture("shadowMapTexture", g_pShadowAtlasTexture);
+    g_pEffect->SetFloat("shadowTexelSize", 1.0f / SHADOW_ATLAS_SIZE);
+    g_pEffect->SetFloat("shadowBias", SHADOW_BIAS);
+}
+
+void RenderText(const FrameState &frame)
+{
+    // Formatting the statistics text is only done when one of the displayed
+    // values has actually changed. On most frames (e.g., when the camera
+    // isn't moving) the previously formatted text is simply redrawn. The help
+    // text never changes and is drawn directly from the HELP_TEXT constant.
+
+    static TextBuffer statsText;
+    static HudStats displayedStats;
+    static bool statsTextValid = false;
+
+    const char *pszText = HELP_TEXT;
+    RECT rcClient;
+
+    if (!g_displayHelp)
+    {
+        // The camera and mouse values come from the simulated frame. The
+        // rest is owned by the render thread. memcpy() keeps the zeroed
+        // padding bytes so the snapshots can be memcmp()'d.
+
+        HudStats stats;
+
+        memcpy(&stats, &frame.stats, sizeof(stats));
+        stats.framesPerSecond = g_framesPerSecond;
+        stats.msaaSamples = g_msaaSamples;
+        stats.maxAnisotrophy = g_maxAnisotrophy;
+        stats.shaderLoadMs = g_shaderLoadMs;
+        stats.shaderCacheHit = g_shaderCacheHit;
+        stats.hotReload = !g_enableHotReload ? 0 : (g_assetWatcher.getPolledDirectoryCount() > 0 ? 2 : 1);
+        stats.assetReloads = g_assetReloadCount;
+        stats.assetReloadFailed = g_assetReloadFailed;
+
+        if (!statsTextValid || memcmp(&stats, &displayedStats, sizeof(stats)) != 0)
+        {
+            FormatStatsText(stats, statsText);
+            memcpy(&displayedStats, &stats, sizeof(stats));
+            statsTextValid = true;
         }
 
-        output.setf(std::ios::fixed, std::ios::floatfield);
-        output << std::setprecision(2);
-
-        output
-            << "FPS: " << g_framesPerSecond << std::endl
-            << "Multisample anti-aliasing: " << g_msaaSamples << "x" << std::endl
-            << "Anisotropic filtering: " << g_maxAnisotrophy << "x" << std::endl
-            << std::endl
-            << "Camera" << std::endl
-            << "  Position:"
-            << " x:" << g_camera.getPosition().x
-            << " y:" << g_camera.getPosition().y
-            << " z:" << g_camera.getPosition().z << std::endl
-            << "  Velocity:"
-            << " x:" << g_camera.getCurrentVelocity().x
-            << " y:" << g_camera.getCurrentVelocity().y
-            << " z:" << g_camera.getCurrentVelocity().z << std::endl
-            << "  Behavior: " << pszCurrentBehavior << std::endl
-            << "  Rotation speed: " << g_camera.getRotationSpeed() << std::endl
-            << std::endl
-            << "Mouse" << std::endl
-            << "  Smoothing: " << (mouse.isMouseSmoothing() ? "enabled" : "disabled") << std::endl
-            << "  Sensitivity: " << mouse.weightModifier() << std::endl
-            << std::endl
-            << "Press H to display help";
-    }    
+        pszText = statsText.c_str();
+    }
 
     GetClientRect(g_hWnd, &rcClient);
     rcClient.left += 4;
     rcClient.top += 2;
 
-    g_pFont->DrawText(0, output.str().c_str(), -1, &rcClient,
+    if (FAILED(g_pTextSprite->Begin(D3DXSPRITE_ALPHABLEND | D3DXSPRITE_SORT_TEXTURE)))
+        return;
+
+    g_pFont->DrawText(g_pTextSprite, pszText, -1, &rcClient,
         DT_EXPANDTABS | DT_LEFT, D3DCOLOR_XRGB(255, 255, 0));
+
+    g_pTextSprite->End();
+}
+
+void RenderViews(const FrameState &frame)
+{
+    // Renders the scene once for each view in the frame's camera set. The
+    // floor is culled against all of the views in one go up front.
+
+    const CameraSet &cameraSet = frame.cameraSet;
+    D3DVIEWPORT9 fullViewport;
+    unsigned int floorViewMask = 0;
+    const char *pszTechnique = g_pShadowAtlasTexture
+        ? "NormalMappingSpotLightingShadowed" : "NormalMappingSpotLighting";
+
+    g_pDevice->GetViewport(&fullViewport);
+    cameraSet.cull(&frame.floorBoundsCenter, &FLOOR_BOUNDS_RADIUS, 1, &floorViewMask);
+
+    for (int i = 0; i < cameraSet.getViewCount(); ++i)
+    {
+        if (!(floorViewMask & (1U << i)))
+            continue;
+
+        const CameraView &view = cameraSet.getView(i);
+        D3DVIEWPORT9 viewport;
+
+        viewport.X = fullViewport.X + static_cast<DWORD>(view.viewport[0] * fullViewport.Width);
+        viewport.Y = fullViewport.Y + static_cast<DWORD>(view.viewport[1] * fullViewport.Height);
+        viewport.Width = static_cast<DWORD>(view.viewport[2] * fullViewport.Width);
+        viewport.Height = static_cast<DWORD>(view.viewport[3] * fullViewport.Height);
+        viewport.MinZ = fullViewport.MinZ;
+        viewport.MaxZ = fullViewport.MaxZ;
+
+        if (g_pGBufferTextures[GBUFFER_ALBEDO])
+        {
+            RenderDeferredView(frame, view, viewport);
+        }
+        else
+        {
+            g_pDevice->SetViewport(&viewport);
+            UpdateEffectView(frame, view);
+            RenderDraws(frame.draws, pszTechnique);
+        }
+    }
+
+    g_pDevice->SetViewport(&fullViewport);
+}
+
+void ReplaceTexture(IDirect3DTexture9 *&pTexture, IDirect3DTexture9 *pNewTexture)
+{
+    // Swaps in a reloaded texture, including in the texture sets that refer
+    // to the old one.
+
+    for (int i = 0; i < static_cast<int>(g_materialTextureSets.size()); ++i)
+    {
+        MaterialTextureSet &textures = g_materialTextureSets[i];
+
+        if (textures.pColorMap == pTexture)
+            textures.pColorMap = pNewTexture;
+
+        if (textures.pNormalMap == pTexture)
+            textures.pNormalMap = pNewTexture;
+    }
+
+    SAFE_RELEASE(pTexture);
+    pTexture = pNewTexture;
 }
 
 bool ResetDevice()
@@ -1203,52 +2277,101 @@ bool ResetDevice()
     if (FAILED(g_pFont->OnLostDevice()))
         return false;
 
+    if (FAILED(g_pTextSprite->OnLostDevice()))
+        return false;
+
+    ReleaseFrameQueries();
+    ReleaseShadowMap();
+    ReleaseGBuffer();
+
     if (FAILED(g_pDevice->Reset(&g_params)))
         return false;
 
+    CreateFrameQueries();
+
+    if (g_enableShadows && !CreateShadowMap())
+        g_enableShadows = false;
+
+    if (g_enableDeferred && !CreateGBuffer())
+        g_enableDeferred = false;
+
     if (FAILED(g_pFont->OnResetDevice()))
         return false;
 
+    if (FAILED(g_pTextSprite->OnResetDevice()))
+        return false;
+
     if (FAILED(g_pEffect->OnResetDevice()))
         return false;
 
     return true;
 }
 
-void SetProcessorAffinity()
+void SaveFinalCameraState()
 {
-    // Assign the current thread to one processor. This ensures that timing
-    // code runs on only one processor, and will not suffer any ill effects
-    // from power management.
-    //
-    // Based on the DXUTSetProcessorAffinity() function in the DXUT framework.
+    // The frame pipeline must be idle. Only the first call saves the state,
+    // so the camera is saved as the replay left it even though the
+    // application keeps running until the window closes.
 
-    DWORD_PTR dwProcessAffinityMask = 0;
-    DWORD_PTR dwSystemAffinityMask = 0;
-    HANDLE hCurrentProcess = GetCurrentProcess();
+    CameraState state;
 
-    if (!GetProcessAffinityMask(hCurrentProcess, &dwProcessAffinityMask, &dwSystemAffinityMask))
+    if (g_cameraStateFilename.empty())
         return;
 
-    if (dwProcessAffinityMask)
-    {
-        // Find the lowest processor that our process is allowed to run against.
+    GetCameraState(g_camera, state);
+
+    if (!SaveCameraState(g_cameraStateFilename.c_str(), state))
+        Log("Failed to save the camera state.");
 
-        DWORD_PTR dwAffinityMask = (dwProcessAffinityMask & ((~dwProcessAffinityMask) + 1));
+    g_cameraStateFilename.clear();
+}
 
-        // Set this as the processor that our thread must always run against.
-        // This must be a subset of the process affinity mask.
+void SetFirstPersonBehavior()
+{
+    // Back down to eye height above the floor. The camera's position is
+    // relative to its origin so the eye height is converted too.
 
-        HANDLE hCurrentThread = GetCurrentThread();
+    const D3DXVECTOR3 &cameraPos = g_camera.getPosition();
+    D3DXVECTOR3 eyeHeight = WorldOffset(ToWorldPosition(g_scenePosition) + CAMERA_POS,
+        g_camera.getOrigin());
 
-        if (hCurrentThread != INVALID_HANDLE_VALUE)
-        {
-            SetThreadAffinityMask(hCurrentThread, dwAffinityMask);
-            CloseHandle(hCurrentThread);
-        }
-    }
+    g_camera.setBehavior(Camera::CAMERA_BEHAVIOR_FIRST_PERSON);
+    g_camera.setPosition(cameraPos.x, eyeHeight.y, cameraPos.z);
+}
+
+void SimulateFrame(int slot, float elapsedTimeSec)
+{
+    // Runs as a job on a worker thread when the frame pipeline is enabled.
+    // Only the camera, the mouse's filtered movement and the given frame state
+    // slot are touched here. The main thread leaves these alone until the
+    // frame pipeline's wait() returns.
+
+    if (g_isPlayingCameraTrack)
+        g_cameraTrack.apply(g_cameraTrackTime, g_camera);
+    else
+        UpdateCamera(elapsedTimeSec);
+
+    if (g_isRecordingCameraTrack)
+        g_cameraTrack.record(g_cameraTrackTime, g_camera);
 
-    CloseHandle(hCurrentProcess);
+    g_cameraPredictor.update(elapsedTimeSec, g_camera);
+
+    UpdateInputLatency();
+    UpdateFrameState(g_frameStates[slot], elapsedTimeSec);
+}
+
+void ToggleFlightMode()
+{
+    // Switching behaviors snaps the camera to a new pose. That isn't motion
+    // the predictor should extrapolate.
+
+    g_flightModeEnabled = !g_flightModeEnabled;
+    g_cameraPredictor.reset();
+
+    if (g_flightModeEnabled)
+        g_camera.setBehavior(Camera::CAMERA_BEHAVIOR_FLIGHT);
+    else
+        SetFirstPersonBehavior();
 }
 
 void ToggleFullScreen()
@@ -1331,94 +2454,196 @@ void ToggleFullScreen()
         CAMERA_ZNEAR, CAMERA_ZFAR);
 }
 
-void UpdateCamera(float elapsedTimeSec)
+void UpdateAssets()
 {
-    float heading = 0.0f;
-    float pitch = 0.0f;
-    float roll = 0.0f;
-    float rotationSpeed = g_camera.getRotationSpeed();
-    D3DXVECTOR3 direction;
-    Mouse &mouse = Mouse::instance();
+    // Hot reloading. Called between frames. Changed files are handed to a
+    // background thread. Once it's done the new effect and textures are
+    // created and swapped in here, so a frame never sees a mix of old and
+    // new assets. The effect is fully set up again by UpdateEffect() every
+    // frame. An effect that doesn't compile or a texture that can't be
+    // decoded is skipped and the old one is kept.
+
+    if (g_hAssetReloadThread)
+    {
+        if (WaitForSingleObject(g_hAssetReloadThread, 0) != WAIT_OBJECT_0)
+            return;
 
-    GetMovementDirection(direction);
+        CloseHandle(g_hAssetReloadThread);
+        g_hAssetReloadThread = 0;
+        g_assetReloadFailed = false;
 
-    switch (g_camera.getBehavior())
-    {
-    case Camera::CAMERA_BEHAVIOR_FIRST_PERSON:
-        pitch = mouse.yPosRelative() * rotationSpeed;
-        heading = mouse.xPosRelative() * rotationSpeed;
+        for (int i = 0; i < static_cast<int>(g_assetReload.assets.size()); ++i)
+        {
+            const std::vector<char> &data = g_assetReload.data[i];
+            int asset = g_assetReload.assets[i];
 
-        g_camera.rotate(heading, pitch, 0.0f);
-        break;
+            if (asset == g_shaderAsset)
+            {
+                ID3DXEffect *pEffect = 0;
 
-    case Camera::CAMERA_BEHAVIOR_FLIGHT:
-        heading = direction.x * CAMERA_SPEED_FLIGHT_YAW * elapsedTimeSec;
-        pitch = -mouse.yPosRelative() * rotationSpeed;
-        roll = mouse.xPosRelative() * rotationSpeed;
+                if (!data.empty() && CreateEffect(data, pEffect))
+                {
+                    g_pEffect->Release();
+                    g_pEffect = pEffect;
+                    ++g_assetReloadCount;
+                }
+                else
+                {
+                    OutputDebugString(g_assetReload.errors.c_str());
+                    g_assetReloadFailed = true;
+                }
+            }
+            else
+            {
+                IDirect3DTexture9 *pTexture = 0;
 
-        g_camera.rotate(heading, pitch, roll);
-        direction.x = 0.0f; // ignore yaw motion when updating camera velocity
-        break;
+                if (!data.empty() && SUCCEEDED(D3DXCreateTextureFromFileInMemory(g_pDevice,
+                        &data[0], static_cast<UINT>(data.size()), &pTexture)))
+                {
+                    if (asset == g_normalMapAsset)
+                    {
+                        ReplaceTexture(g_pNormalMapTexture, pTexture);
+                        g_normalMapReconstructZ = IsTwoChannelNormalMap(pTexture);
+                    }
+                    else
+                    {
+                        ReplaceTexture(g_pColorMapTexture, pTexture);
+                    }
+
+                    ++g_assetReloadCount;
+                }
+                else
+                {
+                    g_assetReloadFailed = true;
+                }
+            }
+        }
+
+        g_assetReload.data.clear();
     }
 
-    g_camera.updatePosition(direction, elapsedTimeSec);
-    PerformCameraCollisionDetection();
+    if (g_assetWatcher.poll(g_assetReload.assets) > 0)
+    {
+        g_assetReload.errors.clear();
+        g_hAssetReloadThread = reinterpret_cast<HANDLE>(_beginthreadex(0, 0,
+            ReloadAssetsThreadProc, &g_assetReload, 0, 0));
+
+        if (!g_hAssetReloadThread)
+            g_assetReloadFailed = true;
+    }
+}
+
+void UpdateCamera(float elapsedTimeSec)
+{
+    const Mouse &mouse = Mouse::instance();
+    CameraInput input;
+
+    D3DXVECTOR3 subjectPos;
+    float subjectHeading = 0.0f;
+
+    GetCameraInput(g_actionMap, mouse.xPosRelative(), mouse.yPosRelative(), input);
+    g_cameraController.update(input, elapsedTimeSec, g_camera);
+
+    // The rig eases orbit and follow cameras towards where the input put
+    // them, and keeps the follow camera on the subject. It leaves the other
+    // behaviors alone. The subject is relative to the scene's origin.
+
+    g_followSubjectTimeSec += elapsedTimeSec;
+    GetFollowSubject(g_followSubjectTimeSec, subjectPos, subjectHeading);
+
+    subjectPos = WorldOffset(ToWorldPosition(g_scenePosition) + subjectPos, g_camera.getOrigin());
+    g_cameraRig.setSubject(subjectPos, subjectHeading);
+    g_cameraRig.update(elapsedTimeSec, g_camera);
 }
 
-void UpdateEffect()
+void UpdateEffect(const FrameState &frame)
 {
     D3DXMATRIX identityMatrix;
-    D3DXMATRIX viewProjMatrix;
     
     D3DXMatrixIdentity(&identityMatrix);
-    viewProjMatrix = g_camera.getViewMatrix() * g_camera.getProjectionMatrix();
 
-    // The floor is centered about the world origin and doesn't move.
-    // We can just use the identity matrix here for both the world and
-    // normal matrices. The normal matrix is the transpose of the inverse of
-    // the world matrix and is used to transform the mesh's normal vectors.
-    // But since the floor isn't moving we can just use the identity matrix.
+    // The floor's world matrix only translates the floor to where it is
+    // relative to the frame's camera origin. The normal matrix is the
+    // transpose of the inverse of the world matrix and is used to transform
+    // the mesh's normal vectors. Translations don't affect normals so we can
+    // just use the identity matrix for it.
 
-    g_pEffect->SetMatrix("worldMatrix", &identityMatrix);
+    g_pEffect->SetMatrix("worldMatrix", &frame.floorWorldMatrix);
     g_pEffect->SetMatrix("worldInverseTransposeMatrix", &identityMatrix);
-    g_pEffect->SetMatrix("worldViewProjectionMatrix", &viewProjMatrix);
-
-    g_pEffect->SetValue("cameraPos", &g_camera.getPosition(), sizeof(D3DXVECTOR3));
-    g_pEffect->SetValue("globalAmbient", &g_globalAmbient, sizeof(g_globalAmbient));
-
-    g_pEffect->SetValue("light.dir", g_light.dir, sizeof(g_light.dir));
-    g_pEffect->SetValue("light.pos", g_light.pos, sizeof(g_light.pos));
-    g_pEffect->SetValue("light.ambient", g_light.ambient, sizeof(g_light.ambient));
-    g_pEffect->SetValue("light.diffuse", g_light.diffuse, sizeof(g_light.diffuse));
-    g_pEffect->SetValue("light.specular", g_light.specular, sizeof(g_light.specular));
-    g_pEffect->SetFloat("light.spotInnerCone", g_light.spotInnerCone);
-    g_pEffect->SetFloat("light.spotOuterCone", g_light.spotOuterCone);
-    g_pEffect->SetFloat("light.radius", g_light.radius);
-
-    g_pEffect->SetValue("material.ambient", g_material.ambient, sizeof(g_material.ambient));
-    g_pEffect->SetValue("material.diffuse", g_material.diffuse, sizeof(g_material.diffuse));
-    g_pEffect->SetValue("material.emissive", g_material.emissive, sizeof(g_material.emissive));
-    g_pEffect->SetValue("material.specular", g_material.specular, sizeof(g_material.specular));
-    g_pEffect->SetFloat("material.shininess", g_material.shininess);
+    g_pEffect->SetValue("globalAmbient", frame.globalAmbient, sizeof(frame.globalAmbient));
 
-    if (g_disableColorMapTexture)
-        g_pEffect->SetTexture("colorMapTexture", g_pNullTexture);
-    else
-        g_pEffect->SetTexture("colorMapTexture", g_pColorMapTexture);
+    const Light &light = frame.light;
+
+    g_pEffect->SetValue("light.dir", light.dir, sizeof(light.dir));
+    g_pEffect->SetValue("light.pos", light.pos, sizeof(light.pos));
+    g_pEffect->SetValue("light.ambient", light.ambient, sizeof(light.ambient));
+    g_pEffect->SetValue("light.diffuse", light.diffuse, sizeof(light.diffuse));
+    g_pEffect->SetValue("light.specular", light.specular, sizeof(light.specular));
+    g_pEffect->SetFloat("light.spotInnerCone", light.spotInnerCone);
+    g_pEffect->SetFloat("light.spotOuterCone", light.spotOuterCone);
+    g_pEffect->SetFloat("light.radius", light.radius);
+
+    // The materials themselves are set by BindMaterial() as the draws need
+    // them. Forget the bound material since the color map may have been
+    // toggled.
+
+    float materialTableSize[2] = {static_cast<float>(MATERIAL_TEXELS), static_cast<float>(MAX_MATERIALS)};
+
+    g_boundMaterial = -1;
+    g_pEffect->SetTexture("materialTableTexture", g_pMaterialTableTexture);
+    g_pEffect->SetValue("materialTableSize", materialTableSize, sizeof(materialTableSize));
+    g_pEffect->SetFloat("normalMapReconstructZ", g_normalMapReconstructZ ? 1.0f : 0.0f);
+}
+
+void UpdateEffectView(const FrameState &frame, const CameraView &view)
+{
+    // Only the parameters that differ between the views of a camera set.
 
-    g_pEffect->SetTexture("normalMapTexture", g_pNormalMapTexture);
+    D3DXMATRIX worldViewProjectionMatrix = frame.floorWorldMatrix * view.viewProjectionMatrix;
+
+    g_pEffect->SetMatrix("worldViewProjectionMatrix", &worldViewProjectionMatrix);
+    g_pEffect->SetValue("cameraPos", &view.eye, sizeof(D3DXVECTOR3));
 }
 
 void UpdateFrame(float elapsedTimeSec)
 {
-    Keyboard::instance().update();
-    Mouse::instance().update();
+    if (g_inputPlayback.isOpen())
+    {
+        UpdateInputFromPlayback(elapsedTimeSec);
 
-    ProcessUserInput();
+        if (!g_inputPlayback.isOpen())
+            return;
+    }
+    else
+    {
+        Keyboard::instance().update();
+        Mouse::instance().update();
+
+        if (g_inputRecorder.isOpen())
+            RecordInput(elapsedTimeSec);
+    }
 
+    UpdateActionMap(g_actionMap);
+    ProcessUserInput();
     UpdateFrameRate(elapsedTimeSec);
-    UpdateCamera(elapsedTimeSec);
-    UpdateEffect();
+
+    if (g_isRecordingCameraTrack || g_isPlayingCameraTrack)
+    {
+        if (g_cameraTrackFrames++ == 0)
+            g_cameraTrackStartTime = GetTimeInSeconds();
+        else
+            g_cameraTrackTime += elapsedTimeSec;
+
+        if (g_isPlayingCameraTrack && g_cameraTrackTime > g_cameraTrack.endTime())
+        {
+            CameraTrackFinished();
+            return;
+        }
+    }
+
+    // The camera is updated by SimulateFrame(), either as a job on a worker
+    // thread or right here when the frame pipeline is disabled.
+    g_framePipeline.kick(elapsedTimeSec);
 }
 
 void UpdateFrameRate(float elapsedTimeSec)
@@ -1439,4 +2664,204 @@ void UpdateFrameRate(float elapsedTimeSec)
     {
         ++frames;
     }
+}
+
+void UpdateFrameState(FrameState &frame, float elapsedTimeSec)
+{
+    // Snapshots everything the renderer needs from the simulation. The light
+    // is copied as well so it can be animated here later without racing the
+    // render thread. Materials stay in the material table, which only the
+    // render thread changes; the frame's draws just refer to them, sorted
+    // here rather than on the render thread.
+    //
+    // The frame is drawn from the camera's pose predicted for the time the
+    // frame reaches the screen. That's one frame for the pipelining plus the
+    // frames the GPU is allowed to queue up, i.e. g_maxFrameLatency frames.
+    // Camera tracks are played back exactly as recorded.
+    //
+    // Everything is positioned relative to the camera's origin. In large
+    // world mode the origin is moved to the camera's eye first (camera
+    // relative rendering), so the view matrix has no translation and the
+    // scene's offsets from the eye are calculated in double precision.
+    //
+    // The snapshot camera is handed back to g_camera.advanceFrame() at the
+    // end, so next frame's previous view-projection matrix (for motion
+    // vectors) is the predicted one that was actually drawn, re-expressed
+    // relative to next frame's origin.
+
+    const Mouse &mouse = Mouse::instance();
+    const D3DXVECTOR3 &velocity = g_camera.getCurrentVelocity();
+    bool predict = g_enablePrediction && !g_isPlayingCameraTrack && !CameraRig::isRigged(g_camera);
+    HudStats &stats = frame.stats;
+    Camera camera(g_camera);
+
+    if (predict)
+    {
+        g_cameraPredictor.predict(elapsedTimeSec * g_maxFrameLatency, camera);
+        g_cameraController.clampToBounds(camera);
+    }
+
+    if (g_largeWorld)
+        camera.setOrigin(camera.getWorldPosition());
+
+    WorldPosition sceneOrigin = ToWorldPosition(g_scenePosition);
+    D3DXVECTOR3 floorOffset = WorldOffset(sceneOrigin, camera.getOrigin());
+    D3DXVECTOR3 lightPos = WorldOffset(sceneOrigin
+        + D3DXVECTOR3(g_light.pos[0], g_light.pos[1], g_light.pos[2]), camera.getOrigin());
+
+    D3DXMatrixTranslation(&frame.floorWorldMatrix, floorOffset.x, floorOffset.y, floorOffset.z);
+    frame.floorBoundsCenter = floorOffset + FLOOR_BOUNDS_CENTER;
+
+    // The floor is the only shadow caster there is. With a single light the
+    // casters aren't worth culling in parallel.
+
+    SpotLightViewProjection(lightPos, D3DXVECTOR3(g_light.dir), g_light.spotOuterCone,
+        SHADOW_ZNEAR, g_light.radius, frame.shadowViewProjectionMatrix);
+    g_shadowCasterCuller.cull(0, &frame.shadowViewProjectionMatrix, 1,
+        &frame.floorBoundsCenter, &FLOOR_BOUNDS_RADIUS, 1);
+    frame.floorCastsShadow = !g_shadowCasterCuller.getCasters(0).empty();
+
+    // Deferred shading lights the floor with the spot light and the point
+    // lights, all relative to the camera's origin like the floor.
+
+    frame.lights.clear();
+
+    if (g_enableDeferred)
+    {
+        DeferredLight spotLight;
+
+        spotLight.pos = lightPos;
+        spotLight.radius = g_light.radius;
+        spotLight.dir = D3DXVECTOR3(g_light.dir);
+        spotLight.spotCosOuterCone = cosf(g_light.spotOuterCone * 0.5f);
+        spotLight.color = D3DXVECTOR3(g_light.diffuse);
+        spotLight.spotCosInnerCone = cosf(g_light.spotInnerCone * 0.5f);
+        frame.lights.add(spotLight);
+
+        for (size_t i = 0; i < g_deferredLights.size(); ++i)
+        {
+            DeferredLight light = g_deferredLights[i];
+
+            light.pos = WorldOffset(sceneOrigin + light.pos, camera.getOrigin());
+            frame.lights.add(light);
+        }
+    }
+
+    frame.viewMatrix = camera.getViewMatrix();
+    frame.projectionMatrix = camera.getProjectionMatrix();
+    frame.viewProjectionMatrix = frame.viewMatrix * frame.projectionMatrix;
+    frame.previousViewProjectionMatrix = camera.getPreviousViewProjectionMatrix();
+    frame.cameraPos = camera.getPosition();
+    frame.cameraSet = g_cameraSet;
+    frame.cameraSet.update(camera);
+    frame.light = g_light;
+    frame.light.pos[0] = lightPos.x;
+    frame.light.pos[1] = lightPos.y;
+    frame.light.pos[2] = lightPos.z;
+    frame.draws.clear();
+    frame.draws.add(static_cast<int>(g_materialTable.getMaterial(g_floorMaterial).textureSet),
+        g_floorMaterial, 0);
+    frame.draws.sort();
+    memcpy(frame.globalAmbient, g_globalAmbient, sizeof(frame.globalAmbient));
+
+    g_camera.advanceFrame(camera);
+
+    // Zero the padding bytes too so the snapshots can be memcmp()'d.
+    memset(&stats, 0, sizeof(stats));
+
+    stats.inputLatencyMs = g_inputLatencyMs;
+    stats.position[0] = g_camera.getPosition().x;
+    stats.position[1] = g_camera.getPosition().y;
+    stats.position[2] = g_camera.getPosition().z;
+    stats.velocity[0] = velocity.x;
+    stats.velocity[1] = velocity.y;
+    stats.velocity[2] = velocity.z;
+    stats.behavior = g_camera.getBehavior();
+    stats.rotationSpeed = g_camera.getRotationSpeed();
+    stats.prediction = predict ? 1 : 0;
+    stats.predictionConfidence = predict ? g_cameraPredictor.getConfidence() : 0.0f;
+    stats.weightModifier = mouse.weightModifier();
+    stats.mouseSmoothing = mouse.isMouseSmoothing() ? 1 : 0;
+    stats.mouseRawInput = mouse.isRawInput() ? 1 : 0;
+}
+
+void UpdateInputFromPlayback(float &elapsedTimeSec)
+{
+    // Replaces the device input and the measured frame time with the next
+    // recorded frame. Closes the playback once the log has been consumed.
+
+    InputFrame frame;
+    DIMOUSESTATE mouseState;
+
+    if (g_inputPlayback.frameCount() == 0)
+        g_playbackStartTime = GetTimeInSeconds();
+
+    if (!g_inputPlayback.read(frame))
+    {
+        PlaybackFinished();
+        return;
+    }
+
+    mouseState.lX = frame.mouseX;
+    mouseState.lY = frame.mouseY;
+    mouseState.lZ = frame.mouseWheel;
+    memcpy(mouseState.rgbButtons, frame.mouseButtons, sizeof(mouseState.rgbButtons));
+
+    // Replaying the key and button taps and the individual mouse reports
+    // makes the replay match the recording even for keys tapped between two
+    // frames and for sessions recorded with -rawmouse.
+
+    Keyboard::instance().update(frame.keyStates, frame.keyTaps);
+    Mouse::instance().update(mouseState, frame.mouseButtonTaps, frame.mouseRawInput,
+        frame.pMouseReports, frame.mouseReportCount);
+
+    elapsedTimeSec = frame.elapsedTimeSec;
+}
+
+void UpdateInputLatency()
+{
+    // Measures the time between the device reporting an input event and the
+    // camera being updated in response to it. The worst case for the events
+    // consumed this frame is displayed. The value is held when the frame
+    // didn't receive any input. The event times are in the same high
+    // resolution time base as GetTimeInSeconds().
+
+    double now = GetTimeInSeconds();
+    double maxLatency = 0.0;
+    bool hasEvents = false;
+    InputEvent event;
+
+    while (g_inputEvents.pop(event))
+    {
+        double latency = now - event.time;
+
+        if (latency > maxLatency)
+            maxLatency = latency;
+
+        hasEvents = true;
+    }
+
+    if (hasEvents)
+        g_inputLatencyMs = static_cast<float>(maxLatency * 1000.0);
+}
+
+void UploadMaterials(void *pContext, int first, int count, const PackedMaterial *pMaterials)
+{
+    // Copies a range of the material table into the material table texture.
+    // Only the locked rows are sent to the card.
+
+    IDirect3DTexture9 *pTexture = static_cast<IDirect3DTexture9 *>(pContext);
+    RECT rect = {0, first, MATERIAL_TEXELS, first + count};
+    D3DLOCKED_RECT lockedRect;
+
+    if (!pTexture || FAILED(pTexture->LockRect(0, &lockedRect, &rect, 0)))
+        return;
+
+    for (int i = 0; i < count; ++i)
+    {
+        memcpy(static_cast<BYTE *>(lockedRect.pBits) + i * lockedRect.Pitch,
+            &pMaterials[i], sizeof(PackedMaterial));
+    }
+
+    pTexture->UnlockRect(0);
 }
\ No newline at end of file
@@ -0,0 +1,206 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cstring>
+#include <xmmintrin.h>
+#include "material_table.h"
+
+//-----------------------------------------------------------------------------
+// MaterialTable.
+//-----------------------------------------------------------------------------
+
+MaterialTable::MaterialTable()
+{
+    m_pMaterials = 0;
+    m_capacity = 0;
+    m_count = 0;
+    m_uploadRangeCount = 0;
+    m_isDirty = false;
+}
+
+MaterialTable::~MaterialTable()
+{
+    destroy();
+}
+
+int MaterialTable::add(const PackedMaterial &material)
+{
+    // Returns the new material's index, or -1 when the table is full.
+
+    if (m_count == m_capacity)
+        return -1;
+
+    m_pMaterials[m_count] = material;
+    markDirty(m_count);
+    return m_count++;
+}
+
+bool MaterialTable::create(int capacity)
+{
+    destroy();
+
+    if (capacity <= 0 || capacity > MAX_CAPACITY)
+        return false;
+
+    m_pMaterials = static_cast<PackedMaterial *>(_mm_malloc(capacity * sizeof(PackedMaterial), 16));
+
+    if (!m_pMaterials)
+        return false;
+
+    memset(m_pMaterials, 0, capacity * sizeof(PackedMaterial));
+    m_dirtyBlocks.assign((capacity + DIRTY_BLOCK_SIZE - 1) / DIRTY_BLOCK_SIZE, 0);
+    m_capacity = capacity;
+    return true;
+}
+
+void MaterialTable::destroy()
+{
+    if (m_pMaterials)
+    {
+        _mm_free(m_pMaterials);
+        m_pMaterials = 0;
+    }
+
+    m_dirtyBlocks.clear();
+    m_capacity = 0;
+    m_count = 0;
+    m_uploadRangeCount = 0;
+    m_isDirty = false;
+}
+
+void MaterialTable::set(int index, const PackedMaterial &material)
+{
+    if (index < 0 || index >= m_count)
+        return;
+
+    m_pMaterials[index] = material;
+    markDirty(index);
+}
+
+int MaterialTable::upload(UploadFunc pfnUpload, void *pContext)
+{
+    // Returns the number of bytes handed to the upload function. Ranges
+    // never extend past the last material that has been added.
+
+    int bytes = 0;
+
+    m_uploadRangeCount = 0;
+
+    if (!m_isDirty)
+        return 0;
+
+    int blockCount = static_cast<int>(m_dirtyBlocks.size());
+
+    for (int block = 0; block < blockCount; )
+    {
+        if (!m_dirtyBlocks[block])
+        {
+            ++block;
+            continue;
+        }
+
+        int firstBlock = block;
+
+        while (block < blockCount && m_dirtyBlocks[block])
+            m_dirtyBlocks[block++] = 0;
+
+        int first = firstBlock * DIRTY_BLOCK_SIZE;
+        int last = block * DIRTY_BLOCK_SIZE;
+
+        last = (last > m_count) ? m_count : last;
+
+        if (pfnUpload)
+            pfnUpload(pContext, first, last - first, &m_pMaterials[first]);
+
+        bytes += (last - first) * static_cast<int>(sizeof(PackedMaterial));
+        ++m_uploadRangeCount;
+    }
+
+    m_isDirty = false;
+    return bytes;
+}
+
+void MaterialTable::markDirty(int index)
+{
+    m_dirtyBlocks[index / DIRTY_BLOCK_SIZE] = 1;
+    m_isDirty = true;
+}
+
+//-----------------------------------------------------------------------------
+// DrawQueue.
+//-----------------------------------------------------------------------------
+
+DrawQueue::DrawQueue()
+{
+}
+
+DrawQueue::~DrawQueue()
+{
+}
+
+void DrawQueue::add(int textureSet, int material, int object)
+{
+    unsigned long long key = (static_cast<unsigned long long>(textureSet & 0xffff) << 48)
+        | (static_cast<unsigned long long>(material & 0xffff) << 32)
+        | static_cast<unsigned int>(object);
+
+    m_keys.push_back(key);
+}
+
+void DrawQueue::clear()
+{
+    m_keys.clear();
+}
+
+int DrawQueue::countMaterialSwitches() const
+{
+    // The first draw's material counts as a switch too.
+
+    int switches = 0;
+
+    for (size_t i = 0; i < m_keys.size(); ++i)
+    {
+        if (i == 0 || (m_keys[i] >> 32) != (m_keys[i - 1] >> 32))
+            ++switches;
+    }
+
+    return switches;
+}
+
+int DrawQueue::countTextureSetSwitches() const
+{
+    int switches = 0;
+
+    for (size_t i = 0; i < m_keys.size(); ++i)
+    {
+        if (i == 0 || (m_keys[i] >> 48) != (m_keys[i - 1] >> 48))
+            ++switches;
+    }
+
+    return switches;
+}
+
+void DrawQueue::sort()
+{
+    std::sort(m_keys.begin(), m_keys.end());
+}
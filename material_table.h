@@ -0,0 +1,159 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(MATERIAL_TABLE_H)
+#define MATERIAL_TABLE_H
+
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// A material as stored in a MaterialTable. It's 5 float4s with no padding
+// between the members, so every material in a 16-byte aligned table is 16-byte
+// aligned as well. Its first 68 bytes (up to and including shininess) have
+// the same layout as the normal mapping effect's Material struct and can be
+// set with a single ID3DXEffect::SetValue() call. textureSet is the index of
+// the material's color and normal maps in the application's list of texture
+// sets. It's stored as a float so the whole material can be copied into a
+// floating point texture.
+//-----------------------------------------------------------------------------
+
+struct PackedMaterial
+{
+    float ambient[4];
+    float diffuse[4];
+    float emissive[4];
+    float specular[4];
+    float shininess;
+    float textureSet;
+    float reserved[2];
+};
+
+//-----------------------------------------------------------------------------
+// The MaterialTable class keeps all of the materials in one contiguous,
+// 16-byte aligned block of memory. Draws refer to materials by their index
+// in the table.
+//
+// Changed materials are tracked in blocks of DIRTY_BLOCK_SIZE materials.
+// upload() hands each run of consecutive dirty blocks to an upload function
+// as one range and then marks the table clean. The upload function copies
+// the range to wherever the renderer keeps its copy of the table (e.g., a
+// texture). A null upload function just marks the table clean.
+//-----------------------------------------------------------------------------
+
+class MaterialTable
+{
+public:
+    enum { DIRTY_BLOCK_SIZE = 16, MAX_CAPACITY = 65536 };
+
+    typedef void (*UploadFunc)(void *pContext, int first, int count,
+                               const PackedMaterial *pMaterials);
+
+    MaterialTable();
+    ~MaterialTable();
+
+    int add(const PackedMaterial &material);
+    bool create(int capacity);
+    void destroy();
+    void set(int index, const PackedMaterial &material);
+    int upload(UploadFunc pfnUpload, void *pContext);
+
+    // Getter methods.
+
+    int getCapacity() const;
+    int getCount() const;
+    const PackedMaterial &getMaterial(int index) const;
+    int getUploadRangeCount() const;
+
+private:
+    typedef char PackedMaterialMustBe80Bytes[sizeof(PackedMaterial) == 80 ? 1 : -1];
+
+    MaterialTable(const MaterialTable &);
+    MaterialTable &operator=(const MaterialTable &);
+
+    void markDirty(int index);
+
+    PackedMaterial *m_pMaterials;
+    std::vector<unsigned char> m_dirtyBlocks;
+    int m_capacity;
+    int m_count;
+    int m_uploadRangeCount;
+    bool m_isDirty;
+};
+
+//-----------------------------------------------------------------------------
+// The DrawQueue class holds a frame's draws and sorts them so that state
+// changes happen as rarely as possible: by texture set first, since texture
+// changes cost the most, then by material, and then by object. Each draw is
+// a single 64-bit sort key, so sorting only ever moves integers around.
+// Texture sets and materials must be below 65536.
+//-----------------------------------------------------------------------------
+
+class DrawQueue
+{
+public:
+    DrawQueue();
+    ~DrawQueue();
+
+    void add(int textureSet, int material, int object);
+    void clear();
+    int countMaterialSwitches() const;
+    int countTextureSetSwitches() const;
+    void sort();
+
+    // Getter methods.
+
+    int getCount() const;
+    int getMaterial(int i) const;
+    int getObject(int i) const;
+    int getTextureSet(int i) const;
+
+private:
+    std::vector<unsigned long long> m_keys;
+};
+
+//-----------------------------------------------------------------------------
+
+inline int MaterialTable::getCapacity() const
+{ return m_capacity; }
+
+inline int MaterialTable::getCount() const
+{ return m_count; }
+
+inline const PackedMaterial &MaterialTable::getMaterial(int index) const
+{ return m_pMaterials[index]; }
+
+inline int MaterialTable::getUploadRangeCount() const
+{ return m_uploadRangeCount; }
+
+inline int DrawQueue::getCount() const
+{ return static_cast<int>(m_keys.size()); }
+
+inline int DrawQueue::getMaterial(int i) const
+{ return static_cast<int>((m_keys[i] >> 32) & 0xffff); }
+
+inline int DrawQueue::getObject(int i) const
+{ return static_cast<int>(m_keys[i] & 0xffffffff); }
+
+inline int DrawQueue::getTextureSet(int i) const
+{ return static_cast<int>(m_keys[i] >> 48); }
+
+#endif
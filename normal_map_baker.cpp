@@ -0,0 +1,643 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include "job_system.h"
+#include "normal_map_baker.h"
+
+namespace
+{
+    // Texels are inside a low polygon triangle when their barycentric
+    // coordinates are at least this, so that texels on a shared edge aren't
+    // missed by both triangles.
+    const float TEXEL_INSIDE_EPSILON = -1e-5f;
+
+    const int MAX_TRAVERSAL_DEPTH = 64;
+
+    struct CentroidLess
+    {
+        CentroidLess(const std::vector<D3DXVECTOR3> &centroids, int axis)
+            : m_centroids(centroids), m_axis(axis) {}
+
+        bool operator()(int a, int b) const
+        {
+            return (&m_centroids[a].x)[m_axis] < (&m_centroids[b].x)[m_axis];
+        }
+
+        const std::vector<D3DXVECTOR3> &m_centroids;
+        int m_axis;
+    };
+
+    inline bool RayHitsBox(const D3DXVECTOR3 &origin, const D3DXVECTOR3 &invDir,
+                           const D3DXVECTOR3 &boundsMin, const D3DXVECTOR3 &boundsMax,
+                           float maxT, float &entryT)
+    {
+        // Slab test. Axis parallel rays get infinite inverse directions,
+        // which the comparisons handle.
+
+        float t0 = (boundsMin.x - origin.x) * invDir.x;
+        float t1 = (boundsMax.x - origin.x) * invDir.x;
+        float tMin = (t0 < t1) ? t0 : t1;
+        float tMax = (t0 < t1) ? t1 : t0;
+
+        t0 = (boundsMin.y - origin.y) * invDir.y;
+        t1 = (boundsMax.y - origin.y) * invDir.y;
+        tMin = ((t0 < t1 ? t0 : t1) > tMin) ? (t0 < t1 ? t0 : t1) : tMin;
+        tMax = ((t0 < t1 ? t1 : t0) < tMax) ? (t0 < t1 ? t1 : t0) : tMax;
+
+        t0 = (boundsMin.z - origin.z) * invDir.z;
+        t1 = (boundsMax.z - origin.z) * invDir.z;
+        tMin = ((t0 < t1 ? t0 : t1) > tMin) ? (t0 < t1 ? t0 : t1) : tMin;
+        tMax = ((t0 < t1 ? t1 : t0) < tMax) ? (t0 < t1 ? t1 : t0) : tMax;
+
+        entryT = tMin;
+        return tMax >= tMin && tMax >= 0.0f && tMin <= maxT;
+    }
+
+    inline float SafeInverse(float value)
+    {
+        return (value != 0.0f) ? 1.0f / value : FLT_MAX;
+    }
+
+    inline unsigned short ToUnorm16(float value)
+    {
+        float scaled = (value * 0.5f + 0.5f) * 65535.0f + 0.5f;
+
+        scaled = (scaled < 0.0f) ? 0.0f : ((scaled > 65535.0f) ? 65535.0f : scaled);
+        return static_cast<unsigned short>(scaled);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// TriangleBvh.
+//-----------------------------------------------------------------------------
+
+TriangleBvh::TriangleBvh()
+{
+}
+
+TriangleBvh::~TriangleBvh()
+{
+    destroy();
+}
+
+void TriangleBvh::build(const D3DXVECTOR3 *pPositions, const D3DXVECTOR3 *pNormals,
+                        const int *pIndices, int triangleCount)
+{
+    destroy();
+
+    if (triangleCount <= 0)
+        return;
+
+    m_order.resize(triangleCount);
+    m_centroids.resize(triangleCount);
+    m_boundsMins.resize(triangleCount);
+    m_boundsMaxs.resize(triangleCount);
+
+    for (int i = 0; i < triangleCount; ++i)
+    {
+        const D3DXVECTOR3 &p0 = pPositions[pIndices[i * 3 + 0]];
+        const D3DXVECTOR3 &p1 = pPositions[pIndices[i * 3 + 1]];
+        const D3DXVECTOR3 &p2 = pPositions[pIndices[i * 3 + 2]];
+
+        m_order[i] = i;
+        m_centroids[i] = (p0 + p1 + p2) * (1.0f / 3.0f);
+        D3DXVec3Minimize(&m_boundsMins[i], &p0, &p1);
+        D3DXVec3Minimize(&m_boundsMins[i], &m_boundsMins[i], &p2);
+        D3DXVec3Maximize(&m_boundsMaxs[i], &p0, &p1);
+        D3DXVec3Maximize(&m_boundsMaxs[i], &m_boundsMaxs[i], &p2);
+    }
+
+    // A tree with leaves of at least half of MAX_LEAF_TRIANGLES has fewer
+    // than this many nodes.
+
+    m_nodes.reserve(4 * triangleCount / MAX_LEAF_TRIANGLES + 1);
+    m_nodes.push_back(Node());
+    buildNode(0, 0, triangleCount);
+
+    // Copy the triangles in leaf order.
+
+    m_triangles.resize(triangleCount);
+    m_normals.resize(triangleCount);
+
+    for (int i = 0; i < triangleCount; ++i)
+    {
+        int triangle = m_order[i];
+        int i0 = pIndices[triangle * 3 + 0];
+        int i1 = pIndices[triangle * 3 + 1];
+        int i2 = pIndices[triangle * 3 + 2];
+
+        m_triangles[i].v0 = pPositions[i0];
+        m_triangles[i].edge1 = pPositions[i1] - pPositions[i0];
+        m_triangles[i].edge2 = pPositions[i2] - pPositions[i0];
+
+        if (pNormals)
+        {
+            m_normals[i].n0 = pNormals[i0];
+            m_normals[i].n1 = pNormals[i1];
+            m_normals[i].n2 = pNormals[i2];
+        }
+        else
+        {
+            D3DXVECTOR3 faceNormal;
+
+            D3DXVec3Cross(&faceNormal, &m_triangles[i].edge1, &m_triangles[i].edge2);
+            D3DXVec3Normalize(&faceNormal, &faceNormal);
+            m_normals[i].n0 = faceNormal;
+            m_normals[i].n1 = faceNormal;
+            m_normals[i].n2 = faceNormal;
+        }
+    }
+
+    // The per triangle build data isn't needed any more.
+
+    std::vector<int>().swap(m_order);
+    std::vector<D3DXVECTOR3>().swap(m_centroids);
+    std::vector<D3DXVECTOR3>().swap(m_boundsMins);
+    std::vector<D3DXVECTOR3>().swap(m_boundsMaxs);
+}
+
+void TriangleBvh::destroy()
+{
+    m_nodes.clear();
+    m_triangles.clear();
+    m_normals.clear();
+}
+
+bool TriangleBvh::intersect(const D3DXVECTOR3 &origin, const D3DXVECTOR3 &dir,
+                            float maxT, Hit &hit) const
+{
+    // Finds the nearest hit within maxT. The nearer child of each interior
+    // node is visited first so that maxT shrinks as early as possible.
+
+    if (m_nodes.empty())
+        return false;
+
+    D3DXVECTOR3 invDir(SafeInverse(dir.x), SafeInverse(dir.y), SafeInverse(dir.z));
+    int stack[MAX_TRAVERSAL_DEPTH];
+    int stackSize = 0;
+    int node = 0;
+    float entryT = 0.0f;
+    bool found = false;
+
+    if (!RayHitsBox(origin, invDir, m_nodes[0].boundsMin, m_nodes[0].boundsMax, maxT, entryT))
+        return false;
+
+    for (;;)
+    {
+        const Node &current = m_nodes[node];
+
+        if (current.count > 0)
+        {
+            // Moller-Trumbore ray-triangle test.
+
+            for (int i = current.first; i < current.first + current.count; ++i)
+            {
+                const Triangle &triangle = m_triangles[i];
+                D3DXVECTOR3 p;
+                D3DXVECTOR3 q;
+                D3DXVECTOR3 s = origin - triangle.v0;
+
+                D3DXVec3Cross(&p, &dir, &triangle.edge2);
+
+                float det = D3DXVec3Dot(&triangle.edge1, &p);
+
+                if (fabsf(det) < 1e-12f)
+                    continue;
+
+                float invDet = 1.0f / det;
+                float u = D3DXVec3Dot(&s, &p) * invDet;
+
+                if (u < 0.0f || u > 1.0f)
+                    continue;
+
+                D3DXVec3Cross(&q, &s, &triangle.edge1);
+
+                float v = D3DXVec3Dot(&dir, &q) * invDet;
+
+                if (v < 0.0f || u + v > 1.0f)
+                    continue;
+
+                float t = D3DXVec3Dot(&triangle.edge2, &q) * invDet;
+
+                if (t < 0.0f || t > maxT)
+                    continue;
+
+                maxT = t;
+                hit.triangle = i;
+                hit.t = t;
+                hit.u = u;
+                hit.v = v;
+                found = true;
+            }
+        }
+        else
+        {
+            int first = node + 1;
+            int second = current.first;
+            float firstT = 0.0f;
+            float secondT = 0.0f;
+            bool hitsFirst = RayHitsBox(origin, invDir, m_nodes[first].boundsMin,
+                m_nodes[first].boundsMax, maxT, firstT);
+            bool hitsSecond = RayHitsBox(origin, invDir, m_nodes[second].boundsMin,
+                m_nodes[second].boundsMax, maxT, secondT);
+
+            if (hitsFirst && hitsSecond)
+            {
+                if (secondT < firstT)
+                {
+                    int temp = first;
+
+                    first = second;
+                    second = temp;
+                }
+
+                if (stackSize < MAX_TRAVERSAL_DEPTH)
+                    stack[stackSize++] = second;
+
+                node = first;
+                continue;
+            }
+
+            if (hitsFirst || hitsSecond)
+            {
+                node = hitsFirst ? first : second;
+                continue;
+            }
+        }
+
+        if (stackSize == 0)
+            break;
+
+        node = stack[--stackSize];
+    }
+
+    return found;
+}
+
+D3DXVECTOR3 TriangleBvh::normal(const Hit &hit) const
+{
+    const TriangleNormals &normals = m_normals[hit.triangle];
+    D3DXVECTOR3 n = normals.n0 * (1.0f - hit.u - hit.v) + normals.n1 * hit.u + normals.n2 * hit.v;
+
+    D3DXVec3Normalize(&n, &n);
+    return n;
+}
+
+void TriangleBvh::buildNode(int node, int first, int count)
+{
+    // m_nodes may grow during the recursion, so nodes are only ever
+    // referred to by index here.
+
+    D3DXVECTOR3 boundsMin(FLT_MAX, FLT_MAX, FLT_MAX);
+    D3DXVECTOR3 boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    D3DXVECTOR3 centroidMin(FLT_MAX, FLT_MAX, FLT_MAX);
+    D3DXVECTOR3 centroidMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+    for (int i = first; i < first + count; ++i)
+    {
+        int triangle = m_order[i];
+
+        D3DXVec3Minimize(&boundsMin, &boundsMin, &m_boundsMins[triangle]);
+        D3DXVec3Maximize(&boundsMax, &boundsMax, &m_boundsMaxs[triangle]);
+        D3DXVec3Minimize(&centroidMin, &centroidMin, &m_centroids[triangle]);
+        D3DXVec3Maximize(&centroidMax, &centroidMax, &m_centroids[triangle]);
+    }
+
+    m_nodes[node].boundsMin = boundsMin;
+    m_nodes[node].boundsMax = boundsMax;
+
+    D3DXVECTOR3 extent = centroidMax - centroidMin;
+    int axis = (extent.x > extent.y) ? ((extent.x > extent.z) ? 0 : 2) : ((extent.y > extent.z) ? 1 : 2);
+
+    // All of the centroids in the same place can't be split any further.
+
+    if (count <= MAX_LEAF_TRIANGLES || (&extent.x)[axis] <= 0.0f)
+    {
+        m_nodes[node].first = first;
+        m_nodes[node].count = count;
+        return;
+    }
+
+    int half = count / 2;
+
+    std::nth_element(m_order.begin() + first, m_order.begin() + first + half,
+        m_order.begin() + first + count, CentroidLess(m_centroids, axis));
+
+    m_nodes[node].count = 0;
+    m_nodes.push_back(Node());
+    buildNode(node + 1, first, half);
+
+    int second = static_cast<int>(m_nodes.size());
+
+    m_nodes[node].first = second;
+    m_nodes.push_back(Node());
+    buildNode(second, first + half, count - half);
+}
+
+//-----------------------------------------------------------------------------
+// NormalMapBaker.
+//-----------------------------------------------------------------------------
+
+NormalMapBaker::NormalMapBaker()
+{
+    m_pHighPolyMesh = 0;
+    m_maxDistance = 0.0f;
+    m_width = 0;
+    m_height = 0;
+    m_coveredTexelCount = 0;
+    m_hitCount = 0;
+}
+
+NormalMapBaker::~NormalMapBaker()
+{
+    destroy();
+}
+
+bool NormalMapBaker::bake(JobSystem *pJobSystem, const NormalMappedQuad::Vertex *pVertices,
+                          int vertexCount, const TriangleBvh &highPolyMesh,
+                          int width, int height, float maxDistance)
+{
+    // Pass a null job system to bake on the calling thread.
+
+    destroy();
+
+    if (width <= 0 || height <= 0 || vertexCount < 3)
+        return false;
+
+    m_pHighPolyMesh = &highPolyMesh;
+    m_maxDistance = maxDistance;
+    m_width = width;
+    m_height = height;
+    m_normals.resize(width * height, D3DXVECTOR2(0.0f, 0.0f));
+
+    int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+    m_tiles.resize(tilesX * tilesY);
+
+    for (int i = 0; i < tilesX * tilesY; ++i)
+    {
+        m_tiles[i].pBaker = this;
+        m_tiles[i].x = (i % tilesX) * TILE_SIZE;
+        m_tiles[i].y = (i / tilesX) * TILE_SIZE;
+        m_tiles[i].coveredTexels = 0;
+        m_tiles[i].hits = 0;
+    }
+
+    // Set up the low polygon triangles for the texel coverage tests and bin
+    // them into the tiles their texture space bounds overlap.
+
+    for (int i = 0; i + 2 < vertexCount; i += 3)
+    {
+        LowPolyTriangle triangle;
+
+        for (int j = 0; j < 3; ++j)
+            triangle.pVertices[j] = &pVertices[i + j];
+
+        D3DXVECTOR2 texCoord1(pVertices[i + 1].texCoord[0], pVertices[i + 1].texCoord[1]);
+        D3DXVECTOR2 texCoord2(pVertices[i + 2].texCoord[0], pVertices[i + 2].texCoord[1]);
+
+        triangle.texCoord0 = D3DXVECTOR2(pVertices[i].texCoord[0], pVertices[i].texCoord[1]);
+        triangle.texEdge1 = texCoord1 - triangle.texCoord0;
+        triangle.texEdge2 = texCoord2 - triangle.texCoord0;
+
+        float det = triangle.texEdge1.x * triangle.texEdge2.y - triangle.texEdge1.y * triangle.texEdge2.x;
+
+        if (fabsf(det) < 1e-12f)
+            continue;
+
+        triangle.invDet = 1.0f / det;
+
+        float minU = triangle.texCoord0.x;
+        float maxU = triangle.texCoord0.x;
+        float minV = triangle.texCoord0.y;
+        float maxV = triangle.texCoord0.y;
+
+        minU = (texCoord1.x < minU) ? texCoord1.x : minU;
+        minU = (texCoord2.x < minU) ? texCoord2.x : minU;
+        maxU = (texCoord1.x > maxU) ? texCoord1.x : maxU;
+        maxU = (texCoord2.x > maxU) ? texCoord2.x : maxU;
+        minV = (texCoord1.y < minV) ? texCoord1.y : minV;
+        minV = (texCoord2.y < minV) ? texCoord2.y : minV;
+        maxV = (texCoord1.y > maxV) ? texCoord1.y : maxV;
+        maxV = (texCoord2.y > maxV) ? texCoord2.y : maxV;
+
+        int left = static_cast<int>(floorf(minU * width)) / TILE_SIZE;
+        int right = static_cast<int>(floorf(maxU * width)) / TILE_SIZE;
+        int top = static_cast<int>(floorf(minV * height)) / TILE_SIZE;
+        int bottom = static_cast<int>(floorf(maxV * height)) / TILE_SIZE;
+
+        left = (left < 0) ? 0 : left;
+        top = (top < 0) ? 0 : top;
+        right = (right >= tilesX) ? tilesX - 1 : right;
+        bottom = (bottom >= tilesY) ? tilesY - 1 : bottom;
+
+        int index = static_cast<int>(m_triangles.size());
+
+        m_triangles.push_back(triangle);
+
+        for (int y = top; y <= bottom; ++y)
+        {
+            for (int x = left; x <= right; ++x)
+                m_tiles[y * tilesX + x].triangles.push_back(index);
+        }
+    }
+
+    int tileCount = static_cast<int>(m_tiles.size());
+
+    if (pJobSystem)
+    {
+        JobCounter counter;
+
+        for (int i = 0; i < tileCount; ++i)
+            pJobSystem->submit(bakeTileJob, &m_tiles[i], &counter);
+
+        pJobSystem->wait(&counter);
+    }
+    else
+    {
+        for (int i = 0; i < tileCount; ++i)
+            bakeTile(m_tiles[i]);
+    }
+
+    for (int i = 0; i < tileCount; ++i)
+    {
+        m_coveredTexelCount += m_tiles[i].coveredTexels;
+        m_hitCount += m_tiles[i].hits;
+    }
+
+    return true;
+}
+
+void NormalMapBaker::destroy()
+{
+    m_normals.clear();
+    m_triangles.clear();
+    m_tiles.clear();
+    m_pHighPolyMesh = 0;
+    m_width = 0;
+    m_height = 0;
+    m_coveredTexelCount = 0;
+    m_hitCount = 0;
+}
+
+bool NormalMapBaker::save(const char *pszFilename) const
+{
+    // An uncompressed DDS file without mipmaps. The 32-bit RGB pixel format
+    // with 16-bit red and green masks is loaded by D3DX as D3DFMT_G16R16.
+
+    if (m_normals.empty())
+        return false;
+
+    FILE *pFile = fopen(pszFilename, "wb");
+
+    if (!pFile)
+        return false;
+
+    unsigned int header[32] = {0};
+
+    header[0] = 0x20534444;                                 // "DDS "
+    header[1] = 124;                                        // header size
+    header[2] = 0x0000100f;                                 // caps, height, width, pitch, pixel format
+    header[3] = m_height;
+    header[4] = m_width;
+    header[5] = m_width * 4;                                // pitch
+    header[19] = 32;                                        // pixel format size
+    header[20] = 0x00000040;                                // RGB
+    header[22] = 32;                                        // bits per pixel
+    header[23] = 0x0000ffff;                                // red mask
+    header[24] = 0xffff0000;                                // green mask
+    header[27] = 0x00001000;                                // texture
+
+    bool ok = fwrite(header, sizeof(header), 1, pFile) == 1;
+    std::vector<unsigned short> row(m_width * 2);
+
+    for (int y = 0; ok && y < m_height; ++y)
+    {
+        for (int x = 0; x < m_width; ++x)
+        {
+            const D3DXVECTOR2 &normal = m_normals[y * m_width + x];
+
+            row[x * 2 + 0] = ToUnorm16(normal.x);
+            row[x * 2 + 1] = ToUnorm16(normal.y);
+        }
+
+        ok = fwrite(&row[0], sizeof(unsigned short), row.size(), pFile) == row.size();
+    }
+
+    if (fclose(pFile) != 0)
+        ok = false;
+
+    return ok;
+}
+
+void NormalMapBaker::bakeTileJob(void *pData)
+{
+    Tile *pTile = static_cast<Tile *>(pData);
+
+    pTile->pBaker->bakeTile(*pTile);
+}
+
+void NormalMapBaker::bakeTile(Tile &tile)
+{
+    // Tiles write to disjoint texels and counters of their own, so they run
+    // in parallel without any locking.
+
+    int right = (tile.x + TILE_SIZE < m_width) ? tile.x + TILE_SIZE : m_width;
+    int bottom = (tile.y + TILE_SIZE < m_height) ? tile.y + TILE_SIZE : m_height;
+    int triangleCount = static_cast<int>(tile.triangles.size());
+
+    if (triangleCount == 0)
+        return;
+
+    for (int y = tile.y; y < bottom; ++y)
+    {
+        for (int x = tile.x; x < right; ++x)
+        {
+            D3DXVECTOR2 texCoord((x + 0.5f) / m_width, (y + 0.5f) / m_height);
+
+            for (int i = 0; i < triangleCount; ++i)
+            {
+                const LowPolyTriangle &triangle = m_triangles[tile.triangles[i]];
+                D3DXVECTOR2 offset = texCoord - triangle.texCoord0;
+                float b1 = (offset.x * triangle.texEdge2.y - offset.y * triangle.texEdge2.x) * triangle.invDet;
+                float b2 = (triangle.texEdge1.x * offset.y - triangle.texEdge1.y * offset.x) * triangle.invDet;
+                float b0 = 1.0f - b1 - b2;
+
+                if (b0 < TEXEL_INSIDE_EPSILON || b1 < TEXEL_INSIDE_EPSILON || b2 < TEXEL_INSIDE_EPSILON)
+                    continue;
+
+                // The low polygon surface point and its tangent frame, built
+                // the same way as in the normal mapping vertex shaders.
+
+                const NormalMappedQuad::Vertex &v0 = *triangle.pVertices[0];
+                const NormalMappedQuad::Vertex &v1 = *triangle.pVertices[1];
+                const NormalMappedQuad::Vertex &v2 = *triangle.pVertices[2];
+                D3DXVECTOR3 pos(
+                    v0.pos[0] * b0 + v1.pos[0] * b1 + v2.pos[0] * b2,
+                    v0.pos[1] * b0 + v1.pos[1] * b1 + v2.pos[1] * b2,
+                    v0.pos[2] * b0 + v1.pos[2] * b1 + v2.pos[2] * b2);
+                D3DXVECTOR3 n(
+                    v0.normal[0] * b0 + v1.normal[0] * b1 + v2.normal[0] * b2,
+                    v0.normal[1] * b0 + v1.normal[1] * b1 + v2.normal[1] * b2,
+                    v0.normal[2] * b0 + v1.normal[2] * b1 + v2.normal[2] * b2);
+                D3DXVECTOR3 t(
+                    v0.tangent[0] * b0 + v1.tangent[0] * b1 + v2.tangent[0] * b2,
+                    v0.tangent[1] * b0 + v1.tangent[1] * b1 + v2.tangent[1] * b2,
+                    v0.tangent[2] * b0 + v1.tangent[2] * b1 + v2.tangent[2] * b2);
+                D3DXVECTOR3 b;
+
+                D3DXVec3Normalize(&n, &n);
+                D3DXVec3Normalize(&t, &t);
+                D3DXVec3Cross(&b, &n, &t);
+                b *= v0.tangent[3];
+
+                ++tile.coveredTexels;
+
+                TriangleBvh::Hit hit;
+                D3DXVECTOR3 dir = -n;
+                D3DXVECTOR3 origin = pos + n * m_maxDistance;
+
+                if (m_pHighPolyMesh->intersect(origin, dir, 2.0f * m_maxDistance, hit))
+                {
+                    D3DXVECTOR3 highPolyNormal = m_pHighPolyMesh->normal(hit);
+                    D3DXVECTOR3 tangentSpaceNormal(D3DXVec3Dot(&highPolyNormal, &t),
+                        D3DXVec3Dot(&highPolyNormal, &b), D3DXVec3Dot(&highPolyNormal, &n));
+
+                    // z is rebuilt as a positive value by the shaders.
+
+                    tangentSpaceNormal.z = (tangentSpaceNormal.z < 0.0f) ? 0.0f : tangentSpaceNormal.z;
+                    D3DXVec3Normalize(&tangentSpaceNormal, &tangentSpaceNormal);
+
+                    m_normals[y * m_width + x] = D3DXVECTOR2(tangentSpaceNormal.x, tangentSpaceNormal.y);
+                    ++tile.hits;
+                }
+
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,217 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(NORMAL_MAP_BAKER_H)
+#define NORMAL_MAP_BAKER_H
+
+#include <vector>
+#include "normal_mapping_utils.h"
+
+class JobSystem;
+
+//-----------------------------------------------------------------------------
+// The TriangleBvh class is a bounding volume hierarchy over a triangle mesh
+// for ray casting. It's built by splitting the triangles at the median of
+// their centroids along the longest axis of their bounds until at most
+// MAX_LEAF_TRIANGLES are left. The nodes are stored depth first, so a node's
+// first child directly follows it. The triangles are copied in leaf order as
+// a vertex and two edges, which is what the ray-triangle test needs.
+//
+// The mesh's vertex normals are interpolated at the hit point. Without
+// vertex normals the triangle's face normal is used. intersect() is const
+// and may be called from several threads at once.
+//-----------------------------------------------------------------------------
+
+class TriangleBvh
+{
+public:
+    enum { MAX_LEAF_TRIANGLES = 4 };
+
+    struct Hit
+    {
+        int triangle;
+        float t;
+        float u;
+        float v;
+    };
+
+    TriangleBvh();
+    ~TriangleBvh();
+
+    void build(const D3DXVECTOR3 *pPositions, const D3DXVECTOR3 *pNormals,
+               const int *pIndices, int triangleCount);
+    void destroy();
+    bool intersect(const D3DXVECTOR3 &origin, const D3DXVECTOR3 &dir,
+                   float maxT, Hit &hit) const;
+    D3DXVECTOR3 normal(const Hit &hit) const;
+
+    // Getter methods.
+
+    int getNodeCount() const;
+    int getTriangleCount() const;
+
+private:
+    struct Node
+    {
+        D3DXVECTOR3 boundsMin;
+        int first;              // first triangle (leaf) or second child
+        D3DXVECTOR3 boundsMax;
+        int count;              // 0 for interior nodes
+    };
+
+    struct Triangle
+    {
+        D3DXVECTOR3 v0;
+        D3DXVECTOR3 edge1;
+        D3DXVECTOR3 edge2;
+    };
+
+    struct TriangleNormals
+    {
+        D3DXVECTOR3 n0;
+        D3DXVECTOR3 n1;
+        D3DXVECTOR3 n2;
+    };
+
+    TriangleBvh(const TriangleBvh &);
+    TriangleBvh &operator=(const TriangleBvh &);
+
+    void buildNode(int node, int first, int count);
+
+    std::vector<Node> m_nodes;
+    std::vector<Triangle> m_triangles;
+    std::vector<TriangleNormals> m_normals;
+    std::vector<int> m_order;
+    std::vector<D3DXVECTOR3> m_centroids;
+    std::vector<D3DXVECTOR3> m_boundsMins;
+    std::vector<D3DXVECTOR3> m_boundsMaxs;
+};
+
+//-----------------------------------------------------------------------------
+// The NormalMapBaker class bakes a high polygon mesh's normals into a tangent
+// space normal map for a low polygon mesh.
+//
+// The low polygon mesh is a triangle list of NormalMappedQuad::Vertex
+// vertices, with texture coordinates in [0, 1]. Each texel's center is
+// located on the low polygon triangle that covers it in texture space. A
+// ray is cast from maxDistance above that point, along the interpolated
+// vertex normal, back down through the surface, and the first hit on the
+// high polygon mesh gives the normal. The normal is then expressed in the
+// same tangent frame the normal mapping vertex shaders build:
+// t = tangent.xyz, b = cross(n, t) * tangent.w, and n. Normal maps baked
+// with tools that use a different tangent basis don't light correctly with
+// this project's shaders; baked here they do.
+//
+// Only the tangent space normal's x and y are kept. The shaders rebuild z
+// from them, since z is always positive. save() writes them to a DDS file as
+// a D3DFMT_G16R16 texture. Texels that no low polygon triangle covers, or
+// whose ray misses the high polygon mesh, get the unperturbed normal.
+//
+// bake() splits the normal map into TILE_SIZE x TILE_SIZE texel tiles and
+// bakes the tiles as jobs on a JobSystem. Each tile only tests the low
+// polygon triangles whose texture space bounds overlap it.
+//-----------------------------------------------------------------------------
+
+class NormalMapBaker
+{
+public:
+    enum { TILE_SIZE = 32 };
+
+    NormalMapBaker();
+    ~NormalMapBaker();
+
+    bool bake(JobSystem *pJobSystem, const NormalMappedQuad::Vertex *pVertices,
+              int vertexCount, const TriangleBvh &highPolyMesh,
+              int width, int height, float maxDistance);
+    void destroy();
+    bool save(const char *pszFilename) const;
+
+    // Getter methods.
+
+    int getCoveredTexelCount() const;
+    int getHeight() const;
+    int getHitCount() const;
+    const D3DXVECTOR2 *getNormals() const;
+    int getWidth() const;
+
+private:
+    struct LowPolyTriangle
+    {
+        const NormalMappedQuad::Vertex *pVertices[3];
+        D3DXVECTOR2 texCoord0;
+        D3DXVECTOR2 texEdge1;
+        D3DXVECTOR2 texEdge2;
+        float invDet;
+    };
+
+    struct Tile
+    {
+        NormalMapBaker *pBaker;
+        int x;
+        int y;
+        int coveredTexels;
+        int hits;
+        std::vector<int> triangles;
+    };
+
+    NormalMapBaker(const NormalMapBaker &);
+    NormalMapBaker &operator=(const NormalMapBaker &);
+
+    static void bakeTileJob(void *pData);
+
+    void bakeTile(Tile &tile);
+
+    std::vector<D3DXVECTOR2> m_normals;
+    std::vector<LowPolyTriangle> m_triangles;
+    std::vector<Tile> m_tiles;
+    const TriangleBvh *m_pHighPolyMesh;
+    float m_maxDistance;
+    int m_width;
+    int m_height;
+    int m_coveredTexelCount;
+    int m_hitCount;
+};
+
+//-----------------------------------------------------------------------------
+
+inline int TriangleBvh::getNodeCount() const
+{ return static_cast<int>(m_nodes.size()); }
+
+inline int TriangleBvh::getTriangleCount() const
+{ return static_cast<int>(m_triangles.size()); }
+
+inline int NormalMapBaker::getCoveredTexelCount() const
+{ return m_coveredTexelCount; }
+
+inline int NormalMapBaker::getHeight() const
+{ return m_height; }
+
+inline int NormalMapBaker::getHitCount() const
+{ return m_hitCount; }
+
+inline const D3DXVECTOR2 *NormalMapBaker::getNormals() const
+{ return m_normals.empty() ? 0 : &m_normals[0]; }
+
+inline int NormalMapBaker::getWidth() const
+{ return m_width; }
+
+#endif
@@ -49,10 +49,34 @@
 // normals back to the original [-1,1] range we need to perform a scale and a
 // bias. We do this by: tex2D(normalMap, IN.texCoord) * 2.0f - 1.0f.
 //
+// Normal maps baked by this project's NormalMapBaker only store the normal's
+// x and y, in a two channel texture. Set normalMapReconstructZ to 1 for those
+// and the pixel shaders rebuild z from x and y: z = sqrt(1 - x * x - y * y).
+// Tangent space normals never point into the surface, so z is never negative.
+//
 // Light attenuation for the point and spot lighting models is based on a
 // light radius. Light is at its brightest at the center of the sphere defined
 // by the light radius. There is no lighting at the edges of this sphere.
 //
+// The spot light can also cast shadows. The ShadowMapDepth technique renders
+// the light's depth (z/w) into a floating point shadow map, which is one slot
+// of a shadow atlas texture. NormalMappingSpotLightingShadowed then looks the
+// pixel up in the shadow map using shadowMatrix, which transforms world space
+// positions to the slot's texture coordinates, and filters the depth
+// comparisons with a 3x3 percentage closer filter.
+//
+// Deferred shading splits the spot lighting in two. DeferredGBuffer writes
+// the surface's albedo, world space normal (the normal map's tangent space
+// normal transformed by the tangent frame), and depth (z/w) into 3 render
+// targets. DeferredAmbient and DeferredLighting then draw full screen quads
+// that read the G-buffer back. DeferredLighting adds one light per draw and is
+// meant to be drawn with a scissor rectangle around the light. Only the
+// diffuse term is lit per light. The per light ambient term of the forward
+// techniques is left out and the specular term is 0 with this material.
+// The deferred passes read the surface's material from the material table
+// texture, which holds a row of 5 texels per material (ambient, diffuse,
+// emissive, specular, and shininess), at row materialIndex.
+//
 //-----------------------------------------------------------------------------
 
 struct Light
@@ -84,8 +108,21 @@ float4x4 worldMatrix;
 float4x4 worldInverseTransposeMatrix;
 float4x4 worldViewProjectionMatrix;
 
+float4x4 lightViewProjectionMatrix;
+float4x4 shadowMatrix;
+
 float3 cameraPos;
 float4 globalAmbient;
+float shadowBias;
+float shadowTexelSize;
+float normalMapReconstructZ;
+float materialIndex;
+float2 materialTableSize;   // texels per material, materials
+
+float4x4 inverseViewProjectionMatrix;
+float4 viewportRect;        // x, y, width, height in pixels
+float2 gBufferSize;         // width, height in pixels
+float4 deferredLight[3];    // pos, radius; dir, cos outer cone; color, cos inner cone
 
 Light light;
 Material material;
@@ -115,6 +152,58 @@ sampler2D normalMap = sampler_state
     MaxAnisotropy = 16;
 };
 
+texture gBufferAlbedoTexture;
+texture gBufferNormalTexture;
+texture gBufferDepthTexture;
+
+sampler2D gBufferAlbedo = sampler_state
+{
+    Texture = <gBufferAlbedoTexture>;
+    MagFilter = Point;
+    MinFilter = Point;
+    MipFilter = None;
+};
+
+sampler2D gBufferNormal = sampler_state
+{
+    Texture = <gBufferNormalTexture>;
+    MagFilter = Point;
+    MinFilter = Point;
+    MipFilter = None;
+};
+
+sampler2D gBufferDepth = sampler_state
+{
+    Texture = <gBufferDepthTexture>;
+    MagFilter = Point;
+    MinFilter = Point;
+    MipFilter = None;
+};
+
+texture materialTableTexture;
+
+sampler2D materialTable = sampler_state
+{
+    Texture = <materialTableTexture>;
+    MagFilter = Point;
+    MinFilter = Point;
+    MipFilter = None;
+    AddressU = Clamp;
+    AddressV = Clamp;
+};
+
+texture shadowMapTexture;
+
+sampler2D shadowMap = sampler_state
+{
+    Texture = <shadowMapTexture>;
+    MagFilter = Point;
+    MinFilter = Point;
+    MipFilter = None;
+    AddressU = Clamp;
+    AddressV = Clamp;
+};
+
 //-----------------------------------------------------------------------------
 // Vertex Shaders.
 //-----------------------------------------------------------------------------
@@ -158,6 +247,41 @@ struct VS_OUTPUT_SPOT
 	float4 specular : COLOR1;
 };
 
+struct VS_OUTPUT_SPOT_SHADOWED
+{
+	float4 position : POSITION;
+	float2 texCoord : TEXCOORD0;
+	float3 viewDir : TEXCOORD1;
+	float3 lightDir : TEXCOORD2;
+	float3 spotDir : TEXCOORD3;
+	float4 shadowCoord : TEXCOORD4;
+	float4 diffuse : COLOR0;
+	float4 specular : COLOR1;
+};
+
+struct VS_OUTPUT_SHADOW_DEPTH
+{
+	float4 position : POSITION;
+	float2 depth : TEXCOORD0;
+};
+
+struct VS_OUTPUT_GBUFFER
+{
+	float4 position : POSITION;
+	float2 texCoord : TEXCOORD0;
+	float3 tangent : TEXCOORD1;
+	float3 bitangent : TEXCOORD2;
+	float3 normal : TEXCOORD3;
+	float2 depth : TEXCOORD4;
+};
+
+struct PS_OUTPUT_GBUFFER
+{
+	float4 albedo : COLOR0;
+	float4 normal : COLOR1;
+	float4 depth : COLOR2;
+};
+
 VS_OUTPUT_DIR VS_DirLighting(VS_INPUT IN)
 {
 	VS_OUTPUT_DIR OUT;
@@ -235,13 +359,131 @@ VS_OUTPUT_SPOT VS_SpotLighting(VS_INPUT IN)
     return OUT;
 }
 
+VS_OUTPUT_SPOT_SHADOWED VS_SpotLightingShadowed(VS_INPUT IN)
+{
+    VS_OUTPUT_SPOT_SHADOWED OUT;
+    VS_OUTPUT_SPOT spot = VS_SpotLighting(IN);
+
+    float4 worldPos = mul(float4(IN.position, 1.0f), worldMatrix);
+
+    OUT.position = spot.position;
+    OUT.texCoord = spot.texCoord;
+    OUT.viewDir = spot.viewDir;
+    OUT.lightDir = spot.lightDir;
+    OUT.spotDir = spot.spotDir;
+    OUT.shadowCoord = mul(worldPos, shadowMatrix);
+    OUT.diffuse = spot.diffuse;
+    OUT.specular = spot.specular;
+
+    return OUT;
+}
+
+VS_OUTPUT_SHADOW_DEPTH VS_ShadowMapDepth(VS_INPUT IN)
+{
+    VS_OUTPUT_SHADOW_DEPTH OUT;
+
+    float4 worldPos = mul(float4(IN.position, 1.0f), worldMatrix);
+
+    OUT.position = mul(worldPos, lightViewProjectionMatrix);
+    OUT.depth = OUT.position.zw;
+
+    return OUT;
+}
+
+VS_OUTPUT_GBUFFER VS_DeferredGBuffer(VS_INPUT IN)
+{
+    VS_OUTPUT_GBUFFER OUT;
+
+    float3 n = mul(IN.normal, (float3x3)worldInverseTransposeMatrix);
+	float3 t = mul(IN.tangent.xyz, (float3x3)worldInverseTransposeMatrix);
+	float3 b = cross(n, t) * IN.tangent.w;
+
+    OUT.position = mul(float4(IN.position, 1.0f), worldViewProjectionMatrix);
+    OUT.texCoord = IN.texCoord;
+    OUT.tangent = t;
+    OUT.bitangent = b;
+    OUT.normal = n;
+    OUT.depth = OUT.position.zw;
+
+    return OUT;
+}
+
+float4 VS_FullScreen(float2 position : POSITION) : POSITION
+{
+    return float4(position, 0.0f, 1.0f);
+}
+
 //-----------------------------------------------------------------------------
 // Pixel Shaders.
 //-----------------------------------------------------------------------------
 
+float3 NormalMapNormal(float2 texCoord)
+{
+    float3 n = tex2D(normalMap, texCoord).rgb * 2.0f - 1.0f;
+
+    n.z = lerp(n.z, sqrt(saturate(1.0f - dot(n.xy, n.xy))), normalMapReconstructZ);
+    return normalize(n);
+}
+
+float4 MaterialTexel(float texel)
+{
+    float2 texCoord = (float2(texel, materialIndex) + 0.5f) / materialTableSize;
+
+    return tex2Dlod(materialTable, float4(texCoord, 0.0f, 0.0f));
+}
+
+float ShadowPCF(float4 shadowCoord)
+{
+    // Returns the fraction of the 3x3 texels around the pixel's position in
+    // the shadow map that aren't nearer to the light than the pixel.
+
+    float3 coord = shadowCoord.xyz / shadowCoord.w;
+    float depth = coord.z - shadowBias;
+    float lit = 0.0f;
+
+    for (int y = -1; y <= 1; ++y)
+    {
+        for (int x = -1; x <= 1; ++x)
+        {
+            float2 offset = float2(x, y) * shadowTexelSize;
+            lit += (depth <= tex2D(shadowMap, coord.xy + offset).r) ? 1.0f : 0.0f;
+        }
+    }
+
+    return lit / 9.0f;
+}
+
+float4 SpotLighting(float2 texCoord, float3 viewDir, float3 lightDir, float3 spotDir,
+                    float4 diffuse, float4 specular, float shadow)
+{
+    float atten = saturate(1.0f - dot(lightDir, lightDir));
+    
+	float3 l = normalize(lightDir);
+    float2 cosAngles = cos(float2(light.spotOuterCone, light.spotInnerCone) * 0.5f);
+    float spotDot = dot(-l, normalize(spotDir));
+    float spotEffect = smoothstep(cosAngles[0], cosAngles[1], spotDot);
+    
+    atten *= spotEffect;
+
+    float3 n = NormalMapNormal(texCoord);
+	float3 v = normalize(viewDir);
+	float3 h = normalize(l + v);
+    
+    float nDotL = saturate(dot(n, l));
+    float nDotH = saturate(dot(n, h));
+    float power = (nDotL == 0.0f) ? 0.0f : pow(nDotH, material.shininess);
+    
+    // Shadows only block the light's direct diffuse and specular terms.
+
+    float4 color = (material.ambient * (globalAmbient + (atten * light.ambient))) +
+                   (diffuse * nDotL * atten * shadow) + (specular * power * atten * shadow);
+    
+	return color * tex2D(colorMap, texCoord);
+}
+
 float4 PS_DirLighting(VS_OUTPUT_DIR IN) : COLOR
 {
-    float3 n = normalize(tex2D(normalMap, IN.texCoord).rgb * 2.0f - 1.0f);
+    float3 n = NormalMapNormal(IN.texCoord);
     float3 h = normalize(IN.halfVector);
     float3 l = normalize(IN.lightDir);
     
@@ -259,7 +501,7 @@ float4 PS_PointLighting(VS_OUTPUT_POINT IN) : COLOR
 {
     float atten = saturate(1.0f - dot(IN.lightDir, IN.lightDir));
 
-	float3 n = normalize(tex2D(normalMap, IN.texCoord).rgb * 2.0f - 1.0f);
+	float3 n = NormalMapNormal(IN.texCoord);
     float3 l = normalize(IN.lightDir);
     float3 v = normalize(IN.viewDir);
     float3 h = normalize(l + v);
@@ -276,27 +518,67 @@ float4 PS_PointLighting(VS_OUTPUT_POINT IN) : COLOR
 
 float4 PS_SpotLighting(VS_OUTPUT_SPOT IN) : COLOR
 {
-    float atten = saturate(1.0f - dot(IN.lightDir, IN.lightDir));
-    
-	float3 l = normalize(IN.lightDir);
-    float2 cosAngles = cos(float2(light.spotOuterCone, light.spotInnerCone) * 0.5f);
-    float spotDot = dot(-l, normalize(IN.spotDir));
-    float spotEffect = smoothstep(cosAngles[0], cosAngles[1], spotDot);
-    
-    atten *= spotEffect;
+    return SpotLighting(IN.texCoord, IN.viewDir, IN.lightDir, IN.spotDir,
+                        IN.diffuse, IN.specular, 1.0f);
+}
 
-    float3 n = normalize(tex2D(normalMap, IN.texCoord).rgb * 2.0f - 1.0f);
-	float3 v = normalize(IN.viewDir);
-	float3 h = normalize(l + v);
-    
+float4 PS_SpotLightingShadowed(VS_OUTPUT_SPOT_SHADOWED IN) : COLOR
+{
+    return SpotLighting(IN.texCoord, IN.viewDir, IN.lightDir, IN.spotDir,
+                        IN.diffuse, IN.specular, ShadowPCF(IN.shadowCoord));
+}
+
+float4 PS_ShadowMapDepth(VS_OUTPUT_SHADOW_DEPTH IN) : COLOR
+{
+    return IN.depth.x / IN.depth.y;
+}
+
+PS_OUTPUT_GBUFFER PS_DeferredGBuffer(VS_OUTPUT_GBUFFER IN)
+{
+    PS_OUTPUT_GBUFFER OUT;
+
+    float3 n = NormalMapNormal(IN.texCoord);
+
+    n = normalize(n.x * IN.tangent + n.y * IN.bitangent + n.z * IN.normal);
+
+    OUT.albedo = tex2D(colorMap, IN.texCoord);
+    OUT.normal = float4(n * 0.5f + 0.5f, 1.0f);
+    OUT.depth = IN.depth.x / IN.depth.y;
+
+    return OUT;
+}
+
+float4 PS_DeferredAmbient(float2 screenPos : VPOS) : COLOR
+{
+    float2 texCoord = (screenPos + 0.5f) / gBufferSize;
+    float4 albedo = tex2D(gBufferAlbedo, texCoord);
+
+    return albedo * MaterialTexel(0.0f) * globalAmbient;
+}
+
+float4 PS_DeferredLighting(float2 screenPos : VPOS) : COLOR
+{
+    // The pixel's position is rebuilt from its depth and its position in
+    // the viewport. The lighting is the same as the forward spot lighting's
+    // diffuse term. Point lights have cone cosines that make spotEffect 1.
+
+    float2 texCoord = (screenPos + 0.5f) / gBufferSize;
+    float2 viewportPos = (screenPos + 0.5f - viewportRect.xy) / viewportRect.zw;
+    float depth = tex2D(gBufferDepth, texCoord).r;
+    float4 clipPos = float4(viewportPos.x * 2.0f - 1.0f, 1.0f - viewportPos.y * 2.0f, depth, 1.0f);
+    float4 worldPos = mul(clipPos, inverseViewProjectionMatrix);
+
+    worldPos.xyz /= worldPos.w;
+
+    float3 lightDir = deferredLight[0].xyz - worldPos.xyz;
+    float atten = saturate(1.0f - dot(lightDir, lightDir) / (deferredLight[0].w * deferredLight[0].w));
+    float3 l = normalize(lightDir);
+    float spotEffect = smoothstep(deferredLight[1].w, deferredLight[2].w, dot(-l, deferredLight[1].xyz));
+    float3 n = normalize(tex2D(gBufferNormal, texCoord).rgb * 2.0f - 1.0f);
     float nDotL = saturate(dot(n, l));
-    float nDotH = saturate(dot(n, h));
-    float power = (nDotL == 0.0f) ? 0.0f : pow(nDotH, material.shininess);
-    
-    float4 color = (material.ambient * (globalAmbient + (atten * light.ambient))) +
-                   (IN.diffuse * nDotL * atten) + (IN.specular * power * atten);
-    
-	return color * tex2D(colorMap, IN.texCoord);
+    float3 albedo = tex2D(gBufferAlbedo, texCoord).rgb;
+
+    return float4(albedo * MaterialTexel(1.0f).rgb * deferredLight[2].rgb * (nDotL * atten * spotEffect), 1.0f);
 }
 
 //-----------------------------------------------------------------------------
@@ -329,3 +611,59 @@ technique NormalMappingSpotLighting
         PixelShader = compile ps_2_0 PS_SpotLighting();
     }
 }
+
+// The 9 shadow map lookups don't fit into the ps_2_0 instruction limits.
+
+technique NormalMappingSpotLightingShadowed
+{
+    pass
+    {
+        VertexShader = compile vs_3_0 VS_SpotLightingShadowed();
+        PixelShader = compile ps_3_0 PS_SpotLightingShadowed();
+    }
+}
+
+technique ShadowMapDepth
+{
+    pass
+    {
+        VertexShader = compile vs_2_0 VS_ShadowMapDepth();
+        PixelShader = compile ps_2_0 PS_ShadowMapDepth();
+    }
+}
+
+technique DeferredGBuffer
+{
+    pass
+    {
+        VertexShader = compile vs_3_0 VS_DeferredGBuffer();
+        PixelShader = compile ps_3_0 PS_DeferredGBuffer();
+    }
+}
+
+technique DeferredAmbient
+{
+    pass
+    {
+        VertexShader = compile vs_3_0 VS_FullScreen();
+        PixelShader = compile ps_3_0 PS_DeferredAmbient();
+        ZEnable = false;
+        ZWriteEnable = false;
+        AlphaBlendEnable = false;
+    }
+}
+
+technique DeferredLighting
+{
+    pass
+    {
+        VertexShader = compile vs_3_0 VS_FullScreen();
+        PixelShader = compile ps_3_0 PS_DeferredLighting();
+        ZEnable = false;
+        ZWriteEnable = false;
+        AlphaBlendEnable = true;
+        SrcBlend = One;
+        DestBlend = One;
+        ScissorTestEnable = true;
+    }
+}
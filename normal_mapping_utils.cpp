@@ -20,6 +20,7 @@
 // IN THE SOFTWARE.
 //-----------------------------------------------------------------------------
 
+#include <cstring>
 #include "normal_mapping_utils.h"
 
 void CalcTangentVector(const D3DXVECTOR3 &pos1,
@@ -0,0 +1,449 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <xmmintrin.h>
+#include "job_system.h"
+#include "occlusion_culler.h"
+
+namespace
+{
+    // Vertices closer to the eye than this (in clip space w) are treated as
+    // crossing the near plane.
+    const float MIN_W = 1e-3f;
+
+    // More bands than threads so that a band full of occluders doesn't hold
+    // up the whole frame.
+    const int BANDS_PER_THREAD = 4;
+
+    inline int ClampInt(int value, int minValue, int maxValue)
+    {
+        return (value < minValue) ? minValue : ((value > maxValue) ? maxValue : value);
+    }
+
+    inline float ClampFloat(float value, float minValue, float maxValue)
+    {
+        return (value < minValue) ? minValue : ((value > maxValue) ? maxValue : value);
+    }
+}
+
+OcclusionCuller::OcclusionCuller()
+{
+    m_width = 0;
+    m_height = 0;
+    m_tilesX = 0;
+    m_tilesY = 0;
+
+    D3DXMatrixIdentity(&m_viewProj);
+}
+
+OcclusionCuller::~OcclusionCuller()
+{
+    destroy();
+}
+
+void OcclusionCuller::addOccluder(const D3DXVECTOR3 *pVertices, int vertexCount,
+                                  const int *pIndices, int triangleCount)
+{
+    // The vertices are in the same space as the view-projection matrix given
+    // to begin(), i.e. relative to the camera's origin.
+
+    if (vertexCount <= 0 || triangleCount <= 0)
+        return;
+
+    m_clipVertices.resize(vertexCount);
+
+    for (int i = 0; i < vertexCount; ++i)
+        D3DXVec3Transform(&m_clipVertices[i], &pVertices[i], &m_viewProj);
+
+    for (int i = 0; i < triangleCount; ++i, pIndices += 3)
+    {
+        addTriangle(m_clipVertices[pIndices[0]], m_clipVertices[pIndices[1]],
+            m_clipVertices[pIndices[2]]);
+    }
+}
+
+void OcclusionCuller::begin(const D3DXMATRIX &viewProj)
+{
+    m_viewProj = viewProj;
+    m_triangles.clear();
+}
+
+bool OcclusionCuller::create(int width, int height)
+{
+    // The size is rounded up to whole tiles. Low resolutions work best; the
+    // depth buffer only needs to be good enough to tell whether a box is
+    // hidden, and every pixel costs time.
+
+    if (width <= 0 || height <= 0)
+        return false;
+
+    m_tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    m_tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    m_width = m_tilesX * TILE_SIZE;
+    m_height = m_tilesY * TILE_SIZE;
+    m_depth.assign(m_width * m_height, 0.0f);
+    m_tileDepth.assign(m_tilesX * m_tilesY, 0.0f);
+    m_triangles.clear();
+    return true;
+}
+
+void OcclusionCuller::destroy()
+{
+    std::vector<float>().swap(m_depth);
+    std::vector<float>().swap(m_tileDepth);
+    std::vector<Triangle>().swap(m_triangles);
+    std::vector<D3DXVECTOR4>().swap(m_clipVertices);
+    std::vector<Band>().swap(m_bands);
+
+    m_width = 0;
+    m_height = 0;
+    m_tilesX = 0;
+    m_tilesY = 0;
+}
+
+bool OcclusionCuller::isOccluded(const D3DXVECTOR3 &boxMin, const D3DXVECTOR3 &boxMax) const
+{
+    // The box is projected to a screen rectangle and the nearest depth of
+    // its corners. It's occluded when every tile under the rectangle has
+    // all of its pixels nearer than that. The corners are found by adding
+    // the matrix rows scaled by the box's extents to the projected minimum
+    // corner.
+
+    if (m_tileDepth.empty())
+        return false;
+
+    const D3DXMATRIX &m = m_viewProj;
+    float extents[3] = { boxMax.x - boxMin.x, boxMax.y - boxMin.y, boxMax.z - boxMin.z };
+    float base[4];
+    float minX = FLT_MAX;
+    float minY = FLT_MAX;
+    float maxX = -FLT_MAX;
+    float maxY = -FLT_MAX;
+    float nearest = 0.0f;
+
+    for (int j = 0; j < 4; ++j)
+        base[j] = boxMin.x * m(0,j) + boxMin.y * m(1,j) + boxMin.z * m(2,j) + m(3,j);
+
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        float clip[4] = { base[0], base[1], base[2], base[3] };
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            if (corner & (1 << axis))
+            {
+                for (int j = 0; j < 4; ++j)
+                    clip[j] += extents[axis] * m(axis,j);
+            }
+        }
+
+        if (clip[3] < MIN_W)
+            return false;
+
+        float invW = 1.0f / clip[3];
+        float x = (clip[0] * invW * 0.5f + 0.5f) * m_width;
+        float y = (0.5f - clip[1] * invW * 0.5f) * m_height;
+
+        minX = (x < minX) ? x : minX;
+        maxX = (x > maxX) ? x : maxX;
+        minY = (y < minY) ? y : minY;
+        maxY = (y > maxY) ? y : maxY;
+        nearest = (invW > nearest) ? invW : nearest;
+    }
+
+    if (maxX < 0.0f || maxY < 0.0f || minX >= m_width || minY >= m_height)
+        return false;
+
+    int tx0 = ClampInt(static_cast<int>(ClampFloat(minX, 0.0f, static_cast<float>(m_width))) / TILE_SIZE, 0, m_tilesX - 1);
+    int tx1 = ClampInt(static_cast<int>(ClampFloat(maxX, 0.0f, static_cast<float>(m_width))) / TILE_SIZE, 0, m_tilesX - 1);
+    int ty0 = ClampInt(static_cast<int>(ClampFloat(minY, 0.0f, static_cast<float>(m_height))) / TILE_SIZE, 0, m_tilesY - 1);
+    int ty1 = ClampInt(static_cast<int>(ClampFloat(maxY, 0.0f, static_cast<float>(m_height))) / TILE_SIZE, 0, m_tilesY - 1);
+
+    for (int ty = ty0; ty <= ty1; ++ty)
+    {
+        const float *pTiles = &m_tileDepth[ty * m_tilesX];
+
+        for (int tx = tx0; tx <= tx1; ++tx)
+        {
+            if (pTiles[tx] <= nearest)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+void OcclusionCuller::rasterize(JobSystem *pJobSystem)
+{
+    // Draws the occluders added since begin(). Pass a null job system to
+    // draw everything on the calling thread.
+
+    if (m_depth.empty())
+        return;
+
+    int bandCount = 1;
+
+    if (pJobSystem)
+        bandCount = (pJobSystem->workerCount() + 1) * BANDS_PER_THREAD;
+
+    if (bandCount > m_tilesY)
+        bandCount = m_tilesY;
+
+    m_bands.resize(bandCount);
+
+    for (int i = 0; i < bandCount; ++i)
+    {
+        Band &band = m_bands[i];
+
+        band.pCuller = this;
+        band.firstRow = (m_tilesY * i / bandCount) * TILE_SIZE;
+        band.endRow = (m_tilesY * (i + 1) / bandCount) * TILE_SIZE;
+    }
+
+    if (bandCount == 1)
+    {
+        rasterizeBand(0, m_height);
+        return;
+    }
+
+    JobCounter counter;
+
+    for (int i = 0; i < bandCount; ++i)
+        pJobSystem->submit(rasterizeBandJob, &m_bands[i], &counter);
+
+    pJobSystem->wait(&counter);
+}
+
+int OcclusionCuller::testBoxes(const D3DXVECTOR3 *pBoxMins, const D3DXVECTOR3 *pBoxMaxs,
+                               int count, bool *pOccluded) const
+{
+    // Returns the number of occluded boxes.
+
+    int occludedCount = 0;
+
+    for (int i = 0; i < count; ++i)
+    {
+        pOccluded[i] = isOccluded(pBoxMins[i], pBoxMaxs[i]);
+
+        if (pOccluded[i])
+            ++occludedCount;
+    }
+
+    return occludedCount;
+}
+
+void OcclusionCuller::rasterizeBandJob(void *pData)
+{
+    Band *pBand = static_cast<Band *>(pData);
+
+    pBand->pCuller->rasterizeBand(pBand->firstRow, pBand->endRow);
+}
+
+void OcclusionCuller::addTriangle(const D3DXVECTOR4 &v0, const D3DXVECTOR4 &v1, const D3DXVECTOR4 &v2)
+{
+    // Sets the triangle up in double precision. Near the eye the screen
+    // coordinates get very large and the edge functions would lose too much
+    // precision in float. The planes are stored relative to the center of
+    // the triangle's first pixel, which keeps the values small enough for
+    // float from then on.
+
+    if (v0.w < MIN_W || v1.w < MIN_W || v2.w < MIN_W)
+        return;
+
+    const D3DXVECTOR4 *pVertices[3] = { &v0, &v1, &v2 };
+    double x[3];
+    double y[3];
+    double invW[3];
+
+    for (int i = 0; i < 3; ++i)
+    {
+        invW[i] = 1.0 / pVertices[i]->w;
+        x[i] = (pVertices[i]->x * invW[i] * 0.5 + 0.5) * m_width;
+        y[i] = (0.5 - pVertices[i]->y * invW[i] * 0.5) * m_height;
+    }
+
+    double area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+
+    if (area == 0.0)
+        return;
+
+    // Occluders are drawn two sided. Make the winding consistent so that
+    // inside is where all three edge functions are positive.
+
+    if (area < 0.0)
+    {
+        double temp;
+
+        temp = x[1], x[1] = x[2], x[2] = temp;
+        temp = y[1], y[1] = y[2], y[2] = temp;
+        temp = invW[1], invW[1] = invW[2], invW[2] = temp;
+        area = -area;
+    }
+
+    // Pixel centers inside the triangle's bounds.
+
+    double boundsMinX = (x[0] < x[1]) ? ((x[0] < x[2]) ? x[0] : x[2]) : ((x[1] < x[2]) ? x[1] : x[2]);
+    double boundsMaxX = (x[0] > x[1]) ? ((x[0] > x[2]) ? x[0] : x[2]) : ((x[1] > x[2]) ? x[1] : x[2]);
+    double boundsMinY = (y[0] < y[1]) ? ((y[0] < y[2]) ? y[0] : y[2]) : ((y[1] < y[2]) ? y[1] : y[2]);
+    double boundsMaxY = (y[0] > y[1]) ? ((y[0] > y[2]) ? y[0] : y[2]) : ((y[1] > y[2]) ? y[1] : y[2]);
+
+    if (boundsMaxX < 0.0 || boundsMaxY < 0.0 || boundsMinX > m_width || boundsMinY > m_height)
+        return;
+
+    Triangle triangle;
+
+    triangle.minX = static_cast<int>(ceil((boundsMinX > -1.0 ? boundsMinX : -1.0) - 0.5));
+    triangle.maxX = static_cast<int>(floor((boundsMaxX < m_width + 1.0 ? boundsMaxX : m_width + 1.0) - 0.5));
+    triangle.minY = static_cast<int>(ceil((boundsMinY > -1.0 ? boundsMinY : -1.0) - 0.5));
+    triangle.maxY = static_cast<int>(floor((boundsMaxY < m_height + 1.0 ? boundsMaxY : m_height + 1.0) - 0.5));
+    triangle.minX = ClampInt(triangle.minX, 0, m_width - 1);
+    triangle.maxX = ClampInt(triangle.maxX, 0, m_width - 1);
+    triangle.minY = ClampInt(triangle.minY, 0, m_height - 1);
+    triangle.maxY = ClampInt(triangle.maxY, 0, m_height - 1);
+
+    if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+        return;
+
+    double originX = triangle.minX + 0.5;
+    double originY = triangle.minY + 0.5;
+    double depthA = 0.0;
+    double depthB = 0.0;
+    double depthC = 0.0;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        // Edge i runs between the two vertices other than vertex i and is
+        // positive on vertex i's side.
+
+        int j = (i + 1) % 3;
+        int k = (i + 2) % 3;
+        double a = y[j] - y[k];
+        double b = x[k] - x[j];
+        double c = a * (originX - x[j]) + b * (originY - y[j]);
+
+        triangle.edgeA[i] = static_cast<float>(a);
+        triangle.edgeB[i] = static_cast<float>(b);
+        triangle.edgeC[i] = static_cast<float>(c);
+
+        depthA += a * invW[i];
+        depthB += b * invW[i];
+        depthC += c * invW[i];
+    }
+
+    triangle.depthA = static_cast<float>(depthA / area);
+    triangle.depthB = static_cast<float>(depthB / area);
+    triangle.depthC = static_cast<float>(depthC / area);
+
+    m_triangles.push_back(triangle);
+}
+
+void OcclusionCuller::rasterizeBand(int firstRow, int endRow)
+{
+    // Clears the band, draws every triangle that overlaps it, and then
+    // updates the band's tiles with the farthest depth in each tile.
+
+    memset(&m_depth[firstRow * m_width], 0, (endRow - firstRow) * m_width * sizeof(float));
+
+    for (size_t i = 0; i < m_triangles.size(); ++i)
+    {
+        const Triangle &triangle = m_triangles[i];
+
+        if (triangle.maxY >= firstRow && triangle.minY < endRow)
+            rasterizeTriangle(triangle, firstRow, endRow);
+    }
+
+    for (int ty = firstRow / TILE_SIZE; ty < endRow / TILE_SIZE; ++ty)
+    {
+        for (int tx = 0; tx < m_tilesX; ++tx)
+        {
+            const float *pPixels = &m_depth[ty * TILE_SIZE * m_width + tx * TILE_SIZE];
+            __m128 farthest = _mm_loadu_ps(pPixels);
+
+            for (int y = 0; y < TILE_SIZE; ++y, pPixels += m_width)
+            {
+                for (int x = 0; x < TILE_SIZE; x += 4)
+                    farthest = _mm_min_ps(farthest, _mm_loadu_ps(pPixels + x));
+            }
+
+            farthest = _mm_min_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(1, 0, 3, 2)));
+            farthest = _mm_min_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(2, 3, 0, 1)));
+            _mm_store_ss(&m_tileDepth[ty * m_tilesX + tx], farthest);
+        }
+    }
+}
+
+void OcclusionCuller::rasterizeTriangle(const Triangle &triangle, int firstRow, int endRow)
+{
+    // Walks the triangle's bounds 4 pixels at a time. The spans start on a
+    // multiple of 4 pixels and the width is a multiple of the tile size, so
+    // every group of 4 is inside the row.
+
+    int minY = (triangle.minY > firstRow) ? triangle.minY : firstRow;
+    int maxY = (triangle.maxY < endRow - 1) ? triangle.maxY : endRow - 1;
+    int minX = triangle.minX & ~3;
+    float startX = static_cast<float>(minX - triangle.minX);
+
+    __m128 offsets = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    __m128 zero = _mm_setzero_ps();
+    __m128 edgeStep[3];
+    __m128 edgeColumn[3];
+    __m128 depthStep = _mm_set1_ps(4.0f * triangle.depthA);
+    __m128 depthColumn = _mm_mul_ps(_mm_add_ps(_mm_set1_ps(startX), offsets), _mm_set1_ps(triangle.depthA));
+
+    for (int i = 0; i < 3; ++i)
+    {
+        edgeStep[i] = _mm_set1_ps(4.0f * triangle.edgeA[i]);
+        edgeColumn[i] = _mm_mul_ps(_mm_add_ps(_mm_set1_ps(startX), offsets), _mm_set1_ps(triangle.edgeA[i]));
+    }
+
+    for (int y = minY; y <= maxY; ++y)
+    {
+        float dy = static_cast<float>(y - triangle.minY);
+        __m128 e0 = _mm_add_ps(edgeColumn[0], _mm_set1_ps(triangle.edgeB[0] * dy + triangle.edgeC[0]));
+        __m128 e1 = _mm_add_ps(edgeColumn[1], _mm_set1_ps(triangle.edgeB[1] * dy + triangle.edgeC[1]));
+        __m128 e2 = _mm_add_ps(edgeColumn[2], _mm_set1_ps(triangle.edgeB[2] * dy + triangle.edgeC[2]));
+        __m128 depth = _mm_add_ps(depthColumn, _mm_set1_ps(triangle.depthB * dy + triangle.depthC));
+        float *pRow = &m_depth[y * m_width];
+
+        for (int x = minX; x <= triangle.maxX; x += 4)
+        {
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)),
+                _mm_cmpge_ps(e2, zero));
+
+            if (_mm_movemask_ps(inside))
+            {
+                __m128 old = _mm_loadu_ps(pRow + x);
+                __m128 nearer = _mm_max_ps(old, depth);
+
+                _mm_storeu_ps(pRow + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+            }
+
+            e0 = _mm_add_ps(e0, edgeStep[0]);
+            e1 = _mm_add_ps(e1, edgeStep[1]);
+            e2 = _mm_add_ps(e2, edgeStep[2]);
+            depth = _mm_add_ps(depth, depthStep);
+        }
+    }
+}
@@ -0,0 +1,145 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(OCCLUSION_CULLER_H)
+#define OCCLUSION_CULLER_H
+
+#include <vector>
+#include <d3dx9.h>
+
+class JobSystem;
+
+//-----------------------------------------------------------------------------
+// The OcclusionCuller class is a software occlusion culler. Occluder meshes
+// are rasterized on the CPU into a small depth buffer and object bounding
+// boxes are then tested against it. Objects hidden behind large occluders
+// can be skipped even though they're inside the view frustum.
+//
+// Each frame:
+//  1. begin() with the camera's view-projection matrix.
+//  2. addOccluder() for each occluder mesh. The triangles are transformed
+//     and set up for rasterization here.
+//  3. rasterize() to draw all of the occluders. The depth buffer is split
+//     into bands of rows that are drawn as jobs on a JobSystem. A tile
+//     pyramid level holding the farthest depth of each 8x8 pixel tile is
+//     built as each band finishes.
+//  4. isOccluded() or testBoxes() for the objects. These only read the tile
+//     level, so any number of threads may test boxes at once.
+//
+// The depth buffer holds 1/w rather than z/w. 1/w interpolates linearly
+// across the screen and doesn't depend on the projection's depth mapping, so
+// reversed and infinite far plane projections work unchanged. Larger values
+// are nearer.
+//
+// Occluders are drawn at pixel centers only and triangles crossing the near
+// plane are dropped, so occluders are never drawn larger than they are. A box
+// that crosses the near plane is never occluded. Boxes outside the view are
+// not reported as occluded either; that's the view frustum's job.
+//
+// Pixels are processed 4 at a time using SSE.
+//-----------------------------------------------------------------------------
+
+class OcclusionCuller
+{
+public:
+    enum { TILE_SIZE = 8 };
+
+    OcclusionCuller();
+    ~OcclusionCuller();
+
+    void addOccluder(const D3DXVECTOR3 *pVertices, int vertexCount,
+                     const int *pIndices, int triangleCount);
+    void begin(const D3DXMATRIX &viewProj);
+    bool create(int width, int height);
+    void destroy();
+    bool isOccluded(const D3DXVECTOR3 &boxMin, const D3DXVECTOR3 &boxMax) const;
+    void rasterize(JobSystem *pJobSystem);
+    int testBoxes(const D3DXVECTOR3 *pBoxMins, const D3DXVECTOR3 *pBoxMaxs, int count,
+                  bool *pOccluded) const;
+
+    // Getter methods.
+
+    const float *getDepthBuffer() const;
+    int getHeight() const;
+    int getTriangleCount() const;
+    int getWidth() const;
+
+private:
+    // A triangle set up for rasterization. The edge functions and 1/w are
+    // planes in screen space: value = a * x + b * y + c.
+    struct Triangle
+    {
+        float edgeA[3];
+        float edgeB[3];
+        float edgeC[3];
+        float depthA;
+        float depthB;
+        float depthC;
+        int minX;
+        int minY;
+        int maxX;
+        int maxY;
+    };
+
+    struct Band
+    {
+        OcclusionCuller *pCuller;
+        int firstRow;
+        int endRow;
+    };
+
+    OcclusionCuller(const OcclusionCuller &);
+    OcclusionCuller &operator=(const OcclusionCuller &);
+
+    static void rasterizeBandJob(void *pData);
+
+    void addTriangle(const D3DXVECTOR4 &v0, const D3DXVECTOR4 &v1, const D3DXVECTOR4 &v2);
+    void rasterizeBand(int firstRow, int endRow);
+    void rasterizeTriangle(const Triangle &triangle, int firstRow, int endRow);
+
+    std::vector<float> m_depth;
+    std::vector<float> m_tileDepth;
+    std::vector<Triangle> m_triangles;
+    std::vector<D3DXVECTOR4> m_clipVertices;
+    std::vector<Band> m_bands;
+    D3DXMATRIX m_viewProj;
+    int m_width;
+    int m_height;
+    int m_tilesX;
+    int m_tilesY;
+};
+
+//-----------------------------------------------------------------------------
+
+inline const float *OcclusionCuller::getDepthBuffer() const
+{ return m_depth.empty() ? 0 : &m_depth[0]; }
+
+inline int OcclusionCuller::getHeight() const
+{ return m_height; }
+
+inline int OcclusionCuller::getTriangleCount() const
+{ return static_cast<int>(m_triangles.size()); }
+
+inline int OcclusionCuller::getWidth() const
+{ return m_width; }
+
+#endif
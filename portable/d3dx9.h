@@ -0,0 +1,780 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(PORTABLE_D3DX9_H)
+#define PORTABLE_D3DX9_H
+
+//-----------------------------------------------------------------------------
+// Stands in for the D3DX header on other platforms. Only the math types and
+// functions used by the portable sources are provided. They follow the D3DX
+// conventions: row vectors, row major matrices, and left-handed rotations
+// that are clockwise when looking along the rotation axis toward the origin.
+// The functions use the same formulas as D3DX so results match to within
+// floating point rounding.
+//-----------------------------------------------------------------------------
+
+#include <cmath>
+#include <d3d9types.h>
+
+typedef float FLOAT;
+
+#define D3DX_PI             ((FLOAT)3.141592654f)
+#define D3DXToRadian(degree) ((degree) * (D3DX_PI / 180.0f))
+#define D3DXToDegree(radian) ((radian) * (180.0f / D3DX_PI))
+
+//-----------------------------------------------------------------------------
+// Vectors.
+//-----------------------------------------------------------------------------
+
+struct D3DXVECTOR2
+{
+    FLOAT x;
+    FLOAT y;
+
+    D3DXVECTOR2() {}
+    D3DXVECTOR2(FLOAT fx, FLOAT fy) : x(fx), y(fy) {}
+
+    operator FLOAT*() { return &x; }
+    operator const FLOAT*() const { return &x; }
+
+    D3DXVECTOR2 &operator+=(const D3DXVECTOR2 &v) { x += v.x; y += v.y; return *this; }
+    D3DXVECTOR2 &operator-=(const D3DXVECTOR2 &v) { x -= v.x; y -= v.y; return *this; }
+    D3DXVECTOR2 &operator*=(FLOAT f) { x *= f; y *= f; return *this; }
+    D3DXVECTOR2 &operator/=(FLOAT f) { x /= f; y /= f; return *this; }
+
+    D3DXVECTOR2 operator+() const { return *this; }
+    D3DXVECTOR2 operator-() const { return D3DXVECTOR2(-x, -y); }
+
+    D3DXVECTOR2 operator+(const D3DXVECTOR2 &v) const { return D3DXVECTOR2(x + v.x, y + v.y); }
+    D3DXVECTOR2 operator-(const D3DXVECTOR2 &v) const { return D3DXVECTOR2(x - v.x, y - v.y); }
+    D3DXVECTOR2 operator*(FLOAT f) const { return D3DXVECTOR2(x * f, y * f); }
+    D3DXVECTOR2 operator/(FLOAT f) const { return D3DXVECTOR2(x / f, y / f); }
+
+    bool operator==(const D3DXVECTOR2 &v) const { return x == v.x && y == v.y; }
+    bool operator!=(const D3DXVECTOR2 &v) const { return x != v.x || y != v.y; }
+};
+
+struct D3DXVECTOR3
+{
+    FLOAT x;
+    FLOAT y;
+    FLOAT z;
+
+    D3DXVECTOR3() {}
+    D3DXVECTOR3(const FLOAT *pf) : x(pf[0]), y(pf[1]), z(pf[2]) {}
+    D3DXVECTOR3(FLOAT fx, FLOAT fy, FLOAT fz) : x(fx), y(fy), z(fz) {}
+
+    operator FLOAT*() { return &x; }
+    operator const FLOAT*() const { return &x; }
+
+    D3DXVECTOR3 &operator+=(const D3DXVECTOR3 &v) { x += v.x; y += v.y; z += v.z; return *this; }
+    D3DXVECTOR3 &operator-=(const D3DXVECTOR3 &v) { x -= v.x; y -= v.y; z -= v.z; return *this; }
+    D3DXVECTOR3 &operator*=(FLOAT f) { x *= f; y *= f; z *= f; return *this; }
+    D3DXVECTOR3 &operator/=(FLOAT f) { x /= f; y /= f; z /= f; return *this; }
+
+    D3DXVECTOR3 operator+() const { return *this; }
+    D3DXVECTOR3 operator-() const { return D3DXVECTOR3(-x, -y, -z); }
+
+    D3DXVECTOR3 operator+(const D3DXVECTOR3 &v) const { return D3DXVECTOR3(x + v.x, y + v.y, z + v.z); }
+    D3DXVECTOR3 operator-(const D3DXVECTOR3 &v) const { return D3DXVECTOR3(x - v.x, y - v.y, z - v.z); }
+    D3DXVECTOR3 operator*(FLOAT f) const { return D3DXVECTOR3(x * f, y * f, z * f); }
+    D3DXVECTOR3 operator/(FLOAT f) const { return D3DXVECTOR3(x / f, y / f, z / f); }
+
+    bool operator==(const D3DXVECTOR3 &v) const { return x == v.x && y == v.y && z == v.z; }
+    bool operator!=(const D3DXVECTOR3 &v) const { return x != v.x || y != v.y || z != v.z; }
+};
+
+struct D3DXVECTOR4
+{
+    FLOAT x;
+    FLOAT y;
+    FLOAT z;
+    FLOAT w;
+
+    D3DXVECTOR4() {}
+    D3DXVECTOR4(FLOAT fx, FLOAT fy, FLOAT fz, FLOAT fw) : x(fx), y(fy), z(fz), w(fw) {}
+
+    operator FLOAT*() { return &x; }
+    operator const FLOAT*() const { return &x; }
+};
+
+inline D3DXVECTOR2 operator*(FLOAT f, const D3DXVECTOR2 &v)
+{ return D3DXVECTOR2(f * v.x, f * v.y); }
+
+inline D3DXVECTOR3 operator*(FLOAT f, const D3DXVECTOR3 &v)
+{ return D3DXVECTOR3(f * v.x, f * v.y, f * v.z); }
+
+//-----------------------------------------------------------------------------
+// Planes, quaternions, and matrices.
+//-----------------------------------------------------------------------------
+
+struct D3DXPLANE
+{
+    FLOAT a;
+    FLOAT b;
+    FLOAT c;
+    FLOAT d;
+
+    D3DXPLANE() {}
+    D3DXPLANE(FLOAT fa, FLOAT fb, FLOAT fc, FLOAT fd) : a(fa), b(fb), c(fc), d(fd) {}
+
+    operator FLOAT*() { return &a; }
+    operator const FLOAT*() const { return &a; }
+
+    D3DXPLANE &operator*=(FLOAT f) { a *= f; b *= f; c *= f; d *= f; return *this; }
+    D3DXPLANE &operator/=(FLOAT f) { a /= f; b /= f; c /= f; d /= f; return *this; }
+};
+
+struct D3DXQUATERNION
+{
+    FLOAT x;
+    FLOAT y;
+    FLOAT z;
+    FLOAT w;
+
+    D3DXQUATERNION() {}
+    D3DXQUATERNION(FLOAT fx, FLOAT fy, FLOAT fz, FLOAT fw) : x(fx), y(fy), z(fz), w(fw) {}
+
+    operator FLOAT*() { return &x; }
+    operator const FLOAT*() const { return &x; }
+
+    D3DXQUATERNION operator-() const { return D3DXQUATERNION(-x, -y, -z, -w); }
+
+    bool operator==(const D3DXQUATERNION &q) const { return x == q.x && y == q.y && z == q.z && w == q.w; }
+    bool operator!=(const D3DXQUATERNION &q) const { return !(*this == q); }
+};
+
+struct D3DXMATRIX
+{
+    union
+    {
+        struct
+        {
+            FLOAT _11, _12, _13, _14;
+            FLOAT _21, _22, _23, _24;
+            FLOAT _31, _32, _33, _34;
+            FLOAT _41, _42, _43, _44;
+        };
+
+        FLOAT m[4][4];
+    };
+
+    D3DXMATRIX() {}
+
+    operator FLOAT*() { return &_11; }
+    operator const FLOAT*() const { return &_11; }
+
+    FLOAT &operator()(unsigned int row, unsigned int col) { return m[row][col]; }
+    FLOAT operator()(unsigned int row, unsigned int col) const { return m[row][col]; }
+
+    D3DXMATRIX operator*(const D3DXMATRIX &mat) const
+    {
+        D3DXMATRIX result;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            for (int j = 0; j < 4; ++j)
+            {
+                result.m[i][j] = m[i][0] * mat.m[0][j] + m[i][1] * mat.m[1][j]
+                    + m[i][2] * mat.m[2][j] + m[i][3] * mat.m[3][j];
+            }
+        }
+
+        return result;
+    }
+
+    D3DXMATRIX &operator*=(const D3DXMATRIX &mat) { return *this = *this * mat; }
+
+    bool operator==(const D3DXMATRIX &mat) const
+    {
+        for (int i = 0; i < 16; ++i)
+        {
+            if ((&_11)[i] != (&mat._11)[i])
+                return false;
+        }
+
+        return true;
+    }
+
+    bool operator!=(const D3DXMATRIX &mat) const { return !(*this == mat); }
+};
+
+//-----------------------------------------------------------------------------
+// Vector functions.
+//-----------------------------------------------------------------------------
+
+inline D3DXVECTOR2 *D3DXVec2Normalize(D3DXVECTOR2 *pOut, const D3DXVECTOR2 *pV)
+{
+    FLOAT length = sqrtf(pV->x * pV->x + pV->y * pV->y);
+
+    if (length == 0.0f)
+        *pOut = D3DXVECTOR2(0.0f, 0.0f);
+    else
+        *pOut = D3DXVECTOR2(pV->x / length, pV->y / length);
+
+    return pOut;
+}
+
+inline D3DXVECTOR3 *D3DXVec3Cross(D3DXVECTOR3 *pOut, const D3DXVECTOR3 *pV1, const D3DXVECTOR3 *pV2)
+{
+    D3DXVECTOR3 v(pV1->y * pV2->z - pV1->z * pV2->y,
+                  pV1->z * pV2->x - pV1->x * pV2->z,
+                  pV1->x * pV2->y - pV1->y * pV2->x);
+
+    *pOut = v;
+    return pOut;
+}
+
+inline D3DXVECTOR3 *D3DXVec3CatmullRom(D3DXVECTOR3 *pOut, const D3DXVECTOR3 *pV0, const D3DXVECTOR3 *pV1,
+                                       const D3DXVECTOR3 *pV2, const D3DXVECTOR3 *pV3, FLOAT s)
+{
+    FLOAT s2 = s * s;
+    FLOAT s3 = s2 * s;
+
+    *pOut = 0.5f * (2.0f * *pV1 + (*pV2 - *pV0) * s
+        + (2.0f * *pV0 - 5.0f * *pV1 + 4.0f * *pV2 - *pV3) * s2
+        + (*pV3 - 3.0f * *pV2 + 3.0f * *pV1 - *pV0) * s3);
+
+    return pOut;
+}
+
+inline FLOAT D3DXVec3Dot(const D3DXVECTOR3 *pV1, const D3DXVECTOR3 *pV2)
+{ return pV1->x * pV2->x + pV1->y * pV2->y + pV1->z * pV2->z; }
+
+inline FLOAT D3DXVec3Length(const D3DXVECTOR3 *pV)
+{ return sqrtf(pV->x * pV->x + pV->y * pV->y + pV->z * pV->z); }
+
+inline FLOAT D3DXVec3LengthSq(const D3DXVECTOR3 *pV)
+{ return pV->x * pV->x + pV->y * pV->y + pV->z * pV->z; }
+
+inline D3DXVECTOR3 *D3DXVec3Maximize(D3DXVECTOR3 *pOut, const D3DXVECTOR3 *pV1, const D3DXVECTOR3 *pV2)
+{
+    *pOut = D3DXVECTOR3(pV1->x > pV2->x ? pV1->x : pV2->x,
+                        pV1->y > pV2->y ? pV1->y : pV2->y,
+                        pV1->z > pV2->z ? pV1->z : pV2->z);
+    return pOut;
+}
+
+inline D3DXVECTOR3 *D3DXVec3Minimize(D3DXVECTOR3 *pOut, const D3DXVECTOR3 *pV1, const D3DXVECTOR3 *pV2)
+{
+    *pOut = D3DXVECTOR3(pV1->x < pV2->x ? pV1->x : pV2->x,
+                        pV1->y < pV2->y ? pV1->y : pV2->y,
+                        pV1->z < pV2->z ? pV1->z : pV2->z);
+    return pOut;
+}
+
+inline D3DXVECTOR3 *D3DXVec3Normalize(D3DXVECTOR3 *pOut, const D3DXVECTOR3 *pV)
+{
+    // Like D3DX a zero length vector normalizes to the zero vector.
+
+    FLOAT length = D3DXVec3Length(pV);
+
+    if (length == 0.0f)
+        *pOut = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+    else
+        *pOut = D3DXVECTOR3(pV->x / length, pV->y / length, pV->z / length);
+
+    return pOut;
+}
+
+inline D3DXVECTOR4 *D3DXVec3Transform(D3DXVECTOR4 *pOut, const D3DXVECTOR3 *pV, const D3DXMATRIX *pM)
+{
+    D3DXVECTOR4 v;
+
+    v.x = pV->x * pM->m[0][0] + pV->y * pM->m[1][0] + pV->z * pM->m[2][0] + pM->m[3][0];
+    v.y = pV->x * pM->m[0][1] + pV->y * pM->m[1][1] + pV->z * pM->m[2][1] + pM->m[3][1];
+    v.z = pV->x * pM->m[0][2] + pV->y * pM->m[1][2] + pV->z * pM->m[2][2] + pM->m[3][2];
+    v.w = pV->x * pM->m[0][3] + pV->y * pM->m[1][3] + pV->z * pM->m[2][3] + pM->m[3][3];
+
+    *pOut = v;
+    return pOut;
+}
+
+inline D3DXVECTOR3 *D3DXVec3TransformCoord(D3DXVECTOR3 *pOut, const D3DXVECTOR3 *pV, const D3DXMATRIX *pM)
+{
+    D3DXVECTOR4 v;
+
+    D3DXVec3Transform(&v, pV, pM);
+
+    FLOAT invW = 1.0f / v.w;
+
+    *pOut = D3DXVECTOR3(v.x * invW, v.y * invW, v.z * invW);
+    return pOut;
+}
+
+inline D3DXVECTOR4 *D3DXVec4Normalize(D3DXVECTOR4 *pOut, const D3DXVECTOR4 *pV)
+{
+    FLOAT length = sqrtf(pV->x * pV->x + pV->y * pV->y + pV->z * pV->z + pV->w * pV->w);
+
+    if (length == 0.0f)
+        *pOut = D3DXVECTOR4(0.0f, 0.0f, 0.0f, 0.0f);
+    else
+        *pOut = D3DXVECTOR4(pV->x / length, pV->y / length, pV->z / length, pV->w / length);
+
+    return pOut;
+}
+
+inline D3DXVECTOR4 *D3DXVec4Transform(D3DXVECTOR4 *pOut, const D3DXVECTOR4 *pV, const D3DXMATRIX *pM)
+{
+    D3DXVECTOR4 v;
+
+    v.x = pV->x * pM->m[0][0] + pV->y * pM->m[1][0] + pV->z * pM->m[2][0] + pV->w * pM->m[3][0];
+    v.y = pV->x * pM->m[0][1] + pV->y * pM->m[1][1] + pV->z * pM->m[2][1] + pV->w * pM->m[3][1];
+    v.z = pV->x * pM->m[0][2] + pV->y * pM->m[1][2] + pV->z * pM->m[2][2] + pV->w * pM->m[3][2];
+    v.w = pV->x * pM->m[0][3] + pV->y * pM->m[1][3] + pV->z * pM->m[2][3] + pV->w * pM->m[3][3];
+
+    *pOut = v;
+    return pOut;
+}
+
+//-----------------------------------------------------------------------------
+// Plane functions.
+//-----------------------------------------------------------------------------
+
+inline FLOAT D3DXPlaneDotCoord(const D3DXPLANE *pP, const D3DXVECTOR3 *pV)
+{ return pP->a * pV->x + pP->b * pV->y + pP->c * pV->z + pP->d; }
+
+//-----------------------------------------------------------------------------
+// Quaternion functions.
+//-----------------------------------------------------------------------------
+
+inline D3DXQUATERNION *D3DXQuaternionConjugate(D3DXQUATERNION *pOut, const D3DXQUATERNION *pQ)
+{
+    *pOut = D3DXQUATERNION(-pQ->x, -pQ->y, -pQ->z, pQ->w);
+    return pOut;
+}
+
+inline FLOAT D3DXQuaternionDot(const D3DXQUATERNION *pQ1, const D3DXQUATERNION *pQ2)
+{ return pQ1->x * pQ2->x + pQ1->y * pQ2->y + pQ1->z * pQ2->z + pQ1->w * pQ2->w; }
+
+inline D3DXQUATERNION *D3DXQuaternionExp(D3DXQUATERNION *pOut, const D3DXQUATERNION *pQ)
+{
+    // The quaternion's w is ignored, as it is by D3DX.
+
+    FLOAT theta = sqrtf(pQ->x * pQ->x + pQ->y * pQ->y + pQ->z * pQ->z);
+    FLOAT scale = (theta > 1e-6f) ? sinf(theta) / theta : 1.0f;
+
+    *pOut = D3DXQUATERNION(pQ->x * scale, pQ->y * scale, pQ->z * scale, cosf(theta));
+    return pOut;
+}
+
+inline D3DXQUATERNION *D3DXQuaternionIdentity(D3DXQUATERNION *pOut)
+{
+    *pOut = D3DXQUATERNION(0.0f, 0.0f, 0.0f, 1.0f);
+    return pOut;
+}
+
+inline D3DXQUATERNION *D3DXQuaternionInverse(D3DXQUATERNION *pOut, const D3DXQUATERNION *pQ)
+{
+    FLOAT lengthSq = D3DXQuaternionDot(pQ, pQ);
+
+    *pOut = D3DXQUATERNION(-pQ->x / lengthSq, -pQ->y / lengthSq, -pQ->z / lengthSq, pQ->w / lengthSq);
+    return pOut;
+}
+
+inline D3DXQUATERNION *D3DXQuaternionLn(D3DXQUATERNION *pOut, const D3DXQUATERNION *pQ)
+{
+    // Expects a unit quaternion, as D3DX does.
+
+    FLOAT w = pQ->w > 1.0f ? 1.0f : (pQ->w < -1.0f ? -1.0f : pQ->w);
+    FLOAT theta = acosf(w);
+    FLOAT sinTheta = sinf(theta);
+    FLOAT scale = (sinTheta > 1e-6f) ? theta / sinTheta : 1.0f;
+
+    *pOut = D3DXQUATERNION(pQ->x * scale, pQ->y * scale, pQ->z * scale, 0.0f);
+    return pOut;
+}
+
+inline D3DXQUATERNION *D3DXQuaternionMultiply(D3DXQUATERNION *pOut, const D3DXQUATERNION *pQ1,
+                                              const D3DXQUATERNION *pQ2)
+{
+    // Like D3DX the result is the rotation pQ1 followed by pQ2, which is the
+    // quaternion product pQ2 * pQ1.
+
+    D3DXQUATERNION q(pQ2->w * pQ1->x + pQ2->x * pQ1->w + pQ2->y * pQ1->z - pQ2->z * pQ1->y,
+                     pQ2->w * pQ1->y - pQ2->x * pQ1->z + pQ2->y * pQ1->w + pQ2->z * pQ1->x,
+                     pQ2->w * pQ1->z + pQ2->x * pQ1->y - pQ2->y * pQ1->x + pQ2->z * pQ1->w,
+                     pQ2->w * pQ1->w - pQ2->x * pQ1->x - pQ2->y * pQ1->y - pQ2->z * pQ1->z);
+
+    *pOut = q;
+    return pOut;
+}
+
+inline D3DXQUATERNION *D3DXQuaternionNormalize(D3DXQUATERNION *pOut, const D3DXQUATERNION *pQ)
+{
+    FLOAT length = sqrtf(D3DXQuaternionDot(pQ, pQ));
+
+    if (length == 0.0f)
+        *pOut = D3DXQUATERNION(0.0f, 0.0f, 0.0f, 0.0f);
+    else
+        *pOut = D3DXQUATERNION(pQ->x / length, pQ->y / length, pQ->z / length, pQ->w / length);
+
+    return pOut;
+}
+
+inline D3DXQUATERNION *D3DXQuaternionRotationAxis(D3DXQUATERNION *pOut, const D3DXVECTOR3 *pV,
+                                                  FLOAT angle)
+{
+    // Like D3DX the axis is normalized first.
+
+    FLOAT length = sqrtf(pV->x * pV->x + pV->y * pV->y + pV->z * pV->z);
+    FLOAT scale = (length > 0.0f) ? sinf(angle * 0.5f) / length : 0.0f;
+
+    *pOut = D3DXQUATERNION(pV->x * scale, pV->y * scale, pV->z * scale, cosf(angle * 0.5f));
+    return pOut;
+}
+
+inline D3DXQUATERNION *D3DXQuaternionRotationMatrix(D3DXQUATERNION *pOut, const D3DXMATRIX *pM)
+{
+    // Uses the largest of w, x, y, and z to avoid dividing by a small number.
+
+    FLOAT trace = pM->m[0][0] + pM->m[1][1] + pM->m[2][2] + 1.0f;
+    FLOAT s;
+
+    if (trace > 1.0f)
+    {
+        s = 2.0f * sqrtf(trace);
+        pOut->x = (pM->m[1][2] - pM->m[2][1]) / s;
+        pOut->y = (pM->m[2][0] - pM->m[0][2]) / s;
+        pOut->z = (pM->m[0][1] - pM->m[1][0]) / s;
+        pOut->w = 0.25f * s;
+    }
+    else if (pM->m[0][0] >= pM->m[1][1] && pM->m[0][0] >= pM->m[2][2])
+    {
+        s = 2.0f * sqrtf(1.0f + pM->m[0][0] - pM->m[1][1] - pM->m[2][2]);
+        pOut->x = 0.25f * s;
+        pOut->y = (pM->m[0][1] + pM->m[1][0]) / s;
+        pOut->z = (pM->m[0][2] + pM->m[2][0]) / s;
+        pOut->w = (pM->m[1][2] - pM->m[2][1]) / s;
+    }
+    else if (pM->m[1][1] >= pM->m[2][2])
+    {
+        s = 2.0f * sqrtf(1.0f + pM->m[1][1] - pM->m[0][0] - pM->m[2][2]);
+        pOut->x = (pM->m[0][1] + pM->m[1][0]) / s;
+        pOut->y = 0.25f * s;
+        pOut->z = (pM->m[1][2] + pM->m[2][1]) / s;
+        pOut->w = (pM->m[2][0] - pM->m[0][2]) / s;
+    }
+    else
+    {
+        s = 2.0f * sqrtf(1.0f + pM->m[2][2] - pM->m[0][0] - pM->m[1][1]);
+        pOut->x = (pM->m[0][2] + pM->m[2][0]) / s;
+        pOut->y = (pM->m[1][2] + pM->m[2][1]) / s;
+        pOut->z = 0.25f * s;
+        pOut->w = (pM->m[0][1] - pM->m[1][0]) / s;
+    }
+
+    return pOut;
+}
+
+inline D3DXQUATERNION *D3DXQuaternionSlerp(D3DXQUATERNION *pOut, const D3DXQUATERNION *pQ1,
+                                           const D3DXQUATERNION *pQ2, FLOAT t)
+{
+    // Takes the shorter way around, and falls back to a linear blend when the
+    // quaternions are almost the same.
+
+    FLOAT dot = D3DXQuaternionDot(pQ1, pQ2);
+    FLOAT s1 = 1.0f - t;
+    FLOAT s2 = t;
+
+    if (dot < 0.0f)
+    {
+        s2 = -s2;
+        dot = -dot;
+    }
+
+    if (1.0f - dot > 0.001f)
+    {
+        FLOAT theta = acosf(dot);
+        FLOAT sinTheta = sinf(theta);
+
+        s1 = sinf(theta * s1) / sinTheta;
+        s2 = sinf(theta * s2) / sinTheta;
+    }
+
+    *pOut = D3DXQUATERNION(s1 * pQ1->x + s2 * pQ2->x, s1 * pQ1->y + s2 * pQ2->y,
+                           s1 * pQ1->z + s2 * pQ2->z, s1 * pQ1->w + s2 * pQ2->w);
+    return pOut;
+}
+
+inline D3DXQUATERNION *D3DXQuaternionSquad(D3DXQUATERNION *pOut, const D3DXQUATERNION *pQ1,
+                                           const D3DXQUATERNION *pA, const D3DXQUATERNION *pB,
+                                           const D3DXQUATERNION *pC, FLOAT t)
+{
+    D3DXQUATERNION q1;
+    D3DXQUATERNION q2;
+
+    D3DXQuaternionSlerp(&q1, pQ1, pC, t);
+    D3DXQuaternionSlerp(&q2, pA, pB, t);
+    return D3DXQuaternionSlerp(pOut, &q1, &q2, 2.0f * t * (1.0f - t));
+}
+
+inline void D3DXQuaternionSquadSetup(D3DXQUATERNION *pAOut, D3DXQUATERNION *pBOut,
+                                     D3DXQUATERNION *pCOut, const D3DXQUATERNION *pQ0,
+                                     const D3DXQUATERNION *pQ1, const D3DXQUATERNION *pQ2,
+                                     const D3DXQUATERNION *pQ3)
+{
+    // The control points for squad interpolation between pQ1 and pQ2. The
+    // neighbors are first flipped onto the same hemisphere:
+    //
+    //  A = q1 * exp(-(ln(q1^-1 * q0) + ln(q1^-1 * q2)) / 4)
+    //  B = q2 * exp(-(ln(q2^-1 * q1) + ln(q2^-1 * q3)) / 4)
+    //  C = q2
+    //
+    // with the products written in the D3DXQuaternionMultiply() order.
+
+    D3DXQUATERNION q0 = (D3DXQuaternionDot(pQ0, pQ1) < 0.0f) ? -*pQ0 : *pQ0;
+    D3DXQUATERNION q1 = *pQ1;
+    D3DXQUATERNION q2 = (D3DXQuaternionDot(pQ1, pQ2) < 0.0f) ? -*pQ2 : *pQ2;
+    D3DXQUATERNION q3 = (D3DXQuaternionDot(&q2, pQ3) < 0.0f) ? -*pQ3 : *pQ3;
+    const D3DXQUATERNION *pCenters[2] = { &q1, &q2 };
+    const D3DXQUATERNION *pPrevs[2] = { &q0, &q1 };
+    const D3DXQUATERNION *pNexts[2] = { &q2, &q3 };
+    D3DXQUATERNION *pOuts[2] = { pAOut, pBOut };
+
+    for (int i = 0; i < 2; ++i)
+    {
+        D3DXQUATERNION inverse;
+        D3DXQUATERNION prev;
+        D3DXQUATERNION next;
+        D3DXQUATERNION sum;
+
+        D3DXQuaternionInverse(&inverse, pCenters[i]);
+        D3DXQuaternionMultiply(&prev, &inverse, pPrevs[i]);
+        D3DXQuaternionMultiply(&next, &inverse, pNexts[i]);
+        D3DXQuaternionLn(&prev, &prev);
+        D3DXQuaternionLn(&next, &next);
+
+        sum = D3DXQUATERNION(-0.25f * (prev.x + next.x), -0.25f * (prev.y + next.y),
+                             -0.25f * (prev.z + next.z), -0.25f * (prev.w + next.w));
+
+        D3DXQuaternionExp(&sum, &sum);
+        D3DXQuaternionMultiply(pOuts[i], pCenters[i], &sum);
+    }
+
+    *pCOut = q2;
+}
+
+//-----------------------------------------------------------------------------
+// Matrix functions.
+//-----------------------------------------------------------------------------
+
+inline D3DXMATRIX *D3DXMatrixIdentity(D3DXMATRIX *pOut)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        for (int j = 0; j < 4; ++j)
+            pOut->m[i][j] = (i == j) ? 1.0f : 0.0f;
+    }
+
+    return pOut;
+}
+
+inline D3DXMATRIX *D3DXMatrixInverse(D3DXMATRIX *pOut, FLOAT *pDeterminant, const D3DXMATRIX *pM)
+{
+    // Cofactor expansion using the 2x2 sub-determinants of the top and bottom
+    // two rows. Returns 0 and leaves pOut alone if the matrix is singular.
+
+    const FLOAT (*m)[4] = pM->m;
+    FLOAT s0 = m[0][0] * m[1][1] - m[1][0] * m[0][1];
+    FLOAT s1 = m[0][0] * m[1][2] - m[1][0] * m[0][2];
+    FLOAT s2 = m[0][0] * m[1][3] - m[1][0] * m[0][3];
+    FLOAT s3 = m[0][1] * m[1][2] - m[1][1] * m[0][2];
+    FLOAT s4 = m[0][1] * m[1][3] - m[1][1] * m[0][3];
+    FLOAT s5 = m[0][2] * m[1][3] - m[1][2] * m[0][3];
+    FLOAT c5 = m[2][2] * m[3][3] - m[3][2] * m[2][3];
+    FLOAT c4 = m[2][1] * m[3][3] - m[3][1] * m[2][3];
+    FLOAT c3 = m[2][1] * m[3][2] - m[3][1] * m[2][2];
+    FLOAT c2 = m[2][0] * m[3][3] - m[3][0] * m[2][3];
+    FLOAT c1 = m[2][0] * m[3][2] - m[3][0] * m[2][2];
+    FLOAT c0 = m[2][0] * m[3][1] - m[3][0] * m[2][1];
+    FLOAT det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+
+    if (pDeterminant)
+        *pDeterminant = det;
+
+    if (det == 0.0f)
+        return 0;
+
+    FLOAT inv = 1.0f / det;
+    D3DXMATRIX r;
+
+    r.m[0][0] = ( m[1][1] * c5 - m[1][2] * c4 + m[1][3] * c3) * inv;
+    r.m[0][1] = (-m[0][1] * c5 + m[0][2] * c4 - m[0][3] * c3) * inv;
+    r.m[0][2] = ( m[3][1] * s5 - m[3][2] * s4 + m[3][3] * s3) * inv;
+    r.m[0][3] = (-m[2][1] * s5 + m[2][2] * s4 - m[2][3] * s3) * inv;
+
+    r.m[1][0] = (-m[1][0] * c5 + m[1][2] * c2 - m[1][3] * c1) * inv;
+    r.m[1][1] = ( m[0][0] * c5 - m[0][2] * c2 + m[0][3] * c1) * inv;
+    r.m[1][2] = (-m[3][0] * s5 + m[3][2] * s2 - m[3][3] * s1) * inv;
+    r.m[1][3] = ( m[2][0] * s5 - m[2][2] * s2 + m[2][3] * s1) * inv;
+
+    r.m[2][0] = ( m[1][0] * c4 - m[1][1] * c2 + m[1][3] * c0) * inv;
+    r.m[2][1] = (-m[0][0] * c4 + m[0][1] * c2 - m[0][3] * c0) * inv;
+    r.m[2][2] = ( m[3][0] * s4 - m[3][1] * s2 + m[3][3] * s0) * inv;
+    r.m[2][3] = (-m[2][0] * s4 + m[2][1] * s2 - m[2][3] * s0) * inv;
+
+    r.m[3][0] = (-m[1][0] * c3 + m[1][1] * c1 - m[1][2] * c0) * inv;
+    r.m[3][1] = ( m[0][0] * c3 - m[0][1] * c1 + m[0][2] * c0) * inv;
+    r.m[3][2] = (-m[3][0] * s3 + m[3][1] * s1 - m[3][2] * s0) * inv;
+    r.m[3][3] = ( m[2][0] * s3 - m[2][1] * s1 + m[2][2] * s0) * inv;
+
+    *pOut = r;
+    return pOut;
+}
+
+inline D3DXMATRIX *D3DXMatrixLookAtLH(D3DXMATRIX *pOut, const D3DXVECTOR3 *pEye,
+                                      const D3DXVECTOR3 *pAt, const D3DXVECTOR3 *pUp)
+{
+    D3DXVECTOR3 zAxis = *pAt - *pEye;
+    D3DXVECTOR3 xAxis;
+    D3DXVECTOR3 yAxis;
+
+    D3DXVec3Normalize(&zAxis, &zAxis);
+    D3DXVec3Cross(&xAxis, pUp, &zAxis);
+    D3DXVec3Normalize(&xAxis, &xAxis);
+    D3DXVec3Cross(&yAxis, &zAxis, &xAxis);
+
+    D3DXMatrixIdentity(pOut);
+
+    pOut->m[0][0] = xAxis.x;
+    pOut->m[1][0] = xAxis.y;
+    pOut->m[2][0] = xAxis.z;
+    pOut->m[3][0] = -D3DXVec3Dot(&xAxis, pEye);
+
+    pOut->m[0][1] = yAxis.x;
+    pOut->m[1][1] = yAxis.y;
+    pOut->m[2][1] = yAxis.z;
+    pOut->m[3][1] = -D3DXVec3Dot(&yAxis, pEye);
+
+    pOut->m[0][2] = zAxis.x;
+    pOut->m[1][2] = zAxis.y;
+    pOut->m[2][2] = zAxis.z;
+    pOut->m[3][2] = -D3DXVec3Dot(&zAxis, pEye);
+
+    return pOut;
+}
+
+inline D3DXMATRIX *D3DXMatrixMultiply(D3DXMATRIX *pOut, const D3DXMATRIX *pM1, const D3DXMATRIX *pM2)
+{
+    *pOut = *pM1 * *pM2;
+    return pOut;
+}
+
+inline D3DXMATRIX *D3DXMatrixPerspectiveFovLH(D3DXMATRIX *pOut, FLOAT fovy, FLOAT aspect,
+                                              FLOAT zn, FLOAT zf)
+{
+    FLOAT yScale = 1.0f / tanf(fovy * 0.5f);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        for (int j = 0; j < 4; ++j)
+            pOut->m[i][j] = 0.0f;
+    }
+
+    pOut->m[0][0] = yScale / aspect;
+    pOut->m[1][1] = yScale;
+    pOut->m[2][2] = zf / (zf - zn);
+    pOut->m[2][3] = 1.0f;
+    pOut->m[3][2] = -zn * zf / (zf - zn);
+
+    return pOut;
+}
+
+inline D3DXMATRIX *D3DXMatrixRotationAxis(D3DXMATRIX *pOut, const D3DXVECTOR3 *pV, FLOAT angle)
+{
+    D3DXVECTOR3 v;
+
+    D3DXVec3Normalize(&v, pV);
+
+    FLOAT s = sinf(angle);
+    FLOAT c = cosf(angle);
+    FLOAT t = 1.0f - c;
+
+    D3DXMatrixIdentity(pOut);
+
+    pOut->m[0][0] = t * v.x * v.x + c;
+    pOut->m[1][0] = t * v.x * v.y - s * v.z;
+    pOut->m[2][0] = t * v.x * v.z + s * v.y;
+
+    pOut->m[0][1] = t * v.y * v.x + s * v.z;
+    pOut->m[1][1] = t * v.y * v.y + c;
+    pOut->m[2][1] = t * v.y * v.z - s * v.x;
+
+    pOut->m[0][2] = t * v.z * v.x - s * v.y;
+    pOut->m[1][2] = t * v.z * v.y + s * v.x;
+    pOut->m[2][2] = t * v.z * v.z + c;
+
+    return pOut;
+}
+
+inline D3DXMATRIX *D3DXMatrixRotationQuaternion(D3DXMATRIX *pOut, const D3DXQUATERNION *pQ)
+{
+    FLOAT x = pQ->x;
+    FLOAT y = pQ->y;
+    FLOAT z = pQ->z;
+    FLOAT w = pQ->w;
+
+    D3DXMatrixIdentity(pOut);
+
+    pOut->m[0][0] = 1.0f - 2.0f * (y * y + z * z);
+    pOut->m[0][1] = 2.0f * (x * y + z * w);
+    pOut->m[0][2] = 2.0f * (x * z - y * w);
+
+    pOut->m[1][0] = 2.0f * (x * y - z * w);
+    pOut->m[1][1] = 1.0f - 2.0f * (x * x + z * z);
+    pOut->m[1][2] = 2.0f * (y * z + x * w);
+
+    pOut->m[2][0] = 2.0f * (x * z + y * w);
+    pOut->m[2][1] = 2.0f * (y * z - x * w);
+    pOut->m[2][2] = 1.0f - 2.0f * (x * x + y * y);
+
+    return pOut;
+}
+
+inline D3DXMATRIX *D3DXMatrixRotationY(D3DXMATRIX *pOut, FLOAT angle)
+{
+    FLOAT s = sinf(angle);
+    FLOAT c = cosf(angle);
+
+    D3DXMatrixIdentity(pOut);
+
+    pOut->m[0][0] = c;
+    pOut->m[0][2] = -s;
+    pOut->m[2][0] = s;
+    pOut->m[2][2] = c;
+
+    return pOut;
+}
+
+inline D3DXMATRIX *D3DXMatrixTranslation(D3DXMATRIX *pOut, FLOAT x, FLOAT y, FLOAT z)
+{
+    D3DXMatrixIdentity(pOut);
+
+    pOut->m[3][0] = x;
+    pOut->m[3][1] = y;
+    pOut->m[3][2] = z;
+
+    return pOut;
+}
+
+#endif
@@ -0,0 +1,135 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(PORTABLE_DINPUT_H)
+#define PORTABLE_DINPUT_H
+
+//-----------------------------------------------------------------------------
+// Stands in for the DirectInput header on other platforms. Declares what the
+// Keyboard and Mouse classes use. DirectInput8Create() always fails, so the
+// classes never get a device and their update() calls without a state do
+// nothing, as on a machine without a keyboard or a mouse. Their update()
+// calls that take a recorded or synthetic state work as they do on Windows,
+// which is what the headless tests and benchmarks use.
+//-----------------------------------------------------------------------------
+
+#include <windows.h>
+
+struct GUID
+{
+    DWORD data1;
+    WORD data2;
+    WORD data3;
+    BYTE data4[8];
+};
+
+typedef const GUID &REFGUID;
+typedef const GUID &REFIID;
+
+const GUID IID_IDirectInput8 = {0, 0, 0, {0}};
+const GUID GUID_SysKeyboard = {0, 0, 0, {0}};
+const GUID GUID_SysMouse = {0, 0, 0, {0}};
+
+#define DIERR_INPUTLOST     static_cast<HRESULT>(0x8007001E)
+#define DIERR_NOTACQUIRED   static_cast<HRESULT>(0x8007000C)
+
+#define DISCL_EXCLUSIVE     0x00000001
+#define DISCL_NONEXCLUSIVE  0x00000002
+#define DISCL_FOREGROUND    0x00000004
+
+#define DIPH_DEVICE         0
+#define DIPROP_BUFFERSIZE   (*reinterpret_cast<const GUID*>(1))
+
+#define DIMOFS_X            0
+#define DIMOFS_Y            4
+#define DIMOFS_Z            8
+#define DIMOFS_BUTTON0      12
+#define DIMOFS_BUTTON1      13
+#define DIMOFS_BUTTON2      14
+#define DIMOFS_BUTTON3      15
+
+struct DIDATAFORMAT
+{
+    DWORD dwSize;
+};
+
+const DIDATAFORMAT c_dfDIKeyboard = {0};
+const DIDATAFORMAT c_dfDIMouse = {0};
+
+struct DIDEVICEOBJECTDATA
+{
+    DWORD dwOfs;
+    DWORD dwData;
+    DWORD dwTimeStamp;
+    DWORD dwSequence;
+    UINT_PTR uAppData;
+};
+
+struct DIMOUSESTATE
+{
+    LONG lX;
+    LONG lY;
+    LONG lZ;
+    BYTE rgbButtons[4];
+};
+
+struct DIPROPHEADER
+{
+    DWORD dwSize;
+    DWORD dwHeaderSize;
+    DWORD dwObj;
+    DWORD dwHow;
+};
+
+struct DIPROPDWORD
+{
+    DIPROPHEADER diph;
+    DWORD dwData;
+};
+
+struct IDirectInputDevice8
+{
+    virtual HRESULT Acquire() = 0;
+    virtual HRESULT GetDeviceData(DWORD cbObjectData, DIDEVICEOBJECTDATA *rgdod,
+                                  DWORD *pdwInOut, DWORD dwFlags) = 0;
+    virtual HRESULT GetDeviceState(DWORD cbData, void *lpvData) = 0;
+    virtual HRESULT SetCooperativeLevel(HWND hWnd, DWORD dwFlags) = 0;
+    virtual HRESULT SetDataFormat(const DIDATAFORMAT *lpdf) = 0;
+    virtual HRESULT SetProperty(REFGUID rguidProp, const DIPROPHEADER *pdiph) = 0;
+    virtual HRESULT Unacquire() = 0;
+    virtual ULONG Release() = 0;
+};
+
+struct IDirectInput8
+{
+    virtual HRESULT CreateDevice(REFGUID rguid, IDirectInputDevice8 **lplpDirectInputDevice,
+                                 void *pUnkOuter) = 0;
+    virtual ULONG Release() = 0;
+};
+
+inline HRESULT DirectInput8Create(HINSTANCE, DWORD, REFIID, void **ppvOut, void *)
+{
+    *ppvOut = 0;
+    return E_FAIL;
+}
+
+#endif
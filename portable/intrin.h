@@ -0,0 +1,56 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(PORTABLE_INTRIN_H)
+#define PORTABLE_INTRIN_H
+
+//-----------------------------------------------------------------------------
+// Stands in for the Visual C++ intrinsics header on other platforms. Only
+// _ReadWriteBarrier() and _BitScanForward() are provided.
+//
+// Visual C++ only targets x86 and x64 here, where the hardware never reorders
+// loads with loads or stores with stores, so its _ReadWriteBarrier() only has
+// to stop the compiler. Other platforms can be weakly ordered (ARM, POWER),
+// so the stand in is a real fence: no load or store before it can be
+// reordered with a store after it, and no load before it can be reordered
+// with a load or store after it. That is both an acquire and a release fence,
+// which is what every caller needs it to be. It still emits no instructions
+// on x86.
+//-----------------------------------------------------------------------------
+
+inline void _ReadWriteBarrier()
+{
+    __atomic_thread_fence(__ATOMIC_ACQ_REL);
+}
+
+inline unsigned char _BitScanForward(unsigned long *pIndex, unsigned long mask)
+{
+    // Leaves *pIndex alone if no bit is set, as Visual C++ documents it.
+
+    if (mask == 0)
+        return 0;
+
+    *pIndex = static_cast<unsigned long>(__builtin_ctzl(mask));
+    return 1;
+}
+
+#endif
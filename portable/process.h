@@ -0,0 +1,72 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(PORTABLE_PROCESS_H)
+#define PORTABLE_PROCESS_H
+
+//-----------------------------------------------------------------------------
+// Stands in for the C runtime's process.h on other platforms. Only
+// _beginthreadex() is provided. See windows.h in this directory.
+//-----------------------------------------------------------------------------
+
+#include <windows.h>
+
+inline void *PortableThreadProc(void *pArg)
+{
+    // Threads created with CREATE_SUSPENDED wait here until ResumeThread().
+
+    PortableHandle *pHandle = static_cast<PortableHandle*>(pArg);
+
+    while (sem_wait(&pHandle->semaphore) != 0)
+        ;
+
+    pHandle->pfnStart(pHandle->pArg);
+    return 0;
+}
+
+inline uintptr_t _beginthreadex(void *, unsigned int, unsigned int (*pfnStart)(void *),
+                                void *pArg, unsigned int initFlag, unsigned int *)
+{
+    PortableHandle *pHandle = new PortableHandle;
+
+    pHandle->type = PortableHandle::TYPE_THREAD;
+    pHandle->pfnStart = pfnStart;
+    pHandle->pArg = pArg;
+    pHandle->suspended = (initFlag & CREATE_SUSPENDED) != 0;
+
+    if (sem_init(&pHandle->semaphore, 0, pHandle->suspended ? 0 : 1) != 0)
+    {
+        delete pHandle;
+        return 0;
+    }
+
+    if (pthread_create(&pHandle->thread, 0, PortableThreadProc, pHandle) != 0)
+    {
+        sem_destroy(&pHandle->semaphore);
+        delete pHandle;
+        return 0;
+    }
+
+    return reinterpret_cast<uintptr_t>(pHandle);
+}
+
+#endif
@@ -0,0 +1,364 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(PORTABLE_WINDOWS_H)
+#define PORTABLE_WINDOWS_H
+
+//-----------------------------------------------------------------------------
+// Stands in for the Windows SDK header on other platforms. Only the types
+// and the thread, semaphore, thread local storage, and interlocked functions
+// that the portable sources (the job system, the camera code, the input
+// classes, and the headless tests) use are provided, implemented on top of
+// POSIX threads. This
+// directory is only on the include path of non-Windows builds; see
+// CMakeLists.txt.
+//
+// Threads and semaphores are both HANDLEs so that WaitForSingleObject() and
+// CloseHandle() work on either. Processor affinity uses the Linux specific
+// sched_getaffinity() and pthread_setaffinity_np() and is limited to the first
+// 64 processors, the same as a single Windows processor group.
+//-----------------------------------------------------------------------------
+
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdint.h>
+#include <time.h>
+
+#define WINAPI
+#define __stdcall
+
+typedef int BOOL;
+typedef unsigned char BYTE;
+typedef int LONG;
+typedef LONG HRESULT;
+typedef unsigned int UINT;
+typedef unsigned int ULONG;
+typedef uintptr_t UINT_PTR;
+typedef unsigned short WORD;
+typedef unsigned int DWORD;
+typedef uintptr_t DWORD_PTR;
+typedef intptr_t INT_PTR;
+typedef uintptr_t WPARAM;
+typedef intptr_t LPARAM;
+typedef void *HANDLE;
+typedef struct HWND__ *HWND;
+typedef struct HINSTANCE__ *HINSTANCE;
+
+#define INFINITE            0xFFFFFFFF
+#define CREATE_SUSPENDED    0x00000004
+#define TLS_OUT_OF_INDEXES  0xFFFFFFFF
+#define WAIT_OBJECT_0       0
+#define WAIT_FAILED         0xFFFFFFFF
+#define WM_CHAR             0x0102
+
+#define S_OK                static_cast<HRESULT>(0)
+#define E_FAIL              static_cast<HRESULT>(0x80004005)
+#define SUCCEEDED(hr)       (static_cast<HRESULT>(hr) >= 0)
+#define FAILED(hr)          (static_cast<HRESULT>(hr) < 0)
+
+//-----------------------------------------------------------------------------
+// Kernel objects.
+//-----------------------------------------------------------------------------
+
+struct PortableHandle
+{
+    enum Type
+    {
+        TYPE_PROCESS,
+        TYPE_SEMAPHORE,
+        TYPE_THREAD
+    };
+
+    Type type;
+    sem_t semaphore;                        // the semaphore, or a thread's start gate
+    pthread_t thread;
+    unsigned int (*pfnStart)(void *pArg);
+    void *pArg;
+    bool suspended;
+};
+
+inline HANDLE GetCurrentProcess()
+{
+    // The pseudo handle is never waited on or closed, so only its type is
+    // ever looked at. Every field is still initialized to keep -Wextra quiet.
+
+    static PortableHandle process =
+    {
+        PortableHandle::TYPE_PROCESS,   // type
+        sem_t(),                        // semaphore
+        pthread_t(),                    // thread
+        0,                              // pfnStart
+        0,                              // pArg
+        false                           // suspended
+    };
+
+    return &process;
+}
+
+inline BOOL CloseHandle(HANDLE hObject)
+{
+    PortableHandle *pHandle = static_cast<PortableHandle*>(hObject);
+
+    if (!pHandle || pHandle->type == PortableHandle::TYPE_PROCESS)
+        return 0;
+
+    if (pHandle->type == PortableHandle::TYPE_THREAD)
+        pthread_detach(pHandle->thread);
+
+    sem_destroy(&pHandle->semaphore);
+    delete pHandle;
+    return 1;
+}
+
+inline DWORD WaitForSingleObject(HANDLE hObject, DWORD)
+{
+    // Only infinite waits are supported. Waiting on a thread joins it, so a
+    // thread may only be waited on once.
+
+    PortableHandle *pHandle = static_cast<PortableHandle*>(hObject);
+
+    if (pHandle->type == PortableHandle::TYPE_THREAD)
+    {
+        if (pthread_join(pHandle->thread, 0) != 0)
+            return WAIT_FAILED;
+
+        pHandle->type = PortableHandle::TYPE_SEMAPHORE;
+        return WAIT_OBJECT_0;
+    }
+
+    while (sem_wait(&pHandle->semaphore) != 0)
+        ;
+
+    return WAIT_OBJECT_0;
+}
+
+//-----------------------------------------------------------------------------
+// Semaphores. The maximum count isn't enforced.
+//-----------------------------------------------------------------------------
+
+inline HANDLE CreateSemaphore(void *, LONG initialCount, LONG, const char *)
+{
+    PortableHandle *pHandle = new PortableHandle;
+
+    pHandle->type = PortableHandle::TYPE_SEMAPHORE;
+
+    if (sem_init(&pHandle->semaphore, 0, static_cast<unsigned int>(initialCount)) != 0)
+    {
+        delete pHandle;
+        return 0;
+    }
+
+    return pHandle;
+}
+
+inline BOOL ReleaseSemaphore(HANDLE hSemaphore, LONG releaseCount, LONG *)
+{
+    PortableHandle *pHandle = static_cast<PortableHandle*>(hSemaphore);
+
+    for (LONG i = 0; i < releaseCount; ++i)
+    {
+        if (sem_post(&pHandle->semaphore) != 0)
+            return 0;
+    }
+
+    return 1;
+}
+
+//-----------------------------------------------------------------------------
+// Threads. See process.h for _beginthreadex().
+//-----------------------------------------------------------------------------
+
+inline DWORD ResumeThread(HANDLE hThread)
+{
+    // Threads only ever start out suspended. Resuming a running thread does
+    // nothing.
+
+    PortableHandle *pHandle = static_cast<PortableHandle*>(hThread);
+
+    if (pHandle->type != PortableHandle::TYPE_THREAD || !pHandle->suspended)
+        return 0;
+
+    pHandle->suspended = false;
+    sem_post(&pHandle->semaphore);
+    return 1;
+}
+
+inline void Sleep(DWORD milliseconds)
+{
+    // Sleep(0) gives up the rest of the time slice.
+
+    if (milliseconds == 0)
+    {
+        sched_yield();
+        return;
+    }
+
+    timespec duration;
+
+    duration.tv_sec = static_cast<time_t>(milliseconds / 1000);
+    duration.tv_nsec = static_cast<long>(milliseconds % 1000) * 1000000L;
+
+    while (nanosleep(&duration, &duration) != 0)
+        ;
+}
+
+inline BOOL GetProcessAffinityMask(HANDLE, DWORD_PTR *pProcessMask, DWORD_PTR *pSystemMask)
+{
+    cpu_set_t cpus;
+
+    CPU_ZERO(&cpus);
+
+    if (sched_getaffinity(0, sizeof(cpus), &cpus) != 0)
+        return 0;
+
+    *pProcessMask = 0;
+
+    for (int i = 0; i < static_cast<int>(sizeof(DWORD_PTR) * 8); ++i)
+    {
+        if (CPU_ISSET(i, &cpus))
+            *pProcessMask |= static_cast<DWORD_PTR>(1) << i;
+    }
+
+    *pSystemMask = *pProcessMask;
+    return 1;
+}
+
+inline DWORD_PTR SetThreadAffinityMask(HANDLE hThread, DWORD_PTR mask)
+{
+    PortableHandle *pHandle = static_cast<PortableHandle*>(hThread);
+    cpu_set_t cpus;
+
+    CPU_ZERO(&cpus);
+
+    for (int i = 0; i < static_cast<int>(sizeof(DWORD_PTR) * 8); ++i)
+    {
+        if (mask & (static_cast<DWORD_PTR>(1) << i))
+            CPU_SET(i, &cpus);
+    }
+
+    if (pthread_setaffinity_np(pHandle->thread, sizeof(cpus), &cpus) != 0)
+        return 0;
+
+    return mask;
+}
+
+//-----------------------------------------------------------------------------
+// Windows and time. There are no windows, so there's never a foreground
+// window for a device to be bound to.
+//-----------------------------------------------------------------------------
+
+inline HWND GetForegroundWindow()
+{
+    return 0;
+}
+
+inline HINSTANCE GetModuleHandle(const char *)
+{
+    return 0;
+}
+
+inline DWORD GetTickCount()
+{
+    // Milliseconds since an arbitrary start, wrapping around the same way.
+
+    timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<DWORD>(static_cast<long long>(now.tv_sec) * 1000 + now.tv_nsec / 1000000);
+}
+
+//-----------------------------------------------------------------------------
+// Thread local storage.
+//-----------------------------------------------------------------------------
+
+inline DWORD TlsAlloc()
+{
+    pthread_key_t key;
+
+    if (pthread_key_create(&key, 0) != 0)
+        return TLS_OUT_OF_INDEXES;
+
+    return static_cast<DWORD>(key);
+}
+
+inline BOOL TlsFree(DWORD index)
+{
+    return pthread_key_delete(static_cast<pthread_key_t>(index)) == 0;
+}
+
+inline void *TlsGetValue(DWORD index)
+{
+    return pthread_getspecific(static_cast<pthread_key_t>(index));
+}
+
+inline BOOL TlsSetValue(DWORD index, void *pValue)
+{
+    return pthread_setspecific(static_cast<pthread_key_t>(index), pValue) == 0;
+}
+
+//-----------------------------------------------------------------------------
+// Interlocked operations and barriers. The interlocked operations are full
+// barriers, as they are on Windows.
+//-----------------------------------------------------------------------------
+
+inline LONG InterlockedCompareExchange(volatile LONG *pDest, LONG exchange, LONG comparand)
+{
+    return __sync_val_compare_and_swap(pDest, comparand, exchange);
+}
+
+inline LONG InterlockedDecrement(volatile LONG *pValue)
+{
+    return __sync_sub_and_fetch(pValue, 1);
+}
+
+inline LONG InterlockedExchange(volatile LONG *pDest, LONG value)
+{
+    // __sync_lock_test_and_set() is only an acquire barrier. Callers rely on
+    // the exchange being a full fence in both directions (the job system's
+    // deque stores bottom and then loads top), so the store must also be
+    // ordered before every later load.
+
+    LONG previous = __atomic_exchange_n(pDest, value, __ATOMIC_SEQ_CST);
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return previous;
+}
+
+inline LONG InterlockedIncrement(volatile LONG *pValue)
+{
+    return __sync_add_and_fetch(pValue, 1);
+}
+
+inline void MemoryBarrier()
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+inline void YieldProcessor()
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#endif
+}
+
+#endif
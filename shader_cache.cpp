@@ -0,0 +1,155 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <windows.h>
+#include <cstdio>
+#include "shader_cache.h"
+
+namespace
+{
+    const unsigned long long FNV_PRIME = 1099511628211ULL;
+
+    // Entries start with this header. "FXC1" in the native (little endian)
+    // byte order.
+    struct EntryHeader
+    {
+        unsigned int magic;
+        unsigned int size;
+        unsigned long long key;
+    };
+
+    const unsigned int ENTRY_MAGIC = 0x31435846;
+}
+
+ShaderCache::ShaderCache()
+{
+}
+
+ShaderCache::~ShaderCache()
+{
+    destroy();
+}
+
+bool ShaderCache::create(const char *pszDirectory)
+{
+    destroy();
+
+    if (!CreateDirectory(pszDirectory, 0) && GetLastError() != ERROR_ALREADY_EXISTS)
+        return false;
+
+    m_directory = pszDirectory;
+    return true;
+}
+
+void ShaderCache::destroy()
+{
+    m_directory.clear();
+}
+
+unsigned long long ShaderCache::hash(const void *pData, unsigned int size,
+                                     unsigned long long hash)
+{
+    const unsigned char *pBytes = static_cast<const unsigned char *>(pData);
+
+    for (unsigned int i = 0; i < size; ++i)
+    {
+        hash ^= pBytes[i];
+        hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
+
+bool ShaderCache::load(unsigned long long key, std::vector<char> &data) const
+{
+    // 'data' is left empty if the entry isn't in the cache.
+
+    data.clear();
+
+    if (!isOpen())
+        return false;
+
+    FILE *pFile = fopen(entryFilename(key).c_str(), "rb");
+
+    if (!pFile)
+        return false;
+
+    EntryHeader header;
+    bool loaded = false;
+
+    if (fread(&header, sizeof(header), 1, pFile) == 1
+        && header.magic == ENTRY_MAGIC && header.key == key && header.size > 0)
+    {
+        data.resize(header.size);
+
+        if (fread(&data[0], header.size, 1, pFile) == 1)
+            loaded = true;
+        else
+            data.clear();
+    }
+
+    fclose(pFile);
+    return loaded;
+}
+
+bool ShaderCache::remove(unsigned long long key) const
+{
+    return isOpen() && DeleteFile(entryFilename(key).c_str()) != 0;
+}
+
+bool ShaderCache::store(unsigned long long key, const void *pData, unsigned int size) const
+{
+    if (!isOpen() || size == 0)
+        return false;
+
+    std::string filename = entryFilename(key);
+    std::string tempFilename = filename + ".tmp";
+    FILE *pFile = fopen(tempFilename.c_str(), "wb");
+
+    if (!pFile)
+        return false;
+
+    EntryHeader header = {ENTRY_MAGIC, size, key};
+    bool written = fwrite(&header, sizeof(header), 1, pFile) == 1
+        && fwrite(pData, size, 1, pFile) == 1;
+
+    if (fclose(pFile) != 0)
+        written = false;
+
+    if (!written || !MoveFileEx(tempFilename.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING))
+    {
+        DeleteFile(tempFilename.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+std::string ShaderCache::entryFilename(unsigned long long key) const
+{
+    char szName[32];
+
+    sprintf(szName, "\\%08x%08x.fxo",
+        static_cast<unsigned int>(key >> 32), static_cast<unsigned int>(key));
+
+    return m_directory + szName;
+}
@@ -0,0 +1,76 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(SHADER_CACHE_H)
+#define SHADER_CACHE_H
+
+#include <string>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// The ShaderCache class keeps compiled shaders in a directory on disk, keyed
+// by a 64-bit hash of everything that affects the compiler's output: the
+// source text, the compile flags, and the compiler version. Since the key
+// changes whenever the source does there's nothing to invalidate. Entries
+// for old versions of a shader are simply never looked up again.
+//
+// Each entry is written to a temporary file that's then renamed over the
+// entry, so a crash part way through store() never leaves a truncated entry
+// behind. Entries also start with their key and size, and load() ignores
+// ones that don't match.
+//-----------------------------------------------------------------------------
+
+class ShaderCache
+{
+public:
+    ShaderCache();
+    ~ShaderCache();
+
+    bool create(const char *pszDirectory);
+    void destroy();
+    bool load(unsigned long long key, std::vector<char> &data) const;
+    bool remove(unsigned long long key) const;
+    bool store(unsigned long long key, const void *pData, unsigned int size) const;
+
+    // 64-bit FNV-1a. Pass the previous hash as 'hash' to hash more data.
+    static unsigned long long hash(const void *pData, unsigned int size,
+                                   unsigned long long hash = 14695981039346656037ULL);
+
+    // Getter methods.
+
+    bool isOpen() const;
+
+private:
+    ShaderCache(const ShaderCache &);
+    ShaderCache &operator=(const ShaderCache &);
+
+    std::string entryFilename(unsigned long long key) const;
+
+    std::string m_directory;
+};
+
+//-----------------------------------------------------------------------------
+
+inline bool ShaderCache::isOpen() const
+{ return !m_directory.empty(); }
+
+#endif
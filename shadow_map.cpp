@@ -0,0 +1,465 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <cmath>
+#include <xmmintrin.h>
+#include "job_system.h"
+#include "shadow_map.h"
+
+namespace
+{
+    const float MAX_SPOT_FOV = D3DXToRadian(170.0f);
+    const float DEFAULT_SOFTWARE_SHADOW_BIAS = 0.02f;
+
+    // Enough batches for the job system to balance lights with many casters
+    // against lights with few.
+    const int BATCHES_PER_THREAD = 4;
+
+    void ExtractPlanes(const D3DXMATRIX &viewProj, float planes[4][8])
+    {
+        // Same as CameraSet::extractPlanes(). The planes point into the
+        // frustum and the last 2 are padding that every sphere passes.
+
+        float n[6][4];
+
+        for (int j = 0; j < 4; ++j)
+        {
+            n[0][j] = viewProj(j,3) + viewProj(j,0);    // left
+            n[1][j] = viewProj(j,3) - viewProj(j,0);    // right
+            n[2][j] = viewProj(j,3) + viewProj(j,1);    // bottom
+            n[3][j] = viewProj(j,3) - viewProj(j,1);    // top
+            n[4][j] = viewProj(j,2);                    // near
+            n[5][j] = viewProj(j,3) - viewProj(j,2);    // far
+        }
+
+        for (int i = 0; i < 6; ++i)
+        {
+            float length = sqrtf(n[i][0] * n[i][0] + n[i][1] * n[i][1] + n[i][2] * n[i][2]);
+            float invLength = (length > 1e-6f * fabsf(n[i][3])) ? 1.0f / length : 0.0f;
+
+            for (int j = 0; j < 4; ++j)
+                planes[j][i] = n[i][j] * invLength;
+        }
+
+        for (int i = 6; i < 8; ++i)
+        {
+            planes[0][i] = 0.0f;
+            planes[1][i] = 0.0f;
+            planes[2][i] = 0.0f;
+            planes[3][i] = 1.0f;
+        }
+    }
+}
+
+void SpotLightViewProjection(const D3DXVECTOR3 &pos, const D3DXVECTOR3 &dir,
+                             float outerCone, float znear, float radius,
+                             D3DXMATRIX &viewProj)
+{
+    // The cone fits inside the square frustum. Any up vector that isn't
+    // parallel to the light's direction will do.
+
+    D3DXVECTOR3 target = pos + dir;
+    D3DXVECTOR3 up = (fabsf(dir.y) > 0.99f * D3DXVec3Length(&dir))
+        ? D3DXVECTOR3(0.0f, 0.0f, 1.0f) : D3DXVECTOR3(0.0f, 1.0f, 0.0f);
+    float fov = (outerCone < MAX_SPOT_FOV) ? outerCone : MAX_SPOT_FOV;
+    D3DXMATRIX view;
+    D3DXMATRIX proj;
+
+    D3DXMatrixLookAtLH(&view, &pos, &target, &up);
+    D3DXMatrixPerspectiveFovLH(&proj, fov, 1.0f, znear, radius);
+
+    viewProj = view * proj;
+}
+
+//-----------------------------------------------------------------------------
+// ShadowAtlas.
+//-----------------------------------------------------------------------------
+
+ShadowAtlas::ShadowAtlas()
+{
+    m_frame = 0;
+    m_atlasSize = 0;
+    m_slotSize = 0;
+    m_slotsPerRow = 0;
+    m_hitCount = 0;
+    m_missCount = 0;
+    m_evictionCount = 0;
+}
+
+ShadowAtlas::~ShadowAtlas()
+{
+    destroy();
+}
+
+int ShadowAtlas::allocate(int lightId, bool &isCached)
+{
+    // Returns the light's slot. 'isCached' is set if the slot still holds
+    // the light's shadow map from an earlier frame. Otherwise the caller
+    // must render the shadow map into the slot. A light that doesn't have a
+    // slot takes a free one or else the least recently used one. Slots used
+    // this frame are never taken. Returns -1 when every slot is in use this
+    // frame.
+
+    int victim = -1;
+
+    isCached = false;
+
+    for (int i = 0; i < static_cast<int>(m_slots.size()); ++i)
+    {
+        Slot &slot = m_slots[i];
+
+        if (slot.lightId == lightId)
+        {
+            isCached = slot.isValid;
+
+            if (isCached)
+                ++m_hitCount;
+            else
+                ++m_missCount;
+
+            slot.lastUsedFrame = m_frame;
+            slot.isValid = true;
+            return i;
+        }
+
+        if (slot.lightId < 0)
+        {
+            if (victim < 0 || m_slots[victim].lightId >= 0)
+                victim = i;
+
+            continue;
+        }
+
+        if (slot.lastUsedFrame == m_frame)
+            continue;
+
+        if (victim < 0 || (m_slots[victim].lightId >= 0
+            && slot.lastUsedFrame < m_slots[victim].lastUsedFrame))
+        {
+            victim = i;
+        }
+    }
+
+    if (victim < 0)
+        return -1;
+
+    Slot &slot = m_slots[victim];
+
+    if (slot.lightId >= 0)
+        ++m_evictionCount;
+
+    ++m_missCount;
+    slot.lightId = lightId;
+    slot.lastUsedFrame = m_frame;
+    slot.isValid = true;
+    return victim;
+}
+
+void ShadowAtlas::beginFrame()
+{
+    ++m_frame;
+}
+
+void ShadowAtlas::create(int atlasSize, int slotSize)
+{
+    // The atlas is split into a grid of square slots of slotSize texels.
+
+    destroy();
+
+    if (atlasSize <= 0 || slotSize <= 0 || slotSize > atlasSize)
+        return;
+
+    Slot emptySlot = { -1, 0, false };
+
+    m_atlasSize = atlasSize;
+    m_slotSize = slotSize;
+    m_slotsPerRow = atlasSize / slotSize;
+    m_slots.assign(m_slotsPerRow * m_slotsPerRow, emptySlot);
+}
+
+void ShadowAtlas::destroy()
+{
+    m_slots.clear();
+    m_frame = 0;
+    m_atlasSize = 0;
+    m_slotSize = 0;
+    m_slotsPerRow = 0;
+    m_hitCount = 0;
+    m_missCount = 0;
+    m_evictionCount = 0;
+}
+
+void ShadowAtlas::getSlotRect(int slot, int &x, int &y, int &size) const
+{
+    x = (slot % m_slotsPerRow) * m_slotSize;
+    y = (slot / m_slotsPerRow) * m_slotSize;
+    size = m_slotSize;
+}
+
+void ShadowAtlas::invalidate(int lightId)
+{
+    // Call when the light or any of its casters move. The light keeps its
+    // slot but the shadow map must be rendered again. A light id of -1
+    // invalidates every slot, e.g., after the atlas texture has been lost.
+
+    for (size_t i = 0; i < m_slots.size(); ++i)
+    {
+        if (lightId < 0 || m_slots[i].lightId == lightId)
+            m_slots[i].isValid = false;
+    }
+}
+
+void ShadowAtlas::textureMatrix(int slot, D3DXMATRIX &matrix) const
+{
+    // Maps the light's clip space to the slot's texture coordinates. z and w
+    // are passed through so the shader can divide and compare depths. The
+    // extra half texel lines texels up with pixels in Direct3D 9.
+
+    int x = 0;
+    int y = 0;
+    int size = 0;
+
+    getSlotRect(slot, x, y, size);
+
+    float invAtlasSize = 1.0f / m_atlasSize;
+    float scale = 0.5f * size * invAtlasSize;
+
+    D3DXMatrixIdentity(&matrix);
+    matrix(0,0) = scale;
+    matrix(1,1) = -scale;
+    matrix(3,0) = (x + 0.5f * size + 0.5f) * invAtlasSize;
+    matrix(3,1) = (y + 0.5f * size + 0.5f) * invAtlasSize;
+}
+
+//-----------------------------------------------------------------------------
+// ShadowCasterCuller.
+//-----------------------------------------------------------------------------
+
+ShadowCasterCuller::ShadowCasterCuller()
+{
+    m_pCenters = 0;
+    m_pRadii = 0;
+    m_lightCount = 0;
+    m_casterCount = 0;
+}
+
+ShadowCasterCuller::~ShadowCasterCuller()
+{
+}
+
+void ShadowCasterCuller::cull(JobSystem *pJobSystem, const D3DXMATRIX *pLightViewProjs,
+                              int lightCount, const D3DXVECTOR3 *pCenters,
+                              const float *pRadii, int casterCount)
+{
+    // Finds the bounding spheres inside each light's frustum. The caster
+    // lists are kept between calls so that they don't have to be allocated
+    // every frame. Pass a null job system to cull on the calling thread.
+
+    m_pCenters = pCenters;
+    m_pRadii = pRadii;
+    m_lightCount = lightCount;
+    m_casterCount = casterCount;
+
+    if (static_cast<int>(m_casters.size()) < lightCount)
+        m_casters.resize(lightCount);
+
+    m_planes.resize(lightCount);
+
+    for (int i = 0; i < lightCount; ++i)
+        ExtractPlanes(pLightViewProjs[i], m_planes[i].n);
+
+    int batchCount = 1;
+
+    if (pJobSystem)
+        batchCount = (pJobSystem->workerCount() + 1) * BATCHES_PER_THREAD;
+
+    if (batchCount > lightCount)
+        batchCount = lightCount;
+
+    if (batchCount <= 1)
+    {
+        cullBatch(0, lightCount);
+        return;
+    }
+
+    m_batches.resize(batchCount);
+
+    JobCounter counter;
+
+    for (int i = 0; i < batchCount; ++i)
+    {
+        Batch &batch = m_batches[i];
+
+        batch.pCuller = this;
+        batch.firstLight = lightCount * i / batchCount;
+        batch.endLight = lightCount * (i + 1) / batchCount;
+        pJobSystem->submit(cullBatchJob, &batch, &counter);
+    }
+
+    pJobSystem->wait(&counter);
+}
+
+void ShadowCasterCuller::cullBatchJob(void *pData)
+{
+    Batch *pBatch = static_cast<Batch *>(pData);
+
+    pBatch->pCuller->cullBatch(pBatch->firstLight, pBatch->endLight);
+}
+
+void ShadowCasterCuller::cullBatch(int firstLight, int endLight)
+{
+    // Each light only writes its own caster list, so batches don't share
+    // anything they write to.
+
+    for (int light = firstLight; light < endLight; ++light)
+    {
+        const FrustumPlanes &planes = m_planes[light];
+        std::vector<int> &casters = m_casters[light];
+
+        casters.clear();
+
+        for (int i = 0; i < m_casterCount; ++i)
+        {
+            const D3DXVECTOR3 &center = m_pCenters[i];
+            __m128 cx = _mm_set1_ps(center.x);
+            __m128 cy = _mm_set1_ps(center.y);
+            __m128 cz = _mm_set1_ps(center.z);
+            __m128 negRadius = _mm_set1_ps(-m_pRadii[i]);
+            int outside = 0;
+
+            for (int j = 0; j < PLANE_COUNT; j += 4)
+            {
+                __m128 dist = _mm_mul_ps(_mm_loadu_ps(&planes.n[0][j]), cx);
+
+                dist = _mm_add_ps(dist, _mm_mul_ps(_mm_loadu_ps(&planes.n[1][j]), cy));
+                dist = _mm_add_ps(dist, _mm_mul_ps(_mm_loadu_ps(&planes.n[2][j]), cz));
+                dist = _mm_add_ps(dist, _mm_loadu_ps(&planes.n[3][j]));
+
+                outside |= _mm_movemask_ps(_mm_cmplt_ps(dist, negRadius));
+            }
+
+            if (!outside)
+                casters.push_back(i);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// SoftwareShadowMap.
+//-----------------------------------------------------------------------------
+
+SoftwareShadowMap::SoftwareShadowMap()
+{
+    m_bias = DEFAULT_SOFTWARE_SHADOW_BIAS;
+
+    D3DXMatrixIdentity(&m_lightViewProj);
+}
+
+SoftwareShadowMap::~SoftwareShadowMap()
+{
+    destroy();
+}
+
+void SoftwareShadowMap::addCaster(const D3DXVECTOR3 *pVertices, int vertexCount,
+                                  const int *pIndices, int triangleCount)
+{
+    m_rasterizer.addOccluder(pVertices, vertexCount, pIndices, triangleCount);
+}
+
+void SoftwareShadowMap::begin(const D3DXMATRIX &lightViewProj)
+{
+    m_lightViewProj = lightViewProj;
+    m_rasterizer.begin(lightViewProj);
+}
+
+bool SoftwareShadowMap::create(int size)
+{
+    return m_rasterizer.create(size, size);
+}
+
+void SoftwareShadowMap::destroy()
+{
+    m_rasterizer.destroy();
+}
+
+void SoftwareShadowMap::rasterize(JobSystem *pJobSystem)
+{
+    m_rasterizer.rasterize(pJobSystem);
+}
+
+float SoftwareShadowMap::shadowFactor(const D3DXVECTOR3 &position) const
+{
+    // Returns how much of the light reaches the position: 0 is fully in
+    // shadow and 1 is fully lit. The depth map holds 1/w, so a caster is
+    // nearer to the light when its value is greater. The bias is relative,
+    // which scales it with the distance from the light the way the depth
+    // map's precision does. Positions outside the light's frustum are lit;
+    // the spot light's cone and range already leave them dark.
+
+    const float *pDepth = m_rasterizer.getDepthBuffer();
+    int size = m_rasterizer.getWidth();
+    D3DXVECTOR4 clip;
+
+    if (!pDepth)
+        return 1.0f;
+
+    D3DXVec3Transform(&clip, &position, &m_lightViewProj);
+
+    if (clip.w <= 0.0f)
+        return 1.0f;
+
+    float invW = 1.0f / clip.w;
+    float x = (clip.x * invW * 0.5f + 0.5f) * size;
+    float y = (0.5f - clip.y * invW * 0.5f) * size;
+
+    if (x < 0.0f || y < 0.0f || x >= size || y >= size)
+        return 1.0f;
+
+    int px = static_cast<int>(x);
+    int py = static_cast<int>(y);
+    float biasedDepth = invW * (1.0f + m_bias);
+    int lit = 0;
+
+    for (int dy = -1; dy <= 1; ++dy)
+    {
+        int sy = py + dy;
+
+        sy = (sy < 0) ? 0 : ((sy >= size) ? size - 1 : sy);
+
+        for (int dx = -1; dx <= 1; ++dx)
+        {
+            int sx = px + dx;
+
+            sx = (sx < 0) ? 0 : ((sx >= size) ? size - 1 : sx);
+
+            if (biasedDepth >= pDepth[sy * size + sx])
+                ++lit;
+        }
+    }
+
+    return lit / 9.0f;
+}
+
+void SoftwareShadowMap::setBias(float bias)
+{
+    m_bias = bias;
+}
@@ -0,0 +1,212 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(SHADOW_MAP_H)
+#define SHADOW_MAP_H
+
+#include <vector>
+#include <d3dx9.h>
+#include "occlusion_culler.h"
+
+class JobSystem;
+
+//-----------------------------------------------------------------------------
+// Spot light shadow maps.
+//
+// A spot light's shadow map is rendered with a perspective projection from
+// the light's position looking down its direction. The field of view is the
+// spot light's outer cone angle and the far plane is the light's radius, as
+// nothing outside the cone or beyond the radius is lit anyway.
+//
+// The shadow maps of all of the lights share one atlas texture. The
+// ShadowAtlas class hands out fixed size slots in the atlas to lights and
+// keeps them in a least recently used cache, so a light whose map is still in
+// the atlas doesn't need to be rendered again until it or its casters move.
+//
+// The ShadowCasterCuller class finds the casters inside each light's frustum.
+// Lights are culled in parallel as jobs on a JobSystem.
+//
+// The SoftwareShadowMap class is a CPU reference of the whole thing: it
+// rasterizes casters into a depth map with the OcclusionCuller's rasterizer
+// and filters the depth comparisons with the same 3x3 percentage closer
+// filter as the shader.
+//-----------------------------------------------------------------------------
+
+void SpotLightViewProjection(const D3DXVECTOR3 &pos, const D3DXVECTOR3 &dir,
+                             float outerCone, float znear, float radius,
+                             D3DXMATRIX &viewProj);
+
+//-----------------------------------------------------------------------------
+
+class ShadowAtlas
+{
+public:
+    ShadowAtlas();
+    ~ShadowAtlas();
+
+    int allocate(int lightId, bool &isCached);
+    void beginFrame();
+    void create(int atlasSize, int slotSize);
+    void destroy();
+    void getSlotRect(int slot, int &x, int &y, int &size) const;
+    void invalidate(int lightId);
+    void textureMatrix(int slot, D3DXMATRIX &matrix) const;
+
+    // Getter methods.
+
+    int getAtlasSize() const;
+    int getEvictionCount() const;
+    int getHitCount() const;
+    int getMissCount() const;
+    int getSlotCount() const;
+    int getSlotSize() const;
+
+private:
+    struct Slot
+    {
+        int lightId;
+        unsigned int lastUsedFrame;
+        bool isValid;
+    };
+
+    std::vector<Slot> m_slots;
+    unsigned int m_frame;
+    int m_atlasSize;
+    int m_slotSize;
+    int m_slotsPerRow;
+    int m_hitCount;
+    int m_missCount;
+    int m_evictionCount;
+};
+
+//-----------------------------------------------------------------------------
+
+class ShadowCasterCuller
+{
+public:
+    ShadowCasterCuller();
+    ~ShadowCasterCuller();
+
+    void cull(JobSystem *pJobSystem, const D3DXMATRIX *pLightViewProjs, int lightCount,
+              const D3DXVECTOR3 *pCenters, const float *pRadii, int casterCount);
+
+    // Getter methods.
+
+    const std::vector<int> &getCasters(int light) const;
+    int getLightCount() const;
+
+private:
+    // Same layout as CameraSet's frustum planes: 8 nx, 8 ny, 8 nz, then 8 d.
+    enum { PLANE_COUNT = 8 };
+
+    struct FrustumPlanes
+    {
+        float n[4][PLANE_COUNT];
+    };
+
+    struct Batch
+    {
+        ShadowCasterCuller *pCuller;
+        int firstLight;
+        int endLight;
+    };
+
+    ShadowCasterCuller(const ShadowCasterCuller &);
+    ShadowCasterCuller &operator=(const ShadowCasterCuller &);
+
+    static void cullBatchJob(void *pData);
+
+    void cullBatch(int firstLight, int endLight);
+
+    std::vector<FrustumPlanes> m_planes;
+    std::vector<std::vector<int> > m_casters;
+    std::vector<Batch> m_batches;
+    const D3DXVECTOR3 *m_pCenters;
+    const float *m_pRadii;
+    int m_lightCount;
+    int m_casterCount;
+};
+
+//-----------------------------------------------------------------------------
+
+class SoftwareShadowMap
+{
+public:
+    SoftwareShadowMap();
+    ~SoftwareShadowMap();
+
+    void addCaster(const D3DXVECTOR3 *pVertices, int vertexCount,
+                   const int *pIndices, int triangleCount);
+    void begin(const D3DXMATRIX &lightViewProj);
+    bool create(int size);
+    void destroy();
+    void rasterize(JobSystem *pJobSystem);
+    float shadowFactor(const D3DXVECTOR3 &position) const;
+
+    // Getter methods.
+
+    float getBias() const;
+    int getSize() const;
+
+    // Setter methods.
+
+    void setBias(float bias);
+
+private:
+    OcclusionCuller m_rasterizer;
+    D3DXMATRIX m_lightViewProj;
+    float m_bias;
+};
+
+//-----------------------------------------------------------------------------
+
+inline int ShadowAtlas::getAtlasSize() const
+{ return m_atlasSize; }
+
+inline int ShadowAtlas::getEvictionCount() const
+{ return m_evictionCount; }
+
+inline int ShadowAtlas::getHitCount() const
+{ return m_hitCount; }
+
+inline int ShadowAtlas::getMissCount() const
+{ return m_missCount; }
+
+inline int ShadowAtlas::getSlotCount() const
+{ return static_cast<int>(m_slots.size()); }
+
+inline int ShadowAtlas::getSlotSize() const
+{ return m_slotSize; }
+
+inline const std::vector<int> &ShadowCasterCuller::getCasters(int light) const
+{ return m_casters[light]; }
+
+inline int ShadowCasterCuller::getLightCount() const
+{ return m_lightCount; }
+
+inline float SoftwareShadowMap::getBias() const
+{ return m_bias; }
+
+inline int SoftwareShadowMap::getSize() const
+{ return m_rasterizer.getWidth(); }
+
+#endif
@@ -0,0 +1,144 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include "job_system.h"
+#include "synthetic_city.h"
+
+namespace
+{
+    // One row of blocks of the synthetic city made by BuildCity(). The row is
+    // written to its own slice of the city's arrays, so rows can be built in
+    // parallel.
+    struct CityRow
+    {
+        int blockCount;
+        int row;
+        unsigned int random;
+        D3DXVECTOR3 *pVertices;
+        int *pIndices;
+        D3DXVECTOR3 *pObjectMins;
+        D3DXVECTOR3 *pObjectMaxs;
+    };
+
+    void BuildCityRowJob(void *pData)
+    {
+        static const int BOX_INDICES[36] =
+        {
+            0, 1, 3, 0, 3, 2,   4, 6, 7, 4, 7, 5,   0, 4, 5, 0, 5, 1,
+            2, 3, 7, 2, 7, 6,   0, 2, 6, 0, 6, 4,   1, 5, 7, 1, 7, 3
+        };
+
+        CityRow &row = *static_cast<CityRow*>(pData);
+        unsigned int random = row.random;
+        int bz = row.row;
+
+        for (int bx = 0; bx < row.blockCount; ++bx)
+        {
+            float x = bx * CITY_BLOCK_SIZE + CITY_STREET_WIDTH * 0.5f;
+            float z = bz * CITY_BLOCK_SIZE + CITY_STREET_WIDTH * 0.5f;
+            float size = CITY_BLOCK_SIZE - CITY_STREET_WIDTH;
+
+            random = random * 1664525 + 1013904223;
+
+            float height = CITY_MIN_BUILDING_HEIGHT + (CITY_MAX_BUILDING_HEIGHT
+                - CITY_MIN_BUILDING_HEIGHT) * ((random >> 8) & 0xffff) / 65535.0f;
+            int firstVertex = (bz * row.blockCount + bx) * 8;
+            D3DXVECTOR3 *pVertices = &row.pVertices[bx * 8];
+            int *pIndices = &row.pIndices[bx * 36];
+
+            for (int i = 0; i < 8; ++i)
+            {
+                pVertices[i] = D3DXVECTOR3((i & 1) ? x + size : x,
+                    (i & 2) ? height : 0.0f, (i & 4) ? z + size : z);
+            }
+
+            for (int i = 0; i < 36; ++i)
+                pIndices[i] = firstVertex + BOX_INDICES[i];
+
+            // Half of the objects go along the street in front of the block
+            // and half along the street to its left.
+
+            for (int i = 0; i < CITY_OBJECTS_PER_BLOCK; ++i)
+            {
+                random = random * 1664525 + 1013904223;
+
+                float along = CITY_BLOCK_SIZE * ((random >> 8) & 0xffff) / 65535.0f;
+                D3DXVECTOR3 objectMin = (i & 1)
+                    ? D3DXVECTOR3(bx * CITY_BLOCK_SIZE + along, 0.0f, bz * CITY_BLOCK_SIZE)
+                    : D3DXVECTOR3(bx * CITY_BLOCK_SIZE, 0.0f, bz * CITY_BLOCK_SIZE + along);
+                int object = bx * CITY_OBJECTS_PER_BLOCK + i;
+
+                row.pObjectMins[object] = objectMin;
+                row.pObjectMaxs[object] = objectMin + D3DXVECTOR3(CITY_OBJECT_SIZE, CITY_OBJECT_SIZE, CITY_OBJECT_SIZE);
+            }
+        }
+    }
+}
+
+void BuildCity(JobSystem *pJobSystem, int blockCount, std::vector<D3DXVECTOR3> &vertices,
+               std::vector<int> &indices, std::vector<D3DXVECTOR3> &objectMins,
+               std::vector<D3DXVECTOR3> &objectMaxs)
+{
+    const int randomsPerBlock = 1 + CITY_OBJECTS_PER_BLOCK;
+    std::vector<CityRow> rows(blockCount);
+    unsigned int random = 12345;
+
+    vertices.resize(blockCount * blockCount * 8);
+    indices.resize(blockCount * blockCount * 36);
+    objectMins.resize(blockCount * blockCount * CITY_OBJECTS_PER_BLOCK);
+    objectMaxs.resize(blockCount * blockCount * CITY_OBJECTS_PER_BLOCK);
+
+    if (blockCount <= 0)
+        return;
+
+    for (int bz = 0; bz < blockCount; ++bz)
+    {
+        CityRow &row = rows[bz];
+        int firstBlock = bz * blockCount;
+
+        row.blockCount = blockCount;
+        row.row = bz;
+        row.random = random;
+        row.pVertices = &vertices[firstBlock * 8];
+        row.pIndices = &indices[firstBlock * 36];
+        row.pObjectMins = &objectMins[firstBlock * CITY_OBJECTS_PER_BLOCK];
+        row.pObjectMaxs = &objectMaxs[firstBlock * CITY_OBJECTS_PER_BLOCK];
+
+        for (int i = 0; i < blockCount * randomsPerBlock; ++i)
+            random = random * 1664525 + 1013904223;
+    }
+
+    if (pJobSystem)
+    {
+        JobCounter counter;
+
+        for (int bz = 0; bz < blockCount; ++bz)
+            pJobSystem->submit(BuildCityRowJob, &rows[bz], &counter);
+
+        pJobSystem->wait(&counter);
+    }
+    else
+    {
+        for (int bz = 0; bz < blockCount; ++bz)
+            BuildCityRowJob(&rows[bz]);
+    }
+}
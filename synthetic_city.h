@@ -0,0 +1,60 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(SYNTHETIC_CITY_H)
+#define SYNTHETIC_CITY_H
+
+#include <vector>
+#include <d3dx9.h>
+
+class JobSystem;
+
+//-----------------------------------------------------------------------------
+// The layout of the synthetic city. Blocks are laid out on a grid starting at
+// the world origin and extend along the positive x and z axes.
+//-----------------------------------------------------------------------------
+
+const float CITY_BLOCK_SIZE = 24.0f;
+const float CITY_STREET_WIDTH = 8.0f;
+const float CITY_MIN_BUILDING_HEIGHT = 8.0f;
+const float CITY_MAX_BUILDING_HEIGHT = 60.0f;
+const int   CITY_OBJECTS_PER_BLOCK = 8;
+const float CITY_OBJECT_SIZE = 1.5f;
+const float CITY_ZFAR = 1000.0f;
+
+//-----------------------------------------------------------------------------
+// Builds a dense synthetic city for the culling and job system benchmarks: a
+// grid of blockCount x blockCount box shaped buildings of random heights
+// separated by streets, with small objects scattered along the streets. The
+// buildings are the occluders and go into a single indexed mesh. The objects
+// are the boxes to be culled. The same city is built every time.
+//
+// Each row of blocks is built by its own job when a job system is given.
+// A row's random number generator state is worked out up front so that
+// the city doesn't depend on the order in which the rows are built.
+//-----------------------------------------------------------------------------
+
+void BuildCity(JobSystem *pJobSystem, int blockCount, std::vector<D3DXVECTOR3> &vertices,
+               std::vector<int> &indices, std::vector<D3DXVECTOR3> &objectMins,
+               std::vector<D3DXVECTOR3> &objectMaxs);
+
+#endif
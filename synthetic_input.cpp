@@ -0,0 +1,201 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <cmath>
+#include "synthetic_input.h"
+#include "timer.h"
+
+namespace
+{
+    const double TWO_PI = 6.283185307179586;
+
+    // The mouse sweeps back and forth along both axes. The peak speed along
+    // x is about 12500 counts/sec, which at 8 kHz is a little over one and a
+    // half counts per report.
+    const double MOUSE_AMPLITUDE_X = 4000.0;
+    const double MOUSE_AMPLITUDE_Y = 1500.0;
+    const double MOUSE_FREQUENCY_X = 0.5;
+    const double MOUSE_FREQUENCY_Y = 0.35;
+
+    const double KEY_HOLD_MIN = 0.002;
+    const double KEY_HOLD_MAX = 0.2;
+
+    // The keys are picked from the main block of the keyboard (Keyboard::KEY_1 up
+    // to Keyboard::KEY_SPACE).
+    const int FIRST_KEY = 0x02;
+    const int KEY_COUNT = 0x38;
+}
+
+SyntheticInputSource::SyntheticInputSource()
+{
+    m_pEventQueue = 0;
+    create(0.0, 0.0f, 0.0f, 1);
+}
+
+SyntheticInputSource::~SyntheticInputSource()
+{
+}
+
+void SyntheticInputSource::create(double startTime, float mouseReportRate,
+                                  float keyPressRate, unsigned int seed)
+{
+    // A rate of 0 turns that kind of event off.
+
+    m_startTime = startTime;
+    m_time = startTime;
+    m_reportInterval = (mouseReportRate > 0.0f) ? 1.0 / mouseReportRate : 0.0;
+    m_keyInterval = (keyPressRate > 0.0f) ? 1.0 / keyPressRate : 0.0;
+    m_reportIndex = 1;
+    m_nextReportTime = startTime + m_reportInterval;
+    m_mouseX = 0;
+    m_mouseY = 0;
+    m_keyDown = -1;
+    m_random = seed;
+    m_sequence = 0;
+    m_eventCount = 0;
+    m_droppedEventCount = 0;
+    m_keyPressCount = 0;
+    m_mouseReportCount = 0;
+
+    m_nextKeyTime = startTime + m_keyInterval * random();
+}
+
+void SyntheticInputSource::setEventQueue(InputEventQueue *pQueue)
+{
+    m_pEventQueue = pQueue;
+}
+
+void SyntheticInputSource::update()
+{
+    update(GetTimeInSeconds());
+}
+
+void SyntheticInputSource::update(double time)
+{
+    bool hasMouse = m_reportInterval > 0.0;
+    bool hasKeys = m_keyInterval > 0.0;
+
+    while (hasMouse || hasKeys)
+    {
+        bool keyEvent = hasKeys && (!hasMouse || m_nextKeyTime < m_nextReportTime);
+        double eventTime = keyEvent ? m_nextKeyTime : m_nextReportTime;
+
+        if (eventTime > time)
+            break;
+
+        if (keyEvent)
+        {
+            if (m_keyDown < 0)
+            {
+                m_keyDown = FIRST_KEY + static_cast<int>(random() * KEY_COUNT);
+                emit(InputEvent::KEY_DOWN, m_keyDown, 0, m_sequence++, eventTime);
+                ++m_keyPressCount;
+
+                m_nextKeyTime += KEY_HOLD_MIN + (KEY_HOLD_MAX - KEY_HOLD_MIN) * random();
+            }
+            else
+            {
+                // Wait long enough between releasing a key and pressing the
+                // next one that the presses average out to the key press
+                // rate. That's not possible when the rate is so high that
+                // the keys are on average held longer than the interval.
+
+                double gap = m_keyInterval - 0.5 * (KEY_HOLD_MIN + KEY_HOLD_MAX);
+
+                emit(InputEvent::KEY_UP, m_keyDown, 0, m_sequence++, eventTime);
+                m_keyDown = -1;
+
+                m_nextKeyTime += (gap > 0.0) ? 2.0 * gap * random() : 0.0;
+            }
+        }
+        else
+        {
+            // The report times are calculated from the report index rather
+            // than accumulated so that they don't drift over long runs.
+
+            int x = mousePosition(eventTime, 0);
+            int y = mousePosition(eventTime, 1);
+
+            if (x != m_mouseX || y != m_mouseY)
+            {
+                unsigned int sequence = m_sequence++;
+
+                if (x != m_mouseX)
+                    emit(InputEvent::MOUSE_MOVE_X, 0, x - m_mouseX, sequence, eventTime);
+
+                if (y != m_mouseY)
+                    emit(InputEvent::MOUSE_MOVE_Y, 0, y - m_mouseY, sequence, eventTime);
+
+                m_mouseX = x;
+                m_mouseY = y;
+                ++m_mouseReportCount;
+            }
+
+            ++m_reportIndex;
+            m_nextReportTime = m_startTime + m_reportInterval * static_cast<double>(m_reportIndex);
+        }
+    }
+
+    if (time > m_time)
+        m_time = time;
+}
+
+void SyntheticInputSource::emit(InputEvent::Type type, int code, int value,
+                                unsigned int sequence, double time)
+{
+    InputEvent event;
+
+    event.type = type;
+    event.code = code;
+    event.value = value;
+    event.timeStamp = static_cast<unsigned int>(time * 1000.0);
+    event.sequence = sequence;
+    event.time = time;
+
+    ++m_eventCount;
+
+    if (m_pEventQueue && !m_pEventQueue->push(event))
+        ++m_droppedEventCount;
+}
+
+int SyntheticInputSource::mousePosition(double time, int axis) const
+{
+    // The position in whole counts. Both axes start at 0.
+
+    double t = time - m_startTime;
+    double position = 0.0;
+
+    if (axis == 0)
+        position = MOUSE_AMPLITUDE_X * sin(TWO_PI * MOUSE_FREQUENCY_X * t);
+    else
+        position = MOUSE_AMPLITUDE_Y * (1.0 - cos(TWO_PI * MOUSE_FREQUENCY_Y * t));
+
+    return static_cast<int>(floor(position));
+}
+
+float SyntheticInputSource::random()
+{
+    // Returns a number in the range [0,1).
+
+    m_random = m_random * 1664525 + 1013904223;
+    return static_cast<float>(m_random >> 8) * (1.0f / 16777216.0f);
+}
@@ -0,0 +1,124 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(SYNTHETIC_INPUT_H)
+#define SYNTHETIC_INPUT_H
+
+#include "input_events.h"
+
+//-----------------------------------------------------------------------------
+// The SyntheticInputSource class generates a reproducible stream of input
+// events without any input devices. It's used to test and benchmark the
+// input event path on machines (and build servers) that have no keyboard or
+// mouse attached, and at rates (e.g., an 8 kHz mouse) that the available
+// hardware can't produce.
+//
+// The mouse moves smoothly back and forth and sends a report every
+// 1 / mouseReportRate seconds. The movement of a report is quantized to
+// whole counts the way a real mouse does it, and the x and y events of a
+// report share the same sequence number. Reports without any movement are
+// not sent. Keys are pressed at random, on average keyPressRate times a
+// second, and are held for between 2 and 200 milliseconds so some of the
+// key presses are shorter than a frame.
+//
+// Events are generated in time order. The events generated for a given
+// seed only depend on the time passed to update(), not on how often update()
+// is called, so two sources created with the same settings produce the same
+// events.
+//-----------------------------------------------------------------------------
+
+class SyntheticInputSource : public InputEventSource
+{
+public:
+    SyntheticInputSource();
+    virtual ~SyntheticInputSource();
+
+    void create(double startTime, float mouseReportRate, float keyPressRate, unsigned int seed);
+    virtual void setEventQueue(InputEventQueue *pQueue);
+
+    // Generates all events up to now (GetTimeInSeconds()).
+    virtual void update();
+
+    // Generates all events up to the given time.
+    void update(double time);
+
+    // Getter methods.
+
+    int getDroppedEventCount() const;
+    int getEventCount() const;
+    int getKeyPressCount() const;
+    int getMouseReportCount() const;
+    int getMouseX() const;
+    int getMouseY() const;
+    double getTime() const;
+
+private:
+    SyntheticInputSource(const SyntheticInputSource &);
+    SyntheticInputSource &operator=(const SyntheticInputSource &);
+
+    void emit(InputEvent::Type type, int code, int value, unsigned int sequence, double time);
+    int mousePosition(double time, int axis) const;
+    float random();
+
+    InputEventQueue *m_pEventQueue;
+    double m_startTime;
+    double m_time;
+    double m_reportInterval;
+    double m_keyInterval;
+    double m_nextReportTime;
+    double m_nextKeyTime;
+    int m_reportIndex;
+    int m_mouseX;
+    int m_mouseY;
+    int m_keyDown;
+    unsigned int m_random;
+    unsigned int m_sequence;
+    int m_eventCount;
+    int m_droppedEventCount;
+    int m_keyPressCount;
+    int m_mouseReportCount;
+};
+
+//-----------------------------------------------------------------------------
+
+inline int SyntheticInputSource::getDroppedEventCount() const
+{ return m_droppedEventCount; }
+
+inline int SyntheticInputSource::getEventCount() const
+{ return m_eventCount; }
+
+inline int SyntheticInputSource::getKeyPressCount() const
+{ return m_keyPressCount; }
+
+inline int SyntheticInputSource::getMouseReportCount() const
+{ return m_mouseReportCount; }
+
+inline int SyntheticInputSource::getMouseX() const
+{ return m_mouseX; }
+
+inline int SyntheticInputSource::getMouseY() const
+{ return m_mouseY; }
+
+inline double SyntheticInputSource::getTime() const
+{ return m_time; }
+
+#endif
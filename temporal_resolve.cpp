@@ -0,0 +1,277 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include "temporal_resolve.h"
+
+namespace
+{
+    // How much of the current frame goes into the output. 0.1 averages over
+    // roughly the last 10 frames, which is enough for 8 jitter samples.
+    const float DEFAULT_BLEND_FACTOR = 0.1f;
+
+    inline float Clamp(float value, float minValue, float maxValue)
+    {
+        return (value < minValue) ? minValue : ((value > maxValue) ? maxValue : value);
+    }
+
+    inline void ReprojectPixel(const D3DXMATRIX &reprojection, float x, float y, float depth,
+                               D3DXVECTOR2 &motion)
+    {
+        // The pixel's normalized device coordinates and depth go through
+        // 'reprojection' to where the same point was in the previous frame.
+        // The unprojected position is left in homogeneous form; the divide
+        // by w cancels out in the second projection.
+
+        D3DXVECTOR4 ndc(x, y, depth, 1.0f);
+        D3DXVECTOR4 previous;
+
+        D3DXVec4Transform(&previous, &ndc, &reprojection);
+
+        motion.x = x - previous.x / previous.w;
+        motion.y = y - previous.y / previous.w;
+    }
+}
+
+TemporalResolve::TemporalResolve()
+{
+    m_width = 0;
+    m_height = 0;
+    m_blendFactor = DEFAULT_BLEND_FACTOR;
+    m_hasHistory = false;
+}
+
+TemporalResolve::~TemporalResolve()
+{
+    destroy();
+}
+
+void TemporalResolve::cameraMotionVectors(const CameraBase &camera, const float *pDepth,
+                                          int width, int height, D3DXVECTOR2 *pMotion)
+{
+    // Each pixel's depth buffer value is unprojected to a position relative
+    // to the camera's origin using the inverse of the unjittered
+    // view-projection matrix. That position is then projected with the
+    // previous frame's matrix. The pixel centers are taken without the
+    // jitter, so a static camera produces zero motion.
+
+    D3DXMATRIX viewProj = camera.getUnjitteredViewProjectionMatrix();
+    D3DXMATRIX prevViewProj = camera.getPreviousViewProjectionMatrix();
+    D3DXMATRIX invViewProj;
+    D3DXMATRIX reprojection;
+
+    D3DXMatrixInverse(&invViewProj, 0, &viewProj);
+    reprojection = invViewProj * prevViewProj;
+
+    float scaleX = 2.0f / width;
+    float scaleY = -2.0f / height;
+
+    for (int y = 0; y < height; ++y)
+    {
+        float ndcY = (y + 0.5f) * scaleY + 1.0f;
+
+        for (int x = 0; x < width; ++x)
+        {
+            int index = y * width + x;
+            ReprojectPixel(reprojection, (x + 0.5f) * scaleX - 1.0f, ndcY, pDepth[index], pMotion[index]);
+        }
+    }
+}
+
+void TemporalResolve::objectMotionVectors(const CameraBase &camera, const float *pDepth,
+                                          const int *pObjectIds, const D3DXMATRIX *pWorldMatrices,
+                                          const D3DXMATRIX *pPreviousWorldMatrices, int objectCount,
+                                          int width, int height, D3DXVECTOR2 *pMotion)
+{
+    // Like cameraMotionVectors(), except that the unprojected position is
+    // taken back into the object's local space with the inverse of its
+    // current world matrix, and out again with its previous world matrix,
+    // before the previous frame's projection. Both world matrices are
+    // relative to the camera's current origin. Pixels whose object id isn't
+    // in the range [0, objectCount) are left alone.
+
+    if (objectCount <= 0)
+        return;
+
+    D3DXMATRIX viewProj = camera.getUnjitteredViewProjectionMatrix();
+    D3DXMATRIX prevViewProj = camera.getPreviousViewProjectionMatrix();
+    D3DXMATRIX invViewProj;
+    D3DXMATRIX invWorld;
+    std::vector<D3DXMATRIX> reprojections(objectCount);
+
+    D3DXMatrixInverse(&invViewProj, 0, &viewProj);
+
+    for (int i = 0; i < objectCount; ++i)
+    {
+        D3DXMatrixInverse(&invWorld, 0, &pWorldMatrices[i]);
+        reprojections[i] = invViewProj * invWorld * pPreviousWorldMatrices[i] * prevViewProj;
+    }
+
+    float scaleX = 2.0f / width;
+    float scaleY = -2.0f / height;
+
+    for (int y = 0; y < height; ++y)
+    {
+        float ndcY = (y + 0.5f) * scaleY + 1.0f;
+
+        for (int x = 0; x < width; ++x)
+        {
+            int index = y * width + x;
+            int id = pObjectIds[index];
+
+            if (id >= 0 && id < objectCount)
+                ReprojectPixel(reprojections[id], (x + 0.5f) * scaleX - 1.0f, ndcY, pDepth[index], pMotion[index]);
+        }
+    }
+}
+
+bool TemporalResolve::create(int width, int height)
+{
+    if (width <= 0 || height <= 0)
+        return false;
+
+    m_width = width;
+    m_height = height;
+    m_history.assign(width * height, D3DXVECTOR3(0.0f, 0.0f, 0.0f));
+    m_hasHistory = false;
+    return true;
+}
+
+void TemporalResolve::destroy()
+{
+    std::vector<D3DXVECTOR3>().swap(m_history);
+    m_width = 0;
+    m_height = 0;
+    m_hasHistory = false;
+}
+
+void TemporalResolve::reset()
+{
+    // Call after a camera cut. The next resolve() starts a new history.
+
+    m_hasHistory = false;
+}
+
+void TemporalResolve::resolve(const D3DXVECTOR3 *pColor, const D3DXVECTOR2 *pMotion,
+                              D3DXVECTOR3 *pOutput)
+{
+    // 'pColor', 'pMotion', and 'pOutput' are width * height pixels in rows
+    // from top to bottom. The output becomes the history for the next frame.
+    // 'pOutput' may not point to the same pixels as 'pColor'.
+
+    if (m_history.empty())
+        return;
+
+    if (!m_hasHistory)
+    {
+        for (int i = 0; i < m_width * m_height; ++i)
+            m_history[i] = pOutput[i] = pColor[i];
+
+        m_hasHistory = true;
+        return;
+    }
+
+    float halfWidth = 0.5f * m_width;
+    float halfHeight = 0.5f * m_height;
+
+    for (int y = 0; y < m_height; ++y)
+    {
+        for (int x = 0; x < m_width; ++x)
+        {
+            int index = y * m_width + x;
+
+            // The current frame's 3x3 neighborhood bounds the history.
+
+            D3DXVECTOR3 minColor = pColor[index];
+            D3DXVECTOR3 maxColor = pColor[index];
+
+            for (int j = y - 1; j <= y + 1; ++j)
+            {
+                if (j < 0 || j >= m_height)
+                    continue;
+
+                for (int i = x - 1; i <= x + 1; ++i)
+                {
+                    if (i < 0 || i >= m_width)
+                        continue;
+
+                    D3DXVec3Minimize(&minColor, &minColor, &pColor[j * m_width + i]);
+                    D3DXVec3Maximize(&maxColor, &maxColor, &pColor[j * m_width + i]);
+                }
+            }
+
+            // Motion vectors are in normalized device coordinates where y
+            // points up, so y is flipped going to pixels.
+
+            float prevX = x - pMotion[index].x * halfWidth;
+            float prevY = y + pMotion[index].y * halfHeight;
+            D3DXVECTOR3 current = pColor[index];
+
+            if (prevX < -0.5f || prevX > m_width - 0.5f || prevY < -0.5f || prevY > m_height - 0.5f)
+            {
+                // Came in from off screen. There's no history.
+                pOutput[index] = current;
+                continue;
+            }
+
+            D3DXVECTOR3 history = sampleHistory(prevX, prevY);
+
+            history.x = Clamp(history.x, minColor.x, maxColor.x);
+            history.y = Clamp(history.y, minColor.y, maxColor.y);
+            history.z = Clamp(history.z, minColor.z, maxColor.z);
+
+            pOutput[index] = history + (current - history) * m_blendFactor;
+        }
+    }
+
+    for (int i = 0; i < m_width * m_height; ++i)
+        m_history[i] = pOutput[i];
+}
+
+void TemporalResolve::setBlendFactor(float blendFactor)
+{
+    m_blendFactor = Clamp(blendFactor, 0.0f, 1.0f);
+}
+
+D3DXVECTOR3 TemporalResolve::sampleHistory(float x, float y) const
+{
+    // Bilinear fetch with the coordinates clamped to the edges of the buffer.
+
+    x = Clamp(x, 0.0f, static_cast<float>(m_width - 1));
+    y = Clamp(y, 0.0f, static_cast<float>(m_height - 1));
+
+    int x0 = static_cast<int>(x);
+    int y0 = static_cast<int>(y);
+    int x1 = (x0 + 1 < m_width) ? x0 + 1 : x0;
+    int y1 = (y0 + 1 < m_height) ? y0 + 1 : y0;
+    float fx = x - x0;
+    float fy = y - y0;
+
+    const D3DXVECTOR3 &c00 = m_history[y0 * m_width + x0];
+    const D3DXVECTOR3 &c10 = m_history[y0 * m_width + x1];
+    const D3DXVECTOR3 &c01 = m_history[y1 * m_width + x0];
+    const D3DXVECTOR3 &c11 = m_history[y1 * m_width + x1];
+
+    D3DXVECTOR3 top = c00 + (c10 - c00) * fx;
+    D3DXVECTOR3 bottom = c01 + (c11 - c01) * fx;
+
+    return top + (bottom - top) * fy;
+}
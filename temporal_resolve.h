@@ -0,0 +1,103 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(TEMPORAL_RESOLVE_H)
+#define TEMPORAL_RESOLVE_H
+
+#include <vector>
+#include <d3dx9.h>
+#include "camera.h"
+
+//-----------------------------------------------------------------------------
+// The TemporalResolve class is a CPU reference implementation of temporal
+// anti-aliasing. Each frame is rendered with a sub-pixel jittered projection
+// (see CameraBase::setJitter()) and blended into a history buffer that has
+// been reprojected to the current frame using per-pixel motion vectors. Over
+// a few frames the jittered samples add up to a supersampled image.
+//
+// The history sample is clamped to the range of the current frame's 3x3
+// neighborhood around the pixel before blending. This rejects most stale
+// history (disocclusions, lighting changes) at the cost of a little blur.
+//
+// Motion vectors are in normalized device coordinates, current minus
+// previous, as returned by CameraBase::motionVector(). cameraMotionVectors()
+// fills them in for a static scene from the depth buffer and the camera's
+// current and previous view-projection matrices. objectMotionVectors() then
+// overwrites the pixels covered by moving objects, given an object id per
+// pixel and each object's current and previous world matrix. Without them a
+// moving object's history is fetched from where the static scene behind it
+// would have been, and it leaves a trail.
+//
+// This is a reference for checking a GPU resolve against and for headless
+// testing. It isn't fast enough to resolve every frame at full resolution.
+//-----------------------------------------------------------------------------
+
+class TemporalResolve
+{
+public:
+    TemporalResolve();
+    ~TemporalResolve();
+
+    static void cameraMotionVectors(const CameraBase &camera, const float *pDepth,
+                                    int width, int height, D3DXVECTOR2 *pMotion);
+    static void objectMotionVectors(const CameraBase &camera, const float *pDepth,
+                                    const int *pObjectIds, const D3DXMATRIX *pWorldMatrices,
+                                    const D3DXMATRIX *pPreviousWorldMatrices, int objectCount,
+                                    int width, int height, D3DXVECTOR2 *pMotion);
+
+    bool create(int width, int height);
+    void destroy();
+    void reset();
+    void resolve(const D3DXVECTOR3 *pColor, const D3DXVECTOR2 *pMotion, D3DXVECTOR3 *pOutput);
+
+    // Getter methods.
+
+    float getBlendFactor() const;
+    int getHeight() const;
+    int getWidth() const;
+
+    // Setter methods.
+
+    void setBlendFactor(float blendFactor);
+
+private:
+    D3DXVECTOR3 sampleHistory(float x, float y) const;
+
+    std::vector<D3DXVECTOR3> m_history;
+    int m_width;
+    int m_height;
+    float m_blendFactor;
+    bool m_hasHistory;
+};
+
+//-----------------------------------------------------------------------------
+
+inline float TemporalResolve::getBlendFactor() const
+{ return m_blendFactor; }
+
+inline int TemporalResolve::getHeight() const
+{ return m_height; }
+
+inline int TemporalResolve::getWidth() const
+{ return m_width; }
+
+#endif
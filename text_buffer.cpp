@@ -0,0 +1,168 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <cmath>
+#include <cstdio>
+#include "text_buffer.h"
+
+namespace
+{
+    const unsigned long long POWERS_OF_TEN[] =
+    {
+        1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL
+    };
+
+    const int MAX_PRECISION = 6;
+
+    // Floats at or above this magnitude no longer fit into the 64-bit
+    // fixed point representation used by TextBuffer::append(float, int).
+    const double MAX_FIXED_POINT_VALUE = 1e12;
+}
+
+TextBuffer::TextBuffer()
+{
+    clear();
+}
+
+TextBuffer::~TextBuffer()
+{
+}
+
+TextBuffer &TextBuffer::append(char c)
+{
+    // Always leave room for the null terminator.
+
+    if (m_length < CAPACITY - 1)
+    {
+        m_text[m_length++] = c;
+        m_text[m_length] = '\0';
+    }
+
+    return *this;
+}
+
+TextBuffer &TextBuffer::append(const char *pszText)
+{
+    while (*pszText && m_length < CAPACITY - 1)
+        m_text[m_length++] = *pszText++;
+
+    m_text[m_length] = '\0';
+    return *this;
+}
+
+TextBuffer &TextBuffer::append(int value)
+{
+    unsigned long long magnitude = 0;
+
+    if (value < 0)
+    {
+        append('-');
+        magnitude = static_cast<unsigned long long>(-(static_cast<long long>(value)));
+    }
+    else
+    {
+        magnitude = static_cast<unsigned long long>(value);
+    }
+
+    appendUnsigned(magnitude, 1);
+    return *this;
+}
+
+TextBuffer &TextBuffer::append(float value, int precision)
+{
+    // Formats the float in fixed point notation with 'precision' digits after
+    // the decimal point. The value is rounded to the nearest representable
+    // fixed point value and then written out as two integers. This is much
+    // cheaper than going through the stream or printf machinery.
+
+    if (precision < 0)
+        precision = 0;
+    else if (precision > MAX_PRECISION)
+        precision = MAX_PRECISION;
+
+    double v = static_cast<double>(value);
+
+    if (v != v)
+        return append("nan");
+
+    if (fabs(v) >= MAX_FIXED_POINT_VALUE)
+    {
+        // Rare case. Fall back to the C runtime using a stack buffer so that
+        // we still don't allocate any memory.
+
+        char szTemp[64];
+        sprintf(szTemp, "%.*f", precision, v);
+        return append(szTemp);
+    }
+
+    unsigned long long scale = POWERS_OF_TEN[precision];
+    unsigned long long fixed = static_cast<unsigned long long>(fabs(v) * scale + 0.5);
+
+    // Don't print "-0.00" for small negative values that round to zero.
+    if (v < 0.0 && fixed != 0)
+        append('-');
+
+    appendUnsigned(fixed / scale, 1);
+
+    if (precision > 0)
+    {
+        append('.');
+        appendUnsigned(fixed % scale, precision);
+    }
+
+    return *this;
+}
+
+TextBuffer &TextBuffer::newline()
+{
+    return append('\n');
+}
+
+void TextBuffer::clear()
+{
+    m_length = 0;
+    m_text[0] = '\0';
+}
+
+void TextBuffer::appendUnsigned(unsigned long long value, int minDigits)
+{
+    // Digits are generated in reverse order into a small scratch buffer and
+    // then copied into the text buffer. 20 digits is enough for any 64-bit
+    // unsigned integer.
+
+    char digits[20];
+    int count = 0;
+
+    do
+    {
+        digits[count++] = static_cast<char>('0' + (value % 10));
+        value /= 10;
+    } while (value != 0 && count < 20);
+
+    while (count < minDigits && count < 20)
+        digits[count++] = '0';
+
+    while (count > 0 && m_length < CAPACITY - 1)
+        m_text[m_length++] = digits[--count];
+
+    m_text[m_length] = '\0';
+}
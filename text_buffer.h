@@ -0,0 +1,62 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(TEXT_BUFFER_H)
+#define TEXT_BUFFER_H
+
+//-----------------------------------------------------------------------------
+// The TextBuffer class is a fixed capacity string builder used to format the
+// on screen text. Unlike std::ostringstream it never allocates memory, and
+// integers and floats are converted to text without going through the C
+// runtime's locale aware formatting routines. Text that doesn't fit into the
+// buffer is silently truncated.
+//-----------------------------------------------------------------------------
+
+class TextBuffer
+{
+public:
+    TextBuffer();
+    ~TextBuffer();
+
+    TextBuffer &append(char c);
+    TextBuffer &append(const char *pszText);
+    TextBuffer &append(int value);
+    TextBuffer &append(float value, int precision);
+    TextBuffer &newline();
+    void clear();
+
+    const char *c_str() const
+    { return m_text; }
+
+    int length() const
+    { return m_length; }
+
+private:
+    enum { CAPACITY = 2048 };
+
+    void appendUnsigned(unsigned long long value, int minDigits);
+
+    char m_text[CAPACITY];
+    int m_length;
+};
+
+#endif
@@ -0,0 +1,113 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <intrin.h>
+#pragma intrinsic(_InterlockedCompareExchange64)
+#else
+#include <time.h>
+#endif
+
+#include "timer.h"
+
+namespace
+{
+    // The largest tick count returned so far. Readings from a processor whose
+    // counter lags behind are clamped to this value.
+    volatile long long g_lastTicks = 0;
+
+    long long ReadTicks()
+    {
+#if defined(_WIN32)
+        LARGE_INTEGER ticks;
+
+        QueryPerformanceCounter(&ticks);
+        return ticks.QuadPart;
+#else
+        timespec now;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return static_cast<long long>(now.tv_sec) * 1000000000LL + now.tv_nsec;
+#endif
+    }
+
+    double TicksPerSecond()
+    {
+#if defined(_WIN32)
+        LARGE_INTEGER freq;
+
+        QueryPerformanceFrequency(&freq);
+        return static_cast<double>(freq.QuadPart);
+#else
+        return 1e9;
+#endif
+    }
+
+    long long CompareExchange(volatile long long *pDest, long long exchange, long long comparand)
+    {
+#if defined(_WIN32)
+        return _InterlockedCompareExchange64(pDest, exchange, comparand);
+#else
+        return __sync_val_compare_and_swap(pDest, comparand, exchange);
+#endif
+    }
+
+    // Computed once during static initialization, before any threads are
+    // started. A function local static would be initialized on first use,
+    // which isn't thread safe with Visual C++ 2008.
+    const double g_secondsPerTick = 1.0 / TicksPerSecond();
+}
+
+double GetTimeInSeconds()
+{
+    long long ticks = ReadTicks();
+
+    // A plain 64-bit read isn't atomic on 32-bit x86. A compare exchange that
+    // never succeeds in changing anything is.
+    long long lastTicks = CompareExchange(&g_lastTicks, 0, 0);
+
+    while (ticks > lastTicks)
+    {
+        long long previous = CompareExchange(&g_lastTicks, ticks, lastTicks);
+
+        if (previous == lastTicks)
+            break;
+
+        lastTicks = previous;
+    }
+
+    if (ticks < lastTicks)
+        ticks = lastTicks;
+
+    return static_cast<double>(ticks) * g_secondsPerTick;
+}
+
+long long GetTimerTicks()
+{
+    return ReadTicks();
+}
+
+double GetTimerTickSeconds()
+{
+    return g_secondsPerTick;
+}
@@ -0,0 +1,51 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(TIMER_H)
+#define TIMER_H
+
+//-----------------------------------------------------------------------------
+// Returns the time in seconds since an arbitrary fixed point in the past.
+//
+// The returned time never goes backwards, even when successive calls are made
+// from different processors whose performance counters aren't perfectly
+// synchronized. This makes it safe to call from any thread without having to
+// pin the calling thread to a single processor.
+//-----------------------------------------------------------------------------
+
+extern double GetTimeInSeconds();
+
+//-----------------------------------------------------------------------------
+// Returns the raw high resolution counter, and the length of one of its ticks
+// in seconds.
+//
+// Unlike GetTimeInSeconds() reading the counter touches no shared state, so
+// it's cheap enough to time very short operations from many threads at once.
+// The reading isn't adjusted for unsynchronized processors though. The
+// difference between two readings can be negative if the thread moved to
+// another processor in between.
+//-----------------------------------------------------------------------------
+
+extern long long GetTimerTicks();
+extern double GetTimerTickSeconds();
+
+#endif
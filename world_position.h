@@ -0,0 +1,108 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2008 dhpoware. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#if !defined(WORLD_POSITION_H)
+#define WORLD_POSITION_H
+
+#include <cmath>
+#include <d3dx9.h>
+
+//-----------------------------------------------------------------------------
+// Positions in large worlds.
+//
+// A float only has 24 bits of mantissa. 10 km from the origin a float can't
+// resolve anything finer than about 1 mm, and at 10,000 km it's down to 1 m.
+// Building the view matrix from such a position makes the whole scene jitter
+// as the camera moves.
+//
+// WorldPosition holds an absolute position in doubles. Anything stored for
+// long (e.g., objects in a level) is better kept as a SectorPosition: the
+// integer index of the sector (a cube of WORLD_SECTOR_SIZE world units) the
+// position lies in plus a float offset from the sector's origin. The offset
+// stays small so it keeps its full precision.
+//
+// WorldOffset() subtracts two positions in double precision and only then
+// rounds the result to a float. As long as the two positions are close
+// together the result is accurate no matter how far they are from the
+// origin. This is what camera relative rendering relies on: everything is
+// positioned relative to the camera's eye rather than to the world origin.
+//-----------------------------------------------------------------------------
+
+const double WORLD_SECTOR_SIZE = 1024.0;
+
+struct WorldPosition
+{
+    double x;
+    double y;
+    double z;
+
+    WorldPosition() : x(0.0), y(0.0), z(0.0) {}
+    WorldPosition(double x_, double y_, double z_) : x(x_), y(y_), z(z_) {}
+
+    explicit WorldPosition(const D3DXVECTOR3 &v) : x(v.x), y(v.y), z(v.z) {}
+};
+
+struct SectorPosition
+{
+    int sector[3];
+    D3DXVECTOR3 offset;
+};
+
+//-----------------------------------------------------------------------------
+
+inline WorldPosition operator+(const WorldPosition &position, const D3DXVECTOR3 &offset)
+{
+    return WorldPosition(position.x + offset.x, position.y + offset.y, position.z + offset.z);
+}
+
+inline D3DXVECTOR3 WorldOffset(const WorldPosition &position, const WorldPosition &origin)
+{
+    return D3DXVECTOR3(static_cast<float>(position.x - origin.x),
+        static_cast<float>(position.y - origin.y),
+        static_cast<float>(position.z - origin.z));
+}
+
+inline WorldPosition SectorOrigin(const SectorPosition &position)
+{
+    return WorldPosition(position.sector[0] * WORLD_SECTOR_SIZE,
+        position.sector[1] * WORLD_SECTOR_SIZE,
+        position.sector[2] * WORLD_SECTOR_SIZE);
+}
+
+inline SectorPosition ToSectorPosition(const WorldPosition &position)
+{
+    SectorPosition result;
+
+    result.sector[0] = static_cast<int>(floor(position.x / WORLD_SECTOR_SIZE));
+    result.sector[1] = static_cast<int>(floor(position.y / WORLD_SECTOR_SIZE));
+    result.sector[2] = static_cast<int>(floor(position.z / WORLD_SECTOR_SIZE));
+    result.offset = WorldOffset(position, SectorOrigin(result));
+
+    return result;
+}
+
+inline WorldPosition ToWorldPosition(const SectorPosition &position)
+{
+    return SectorOrigin(position) + position.offset;
+}
+
+#endif